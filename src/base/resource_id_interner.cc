@@ -0,0 +1,113 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Interning table that maps resource UUIDs to dense 32-bit indices.
+
+#include "base/resource_id_interner.h"
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/thread/locks.hpp>
+#include <boost/uuid/string_generator.hpp>
+#endif
+
+#include <cstdlib>
+#include <limits>
+
+namespace firmament {
+
+const DenseResourceID_t ResourceIDInterner::kInvalidDenseResourceID =
+  numeric_limits<DenseResourceID_t>::max();
+
+DenseResourceID_t ResourceIDInterner::Intern(const ResourceID_t& res_id) {
+  // Taking a reference modifies the table, so this needs the exclusive lock
+  // even if the ID is known. Hot paths use Lookup instead.
+  boost::unique_lock<boost::shared_mutex> lock(lock_);
+  auto result = dense_ids_.insert(
+      pair<ResourceID_t, DenseResourceID_t>(res_id,
+                                            kInvalidDenseResourceID));
+  if (result.second) {
+    if (!free_ids_.empty()) {
+      result.first->second = free_ids_.back();
+      free_ids_.pop_back();
+      res_ids_[result.first->second] = res_id;
+    } else {
+      CHECK_LT(res_ids_.size(), kInvalidDenseResourceID);
+      result.first->second = res_ids_.size();
+      res_ids_.push_back(res_id);
+      ref_counts_.push_back(0);
+    }
+  }
+  ++ref_counts_[result.first->second];
+  return result.first->second;
+}
+
+DenseResourceID_t ResourceIDInterner::InternString(const string& res_id_str) {
+#ifdef __PLATFORM_HAS_BOOST__
+  boost::uuids::string_generator gen;
+  return Intern(gen(res_id_str));
+#else
+  return Intern(strtoull(res_id_str.c_str(), NULL, 10));
+#endif
+}
+
+DenseResourceID_t ResourceIDInterner::Lookup(
+    const ResourceID_t& res_id) const {
+  boost::shared_lock<boost::shared_mutex> lock(lock_);
+  auto it = dense_ids_.find(res_id);
+  if (it == dense_ids_.end())
+    return kInvalidDenseResourceID;
+  return it->second;
+}
+
+void ResourceIDInterner::Release(const ResourceID_t& res_id) {
+  boost::unique_lock<boost::shared_mutex> lock(lock_);
+  auto it = dense_ids_.find(res_id);
+  if (it == dense_ids_.end())
+    return;
+  CHECK_GT(ref_counts_[it->second], 0);
+  if (--ref_counts_[it->second] > 0)
+    return;
+  free_ids_.push_back(it->second);
+  dense_ids_.erase(it);
+}
+
+void ResourceIDInterner::ReleaseDenseID(DenseResourceID_t dense_id) {
+  ResourceID_t res_id = ResourceIDForDenseID(dense_id);
+  Release(res_id);
+}
+
+ResourceID_t ResourceIDInterner::ResourceIDForDenseID(
+    DenseResourceID_t dense_id) const {
+  boost::shared_lock<boost::shared_mutex> lock(lock_);
+  CHECK_LT(dense_id, res_ids_.size());
+  return res_ids_[dense_id];
+}
+
+size_t ResourceIDInterner::size() const {
+  boost::shared_lock<boost::shared_mutex> lock(lock_);
+  return res_ids_.size();
+}
+
+ResourceIDInterner* ResourceIDs() {
+  static ResourceIDInterner interner;
+  return &interner;
+}
+
+}  // namespace firmament
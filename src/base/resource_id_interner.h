@@ -0,0 +1,120 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Interning table that maps resource UUIDs to dense 32-bit indices, so that
+// scheduler-internal state can be kept in flat arrays rather than in maps
+// keyed by 16-byte UUIDs.
+
+#ifndef FIRMAMENT_BASE_RESOURCE_ID_INTERNER_H
+#define FIRMAMENT_BASE_RESOURCE_ID_INTERNER_H
+
+#include <boost/thread/shared_mutex.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+
+namespace firmament {
+
+// Each Intern call takes a reference on the resource's index, and each
+// Release drops one. An index stays valid, and keeps referring to the same
+// resource, until all references to it have been released. Released indices
+// are handed out again, so that arrays indexed by dense ID stay as large as
+// the peak number of live resources rather than growing with every resource
+// ever seen. Anyone keeping state in such an array must hold a reference for
+// as long as the state exists.
+class ResourceIDInterner {
+ public:
+  static const DenseResourceID_t kInvalidDenseResourceID;
+
+  /**
+   * Returns the dense index for a resource ID, allocating one if the ID has
+   * not been seen before, and takes a reference on it.
+   * @param res_id the resource ID to intern
+   * @return the dense index of the resource
+   */
+  DenseResourceID_t Intern(const ResourceID_t& res_id);
+
+  /**
+   * Like Intern, but takes the resource ID in its string form.
+   * @param res_id_str the string representation of the resource ID
+   * @return the dense index of the resource
+   */
+  DenseResourceID_t InternString(const string& res_id_str);
+
+  /**
+   * Looks up the dense index of a resource ID without allocating one.
+   * @param res_id the resource ID to look up
+   * @return the dense index, or kInvalidDenseResourceID if the ID has not
+   * been interned
+   */
+  DenseResourceID_t Lookup(const ResourceID_t& res_id) const;
+
+  /**
+   * Drops a reference on a resource ID. Once the last reference is dropped,
+   * the ID is forgotten and its dense index becomes available for reuse.
+   * Does nothing if the ID has not been interned.
+   * @param res_id the resource ID to release
+   */
+  void Release(const ResourceID_t& res_id);
+
+  /**
+   * Like Release, but takes the dense index of the resource.
+   * @param dense_id a dense index previously returned by Intern, and not
+   * released since
+   */
+  void ReleaseDenseID(DenseResourceID_t dense_id);
+
+  /**
+   * @param dense_id a dense index previously returned by Intern, and not
+   * released since
+   * @return the resource ID that the index was allocated for
+   */
+  ResourceID_t ResourceIDForDenseID(DenseResourceID_t dense_id) const;
+
+  /**
+   * @return the number of dense indices allocated so far, including released
+   * ones. All dense indices are smaller than this.
+   */
+  size_t size() const;
+
+ private:
+  mutable boost::shared_mutex lock_;
+  unordered_map<ResourceID_t, DenseResourceID_t,
+    boost::hash<ResourceID_t>> dense_ids_;
+  // Indexed by dense ID. A deque does not move its elements when it grows.
+  deque<ResourceID_t> res_ids_;
+  // The number of references on each dense ID; indexed by dense ID.
+  deque<uint32_t> ref_counts_;
+  // Released dense IDs, reused most recently released first.
+  vector<DenseResourceID_t> free_ids_;
+};
+
+/**
+ * @return the process-wide resource ID interner
+ */
+ResourceIDInterner* ResourceIDs();
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_BASE_RESOURCE_ID_INTERNER_H
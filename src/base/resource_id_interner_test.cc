@@ -0,0 +1,133 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Resource ID interner unit tests.
+
+#include <gtest/gtest.h>
+
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+#include <string>
+
+#include "base/common.h"
+#include "base/resource_desc.pb.h"
+#include "base/resource_id_interner.h"
+#include "base/resource_status.h"
+#include "base/resource_topology_node_desc.pb.h"
+
+namespace firmament {
+
+class ResourceIDInternerTest : public ::testing::Test {
+ protected:
+  boost::uuids::random_generator gen_;
+};
+
+// Tests that interning is idempotent and hands out dense indices.
+TEST_F(ResourceIDInternerTest, InternIsDenseAndStable) {
+  ResourceIDInterner interner;
+  ResourceID_t res_id1 = gen_();
+  ResourceID_t res_id2 = gen_();
+  EXPECT_EQ(interner.Lookup(res_id1),
+            ResourceIDInterner::kInvalidDenseResourceID);
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+  EXPECT_EQ(interner.Intern(res_id2), 1);
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+  EXPECT_EQ(interner.InternString(boost::uuids::to_string(res_id2)), 1);
+  EXPECT_EQ(interner.Lookup(res_id2), 1);
+  EXPECT_EQ(interner.ResourceIDForDenseID(0), res_id1);
+  EXPECT_EQ(interner.ResourceIDForDenseID(1), res_id2);
+  EXPECT_EQ(interner.size(), 2);
+}
+
+// Tests that released dense indices are handed out again.
+TEST_F(ResourceIDInternerTest, ReleaseReusesDenseIDs) {
+  ResourceIDInterner interner;
+  ResourceID_t res_id1 = gen_();
+  ResourceID_t res_id2 = gen_();
+  ResourceID_t res_id3 = gen_();
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+  EXPECT_EQ(interner.Intern(res_id2), 1);
+  interner.Release(res_id1);
+  EXPECT_EQ(interner.Lookup(res_id1),
+            ResourceIDInterner::kInvalidDenseResourceID);
+  // Releasing an unknown ID is a no-op.
+  interner.Release(res_id1);
+  EXPECT_EQ(interner.Intern(res_id3), 0);
+  EXPECT_EQ(interner.ResourceIDForDenseID(0), res_id3);
+  EXPECT_EQ(interner.Lookup(res_id2), 1);
+  EXPECT_EQ(interner.Intern(res_id1), 2);
+  EXPECT_EQ(interner.size(), 3);
+}
+
+// Tests that a dense index is not reused while any holder still has a
+// reference on it.
+TEST_F(ResourceIDInternerTest, ReleaseDropsOneReference) {
+  ResourceIDInterner interner;
+  ResourceID_t res_id1 = gen_();
+  ResourceID_t res_id2 = gen_();
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+  interner.Release(res_id1);
+  EXPECT_EQ(interner.Lookup(res_id1), 0);
+  EXPECT_EQ(interner.Intern(res_id2), 1);
+  interner.ReleaseDenseID(0);
+  EXPECT_EQ(interner.Lookup(res_id1),
+            ResourceIDInterner::kInvalidDenseResourceID);
+  EXPECT_EQ(interner.Intern(res_id1), 0);
+}
+
+// Tests that resource statuses carry the dense ID of their resource.
+TEST_F(ResourceIDInternerTest, ResourceStatusDenseID) {
+  ResourceTopologyNodeDescriptor rtnd;
+  ResourceDescriptor* rd_ptr = rtnd.mutable_resource_desc();
+  ResourceID_t res_id = gen_();
+  rd_ptr->set_uuid(boost::uuids::to_string(res_id));
+  ResourceStatus rs(rd_ptr, &rtnd, "endpoint_uri", 0);
+  EXPECT_EQ(rs.dense_id(), ResourceIDs()->Lookup(res_id));
+  EXPECT_EQ(ResourceIDs()->ResourceIDForDenseID(rs.dense_id()), res_id);
+  EXPECT_EQ(rs.machine_dense_id(),
+            ResourceIDInterner::kInvalidDenseResourceID);
+}
+
+// Tests that a resource status holds a reference on its dense ID for as long
+// as it exists.
+TEST_F(ResourceIDInternerTest, ResourceStatusHoldsReference) {
+  ResourceTopologyNodeDescriptor rtnd;
+  ResourceDescriptor* rd_ptr = rtnd.mutable_resource_desc();
+  ResourceID_t res_id = gen_();
+  rd_ptr->set_uuid(boost::uuids::to_string(res_id));
+  DenseResourceID_t dense_id = ResourceIDs()->Intern(res_id);
+  {
+    ResourceStatus rs(rd_ptr, &rtnd, "endpoint_uri", 0);
+    EXPECT_EQ(rs.dense_id(), dense_id);
+    ResourceIDs()->Release(res_id);
+    EXPECT_EQ(ResourceIDs()->Lookup(res_id), dense_id);
+  }
+  EXPECT_EQ(ResourceIDs()->Lookup(res_id),
+            ResourceIDInterner::kInvalidDenseResourceID);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
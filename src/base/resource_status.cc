@@ -25,6 +25,8 @@
 
 #include "base/resource_status.h"
 
+#include "base/resource_id_interner.h"
+
 namespace firmament {
 
 ResourceStatus::ResourceStatus(ResourceDescriptor* descr,
@@ -34,7 +36,31 @@ ResourceStatus::ResourceStatus(ResourceDescriptor* descr,
     : descriptor_(descr),
       topology_node_(rtnd),
       endpoint_uri_(endpoint_uri),
-      last_heartbeat_(last_heartbeat) {
+      last_heartbeat_(last_heartbeat),
+      dense_id_(ResourceIDInterner::kInvalidDenseResourceID),
+      machine_dense_id_(ResourceIDInterner::kInvalidDenseResourceID) {
+  if (!descr->uuid().empty()) {
+    dense_id_ = ResourceIDs()->InternString(descr->uuid());
+  }
+}
+
+ResourceStatus::~ResourceStatus() {
+  if (dense_id_ != ResourceIDInterner::kInvalidDenseResourceID) {
+    ResourceIDs()->ReleaseDenseID(dense_id_);
+  }
+  uint32_t machine_dense_id = machine_dense_id_.load();
+  if (machine_dense_id != ResourceIDInterner::kInvalidDenseResourceID) {
+    ResourceIDs()->ReleaseDenseID(machine_dense_id);
+  }
+}
+
+void ResourceStatus::set_machine_dense_id(uint32_t machine_dense_id) {
+  uint32_t unset = ResourceIDInterner::kInvalidDenseResourceID;
+  // Another thread may have cached the machine first, in which case the
+  // caller's reference is not needed.
+  if (!machine_dense_id_.compare_exchange_strong(unset, machine_dense_id)) {
+    ResourceIDs()->ReleaseDenseID(machine_dense_id);
+  }
 }
 
 }  // namespace firmament
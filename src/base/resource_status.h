@@ -23,6 +23,7 @@
 #ifndef FIRMAMENT_BASE_RESOURCE_STATUS_H
 #define FIRMAMENT_BASE_RESOURCE_STATUS_H
 
+#include <atomic>
 #include <string>
 
 #include "base/common.h"
@@ -37,22 +38,44 @@ class ResourceStatus {
                  ResourceTopologyNodeDescriptor* rtnd,
                  const string& endpoint_uri,
                  uint64_t last_heartbeat);
+  ~ResourceStatus();
   inline ResourceDescriptor* mutable_descriptor() { return descriptor_; }
   inline const ResourceDescriptor& descriptor() { return *descriptor_; }
   inline const string& location() { return endpoint_uri_; }
-  inline uint64_t last_heartbeat() { return last_heartbeat_; }
-  inline void set_last_heartbeat(uint64_t hb) { last_heartbeat_ = hb; }
+  // Heartbeats are recorded concurrently with readers of the timestamp.
+  inline uint64_t last_heartbeat() {
+    return last_heartbeat_.load(std::memory_order_relaxed);
+  }
+  inline void set_last_heartbeat(uint64_t hb) {
+    last_heartbeat_.store(hb, std::memory_order_relaxed);
+  }
   inline ResourceTopologyNodeDescriptor* mutable_topology_node() {
     return topology_node_;
   }
   inline const ResourceTopologyNodeDescriptor& topology_node() {
     return *topology_node_;
   }
+  // The resource's index in the process-wide ResourceIDInterner, on which
+  // the status holds a reference.
+  inline uint32_t dense_id() const { return dense_id_; }
+  // The dense index of the machine that contains this resource, or the
+  // interner's invalid index if it has not been computed yet.
+  inline uint32_t machine_dense_id() const {
+    return machine_dense_id_.load(std::memory_order_relaxed);
+  }
+  /**
+   * Caches the dense index of the machine that contains this resource.
+   * @param machine_dense_id the machine's dense index, with a reference that
+   * the status takes over
+   */
+  void set_machine_dense_id(uint32_t machine_dense_id);
  protected:
   ResourceDescriptor* descriptor_;
   ResourceTopologyNodeDescriptor* topology_node_;
   string endpoint_uri_;
-  uint64_t last_heartbeat_;
+  std::atomic<uint64_t> last_heartbeat_;
+  uint32_t dense_id_;
+  std::atomic<uint32_t> machine_dense_id_;
 };
 
 }  // namespace firmament
@@ -0,0 +1,35 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Striped locks guarding the heartbeat fields of task descriptors.
+
+#include "base/task_heartbeat_lock.h"
+
+namespace firmament {
+
+// Power of two, so that picking a stripe is a mask.
+static const uint64_t kNumTaskHeartbeatLocks = 64;
+
+boost::mutex* TaskHeartbeatLock(TaskID_t task_id) {
+  static boost::mutex locks[kNumTaskHeartbeatLocks];
+  return &locks[task_id & (kNumTaskHeartbeatLocks - 1)];
+}
+
+}  // namespace firmament
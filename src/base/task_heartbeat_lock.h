@@ -0,0 +1,44 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Striped locks guarding the heartbeat fields of task descriptors.
+
+#ifndef FIRMAMENT_BASE_TASK_HEARTBEAT_LOCK_H
+#define FIRMAMENT_BASE_TASK_HEARTBEAT_LOCK_H
+
+#include <boost/thread/mutex.hpp>
+
+#include "base/types.h"
+
+namespace firmament {
+
+/**
+ * Task heartbeats are recorded concurrently with other message handlers, the
+ * health monitor and the scheduler, all of which may read the heartbeat
+ * fields (last_heartbeat_time and last_heartbeat_location) of the same task
+ * descriptor. Hold the returned lock whenever reading or writing them.
+ * @param task_id the ID of the task whose heartbeat fields are accessed
+ * @return the lock guarding the task's heartbeat fields; tasks share locks
+ */
+boost::mutex* TaskHeartbeatLock(TaskID_t task_id);
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_BASE_TASK_HEARTBEAT_LOCK_H
@@ -41,6 +41,7 @@
 #include <thread_safe_deque.h>
 
 #include "base/resource_status.h"
+#include "misc/sharded_map.h"
 #include "base/resource_desc.pb.h"
 #include "base/job_desc.pb.h"
 
@@ -115,6 +116,8 @@ namespace firmament {
 typedef uint32_t TaskOutputID_t;
 typedef uint64_t TaskID_t;
 typedef uint64_t EquivClass_t;
+// Dense per-process index of a resource; see base/resource_id_interner.h.
+typedef uint32_t DenseResourceID_t;
 #ifdef __PLATFORM_HAS_BOOST__
 typedef boost::uuids::uuid ResourceID_t;
 typedef boost::uuids::uuid JobID_t;
@@ -122,8 +125,8 @@ typedef boost::uuids::uuid JobID_t;
         boost::hash<boost::uuids::uuid> > ResourceMap_t;
 typedef unordered_map<JobID_t, JobDescriptor,
         boost::hash<boost::uuids::uuid> > JobMap_t; */
-typedef thread_safe::map<ResourceID_t, ResourceStatus*> ResourceMap_t;
-typedef thread_safe::map<JobID_t, JobDescriptor> JobMap_t;
+typedef ShardedMap<ResourceID_t, ResourceStatus*> ResourceMap_t;
+typedef ShardedMap<JobID_t, JobDescriptor> JobMap_t;
 #else
 typedef uint64_t ResourceID_t;
 typedef uint64_t JobID_t;
@@ -134,7 +137,7 @@ typedef unordered_map<JobID_t, JobDescriptor> JobMap_t;
 // TaskDescriptor objects will be part of the JobDescriptor protobuf that is
 // already held in the job table.
 //typedef unordered_map<TaskID_t, TaskDescriptor*> TaskMap_t;
-typedef thread_safe::map<TaskID_t, TaskDescriptor*> TaskMap_t;
+typedef ShardedMap<TaskID_t, TaskDescriptor*> TaskMap_t;
 
 #ifdef __PLATFORM_HAS_BOOST__
 // Message handler callback type definition
@@ -28,6 +28,7 @@
 #include <utility>
 
 #ifdef __PLATFORM_HAS_BOOST__
+#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #endif
@@ -37,6 +38,7 @@
 #include "base/resource_desc.pb.h"
 #include "base/resource_topology_node_desc.pb.h"
 #include "base/task_final_report.pb.h"
+#include "base/task_heartbeat_lock.h"
 #include "engine/health_monitor.h"
 #include "messages/base_message.pb.h"
 #include "misc/map-util.h"
@@ -47,7 +49,7 @@
 #include "scheduling/knowledge_base.h"
 #include "scheduling/simple/simple_scheduler.h"
 #include "scheduling/fulcrum_c/fulcrum_c_scheduler.h"
-#include "storage/simple_object_store.h"
+#include "storage/shm_object_store.h"
 
 #ifdef ENABLE_HDFS
 #include "storage/hdfs_data_locality_manager.h"
@@ -55,8 +57,13 @@
 
 // It is necessary to declare listen_uri here, since "node.o" comes after
 // "coordinator.o" in linking order (I *think*).
+DECLARE_bool(aggregate_task_heartbeats);
 DECLARE_uint64(heartbeat_interval);
 DECLARE_string(listen_uri);
+DECLARE_bool(object_transfer_server);
+DECLARE_uint64(object_transfer_port);
+DECLARE_bool(stream_sockets_batching);
+DECLARE_uint64(stream_sockets_io_threads);
 DEFINE_string(parent_uri, "", "The URI of the parent coordinator to register "
         "with.");
 DEFINE_bool(include_local_resources, true, "Add local machine's resources; "
@@ -70,6 +77,20 @@ DEFINE_int32(http_ui_port, 8080,
 #endif
 DEFINE_bool(populate_knowledge_base_from_file, false,
             "True if we should load the knowledge base from file.");
+DEFINE_bool(delta_heartbeats, true,
+            "Send heartbeats to the parent coordinator as deltas against the "
+            "last acknowledged heartbeat.");
+DEFINE_int32(coordinator_dispatch_threads, 0,
+             "Number of threads on which incoming messages are handled; 0 "
+             "handles them inline on the messaging thread, and requires "
+             "stream_sockets_io_threads to be 1.");
+DEFINE_uint64(parent_flush_interval, 10000,
+              "With --stream_sockets_batching, the interval, in "
+              "microseconds, at which heartbeats queued for the parent "
+              "coordinator are written out.");
+DEFINE_int32(coordinator_dispatch_lanes, 64,
+             "Number of ordered lanes onto which resource and task heartbeats "
+             "are hashed when coordinator_dispatch_threads > 0.");
 
 namespace firmament {
 
@@ -81,7 +102,9 @@ Coordinator::Coordinator()
     job_table_(new JobMap_t),
     task_table_(new TaskMap_t),
     topology_manager_(new TopologyManager()),
-    object_store_(new store::SimpleObjectStore(uuid_)),
+    shm_object_store_(new store::ShmObjectStore(uuid_)),
+    object_store_(shm_object_store_),
+    object_transfer_server_(new store::ObjectTransferServer(uuid_)),
     parent_chan_(NULL),
     hostname_(boost::asio::ip::host_name()),
     time_manager_(new WallTime) {
@@ -91,7 +114,13 @@ Coordinator::Coordinator()
   resource_desc_.set_uuid(to_string(uuid_));
   resource_desc_.set_friendly_name(desc_name);
   resource_desc_.set_type(ResourceDescriptor::RESOURCE_COORDINATOR);
-  //resource_desc_.set_storage_engine(object_store_->get_listening_interface());
+  if (!FLAGS_object_transfer_server) {
+    VLOG(1) << "Not serving objects on this machine to others.";
+  } else if (object_transfer_server_->Start(FLAGS_object_transfer_port)) {
+    resource_desc_.set_storage_engine(object_transfer_server_->endpoint());
+  } else {
+    LOG(ERROR) << "Objects on this machine cannot be fetched by others!";
+  }
   local_resource_topology_->mutable_resource_desc()->CopyFrom(
       resource_desc_);
 
@@ -142,17 +171,58 @@ Coordinator::Coordinator()
   LOG(INFO) << "Coordinator starting on host " << FLAGS_listen_uri
             << ", UUID " << uuid_;
 
-  // Start health monitor thread (won't have much to do initially)
+  // Start health monitor thread (won't have much to do initially). Failed
+  // task processes are handled as soon as they are reaped, rather than at
+  // the next periodic check.
+  scheduler_->SetFailedTaskProcessExitNotifier(
+      boost::bind(&HealthMonitor::Wake, &health_monitor_));
   health_monitor_thread_ =
-    new boost::thread(boost::bind(&HealthMonitor::Run, health_monitor_,
+    new boost::thread(boost::bind(&HealthMonitor::Run, &health_monitor_,
                                   scheduler_, associated_resources_));
 
   if (FLAGS_populate_knowledge_base_from_file) {
     scheduler_->knowledge_base()->LoadKnowledgeBaseFromFile();
   }
+
+  // Messages handled inline would race with each other if receipt
+  // callbacks ran on several IO threads.
+  CHECK(FLAGS_stream_sockets_io_threads <= 1 ||
+        FLAGS_coordinator_dispatch_threads > 0)
+    << "--stream_sockets_io_threads > 1 requires "
+    << "--coordinator_dispatch_threads > 0";
+  if (FLAGS_coordinator_dispatch_threads > 0) {
+    VLOG(1) << "Handling incoming messages on "
+            << FLAGS_coordinator_dispatch_threads << " dispatch threads.";
+    message_executor_.reset(
+        new WorkStealingExecutor(FLAGS_coordinator_dispatch_threads));
+    message_dispatcher_.reset(
+        new KeyedDispatcher(message_executor_.get(),
+                            FLAGS_coordinator_dispatch_lanes));
+  }
+
+  if (FLAGS_aggregate_task_heartbeats) {
+    task_heartbeat_aggregator_.reset(new executor::TaskHeartbeatAggregator(
+        executor::TaskHeartbeatAggregator::SocketPathForCoordinator(
+            FLAGS_listen_uri),
+        FLAGS_heartbeat_interval,
+        boost::bind(&Coordinator::QueueTaskHeartbeatBatch, this, _1),
+        boost::bind(&Coordinator::QueueTaskStateChange, this, _1)));
+    if (!task_heartbeat_aggregator_->Start()) {
+      LOG(ERROR) << "Local tasks will send heartbeats over their connection "
+                 << "to the coordinator.";
+      task_heartbeat_aggregator_.reset();
+    }
+  }
 }
 
 Coordinator::~Coordinator() {
+  // Hand over the last batch of task heartbeats before messages are drained.
+  if (task_heartbeat_aggregator_)
+    task_heartbeat_aggregator_->Stop();
+  // Finish handling any outstanding messages before tearing down state.
+  if (message_executor_)
+    message_executor_->Shutdown();
+  object_transfer_server_->Stop();
   delete trace_generator_;
   delete time_manager_;
   // TODO(malte): check destruction order in C++; c_http_ui_ may already
@@ -173,6 +243,10 @@ bool Coordinator::RegisterWithCoordinator(
   rtnd->CopyFrom(*local_resource_topology_);
   SUBMSG_WRITE(bm, registration, uuid, to_string(uuid_));
   SUBMSG_WRITE(bm, registration, location, chan->LocalEndpointString());
+  // A (re-)registering coordinator has no heartbeat base at the parent any
+  // more, so the next heartbeat must be sent in full.
+  if (parent_heartbeat_encoder_)
+    parent_heartbeat_encoder_->Reset();
   // wrap in envelope
   VLOG(2) << "Sending registration message...";
   // send heartbeat message
@@ -219,6 +293,8 @@ void Coordinator::AddResource(ResourceTopologyNodeDescriptor* rtnd,
     // Store the machine UUID (different from the coordinator resource UUID,
     // which is stored in uuid_).
     machine_uuid_ = ResourceIDFromString(resource_desc->uuid());
+    // Schedulers look up where to fetch the machine's objects from here.
+    resource_desc->set_storage_engine(resource_desc_.storage_engine());
     // Figure out the machine's resource capacity.
     ResourceVector* cap = resource_desc->mutable_resource_capacity();
     machine_monitor_.GetMachineCapacity(cap);
@@ -262,10 +338,15 @@ void Coordinator::Run() {
             << parent_chan_->RemoteEndpointString();
     RegisterWithCoordinator(parent_chan_);
     parent_uri_ = FLAGS_parent_uri;
+    if (FLAGS_delta_heartbeats) {
+      parent_heartbeat_encoder_.reset(
+          new HeartbeatDeltaEncoder(to_string(uuid_)));
+    }
   }
 
   uint64_t cur_time = 0;
   uint64_t last_heartbeat_time = 0;
+  uint64_t last_parent_flush_time = 0;
   // Main loop
   while (!exit_) {
     // Wait for events (i.e. messages from workers.
@@ -287,6 +368,13 @@ void Coordinator::Run() {
       }
       last_heartbeat_time = cur_time;
     }
+    // Heartbeats for the parent are queued on its channel (with batching),
+    // and go out together here, or earlier if the queue fills up.
+    if (parent_chan_ != NULL && FLAGS_stream_sockets_batching &&
+        cur_time - last_parent_flush_time >= FLAGS_parent_flush_interval) {
+      FlushParentChannel();
+      last_parent_flush_time = cur_time;
+    }
   }
 
   // We have dropped out of the main loop and are exiting
@@ -329,8 +417,65 @@ bool Coordinator::HasJobCompleted(const JobDescriptor& jd) {
   return true;
 }
 
+void Coordinator::DispatchIncomingMessage(shared_ptr<BaseMessage> bm,
+                                          const string& remote_endpoint) {
+  ProcessIncomingMessage(bm.get(), remote_endpoint);
+}
+
 void Coordinator::HandleIncomingMessage(BaseMessage *bm,
                                         const string& remote_endpoint) {
+  if (!message_dispatcher_) {
+    ProcessIncomingMessage(bm, remote_endpoint);
+    return;
+  }
+  // The messaging adapter reuses the message once we return, so take over its
+  // contents.
+  shared_ptr<BaseMessage> msg(new BaseMessage);
+  msg->Swap(bm);
+  // Resource and task heartbeats only touch state of their own resource or
+  // task, so they are ordered per resource or task and otherwise run in
+  // parallel with each other. Everything else may change scheduler state, and
+  // runs on the sequenced lane, in arrival order. The heartbeat fields of
+  // task and resource descriptors, which both lanes access, are synchronized
+  // per descriptor (see TaskHeartbeatLock() and ResourceStatus).
+  vector<const google::protobuf::FieldDescriptor*> fields;
+  msg->GetReflection()->ListFields(*msg, &fields);
+  if (fields.size() == 1 && msg->has_heartbeat()) {
+    message_dispatcher_->Dispatch(
+        boost::hash<string>()(msg->heartbeat().uuid()),
+        boost::bind(&Coordinator::DispatchIncomingMessage, this, msg,
+                    remote_endpoint));
+  } else if (fields.size() == 1 && msg->has_task_heartbeat()) {
+    message_dispatcher_->Dispatch(
+        msg->task_heartbeat().task_id(),
+        boost::bind(&Coordinator::DispatchIncomingMessage, this, msg,
+                    remote_endpoint));
+  } else if (fields.size() == 1 && msg->has_task_heartbeat_batch()) {
+    // Each heartbeat in a batch goes to the lane of its task, as it would
+    // have done had it been sent on its own.
+    const TaskHeartbeatBatchMessage& batch = msg->task_heartbeat_batch();
+    VLOG(1) << "HEARTBEAT batch of " << batch.heartbeats_size() << " tasks";
+    for (int32_t i = 0; i < batch.heartbeats_size(); ++i) {
+      message_dispatcher_->Dispatch(
+          batch.heartbeats(i).task_id(),
+          boost::bind(&Coordinator::RecordBatchedTaskHeartbeat, this, msg,
+                      i));
+    }
+    if (parent_chan_ != NULL && batch.heartbeats_size() > 0) {
+      message_dispatcher_->Dispatch(
+          batch.heartbeats(0).task_id(),
+          boost::bind(&Coordinator::ForwardBatchedTaskHeartbeats, this,
+                      msg));
+    }
+  } else {
+    message_dispatcher_->DispatchSequenced(
+        boost::bind(&Coordinator::DispatchIncomingMessage, this, msg,
+                    remote_endpoint));
+  }
+}
+
+void Coordinator::ProcessIncomingMessage(BaseMessage* bm,
+                                         const string& remote_endpoint) {
   uint32_t handled_extensions = 0;
   // Registration message
   if (bm->has_registration()) {
@@ -341,7 +486,13 @@ void Coordinator::HandleIncomingMessage(BaseMessage *bm,
   // Resource Heartbeat message
   if (bm->has_heartbeat()) {
     const HeartbeatMessage& msg = bm->heartbeat();
-    HandleHeartbeat(msg);
+    HandleHeartbeat(msg, remote_endpoint);
+    handled_extensions++;
+  }
+  // Resource heartbeat acknowledgement (from parent coordinator)
+  if (bm->has_heartbeat_ack()) {
+    const HeartbeatAckMessage& msg = bm->heartbeat_ack();
+    HandleHeartbeatAck(msg);
     handled_extensions++;
   }
   // Task heartbeat message
@@ -350,6 +501,13 @@ void Coordinator::HandleIncomingMessage(BaseMessage *bm,
     HandleTaskHeartbeat(msg);
     handled_extensions++;
   }
+  // Batch of task heartbeats (from a subordinate coordinator or our own
+  // aggregator)
+  if (bm->has_task_heartbeat_batch()) {
+    const TaskHeartbeatBatchMessage& msg = bm->task_heartbeat_batch();
+    HandleTaskHeartbeatBatch(msg);
+    handled_extensions++;
+  }
   // Task state change message
   if (bm->has_task_state()) {
     const TaskStateMessage& msg = bm->task_state();
@@ -380,6 +538,18 @@ void Coordinator::HandleIncomingMessage(BaseMessage *bm,
     HandleTaskDelegationResponse(msg, remote_endpoint);
     handled_extensions++;
   }
+  // Object publication message
+  if (bm->has_object_publish()) {
+    const ObjectPublishMessage& msg = bm->object_publish();
+    HandleObjectPublish(msg);
+    handled_extensions++;
+  }
+  // Job completion message (at delegatee coordinator)
+  if (bm->has_job_completion()) {
+    const JobCompletionMessage& msg = bm->job_completion();
+    HandleJobCompletion(msg);
+    handled_extensions++;
+  }
   // Task kill message
   if (bm->has_task_kill()) {
     const TaskKillMessage& msg = bm->task_kill();
@@ -404,6 +574,64 @@ void Coordinator::HandleIncomingMessage(BaseMessage *bm,
                << "so cannot handle it: " << bm->DebugString();
 }
 
+bool Coordinator::QueueAggregatedMessage(shared_ptr<BaseMessage> bm) {
+  // Called on the aggregator thread. With dispatch threads, the message goes
+  // to the message dispatcher like any other incoming message; otherwise it
+  // is handled on the messaging thread, so that it does not race with the
+  // messages handled inline there.
+  if (message_dispatcher_) {
+    HandleIncomingMessage(bm.get(), "");
+    return true;
+  }
+  return m_adapter_->PostToMessagingThread(
+      boost::bind(&Coordinator::DispatchIncomingMessage, this, bm, string()));
+}
+
+void Coordinator::QueueTaskHeartbeatBatch(
+    const TaskHeartbeatBatchMessage& batch) {
+  shared_ptr<BaseMessage> bm(new BaseMessage);
+  bm->mutable_task_heartbeat_batch()->CopyFrom(batch);
+  if (!QueueAggregatedMessage(bm)) {
+    VLOG(1) << "Dropped heartbeat batch of " << batch.heartbeats_size()
+            << " tasks: not listening for messages yet";
+  }
+}
+
+void Coordinator::QueueTaskStateChange(const TaskStateMessage& msg) {
+  shared_ptr<BaseMessage> bm(new BaseMessage);
+  bm->mutable_task_state()->CopyFrom(msg);
+  if (!QueueAggregatedMessage(bm)) {
+    LOG(ERROR) << "Dropped state change of task " << msg.id()
+               << ": not listening for messages yet";
+  }
+}
+
+void Coordinator::RecordBatchedTaskHeartbeat(shared_ptr<BaseMessage> bm,
+                                             int32_t index) {
+  RecordTaskHeartbeat(bm->task_heartbeat_batch().heartbeats(index));
+}
+
+void Coordinator::RecordTaskHeartbeat(const TaskHeartbeatMessage& msg) {
+  TaskID_t task_id = msg.task_id();
+  TaskDescriptor* tdp = NULL;
+  if (!task_table_->Lookup(task_id, &tdp)) {
+    LOG(WARNING) << "HEARTBEAT from UNKNOWN task (ID: "
+                 << task_id << ")!";
+  } else {
+    VLOG(1) << "HEARTBEAT from task " << task_id;
+    {
+      boost::lock_guard<boost::mutex> lock(*TaskHeartbeatLock(task_id));
+      // Remember the current location from which this task reports
+      tdp->set_last_heartbeat_location(msg.location());
+      // Remember the heartbeat time
+      tdp->set_last_heartbeat_time(time_manager_->GetCurrentTimestamp());
+    }
+    // Process the profiling information submitted by the task, add it to
+    // the knowledge base
+    scheduler_->knowledge_base()->AddTaskStatsSample(msg.stats());
+  }
+}
+
 void Coordinator::HandleIncomingReceiveError(
     const boost::system::error_code& error,
     const string& remote_endpoint) {
@@ -420,24 +648,158 @@ void Coordinator::HandleIncomingReceiveError(
                  << "connection failed (error: " << error.message() << ", "
                  << "code " << error.value() << ").";
   }
+  // Either way, the channel has been dropped.
+  DropHeartbeatStateForEndpoint(remote_endpoint);
 }
 
-void Coordinator::HandleHeartbeat(const HeartbeatMessage& msg) {
+void Coordinator::DropHeartbeatStateForEndpoint(
+    const string& remote_endpoint) {
+  if (remote_endpoint.empty())
+    return;
+  // Delta heartbeats are only meaningful on the connection on which their
+  // bases were acknowledged; a reconnecting sender starts with a full
+  // heartbeat, so the state kept for the old connection is dead weight.
+  if (parent_chan_ != NULL && parent_heartbeat_encoder_ &&
+      parent_chan_->RemoteEndpointString() == remote_endpoint) {
+    VLOG(1) << "Dropping delta heartbeat state for parent coordinator";
+    parent_heartbeat_encoder_->Reset();
+    return;
+  }
+  // The resource map locks each of its shards while we walk it, so resources
+  // registering concurrently are safe to miss: they have no state yet.
+  for (ResourceMap_t::const_iterator it = associated_resources_->begin();
+       it != associated_resources_->end();
+       ++it) {
+    if (it->second->location() == remote_endpoint)
+      heartbeat_decoder_.RemoveResource(to_string(it->first));
+  }
+}
+
+void Coordinator::HandleHeartbeat(const HeartbeatMessage& msg,
+                                  const string& remote_endpoint) {
   boost::uuids::string_generator gen;
   boost::uuids::uuid uuid = gen(msg.uuid());
-  ResourceStatus* rsp = FindPtrOrNull(*associated_resources_, uuid);
-  if (!rsp) {
+  ResourceStatus* rsp = NULL;
+  if (!associated_resources_->Lookup(uuid, &rsp)) {
       LOG(WARNING) << "HEARTBEAT from UNKNOWN resource (uuid: "
               << msg.uuid() << ")!";
   } else {
       VLOG(1) << "HEARTBEAT from resource " << msg.uuid()
               << " (last seen at " << rsp->last_heartbeat() << ")";
-      if (msg.has_load())
-        VLOG(2) << "Remote resource stats: " << msg.load().ShortDebugString();
       // Update timestamp
       rsp->set_last_heartbeat(time_manager_->GetCurrentTimestamp());
-      // Record resource statistics sample
-      scheduler_->knowledge_base()->AddMachineSample(msg.load());
+      // Reconstruct the full heartbeat if it is delta-encoded, and
+      // acknowledge it.
+      HeartbeatMessage state;
+      BaseMessage ack_bm;
+      bool applied = heartbeat_decoder_.DecodeHeartbeat(
+          msg, &state, ack_bm.mutable_heartbeat_ack());
+      if (msg.seq() != 0 &&
+          !m_adapter_->SendMessageToEndpoint(remote_endpoint, ack_bm)) {
+        LOG(WARNING) << "Failed to acknowledge heartbeat from resource "
+                     << msg.uuid();
+      }
+      if (!applied)
+        return;
+      if (state.has_load()) {
+        VLOG(2) << "Remote resource stats: " << state.load().ShortDebugString();
+        // Record resource statistics sample
+        scheduler_->knowledge_base()->AddMachineSample(state.load());
+      }
+  }
+}
+
+void Coordinator::HandleHeartbeatAck(const HeartbeatAckMessage& msg) {
+  if (!parent_heartbeat_encoder_) {
+    LOG(WARNING) << "Received heartbeat acknowledgement, but we do not send "
+                 << "delta heartbeats. Ignoring.";
+    return;
+  }
+  parent_heartbeat_encoder_->HandleAck(msg);
+}
+
+void Coordinator::HandleJobCompletion(const JobCompletionMessage& msg) {
+  // Sent by the coordinator that delegated tasks of the job to us. Their
+  // published outputs are no longer needed.
+  VLOG(1) << "Job " << msg.job_id() << " has completed; unpinning its "
+          << "objects";
+  UnpinJobObjects(JobIDFromString(msg.job_id()));
+}
+
+void Coordinator::HandleObjectPublish(const ObjectPublishMessage& msg) {
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_table_, msg.task_id());
+  if (!td_ptr) {
+    LOG(WARNING) << "Received object publication from unknown task "
+                 << msg.task_id();
+    return;
+  }
+  BaseMessage bm;
+  bm.mutable_object_publish()->CopyFrom(msg);
+  bool unblocked = false;
+  for (auto& rd : *bm.mutable_object_publish()->mutable_references()) {
+    DataObjectID_t id(DataObjectIDFromProtobuf(rd.id()));
+    if (rd.location().empty()) {
+      // The object sits in the shared memory store of the machine that ran
+      // the task; only the coordinator managing that machine can name it.
+      ResourceID_t res_id =
+        ResourceIDFromString(td_ptr->scheduled_to_resource());
+      if (!GetResourceStatus(res_id)) {
+        LOG(ERROR) << "Task " << td_ptr->uid() << " published object " << id
+                   << ", but does not run on a local resource!";
+        continue;
+      }
+      rd.set_location(store::ShmObjectStore::LocationForObject(
+          MachineResIDForResource(associated_resources_, res_id), id));
+      if (shm_object_store_->PinObject(id)) {
+        boost::lock_guard<boost::mutex> lock(pinned_objects_lock_);
+        pinned_objects_[JobIDFromString(td_ptr->job_id())].push_back(id);
+      } else {
+        LOG(WARNING) << "Failed to pin object " << id << " published by "
+                     << "task " << td_ptr->uid() << "; it may be evicted "
+                     << "before its consumers run";
+      }
+    }
+    VLOG(1) << "Task " << td_ptr->uid() << " published object " << id
+            << " at " << rd.location();
+    // Replace the future references to the object with a concrete one, and
+    // let the scheduler unblock any tasks waiting for it.
+    vector<ReferenceInterface*> old_refs;
+    bool already_known = false;
+    unordered_set<ReferenceInterface*>* refs =
+      object_store_->GetReferences(id);
+    if (refs) {
+      for (auto it = refs->begin(); it != refs->end();) {
+        ReferenceDescriptor existing = (*it)->desc();
+        if (existing.type() == ReferenceDescriptor::FUTURE) {
+          old_refs.push_back(*it);
+          it = refs->erase(it);
+        } else {
+          if (existing.type() == ReferenceDescriptor::CONCRETE &&
+              existing.location() == rd.location())
+            already_known = true;
+          ++it;
+        }
+      }
+    }
+    if (!already_known)
+      object_store_->AddReference(id, &rd);
+    ConcreteReference new_ref(rd);
+    for (auto& old_ref : old_refs) {
+      scheduler_->HandleReferenceStateChange(*old_ref, new_ref, td_ptr);
+      delete old_ref;
+      unblocked = true;
+    }
+  }
+  // Delegated tasks' outputs are also tracked by the delegating coordinator,
+  // which schedules their consumers.
+  if (!td_ptr->delegated_from().empty()) {
+    m_adapter_->SendMessageToEndpoint(td_ptr->delegated_from(), bm);
+    return;
+  }
+  if (unblocked) {
+    JobDescriptor* jd = DescriptorForJob(td_ptr->job_id());
+    scheduler::SchedulerStats scheduler_stats;
+    scheduler_->ScheduleJob(jd, &scheduler_stats);
   }
 }
 
@@ -472,31 +834,15 @@ void Coordinator::HandleRegistrationRequest(
 }
 
 void Coordinator::HandleTaskHeartbeat(const TaskHeartbeatMessage& msg) {
-  TaskID_t task_id = msg.task_id();
-  TaskDescriptor* tdp = FindPtrOrNull(*task_table_, task_id);
-  if (!tdp) {
-    LOG(WARNING) << "HEARTBEAT from UNKNOWN task (ID: "
-                 << task_id << ")!";
-  } else {
-    VLOG(1) << "HEARTBEAT from task " << task_id;
-    // Remember the current location from which this task reports
-    tdp->set_last_heartbeat_location(msg.location());
-    // Remember the heartbeat time
-    tdp->set_last_heartbeat_time(time_manager_->GetCurrentTimestamp());
-    // Process the profiling information submitted by the task, add it to
-    // the knowledge base
-    scheduler_->knowledge_base()->AddTaskStatsSample(msg.stats());
-  }
-
+  RecordTaskHeartbeat(msg);
   // If we have a parent coordinator on whose behalf we are managing this task,
-  // forward the message.
-  // TODO(malte): this does not currently perform any aggregation, so we're
-  // likely to DoS the parent coordinator on a large deployment. Instead, we
-  // should only selectively forward heartbeats and aggregate them.
+  // forward the message. Local tasks normally report via the task heartbeat
+  // aggregator instead, whose batches are forwarded as a single message.
   if (parent_chan_ != NULL) {
     BaseMessage bm;
     bm.mutable_task_heartbeat()->CopyFrom(msg);
-    if (!SendMessageToRemote(parent_chan_, &bm)) {
+    boost::lock_guard<boost::mutex> lock(parent_send_lock_);
+    if (!QueueMessageToRemote(parent_chan_, &bm)) {
       LOG(ERROR) << "Failed to forward heartbeat to parent coordinator!";
       // Try to re-register
       RegisterWithCoordinator(parent_chan_);
@@ -506,6 +852,35 @@ void Coordinator::HandleTaskHeartbeat(const TaskHeartbeatMessage& msg) {
   }
 }
 
+void Coordinator::HandleTaskHeartbeatBatch(
+    const TaskHeartbeatBatchMessage& msg) {
+  VLOG(1) << "HEARTBEAT batch of " << msg.heartbeats_size() << " tasks";
+  for (int32_t i = 0; i < msg.heartbeats_size(); ++i) {
+    RecordTaskHeartbeat(msg.heartbeats(i));
+  }
+  ForwardTaskHeartbeatBatch(msg);
+}
+
+void Coordinator::ForwardBatchedTaskHeartbeats(shared_ptr<BaseMessage> bm) {
+  ForwardTaskHeartbeatBatch(bm->task_heartbeat_batch());
+}
+
+void Coordinator::ForwardTaskHeartbeatBatch(
+    const TaskHeartbeatBatchMessage& msg) {
+  // Pass the whole batch on, so that the parent coordinator receives one
+  // message per machine and interval rather than one per task.
+  if (parent_chan_ != NULL) {
+    BaseMessage bm;
+    bm.mutable_task_heartbeat_batch()->CopyFrom(msg);
+    boost::lock_guard<boost::mutex> lock(parent_send_lock_);
+    if (!QueueMessageToRemote(parent_chan_, &bm)) {
+      LOG(ERROR) << "Failed to forward heartbeats to parent coordinator!";
+      // Try to re-register
+      RegisterWithCoordinator(parent_chan_);
+    }
+  }
+}
+
 void Coordinator::HandleTaskDelegationRequest(
     const TaskDelegationRequestMessage& msg,
     const string& remote_endpoint) {
@@ -562,7 +937,10 @@ void Coordinator::HandleTaskInfoRequest(const TaskInfoRequestMessage& msg,
   TaskDescriptor* task_desc_ptr = FindPtrOrNull(*task_table_, msg.task_id());
   CHECK_NOTNULL(task_desc_ptr);
   // Remember the current location of this task
-  task_desc_ptr->set_last_heartbeat_location(remote_endpoint);
+  {
+    boost::lock_guard<boost::mutex> lock(*TaskHeartbeatLock(msg.task_id()));
+    task_desc_ptr->set_last_heartbeat_location(remote_endpoint);
+  }
   BaseMessage resp;
   // XXX(malte): ugly hack!
   SUBMSG_WRITE(resp, task_info_response, task_id, msg.task_id());
@@ -696,6 +1074,8 @@ void Coordinator::HandleTaskCompletion(const TaskStateMessage& msg,
     if (HasJobCompleted(*jd)) {
       LOG(INFO) << "Job " << jd->uuid() << " has completed!";
       scheduler_->HandleJobCompletion(JobIDFromString(jd->uuid()));
+      UnpinJobObjects(JobIDFromString(jd->uuid()));
+      ForwardJobCompletion(*jd);
     }
   }
   if (report.task_id() != 0) {
@@ -753,6 +1133,8 @@ bool Coordinator::KillRunningJob(JobID_t job_id) {
     }
   }
   jd->set_state(JobDescriptor::ABORTED);
+  UnpinJobObjects(job_id);
+  ForwardJobCompletion(*jd);
   return true;
 }
 
@@ -764,8 +1146,13 @@ bool Coordinator::KillRunningTask(TaskID_t task_id,
   if (!td_ptr) {
     LOG(ERROR) << "Tried to kill unknown task " << task_id;
     return false;
-  } else if (td_ptr->delegated_to().empty() &&
-             td_ptr->last_heartbeat_location().empty()) {
+  }
+  bool location_known;
+  {
+    boost::lock_guard<boost::mutex> lock(*TaskHeartbeatLock(task_id));
+    location_known = !td_ptr->last_heartbeat_location().empty();
+  }
+  if (td_ptr->delegated_to().empty() && !location_known) {
     LOG(ERROR) << "Tried to kill task " << task_id << " at unknown location";
     return false;
   }
@@ -850,22 +1237,85 @@ void Coordinator::AddJobsTasksToTables(TaskDescriptor* td, JobID_t job_id) {
 
 void Coordinator::SendHeartbeatToParent(const ResourceStats& stats) {
   BaseMessage bm;
-  // TODO(malte): we do not always need to send the location string; it
-  // sufficies to send it if our location changed (which should be rare).
-  SUBMSG_WRITE(bm, heartbeat, uuid, to_string(uuid_));
-  SUBMSG_WRITE(bm, heartbeat, location, node_uri_);
-  SUBMSG_WRITE(bm, heartbeat, capacity,
-               topology_manager_->NumProcessingUnits());
-  // Include resource usage stats
-  bm.mutable_heartbeat()->mutable_load()->CopyFrom(stats);
+  if (parent_heartbeat_encoder_) {
+    // Only sends the location, capacity and stats fields that have changed
+    // since the last heartbeat acknowledged by the parent.
+    parent_heartbeat_encoder_->EncodeHeartbeat(
+        node_uri_, topology_manager_->NumProcessingUnits(), stats,
+        bm.mutable_heartbeat());
+  } else {
+    // TODO(malte): we do not always need to send the location string; it
+    // sufficies to send it if our location changed (which should be rare).
+    SUBMSG_WRITE(bm, heartbeat, uuid, to_string(uuid_));
+    SUBMSG_WRITE(bm, heartbeat, location, node_uri_);
+    SUBMSG_WRITE(bm, heartbeat, capacity,
+                 topology_manager_->NumProcessingUnits());
+    // Include resource usage stats
+    bm.mutable_heartbeat()->mutable_load()->CopyFrom(stats);
+  }
   VLOG(2) << "Sending heartbeat to parent coordinator!";
-  if (!SendMessageToRemote(parent_chan_, &bm)) {
+  boost::lock_guard<boost::mutex> lock(parent_send_lock_);
+  if (!QueueMessageToRemote(parent_chan_, &bm)) {
     LOG(ERROR) << "Failed to send heartbeat to parent coordinator!";
     // Try to re-register
     RegisterWithCoordinator(parent_chan_);
   }
 }
 
+void Coordinator::FlushParentChannel() {
+  boost::lock_guard<boost::mutex> lock(parent_send_lock_);
+  if (!parent_chan_->FlushS()) {
+    LOG(ERROR) << "Failed to send heartbeats to parent coordinator!";
+    // Try to re-register
+    RegisterWithCoordinator(parent_chan_);
+  }
+}
+
+void Coordinator::ForwardJobCompletion(const JobDescriptor& jd) {
+  // The coordinators that ran delegated tasks of the job pinned the objects
+  // that those tasks published, and only learn from us when to unpin them.
+  set<string> delegatees;
+  queue<const TaskDescriptor*> q;
+  q.push(&jd.root_task());
+  while (!q.empty()) {
+    TaskDescriptor* td_ptr = FindPtrOrNull(*task_table_, q.front()->uid());
+    q.pop();
+    if (!td_ptr)
+      continue;
+    if (!td_ptr->delegated_to().empty())
+      delegatees.insert(td_ptr->delegated_to());
+    for (auto& spawned : td_ptr->spawned()) {
+      q.push(&spawned);
+    }
+  }
+  if (delegatees.empty())
+    return;
+  BaseMessage bm;
+  SUBMSG_WRITE(bm, job_completion, job_id, jd.uuid());
+  for (auto& endpoint : delegatees) {
+    VLOG(1) << "Forwarding completion of job " << jd.uuid() << " to "
+            << endpoint;
+    m_adapter_->SendMessageToEndpoint(endpoint, bm);
+  }
+}
+
+void Coordinator::UnpinJobObjects(JobID_t job_id) {
+  vector<DataObjectID_t> objects;
+  {
+    boost::lock_guard<boost::mutex> lock(pinned_objects_lock_);
+    vector<DataObjectID_t>* pinned = FindOrNull(pinned_objects_, job_id);
+    if (!pinned)
+      return;
+    objects.swap(*pinned);
+    pinned_objects_.erase(job_id);
+  }
+  // The job's tasks have all finished, so nothing will consume its objects
+  // any more; they may be evicted from now on.
+  for (auto& id : objects) {
+    shm_object_store_->UnpinObject(id);
+  }
+}
+
 const string Coordinator::SubmitJob(const JobDescriptor& job_descriptor) {
   // Generate a job ID
   // TODO(malte): This should become deterministic, and based on the
@@ -48,8 +48,10 @@
 #include "base/resource_desc.pb.h"
 #include "base/resource_topology_node_desc.pb.h"
 #include "engine/health_monitor.h"
+#include "engine/heartbeat_delta.h"
 #include "engine/node.h"
 #include "messages/heartbeat_message.pb.h"
+#include "messages/job_completion_message.pb.h"
 #include "messages/registration_message.pb.h"
 #include "messages/task_delegation_message.pb.h"
 #include "messages/task_heartbeat_message.pb.h"
@@ -60,6 +62,7 @@
 #include "misc/trace_generator.h"
 #include "misc/utils.h"
 #include "misc/wall_time.h"
+#include "misc/work_stealing_executor.h"
 #include "platforms/common.h"
 #include "platforms/unix/signal_handler.h"
 #include "platforms/unix/stream_sockets_adapter.h"
@@ -71,6 +74,8 @@
 #include "scheduling/simple/simple_scheduler.h"
 #include "scheduling/fulcrum_c/fulcrum_c_scheduler.h"
 #include "storage/object_store_interface.h"
+#include "storage/object_transfer_server.h"
+#include "engine/executors/task_heartbeat_aggregator.h"
 #include "engine/executors/topology_manager.h"
 
 namespace firmament {
@@ -140,7 +145,8 @@ class Coordinator : public Node,
   // Gets a pointer to the resource status for an associated resource.
   // Returns NULL if not associated.
   ResourceStatus* GetResourceStatus(ResourceID_t res_id) {
-    ResourceStatus* res = FindPtrOrNull(*associated_resources_, res_id);
+    ResourceStatus* res = NULL;
+    associated_resources_->Lookup(res_id, &res);
     return res;
   }
 
@@ -252,11 +258,20 @@ class Coordinator : public Node,
                    bool local);
   bool RegisterWithCoordinator(StreamSocketsChannel<BaseMessage>* chan);
   void DetectLocalResources();
+  void DropHeartbeatStateForEndpoint(const string& remote_endpoint);
+  void ForwardBatchedTaskHeartbeats(shared_ptr<BaseMessage> bm);
+  void ForwardTaskHeartbeatBatch(const TaskHeartbeatBatchMessage& msg);
   bool HasJobCompleted(const JobDescriptor& jd);
+  void DispatchIncomingMessage(shared_ptr<BaseMessage> bm,
+                               const string& remote_endpoint);
   void HandleIncomingMessage(BaseMessage *bm, const string& remote_endpoint);
   void HandleIncomingReceiveError(const boost::system::error_code& error,
                                   const string& remote_endpoint);
-  void HandleHeartbeat(const HeartbeatMessage& msg);
+  void HandleHeartbeat(const HeartbeatMessage& msg,
+                       const string& remote_endpoint);
+  void HandleHeartbeatAck(const HeartbeatAckMessage& msg);
+  void HandleJobCompletion(const JobCompletionMessage& msg);
+  void HandleObjectPublish(const ObjectPublishMessage& msg);
   void HandleRegistrationRequest(const RegistrationMessage& msg);
   void HandleTaskCompletion(const TaskStateMessage& msg, TaskDescriptor* td);
   void HandleTaskDelegationRequest(const TaskDelegationRequestMessage& msg,
@@ -264,6 +279,7 @@ class Coordinator : public Node,
   void HandleTaskDelegationResponse(const TaskDelegationResponseMessage& msg,
                                     const string& endpoint);
   void HandleTaskHeartbeat(const TaskHeartbeatMessage& msg);
+  void HandleTaskHeartbeatBatch(const TaskHeartbeatBatchMessage& msg);
   void HandleTaskInfoRequest(const TaskInfoRequestMessage& msg,
                              const string& remote_endpoint);
   void HandleTaskSpawn(const TaskSpawnMessage& msg);
@@ -272,7 +288,16 @@ class Coordinator : public Node,
 #ifdef __HTTP_UI__
   void InitHTTPUI();
 #endif
+  void ProcessIncomingMessage(BaseMessage* bm, const string& remote_endpoint);
+  bool QueueAggregatedMessage(shared_ptr<BaseMessage> bm);
+  void QueueTaskHeartbeatBatch(const TaskHeartbeatBatchMessage& batch);
+  void QueueTaskStateChange(const TaskStateMessage& msg);
+  void RecordBatchedTaskHeartbeat(shared_ptr<BaseMessage> bm, int32_t index);
+  void RecordTaskHeartbeat(const TaskHeartbeatMessage& msg);
+  void ForwardJobCompletion(const JobDescriptor& jd);
+  void FlushParentChannel();
   void SendHeartbeatToParent(const ResourceStats& stats);
+  void UnpinJobObjects(JobID_t job_id);
 
 #ifdef __HTTP_UI__
   scoped_ptr<CoordinatorHTTPUI> c_http_ui_;
@@ -293,6 +318,10 @@ class Coordinator : public Node,
   // A map of all tasks that the coordinator currently knows about.
   // TODO(malte): Think about GC'ing this.
   shared_ptr<TaskMap_t> task_table_;
+  // Executor and dispatcher on which incoming messages are handled; both are
+  // NULL if messages are handled inline on the messaging thread.
+  scoped_ptr<WorkStealingExecutor> message_executor_;
+  scoped_ptr<KeyedDispatcher> message_dispatcher_;
   // The health monitor periodically checks on the liveness of subordinate
   // coordinators and running tasks.
   HealthMonitor health_monitor_;
@@ -301,7 +330,20 @@ class Coordinator : public Node,
   // local resources.
   shared_ptr<TopologyManager> topology_manager_;
   // The local object store.
+  shared_ptr<store::ShmObjectStore> shm_object_store_;
   shared_ptr<ObjectStoreInterface> object_store_;
+  // Objects published into the local store by tasks of each job. They are
+  // pinned against eviction until the job completes, since tasks that
+  // consume them may not have run yet. For delegated tasks, the delegating
+  // coordinator tells us when that is.
+  boost::mutex pinned_objects_lock_;
+  unordered_map<JobID_t, vector<DataObjectID_t>,
+                boost::hash<JobID_t>> pinned_objects_;
+  // Serves the objects in the local object store to other machines.
+  scoped_ptr<store::ObjectTransferServer> object_transfer_server_;
+  // Collects the heartbeats of local tasks; NULL if tasks send heartbeats
+  // over their connection to the coordinator.
+  scoped_ptr<executor::TaskHeartbeatAggregator> task_heartbeat_aggregator_;
   // The local scheduler object. A coordinator may not have a scheduler, in
   // which case this will be a stub that defers to another scheduler.
   // TODO(malte): Work out the detailed semantics of this.
@@ -310,6 +352,13 @@ class Coordinator : public Node,
   string parent_uri_;
   // Pointer to channel to the parent coordinator
   StreamSocketsChannel<BaseMessage>* parent_chan_;
+  // Serializes forwarding to, and re-registration with, the parent
+  // coordinator, which happen on several message handler threads.
+  boost::mutex parent_send_lock_;
+  // Delta-encodes the heartbeats we send to the parent coordinator.
+  scoped_ptr<HeartbeatDeltaEncoder> parent_heartbeat_encoder_;
+  // Reconstructs delta-encoded heartbeats received from our resources.
+  HeartbeatDeltaDecoder heartbeat_decoder_;
   // Machine statistics monitor
   ProcFSMachine machine_monitor_;
   ResourceID_t machine_uuid_;
@@ -32,6 +32,7 @@
 #include <google/protobuf/util/json_util.h>
 
 #include "base/job_desc.pb.h"
+#include "base/task_heartbeat_lock.h"
 #include "engine/coordinator.h"
 #include "misc/utils.h"
 #include "misc/string_utils.h"
@@ -1057,8 +1058,12 @@ void CoordinatorHTTPUI::HandleTaskURI(const http::request_ptr& http_request,
         CoarseTimestampToHumanReadble(td_ptr->finish_time() / 1000000));
     // Heartbeat time
     // JS expects millisecond values
-    dict.SetIntValue("TASK_LAST_HEARTBEAT",
-                     td_ptr->last_heartbeat_time() / 1000);
+    uint64_t last_heartbeat_time;
+    {
+      boost::lock_guard<boost::mutex> lock(*TaskHeartbeatLock(td_ptr->uid()));
+      last_heartbeat_time = td_ptr->last_heartbeat_time();
+    }
+    dict.SetIntValue("TASK_LAST_HEARTBEAT", last_heartbeat_time / 1000);
     coordinator_->scheduler()->PopulateSchedulerTaskUI(td_ptr->uid(), &dict);
     // Dependencies
     if (td_ptr->dependencies_size() > 0)
@@ -0,0 +1,341 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Single-threaded supervisor for task processes.
+
+#include "engine/executors/child_supervisor.h"
+
+extern "C" {
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include "misc/map-util.h"
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+namespace firmament {
+namespace executor {
+
+// Interval at which processes without a pidfd are polled, and at which
+// retried work runs.
+static const int kFallbackPollIntervalMs = 100;
+static const int kMaxEvents = 64;
+// epoll data tags of the wake-up eventfd and the sampling timer; all other
+// events carry the PID of a watched process.
+static const uint64_t kWakeTag = ~0ULL;
+static const uint64_t kTimerTag = ~0ULL - 1;
+
+ChildSupervisor::ChildSupervisor(uint64_t sample_interval_ms)
+  : sample_interval_ms_(sample_interval_ms), epoll_fd_(-1), wake_fd_(-1),
+    timer_fd_(-1), stop_(false), thread_(NULL) {
+}
+
+ChildSupervisor::~ChildSupervisor() {
+  Stop();
+}
+
+bool ChildSupervisor::Start() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    PLOG(ERROR) << "Failed to set up child supervisor";
+    return false;
+  }
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeTag;
+  CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event), 0);
+  if (sample_interval_ms_ > 0) {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd_ < 0) {
+      PLOG(ERROR) << "Failed to create sampling timer";
+      return false;
+    }
+    struct itimerspec interval;
+    interval.it_interval.tv_sec = sample_interval_ms_ / 1000;
+    interval.it_interval.tv_nsec = (sample_interval_ms_ % 1000) * 1000000;
+    interval.it_value = interval.it_interval;
+    CHECK_EQ(timerfd_settime(timer_fd_, 0, &interval, NULL), 0);
+    event.data.u64 = kTimerTag;
+    CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &event), 0);
+  }
+  thread_ = new boost::thread(boost::bind(&ChildSupervisor::Run, this));
+  thread_id_ = thread_->get_id();
+  return true;
+}
+
+void ChildSupervisor::Stop() {
+  if (thread_) {
+    stop_ = true;
+    Wake();
+    thread_->join();
+    delete thread_;
+    thread_ = NULL;
+  }
+  // Launch requests that arrived while stopping run on this thread.
+  RunLaunchRequests();
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  for (unordered_map<pid_t, WatchedProcess>::iterator it = processes_.begin();
+       it != processes_.end();
+       ++it) {
+    if (it->second.pidfd >= 0)
+      close(it->second.pidfd);
+  }
+  processes_.clear();
+  polled_processes_.clear();
+  retried_work_.clear();
+  int* fds[] = {&epoll_fd_, &wake_fd_, &timer_fd_};
+  for (uint32_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+    if (*fds[i] >= 0) {
+      close(*fds[i]);
+      *fds[i] = -1;
+    }
+  }
+}
+
+pid_t ChildSupervisor::Launch(ProcessLauncher* launcher, int* exec_errno) {
+  if (!thread_ || stop_ || boost::this_thread::get_id() == thread_id_)
+    return launcher->Launch(exec_errno);
+  LaunchRequest request;
+  request.launcher = launcher;
+  request.exec_errno = exec_errno;
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  launch_requests_.push_back(&request);
+  Wake();
+  while (!request.done) {
+    launch_condvar_.wait(lock);
+  }
+  return request.pid;
+}
+
+bool ChildSupervisor::Watch(pid_t pid, ExitCallback on_exit,
+                            SampleCallback on_sample) {
+  WatchedProcess process;
+  process.on_exit = on_exit;
+  process.on_sample = on_sample;
+  process.pidfd = syscall(__NR_pidfd_open, pid, 0);
+  if (process.pidfd < 0 && errno != ENOSYS) {
+    PLOG(ERROR) << "Failed to open pidfd for process " << pid;
+    return false;
+  }
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (!InsertIfNotPresent(&processes_, pid, process)) {
+    LOG(ERROR) << "Process " << pid << " is already being watched";
+    if (process.pidfd >= 0)
+      close(process.pidfd);
+    return false;
+  }
+  if (process.pidfd >= 0) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = pid;
+    CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, process.pidfd, &event), 0);
+  } else {
+    polled_processes_.insert(pid);
+    // Makes the thread pick up the poll timeout.
+    Wake();
+  }
+  return true;
+}
+
+void ChildSupervisor::Detach(pid_t pid) {
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    WatchedProcess* process = FindOrNull(processes_, pid);
+    if (!process)
+      return;
+    process->on_exit.clear();
+    process->on_sample.clear();
+  }
+  // Wait for a callback that is running to return.
+  if (boost::this_thread::get_id() != thread_id_) {
+    boost::lock_guard<boost::mutex> callback_lock(callback_mutex_);
+  }
+}
+
+size_t ChildSupervisor::NumWatched() {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  return processes_.size();
+}
+
+void ChildSupervisor::RetryUntilDone(RetriedWork work) {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (!thread_ || stop_)
+    return;
+  retried_work_.push_back(work);
+  // Makes the thread run the work and pick up the retry timeout.
+  Wake();
+}
+
+void ChildSupervisor::ReapExitedProcesses(const vector<pid_t>& pids) {
+  for (vector<pid_t>::const_iterator it = pids.begin();
+       it != pids.end();
+       ++it) {
+    int status;
+    pid_t ret;
+    while ((ret = waitpid(*it, &status, WNOHANG)) < 0 && errno == EINTR) {}
+    if (ret == 0)
+      continue;
+    if (ret < 0) {
+      PLOG(ERROR) << "Failed to wait for child process " << *it;
+      status = -1;
+    }
+    boost::lock_guard<boost::mutex> callback_lock(callback_mutex_);
+    ExitCallback on_exit;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      WatchedProcess* process = FindOrNull(processes_, *it);
+      if (!process)
+        continue;
+      // Closing the pidfd also removes it from the epoll set.
+      if (process->pidfd >= 0)
+        close(process->pidfd);
+      on_exit = process->on_exit;
+      processes_.erase(*it);
+      polled_processes_.erase(*it);
+    }
+    if (on_exit)
+      on_exit(status);
+  }
+}
+
+void ChildSupervisor::Run() {
+  struct epoll_event events[kMaxEvents];
+  while (!stop_) {
+    int timeout_ms;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      timeout_ms = polled_processes_.empty() && retried_work_.empty() ?
+        -1 : kFallbackPollIntervalMs;
+    }
+    int num_events = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (num_events < 0) {
+      if (errno == EINTR)
+        continue;
+      PLOG(ERROR) << "Child supervisor epoll_wait failed";
+      break;
+    }
+    bool sample = false;
+    vector<pid_t> exited;
+    for (int i = 0; i < num_events; ++i) {
+      uint64_t value;
+      if (events[i].data.u64 == kWakeTag) {
+        while (read(wake_fd_, &value, sizeof(value)) > 0) {}
+      } else if (events[i].data.u64 == kTimerTag) {
+        while (read(timer_fd_, &value, sizeof(value)) > 0) {}
+        sample = true;
+      } else {
+        exited.push_back(static_cast<pid_t>(events[i].data.u64));
+      }
+    }
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      exited.insert(exited.end(), polled_processes_.begin(),
+                    polled_processes_.end());
+    }
+    RunLaunchRequests();
+    ReapExitedProcesses(exited);
+    if (sample)
+      RunSampleCallbacks();
+    RunRetriedWork();
+  }
+}
+
+void ChildSupervisor::RunRetriedWork() {
+  vector<RetriedWork> work;
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    work.swap(retried_work_);
+  }
+  vector<RetriedWork> not_done;
+  for (vector<RetriedWork>::iterator it = work.begin();
+       it != work.end();
+       ++it) {
+    if (!(*it)())
+      not_done.push_back(*it);
+  }
+  if (not_done.empty())
+    return;
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  retried_work_.insert(retried_work_.end(), not_done.begin(),
+                       not_done.end());
+}
+
+void ChildSupervisor::RunLaunchRequests() {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (!launch_requests_.empty()) {
+    LaunchRequest* request = launch_requests_.front();
+    launch_requests_.pop_front();
+    lock.unlock();
+    request->pid = request->launcher->Launch(request->exec_errno);
+    lock.lock();
+    request->done = true;
+  }
+  launch_condvar_.notify_all();
+}
+
+void ChildSupervisor::RunSampleCallbacks() {
+  vector<pid_t> pids;
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    for (unordered_map<pid_t, WatchedProcess>::const_iterator it =
+         processes_.begin();
+         it != processes_.end();
+         ++it) {
+      if (it->second.on_sample)
+        pids.push_back(it->first);
+    }
+  }
+  for (vector<pid_t>::const_iterator it = pids.begin();
+       it != pids.end();
+       ++it) {
+    // The callback is looked up again with callback_mutex_ held, since the
+    // process may have been detached in the meantime.
+    boost::lock_guard<boost::mutex> callback_lock(callback_mutex_);
+    SampleCallback on_sample;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      WatchedProcess* process = FindOrNull(processes_, *it);
+      if (process)
+        on_sample = process->on_sample;
+    }
+    if (on_sample)
+      on_sample();
+  }
+}
+
+void ChildSupervisor::Wake() {
+  uint64_t value = 1;
+  if (wake_fd_ >= 0 && write(wake_fd_, &value, sizeof(value)) < 0 &&
+      errno != EAGAIN) {
+    PLOG(WARNING) << "Failed to wake up child supervisor thread";
+  }
+}
+
+}  // namespace executor
+}  // namespace firmament
@@ -0,0 +1,170 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Supervises the task processes of all local executors from a single thread.
+// The thread waits in epoll(7) on a pidfd for each process, so exits are
+// delivered as soon as they happen, and on a timer that drives periodic
+// statistics sampling. It also launches the processes: the kernel ties a
+// child's parent-death signal to the thread that created it, so children must
+// be created by a thread that lives as long as the supervisor.
+//
+// On kernels without pidfd_open(2) (before Linux 5.3), the thread instead
+// polls the processes with waitpid(2) every kFallbackPollIntervalMs.
+//
+// The thread also retries cleanup work that has to wait for processes to go
+// away, so that those who need it done never block on it.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_CHILD_SUPERVISOR_H
+#define FIRMAMENT_ENGINE_EXECUTORS_CHILD_SUPERVISOR_H
+
+#include <sys/types.h>
+
+#include <deque>
+#include <vector>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#else
+#error Boost not available!
+#endif
+
+#include "base/common.h"
+#include "base/types.h"
+#include "engine/executors/process_launcher.h"
+
+namespace firmament {
+namespace executor {
+
+class ChildSupervisor {
+ public:
+  // Called with the wait(2) status of an exited process.
+  typedef boost::function<void(int)> ExitCallback;
+  typedef boost::function<void()> SampleCallback;
+  // Returns true once the work is done.
+  typedef boost::function<bool()> RetriedWork;
+
+  /**
+   * @param sample_interval_ms interval between calls to the processes'
+   * sample callbacks; 0 disables sampling
+   */
+  explicit ChildSupervisor(uint64_t sample_interval_ms);
+  ~ChildSupervisor();
+
+  /**
+   * Starts the supervisor thread.
+   * @return false if the thread's epoll instance could not be set up
+   */
+  bool Start();
+
+  /**
+   * Stops the supervisor thread. Processes that are still running are no
+   * longer reaped.
+   */
+  void Stop();
+
+  /**
+   * Launches a process from the supervisor thread and waits for the launch
+   * to finish.
+   * @param launcher the launcher to run
+   * @param exec_errno see ProcessLauncher::Launch()
+   * @return the PID of the process, or -1 if it could not be created
+   */
+  pid_t Launch(ProcessLauncher* launcher, int* exec_errno);
+
+  /**
+   * Watches a child process until it exits, and reaps it. Callbacks run on
+   * the supervisor thread, one at a time.
+   * @param pid the PID of the process, which must be a child of this process
+   * @param on_exit called with the process's wait status once it exits
+   * @param on_sample if set, called every sample interval while the process
+   * runs
+   * @return false if the process cannot be watched
+   */
+  bool Watch(pid_t pid, ExitCallback on_exit, SampleCallback on_sample);
+
+  /**
+   * Stops calling a process's callbacks; the process is still reaped when it
+   * exits. Unless called from a callback, this waits for any of the
+   * process's callbacks that is running to return.
+   * @param pid the PID of the process
+   */
+  void Detach(pid_t pid);
+
+  /**
+   * @return the number of processes being watched
+   */
+  size_t NumWatched();
+
+  /**
+   * Runs work on the supervisor thread, and again every
+   * kFallbackPollIntervalMs until it is done. Work that is not done when the
+   * supervisor stops is dropped.
+   * @param work the work to run; must not block
+   */
+  void RetryUntilDone(RetriedWork work);
+
+ private:
+  struct WatchedProcess {
+    WatchedProcess() : pidfd(-1) {}
+    int pidfd;
+    ExitCallback on_exit;
+    SampleCallback on_sample;
+  };
+
+  struct LaunchRequest {
+    LaunchRequest() : launcher(NULL), exec_errno(NULL), pid(-1), done(false) {}
+    ProcessLauncher* launcher;
+    int* exec_errno;
+    pid_t pid;
+    bool done;
+  };
+
+  void Run();
+  void RunLaunchRequests();
+  void RunRetriedWork();
+  void RunSampleCallbacks();
+  void ReapExitedProcesses(const vector<pid_t>& pids);
+  void Wake();
+
+  uint64_t sample_interval_ms_;
+  int epoll_fd_;
+  int wake_fd_;
+  int timer_fd_;
+  volatile bool stop_;
+  boost::thread* thread_;
+  boost::thread::id thread_id_;
+  // Guards processes_, polled_processes_, launch_requests_ and
+  // retried_work_.
+  boost::mutex mutex_;
+  // Held while callbacks run, so that Detach() can wait for them.
+  boost::mutex callback_mutex_;
+  boost::condition_variable launch_condvar_;
+  unordered_map<pid_t, WatchedProcess> processes_;
+  // Processes without a pidfd, which are polled.
+  unordered_set<pid_t> polled_processes_;
+  deque<LaunchRequest*> launch_requests_;
+  vector<RetriedWork> retried_work_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_CHILD_SUPERVISOR_H
@@ -0,0 +1,175 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for the task process supervisor.
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <sys/wait.h>
+
+#include "base/common.h"
+#include "engine/executors/child_supervisor.h"
+
+namespace firmament {
+namespace executor {
+
+class ChildSupervisorTest : public ::testing::Test {
+ public:
+  void OnExit(int status) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    exit_status_ = status;
+    ++num_exits_;
+    exit_condvar_.notify_all();
+  }
+
+  void OnSample() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ++num_samples_;
+  }
+
+  // Done on the third attempt.
+  bool RetriedWork() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return ++num_attempts_ == 3;
+  }
+
+ protected:
+  ChildSupervisorTest()
+    : exit_status_(-1), num_exits_(0), num_samples_(0), num_attempts_(0) {}
+
+  pid_t LaunchShell(ChildSupervisor* supervisor, const string& command) {
+    vector<string> argv;
+    argv.push_back("/bin/sh");
+    argv.push_back("-c");
+    argv.push_back(command);
+    ProcessLauncher launcher(argv, unordered_map<string, string>());
+    int exec_errno;
+    pid_t pid = supervisor->Launch(&launcher, &exec_errno);
+    CHECK_GT(pid, 0);
+    CHECK_EQ(exec_errno, 0);
+    return pid;
+  }
+
+  // Waits up to five seconds for an exit to be reported.
+  bool WaitForExit() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    boost::system_time deadline =
+      boost::get_system_time() + boost::posix_time::seconds(5);
+    while (num_exits_ == 0) {
+      if (!exit_condvar_.timed_wait(lock, deadline))
+        return false;
+    }
+    return true;
+  }
+
+  boost::mutex mutex_;
+  boost::condition_variable exit_condvar_;
+  int exit_status_;
+  uint32_t num_exits_;
+  uint32_t num_samples_;
+  uint32_t num_attempts_;
+};
+
+TEST_F(ChildSupervisorTest, ReportsExitStatus) {
+  ChildSupervisor supervisor(0);
+  ASSERT_TRUE(supervisor.Start());
+  pid_t pid = LaunchShell(&supervisor, "exit 3");
+  ASSERT_TRUE(supervisor.Watch(
+      pid, boost::bind(&ChildSupervisorTest::OnExit, this, _1),
+      ChildSupervisor::SampleCallback()));
+  ASSERT_TRUE(WaitForExit());
+  EXPECT_TRUE(WIFEXITED(exit_status_));
+  EXPECT_EQ(WEXITSTATUS(exit_status_), 3);
+  EXPECT_EQ(supervisor.NumWatched(), 0);
+  // The process has been reaped.
+  EXPECT_EQ(waitpid(pid, NULL, WNOHANG), -1);
+  EXPECT_EQ(errno, ECHILD);
+}
+
+TEST_F(ChildSupervisorTest, ReportsProcessThatExitedBeforeWatch) {
+  ChildSupervisor supervisor(0);
+  ASSERT_TRUE(supervisor.Start());
+  pid_t pid = LaunchShell(&supervisor, "kill -9 $$");
+  // Let the process die before we watch it.
+  siginfo_t info;
+  ASSERT_EQ(waitid(P_PID, pid, &info, WEXITED | WNOWAIT), 0);
+  ASSERT_TRUE(supervisor.Watch(
+      pid, boost::bind(&ChildSupervisorTest::OnExit, this, _1),
+      ChildSupervisor::SampleCallback()));
+  ASSERT_TRUE(WaitForExit());
+  EXPECT_TRUE(WIFSIGNALED(exit_status_));
+  EXPECT_EQ(WTERMSIG(exit_status_), SIGKILL);
+}
+
+TEST_F(ChildSupervisorTest, SamplesRunningProcess) {
+  ChildSupervisor supervisor(10);
+  ASSERT_TRUE(supervisor.Start());
+  pid_t pid = LaunchShell(&supervisor, "sleep 0.2");
+  ASSERT_TRUE(supervisor.Watch(
+      pid, boost::bind(&ChildSupervisorTest::OnExit, this, _1),
+      boost::bind(&ChildSupervisorTest::OnSample, this)));
+  ASSERT_TRUE(WaitForExit());
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  EXPECT_GT(num_samples_, 0);
+}
+
+TEST_F(ChildSupervisorTest, ReapsDetachedProcess) {
+  ChildSupervisor supervisor(0);
+  ASSERT_TRUE(supervisor.Start());
+  pid_t pid = LaunchShell(&supervisor, "sleep 0.1");
+  ASSERT_TRUE(supervisor.Watch(
+      pid, boost::bind(&ChildSupervisorTest::OnExit, this, _1),
+      ChildSupervisor::SampleCallback()));
+  supervisor.Detach(pid);
+  for (uint32_t i = 0; i < 500 && supervisor.NumWatched() > 0; ++i) {
+    usleep(10000);
+  }
+  EXPECT_EQ(supervisor.NumWatched(), 0);
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  EXPECT_EQ(num_exits_, 0);
+}
+
+TEST_F(ChildSupervisorTest, RetriesWorkUntilDone) {
+  ChildSupervisor supervisor(0);
+  ASSERT_TRUE(supervisor.Start());
+  supervisor.RetryUntilDone(
+      boost::bind(&ChildSupervisorTest::RetriedWork, this));
+  for (uint32_t i = 0; i < 500; ++i) {
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      if (num_attempts_ >= 3)
+        break;
+    }
+    usleep(10000);
+  }
+  // Give the supervisor the chance to (wrongly) run the work once more.
+  usleep(300000);
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  EXPECT_EQ(num_attempts_, 3);
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,199 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Page cache warm-up for task input files.
+
+#include "engine/executors/input_prefetcher.h"
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+#include <algorithm>
+#include <utility>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "misc/map-util.h"
+
+DEFINE_uint64(input_prefetch_chunk_size, 4 * 1024 * 1024,
+              "Size, in bytes, of the chunks in which task input files are "
+              "read into the page cache.");
+DEFINE_uint64(input_prefetch_max_bytes, 1024ULL * 1024 * 1024,
+              "Maximum number of input bytes warmed up in the page cache "
+              "for each task.");
+
+namespace firmament {
+namespace executor {
+
+static const char kFileLocationPrefix[] = "file://";
+
+InputPrefetcher::InputPrefetcher()
+  : next_generation_(0), num_threads_(0) {
+}
+
+InputPrefetcher::~InputPrefetcher() {
+  boost::unique_lock<boost::mutex> lock(active_lock_);
+  active_prefetches_.clear();
+  while (num_threads_ > 0)
+    prefetch_finished_.wait(lock);
+}
+
+bool InputPrefetcher::PrefetchAsync(TaskID_t task_id,
+                                    const vector<string>& paths,
+                                    ProgressCallback callback) {
+  if (paths.empty())
+    return false;
+  uint64_t generation;
+  {
+    boost::lock_guard<boost::mutex> lock(active_lock_);
+    generation = next_generation_++;
+    if (!active_prefetches_.insert(make_pair(task_id, generation)).second) {
+      // The task's inputs are being prefetched already.
+      return false;
+    }
+    num_threads_++;
+  }
+  boost::thread prefetch_thread(
+      boost::bind(&InputPrefetcher::RunPrefetch, this, task_id, generation,
+                  paths, callback));
+  prefetch_thread.detach();
+  return true;
+}
+
+void InputPrefetcher::Cancel(TaskID_t task_id) {
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  active_prefetches_.erase(task_id);
+}
+
+uint64_t InputPrefetcher::NumActivePrefetches() {
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  return num_threads_;
+}
+
+string InputPrefetcher::PathForLocation(const string& location) {
+  if (location.compare(0, sizeof(kFileLocationPrefix) - 1,
+                       kFileLocationPrefix) == 0) {
+    return location.substr(sizeof(kFileLocationPrefix) - 1);
+  }
+  if (!location.empty() && location[0] == '/')
+    return location;
+  return "";
+}
+
+uint64_t InputPrefetcher::OpenInputFiles(TaskID_t task_id,
+                                         const vector<string>& paths,
+                                         vector<InputFile>* files) {
+  uint64_t input_size = 0;
+  for (vector<string>::const_iterator it = paths.begin();
+       it != paths.end() && input_size < FLAGS_input_prefetch_max_bytes;
+       ++it) {
+    int fd = open(it->c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      VLOG(1) << "Not prefetching input " << *it << " of task " << task_id
+              << ": " << strerror(errno);
+      continue;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+      close(fd);
+      continue;
+    }
+    InputFile file;
+    file.fd = fd;
+    file.size = min(static_cast<uint64_t>(st.st_size),
+                    FLAGS_input_prefetch_max_bytes - input_size);
+    // Lets the kernel queue the reads while we work through the chunks.
+    posix_fadvise(fd, 0, file.size, POSIX_FADV_WILLNEED);
+    files->push_back(file);
+    input_size += file.size;
+  }
+  return input_size;
+}
+
+bool InputPrefetcher::ReportProgress(TaskID_t task_id, uint64_t generation,
+                                     uint64_t bytes_prefetched,
+                                     uint64_t input_size,
+                                     ProgressCallback callback) {
+  // Reporting under the lock keeps Cancel from returning while a report for
+  // the cancelled prefetch is under way.
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  uint64_t* active_generation = FindOrNull(active_prefetches_, task_id);
+  if (!active_generation || *active_generation != generation)
+    return false;
+  if (callback)
+    callback(task_id, bytes_prefetched, input_size);
+  return true;
+}
+
+void InputPrefetcher::RunPrefetch(TaskID_t task_id, uint64_t generation,
+                                  vector<string> paths,
+                                  ProgressCallback callback) {
+  // The files are opened here rather than by PrefetchAsync, whose caller
+  // should not wait for a slow or remote file system.
+  vector<InputFile> files;
+  uint64_t input_size = OpenInputFiles(task_id, paths, &files);
+  // Reading the data, rather than only advising the kernel, makes sure that
+  // it is cached by the time we report it, and also works on file systems
+  // that ignore readahead hints.
+  vector<char> buffer(FLAGS_input_prefetch_chunk_size);
+  uint64_t bytes_prefetched = 0;
+  bool cancelled = false;
+  for (vector<InputFile>::iterator it = files.begin();
+       it != files.end();
+       ++it) {
+    uint64_t offset = 0;
+    while (!cancelled && offset < it->size) {
+      size_t length = min(static_cast<uint64_t>(buffer.size()),
+                          it->size - offset);
+      ssize_t ret = pread(it->fd, &buffer[0], length, offset);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret < 0)
+        PLOG(WARNING) << "Failed to prefetch input of task " << task_id;
+      // On errors or a truncated file, the unread remainder counts as done,
+      // so that the progress still reaches the total.
+      if (ret <= 0)
+        ret = it->size - offset;
+      offset += ret;
+      bytes_prefetched += ret;
+      cancelled = !ReportProgress(task_id, generation, bytes_prefetched,
+                                  input_size, callback);
+    }
+    close(it->fd);
+  }
+  VLOG(1) << "Prefetched " << bytes_prefetched << " of " << input_size
+          << " input bytes of task " << task_id
+          << (cancelled ? " before it was cancelled" : "");
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  uint64_t* active_generation = FindOrNull(active_prefetches_, task_id);
+  if (active_generation && *active_generation == generation)
+    active_prefetches_.erase(task_id);
+  num_threads_--;
+  prefetch_finished_.notify_all();
+}
+
+}  // namespace executor
+}  // namespace firmament
@@ -0,0 +1,123 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Warms up the page cache with the input files of a task while the task
+// starts up, so that its first reads do not stall on a local disk or on a
+// remote file system. Each prefetch reads the files in chunks on a
+// background thread and reports its progress after every chunk.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_INPUT_PREFETCHER_H
+#define FIRMAMENT_ENGINE_EXECUTORS_INPUT_PREFETCHER_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "base/common.h"
+#include "base/types.h"
+
+namespace firmament {
+namespace executor {
+
+class InputPrefetcher {
+ public:
+  // Called with the task's ID, the number of bytes warmed up so far and the
+  // total number of bytes being warmed up. It runs with the prefetcher's lock
+  // held, so it must not call back into the prefetcher.
+  typedef boost::function<void(TaskID_t, uint64_t, uint64_t)>
+    ProgressCallback;
+
+  InputPrefetcher();
+  /**
+   * Cancels outstanding prefetches and waits for them to stop.
+   */
+  ~InputPrefetcher();
+
+  /**
+   * Starts warming up the page cache with a task's input files. At most
+   * --input_prefetch_max_bytes are read per task; the remainder is left to
+   * be read on demand. The files are opened on the prefetch thread, so this
+   * does no file I/O.
+   * @param task_id the ID of the task whose inputs are prefetched
+   * @param paths the paths of the input files; files that cannot be opened
+   * are skipped
+   * @param callback if not NULL, invoked with the prefetch's progress after
+   * every chunk
+   * @return true if a prefetch was started, false if there are no paths or
+   * the task's inputs are being prefetched already
+   */
+  bool PrefetchAsync(TaskID_t task_id, const vector<string>& paths,
+                     ProgressCallback callback);
+  /**
+   * Stops prefetching a task's inputs, e.g. because the task has finished.
+   * No progress is reported for the task after this returns, even if its
+   * inputs are prefetched again later.
+   * @param task_id the ID of the task
+   */
+  void Cancel(TaskID_t task_id);
+  /**
+   * @return the number of prefetches in flight
+   */
+  uint64_t NumActivePrefetches();
+  /**
+   * @param location the location of a task input
+   * @return the local path of the input if it is a file, or an empty string
+   */
+  static string PathForLocation(const string& location);
+
+ private:
+  struct InputFile {
+    int fd;
+    uint64_t size;
+  };
+
+  /**
+   * Opens the input files, skipping those that cannot be read, and hints to
+   * the kernel that they are about to be read.
+   * @return the number of bytes to warm up
+   */
+  uint64_t OpenInputFiles(TaskID_t task_id, const vector<string>& paths,
+                          vector<InputFile>* files);
+  bool ReportProgress(TaskID_t task_id, uint64_t generation,
+                      uint64_t bytes_prefetched, uint64_t input_size,
+                      ProgressCallback callback);
+  void RunPrefetch(TaskID_t task_id, uint64_t generation,
+                   vector<string> paths, ProgressCallback callback);
+
+  boost::mutex active_lock_;
+  boost::condition_variable prefetch_finished_;
+  // The generation of the running, uncancelled prefetch of each task. A
+  // prefetch whose generation no longer matches was cancelled, even if the
+  // task's inputs have been prefetched again since; guarded by active_lock_.
+  unordered_map<TaskID_t, uint64_t> active_prefetches_;
+  // The generation of the next prefetch; guarded by active_lock_.
+  uint64_t next_generation_;
+  // Number of prefetch threads that have not exited yet, including
+  // cancelled ones; guarded by active_lock_.
+  uint64_t num_threads_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_INPUT_PREFETCHER_H
@@ -0,0 +1,224 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for the page cache warm-up of task input files.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "base/common.h"
+#include "engine/executors/input_prefetcher.h"
+
+DECLARE_uint64(input_prefetch_chunk_size);
+DECLARE_uint64(input_prefetch_max_bytes);
+
+namespace firmament {
+namespace executor {
+
+class InputPrefetcherTest : public ::testing::Test {
+ protected:
+  InputPrefetcherTest()
+    : num_callbacks_(0), bytes_prefetched_(0), input_size_(0) {
+    FLAGS_input_prefetch_chunk_size = 4096;
+    FLAGS_input_prefetch_max_bytes = 1024 * 1024;
+  }
+
+  virtual ~InputPrefetcherTest() {
+    for (vector<string>::iterator it = files_.begin();
+         it != files_.end();
+         ++it) {
+      unlink(it->c_str());
+    }
+  }
+
+  // Creates a temporary file of the given size and returns its path.
+  string CreateFile(uint64_t size) {
+    char path[] = "/tmp/input_prefetcher_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK_GE(fd, 0);
+    string data(size, 'x');
+    CHECK_EQ(write(fd, data.data(), data.size()),
+             static_cast<ssize_t>(size));
+    close(fd);
+    files_.push_back(path);
+    return path;
+  }
+
+  // Returns false if the prefetches are still running after ten seconds.
+  bool WaitForPrefetches(InputPrefetcher* prefetcher) {
+    for (uint32_t i = 0; i < 10000; ++i) {
+      if (prefetcher->NumActivePrefetches() == 0)
+        return true;
+      usleep(1000);
+    }
+    return false;
+  }
+
+  // Returns false if no progress is reported within ten seconds.
+  bool WaitForProgress() {
+    for (uint32_t i = 0; i < 10000; ++i) {
+      {
+        boost::lock_guard<boost::mutex> lock(progress_lock_);
+        if (num_callbacks_ > 0)
+          return true;
+      }
+      usleep(1000);
+    }
+    return false;
+  }
+
+  vector<string> files_;
+  boost::mutex progress_lock_;
+  uint64_t num_callbacks_;
+  uint64_t bytes_prefetched_;
+  uint64_t input_size_;
+
+ public:
+  void RecordProgress(TaskID_t task_id, uint64_t bytes_prefetched,
+                      uint64_t input_size) {
+    boost::lock_guard<boost::mutex> lock(progress_lock_);
+    num_callbacks_++;
+    EXPECT_GE(bytes_prefetched, bytes_prefetched_);
+    bytes_prefetched_ = bytes_prefetched;
+    input_size_ = input_size;
+  }
+
+  // Slows the prefetch down, so that it is still running when cancelled.
+  void RecordProgressSlowly(TaskID_t task_id, uint64_t bytes_prefetched,
+                            uint64_t input_size) {
+    RecordProgress(task_id, bytes_prefetched, input_size);
+    usleep(1000);
+  }
+};
+
+TEST_F(InputPrefetcherTest, PathForLocation) {
+  EXPECT_EQ(InputPrefetcher::PathForLocation("file:///data/input"),
+            "/data/input");
+  EXPECT_EQ(InputPrefetcher::PathForLocation("/data/input"), "/data/input");
+  EXPECT_EQ(InputPrefetcher::PathForLocation("hdfs://namenode/input"), "");
+  EXPECT_EQ(InputPrefetcher::PathForLocation(""), "");
+}
+
+TEST_F(InputPrefetcherTest, PrefetchFiles) {
+  InputPrefetcher prefetcher;
+  vector<string> paths;
+  paths.push_back(CreateFile(10000));
+  paths.push_back("/nonexistent/input");
+  paths.push_back(CreateFile(5000));
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, paths, boost::bind(&InputPrefetcherTest::RecordProgress, this,
+                            _1, _2, _3)));
+  ASSERT_TRUE(WaitForPrefetches(&prefetcher));
+  // One report per chunk: three for the first file and two for the second.
+  EXPECT_EQ(num_callbacks_, 5ULL);
+  EXPECT_EQ(bytes_prefetched_, 15000ULL);
+  EXPECT_EQ(input_size_, 15000ULL);
+}
+
+TEST_F(InputPrefetcherTest, NothingToPrefetch) {
+  InputPrefetcher prefetcher;
+  vector<string> paths;
+  paths.push_back("/nonexistent/input");
+  paths.push_back(CreateFile(0));
+  EXPECT_FALSE(prefetcher.PrefetchAsync(
+      1, vector<string>(), boost::bind(&InputPrefetcherTest::RecordProgress,
+                                       this, _1, _2, _3)));
+  EXPECT_EQ(prefetcher.NumActivePrefetches(), 0ULL);
+  // The files are only found to be unreadable on the prefetch thread, which
+  // then exits without reporting progress.
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, paths, boost::bind(&InputPrefetcherTest::RecordProgress, this,
+                            _1, _2, _3)));
+  ASSERT_TRUE(WaitForPrefetches(&prefetcher));
+  EXPECT_EQ(num_callbacks_, 0ULL);
+}
+
+TEST_F(InputPrefetcherTest, MaxBytes) {
+  FLAGS_input_prefetch_max_bytes = 6000;
+  InputPrefetcher prefetcher;
+  vector<string> paths;
+  paths.push_back(CreateFile(5000));
+  paths.push_back(CreateFile(5000));
+  paths.push_back(CreateFile(5000));
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, paths, boost::bind(&InputPrefetcherTest::RecordProgress, this,
+                            _1, _2, _3)));
+  ASSERT_TRUE(WaitForPrefetches(&prefetcher));
+  EXPECT_EQ(bytes_prefetched_, 6000ULL);
+  EXPECT_EQ(input_size_, 6000ULL);
+}
+
+TEST_F(InputPrefetcherTest, Cancel) {
+  InputPrefetcher prefetcher;
+  vector<string> paths;
+  paths.push_back(CreateFile(100000));
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, paths, boost::bind(&InputPrefetcherTest::RecordProgressSlowly, this,
+                            _1, _2, _3)));
+  ASSERT_TRUE(WaitForProgress());
+  prefetcher.Cancel(1);
+  uint64_t num_callbacks;
+  {
+    boost::lock_guard<boost::mutex> lock(progress_lock_);
+    num_callbacks = num_callbacks_;
+  }
+  ASSERT_TRUE(WaitForPrefetches(&prefetcher));
+  // No progress is reported once Cancel has returned.
+  EXPECT_EQ(num_callbacks_, num_callbacks);
+  EXPECT_LT(bytes_prefetched_, 100000ULL);
+}
+
+// A cancelled prefetch does not report progress for a later prefetch of the
+// same task's inputs.
+TEST_F(InputPrefetcherTest, CancelAndRestart) {
+  InputPrefetcher prefetcher;
+  vector<string> paths;
+  paths.push_back(CreateFile(100000));
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, paths, boost::bind(&InputPrefetcherTest::RecordProgressSlowly, this,
+                            _1, _2, _3)));
+  ASSERT_TRUE(WaitForProgress());
+  prefetcher.Cancel(1);
+  {
+    boost::lock_guard<boost::mutex> lock(progress_lock_);
+    bytes_prefetched_ = 0;
+  }
+  vector<string> new_paths;
+  new_paths.push_back(CreateFile(5000));
+  EXPECT_TRUE(prefetcher.PrefetchAsync(
+      1, new_paths, boost::bind(&InputPrefetcherTest::RecordProgress, this,
+                                _1, _2, _3)));
+  ASSERT_TRUE(WaitForPrefetches(&prefetcher));
+  EXPECT_EQ(bytes_prefetched_, 5000ULL);
+  EXPECT_EQ(input_size_, 5000ULL);
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
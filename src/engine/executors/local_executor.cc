@@ -23,26 +23,30 @@
 #include "engine/executors/local_executor.h"
 
 extern "C" {
+#include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
-#ifdef __linux__
-#include <sys/prctl.h>
-#endif
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 }
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/regex.hpp>
 
 #include "base/common.h"
 #include "base/types.h"
 #include "base/units.h"
+#include "engine/executors/process_launcher.h"
 #include "engine/executors/task_health_checker.h"
+#include "engine/executors/task_heartbeat_aggregator.h"
 #include "misc/utils.h"
 #include "misc/map-util.h"
 
+DECLARE_bool(aggregate_task_heartbeats);
+
 DEFINE_bool(pin_tasks_to_cores, true,
             "Pin tasks to their allocated CPU core when executing.");
 DEFINE_bool(debug_tasks, false,
@@ -51,6 +55,28 @@ DEFINE_uint64(debug_interactively, 0,
               "Run this task ID inside an interactive debugger.");
 DEFINE_bool(perf_monitoring, true,
             "Enable performance monitoring for tasks executed.");
+DEFINE_bool(perf_event_counters, true,
+            "Read tasks' hardware counters directly with perf_event_open(2) "
+            "instead of running tasks under perf stat.");
+DEFINE_uint64(task_stats_sample_interval_ms, 0,
+              "Interval at which to sample running tasks' hardware counters "
+              "(with --perf_event_counters) and cgroup statistics (with "
+              "--task_cgroups, or else procfs statistics) into TaskStats. "
+              "0 disables sampling.");
+DEFINE_bool(task_cgroups, false,
+            "Run each task in its own cgroup v2 control group, limited to "
+            "the task's CPU and RAM request.");
+DEFINE_string(task_cgroup_root, "/sys/fs/cgroup/firmament",
+              "cgroup v2 directory below which task cgroups are created. It "
+              "must be delegated to the user running the executor.");
+DEFINE_string(zygote_binaries, "",
+              "Comma-separated list of task binaries for which to keep warm, "
+              "pre-initialized processes that tasks are handed to instead of "
+              "launching new processes. The binaries must link task_lib "
+              "through task_lib_bridge.h.");
+DEFINE_uint64(zygote_pool_size, 2,
+              "Number of warm processes to keep for each of "
+              "--zygote_binaries.");
 DEFINE_string(task_lib_dir, "build/engine/",
               "Path where task_lib.a and task_lib_inject.so are.");
 DEFINE_string(task_log_dir, "/tmp/firmament-log",
@@ -69,20 +95,61 @@ DEFINE_string(perf_event_list,
 namespace firmament {
 namespace executor {
 
+using boost::algorithm::is_any_of;
+using boost::token_compress_on;
 using common::pb_to_vector;
+using store::ObjectFetcher;
+
+// The local executors of a process share a single supervisor thread for their
+// task processes.
+static shared_ptr<ChildSupervisor> SharedChildSupervisor() {
+  static boost::mutex supervisor_mutex;
+  static weak_ptr<ChildSupervisor> shared_supervisor;
+  boost::lock_guard<boost::mutex> lock(supervisor_mutex);
+  shared_ptr<ChildSupervisor> supervisor = shared_supervisor.lock();
+  if (!supervisor) {
+    supervisor.reset(
+        new ChildSupervisor(FLAGS_task_stats_sample_interval_ms));
+    CHECK(supervisor->Start());
+    shared_supervisor = supervisor;
+  }
+  return supervisor;
+}
+
+// Likewise, they share one fetcher for task inputs, so that concurrent tasks
+// needing the same object fetch it once.
+static shared_ptr<ObjectFetcher> SharedObjectFetcher() {
+  static boost::mutex fetcher_mutex;
+  static weak_ptr<ObjectFetcher> shared_fetcher;
+  boost::lock_guard<boost::mutex> lock(fetcher_mutex);
+  shared_ptr<ObjectFetcher> fetcher = shared_fetcher.lock();
+  if (!fetcher) {
+    fetcher.reset(new ObjectFetcher(GenerateResourceID()));
+    shared_fetcher = fetcher;
+  }
+  return fetcher;
+}
 
 LocalExecutor::LocalExecutor(ResourceID_t resource_id,
                              const string& coordinator_uri,
                              TimeInterface* time_manager)
     : local_resource_id_(resource_id),
       coordinator_uri_(coordinator_uri),
-      health_checker_(&task_handler_threads_, &handler_map_mutex_),
+      health_checker_(&exited_tasks_, &pid_map_mutex_),
       time_manager_(time_manager),
       topology_manager_(shared_ptr<TopologyManager>()),  // NULL
-      heartbeat_interval_(1000000000ULL) {  // 1 billios nanosec = 1 sec
+      heartbeat_interval_(1000000000ULL),  // 1 billios nanosec = 1 sec
+      cgroups_enabled_(false),
+      procfs_monitor_(FLAGS_task_stats_sample_interval_ms *
+                      MILLISECONDS_TO_MICROSECONDS),
+      procfs_samples_time_(0) {
   VLOG(1) << "Executor for resource " << resource_id << " is up: " << *this;
   VLOG(1) << "No topology manager passed, so will not bind to resource.";
+  supervisor_ = SharedChildSupervisor();
+  object_fetcher_ = SharedObjectFetcher();
   CreateDirectories();
+  SetUpTaskCgroups();
+  SetUpZygotePools();
 }
 
 LocalExecutor::LocalExecutor(ResourceID_t resource_id,
@@ -91,14 +158,42 @@ LocalExecutor::LocalExecutor(ResourceID_t resource_id,
                              shared_ptr<TopologyManager> topology_mgr)
     : local_resource_id_(resource_id),
       coordinator_uri_(coordinator_uri),
-      health_checker_(&task_handler_threads_, &handler_map_mutex_),
+      health_checker_(&exited_tasks_, &pid_map_mutex_),
       time_manager_(time_manager),
       topology_manager_(topology_mgr),
-      heartbeat_interval_(1000000000ULL) {  // 1 billios nanosec = 1 sec
+      heartbeat_interval_(1000000000ULL),  // 1 billios nanosec = 1 sec
+      cgroups_enabled_(false),
+      procfs_monitor_(FLAGS_task_stats_sample_interval_ms *
+                      MILLISECONDS_TO_MICROSECONDS),
+      procfs_samples_time_(0) {
   VLOG(1) << "Executor for resource " << resource_id << " is up: " << *this;
   VLOG(1) << "Tasks will be bound to the resource by the topology manager"
           << "at " << topology_manager_;
+  supervisor_ = SharedChildSupervisor();
+  object_fetcher_ = SharedObjectFetcher();
   CreateDirectories();
+  SetUpTaskCgroups();
+  SetUpZygotePools();
+}
+
+LocalExecutor::~LocalExecutor() {
+  // Tasks that are still running are left alone, but their exits are no
+  // longer reported to this executor.
+  vector<pid_t> pids;
+  {
+    boost::shared_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    for (unordered_map<TaskID_t, pid_t>::const_iterator it =
+         task_pids_.begin();
+         it != task_pids_.end();
+         ++it) {
+      pids.push_back(it->second);
+    }
+  }
+  for (vector<pid_t>::const_iterator it = pids.begin();
+       it != pids.end();
+       ++it) {
+    supervisor_->Detach(*it);
+  }
 }
 
 char* LocalExecutor::AddPerfMonitoringToCommandLine(
@@ -133,19 +228,86 @@ bool LocalExecutor::CheckRunningTasksHealth(vector<TaskID_t>* failed_tasks) {
 }
 
 void LocalExecutor::CleanUpCompletedTask(const TaskDescriptor& td) {
-  // Drop task handler thread
-  boost::unique_lock<boost::shared_mutex> handler_lock(handler_map_mutex_);
+  shared_ptr<TaskCgroup> cgroup;
+  {
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    // Issue a kill to make double-sure that the task has finished, unless its
+    // process has exited already (or was never launched). The process is
+    // reaped by the supervisor when it exits.
+    // XXX(malte): this is a hack!
+    bool exited = exited_tasks_.erase(td.uid()) > 0;
+    pid_t* pid = FindOrNull(task_pids_, td.uid());
+    if (pid && !exited) {
+      int ret = kill(*pid, SIGKILL);
+      LOG(INFO) << "kill(2) for task " << td.uid() << " returned " << ret;
+    }
+    if (pid && procfs_tasks_.erase(td.uid()) > 0) {
+      procfs_monitor_.UnwatchPID(*pid);
+    }
+    task_pids_.erase(td.uid());
+    task_counters_.erase(td.uid());
+    cgroup = FindWithDefault(task_cgroups_, td.uid(),
+                             shared_ptr<TaskCgroup>());
+    task_cgroups_.erase(td.uid());
+  }
+  input_prefetcher_.Cancel(td.uid());
+  // The cgroup can only be removed once the task's remaining processes have
+  // died. This runs on the scheduling path, so rather than wait for them,
+  // leave the retries to the supervisor.
+  if (cgroup && !cgroup->Remove()) {
+    supervisor_->RetryUntilDone(boost::bind(&TaskCgroup::Remove, cgroup));
+  }
+}
+
+shared_ptr<TaskCgroup> LocalExecutor::CgroupForTask(TaskID_t task_id) {
+  boost::shared_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  return FindWithDefault(task_cgroups_, task_id, shared_ptr<TaskCgroup>());
+}
+
+shared_ptr<PerfEventCounters> LocalExecutor::CountersForTask(
+    TaskID_t task_id) {
+  boost::shared_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  return FindWithDefault(task_counters_, task_id,
+                         shared_ptr<PerfEventCounters>());
+}
+
+bool LocalExecutor::AttachCountersToTask(TaskID_t task_id, pid_t pid) {
+  // The process has exec'ed its binary already, so the counters start
+  // counting right away. Threads and processes that the task starts later
+  // inherit them.
+  shared_ptr<PerfEventCounters> counters(new PerfEventCounters(pid));
+  if (!counters->Open(false)) {
+    LOG(WARNING) << "Hardware counters unavailable for task " << task_id;
+    return false;
+  }
   boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
-  task_handler_threads_.erase(td.uid());
-  // Issue a kill to make double-sure that the task has finished
-  // XXX(malte): this is a hack!
-  pid_t* pid = FindOrNull(task_pids_, td.uid());
-  CHECK_NOTNULL(pid);
-  int ret = kill(*pid, SIGKILL);
-  LOG(INFO) << "kill(2) for task " << td.uid() << " returned " << ret;
-  task_pids_.erase(td.uid());
+  InsertOrUpdate(&task_counters_, task_id, counters);
+  return true;
 }
 
+void LocalExecutor::CreateCgroupForTask(const TaskDescriptor& td) {
+  shared_ptr<TaskCgroup> cgroup(new TaskCgroup(
+      FLAGS_task_cgroup_root + "/task-" + to_string(td.uid())));
+  if (!cgroup->Create(td.resource_request())) {
+    LOG(WARNING) << "Failed to set up cgroup for task " << td.uid()
+                 << "; running it without resource isolation.";
+    return;
+  }
+  boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+  InsertOrUpdate(&task_cgroups_, td.uid(), cgroup);
+}
+
+void LocalExecutor::DropCgroupForTask(TaskID_t task_id,
+                                      shared_ptr<TaskCgroup>* cgroup) {
+  LOG(WARNING) << "Task " << task_id << " failed to join cgroup "
+               << (*cgroup)->path() << "; running it without resource "
+               << "isolation.";
+  {
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    task_cgroups_.erase(task_id);
+  }
+  cgroup->reset();
+}
 
 void LocalExecutor::CreateDirectories() {
   struct stat st;
@@ -166,6 +328,21 @@ void LocalExecutor::CreateDirectories() {
   }
 }
 
+void LocalExecutor::FetchTaskInputs(const TaskDescriptor& td) {
+  for (auto& dependency : td.dependencies()) {
+    if (dependency.replica_endpoints_size() == 0)
+      continue;
+    DataObjectID_t id(DataObjectIDFromProtobuf(dependency.id()));
+    vector<string> replicas = pb_to_vector(dependency.replica_endpoints());
+    // Fails without fetching if the object is already here or in flight.
+    if (object_fetcher_->FetchAsync(id, dependency.size(), replicas,
+                                    ObjectFetcher::FetchCallback())) {
+      VLOG(1) << "Fetching input " << id << " of task " << td.uid()
+              << " from " << replicas.size() << " replicas";
+    }
+  }
+}
+
 void LocalExecutor::GetPerfDataFromLine(TaskFinalReport* report,
                                         const string& line) {
   boost::regex e("[[:space:]]*? ([0-9,.]+) ([a-zA-Z-]+) .*");
@@ -200,7 +377,7 @@ void LocalExecutor::HandleTaskCompletion(TaskDescriptor* td,
   report->set_start_time(start_time);
   report->set_finish_time(end_time);
   // Load perf data, if it exists
-  if (FLAGS_perf_monitoring) {
+  if (FLAGS_perf_monitoring && !FLAGS_perf_event_counters) {
     FILE* fptr;
     char line[1024];
     string file_name = PerfDataFileName(*td);
@@ -227,6 +404,11 @@ void LocalExecutor::HandleTaskCompletion(TaskDescriptor* td,
                  << "contain data!";
     }
   } else {
+    shared_ptr<PerfEventCounters> counters = CountersForTask(td->uid());
+    PerfCounterValues values;
+    if (counters && counters->Read(&values)) {
+      PerfEventCounters::PopulateTaskFinalReport(values, report);
+    }
     // TODO(malte): this is a bit of a hack -- when we don't have the perf
     // information available, we use the executor's runtime measurements.
     // They should be identical, however, so maybe we should just always do
@@ -238,10 +420,41 @@ void LocalExecutor::HandleTaskCompletion(TaskDescriptor* td,
   CleanUpCompletedTask(*td);
 }
 
+void LocalExecutor::HandleTaskExit(TaskID_t task_id, pid_t pid, int status) {
+  if (WIFEXITED(status)) {
+    VLOG(1) << "Task process with PID " << pid << " exited with status "
+            << WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    VLOG(1) << "Task process with PID " << pid << " exited due to uncaught "
+            << "signal " << WTERMSIG(status);
+  } else {
+    LOG(ERROR) << "Unexpected exit status: " << hex << status;
+  }
+  // The cgroup's statistics remain readable until it is removed, so
+  // record the task's final resource usage.
+  if (task_stats_handler_ && CgroupForTask(task_id)) {
+    SampleTask(task_id);
+  }
+  {
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    pid_t* task_pid = FindOrNull(task_pids_, task_id);
+    if (!task_pid || *task_pid != pid) {
+      // The task was cleaned up already.
+      return;
+    }
+    exited_tasks_.insert(task_id);
+  }
+  if (task_exit_handler_) {
+    task_exit_handler_(task_id, status);
+  }
+}
+
 void LocalExecutor::HandleTaskEviction(TaskDescriptor* td) {
   td->set_finish_time(time_manager_->GetCurrentTimestamp());
   td->set_total_run_time(UpdateTaskTotalRunTime(*td));
   td->set_submit_time(time_manager_->GetCurrentTimestamp());
+  // The task no longer runs here, so its inputs need not be cached here.
+  input_prefetcher_.Cancel(td->uid());
   // TODO(ionel): Implement.
 }
 
@@ -261,14 +474,13 @@ void LocalExecutor::RunTask(TaskDescriptor* td,
   // Mark the start time of the task.
   td->set_start_time(start_time);
   td->set_total_unscheduled_time(UpdateTaskTotalUnscheduledTime(*td));
-  // XXX(malte): Move this over to use RunProcessAsync, instead of custom thread
-  // spawning.
-  boost::unique_lock<boost::mutex> exec_lock(exec_mutex_);
-  boost::unique_lock<boost::shared_mutex> handler_lock(handler_map_mutex_);
-  boost::thread* task_thread = new boost::thread(
-      boost::bind(&LocalExecutor::_RunTask, this, td, firmament_binary));
-  CHECK(InsertIfNotPresent(&task_handler_threads_, td->uid(), task_thread));
-  exec_condvar_.wait(exec_lock);
+  FetchTaskInputs(*td);
+  PrefetchTaskInputs(*td);
+  if (!_RunTask(td, firmament_binary)) {
+    // The next health check reports the task as failed.
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    exited_tasks_.insert(td->uid());
+  }
 }
 
 bool LocalExecutor::_RunTask(TaskDescriptor* td,
@@ -283,6 +495,10 @@ bool LocalExecutor::_RunTask(TaskDescriptor* td,
   }
   // Environment variables
   SetUpEnvironmentForTask(*td, &env);
+  // Resource isolation
+  if (cgroups_enabled_) {
+    CreateCgroupForTask(*td);
+  }
   // Path for task log files (stdout/stderr)
   string tasklog = FLAGS_task_log_dir + "/" + td->job_id() +
                    "-" + to_string(td->uid());
@@ -290,41 +506,23 @@ bool LocalExecutor::_RunTask(TaskDescriptor* td,
   // arguments: binary (path + name), arguments, performance monitoring on/off,
   // debugging flags, is this a Firmament task binary? (on/off; will cause
   // default arugments to be passed)
-  bool res = (RunProcessSync(
+  bool res = (StartProcess(
       td->uid(), td->binary(), args, env, FLAGS_perf_monitoring,
       (FLAGS_debug_tasks || ((FLAGS_debug_interactively != 0) &&
                              (td->uid() == FLAGS_debug_interactively))),
-      firmament_binary, tasklog) == 0);
-  VLOG(1) << "Result of RunProcessSync was " << res;
+      firmament_binary, tasklog) >= 0);
+  VLOG(1) << "Result of StartProcess was " << res;
   return res;
 }
 
-int32_t LocalExecutor::RunProcessAsync(TaskID_t task_id,
-                                       const string& cmdline,
-                                       vector<string> args,
-                                       unordered_map<string, string> env,
-                                       bool perf_monitoring,
-                                       bool debug,
-                                       bool default_args,
-                                       const string& tasklog) {
-  // TODO(malte): We lose the thread reference here, so we can never join this
-  // thread. Need to return or store if we ever need it for anythign again.
-  boost::thread async_process_thread(
-      boost::bind(&LocalExecutor::RunProcessSync, this, task_id, cmdline, args,
-                  env, perf_monitoring, debug, default_args, tasklog));
-  // We hard-code the return to zero here; maybe should return a thread
-  // reference instead.
-  return 0;
-}
-
-int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
-                                      const string& cmdline,
-                                      vector<string> args,
-                                      unordered_map<string, string> env,
-                                      bool perf_monitoring,
-                                      bool debug,
-                                      bool default_args,
-                                      const string& tasklog) {
+pid_t LocalExecutor::StartProcess(TaskID_t task_id,
+                                  const string& cmdline,
+                                  vector<string> args,
+                                  unordered_map<string, string> env,
+                                  bool perf_monitoring,
+                                  bool debug,
+                                  bool default_args,
+                                  const string& tasklog) {
   pid_t pid;
   /*int pipe_to[2];    // pipe to feed input data to task
   int pipe_from[3];  // pipe to receive output data from task
@@ -335,26 +533,25 @@ int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
     PLOG(ERROR) << "Failed to create pipe from task.";
   }*/
   vector<char*> argv;
-  vector<char*> envv;
-  // Get paths for task logs
-  string tasklog_stdout = tasklog + "-stdout";
-  string tasklog_stderr = tasklog + "-stderr";
   // N.B.: only one of debug and perf_monitoring can be active at a time;
   // debug takes priority here.
+  bool perf_event_counters =
+    perf_monitoring && !debug && FLAGS_perf_event_counters;
+  shared_ptr<TaskCgroup> cgroup = CgroupForTask(task_id);
   if (debug) {
     // task debugging is active, so reserve extra space for the
     // gdb invocation prefix.
-    argv.reserve(args.size() + (default_args ? 4 : 3));
+    argv.reserve(args.size() + (default_args ? 3 : 2));
     AddDebuggingToCommandLine(&argv);
-  } else if (perf_monitoring) {
+  } else if (perf_monitoring && !FLAGS_perf_event_counters) {
     // performance monitoring is active, so reserve extra space for the
     // "perf" invocation prefix.
-    argv.reserve(args.size() + (default_args ? 11 : 10));
+    argv.reserve(args.size() + (default_args ? 10 : 9));
     AddPerfMonitoringToCommandLine(env, &argv);
   } else {
     // no performance monitoring, so we only need to reserve space for the
-    // default and NULL args
-    argv.reserve(args.size() + (default_args ? 2 : 1));
+    // default args
+    argv.reserve(args.size() + (default_args ? 1 : 0));
   }
   argv.push_back((char*)(cmdline.c_str()));  // NOLINT
   if (default_args)
@@ -362,120 +559,166 @@ int32_t LocalExecutor::RunProcessSync(TaskID_t task_id,
         (char*)"--tryfromenv=coordinator_uri,resource_id,task_id");  // NOLINT
   for (uint32_t i = 0; i < args.size(); ++i) {
     // N.B.: This casts away the const qualifier on the c_str() result.
-    // Unsafe, but okay since args lives beyond the execvpe call.
+    // Unsafe, but okay since args lives beyond the launcher's construction.
     VLOG(1) << "Adding extra argument \"" << args[i] << "\"";
     argv.push_back((char*)(args[i].c_str()));  // NOLINT
   }
-  vector<string> env_strings(env.size());
-  uint64_t i = 0;
-  for (unordered_map<string, string>::const_iterator it = env.begin();
-       it != env.end();
-       ++it) {
-    env_strings[i] = it->first + "=" + it->second;
-    // N.B.: This casts away the const qualifier on the c_str() result.
-    // Unsafe, but okay since env_str lives beyond the execvpe call.
-    envv.push_back((char*)(env_strings[i].c_str()));  // NOLINT
-    ++i;
-  }
-  // The last item in the argv and envp for execvpe is always NULL.
-  argv.push_back(NULL);
-  envv.push_back(NULL);
   // Print the whole command line
   string full_cmd_line;
   for (vector<char*>::const_iterator arg_iter = argv.begin();
        arg_iter != argv.end();
        ++arg_iter) {
-    if (*arg_iter != NULL) {
-      full_cmd_line += *arg_iter;
-      full_cmd_line += " ";
-    }
+    full_cmd_line += *arg_iter;
+    full_cmd_line += " ";
   }
   LOG(INFO) << "COMMAND LINE for task " << task_id << ": "
             << full_cmd_line;
-  VLOG(1) << "About to fork child process for task execution of "
-          << task_id << "!";
-  pid = fork();
-  switch (pid) {
-    case -1:
-      // Error
-      LOG(ERROR) << "Failed to fork child process.";
-      break;
-    case 0: {
-      // Child
-      // Set up stderr and stdout log redirections to files
-      int stdout_fd = open(tasklog_stdout.c_str(),
-                           O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-      dup2(stdout_fd, STDOUT_FILENO);
-      int stderr_fd = open(tasklog_stderr.c_str(),
-                           O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-      dup2(stderr_fd, STDERR_FILENO);
-      if (close(stdout_fd) != 0)
-        PLOG(FATAL) << "Failed to close stdout FD in child";
-      if (close(stderr_fd) != 0)
-        PLOG(FATAL) << "Failed to close stderr FD in child";
-
-      // Change to task's working directory
-      if (!FindOrNull(env, "FLAGS_task_data_dir") &&
-          !env["FLAGS_task_data_dir"].empty()) {
-        CHECK_EQ(chdir(env["FLAGS_task_data_dir"].c_str()), 0);
-      }
+  // Hand the task to a warm process if we keep them for its binary. Tasks
+  // that run under perf stat or a debugger need a new process.
+  pid = -1;
+  shared_ptr<ZygotePool> zygote_pool =
+    FindWithDefault(zygote_pools_, cmdline, shared_ptr<ZygotePool>());
+  if (zygote_pool && default_args && !debug &&
+      (!perf_monitoring || FLAGS_perf_event_counters)) {
+    pid = RunOnWarmProcess(zygote_pool.get(), task_id, argv, env, tasklog,
+                           &cgroup, &perf_event_counters);
+  }
+  bool launched = false;
+  shared_ptr<PerfEventCounters> counters;
+  if (pid < 0) {
+    // Everything the child needs is built here, before it is created.
+    ProcessLauncher launcher(vector<string>(argv.begin(), argv.end()), env);
+    launcher.set_stdout_path(tasklog + "-stdout");
+    launcher.set_stderr_path(tasklog + "-stderr");
+    if (cgroup) {
+      launcher.set_cgroup_path(cgroup->path());
+    }
+    if (perf_event_counters) {
+      // Opened by the process before it execs, and enabled by the exec, the
+      // counters cover the task from its first instruction.
+      counters.reset(new PerfEventCounters(0));
+      launcher.set_perf_event_counters(counters.get());
+    }
+    VLOG(1) << "About to launch child process for task execution of "
+            << task_id << "!";
+    // The supervisor thread creates the process, so that the process's
+    // parent-death signal is tied to the supervisor rather than this thread.
+    int exec_errno;
+    pid = supervisor_->Launch(&launcher, &exec_errno);
+    if (pid < 0) {
+      LOG(ERROR) << "Failed to launch child process for task " << task_id;
+      return -1;
+    }
+    launched = true;
+    if (cgroup && !launcher.joined_cgroup()) {
+      DropCgroupForTask(task_id, &cgroup);
+    }
+  }
+  VLOG(1) << "Task process with PID " << pid << " created.";
+  if (launched && perf_event_counters) {
+    if (counters->is_open()) {
+      boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+      InsertOrUpdate(&task_counters_, task_id, counters);
+    } else {
+      // The process did not open the counters before it exec'ed (e.g. on
+      // the fork launch path), so they miss the task's start-up.
+      perf_event_counters = AttachCountersToTask(task_id, pid);
+    }
+  }
+  {
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    CHECK(InsertIfNotPresent(&task_pids_, task_id, pid));
+  }
+  // Pin the task to the appropriate resource
+  if (topology_manager_ && FLAGS_pin_tasks_to_cores)
+    topology_manager_->BindPIDToResource(pid, local_resource_id_);
+  // The supervisor reports the task's exit to HandleTaskExit and samples it
+  // while it runs.
+  // Tasks without a cgroup have their process trees sampled from procfs.
+  ChildSupervisor::SampleCallback on_sample;
+  if (FLAGS_task_stats_sample_interval_ms > 0 && task_stats_handler_) {
+    if (!cgroup) {
+      boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+      procfs_tasks_.insert(task_id);
+      procfs_monitor_.WatchPID(pid);
+    }
+    on_sample = boost::bind(&LocalExecutor::SampleTask, this, task_id);
+  }
+  if (!supervisor_->Watch(pid, boost::bind(&LocalExecutor::HandleTaskExit,
+                                           this, task_id, pid, _1),
+                          on_sample)) {
+    LOG(ERROR) << "Failed to supervise process " << pid << " of task "
+               << task_id << "; killing it.";
+    kill(pid, SIGKILL);
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    task_pids_.erase(task_id);
+    if (procfs_tasks_.erase(task_id) > 0) {
+      procfs_monitor_.UnwatchPID(pid);
+    }
+    return -1;
+  }
+  return pid;
+}
 
-      // Close the open FDs in the child before exec-ing, so that the task does
-      // not inherit all of the coordinator's sockets and FDs.
-      // We start from 3 here in order to avoid closing stdin/stdout/stderr.
-      int fd;
-      int fds;
-      if ((fds = getdtablesize()) == -1) fds = OPEN_MAX_GUESS;
-      for (fd = 3; fd < fds; fd++) {
-        if (close(fd) == -EBADF)
-          break;
-      }
+pid_t LocalExecutor::RunOnWarmProcess(ZygotePool* zygote_pool,
+                                      TaskID_t task_id,
+                                      const vector<char*>& argv,
+                                      const unordered_map<string, string>& env,
+                                      const string& tasklog,
+                                      shared_ptr<TaskCgroup>* cgroup,
+                                      bool* perf_event_counters) {
+  WarmProcess process;
+  if (!zygote_pool->Acquire(&process)) {
+    VLOG(1) << "No warm process for " << zygote_pool->binary() << " is idle";
+    return -1;
+  }
+  if (*cgroup && !(*cgroup)->AddProcess(process.pid)) {
+    DropCgroupForTask(task_id, cgroup);
+  }
+  // The warm process has exec'ed already, so the counters count right away.
+  // They cover the threads that the task starts, but not task_lib's threads,
+  // which already exist.
+  if (*perf_event_counters) {
+    *perf_event_counters = AttachCountersToTask(task_id, process.pid);
+  }
+  ZygoteTaskMessage task;
+  task.set_task_id(task_id);
+  for (uint32_t i = 1; i < argv.size(); ++i) {
+    task.add_args(argv[i]);
+  }
+  for (unordered_map<string, string>::const_iterator it = env.begin();
+       it != env.end();
+       ++it) {
+    task.add_env(it->first + "=" + it->second);
+  }
+  task.set_stdout_path(tasklog + "-stdout");
+  task.set_stderr_path(tasklog + "-stderr");
+  if (!zygote_pool->Assign(process, task)) {
+    boost::unique_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    task_counters_.erase(task_id);
+    return -1;
+  }
+  VLOG(1) << "Task " << task_id << " handed to warm process " << process.pid;
+  return process.pid;
+}
 
-      // kill child process if parent terminates
-      // SOMEDAY(adam): make this portable beyond Linux?
-#ifdef __linux__
-      prctl(PR_SET_PDEATHSIG, SIGHUP);
-#endif
-
-      // Run the task binary
-      execvpe(argv[0], &argv[0], &envv[0]);
-      // execl only returns if there was an error
-      PLOG(ERROR) << "execvp failed for task command '" << full_cmd_line << "'";
-      //ReportTaskExecutionFailure();
-      _exit(1);
-    }
-    default:
-      // Parent
-      VLOG(1) << "Task process with PID " << pid << " created.";
-      {
-        boost::unique_lock<boost::shared_mutex> handler_lock(pid_map_mutex_);
-        CHECK(InsertIfNotPresent(&task_pids_, task_id, pid));
-      }
-      // Pin the task to the appropriate resource
-      if (topology_manager_ && FLAGS_pin_tasks_to_cores)
-        topology_manager_->BindPIDToResource(pid, local_resource_id_);
-      // Notify any other threads waiting to execute processes (?)
-      exec_condvar_.notify_one();
-      // Wait for task to terminate
-      int status;
-      while (waitpid(pid, &status, 0) != pid) {
-        VLOG(3) << "Waiting for child process " << pid << " to exit...";
-      }
-      if (WIFEXITED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " exited with status "
-                << WEXITSTATUS(status);
-      } else if (WIFSIGNALED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " exited due to uncaught "
-                << "signal " << WTERMSIG(status);
-      } else if (WIFSTOPPED(status)) {
-        VLOG(1) << "Task process with PID " << pid << " is stopped due to "
-                << "signal " << WSTOPSIG(status);
-      } else {
-        LOG(ERROR) << "Unexpected exit status: " << hex << status;
-      }
-      return status;
+void LocalExecutor::PrefetchTaskInputs(const TaskDescriptor& td) {
+  vector<string> paths;
+  for (auto& dependency : td.dependencies()) {
+    if (!dependency.prefetch())
+      continue;
+    string path = InputPrefetcher::PathForLocation(dependency.location());
+    if (!path.empty())
+      paths.push_back(path);
+  }
+  if (paths.empty())
+    return;
+  if (input_prefetcher_.PrefetchAsync(td.uid(), paths,
+                                     input_prefetch_handler_)) {
+    VLOG(1) << "Prefetching " << paths.size() << " inputs of task "
+            << td.uid();
   }
-  return -1;
 }
 
 string LocalExecutor::PerfDataFileName(const TaskDescriptor& td) {
@@ -484,6 +727,125 @@ string LocalExecutor::PerfDataFileName(const TaskDescriptor& td) {
   return fname;
 }
 
+bool LocalExecutor::SampleTaskProcesses(pid_t pid, TaskStats* stats) {
+  boost::lock_guard<boost::mutex> lock(procfs_samples_mutex_);
+  // The supervisor samples all tasks in the same tick. The first of them
+  // reads every watched process tree in one pass, and the others use the
+  // result.
+  uint64_t now = time_manager_->GetCurrentTimestamp();
+  if (now - procfs_samples_time_ >=
+      FLAGS_task_stats_sample_interval_ms * MILLISECONDS_TO_MICROSECONDS / 2) {
+    procfs_samples_.clear();
+    procfs_monitor_.SampleWatchedPIDs(&procfs_samples_);
+    procfs_samples_time_ = now;
+  }
+  const platform_unix::ProcessStatistics* sample =
+      FindOrNull(procfs_samples_, pid);
+  if (!sample)
+    return false;
+  uint64_t rss_kb =
+      sample->rss * procfs_monitor_.page_size() / KB_TO_BYTES;
+  stats->set_mem_usage(rss_kb);
+  stats->set_mem_rss(rss_kb);
+  stats->set_mem_page_faults(sample->minflt + sample->majflt);
+  stats->set_major_page_faults(sample->majflt);
+  stats->set_cpu_time((sample->utime + sample->stime) *
+                      SECONDS_TO_MICROSECONDS /
+                      procfs_monitor_.ticks_per_sec());
+  return true;
+}
+
+void LocalExecutor::SampleTask(TaskID_t task_id) {
+  shared_ptr<PerfEventCounters> counters = CountersForTask(task_id);
+  shared_ptr<TaskCgroup> cgroup = CgroupForTask(task_id);
+  pid_t pid = 0;
+  {
+    boost::shared_lock<boost::shared_mutex> pid_lock(pid_map_mutex_);
+    if (procfs_tasks_.count(task_id) > 0) {
+      pid = FindWithDefault(task_pids_, task_id, 0);
+    }
+  }
+  TaskStats stats;
+  bool sampled = false;
+  PerfCounterValues values;
+  if (counters && counters->Read(&values)) {
+    PerfEventCounters::PopulateTaskStats(values, &stats);
+    sampled = true;
+  }
+  if (pid > 0 && SampleTaskProcesses(pid, &stats)) {
+    sampled = true;
+  }
+  CgroupStats cgroup_stats;
+  if (cgroup && cgroup->Read(&cgroup_stats)) {
+    cgroup->PopulateTaskStats(cgroup_stats, &stats);
+    sampled = true;
+  }
+  if (!sampled)
+    return;
+  stats.set_task_id(task_id);
+  stats.set_timestamp(time_manager_->GetCurrentTimestamp());
+  task_stats_handler_(stats);
+}
+
+void LocalExecutor::SetUpTaskCgroups() {
+  if (!FLAGS_task_cgroups)
+    return;
+  cgroups_enabled_ = TaskCgroup::SetUpRoot(FLAGS_task_cgroup_root);
+  if (!cgroups_enabled_) {
+    LOG(ERROR) << "Failed to set up task cgroups below "
+               << FLAGS_task_cgroup_root << "; tasks will run without "
+               << "resource isolation.";
+  }
+}
+
+void LocalExecutor::SetUpZygotePools() {
+  if (FLAGS_zygote_binaries.empty() || FLAGS_zygote_pool_size == 0)
+    return;
+  if (coordinator_uri_.empty()) {
+    LOG(WARNING) << "Not keeping warm task processes, since the executor does "
+                 << "not know the coordinator's URI.";
+    return;
+  }
+  // Task-specific variables are passed to the warm process with its task.
+  unordered_map<string, string> env;
+  SetUpCommonEnvironment(&env);
+  vector<string> binaries;
+  boost::split(binaries, FLAGS_zygote_binaries, is_any_of(","),
+               token_compress_on);
+  for (uint32_t i = 0; i < binaries.size(); ++i) {
+    if (binaries[i].empty())
+      continue;
+    string name = "zygote-" + to_string(local_resource_id_) + "-" +
+      to_string(i);
+    shared_ptr<ZygotePool> pool(new ZygotePool(
+        binaries[i], env, FLAGS_task_data_dir + "/" + name + ".sock",
+        FLAGS_task_log_dir + "/" + name, FLAGS_zygote_pool_size));
+    if (pool->Start()) {
+      LOG(INFO) << "Keeping " << FLAGS_zygote_pool_size << " warm processes "
+                << "for " << binaries[i];
+      InsertIfNotPresent(&zygote_pools_, binaries[i], pool);
+    }
+  }
+}
+
+void LocalExecutor::SetUpCommonEnvironment(
+    unordered_map<string, string>* env) {
+  // N.B.: we pass a completely scrubbed environment to the task, so we need to
+  // define even things like PATH that would normally be inherited.
+  InsertIfNotPresent(env, "PATH",
+      "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin");
+  InsertIfNotPresent(env, "FLAGS_coordinator_uri", coordinator_uri_);
+  InsertIfNotPresent(env, "FLAGS_resource_id", to_string(local_resource_id_));
+  InsertIfNotPresent(env, "FLAGS_heartbeat_interval",
+                     to_string(heartbeat_interval_));
+  // Tasks fall back to their coordinator connection if nothing listens on the
+  // socket.
+  if (FLAGS_aggregate_task_heartbeats) {
+    InsertIfNotPresent(env, "FLAGS_task_heartbeat_socket",
+        TaskHeartbeatAggregator::SocketPathForCoordinator(coordinator_uri_));
+  }
+}
+
 void LocalExecutor::SetUpEnvironmentForTask(
     const TaskDescriptor& td,
     unordered_map<string, string>* env) {
@@ -496,16 +858,9 @@ void LocalExecutor::SetUpEnvironmentForTask(
                     to_string(td.uid());
   mkdir(data_dir.c_str(), 0700);
   // Set environment variables
-  // N.B.: we pass a completely scrubbed environment to the task, so we need to
-  // define even things like PATH that would normally be inherited.
-  InsertIfNotPresent(env, "PATH",
-      "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin");
+  SetUpCommonEnvironment(env);
   InsertIfNotPresent(env, "FLAGS_task_id", to_string(td.uid()));
   InsertIfNotPresent(env, "PERF_FNAME", PerfDataFileName(td));
-  InsertIfNotPresent(env, "FLAGS_coordinator_uri", coordinator_uri_);
-  InsertIfNotPresent(env, "FLAGS_resource_id", to_string(local_resource_id_));
-  InsertIfNotPresent(env, "FLAGS_heartbeat_interval",
-                     to_string(heartbeat_interval_));
   InsertIfNotPresent(env, "FLAGS_task_data_dir", data_dir);
   if (td.inject_task_lib()) {
     InsertIfNotPresent(env, "LD_LIBRARY_PATH", FLAGS_task_lib_dir +
@@ -43,9 +43,17 @@
 #include "base/common.h"
 #include "base/types.h"
 #include "base/task_final_report.pb.h"
+#include "base/task_stats.pb.h"
+#include "engine/executors/child_supervisor.h"
+#include "engine/executors/input_prefetcher.h"
+#include "engine/executors/perf_event_counters.h"
+#include "engine/executors/task_cgroup.h"
 #include "engine/executors/task_health_checker.h"
 #include "engine/executors/topology_manager.h"
+#include "engine/executors/zygote_pool.h"
 #include "misc/time_interface.h"
+#include "platforms/unix/procfs_monitor.h"
+#include "storage/object_fetcher.h"
 
 namespace firmament {
 namespace executor {
@@ -61,6 +69,7 @@ class LocalExecutor : public ExecutorInterface {
                 const string& coordinator_uri,
                 TimeInterface* time_manager,
                 shared_ptr<TopologyManager> topology_mgr);
+  ~LocalExecutor();
   bool CheckRunningTasksHealth(vector<TaskID_t>* failed_tasks);
   void HandleTaskCompletion(TaskDescriptor* td,
                             TaskFinalReport* report);
@@ -68,6 +77,35 @@ class LocalExecutor : public ExecutorInterface {
   void HandleTaskFailure(TaskDescriptor* td);
   void RunTask(TaskDescriptor* td,
                bool firmament_binary);
+  /**
+   * Sets the handler that receives periodic hardware counter and cgroup
+   * samples for running tasks (see --task_stats_sample_interval_ms).
+   * @param handler the function to call with each sample
+   */
+  void SetTaskStatsHandler(boost::function<void(const TaskStats&)> handler) {
+    task_stats_handler_ = handler;
+  }
+  /**
+   * Sets the handler that receives the progress of the page cache warm-up
+   * of tasks' input files.
+   * @param handler the function to call with the task's ID, the number of
+   * bytes prefetched so far and the total number of bytes being prefetched
+   */
+  void SetInputPrefetchHandler(
+      boost::function<void(TaskID_t, uint64_t, uint64_t)> handler) {
+    input_prefetch_handler_ = handler;
+  }
+  /**
+   * Sets the handler that is notified as soon as a task's process exits. The
+   * handler runs on the supervisor thread that is shared by all local
+   * executors of the process. Tasks are launched on that thread while the
+   * scheduler holds its locks, so the handler must not take them.
+   * @param handler the function to call with the task's ID and wait(2)
+   * status
+   */
+  void SetTaskExitHandler(boost::function<void(TaskID_t, int)> handler) {
+    task_exit_handler_ = handler;
+  }
   virtual ostream& ToString(ostream* stream) const {
     return *stream << "<LocalExecutor at resource "
                    << to_string(local_resource_id_)
@@ -86,32 +124,55 @@ class LocalExecutor : public ExecutorInterface {
   char* AddPerfMonitoringToCommandLine(const unordered_map<string, string>&,
                                        vector<char*>* argv);
   char* AddDebuggingToCommandLine(vector<char*>* argv);
+  bool AttachCountersToTask(TaskID_t task_id, pid_t pid);
+  shared_ptr<TaskCgroup> CgroupForTask(TaskID_t task_id);
   void CleanUpCompletedTask(const TaskDescriptor& td);
+  shared_ptr<PerfEventCounters> CountersForTask(TaskID_t task_id);
+  void CreateCgroupForTask(const TaskDescriptor& td);
   void CreateDirectories();
+  void DropCgroupForTask(TaskID_t task_id, shared_ptr<TaskCgroup>* cgroup);
+  /**
+   * Starts fetching the task's input objects that are not present on this
+   * machine. The fetches run while the task starts up; the task waits for
+   * an object when it first accesses it.
+   * @param td the descriptor of the task about to be started
+   */
+  void FetchTaskInputs(const TaskDescriptor& td);
   void GetPerfDataFromLine(TaskFinalReport* report,
                            const string& line);
-  int32_t RunProcessAsync(TaskID_t task_id,
-                          const string& cmdline,
-                          vector<string> args,
-                          unordered_map<string, string> env,
-                          bool perf_monitoring,
-                          bool debug,
-                          bool default_args,
-                          const string& tasklog);
-  int32_t RunProcessSync(TaskID_t task_id,
-                         const string& cmdline,
-                         vector<string> args,
-                         unordered_map<string, string> env,
-                         bool perf_monitoring,
-                         bool debug,
-                         bool default_args,
-                         const string& tasklog);
+  void HandleTaskExit(TaskID_t task_id, pid_t pid, int status);
+  /**
+   * Starts warming up the page cache with the task's input files that the
+   * scheduler marked for prefetching.
+   * @param td the descriptor of the task about to be started
+   */
+  void PrefetchTaskInputs(const TaskDescriptor& td);
+  pid_t StartProcess(TaskID_t task_id,
+                     const string& cmdline,
+                     vector<string> args,
+                     unordered_map<string, string> env,
+                     bool perf_monitoring,
+                     bool debug,
+                     bool default_args,
+                     const string& tasklog);
   bool _RunTask(TaskDescriptor* td,
                 bool firmament_binary);
+  pid_t RunOnWarmProcess(ZygotePool* zygote_pool,
+                         TaskID_t task_id,
+                         const vector<char*>& argv,
+                         const unordered_map<string, string>& env,
+                         const string& tasklog,
+                         shared_ptr<TaskCgroup>* cgroup,
+                         bool* perf_event_counters);
   string PerfDataFileName(const TaskDescriptor& td);
   void ReadFromPipe(int fd);
+  bool SampleTaskProcesses(pid_t pid, TaskStats* stats);
+  void SampleTask(TaskID_t task_id);
+  void SetUpCommonEnvironment(unordered_map<string, string>* env);
   void SetUpEnvironmentForTask(const TaskDescriptor& td,
                                unordered_map<string, string>* env);
+  void SetUpTaskCgroups();
+  void SetUpZygotePools();
   char* TokenizeIntoArgv(const string& str, vector<char*>* argv);
   bool WaitForPerfFile(const string& file_name);
   void WriteToPipe(int fd, void* data, size_t len);
@@ -128,13 +189,38 @@ class LocalExecutor : public ExecutorInterface {
   // Heartbeat interval for tasks running on the associated resource, in
   // nanoseconds.
   uint64_t heartbeat_interval_;
-  boost::mutex exec_mutex_;
-  boost::shared_mutex handler_map_mutex_;
+  // True if --task_cgroups is set and the cgroup root was set up.
+  bool cgroups_enabled_;
+  // Creates, watches and reaps task processes.
+  shared_ptr<ChildSupervisor> supervisor_;
+  // Fetches task inputs from other machines into the local object store.
+  shared_ptr<store::ObjectFetcher> object_fetcher_;
+  // Reads task input files into the page cache.
+  InputPrefetcher input_prefetcher_;
   boost::shared_mutex pid_map_mutex_;
-  boost::condition_variable exec_condvar_;
-  // Map to each task's local handler thread
-  unordered_map<TaskID_t, boost::thread*> task_handler_threads_;
   unordered_map<TaskID_t, pid_t> task_pids_;
+  // Tasks whose process has exited or failed to launch, but which have not
+  // been cleaned up yet; guarded by pid_map_mutex_.
+  unordered_set<TaskID_t> exited_tasks_;
+  // Hardware counters of tasks started with --perf_event_counters; guarded
+  // by pid_map_mutex_.
+  unordered_map<TaskID_t, shared_ptr<PerfEventCounters>> task_counters_;
+  // Cgroups of tasks started with --task_cgroups; guarded by pid_map_mutex_.
+  unordered_map<TaskID_t, shared_ptr<TaskCgroup>> task_cgroups_;
+  // Tasks without a cgroup whose process trees are sampled from procfs;
+  // guarded by pid_map_mutex_.
+  unordered_set<TaskID_t> procfs_tasks_;
+  // Samples the process trees of procfs_tasks_ in one pass, which serves all
+  // of their samples in a supervisor tick.
+  platform_unix::ProcFSMonitor procfs_monitor_;
+  boost::mutex procfs_samples_mutex_;
+  unordered_map<pid_t, platform_unix::ProcessStatistics> procfs_samples_;
+  uint64_t procfs_samples_time_;
+  // Warm processes for --zygote_binaries, keyed by binary.
+  unordered_map<string, shared_ptr<ZygotePool>> zygote_pools_;
+  boost::function<void(const TaskStats&)> task_stats_handler_;
+  boost::function<void(TaskID_t, int)> task_exit_handler_;
+  boost::function<void(TaskID_t, uint64_t, uint64_t)> input_prefetch_handler_;
 };
 
 }  // namespace executor
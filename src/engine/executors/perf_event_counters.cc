@@ -0,0 +1,176 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Hardware performance counters for a task process, read directly through
+// perf_event_open(2).
+
+#include "engine/executors/perf_event_counters.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace firmament {
+namespace executor {
+
+namespace {
+
+// Layout of a counter read with PERF_FORMAT_TOTAL_TIME_ENABLED and
+// PERF_FORMAT_TOTAL_TIME_RUNNING.
+struct CounterReading {
+  uint64_t value;
+  uint64_t time_enabled;
+  uint64_t time_running;
+};
+
+int PerfEventOpen(struct perf_event_attr* attr, pid_t pid, int group_fd) {
+  return static_cast<int>(syscall(__NR_perf_event_open, attr, pid, -1,
+                                  group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+}  // namespace
+
+PerfEventCounters::PerfEventCounters(pid_t pid) : pid_(pid) {
+  for (uint32_t i = 0; i < NUM_COUNTERS; ++i) {
+    fds_[i] = -1;
+  }
+}
+
+PerfEventCounters::~PerfEventCounters() {
+  Close();
+}
+
+void PerfEventCounters::Close() {
+  for (uint32_t i = 0; i < NUM_COUNTERS; ++i) {
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+bool PerfEventCounters::Open(bool enable_on_exec) {
+  if (OpenCounters(enable_on_exec, false)) {
+    return true;
+  }
+  if (errno == EACCES || errno == EPERM) {
+    VLOG(1) << "Not permitted to count kernel events for PID " << pid_
+            << ", counting user-space events only";
+    if (OpenCounters(enable_on_exec, true)) {
+      return true;
+    }
+  }
+  PLOG(WARNING) << "perf_event_open failed for PID " << pid_;
+  return false;
+}
+
+bool PerfEventCounters::OpenBeforeExec() {
+  if (OpenCounters(true, false)) {
+    return true;
+  }
+  return (errno == EACCES || errno == EPERM) && OpenCounters(true, true);
+}
+
+bool PerfEventCounters::OpenCounters(bool enable_on_exec,
+                                     bool exclude_kernel) {
+  static const uint64_t kConfigs[NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,
+  };
+  for (uint32_t i = 0; i < NUM_COUNTERS; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfigs[i];
+    attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.inherit = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = exclude_kernel;
+    // Only the leader controls the group: it starts disabled and is enabled
+    // when the task execs, which starts all the counters at once.
+    if (i == CYCLES && enable_on_exec) {
+      attr.disabled = 1;
+      attr.enable_on_exec = 1;
+    }
+    fds_[i] = PerfEventOpen(&attr, pid_, i == CYCLES ? -1 : fds_[CYCLES]);
+    // N.B.: This may run in a child that has not exec'ed yet (see
+    // OpenBeforeExec()), so it must not log.
+    if (fds_[i] < 0) {
+      int saved_errno = errno;
+      Close();
+      errno = saved_errno;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PerfEventCounters::Read(PerfCounterValues* values) const {
+  uint64_t scaled[NUM_COUNTERS];
+  for (uint32_t i = 0; i < NUM_COUNTERS; ++i) {
+    if (fds_[i] < 0) {
+      return false;
+    }
+    CounterReading reading;
+    if (read(fds_[i], &reading, sizeof(reading)) !=
+        static_cast<ssize_t>(sizeof(reading))) {
+      PLOG(WARNING) << "Failed to read counter " << i << " of PID " << pid_;
+      return false;
+    }
+    scaled[i] = reading.value;
+    if (reading.time_running > 0 &&
+        reading.time_running < reading.time_enabled) {
+      scaled[i] = static_cast<uint64_t>(
+          static_cast<double>(reading.value) * reading.time_enabled /
+          reading.time_running);
+    }
+  }
+  values->cycles = scaled[CYCLES];
+  values->instructions = scaled[INSTRUCTIONS];
+  values->llc_refs = scaled[LLC_REFS];
+  values->llc_misses = scaled[LLC_MISSES];
+  return true;
+}
+
+void PerfEventCounters::PopulateTaskFinalReport(
+    const PerfCounterValues& values,
+    TaskFinalReport* report) {
+  report->set_instructions(values.instructions);
+  report->set_cycles(values.cycles);
+  report->set_llc_refs(values.llc_refs);
+  report->set_llc_misses(values.llc_misses);
+}
+
+void PerfEventCounters::PopulateTaskStats(const PerfCounterValues& values,
+                                          TaskStats* stats) {
+  stats->set_instructions(values.instructions);
+  stats->set_cycles(values.cycles);
+  stats->set_llc_refs(values.llc_refs);
+  stats->set_llc_misses(values.llc_misses);
+}
+
+}  // namespace executor
+}  // namespace firmament
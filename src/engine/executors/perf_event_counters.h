@@ -0,0 +1,134 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Hardware performance counters for a task process, read directly through
+// perf_event_open(2) rather than by running the task under perf stat.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_PERF_EVENT_COUNTERS_H
+#define FIRMAMENT_ENGINE_EXECUTORS_PERF_EVENT_COUNTERS_H
+
+#include <sys/types.h>
+
+#include "base/common.h"
+#include "base/task_final_report.pb.h"
+#include "base/task_stats.pb.h"
+
+namespace firmament {
+namespace executor {
+
+struct PerfCounterValues {
+  PerfCounterValues()
+    : instructions(0), cycles(0), llc_refs(0), llc_misses(0) {}
+  uint64_t instructions;
+  uint64_t cycles;
+  uint64_t llc_refs;
+  uint64_t llc_misses;
+};
+
+// A group of counters (cycles, instructions, LLC references and LLC misses)
+// attached to a single process and inherited by its threads and children.
+// By default, the counters are opened disabled and are enabled by the kernel
+// when the process calls exec. To count a task from its first instruction,
+// have the task's process open them on itself with OpenBeforeExec() between
+// clone and exec, in a descriptor table shared with the parent. Counters for a
+// process that has exec'ed already are opened enabled.
+class PerfEventCounters {
+ public:
+  /**
+   * @param pid the PID of the process to monitor, or 0 for the calling thread
+   * (and for counters that a task process opens with OpenBeforeExec())
+   */
+  explicit PerfEventCounters(pid_t pid);
+  ~PerfEventCounters();
+
+  /**
+   * Opens the counter group. Falls back to user-space only counting if the
+   * kernel does not permit counting kernel events.
+   * @param enable_on_exec if true, the counters start when the process next
+   * execs; otherwise, they start immediately
+   * @return false if the counters are unavailable (e.g. no PMU access)
+   */
+  bool Open(bool enable_on_exec = true);
+
+  /**
+   * Opens the counter group on the calling process, to be enabled when it
+   * execs. For use in a child process between clone and exec: it does not
+   * allocate memory, take locks or log. Falls back to user-space only
+   * counting as Open() does.
+   * @return false if the counters are unavailable
+   */
+  bool OpenBeforeExec();
+
+  /**
+   * @return true if the counters are open
+   */
+  inline bool is_open() const { return fds_[CYCLES] >= 0; }
+
+  /**
+   * @param pid the PID of the process that opened the counters with
+   * OpenBeforeExec(), used in log messages
+   */
+  inline void set_pid(pid_t pid) { pid_ = pid; }
+
+  /**
+   * Reads the current counter values. Values are scaled to compensate for
+   * the time that the counters were multiplexed off the PMU.
+   * @param values set to the counter values
+   * @return true if all counters were read successfully
+   */
+  bool Read(PerfCounterValues* values) const;
+
+  /**
+   * Copies counter values into a task's final report.
+   * @param values the counter values
+   * @param report the report to populate
+   */
+  static void PopulateTaskFinalReport(const PerfCounterValues& values,
+                                      TaskFinalReport* report);
+
+  /**
+   * Copies counter values into a task statistics sample.
+   * @param values the counter values
+   * @param stats the sample to populate
+   */
+  static void PopulateTaskStats(const PerfCounterValues& values,
+                                TaskStats* stats);
+
+ private:
+  enum CounterIndex {
+    CYCLES = 0,
+    INSTRUCTIONS = 1,
+    LLC_REFS = 2,
+    LLC_MISSES = 3,
+    NUM_COUNTERS = 4,
+  };
+
+  bool OpenCounters(bool enable_on_exec, bool exclude_kernel);
+  void Close();
+
+  pid_t pid_;
+  // The first FD is the group leader.
+  int fds_[NUM_COUNTERS];
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_PERF_EVENT_COUNTERS_H
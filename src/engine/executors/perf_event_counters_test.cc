@@ -0,0 +1,103 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for hardware counters read through perf_event_open(2).
+
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "base/common.h"
+#include "engine/executors/perf_event_counters.h"
+
+namespace firmament {
+namespace executor {
+
+class PerfEventCountersTest : public ::testing::Test {
+ protected:
+  // Forks a child that execs a short shell loop once released through the
+  // returned pipe FD.
+  pid_t ForkWaitingChild(int* release_fd) {
+    int barrier[2];
+    CHECK_EQ(pipe(barrier), 0);
+    pid_t pid = fork();
+    CHECK_GE(pid, 0);
+    if (pid == 0) {
+      char go;
+      close(barrier[1]);
+      if (read(barrier[0], &go, 1) != 1)
+        _exit(1);
+      execl("/bin/sh", "sh", "-c",
+            "i=0; while [ $i -lt 10000 ]; do i=$((i+1)); done", NULL);
+      _exit(1);
+    }
+    close(barrier[0]);
+    *release_fd = barrier[1];
+    return pid;
+  }
+
+  void ReleaseAndWait(pid_t pid, int release_fd) {
+    char go = 1;
+    CHECK_EQ(write(release_fd, &go, 1), 1);
+    close(release_fd);
+    int status;
+    CHECK_EQ(waitpid(pid, &status, 0), pid);
+    CHECK(WIFEXITED(status));
+    CHECK_EQ(WEXITSTATUS(status), 0);
+  }
+};
+
+// Tests that counters opened before exec count the task's work, and can be
+// read after the task has exited.
+TEST_F(PerfEventCountersTest, CountsTaskFromExec) {
+  int release_fd;
+  pid_t pid = ForkWaitingChild(&release_fd);
+  PerfEventCounters counters(pid);
+  bool opened = counters.Open();
+  ReleaseAndWait(pid, release_fd);
+  if (!opened) {
+    LOG(WARNING) << "Hardware counters unavailable; skipping test.";
+    return;
+  }
+  PerfCounterValues values;
+  ASSERT_TRUE(counters.Read(&values));
+  EXPECT_GT(values.instructions, 0);
+  EXPECT_GT(values.cycles, 0);
+  TaskFinalReport report;
+  PerfEventCounters::PopulateTaskFinalReport(values, &report);
+  EXPECT_EQ(report.instructions(), values.instructions);
+  EXPECT_EQ(report.llc_misses(), values.llc_misses);
+}
+
+// Tests that reading unopened counters fails.
+TEST_F(PerfEventCountersTest, ReadWithoutOpenFails) {
+  PerfEventCounters counters(getpid());
+  PerfCounterValues values;
+  EXPECT_FALSE(counters.Read(&values));
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,284 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Launches task processes with a prebuilt argv and environment.
+
+#include "engine/executors/process_launcher.h"
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+#include "misc/utils.h"
+
+DEFINE_bool(fast_task_launch, true,
+            "Create task processes with clone(CLONE_VM | CLONE_VFORK), "
+            "which does not copy the executor's page tables, instead of "
+            "fork(2). With fork(2), hardware counters are only attached "
+            "once the task has exec'ed.");
+
+namespace firmament {
+namespace executor {
+
+// The child only makes a few system calls on this stack before it execs.
+static const size_t kChildStackSize = 64 * 1024;
+
+namespace {
+
+// Record written to the exec status pipe by the child.
+struct ChildError {
+  int32_t step;
+  int32_t error;
+};
+
+bool RedirectToFile(const string& path, int target_fd) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    return false;
+  bool ok = dup2(fd, target_fd) == target_fd;
+  close(fd);
+  return ok;
+}
+
+}  // namespace
+
+ProcessLauncher::ProcessLauncher(const vector<string>& argv,
+                                 const unordered_map<string, string>& env)
+  : argv_strings_(argv), counters_(NULL), cgroup_procs_fd_(-1),
+    status_fd_(-1), child_opens_counters_(false), joined_cgroup_(false) {
+  CHECK(!argv.empty());
+  env_strings_.reserve(env.size());
+  for (unordered_map<string, string>::const_iterator it = env.begin();
+       it != env.end();
+       ++it) {
+    env_strings_.push_back(it->first + "=" + it->second);
+  }
+  // N.B.: This casts away the const qualifier on the c_str() results, which
+  // is safe since execvpe does not modify its arguments.
+  argv_.reserve(argv_strings_.size() + 1);
+  for (vector<string>::iterator it = argv_strings_.begin();
+       it != argv_strings_.end();
+       ++it) {
+    argv_.push_back(const_cast<char*>(it->c_str()));
+  }
+  argv_.push_back(NULL);
+  envp_.reserve(env_strings_.size() + 1);
+  for (vector<string>::iterator it = env_strings_.begin();
+       it != env_strings_.end();
+       ++it) {
+    envp_.push_back(const_cast<char*>(it->c_str()));
+  }
+  envp_.push_back(NULL);
+}
+
+int ProcessLauncher::ChildMain(void* arg) {
+  ProcessLauncher* launcher = static_cast<ProcessLauncher*>(arg);
+  launcher->RunChild(launcher->status_fd_);
+  return 127;
+}
+
+pid_t ProcessLauncher::Launch(int* exec_errno) {
+  *exec_errno = 0;
+  joined_cgroup_ = false;
+  // The child reports failures on this pipe; exec closes the write end.
+  int status_pipe[2];
+  if (pipe2(status_pipe, O_CLOEXEC) != 0) {
+    PLOG(ERROR) << "Failed to create exec status pipe for " << argv_[0];
+    return -1;
+  }
+  status_fd_ = status_pipe[1];
+  if (!cgroup_path_.empty()) {
+    string procs_path = cgroup_path_ + "/cgroup.procs";
+    cgroup_procs_fd_ = open(procs_path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (cgroup_procs_fd_ < 0) {
+      PLOG(WARNING) << "Failed to open " << procs_path;
+    }
+  }
+  // Block all signals until the child has reset its signal handlers: with
+  // CLONE_VM, one of our handlers running in the child would run on our
+  // memory.
+  sigset_t all_signals;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_SETMASK, &all_signals, &parent_sigmask_);
+  pid_t pid = -1;
+  if (FLAGS_fast_task_launch) {
+    // With CLONE_VFORK, we resume once the child has exec'ed or exited, at
+    // which point it no longer uses its stack. A child that opens counters
+    // starts out on our descriptor table, so that the counters' descriptors
+    // end up in it.
+    child_opens_counters_ = counters_ != NULL;
+    void* stack = mmap(NULL, kChildStackSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack != MAP_FAILED) {
+      pid = clone(&ProcessLauncher::ChildMain,
+                  static_cast<char*>(stack) + kChildStackSize,
+                  CLONE_VM | CLONE_VFORK |
+                  (child_opens_counters_ ? CLONE_FILES : 0) | SIGCHLD, this);
+      int saved_errno = errno;
+      munmap(stack, kChildStackSize);
+      errno = saved_errno;
+    }
+  } else {
+    child_opens_counters_ = false;
+    pid = fork();
+    if (pid == 0) {
+      RunChild(status_fd_);
+    }
+  }
+  int saved_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &parent_sigmask_, NULL);
+  close(status_pipe[1]);
+  status_fd_ = -1;
+  if (cgroup_procs_fd_ >= 0) {
+    close(cgroup_procs_fd_);
+    cgroup_procs_fd_ = -1;
+    joined_cgroup_ = pid > 0;
+  }
+  if (pid < 0) {
+    errno = saved_errno;
+    PLOG(ERROR) << "Failed to create process for " << argv_[0];
+    close(status_pipe[0]);
+    return -1;
+  }
+  // Blocks until the child has exec'ed (or exited) when it was forked.
+  ChildError child_error;
+  ssize_t bytes_read;
+  while (true) {
+    bytes_read = read(status_pipe[0], &child_error, sizeof(child_error));
+    if (bytes_read < 0 && errno == EINTR)
+      continue;
+    if (bytes_read != sizeof(child_error))
+      break;
+    if (child_error.step == JOIN_CGROUP) {
+      joined_cgroup_ = false;
+      LOG(WARNING) << "Process " << pid << " failed to join cgroup "
+                   << cgroup_path_ << ": " << strerror(child_error.error);
+    } else {
+      *exec_errno = child_error.error;
+      LOG(ERROR) << "Process " << pid << " failed to "
+                 << ChildStepName(child_error.step) << " " << argv_[0]
+                 << ": " << strerror(child_error.error);
+    }
+  }
+  if (bytes_read < 0) {
+    PLOG(WARNING) << "Failed to read exec status of process " << pid;
+  }
+  close(status_pipe[0]);
+  if (counters_ && counters_->is_open()) {
+    counters_->set_pid(pid);
+  }
+  return pid;
+}
+
+const char* ProcessLauncher::ChildStepName(int32_t step) {
+  switch (step) {
+    case JOIN_CGROUP:
+      return "join cgroup of";
+    case REDIRECT_OUTPUT:
+      return "redirect output of";
+    case EXEC:
+      return "exec";
+    case UNSHARE_FILES:
+      return "unshare descriptors of";
+    default:
+      return "launch";
+  }
+}
+
+void ProcessLauncher::ReportChildError(int status_fd, ChildStep step) {
+  ChildError child_error;
+  child_error.step = step;
+  child_error.error = errno;
+  ssize_t ret = write(status_fd, &child_error, sizeof(child_error));
+  (void)ret;
+}
+
+// N.B.: This runs in the child, which shares its memory with the parent when
+// created with CLONE_VM. It must not allocate memory, take locks or log; only
+// async-signal-safe calls are allowed.
+void ProcessLauncher::RunChild(int status_fd) {
+  if (child_opens_counters_) {
+    // The counters' descriptors land in the parent's descriptor table, which
+    // we share until here; a failure to open them leaves counters_ closed.
+    // Everything below works on a private copy of the table.
+    counters_->OpenBeforeExec();
+    if (unshare(CLONE_FILES) != 0) {
+      ReportChildError(status_fd, UNSHARE_FILES);
+      _exit(127);
+    }
+  }
+  // Reset signal handlers to their defaults; ignored signals stay ignored
+  // across exec, as with fork.
+  for (int sig = 1; sig < NSIG; ++sig) {
+    struct sigaction sa;
+    if (sigaction(sig, NULL, &sa) != 0 || sa.sa_handler == SIG_IGN ||
+        sa.sa_handler == SIG_DFL)
+      continue;
+    sa.sa_handler = SIG_DFL;
+    sa.sa_flags = 0;
+    sigemptyset(&sa.sa_mask);
+    sigaction(sig, &sa, NULL);
+  }
+  sigprocmask(SIG_SETMASK, &parent_sigmask_, NULL);
+  // Writing 0 to cgroup.procs moves the writing process. Failing to join
+  // the cgroup is not fatal.
+  if (cgroup_procs_fd_ >= 0 && write(cgroup_procs_fd_, "0", 1) != 1) {
+    ReportChildError(status_fd, JOIN_CGROUP);
+  }
+  // Set up stderr and stdout log redirections to files
+  if ((!stdout_path_.empty() &&
+       !RedirectToFile(stdout_path_, STDOUT_FILENO)) ||
+      (!stderr_path_.empty() &&
+       !RedirectToFile(stderr_path_, STDERR_FILENO))) {
+    ReportChildError(status_fd, REDIRECT_OUTPUT);
+    _exit(127);
+  }
+  // Close all FDs other than stdin, stdout, stderr and the status pipe, so
+  // that the task does not inherit the executor's sockets and files. The
+  // status pipe moves to FD 3 so that a single range covers the rest.
+  if (status_fd != 3) {
+    if (dup3(status_fd, 3, O_CLOEXEC) != 3)
+      _exit(127);
+    status_fd = 3;
+  }
+  CloseFileDescriptorsFrom(4);
+  // kill child process if parent terminates
+  // SOMEDAY(adam): make this portable beyond Linux?
+#ifdef __linux__
+  prctl(PR_SET_PDEATHSIG, SIGHUP);
+#endif
+  execvpe(argv_[0], &argv_[0], &envp_[0]);
+  // execvpe only returns if there was an error
+  ReportChildError(status_fd, EXEC);
+  _exit(127);
+}
+
+}  // namespace executor
+}  // namespace firmament
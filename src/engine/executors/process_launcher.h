@@ -0,0 +1,128 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Launches task processes. All of the state that the child process needs
+// (argv, envp, log file paths) is built once up front, so that the child only
+// makes a handful of system calls between creation and exec. By default, the
+// child is created with clone(CLONE_VM | CLONE_VFORK), which unlike fork(2)
+// does not copy the parent's page tables; this matters for workers and
+// coordinators with large heaps. This holds for tasks with hardware counters
+// too: their process opens the counters itself before it execs.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_PROCESS_LAUNCHER_H
+#define FIRMAMENT_ENGINE_EXECUTORS_PROCESS_LAUNCHER_H
+
+#include <signal.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "engine/executors/perf_event_counters.h"
+
+namespace firmament {
+namespace executor {
+
+class ProcessLauncher {
+ public:
+  /**
+   * @param argv the command line; argv[0] is looked up in PATH
+   * @param env the environment variables to pass to the process
+   */
+  ProcessLauncher(const vector<string>& argv,
+                  const unordered_map<string, string>& env);
+
+  /**
+   * Launches the process and waits until it has exec'ed its binary or
+   * failed to do so.
+   * @param exec_errno set to 0 if the process exec'ed; otherwise, set to the
+   * errno of the step that failed in the child, which then exits with status
+   * 127
+   * @return the PID of the process, or -1 if it could not be created
+   */
+  pid_t Launch(int* exec_errno);
+
+  /**
+   * @return true if the last launched process joined the cgroup set with
+   * set_cgroup_path()
+   */
+  inline bool joined_cgroup() const { return joined_cgroup_; }
+
+  /**
+   * @param path file to which to redirect the process's stdout
+   */
+  void set_stdout_path(const string& path) { stdout_path_ = path; }
+  /**
+   * @param path file to which to redirect the process's stderr
+   */
+  void set_stderr_path(const string& path) { stderr_path_ = path; }
+  /**
+   * @param path cgroup v2 directory which the process joins before exec
+   */
+  void set_cgroup_path(const string& path) { cgroup_path_ = path; }
+  /**
+   * @param counters counters, not yet open, that the process opens on itself
+   * before it execs. The exec enables them, so they count the task from its
+   * first instruction. Only the clone launch path opens them; callers check
+   * PerfEventCounters::is_open() once Launch() returns.
+   */
+  void set_perf_event_counters(PerfEventCounters* counters) {
+    counters_ = counters;
+  }
+
+ private:
+  // Steps in the child that can fail, reported to the parent through the
+  // exec status pipe.
+  enum ChildStep {
+    JOIN_CGROUP = 0,
+    REDIRECT_OUTPUT = 1,
+    EXEC = 2,
+    UNSHARE_FILES = 3,
+  };
+
+  static int ChildMain(void* arg);
+  static const char* ChildStepName(int32_t step);
+  void RunChild(int status_fd);
+  void ReportChildError(int status_fd, ChildStep step);
+
+  vector<string> argv_strings_;
+  vector<string> env_strings_;
+  vector<char*> argv_;
+  vector<char*> envp_;
+  string stdout_path_;
+  string stderr_path_;
+  string cgroup_path_;
+  PerfEventCounters* counters_;
+  // Set up by Launch() for the child.
+  int cgroup_procs_fd_;
+  int status_fd_;
+  // True if the child shares our descriptor table until it has opened
+  // counters_.
+  bool child_opens_counters_;
+  sigset_t parent_sigmask_;
+  bool joined_cgroup_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_PROCESS_LAUNCHER_H
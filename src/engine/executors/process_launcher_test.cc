@@ -0,0 +1,196 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for launching task processes.
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "base/common.h"
+#include "engine/executors/perf_event_counters.h"
+#include "engine/executors/process_launcher.h"
+#include "misc/utils.h"
+
+DECLARE_bool(fast_task_launch);
+
+namespace firmament {
+namespace executor {
+
+class ProcessLauncherTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    dir_ = MakeTemporaryDirectory("firmament-launcher-test");
+    ASSERT_FALSE(dir_.empty());
+  }
+
+  void TearDown() {
+    FLAGS_fast_task_launch = true;
+    EXPECT_TRUE(RemoveDirectoryRecursively(dir_));
+  }
+
+  // Launches a shell command with its output redirected to files in dir_,
+  // and waits for it to exit. Returns -1 if it did not run to completion.
+  int RunShell(const string& command,
+               const unordered_map<string, string>& env) {
+    vector<string> argv;
+    argv.push_back("/bin/sh");
+    argv.push_back("-c");
+    argv.push_back(command);
+    ProcessLauncher launcher(argv, env);
+    launcher.set_stdout_path(dir_ + "/stdout");
+    launcher.set_stderr_path(dir_ + "/stderr");
+    int exec_errno;
+    pid_t pid = launcher.Launch(&exec_errno);
+    EXPECT_GT(pid, 0);
+    EXPECT_EQ(exec_errno, 0);
+    if (pid <= 0)
+      return -1;
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  }
+
+  string ReadFile(const string& file_name) {
+    ifstream in((dir_ + "/" + file_name).c_str());
+    stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+  }
+
+  string dir_;
+};
+
+// Tests that the process gets its environment and its output is redirected,
+// with both the clone and the fork launch paths.
+TEST_F(ProcessLauncherTest, EnvironmentAndOutput) {
+  unordered_map<string, string> env;
+  env["GREETING"] = "hello";
+  for (int fast = 0; fast < 2; ++fast) {
+    FLAGS_fast_task_launch = fast;
+    EXPECT_EQ(RunShell("echo $GREETING; echo oops >&2", env), 0);
+    EXPECT_EQ(ReadFile("stdout"), "hello\n");
+    EXPECT_EQ(ReadFile("stderr"), "oops\n");
+    EXPECT_EQ(RunShell("exit 3", env), 3);
+  }
+}
+
+// Tests that the process does not inherit the launcher's open descriptors.
+TEST_F(ProcessLauncherTest, ClosesInheritedDescriptors) {
+  int fd = open("/dev/null", O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(dup2(fd, 100), 100);
+  EXPECT_EQ(RunShell("test -e /proc/self/fd/100 && echo open || echo closed",
+                     unordered_map<string, string>()), 0);
+  EXPECT_EQ(ReadFile("stdout"), "closed\n");
+  close(100);
+  close(fd);
+}
+
+// Tests that a failed exec is reported to the parent.
+TEST_F(ProcessLauncherTest, ReportsExecFailure) {
+  vector<string> argv;
+  argv.push_back(dir_ + "/does-not-exist");
+  ProcessLauncher launcher(argv, unordered_map<string, string>());
+  int exec_errno;
+  pid_t pid = launcher.Launch(&exec_errno);
+  ASSERT_GT(pid, 0);
+  EXPECT_EQ(exec_errno, ENOENT);
+  int status;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 127);
+}
+
+// Tests that the process opens the counters set on the launcher before it
+// execs, on the clone launch path only, and that they count the process and
+// not the launching thread.
+TEST_F(ProcessLauncherTest, ProcessOpensCountersBeforeExec) {
+  PerfEventCounters probe(0);
+  if (!probe.Open()) {
+    LOG(WARNING) << "Hardware counters unavailable; skipping test.";
+    return;
+  }
+  vector<string> argv;
+  argv.push_back("/bin/sh");
+  argv.push_back("-c");
+  argv.push_back("i=0; while [ $i -lt 10000 ]; do i=$((i+1)); done");
+  for (int fast = 0; fast < 2; ++fast) {
+    FLAGS_fast_task_launch = fast;
+    PerfEventCounters counters(0);
+    ProcessLauncher launcher(argv, unordered_map<string, string>());
+    launcher.set_perf_event_counters(&counters);
+    int exec_errno;
+    pid_t pid = launcher.Launch(&exec_errno);
+    ASSERT_GT(pid, 0);
+    EXPECT_EQ(exec_errno, 0);
+    int status;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    // Only the clone launch path opens counters before exec, so this also
+    // checks that setting counters leaves that path in use.
+    EXPECT_EQ(counters.is_open(), fast == 1);
+    if (!counters.is_open())
+      continue;
+    PerfCounterValues values;
+    ASSERT_TRUE(counters.Read(&values));
+    EXPECT_GT(values.instructions, 0);
+    EXPECT_GT(values.cycles, 0);
+    // Processes that we start later do not inherit the counters.
+    EXPECT_EQ(RunShell("i=0; while [ $i -lt 10000 ]; do i=$((i+1)); done",
+                       unordered_map<string, string>()), 0);
+    PerfCounterValues after;
+    ASSERT_TRUE(counters.Read(&after));
+    EXPECT_EQ(after.instructions, values.instructions);
+  }
+}
+
+// Tests that counters opened on the launching thread count the process.
+TEST_F(ProcessLauncherTest, InheritedCountersCountProcess) {
+  PerfEventCounters counters(0);
+  if (!counters.Open()) {
+    LOG(WARNING) << "Hardware counters unavailable; skipping test.";
+    return;
+  }
+  PerfCounterValues before;
+  ASSERT_TRUE(counters.Read(&before));
+  EXPECT_EQ(before.instructions, 0);
+  EXPECT_EQ(RunShell("i=0; while [ $i -lt 10000 ]; do i=$((i+1)); done",
+                     unordered_map<string, string>()), 0);
+  PerfCounterValues after;
+  ASSERT_TRUE(counters.Read(&after));
+  EXPECT_GT(after.instructions, 0);
+  EXPECT_GT(after.cycles, 0);
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,291 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// cgroup v2 based resource enforcement and accounting for a task.
+
+#include "engine/executors/task_cgroup.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/thread/locks.hpp>
+#endif
+
+#include "base/units.h"
+
+namespace firmament {
+namespace executor {
+
+using platform_unix::ProcFSTokenizer;
+
+// The CPU bandwidth period used for cpu.max, in microseconds.
+static const uint64_t kCPUPeriodUs = 100000;
+// How often to try removing a cgroup whose killed processes have not yet
+// exited before giving up.
+static const uint32_t kMaxBusyRemovals = 100;
+
+namespace {
+
+uint64_t MonotonicTimeUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL +
+    static_cast<uint64_t>(ts.tv_nsec) / 1000ULL;
+}
+
+bool TokenEquals(const char* token, size_t length, const char* key) {
+  return length == strlen(key) && strncmp(token, key, length) == 0;
+}
+
+// Reads the next "key value" line of a flat-keyed file such as cpu.stat or
+// memory.stat.
+bool NextKeyValue(ProcFSTokenizer* tok, const char** key, size_t* length,
+                  uint64_t* value) {
+  return tok->NextToken(key, length) && tok->NextUint64(value);
+}
+
+}  // namespace
+
+TaskCgroup::TaskCgroup(const string& path)
+  : path_(path), busy_removals_(0) {
+}
+
+TaskCgroup::~TaskCgroup() {
+  Remove();
+}
+
+bool TaskCgroup::SetUpRoot(const string& root) {
+  if (mkdir(root.c_str(), 0755) != 0 && errno != EEXIST) {
+    PLOG(ERROR) << "Failed to create task cgroup root " << root;
+    return false;
+  }
+  struct statfs fs;
+  if (statfs(root.c_str(), &fs) != 0 || fs.f_type != CGROUP2_SUPER_MAGIC) {
+    LOG(ERROR) << root << " is not in a cgroup v2 hierarchy";
+    return false;
+  }
+  // The controllers must also be enabled in the parent's subtree_control,
+  // which is up to whoever delegated the hierarchy to us.
+  string subtree_control = root + "/cgroup.subtree_control";
+  int fd = open(subtree_control.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    PLOG(ERROR) << "Failed to open " << subtree_control;
+    return false;
+  }
+  const char controllers[] = "+cpu +memory +io";
+  bool ok = write(fd, controllers, strlen(controllers)) ==
+    static_cast<ssize_t>(strlen(controllers));
+  if (!ok)
+    PLOG(ERROR) << "Failed to enable cpu, memory and io controllers in "
+                << subtree_control;
+  close(fd);
+  return ok;
+}
+
+bool TaskCgroup::Create(const ResourceVector& request) {
+  if (mkdir(path_.c_str(), 0755) != 0 && errno != EEXIST) {
+    PLOG(ERROR) << "Failed to create cgroup " << path_;
+    return false;
+  }
+  request_.CopyFrom(request);
+  string cpu_max = "max";
+  if (request.cpu_cores() > 0.0) {
+    uint64_t quota = static_cast<uint64_t>(request.cpu_cores() * kCPUPeriodUs);
+    // The kernel rejects quotas below 1ms.
+    cpu_max = to_string(max<uint64_t>(quota, 1000)) + " " +
+      to_string(kCPUPeriodUs);
+  }
+  string memory_max = "max";
+  if (request.ram_cap() > 0) {
+    memory_max = to_string(request.ram_cap() * KB_TO_BYTES);
+  }
+  if (!WriteFile("cpu.max", cpu_max) || !WriteFile("memory.max", memory_max))
+    return false;
+  // Only cpu.stat is always present; the other files exist if the memory
+  // and io controllers are enabled.
+  if (!cpu_stat_.Open(path_ + "/cpu.stat")) {
+    PLOG(ERROR) << "Failed to open " << path_ << "/cpu.stat";
+    return false;
+  }
+  memory_current_.Open(path_ + "/memory.current");
+  memory_stat_.Open(path_ + "/memory.stat");
+  io_stat_.Open(path_ + "/io.stat");
+  last_stats_.timestamp = MonotonicTimeUs();
+  return true;
+}
+
+bool TaskCgroup::AddProcess(pid_t pid) {
+  return WriteFile("cgroup.procs", to_string(pid));
+}
+
+bool TaskCgroup::Remove() {
+  {
+    boost::lock_guard<boost::mutex> lock(files_mut_);
+    cpu_stat_.Close();
+    memory_current_.Close();
+    memory_stat_.Close();
+    io_stat_.Close();
+  }
+  if (rmdir(path_.c_str()) == 0 || errno == ENOENT)
+    return true;
+  if (errno != EBUSY) {
+    PLOG(WARNING) << "Failed to remove cgroup " << path_;
+    return true;
+  }
+  if (busy_removals_ >= kMaxBusyRemovals) {
+    LOG(WARNING) << "Giving up on removing cgroup " << path_ << ", which "
+                 << "still holds processes";
+    return true;
+  }
+  if (busy_removals_++ == 0) {
+    // cgroup.kill needs Linux 5.14 or later.
+    VLOG(1) << "Killing processes left in cgroup " << path_;
+    WriteFile("cgroup.kill", "1");
+  }
+  return false;
+}
+
+bool TaskCgroup::Read(CgroupStats* stats) {
+  *stats = CgroupStats();
+  stats->timestamp = MonotonicTimeUs();
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  if (!cpu_stat_.Read())
+    return false;
+  const char* key;
+  size_t length;
+  uint64_t value;
+  ProcFSTokenizer cpu_tok(cpu_stat_);
+  do {
+    if (!NextKeyValue(&cpu_tok, &key, &length, &value))
+      continue;
+    if (TokenEquals(key, length, "usage_usec"))
+      stats->cpu_usage_us = value;
+    else if (TokenEquals(key, length, "user_usec"))
+      stats->cpu_user_us = value;
+    else if (TokenEquals(key, length, "system_usec"))
+      stats->cpu_system_us = value;
+    else if (TokenEquals(key, length, "nr_throttled"))
+      stats->cpu_nr_throttled = value;
+    else if (TokenEquals(key, length, "throttled_usec"))
+      stats->cpu_throttled_us = value;
+  } while (cpu_tok.NextLine());
+  if (memory_current_.Read()) {
+    ProcFSTokenizer tok(memory_current_);
+    tok.NextUint64(&stats->mem_current);
+  }
+  if (memory_stat_.Read()) {
+    ProcFSTokenizer mem_tok(memory_stat_);
+    do {
+      if (!NextKeyValue(&mem_tok, &key, &length, &value))
+        continue;
+      if (TokenEquals(key, length, "anon"))
+        stats->mem_anon = value;
+      else if (TokenEquals(key, length, "file"))
+        stats->mem_file = value;
+      else if (TokenEquals(key, length, "pgfault"))
+        stats->mem_page_faults = value;
+      else if (TokenEquals(key, length, "pgmajfault"))
+        stats->mem_major_page_faults = value;
+    } while (mem_tok.NextLine());
+  }
+  if (io_stat_.Read()) {
+    // One line per device: "MAJ:MIN rbytes=N wbytes=N rios=N ...".
+    ProcFSTokenizer io_tok(io_stat_);
+    do {
+      const char* token;
+      if (!io_tok.NextToken(&token, &length))
+        continue;
+      while (io_tok.NextToken(&token, &length)) {
+        if (length > 7 && strncmp(token, "rbytes=", 7) == 0) {
+          stats->io_read_bytes += strtoull(token + 7, NULL, 10);
+        } else if (length > 7 && strncmp(token, "wbytes=", 7) == 0) {
+          stats->io_write_bytes += strtoull(token + 7, NULL, 10);
+        }
+      }
+    } while (io_tok.NextLine());
+  }
+  return true;
+}
+
+void TaskCgroup::PopulateTaskStats(const CgroupStats& stats,
+                                   TaskStats* task_stats) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  if (stats.timestamp > last_stats_.timestamp &&
+      stats.cpu_usage_us >= last_stats_.cpu_usage_us) {
+    task_stats->set_cpu_usage(
+        (stats.cpu_usage_us - last_stats_.cpu_usage_us) * 1000 /
+        (stats.timestamp - last_stats_.timestamp));
+  }
+  if (stats.timestamp > last_stats_.timestamp &&
+      stats.mem_page_faults >= last_stats_.mem_page_faults) {
+    double interval_sec = static_cast<double>(
+        stats.timestamp - last_stats_.timestamp) / 1000000.0;
+    task_stats->set_mem_page_faults_rate(
+        (stats.mem_page_faults - last_stats_.mem_page_faults) / interval_sec);
+    task_stats->set_major_page_faults_rate(
+        (stats.mem_major_page_faults - last_stats_.mem_major_page_faults) /
+        interval_sec);
+  }
+  last_stats_ = stats;
+  task_stats->set_cpu_request(
+      static_cast<int64_t>(request_.cpu_cores() * 1000));
+  task_stats->set_cpu_limit(task_stats->cpu_request());
+  task_stats->set_mem_request(request_.ram_cap());
+  task_stats->set_mem_limit(request_.ram_cap());
+  task_stats->set_mem_usage(stats.mem_current / KB_TO_BYTES);
+  task_stats->set_mem_rss(stats.mem_anon / KB_TO_BYTES);
+  task_stats->set_mem_cache(stats.mem_file / KB_TO_BYTES);
+  // As in cAdvisor, the working set excludes the page cache.
+  task_stats->set_mem_working_set(
+      (stats.mem_current - min(stats.mem_current, stats.mem_file)) /
+      KB_TO_BYTES);
+  task_stats->set_mem_page_faults(stats.mem_page_faults);
+  task_stats->set_major_page_faults(stats.mem_major_page_faults);
+  task_stats->set_cpu_time(stats.cpu_usage_us);
+  task_stats->set_cpu_throttled_time(stats.cpu_throttled_us);
+  task_stats->set_disk_read(stats.io_read_bytes / KB_TO_BYTES);
+  task_stats->set_disk_write(stats.io_write_bytes / KB_TO_BYTES);
+}
+
+bool TaskCgroup::WriteFile(const string& file_name, const string& value) {
+  string file_path = path_ + "/" + file_name;
+  int fd = open(file_path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    PLOG(ERROR) << "Failed to open " << file_path;
+    return false;
+  }
+  bool ok = write(fd, value.data(), value.size()) ==
+    static_cast<ssize_t>(value.size());
+  if (!ok)
+    PLOG(ERROR) << "Failed to write " << value << " to " << file_path;
+  close(fd);
+  return ok;
+}
+
+}  // namespace executor
+}  // namespace firmament
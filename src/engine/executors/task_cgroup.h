@@ -0,0 +1,161 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// A cgroup v2 control group holding a single task's processes. The cgroup
+// enforces the task's CPU and memory request through cpu.max and memory.max,
+// and its cpu.stat, memory.current, memory.stat and io.stat files provide
+// accounting for all of the task's processes without scraping /proc.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_TASK_CGROUP_H
+#define FIRMAMENT_ENGINE_EXECUTORS_TASK_CGROUP_H
+
+#include <sys/types.h>
+
+#include <string>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/thread/mutex.hpp>
+#else
+#error Boost not available!
+#endif
+
+#include "base/common.h"
+#include "base/resource_vector.pb.h"
+#include "base/task_stats.pb.h"
+#include "platforms/unix/procfs_reader.h"
+
+namespace firmament {
+namespace executor {
+
+using platform_unix::ProcFSFile;
+
+struct CgroupStats {
+  CgroupStats()
+    : timestamp(0), cpu_usage_us(0), cpu_user_us(0), cpu_system_us(0),
+      cpu_nr_throttled(0), cpu_throttled_us(0), mem_current(0), mem_anon(0),
+      mem_file(0), mem_page_faults(0), mem_major_page_faults(0),
+      io_read_bytes(0), io_write_bytes(0) {}
+  // Monotonic time at which the sample was taken, in microseconds.
+  uint64_t timestamp;
+  uint64_t cpu_usage_us;
+  uint64_t cpu_user_us;
+  uint64_t cpu_system_us;
+  uint64_t cpu_nr_throttled;
+  uint64_t cpu_throttled_us;
+  // Memory stats in bytes.
+  uint64_t mem_current;
+  uint64_t mem_anon;
+  uint64_t mem_file;
+  uint64_t mem_page_faults;
+  uint64_t mem_major_page_faults;
+  // Block I/O summed over all devices.
+  uint64_t io_read_bytes;
+  uint64_t io_write_bytes;
+};
+
+class TaskCgroup {
+ public:
+  /**
+   * @param path the path of the task's cgroup, below a cgroup v2 hierarchy
+   */
+  explicit TaskCgroup(const string& path);
+  /**
+   * Makes a last attempt to remove the cgroup (see Remove()).
+   */
+  ~TaskCgroup();
+
+  /**
+   * Prepares a directory in a cgroup v2 hierarchy to hold task cgroups by
+   * creating it and delegating the cpu, memory and io controllers to its
+   * children.
+   * @param root the directory to prepare
+   * @return false if the directory is not in a cgroup v2 hierarchy or the
+   * controllers could not be enabled
+   */
+  static bool SetUpRoot(const string& root);
+
+  /**
+   * Creates the cgroup and sets its limits. A zero CPU or RAM request leaves
+   * the corresponding resource unlimited.
+   * @param request the task's resource request; cpu_cores is a (possibly
+   * fractional) number of cores and ram_cap is in KB
+   * @return false if the cgroup could not be created or its limits set
+   */
+  bool Create(const ResourceVector& request);
+
+  /**
+   * Moves a running process into the cgroup. Processes that are launched
+   * for a task join its cgroup themselves (see ProcessLauncher); this is for
+   * processes that already exist, such as warm zygote processes.
+   * @param pid the PID of the process to move
+   * @return true if the process was moved
+   */
+  bool AddProcess(pid_t pid);
+
+  /**
+   * Tries to remove the cgroup without blocking. If processes are left in
+   * it, e.g. because the task forked children that outlived it, they are
+   * killed, and the cgroup can be removed once they have exited; callers
+   * retry until this returns true.
+   * @return true if the cgroup is gone, or removing it has failed for good
+   */
+  bool Remove();
+
+  /**
+   * Reads the cgroup's current statistics. Statistics of controllers that
+   * are not enabled for the cgroup are left at zero.
+   * @param stats set to the statistics
+   * @return false if cpu.stat could not be read, e.g. because the cgroup
+   * has been removed
+   */
+  bool Read(CgroupStats* stats);
+
+  /**
+   * Copies cgroup statistics into a task statistics sample. The CPU usage
+   * rate is computed over the interval since the previous sample passed to
+   * this method, or since the cgroup was created.
+   * @param stats the cgroup statistics
+   * @param task_stats the sample to populate
+   */
+  void PopulateTaskStats(const CgroupStats& stats, TaskStats* task_stats);
+
+  inline const string& path() const { return path_; }
+
+ private:
+  bool WriteFile(const string& file_name, const string& value);
+
+  const string path_;
+  ResourceVector request_;
+  ProcFSFile cpu_stat_;
+  ProcFSFile memory_current_;
+  ProcFSFile memory_stat_;
+  ProcFSFile io_stat_;
+  // Guards the files above, which share read buffers, and the previous
+  // sample used to compute CPU usage rates.
+  boost::mutex files_mut_;
+  CgroupStats last_stats_;
+  // Number of times that Remove() found processes left in the cgroup.
+  uint32_t busy_removals_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_TASK_CGROUP_H
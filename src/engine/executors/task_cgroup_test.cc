@@ -0,0 +1,154 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for cgroup v2 task resource enforcement and accounting. The tests run
+// against a directory populated with cgroup interface files, since the test
+// environment may not have a delegated cgroup v2 hierarchy.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "base/common.h"
+#include "engine/executors/task_cgroup.h"
+#include "misc/utils.h"
+
+namespace firmament {
+namespace executor {
+
+class TaskCgroupTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    path_ = MakeTemporaryDirectory("firmament-cgroup-test");
+    ASSERT_FALSE(path_.empty());
+    const char* files[] = {"cpu.max", "memory.max", "cgroup.procs",
+                           "cgroup.kill"};
+    for (const char* file : files) {
+      WriteFile(file, "");
+    }
+    WriteFile("cpu.stat",
+              "usage_usec 2500000\nuser_usec 2000000\nsystem_usec 500000\n"
+              "nr_periods 30\nnr_throttled 4\nthrottled_usec 12000\n");
+    WriteFile("memory.current", "10485760\n");
+    WriteFile("memory.stat",
+              "anon 6291456\nfile 3145728\nkernel_stack 16384\n"
+              "pgfault 1200\npgmajfault 7\n");
+    WriteFile("io.stat",
+              "8:0 rbytes=4096 wbytes=8192 rios=1 wios=2 dbytes=0 dios=0\n"
+              "8:16 rbytes=1024 wbytes=0 rios=1 wios=0 dbytes=0 dios=0\n");
+  }
+
+  void TearDown() {
+    EXPECT_TRUE(RemoveDirectoryRecursively(path_));
+  }
+
+  string ReadFile(const string& file_name) {
+    ifstream in((path_ + "/" + file_name).c_str());
+    stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+  }
+
+  void WriteFile(const string& file_name, const string& contents) {
+    ofstream out((path_ + "/" + file_name).c_str(), ios::trunc);
+    out << contents;
+  }
+
+  string path_;
+};
+
+// Tests that the task's CPU and RAM request become its cgroup's limits.
+TEST_F(TaskCgroupTest, SetsLimitsFromRequest) {
+  TaskCgroup cgroup(path_);
+  ResourceVector request;
+  request.set_cpu_cores(1.5);
+  request.set_ram_cap(2048);
+  ASSERT_TRUE(cgroup.Create(request));
+  EXPECT_EQ(ReadFile("cpu.max"), "150000 100000");
+  EXPECT_EQ(ReadFile("memory.max"), "2097152");
+  EXPECT_TRUE(cgroup.AddProcess(1234));
+  EXPECT_EQ(ReadFile("cgroup.procs"), "1234");
+}
+
+// Tests that an empty request leaves the task unlimited.
+TEST_F(TaskCgroupTest, UnlimitedWithoutRequest) {
+  TaskCgroup cgroup(path_);
+  ASSERT_TRUE(cgroup.Create(ResourceVector()));
+  EXPECT_EQ(ReadFile("cpu.max"), "max");
+  EXPECT_EQ(ReadFile("memory.max"), "max");
+}
+
+// Tests that the cgroup's statistics files are parsed into TaskStats.
+TEST_F(TaskCgroupTest, ReadsStatistics) {
+  TaskCgroup cgroup(path_);
+  ResourceVector request;
+  request.set_cpu_cores(0.5);
+  request.set_ram_cap(1024);
+  ASSERT_TRUE(cgroup.Create(request));
+  // Let some time pass, so that there is an interval to compute CPU usage
+  // over.
+  usleep(1000);
+  CgroupStats stats;
+  ASSERT_TRUE(cgroup.Read(&stats));
+  EXPECT_EQ(stats.cpu_usage_us, 2500000);
+  EXPECT_EQ(stats.cpu_user_us, 2000000);
+  EXPECT_EQ(stats.cpu_system_us, 500000);
+  EXPECT_EQ(stats.cpu_nr_throttled, 4);
+  EXPECT_EQ(stats.cpu_throttled_us, 12000);
+  EXPECT_EQ(stats.mem_current, 10485760);
+  EXPECT_EQ(stats.mem_anon, 6291456);
+  EXPECT_EQ(stats.mem_file, 3145728);
+  EXPECT_EQ(stats.mem_page_faults, 1200);
+  EXPECT_EQ(stats.mem_major_page_faults, 7);
+  EXPECT_EQ(stats.io_read_bytes, 5120);
+  EXPECT_EQ(stats.io_write_bytes, 8192);
+  TaskStats task_stats;
+  cgroup.PopulateTaskStats(stats, &task_stats);
+  EXPECT_EQ(task_stats.cpu_request(), 500);
+  EXPECT_EQ(task_stats.mem_limit(), 1024);
+  EXPECT_EQ(task_stats.cpu_time(), 2500000);
+  EXPECT_EQ(task_stats.cpu_throttled_time(), 12000);
+  EXPECT_EQ(task_stats.mem_usage(), 10240);
+  EXPECT_EQ(task_stats.mem_rss(), 6144);
+  EXPECT_EQ(task_stats.mem_cache(), 3072);
+  EXPECT_EQ(task_stats.mem_working_set(), 7168);
+  EXPECT_EQ(task_stats.disk_read(), 5);
+  EXPECT_EQ(task_stats.disk_write(), 8);
+  EXPECT_GT(task_stats.cpu_usage(), 0);
+}
+
+// Tests that reading fails once the cgroup's files are gone.
+TEST_F(TaskCgroupTest, ReadFailsWithoutCreate) {
+  TaskCgroup cgroup(path_ + "/missing");
+  CgroupStats stats;
+  EXPECT_FALSE(cgroup.Read(&stats));
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -22,51 +22,27 @@
 
 #include <vector>
 
-#if BOOST_VERSION <= 104800
-#include <boost/chrono.hpp>
-#endif
-
 #include "misc/map-util.h"
 #include "misc/utils.h"
 
 namespace firmament {
 
 TaskHealthChecker::TaskHealthChecker(
-    const unordered_map<TaskID_t, boost::thread*>* handler_thread_map,
-    boost::shared_mutex* handler_map_lock)
-  : handler_thread_map_(handler_thread_map),
-    handler_map_lock_(handler_map_lock) {
+    const unordered_set<TaskID_t>* exited_tasks,
+    boost::shared_mutex* exited_tasks_lock)
+  : exited_tasks_(exited_tasks),
+    exited_tasks_lock_(exited_tasks_lock) {
 }
 
 bool TaskHealthChecker::Run(vector<TaskID_t>* failed_tasks) {
-  bool all_good = true;
-  boost::shared_lock<boost::shared_mutex> map_lock(*handler_map_lock_);
-  for (unordered_map<TaskID_t, boost::thread*>::const_iterator
-       it = handler_thread_map_->begin();
-       it != handler_thread_map_->end();
+  boost::shared_lock<boost::shared_mutex> lock(*exited_tasks_lock_);
+  for (unordered_set<TaskID_t>::const_iterator it = exited_tasks_->begin();
+       it != exited_tasks_->end();
        ++it) {
-    VLOG(2) << "Checking liveness of task " << it->first;
-    if (!CheckTaskLiveness(it->first, it->second)) {
-      all_good = false;
-      LOG(ERROR) << "Task " << it->first << " has failed!";
-      failed_tasks->push_back(it->first);
-    }
+    LOG(ERROR) << "Task " << *it << " has failed!";
+    failed_tasks->push_back(*it);
   }
-  return all_good;
-}
-
-bool TaskHealthChecker::CheckTaskLiveness(TaskID_t task_id,
-                                          boost::thread* handler_thread) {
-  if (!handler_thread)
-    return false;
-#if BOOST_VERSION <= 104800
-  if (handler_thread->timed_join(boost::posix_time::seconds(1)))
-    return false;
-#else
-  if (handler_thread->try_join_for(boost::chrono::seconds(1)))
-    return false;
-#endif
-  return true;
+  return exited_tasks_->empty();
 }
 
 }  // namespace firmament
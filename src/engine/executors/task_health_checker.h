@@ -43,16 +43,24 @@ namespace firmament {
 
 class TaskHealthChecker {
  public:
-  TaskHealthChecker(
-      const unordered_map<TaskID_t, boost::thread*>* handler_thread_map,
-      boost::shared_mutex* handler_map_lock);
+  /**
+   * @param exited_tasks the tasks whose processes have exited or failed to
+   * launch, maintained by the executor
+   * @param exited_tasks_lock the lock that guards exited_tasks
+   */
+  TaskHealthChecker(const unordered_set<TaskID_t>* exited_tasks,
+                    boost::shared_mutex* exited_tasks_lock);
+  /**
+   * Reports the tasks whose processes are no longer running. This does not
+   * block or wait on the tasks; exits are recorded as they happen.
+   * @param failed_tasks appended to with the tasks that are not running
+   * @return true if all tasks are running
+   */
   bool Run(vector<TaskID_t>* failed_tasks);
 
  protected:
-  bool CheckTaskLiveness(TaskID_t task_id, boost::thread* handler_thread);
-
-  const unordered_map<TaskID_t, boost::thread*>* handler_thread_map_;
-  boost::shared_mutex* handler_map_lock_;
+  const unordered_set<TaskID_t>* exited_tasks_;
+  boost::shared_mutex* exited_tasks_lock_;
 };
 
 }  // namespace firmament
@@ -0,0 +1,299 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Per-machine collection of task heartbeats and state reports.
+
+#include "engine/executors/task_heartbeat_aggregator.h"
+
+extern "C" {
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+
+#include <vector>
+
+#include "messages/base_message.pb.h"
+
+DEFINE_bool(aggregate_task_heartbeats, true,
+            "Collect the heartbeats and state reports of local tasks on a "
+            "UNIX domain socket, and handle the heartbeats in one batch per "
+            "heartbeat interval.");
+DEFINE_string(task_heartbeat_socket_dir, "/tmp",
+              "Directory in which coordinators create the private "
+              "directories holding the sockets on which they collect the "
+              "heartbeats of local tasks.");
+
+namespace firmament {
+namespace executor {
+
+// Heartbeats and state reports are small; anything larger than this is
+// truncated and dropped.
+static const size_t kMaxMessageSize = 64 * 1024;
+static const int kMaxEvents = 16;
+// epoll data tags of the socket, the wake-up eventfd and the batch timer.
+static const uint64_t kSocketTag = 0;
+static const uint64_t kWakeTag = 1;
+static const uint64_t kTimerTag = 2;
+
+static string DirectoryOf(const string& path) {
+  size_t pos = path.find_last_of('/');
+  return pos == string::npos ? "" : path.substr(0, pos);
+}
+
+// Heartbeats are not authenticated, so only processes running as our user
+// may reach the socket: it lives in a directory that only we can access.
+// Sets *created if the directory did not exist yet.
+static bool MakePrivateDirectory(const string& dir, bool* created) {
+  *created = false;
+  if (mkdir(dir.c_str(), 0700) == 0) {
+    *created = true;
+    return true;
+  }
+  if (errno != EEXIST) {
+    PLOG(ERROR) << "Failed to create task heartbeat socket directory " << dir;
+    return false;
+  }
+  struct stat st;
+  if (lstat(dir.c_str(), &st) != 0) {
+    PLOG(ERROR) << "Failed to stat task heartbeat socket directory " << dir;
+    return false;
+  }
+  if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+      (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+    LOG(ERROR) << "Task heartbeat socket directory " << dir << " must be a "
+               << "directory owned by and accessible only to user "
+               << geteuid();
+    return false;
+  }
+  return true;
+}
+
+TaskHeartbeatAggregator::TaskHeartbeatAggregator(const string& socket_path,
+                                                 uint64_t batch_interval_us,
+                                                 BatchHandler handler,
+                                                 StateHandler state_handler)
+  : socket_path_(socket_path),
+    socket_dir_(DirectoryOf(socket_path)),
+    created_socket_dir_(false), batch_interval_us_(batch_interval_us),
+    handler_(handler), state_handler_(state_handler), socket_fd_(-1), epoll_fd_(-1), wake_fd_(-1),
+    timer_fd_(-1), stop_(false), thread_(NULL) {
+}
+
+TaskHeartbeatAggregator::~TaskHeartbeatAggregator() {
+  Stop();
+}
+
+bool TaskHeartbeatAggregator::Start() {
+  CHECK_GT(batch_interval_us_, 0ULL);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    LOG(ERROR) << "Task heartbeat socket path " << socket_path_
+               << " is too long";
+    return false;
+  }
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+  if (!socket_dir_.empty() &&
+      !MakePrivateDirectory(socket_dir_, &created_socket_dir_)) {
+    return false;
+  }
+  socket_fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (socket_fd_ < 0) {
+    PLOG(ERROR) << "Failed to create task heartbeat socket";
+    Stop();
+    return false;
+  }
+  // The path is derived from the coordinator's listen URI, so a socket that
+  // exists already was left behind by an earlier coordinator.
+  unlink(socket_path_.c_str());
+  if (bind(socket_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)) != 0) {
+    PLOG(ERROR) << "Failed to bind task heartbeat socket " << socket_path_;
+    Stop();
+    return false;
+  }
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (epoll_fd_ < 0 || wake_fd_ < 0 || timer_fd_ < 0) {
+    PLOG(ERROR) << "Failed to set up task heartbeat aggregator";
+    Stop();
+    return false;
+  }
+  struct itimerspec interval;
+  interval.it_interval.tv_sec = batch_interval_us_ / 1000000;
+  interval.it_interval.tv_nsec = (batch_interval_us_ % 1000000) * 1000;
+  interval.it_value = interval.it_interval;
+  CHECK_EQ(timerfd_settime(timer_fd_, 0, &interval, NULL), 0);
+  int fds[] = {socket_fd_, wake_fd_, timer_fd_};
+  uint64_t tags[] = {kSocketTag, kWakeTag, kTimerTag};
+  for (uint32_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = tags[i];
+    CHECK_EQ(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fds[i], &event), 0);
+  }
+  thread_ = new boost::thread(boost::bind(&TaskHeartbeatAggregator::Run,
+                                          this));
+  return true;
+}
+
+void TaskHeartbeatAggregator::Stop() {
+  if (thread_) {
+    stop_ = true;
+    Wake();
+    thread_->join();
+    delete thread_;
+    thread_ = NULL;
+  }
+  if (socket_fd_ >= 0)
+    unlink(socket_path_.c_str());
+  if (created_socket_dir_) {
+    rmdir(socket_dir_.c_str());
+    created_socket_dir_ = false;
+  }
+  int* fds[] = {&socket_fd_, &epoll_fd_, &wake_fd_, &timer_fd_};
+  for (uint32_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+    if (*fds[i] >= 0) {
+      close(*fds[i]);
+      *fds[i] = -1;
+    }
+  }
+}
+
+size_t TaskHeartbeatAggregator::NumPendingHeartbeats() {
+  boost::lock_guard<boost::mutex> lock(pending_lock_);
+  return pending_.size();
+}
+
+string TaskHeartbeatAggregator::SocketPathForCoordinator(
+    const string& coordinator_uri) {
+  string name = coordinator_uri;
+  for (string::iterator it = name.begin(); it != name.end(); ++it) {
+    if (!isalnum(*it) && *it != '.' && *it != '-')
+      *it = '_';
+  }
+  return FLAGS_task_heartbeat_socket_dir + "/firmament-heartbeats-" + name +
+    "/heartbeats.sock";
+}
+
+void TaskHeartbeatAggregator::FlushHeartbeats() {
+  TaskHeartbeatBatchMessage batch;
+  {
+    boost::lock_guard<boost::mutex> lock(pending_lock_);
+    if (pending_.empty())
+      return;
+    for (unordered_map<TaskID_t, TaskHeartbeatMessage>::iterator it =
+         pending_.begin();
+         it != pending_.end();
+         ++it) {
+      batch.add_heartbeats()->Swap(&it->second);
+    }
+    pending_.clear();
+  }
+  VLOG(2) << "Handing over a batch of " << batch.heartbeats_size()
+          << " task heartbeats";
+  handler_(batch);
+}
+
+void TaskHeartbeatAggregator::ReceiveMessages() {
+  vector<char> buffer(kMaxMessageSize);
+  while (true) {
+    ssize_t len = recv(socket_fd_, &buffer[0], buffer.size(), MSG_TRUNC);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        PLOG(WARNING) << "Failed to receive task message";
+      return;
+    }
+    BaseMessage bm;
+    if (static_cast<size_t>(len) > buffer.size() ||
+        !bm.ParseFromArray(&buffer[0], len) ||
+        (!bm.has_task_heartbeat() && !bm.has_task_state())) {
+      LOG(WARNING) << "Dropped malformed task message of " << len
+                   << " bytes";
+      continue;
+    }
+    if (bm.has_task_state()) {
+      {
+        // The report supersedes the task's pending heartbeat, which must
+        // not reach the coordinator after it.
+        boost::lock_guard<boost::mutex> lock(pending_lock_);
+        pending_.erase(bm.task_state().id());
+      }
+      state_handler_(bm.task_state());
+      continue;
+    }
+    boost::lock_guard<boost::mutex> lock(pending_lock_);
+    // Only the latest heartbeat of a task in each batch is passed on.
+    pending_[bm.task_heartbeat().task_id()].Swap(
+        bm.mutable_task_heartbeat());
+  }
+}
+
+void TaskHeartbeatAggregator::Run() {
+  struct epoll_event events[kMaxEvents];
+  while (!stop_) {
+    int num_events = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (num_events < 0) {
+      if (errno == EINTR)
+        continue;
+      PLOG(ERROR) << "Task heartbeat aggregator epoll_wait failed";
+      break;
+    }
+    bool flush = false;
+    for (int i = 0; i < num_events; ++i) {
+      uint64_t value;
+      if (events[i].data.u64 == kSocketTag) {
+        ReceiveMessages();
+      } else if (events[i].data.u64 == kWakeTag) {
+        while (read(wake_fd_, &value, sizeof(value)) > 0) {}
+      } else {
+        while (read(timer_fd_, &value, sizeof(value)) > 0) {}
+        flush = true;
+      }
+    }
+    if (flush)
+      FlushHeartbeats();
+  }
+  ReceiveMessages();
+  FlushHeartbeats();
+}
+
+void TaskHeartbeatAggregator::Wake() {
+  uint64_t value = 1;
+  if (wake_fd_ >= 0 && write(wake_fd_, &value, sizeof(value)) < 0 &&
+      errno != EAGAIN) {
+    PLOG(WARNING) << "Failed to wake up task heartbeat aggregator thread";
+  }
+}
+
+}  // namespace executor
+}  // namespace firmament
@@ -0,0 +1,121 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Collects the heartbeats and state reports of the tasks on a machine. Tasks
+// send them as datagrams to a UNIX domain socket instead of over their
+// connection to the coordinator; the aggregator keeps the latest heartbeat of
+// each task and hands them to the coordinator as one batch per interval, so
+// that a single message per machine goes up the coordinator hierarchy. State
+// reports, such as a task's completion, are handed over as they arrive.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_TASK_HEARTBEAT_AGGREGATOR_H
+#define FIRMAMENT_ENGINE_EXECUTORS_TASK_HEARTBEAT_AGGREGATOR_H
+
+#include <string>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#else
+#error Boost not available!
+#endif
+
+#include "base/common.h"
+#include "base/types.h"
+#include "messages/task_heartbeat_message.pb.h"
+#include "messages/task_state_message.pb.h"
+
+namespace firmament {
+namespace executor {
+
+class TaskHeartbeatAggregator {
+ public:
+  typedef boost::function<void(const TaskHeartbeatBatchMessage&)>
+    BatchHandler;
+  typedef boost::function<void(const TaskStateMessage&)> StateHandler;
+
+  /**
+   * @param socket_path the path at which to create the socket; its directory
+   * is created if needed, and must be accessible only to the current user
+   * @param batch_interval_us the interval, in microseconds, at which
+   * batches are handed to the handler
+   * @param handler called with each non-empty batch on the aggregator thread
+   * @param state_handler called with each task state report on the
+   * aggregator thread
+   */
+  TaskHeartbeatAggregator(const string& socket_path,
+                          uint64_t batch_interval_us,
+                          BatchHandler handler,
+                          StateHandler state_handler);
+  ~TaskHeartbeatAggregator();
+
+  /**
+   * Creates the socket and starts the aggregator thread.
+   * @return false if the socket could not be set up, or if its directory is
+   * accessible to other users
+   */
+  bool Start();
+  /**
+   * Stops the aggregator thread after handing over the pending heartbeats,
+   * and removes the socket, as well as its directory if Start() created it.
+   */
+  void Stop();
+  /**
+   * @return the number of tasks whose heartbeats wait for the next batch
+   */
+  size_t NumPendingHeartbeats();
+  /**
+   * @param coordinator_uri the URI the coordinator listens on
+   * @return the path of the aggregator socket of the coordinator; executors
+   * use it to tell tasks where to send heartbeats
+   */
+  static string SocketPathForCoordinator(const string& coordinator_uri);
+  const string& socket_path() const {
+    return socket_path_;
+  }
+
+ private:
+  void FlushHeartbeats();
+  void ReceiveMessages();
+  void Run();
+  void Wake();
+
+  const string socket_path_;
+  const string socket_dir_;
+  bool created_socket_dir_;
+  const uint64_t batch_interval_us_;
+  BatchHandler handler_;
+  StateHandler state_handler_;
+  int socket_fd_;
+  int epoll_fd_;
+  int wake_fd_;
+  int timer_fd_;
+  volatile bool stop_;
+  boost::thread* thread_;
+  boost::mutex pending_lock_;
+  // The latest heartbeat received from each task since the last batch;
+  // guarded by pending_lock_.
+  unordered_map<TaskID_t, TaskHeartbeatMessage> pending_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_TASK_HEARTBEAT_AGGREGATOR_H
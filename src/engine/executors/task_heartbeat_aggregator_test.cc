@@ -0,0 +1,221 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for the per-machine collection of task heartbeats and state reports.
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "base/common.h"
+#include "engine/executors/task_heartbeat_aggregator.h"
+#include "messages/base_message.pb.h"
+#include "misc/utils.h"
+
+namespace firmament {
+namespace executor {
+
+class TaskHeartbeatAggregatorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    dir_ = MakeTemporaryDirectory("task_heartbeat_aggregator_test");
+    ASSERT_FALSE(dir_.empty());
+    socket_path_ = dir_ + "/heartbeats.sock";
+  }
+
+  virtual void TearDown() {
+    if (!dir_.empty()) {
+      EXPECT_TRUE(RemoveDirectoryRecursively(dir_));
+    }
+  }
+
+  // Sends a datagram to the aggregator's socket, as a task would.
+  void SendDatagram(const string& data) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(sendto(fd, data.data(), data.size(), 0,
+                     reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)),
+              static_cast<ssize_t>(data.size()));
+    close(fd);
+  }
+
+  void SendHeartbeat(TaskID_t task_id, uint64_t sequence_number) {
+    BaseMessage bm;
+    bm.mutable_task_heartbeat()->set_task_id(task_id);
+    bm.mutable_task_heartbeat()->set_sequence_number(sequence_number);
+    SendDatagram(bm.SerializeAsString());
+  }
+
+  void SendStateChange(TaskID_t task_id, TaskDescriptor::TaskState state) {
+    BaseMessage bm;
+    bm.mutable_task_state()->set_id(task_id);
+    bm.mutable_task_state()->set_new_state(state);
+    SendDatagram(bm.SerializeAsString());
+  }
+
+  void WaitForPending(TaskHeartbeatAggregator* aggregator, size_t num) {
+    for (uint32_t i = 0; i < 5000 && aggregator->NumPendingHeartbeats() < num;
+         ++i) {
+      usleep(1000);
+    }
+  }
+
+  size_t NumBatches() {
+    boost::lock_guard<boost::mutex> lock(batches_lock_);
+    return batches_.size();
+  }
+
+  size_t NumStateChanges() {
+    boost::lock_guard<boost::mutex> lock(batches_lock_);
+    return state_changes_.size();
+  }
+
+  string dir_;
+  string socket_path_;
+  boost::mutex batches_lock_;
+  vector<TaskHeartbeatBatchMessage> batches_;
+  vector<TaskStateMessage> state_changes_;
+
+ public:
+  void RecordBatch(const TaskHeartbeatBatchMessage& batch) {
+    boost::lock_guard<boost::mutex> lock(batches_lock_);
+    batches_.push_back(batch);
+  }
+
+  void RecordStateChange(const TaskStateMessage& msg) {
+    boost::lock_guard<boost::mutex> lock(batches_lock_);
+    state_changes_.push_back(msg);
+  }
+};
+
+TEST_F(TaskHeartbeatAggregatorTest, SocketPathForCoordinator) {
+  EXPECT_EQ(TaskHeartbeatAggregator::SocketPathForCoordinator(
+                "tcp:host-1.example.com:8080"),
+            "/tmp/firmament-heartbeats-tcp_host-1.example.com_8080/"
+            "heartbeats.sock");
+}
+
+TEST_F(TaskHeartbeatAggregatorTest, CreatesPrivateSocketDirectory) {
+  string socket_dir = dir_ + "/sockets";
+  TaskHeartbeatAggregator aggregator(
+      socket_dir + "/heartbeats.sock", 3600000000ULL,
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordBatch, this, _1),
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordStateChange, this, _1));
+  ASSERT_TRUE(aggregator.Start());
+  struct stat st;
+  ASSERT_EQ(stat(socket_dir.c_str(), &st), 0);
+  EXPECT_EQ(st.st_mode & 0777, 0700U);
+  aggregator.Stop();
+  EXPECT_NE(access(socket_dir.c_str(), F_OK), 0);
+}
+
+TEST_F(TaskHeartbeatAggregatorTest, RefusesSharedSocketDirectory) {
+  ASSERT_EQ(chmod(dir_.c_str(), 0777), 0);
+  TaskHeartbeatAggregator aggregator(
+      socket_path_, 3600000000ULL,
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordBatch, this, _1),
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordStateChange, this, _1));
+  EXPECT_FALSE(aggregator.Start());
+  EXPECT_NE(access(socket_path_.c_str(), F_OK), 0);
+}
+
+TEST_F(TaskHeartbeatAggregatorTest, BatchesLatestHeartbeats) {
+  TaskHeartbeatAggregator aggregator(
+      socket_path_, 3600000000ULL,
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordBatch, this, _1),
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordStateChange, this, _1));
+  ASSERT_TRUE(aggregator.Start());
+  SendHeartbeat(1, 0);
+  SendHeartbeat(2, 0);
+  SendHeartbeat(1, 1);
+  SendDatagram("not a heartbeat");
+  WaitForPending(&aggregator, 2);
+  EXPECT_EQ(aggregator.NumPendingHeartbeats(), 2U);
+  // Stopping hands over the pending heartbeats.
+  aggregator.Stop();
+  ASSERT_EQ(NumBatches(), 1U);
+  ASSERT_EQ(batches_[0].heartbeats_size(), 2);
+  for (int32_t i = 0; i < batches_[0].heartbeats_size(); ++i) {
+    const TaskHeartbeatMessage& heartbeat = batches_[0].heartbeats(i);
+    EXPECT_EQ(heartbeat.sequence_number(), heartbeat.task_id() == 1 ? 1 : 0);
+  }
+  EXPECT_NE(access(socket_path_.c_str(), F_OK), 0);
+}
+
+TEST_F(TaskHeartbeatAggregatorTest, FlushesEveryInterval) {
+  TaskHeartbeatAggregator aggregator(
+      socket_path_, 10000,
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordBatch, this, _1),
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordStateChange, this, _1));
+  ASSERT_TRUE(aggregator.Start());
+  SendHeartbeat(1, 0);
+  for (uint32_t i = 0; i < 5000 && NumBatches() == 0; ++i)
+    usleep(1000);
+  SendHeartbeat(1, 1);
+  for (uint32_t i = 0; i < 5000 && NumBatches() < 2; ++i)
+    usleep(1000);
+  aggregator.Stop();
+  // Intervals without heartbeats do not produce batches.
+  ASSERT_EQ(NumBatches(), 2U);
+  EXPECT_EQ(batches_[0].heartbeats(0).sequence_number(), 0U);
+  EXPECT_EQ(batches_[1].heartbeats(0).sequence_number(), 1U);
+}
+
+// State reports are handed over as they arrive, and replace the task's
+// pending heartbeat.
+TEST_F(TaskHeartbeatAggregatorTest, HandsOverStateChanges) {
+  TaskHeartbeatAggregator aggregator(
+      socket_path_, 3600000000ULL,
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordBatch, this, _1),
+      boost::bind(&TaskHeartbeatAggregatorTest::RecordStateChange, this, _1));
+  ASSERT_TRUE(aggregator.Start());
+  SendHeartbeat(1, 0);
+  SendHeartbeat(2, 0);
+  SendStateChange(1, TaskDescriptor::COMPLETED);
+  for (uint32_t i = 0; i < 5000 && NumStateChanges() == 0; ++i)
+    usleep(1000);
+  ASSERT_EQ(NumStateChanges(), 1U);
+  EXPECT_EQ(state_changes_[0].id(), 1U);
+  EXPECT_EQ(state_changes_[0].new_state(), TaskDescriptor::COMPLETED);
+  EXPECT_EQ(NumBatches(), 0U);
+  aggregator.Stop();
+  ASSERT_EQ(NumBatches(), 1U);
+  ASSERT_EQ(batches_[0].heartbeats_size(), 1);
+  EXPECT_EQ(batches_[0].heartbeats(0).task_id(), 2U);
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
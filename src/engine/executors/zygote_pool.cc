@@ -0,0 +1,330 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Pool of warm task processes for a task binary.
+
+#include "engine/executors/zygote_pool.h"
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+#include "engine/executors/process_launcher.h"
+
+namespace firmament {
+namespace executor {
+
+const char kZygoteSocketEnv[] = "FIRMAMENT_ZYGOTE_SOCKET";
+
+// Stop launching warm processes after this many of them in a row have died
+// before connecting, e.g. because the binary does not support zygote mode.
+static const uint32_t kMaxConsecutiveFailures = 3;
+// How often the pool thread checks for warm processes that died before
+// connecting.
+static const int kPollTimeoutMs = 1000;
+
+ZygotePool::ZygotePool(const string& binary,
+                       const unordered_map<string, string>& env,
+                       const string& socket_path,
+                       const string& log_prefix,
+                       uint32_t size)
+  : binary_(binary), env_(env), socket_path_(socket_path),
+    log_prefix_(log_prefix), size_(size), listen_fd_(-1),
+    num_launched_(0), consecutive_failures_(0), stop_(false), thread_(NULL) {
+  wake_pipe_[0] = -1;
+  wake_pipe_[1] = -1;
+  env_[kZygoteSocketEnv] = socket_path_;
+}
+
+ZygotePool::~ZygotePool() {
+  Stop();
+}
+
+bool ZygotePool::Start() {
+  struct sockaddr_un addr;
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    LOG(ERROR) << "Zygote socket path " << socket_path_ << " is too long";
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(socket_path_.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                      0);
+  if (listen_fd_ < 0 ||
+      bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)) != 0 ||
+      listen(listen_fd_, size_) != 0) {
+    PLOG(ERROR) << "Failed to listen on zygote socket " << socket_path_;
+    return false;
+  }
+  if (pipe2(wake_pipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+    PLOG(ERROR) << "Failed to create zygote pool wake-up pipe";
+    return false;
+  }
+  thread_ = new boost::thread(boost::bind(&ZygotePool::Run, this));
+  return true;
+}
+
+void ZygotePool::Stop() {
+  if (thread_) {
+    stop_ = true;
+    Wake();
+    thread_->join();
+    delete thread_;
+    thread_ = NULL;
+  }
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  for (deque<WarmProcess>::iterator it = idle_.begin();
+       it != idle_.end();
+       ++it) {
+    close(it->fd);
+    KillAndReap(it->pid);
+  }
+  idle_.clear();
+  for (set<pid_t>::iterator it = starting_.begin();
+       it != starting_.end();
+       ++it) {
+    KillAndReap(*it);
+  }
+  starting_.clear();
+  for (uint32_t i = 0; i < 2; ++i) {
+    if (wake_pipe_[i] >= 0) {
+      close(wake_pipe_[i]);
+      wake_pipe_[i] = -1;
+    }
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(socket_path_.c_str());
+  }
+}
+
+bool ZygotePool::Acquire(WarmProcess* process) {
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (idle_.empty())
+      return false;
+    *process = idle_.front();
+    idle_.pop_front();
+  }
+  // Launch a replacement.
+  Wake();
+  return true;
+}
+
+bool ZygotePool::Assign(const WarmProcess& process,
+                        const ZygoteTaskMessage& task) {
+  string buffer;
+  CHECK(task.SerializeToString(&buffer));
+  ssize_t sent;
+  while ((sent = send(process.fd, buffer.data(), buffer.size(),
+                      MSG_NOSIGNAL)) < 0 && errno == EINTR) {}
+  close(process.fd);
+  if (sent != static_cast<ssize_t>(buffer.size())) {
+    PLOG(WARNING) << "Failed to hand task " << task.task_id()
+                  << " to warm process " << process.pid;
+    KillAndReap(process.pid);
+    return false;
+  }
+  return true;
+}
+
+size_t ZygotePool::NumIdle() {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+void ZygotePool::AcceptWarmProcess() {
+  int fd = accept4(listen_fd_, NULL, NULL, SOCK_CLOEXEC);
+  if (fd < 0) {
+    if (errno != EINTR && errno != EAGAIN)
+      PLOG(WARNING) << "Failed to accept warm process on " << socket_path_;
+    return;
+  }
+  // Only accept processes that we launched ourselves.
+  struct ucred cred;
+  socklen_t cred_len = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0) {
+    PLOG(WARNING) << "Failed to identify process on " << socket_path_;
+    close(fd);
+    return;
+  }
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (starting_.erase(cred.pid) == 0) {
+    LOG(WARNING) << "Rejecting unknown process " << cred.pid << " on "
+                 << socket_path_;
+    close(fd);
+    return;
+  }
+  WarmProcess process;
+  process.pid = cred.pid;
+  process.fd = fd;
+  idle_.push_back(process);
+  consecutive_failures_ = 0;
+  VLOG(1) << "Warm process " << cred.pid << " for " << binary_ << " is ready";
+}
+
+void ZygotePool::KillAndReap(pid_t pid) {
+  kill(pid, SIGKILL);
+  while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+}
+
+void ZygotePool::LaunchWarmProcess() {
+  vector<string> argv;
+  argv.push_back(binary_);
+  ProcessLauncher launcher(argv, env_);
+  string log_file = log_prefix_ + "-" + to_string(num_launched_++);
+  launcher.set_stdout_path(log_file + "-stdout");
+  launcher.set_stderr_path(log_file + "-stderr");
+  int exec_errno;
+  pid_t pid = launcher.Launch(&exec_errno);
+  if (pid < 0) {
+    RecordLaunchFailure();
+    return;
+  }
+  if (exec_errno != 0) {
+    RecordLaunchFailure();
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+    return;
+  }
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  starting_.insert(pid);
+}
+
+void ZygotePool::RecordLaunchFailure() {
+  if (++consecutive_failures_ == kMaxConsecutiveFailures) {
+    LOG(ERROR) << "Warm processes for " << binary_ << " keep failing; no "
+               << "longer launching them.";
+  }
+}
+
+void ZygotePool::ReapFailedLaunches() {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  for (set<pid_t>::iterator it = starting_.begin(); it != starting_.end();) {
+    if (waitpid(*it, NULL, WNOHANG) == *it) {
+      LOG(WARNING) << "Warm process " << *it << " for " << binary_
+                   << " exited before connecting";
+      RecordLaunchFailure();
+      starting_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ZygotePool::RemoveDeadIdleProcesses(const vector<int>& dead_fds) {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  for (vector<int>::const_iterator fd_it = dead_fds.begin();
+       fd_it != dead_fds.end();
+       ++fd_it) {
+    for (deque<WarmProcess>::iterator it = idle_.begin();
+         it != idle_.end();
+         ++it) {
+      if (it->fd == *fd_it) {
+        LOG(WARNING) << "Idle warm process " << it->pid << " for " << binary_
+                     << " went away";
+        close(it->fd);
+        KillAndReap(it->pid);
+        idle_.erase(it);
+        break;
+      }
+    }
+  }
+}
+
+void ZygotePool::Run() {
+  vector<struct pollfd> fds;
+  while (!stop_) {
+    // Top up the pool.
+    while (!stop_) {
+      {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        if (idle_.size() + starting_.size() >= size_)
+          break;
+      }
+      if (consecutive_failures_ >= kMaxConsecutiveFailures)
+        break;
+      LaunchWarmProcess();
+    }
+    // Wait for a wake-up, a new warm process to connect, or an idle one to
+    // die (which makes its socket readable).
+    fds.clear();
+    struct pollfd pfd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    pfd.fd = wake_pipe_[0];
+    fds.push_back(pfd);
+    pfd.fd = listen_fd_;
+    fds.push_back(pfd);
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      for (deque<WarmProcess>::iterator it = idle_.begin();
+           it != idle_.end();
+           ++it) {
+        pfd.fd = it->fd;
+        fds.push_back(pfd);
+      }
+    }
+    int ret = poll(&fds[0], fds.size(), kPollTimeoutMs);
+    if (ret < 0 && errno != EINTR) {
+      PLOG(ERROR) << "Zygote pool poll failed";
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      char buf[64];
+      while (read(wake_pipe_[0], buf, sizeof(buf)) > 0) {}
+    }
+    // Idle processes are checked first: their FDs are not reused while they
+    // remain in idle_, since only Acquire() removes them and Assign() closes
+    // them.
+    vector<int> dead_fds;
+    for (size_t i = 2; i < fds.size(); ++i) {
+      if (fds[i].revents != 0)
+        dead_fds.push_back(fds[i].fd);
+    }
+    if (!dead_fds.empty())
+      RemoveDeadIdleProcesses(dead_fds);
+    if (fds[1].revents & POLLIN)
+      AcceptWarmProcess();
+    ReapFailedLaunches();
+  }
+}
+
+void ZygotePool::Wake() {
+  char c = 0;
+  if (wake_pipe_[1] >= 0 && write(wake_pipe_[1], &c, 1) < 0 &&
+      errno != EAGAIN) {
+    PLOG(WARNING) << "Failed to wake up zygote pool thread";
+  }
+}
+
+}  // namespace executor
+}  // namespace firmament
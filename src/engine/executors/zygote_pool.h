@@ -0,0 +1,151 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// A pool of warm (zygote) task processes for one task binary. Each process
+// has already exec'ed the binary, initialized task_lib and connected to the
+// coordinator, and waits on a UNIX domain socket to be handed a task. Running
+// a task on a warm process takes the fork, exec and task_lib start-up cost
+// off the task's critical path. Each warm process runs a single task; the
+// pool launches a replacement whenever one is taken.
+//
+// Only binaries that link task_lib through examples/task_lib_bridge.h support
+// running as a zygote.
+
+#ifndef FIRMAMENT_ENGINE_EXECUTORS_ZYGOTE_POOL_H
+#define FIRMAMENT_ENGINE_EXECUTORS_ZYGOTE_POOL_H
+
+#include <sys/types.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef __PLATFORM_HAS_BOOST__
+#include <boost/thread.hpp>
+#else
+#error Boost not available!
+#endif
+
+#include "base/common.h"
+#include "base/types.h"
+#include "messages/zygote_task_message.pb.h"
+
+namespace firmament {
+namespace executor {
+
+// The environment variable through which a warm process learns the path of
+// the socket to connect to.
+extern const char kZygoteSocketEnv[];
+
+struct WarmProcess {
+  WarmProcess() : pid(-1), fd(-1) {}
+  pid_t pid;
+  // Connected socket to the process.
+  int fd;
+};
+
+class ZygotePool {
+ public:
+  /**
+   * @param binary the task binary to keep warm processes of
+   * @param env the environment of the warm processes; task-specific
+   * variables are passed with each task
+   * @param socket_path the path at which to listen for warm processes
+   * @param log_prefix prefix of the warm processes' stdout and stderr log
+   * files, used until they are handed a task
+   * @param size the number of warm processes to keep
+   */
+  ZygotePool(const string& binary,
+             const unordered_map<string, string>& env,
+             const string& socket_path,
+             const string& log_prefix,
+             uint32_t size);
+  ~ZygotePool();
+
+  /**
+   * Starts listening and launching warm processes.
+   * @return false if the socket could not be set up
+   */
+  bool Start();
+
+  /**
+   * Stops launching warm processes and kills the idle ones.
+   */
+  void Stop();
+
+  /**
+   * Takes an idle warm process out of the pool. The caller can set up
+   * monitoring and resource isolation for the process before handing it its
+   * task with Assign().
+   * @param process set to the warm process
+   * @return false if no warm process is idle
+   */
+  bool Acquire(WarmProcess* process);
+
+  /**
+   * Hands a task to an acquired warm process, which then starts running it.
+   * If this fails, the process is killed and reaped.
+   * @param process the process returned by Acquire()
+   * @param task the task to run
+   * @return true if the task was handed over
+   */
+  bool Assign(const WarmProcess& process, const ZygoteTaskMessage& task);
+
+  inline const string& binary() const { return binary_; }
+  /**
+   * @return the number of idle warm processes
+   */
+  size_t NumIdle();
+
+ private:
+  void AcceptWarmProcess();
+  void KillAndReap(pid_t pid);
+  void LaunchWarmProcess();
+  void ReapFailedLaunches();
+  void RecordLaunchFailure();
+  void RemoveDeadIdleProcesses(const vector<int>& dead_fds);
+  void Run();
+  void Wake();
+
+  const string binary_;
+  unordered_map<string, string> env_;
+  const string socket_path_;
+  const string log_prefix_;
+  uint32_t size_;
+  int listen_fd_;
+  // Written to wake the pool thread up when a warm process is taken or the
+  // pool is stopped.
+  int wake_pipe_[2];
+  uint64_t num_launched_;
+  uint32_t consecutive_failures_;
+  volatile bool stop_;
+  boost::thread* thread_;
+  // Guards idle_ and starting_.
+  boost::mutex mutex_;
+  deque<WarmProcess> idle_;
+  // Processes that were launched but have not connected yet.
+  set<pid_t> starting_;
+};
+
+}  // namespace executor
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_EXECUTORS_ZYGOTE_POOL_H
@@ -0,0 +1,174 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for the pool of warm task processes. The test binary doubles as the
+// warm process: when started by the pool, it connects to the pool's socket
+// and writes the task it is handed to its stdout log.
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "base/common.h"
+#include "engine/executors/zygote_pool.h"
+#include "misc/utils.h"
+
+namespace firmament {
+namespace executor {
+
+// Connects to the socket of a pool; returns -1 on failure.
+static int ConnectToPool(const string& socket_path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+              sizeof(addr)) != 0) {
+    return -1;
+  }
+  return fd;
+}
+
+// Acts as a warm process: waits for a task and writes its arguments and
+// environment to the task's stdout log.
+int RunFakeWarmProcess(const string& socket_path) {
+  int fd = ConnectToPool(socket_path);
+  if (fd < 0)
+    return 1;
+  char buffer[4096];
+  ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+  close(fd);
+  ZygoteTaskMessage task;
+  if (len <= 0 || !task.ParseFromArray(buffer, len))
+    return 2;
+  ofstream out(task.stdout_path().c_str());
+  out << task.task_id();
+  for (int32_t i = 0; i < task.args_size(); ++i) {
+    out << " " << task.args(i);
+  }
+  for (int32_t i = 0; i < task.env_size(); ++i) {
+    out << " " << task.env(i);
+  }
+  return 0;
+}
+
+class ZygotePoolTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    dir_ = MakeTemporaryDirectory("firmament-zygote-test");
+    ASSERT_FALSE(dir_.empty());
+    char self[4096];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    ASSERT_GT(len, 0);
+    self[len] = '\0';
+    self_ = self;
+  }
+
+  void TearDown() {
+    EXPECT_TRUE(RemoveDirectoryRecursively(dir_));
+  }
+
+  // Waits up to five seconds for the pool to have num_idle idle processes.
+  bool WaitForIdle(ZygotePool* pool, size_t num_idle) {
+    for (uint32_t i = 0; i < 500; ++i) {
+      if (pool->NumIdle() == num_idle)
+        return true;
+      usleep(10000);
+    }
+    return false;
+  }
+
+  string dir_;
+  string self_;
+};
+
+TEST_F(ZygotePoolTest, HandsTaskToWarmProcess) {
+  ZygotePool pool(self_, unordered_map<string, string>(),
+                  dir_ + "/zygote.sock", dir_ + "/zygote", 1);
+  ASSERT_TRUE(pool.Start());
+  ASSERT_TRUE(WaitForIdle(&pool, 1));
+  WarmProcess process;
+  ASSERT_TRUE(pool.Acquire(&process));
+  ZygoteTaskMessage task;
+  task.set_task_id(42);
+  task.add_args("--flag");
+  task.add_env("FOO=bar");
+  task.set_stdout_path(dir_ + "/task-stdout");
+  ASSERT_TRUE(pool.Assign(process, task));
+  // The warm process is our child, so the executor can wait for it as for
+  // any other task process.
+  int status;
+  ASSERT_EQ(waitpid(process.pid, &status, 0), process.pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+  ifstream in((dir_ + "/task-stdout").c_str());
+  stringstream contents;
+  contents << in.rdbuf();
+  EXPECT_EQ(contents.str(), "42 --flag FOO=bar");
+  // The pool replaces the process it handed out.
+  EXPECT_TRUE(WaitForIdle(&pool, 1));
+  pool.Stop();
+  EXPECT_EQ(pool.NumIdle(), 0);
+}
+
+TEST_F(ZygotePoolTest, AcquireFailsWithoutIdleProcess) {
+  // /bin/true exits without connecting, so no process ever becomes idle.
+  ZygotePool pool("/bin/true", unordered_map<string, string>(),
+                  dir_ + "/zygote.sock", dir_ + "/zygote", 1);
+  ASSERT_TRUE(pool.Start());
+  WarmProcess process;
+  EXPECT_FALSE(pool.Acquire(&process));
+  pool.Stop();
+}
+
+TEST_F(ZygotePoolTest, RejectsUnknownProcess) {
+  ZygotePool pool(self_, unordered_map<string, string>(),
+                  dir_ + "/zygote.sock", dir_ + "/zygote", 0);
+  ASSERT_TRUE(pool.Start());
+  int fd = ConnectToPool(dir_ + "/zygote.sock");
+  ASSERT_GE(fd, 0);
+  // The pool hangs up on us, since it did not launch this process.
+  char buffer[16];
+  EXPECT_EQ(recv(fd, buffer, sizeof(buffer), 0), 0);
+  close(fd);
+  EXPECT_EQ(pool.NumIdle(), 0);
+  pool.Stop();
+}
+
+}  // namespace executor
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  const char* socket_path = getenv(firmament::executor::kZygoteSocketEnv);
+  if (socket_path)
+    return firmament::executor::RunFakeWarmProcess(socket_path);
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -23,7 +23,6 @@
 
 #include "engine/health_monitor.h"
 
-#include <unistd.h>
 #include <vector>
 
 #include "misc/map-util.h"
@@ -37,16 +36,28 @@ DEFINE_int32(health_monitor_check_frequency, 10000000ULL,
 
 namespace firmament {
 
-HealthMonitor::HealthMonitor() {
+HealthMonitor::HealthMonitor() : woken_(false) {
 }
 
 void HealthMonitor::Run(SchedulerInterface* scheduler,
                         shared_ptr<ResourceMap_t> resources) {
   while (FLAGS_health_monitor_enable) {
-    usleep(FLAGS_health_monitor_check_frequency);
+    {
+      boost::unique_lock<boost::mutex> lock(wake_lock_);
+      boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::microseconds(FLAGS_health_monitor_check_frequency);
+      while (!woken_ && wake_cond_.timed_wait(lock, deadline)) {}
+      woken_ = false;
+    }
     VLOG(1) << "Health monitor checking on things...";
     scheduler->CheckRunningTasksHealth();
   }
 }
 
+void HealthMonitor::Wake() {
+  boost::lock_guard<boost::mutex> lock(wake_lock_);
+  woken_ = true;
+  wake_cond_.notify_one();
+}
+
 }  // namespace firmament
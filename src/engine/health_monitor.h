@@ -28,6 +28,9 @@
 #include <map>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include "base/common.h"
 #include "base/types.h"
 #include "scheduling/scheduler_interface.h"
@@ -41,8 +44,18 @@ class HealthMonitor {
   HealthMonitor();
   void Run(SchedulerInterface* scheduler,
            shared_ptr<ResourceMap_t> resources);
+  /**
+   * Makes the monitor check on things right away rather than at the end of
+   * the current interval. Does not block; safe to call from any thread.
+   */
+  void Wake();
 
  protected:
+  boost::mutex wake_lock_;
+  boost::condition_variable wake_cond_;
+  // Set by Wake() and cleared when the monitor wakes up; guarded by
+  // wake_lock_.
+  bool woken_;
 };
 
 }  // namespace firmament
@@ -0,0 +1,150 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Delta encoding of resource heartbeats.
+
+#include "engine/heartbeat_delta.h"
+
+#include "misc/pb_utils.h"
+
+DEFINE_uint64(heartbeat_delta_window, 32,
+              "Maximum number of unacknowledged heartbeats whose state is kept "
+              "for delta encoding.");
+
+namespace firmament {
+
+HeartbeatDeltaEncoder::HeartbeatDeltaEncoder(const string& uuid)
+  : uuid_(uuid), next_seq_(1), acked_seq_(0) {
+}
+
+void HeartbeatDeltaEncoder::EncodeHeartbeat(const string& location,
+                                            uint64_t capacity,
+                                            const ResourceStats& stats,
+                                            HeartbeatMessage* msg) {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  uint64_t seq = next_seq_++;
+  msg->set_uuid(uuid_);
+  msg->set_seq(seq);
+  // A delta cannot express an empty location or a zero capacity, since those
+  // mean "unchanged"; send a full heartbeat in that case.
+  if (acked_seq_ == 0 ||
+      (location.empty() && !acked_state_.location().empty()) ||
+      (capacity == 0 && acked_state_.capacity() != 0)) {
+    msg->set_location(location);
+    msg->set_capacity(capacity);
+    msg->mutable_load()->CopyFrom(stats);
+  } else {
+    msg->set_base_seq(acked_seq_);
+    if (location != acked_state_.location())
+      msg->set_location(location);
+    if (capacity != acked_state_.capacity())
+      msg->set_capacity(capacity);
+    DiffProtobuf(acked_state_.load(), stats, msg->mutable_load(),
+                 msg->mutable_cleared_load_fields());
+  }
+  HeartbeatMessage* state = &unacked_states_[seq];
+  state->set_location(location);
+  state->set_capacity(capacity);
+  state->mutable_load()->CopyFrom(stats);
+  // If the receiver stops acknowledging heartbeats, keep only the most recent
+  // ones; we continue to send deltas against the last acknowledged state.
+  while (unacked_states_.size() > FLAGS_heartbeat_delta_window)
+    unacked_states_.erase(unacked_states_.begin());
+}
+
+void HeartbeatDeltaEncoder::HandleAck(const HeartbeatAckMessage& ack) {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  if (ack.resync()) {
+    VLOG(1) << "Receiver requested full heartbeat for " << uuid_;
+    acked_seq_ = 0;
+    acked_state_.Clear();
+    unacked_states_.clear();
+    return;
+  }
+  map<uint64_t, HeartbeatMessage>::iterator it =
+    unacked_states_.find(ack.seq());
+  if (it == unacked_states_.end()) {
+    // Stale or duplicate acknowledgement
+    return;
+  }
+  acked_seq_ = ack.seq();
+  acked_state_.Swap(&it->second);
+  unacked_states_.erase(unacked_states_.begin(), ++it);
+}
+
+void HeartbeatDeltaEncoder::Reset() {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  acked_seq_ = 0;
+  acked_state_.Clear();
+  unacked_states_.clear();
+}
+
+bool HeartbeatDeltaDecoder::DecodeHeartbeat(const HeartbeatMessage& msg,
+                                            HeartbeatMessage* state,
+                                            HeartbeatAckMessage* ack) {
+  if (msg.seq() == 0) {
+    // Legacy heartbeat, always in full.
+    state->set_location(msg.location());
+    state->set_capacity(msg.capacity());
+    state->mutable_load()->CopyFrom(msg.load());
+    return true;
+  }
+  ack->set_uuid(msg.uuid());
+  ack->set_seq(msg.seq());
+  boost::lock_guard<boost::mutex> lock(lock_);
+  map<uint64_t, HeartbeatMessage>* states = &resource_states_[msg.uuid()];
+  if (msg.base_seq() == 0) {
+    state->set_location(msg.location());
+    state->set_capacity(msg.capacity());
+    state->mutable_load()->CopyFrom(msg.load());
+    states->clear();
+  } else {
+    map<uint64_t, HeartbeatMessage>::iterator base_it =
+      states->find(msg.base_seq());
+    if (base_it == states->end()) {
+      VLOG(1) << "Unknown base " << msg.base_seq() << " for heartbeat "
+              << msg.seq() << " from " << msg.uuid()
+              << "; requesting full heartbeat.";
+      ack->set_resync(true);
+      return false;
+    }
+    state->CopyFrom(base_it->second);
+    if (!msg.location().empty())
+      state->set_location(msg.location());
+    if (msg.capacity() != 0)
+      state->set_capacity(msg.capacity());
+    ApplyProtobufDelta(msg.load(), msg.cleared_load_fields(),
+                       state->mutable_load());
+    // The sender's base only moves forward, so older states are no longer
+    // needed.
+    states->erase(states->begin(), base_it);
+  }
+  (*states)[msg.seq()].CopyFrom(*state);
+  while (states->size() > FLAGS_heartbeat_delta_window)
+    states->erase(states->begin());
+  return true;
+}
+
+void HeartbeatDeltaDecoder::RemoveResource(const string& uuid) {
+  boost::lock_guard<boost::mutex> lock(lock_);
+  resource_states_.erase(uuid);
+}
+
+}  // namespace firmament
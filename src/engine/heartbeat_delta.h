@@ -0,0 +1,111 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Delta encoding of resource heartbeats. The sender diffs each heartbeat
+// against the last heartbeat the receiver acknowledged; the receiver keeps the
+// heartbeats it has acknowledged until they can no longer serve as a base, and
+// asks for a full heartbeat if a delta's base is unknown to it.
+
+#ifndef FIRMAMENT_ENGINE_HEARTBEAT_DELTA_H
+#define FIRMAMENT_ENGINE_HEARTBEAT_DELTA_H
+
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <string>
+
+#include "base/common.h"
+#include "base/resource_stats.pb.h"
+#include "messages/heartbeat_message.pb.h"
+
+namespace firmament {
+
+class HeartbeatDeltaEncoder {
+ public:
+  /**
+   * @param uuid the UUID of the resource sending heartbeats
+   */
+  explicit HeartbeatDeltaEncoder(const string& uuid);
+
+  /**
+   * Encodes a heartbeat, as a delta if the receiver has acknowledged an
+   * earlier heartbeat, and in full otherwise.
+   * @param location the location of the resource
+   * @param capacity the capacity of the resource
+   * @param stats the resource's current statistics
+   * @param msg the heartbeat message to populate
+   */
+  void EncodeHeartbeat(const string& location, uint64_t capacity,
+                       const ResourceStats& stats, HeartbeatMessage* msg);
+
+  /**
+   * Handles the receiver's acknowledgement of a heartbeat.
+   * @param ack the acknowledgement
+   */
+  void HandleAck(const HeartbeatAckMessage& ack);
+
+  /**
+   * Forgets all acknowledged state, so that the next heartbeat is sent in
+   * full. Used when the connection to the receiver is re-established.
+   */
+  void Reset();
+
+ private:
+  boost::mutex lock_;
+  string uuid_;
+  uint64_t next_seq_;
+  // Sequence number and state of the last acknowledged heartbeat; the sequence
+  // number is 0 if there is none.
+  uint64_t acked_seq_;
+  HeartbeatMessage acked_state_;
+  // The state of heartbeats sent after acked_seq_, by sequence number.
+  map<uint64_t, HeartbeatMessage> unacked_states_;
+};
+
+class HeartbeatDeltaDecoder {
+ public:
+  /**
+   * Reconstructs the full state of a resource from a heartbeat.
+   * @param msg the received heartbeat
+   * @param state set to the resource's location, capacity and load
+   * @param ack set to the acknowledgement to return to the sender if msg has a
+   * sequence number
+   * @return false if msg is a delta whose base is unknown, in which case ack
+   * requests a full heartbeat and state is not set
+   */
+  bool DecodeHeartbeat(const HeartbeatMessage& msg, HeartbeatMessage* state,
+                       HeartbeatAckMessage* ack);
+
+  /**
+   * Drops the state kept for a resource.
+   * @param uuid the UUID of the resource
+   */
+  void RemoveResource(const string& uuid);
+
+ private:
+  boost::mutex lock_;
+  // For each resource, the state of the heartbeats we have acknowledged and
+  // that may still be used as a base, by sequence number.
+  unordered_map<string, map<uint64_t, HeartbeatMessage> > resource_states_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_ENGINE_HEARTBEAT_DELTA_H
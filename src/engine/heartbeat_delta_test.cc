@@ -0,0 +1,139 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Heartbeat delta encoding unit tests.
+
+#include <gtest/gtest.h>
+
+#include <google/protobuf/util/message_differencer.h>
+
+#include "base/common.h"
+#include "engine/heartbeat_delta.h"
+
+namespace firmament {
+
+using google::protobuf::util::MessageDifferencer;
+
+// The fixture for testing classes HeartbeatDeltaEncoder and
+// HeartbeatDeltaDecoder.
+class HeartbeatDeltaTest : public ::testing::Test {
+ protected:
+  HeartbeatDeltaTest() : encoder_("resource") {}
+
+  ResourceStats MakeStats(uint64_t timestamp, double cpu_utilization) {
+    ResourceStats stats;
+    stats.set_resource_id("resource");
+    stats.set_timestamp(timestamp);
+    stats.set_mem_capacity(16 * 1024 * 1024);
+    stats.set_mem_allocatable(8 * 1024 * 1024);
+    for (uint32_t i = 0; i < 4; ++i) {
+      CpuStats* cpu_stats = stats.add_cpus_stats();
+      cpu_stats->set_cpu_capacity(1000);
+      cpu_stats->set_cpu_allocatable(500);
+      cpu_stats->set_cpu_utilization(cpu_utilization);
+    }
+    return stats;
+  }
+
+  // Encodes and decodes a heartbeat, and acknowledges it if ack is true.
+  // Returns false if the decoder requested a resync.
+  bool SendHeartbeat(const ResourceStats& stats, bool ack,
+                     HeartbeatMessage* msg, HeartbeatMessage* state) {
+    msg->Clear();
+    encoder_.EncodeHeartbeat("tcp:localhost:9998", 4, stats, msg);
+    HeartbeatAckMessage ack_msg;
+    bool applied = decoder_.DecodeHeartbeat(*msg, state, &ack_msg);
+    if (ack)
+      encoder_.HandleAck(ack_msg);
+    return applied;
+  }
+
+  HeartbeatDeltaEncoder encoder_;
+  HeartbeatDeltaDecoder decoder_;
+};
+
+// Tests that heartbeats after the first acknowledged one only carry changes,
+// and that the decoder reconstructs the full state.
+TEST_F(HeartbeatDeltaTest, SendsOnlyChangedFields) {
+  HeartbeatMessage msg;
+  HeartbeatMessage state;
+  ResourceStats stats = MakeStats(1, 0.5);
+  EXPECT_TRUE(SendHeartbeat(stats, true, &msg, &state));
+  EXPECT_EQ(msg.base_seq(), 0ULL);
+  EXPECT_TRUE(MessageDifferencer::Equals(state.load(), stats));
+  size_t full_size = msg.ByteSize();
+  stats.set_timestamp(2);
+  EXPECT_TRUE(SendHeartbeat(stats, true, &msg, &state));
+  EXPECT_EQ(msg.base_seq(), 1ULL);
+  EXPECT_TRUE(msg.location().empty());
+  EXPECT_EQ(msg.load().cpus_stats_size(), 0);
+  EXPECT_LT(msg.ByteSize() * 4, full_size);
+  EXPECT_TRUE(MessageDifferencer::Equals(state.load(), stats));
+  EXPECT_EQ(state.location(), "tcp:localhost:9998");
+  EXPECT_EQ(state.capacity(), 4ULL);
+}
+
+// Tests that fields reset to their defaults are cleared on the receiver.
+TEST_F(HeartbeatDeltaTest, ClearsResetFields) {
+  HeartbeatMessage msg;
+  HeartbeatMessage state;
+  ResourceStats stats = MakeStats(1, 0.5);
+  EXPECT_TRUE(SendHeartbeat(stats, true, &msg, &state));
+  stats.set_timestamp(2);
+  stats.set_mem_allocatable(0);
+  stats.clear_cpus_stats();
+  EXPECT_TRUE(SendHeartbeat(stats, true, &msg, &state));
+  EXPECT_EQ(msg.cleared_load_fields_size(), 2);
+  EXPECT_TRUE(MessageDifferencer::Equals(state.load(), stats));
+}
+
+// Tests that deltas stay decodable when acknowledgements are lost.
+TEST_F(HeartbeatDeltaTest, DeltasAgainstLastAcknowledged) {
+  HeartbeatMessage msg;
+  HeartbeatMessage state;
+  EXPECT_TRUE(SendHeartbeat(MakeStats(1, 0.5), true, &msg, &state));
+  for (uint64_t i = 2; i < 10; ++i) {
+    ResourceStats stats = MakeStats(i, 0.1 * i);
+    EXPECT_TRUE(SendHeartbeat(stats, false, &msg, &state));
+    EXPECT_EQ(msg.base_seq(), 1ULL);
+    EXPECT_TRUE(MessageDifferencer::Equals(state.load(), stats));
+  }
+}
+
+// Tests that a delta against an unknown base leads to a full resync.
+TEST_F(HeartbeatDeltaTest, ResyncsOnUnknownBase) {
+  HeartbeatMessage msg;
+  HeartbeatMessage state;
+  EXPECT_TRUE(SendHeartbeat(MakeStats(1, 0.5), true, &msg, &state));
+  // The receiver loses its state, e.g. because it restarted.
+  decoder_.RemoveResource("resource");
+  EXPECT_FALSE(SendHeartbeat(MakeStats(2, 0.5), true, &msg, &state));
+  ResourceStats stats = MakeStats(3, 0.5);
+  EXPECT_TRUE(SendHeartbeat(stats, true, &msg, &state));
+  EXPECT_EQ(msg.base_seq(), 0ULL);
+  EXPECT_TRUE(MessageDifferencer::Equals(state.load(), stats));
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -86,6 +86,17 @@ bool Node::SendMessageToRemote(
   return chan->SendS(envelope);
 }
 
+bool Node::QueueMessageToRemote(
+    StreamSocketsChannel<BaseMessage>* chan,
+    BaseMessage* msg) {
+  Envelope<BaseMessage> envelope(msg);
+  // The message is serialized into the channel's queue, so it need not
+  // outlive the call either way.
+  if (FLAGS_stream_sockets_batching)
+    return chan->EnqueueS(envelope);
+  return chan->SendS(envelope);
+}
+
 void Node::HandleWrite(const boost::system::error_code& error,
                        size_t bytes_transferred) {
   VLOG(3) << "In HandleWrite, thread is " << boost::this_thread::get_id();
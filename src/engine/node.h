@@ -66,6 +66,11 @@ class Node {
   bool SendMessageToRemote(
       StreamSocketsChannel<BaseMessage>* chan,
       BaseMessage* msg);
+  // With --stream_sockets_batching, queues the message on the channel, to go
+  // out with the next flush or send there; otherwise sends it right away.
+  bool QueueMessageToRemote(
+      StreamSocketsChannel<BaseMessage>* chan,
+      BaseMessage* msg);
   virtual void HandleIncomingMessage(BaseMessage *bm,
                                      const string& remote_endpoint) = 0;
   void HandleIncomingReceiveError(const boost::system::error_code& error,
@@ -20,12 +20,16 @@
 
 // SimpleScheduler class unit tests.
 
+#include <sys/wait.h>
+
 #include <set>
 
+#include <boost/thread.hpp>
 #include <gtest/gtest.h>
 
 #include "base/common.h"
 #include "base/job_desc.pb.h"
+#include "base/resource_status.h"
 #include "base/task_desc.pb.h"
 #include "misc/map-util.h"
 #include "misc/wall_time.h"
@@ -51,7 +55,8 @@ class SimpleSchedulerTest : public ::testing::Test {
     job_map_(new JobMap_t),
     res_map_(new ResourceMap_t),
     obj_store_(new store::SimpleObjectStore(GenerateResourceID())),
-    task_map_(new TaskMap_t) {
+    task_map_(new TaskMap_t),
+    trace_generator_(&wall_time_) {
     // You can do set-up work for each test here.
     FLAGS_v = 3;
   }
@@ -69,13 +74,13 @@ class SimpleSchedulerTest : public ::testing::Test {
     res_map_->clear();
     job_map_->clear();
     obj_store_->Flush();
-    WallTime wall_time;
     sched_.reset(new SimpleScheduler(job_map_, res_map_, &res_topo_,
                                      obj_store_, task_map_,
-                                     shared_ptr<KnowledgeBase>(),
+                                     shared_ptr<KnowledgeBase>(
+                                         new KnowledgeBase),
                                      shared_ptr<TopologyManager>(), NULL, NULL,
                                      GenerateResourceID(), "test",
-                                     &wall_time, NULL));
+                                     &wall_time_, &trace_generator_));
   }
 
   virtual void TearDown() {
@@ -108,6 +113,8 @@ class SimpleSchedulerTest : public ::testing::Test {
   ResourceTopologyNodeDescriptor res_topo_;
   shared_ptr<store::SimpleObjectStore> obj_store_;
   shared_ptr<TaskMap_t> task_map_;
+  WallTime wall_time_;
+  TraceGenerator trace_generator_;
 };
 
 // Tests that the lazy graph reduction algorithm correctly identifies runnable
@@ -270,6 +277,42 @@ TEST_F(SimpleSchedulerTest, FindRunnableTasksForComplexJob2) {
   delete test_job;
 }
 
+// Tests that a task process failing while the scheduler places another task
+// does not block the supervisor thread that reports the exit, and that the
+// task is declared failed once the placement has finished.
+TEST_F(SimpleSchedulerTest, TaskProcessFailsDuringPlacement) {
+  ResourceID_t res_id = GenerateResourceID();
+  ResourceDescriptor* rd_ptr = res_topo_.mutable_resource_desc();
+  rd_ptr->set_uuid(to_string(res_id));
+  rd_ptr->set_type(ResourceDescriptor::RESOURCE_PU);
+  ResourceStatus rs(rd_ptr, &res_topo_, "test", 0);
+  CHECK(InsertIfNotPresent(res_map_.get(), res_id, &rs));
+  sched_->RegisterLocalResource(res_id);
+  JobID_t job_id = GenerateJobID();
+  TaskDescriptor td;
+  td.set_uid(1);
+  td.set_job_id(to_string(job_id));
+  td.set_state(TaskDescriptor::RUNNING);
+  td.set_scheduled_to_resource(rd_ptr->uuid());
+  AddTaskToTaskMap(&td);
+  sched_->BindTaskToResource(&td, rd_ptr);
+  // Placements hold the scheduling lock while the supervisor thread launches
+  // the task's process.
+  boost::unique_lock<boost::recursive_mutex> placement_lock(
+      sched_->scheduling_lock_);
+  boost::thread supervisor(
+      boost::bind(&SimpleScheduler::HandleTaskProcessExit, sched_.get(),
+                  td.uid(), W_EXITCODE(1, 0)));
+  EXPECT_TRUE(supervisor.try_join_for(boost::chrono::seconds(5)));
+  EXPECT_EQ(td.state(), TaskDescriptor::RUNNING);
+  placement_lock.unlock();
+  supervisor.join();
+  sched_->CheckRunningTasksHealth();
+  EXPECT_EQ(td.state(), TaskDescriptor::FAILED);
+  EXPECT_TRUE(sched_->BoundResourceForTask(td.uid()) == NULL);
+  res_map_->clear();
+}
+
 }  // namespace scheduler
 }  // namespace firmament
 
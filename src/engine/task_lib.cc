@@ -25,19 +25,27 @@
 #include "engine/task_lib.h"
 
 #include <vector>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <iostream>
+#include <math.h>
 #include <unistd.h>
 #include <string>
 
 #include "base/common.h"
 #include "base/data_object.h"
 #include "base/units.h"
+#include "messages/object_publish_message.pb.h"
 #include "messages/registration_message.pb.h"
 #include "messages/task_heartbeat_message.pb.h"
 #include "messages/task_info_message.pb.h"
 #include "messages/task_spawn_message.pb.h"
 #include "messages/task_state_message.pb.h"
+#include "messages/zygote_task_message.pb.h"
 #include "misc/utils.h"
 #include "platforms/common.h"
 
@@ -49,9 +57,18 @@ DEFINE_string(task_id, "", "The ID of this task.");
 DEFINE_uint64(heartbeat_interval, 1000000,
         "The interval, in microseconds, between heartbeats sent to the"
         "coordinator.");
+DEFINE_uint64(max_heartbeat_interval, 10000000,
+              "The longest interval, in microseconds, between heartbeats of "
+              "a task whose resource usage is steady.");
+DEFINE_double(heartbeat_steady_threshold, 0.1,
+              "Relative change in memory use or CPU rate between heartbeats "
+              "up to which a task's resource usage counts as steady.");
 
 DEFINE_string(tasklib_application, "",
               "The application running alongside tasklib");
+DEFINE_uint64(object_fetch_timeout_ms, 60000,
+              "Maximum time, in milliseconds, that a task waits for an input "
+              "object that is still being fetched from another machine.");
 
 #define SET_PROTO_IF_DICT_HAS_INT(proto, dict, member, val) \
   val = json_object_get(dict, # member); \
@@ -64,15 +81,31 @@ DEFINE_string(tasklib_application, "",
 
 namespace firmament {
 
+// Heartbeats sent at the base interval after a task starts.
+static const uint64_t kNumStartupHeartbeats = 5;
+
+static double RelativeChange(double old_value, double new_value) {
+  if (old_value == new_value)
+    return 0.0;
+  return fabs(new_value - old_value) / max(old_value, new_value);
+}
+
 TaskLib::TaskLib()
   : m_adapter_(new StreamSocketsAdapter<BaseMessage>()),
     chan_(new StreamSocketsChannel<BaseMessage>(
         StreamSocketsChannel<BaseMessage>::SS_TCP)),
     coordinator_uri_(""),
     resource_id_(GenerateResourceID()),
+    object_store_(NULL),
     pid_(getpid()),
     task_running_(false),
     heartbeat_seq_number_(0),
+    heartbeat_fd_(-1),
+    heartbeat_interval_(FLAGS_heartbeat_interval),
+    last_rss_(0),
+    last_cpu_ticks_(0),
+    last_cpu_rate_(0.0),
+    last_sample_time_(0),
     stop_(false),
     internal_completed_(false),
     completed_(0),
@@ -85,33 +118,26 @@ TaskLib::TaskLib()
   else
     LOG(ERROR) << "No coordinator_uri environment variable!";
 
-  const char* task_id_env = getenv("FLAGS_task_id");
-  VLOG(1) << "Task ID is " << task_id_env;
-  CHECK_NOTNULL(task_id_env);
-  task_id_ = TaskIDFromString(task_id_env);
-
   char* res_id_env = getenv("FLAGS_resource_id");
   if (res_id_env)
     resource_id_ = ResourceIDFromString(res_id_env);
-
-  stringstream ss;
-  ss << "/tmp/" << task_id_env << ".pid";
-  string pid_filename = ss.str();
-
-  FILE* pid_file;
-  pid_file = fopen(pid_filename.c_str(), "w");
-  if (!pid_file) {
-    PLOG(ERROR) << "Failed to create PID file (" << pid_filename << ")";
-  } else {
-    int pid = getpid();
-    fprintf(pid_file, "%d", pid);
-    CHECK_EQ(fclose(pid_file), 0);
-  }
+  object_store_ = new store::ShmObjectStore(resource_id_);
 
   use_procfs_ = true;
+
+  // Warm (zygote) processes learn their task ID in AwaitZygoteTask().
+  const char* task_id_env = getenv("FLAGS_task_id");
+  if (!task_id_env && getenv("FIRMAMENT_ZYGOTE_SOCKET"))
+    return;
+  VLOG(1) << "Task ID is " << task_id_env;
+  CHECK_NOTNULL(task_id_env);
+  SetTaskID(TaskIDFromString(task_id_env));
 }
 
 TaskLib::~TaskLib() {
+  if (heartbeat_fd_ >= 0)
+    close(heartbeat_fd_);
+  delete object_store_;
 }
 
 void TaskLib::Stop(bool success) {
@@ -164,6 +190,104 @@ void TaskLib::SetCompleted(double completed) {
   internal_completed_ = true;
 }
 
+bool TaskLib::AwaitZygoteTask(const string& socket_path,
+                              vector<string>* args) {
+  // Do the slow set-up work while we wait.
+  if (coordinator_uri_.empty())
+    coordinator_uri_ = FLAGS_coordinator_uri;
+  LOG(INFO) << "Connecting to coordinator at " << coordinator_uri_;
+  if (!ConnectToCoordinator(coordinator_uri_)) {
+    LOG(ERROR) << "Failed to connect to coordinator at " << coordinator_uri_;
+    return false;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0 ||
+      connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+              sizeof(addr)) != 0) {
+    PLOG(ERROR) << "Failed to connect to zygote socket " << socket_path;
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  LOG(INFO) << "Waiting for a task on " << socket_path;
+  // Peek first to find out how large the task message is.
+  char peek;
+  ssize_t len;
+  while ((len = recv(fd, &peek, 1, MSG_PEEK | MSG_TRUNC)) < 0 &&
+         errno == EINTR) {}
+  if (len <= 0) {
+    if (len < 0)
+      PLOG(ERROR) << "Failed to receive task on " << socket_path;
+    close(fd);
+    return false;
+  }
+  string buffer(len, '\0');
+  len = recv(fd, &buffer[0], buffer.size(), 0);
+  close(fd);
+  ZygoteTaskMessage task;
+  if (len != static_cast<ssize_t>(buffer.size()) ||
+      !task.ParseFromString(buffer)) {
+    LOG(ERROR) << "Failed to parse task received on " << socket_path;
+    return false;
+  }
+  for (int32_t i = 0; i < task.env_size(); ++i) {
+    size_t pos = task.env(i).find('=');
+    if (pos == string::npos)
+      continue;
+    setenv(task.env(i).substr(0, pos).c_str(),
+           task.env(i).substr(pos + 1).c_str(), 1);
+  }
+  // A cold task parses its arguments, including --tryfromenv, with its own
+  // environment in place; the warm process parsed only its own. Parse the
+  // task's now, so that it sees the flags it would have been started with.
+  vector<char*> flag_argv;
+  flag_argv.push_back(const_cast<char*>("task_lib"));
+  for (int32_t i = 0; i < task.args_size(); ++i) {
+    flag_argv.push_back(const_cast<char*>(task.args(i).c_str()));
+  }
+  int flag_argc = flag_argv.size();
+  char** flag_argv_ptr = &flag_argv[0];
+  google::ParseCommandLineNonHelpFlags(&flag_argc, &flag_argv_ptr, false);
+  // The connection to the coordinator and the object store were set up for
+  // the warm process's resource already, and cannot be changed.
+  if ((!FLAGS_coordinator_uri.empty() &&
+       FLAGS_coordinator_uri != coordinator_uri_) ||
+      (!FLAGS_resource_id.empty() &&
+       ResourceIDFromString(FLAGS_resource_id) != resource_id_)) {
+    LOG(ERROR) << "Task " << task.task_id() << " runs on resource "
+               << FLAGS_resource_id << " of coordinator "
+               << FLAGS_coordinator_uri << ", which differ from those of "
+               << "this warm process";
+    return false;
+  }
+  FLAGS_task_id = to_string(task.task_id());
+  // Switch output over to the task's log files.
+  fflush(stdout);
+  fflush(stderr);
+  if (!task.stdout_path().empty()) {
+    int out_fd = open(task.stdout_path().c_str(), O_RDWR | O_CREAT, 0644);
+    if (out_fd >= 0) {
+      dup2(out_fd, STDOUT_FILENO);
+      close(out_fd);
+    }
+  }
+  if (!task.stderr_path().empty()) {
+    int err_fd = open(task.stderr_path().c_str(), O_RDWR | O_CREAT, 0644);
+    if (err_fd >= 0) {
+      dup2(err_fd, STDERR_FILENO);
+      close(err_fd);
+    }
+  }
+  args->assign(task.args().begin(), task.args().end());
+  SetTaskID(task.task_id());
+  LOG(INFO) << "Running task " << task_id_ << " in warm process " << pid_;
+  return true;
+}
+
 bool TaskLib::ConnectToCoordinator(const string& coordinator_uri) {
   return m_adapter_->EstablishChannel(coordinator_uri, chan_);
 }
@@ -206,8 +330,50 @@ void TaskLib::Spawn(const ReferenceInterface& code,
   SendMessageToCoordinator(&msg);
 }
 
-void TaskLib::Publish(const vector<ConcreteReference>& /*references*/) {
-  LOG(ERROR) << "Output publication currently unimplemented!";
+void TaskLib::Publish(const vector<ConcreteReference>& references) {
+  BaseMessage msg;
+  SUBMSG_WRITE(msg, object_publish, task_id, task_id_);
+  for (vector<ConcreteReference>::const_iterator it = references.begin();
+       it != references.end();
+       ++it) {
+    ReferenceDescriptor* rd =
+      msg.mutable_object_publish()->add_references();
+    rd->CopyFrom(it->desc());
+    rd->set_producing_task(task_id_);
+  }
+  if (!SendMessageToCoordinator(&msg))
+    LOG(ERROR) << "Failed to publish " << references.size() << " objects!";
+}
+
+void* TaskLib::GetObjectStart(const DataObjectID_t& id) {
+  // Inputs held remotely are fetched while the task starts up, so they may
+  // not have been sealed yet.
+  if (!object_store_->WaitForObject(id, FLAGS_object_fetch_timeout_ms * 1000))
+    return NULL;
+  // The store hands out read-only mappings; the non-const return type is
+  // kept for existing task code.
+  return const_cast<void*>(object_store_->GetObjectStart(id, NULL));
+}
+
+void TaskLib::GetObjectEnd(const DataObjectID_t& id) {
+  object_store_->GetObjectEnd(id);
+}
+
+void* TaskLib::PutObjectStart(const DataObjectID_t& id, size_t size) {
+  return object_store_->PutObjectStart(id, size);
+}
+
+void TaskLib::PutObjectEnd(const DataObjectID_t& id, size_t size) {
+  if (!object_store_->PutObjectEnd(id, size))
+    return;
+  vector<ConcreteReference> refs;
+  refs.push_back(ConcreteReference(id, size, ""));
+  Publish(refs);
+}
+
+void* TaskLib::Extend(const DataObjectID_t& id, size_t old_size,
+                      size_t new_size) {
+  return object_store_->Extend(id, old_size, new_size);
 }
 
 void TaskLib::ConvertTaskArgs(int argc, char *argv[], vector<char*>* arg_vec) {
@@ -275,8 +441,11 @@ void TaskLib::RunMonitor(boost::thread::id main_thread_id) {
   if (coordinator_uri_.empty())
     coordinator_uri_ = FLAGS_coordinator_uri;
 
-  LOG(INFO) << "Connecting to coordinator at " << coordinator_uri_;
-  CHECK(ConnectToCoordinator(coordinator_uri_));
+  // Warm processes are connected already.
+  if (!chan_->Ready()) {
+    LOG(INFO) << "Connecting to coordinator at " << coordinator_uri_;
+    CHECK(ConnectToCoordinator(coordinator_uri_));
+  }
 
   m_adapter_->RegisterAsyncMessageReceiptCallback(
       boost::bind(&TaskLib::HandleIncomingMessage, this, _1, _2));
@@ -288,6 +457,18 @@ void TaskLib::RunMonitor(boost::thread::id main_thread_id) {
   //setUpStorageEngine();
   //VLOG(2) << "Finished setting up storage engine";
 
+  // Send heartbeats and state reports to the machine's aggregator if the
+  // executor told us where it listens; warm processes only get their
+  // environment once they receive a task.
+  const char* heartbeat_socket_env = getenv("FLAGS_task_heartbeat_socket");
+  if (heartbeat_socket_env) {
+    heartbeat_socket_path_ = heartbeat_socket_env;
+    heartbeat_fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (heartbeat_fd_ < 0)
+      PLOG(WARNING) << "Failed to create heartbeat socket";
+  }
+  heartbeat_interval_ = FLAGS_heartbeat_interval;
+
   task_running_ = true;
   VLOG(3) << "Setting up process statistics\n";
 
@@ -295,31 +476,32 @@ void TaskLib::RunMonitor(boost::thread::id main_thread_id) {
   bzero(&current_stats, sizeof(ProcFSMonitor::ProcessStatistics_t));
   VLOG(3) << "Finished setting up process statistics\n";
 
-  // This will check if the task thread has joined once every heartbeat
-  // interval, and go back to sleep if it has not.
-  // TODO(malte): think about whether we'd like some kind of explicit
-  // notification scheme in case the heartbeat interval is large.
-
+  // This will check if the task thread has joined once every base heartbeat
+  // interval, and go back to sleep if it has not. Only the heartbeats are
+  // spaced out for tasks with steady usage; stop requests and messages from
+  // the coordinator are still picked up at the base interval.
+  uint64_t next_heartbeat_time = 0;
   while (!stop_) {
     // TODO(malte): Check if we've exited with an error
     // if(error)
     //   task_error_ = true;
-    // Notify the coordinator that we're still running happily
-
-    VLOG(1) << "Task thread has not yet joined, sending heartbeat...";
-
-    if (use_procfs_) {
-      task_perf_monitor_.ProcessInformation(pid_, &current_stats);
+    uint64_t now = time_manager_.GetCurrentTimestamp();
+    if (now >= next_heartbeat_time) {
+      // Notify the coordinator that we're still running happily
+      VLOG(1) << "Task thread has not yet joined, sending heartbeat...";
+      if (use_procfs_) {
+        task_perf_monitor_.ProcessInformation(pid_, &current_stats);
+      }
+      SendHeartbeat(current_stats);
+      next_heartbeat_time = now + NextHeartbeatInterval(current_stats, now);
     }
-    SendHeartbeat(current_stats);
 
-    // TODO(malte): We'll need to receive any potential messages from the
-    // coordinator here, too. This is probably best done by a simple RecvA on
-    // the channel.
+    // Make sure there is a receive outstanding for messages from the
+    // coordinator.
     m_adapter_->AwaitNextMessage();
 
-    // Finally, nap for a bit until the next heartbeat is due
-    usleep(FLAGS_heartbeat_interval);
+    // Finally, nap for a bit until the next poll is due
+    usleep(min(FLAGS_heartbeat_interval, next_heartbeat_time - now));
   }
   LOG(INFO) << "STOPPING HEARTBEATS for " << pid_;
   fflush(stderr);
@@ -335,6 +517,10 @@ void TaskLib::SendFinalizeMessage(bool success) {
     SUBMSG_WRITE(bm, task_state, new_state, TaskDescriptor::ABORTED);
   LOG(INFO) << "Sending finalize message (task state change to "
             << (success ? "COMPLETED" : "ABORTED") << ")!";
+  // The aggregator has the report as soon as the datagram is sent, so there
+  // is no need to wait for it to go out.
+  if (heartbeat_fd_ >= 0 && SendMessageToAggregator(bm))
+    return;
   //SendMessageToCoordinator(&bm);
   Envelope<BaseMessage> envelope(&bm);
   CHECK(chan_->SendS(envelope));
@@ -357,9 +543,78 @@ void TaskLib::SendHeartbeat(
   SUBMSG_WRITE(bm, task_heartbeat, sequence_number, heartbeat_seq_number_++);
 
   //LOG(INFO) << "Sending heartbeat message!";
+  if (heartbeat_fd_ >= 0 && SendMessageToAggregator(bm))
+    return;
   SendMessageToCoordinator(&bm);
 }
 
+bool TaskLib::SendMessageToAggregator(const BaseMessage& msg) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (heartbeat_socket_path_.size() >= sizeof(addr.sun_path))
+    return false;
+  strncpy(addr.sun_path, heartbeat_socket_path_.c_str(),
+          sizeof(addr.sun_path) - 1);
+  string data = msg.SerializeAsString();
+  // If the aggregator is gone or falls behind, the message goes over the
+  // coordinator connection instead.
+  if (sendto(heartbeat_fd_, data.data(), data.size(), MSG_DONTWAIT,
+             reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) !=
+      static_cast<ssize_t>(data.size())) {
+    VLOG(1) << "Failed to send message to aggregator at "
+            << heartbeat_socket_path_ << ": " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+uint64_t TaskLib::NextHeartbeatInterval(
+    const ProcFSMonitor::ProcessStatistics_t& stats, uint64_t sample_time) {
+  uint64_t cpu_ticks = stats.utime + stats.stime;
+  // CPU ticks per second since the previous sample; the time between
+  // samples can exceed heartbeat_interval_ when the monitor is delayed.
+  uint64_t elapsed = sample_time - last_sample_time_;
+  bool have_rate = last_sample_time_ > 0 && sample_time > last_sample_time_ &&
+    cpu_ticks >= last_cpu_ticks_;
+  double cpu_rate = have_rate ?
+    static_cast<double>(cpu_ticks - last_cpu_ticks_) * SECONDS_TO_MICROSECONDS /
+    elapsed : 0.0;
+  bool steady = heartbeat_seq_number_ > kNumStartupHeartbeats && have_rate &&
+    RelativeChange(last_rss_, stats.rss) <= FLAGS_heartbeat_steady_threshold &&
+    RelativeChange(last_cpu_rate_, cpu_rate) <=
+      FLAGS_heartbeat_steady_threshold;
+  last_rss_ = stats.rss;
+  last_cpu_ticks_ = cpu_ticks;
+  last_cpu_rate_ = cpu_rate;
+  last_sample_time_ = sample_time;
+  if (steady) {
+    heartbeat_interval_ = max(FLAGS_heartbeat_interval,
+                              min(2 * heartbeat_interval_,
+                                  FLAGS_max_heartbeat_interval));
+  } else {
+    heartbeat_interval_ = FLAGS_heartbeat_interval;
+  }
+  return heartbeat_interval_;
+}
+
+void TaskLib::SetTaskID(TaskID_t task_id) {
+  task_id_ = task_id;
+  stringstream ss;
+  ss << "/tmp/" << task_id_ << ".pid";
+  string pid_filename = ss.str();
+
+  FILE* pid_file;
+  pid_file = fopen(pid_filename.c_str(), "w");
+  if (!pid_file) {
+    PLOG(ERROR) << "Failed to create PID file (" << pid_filename << ")";
+  } else {
+    int pid = getpid();
+    fprintf(pid_file, "%d", pid);
+    CHECK_EQ(fclose(pid_file), 0);
+  }
+}
+
 bool TaskLib::SendMessageToCoordinator(BaseMessage* msg) {
   Envelope<BaseMessage> envelope(msg);
   return chan_->SendS(envelope);
@@ -37,6 +37,7 @@
 #include "base/task_interface.h"
 #include "base/task_stats.pb.h"
 #include "messages/base_message.pb.h"
+#include "messages/task_heartbeat_message.pb.h"
 #include "misc/messaging_interface.h"
 #include "misc/protobuf_envelope.h"
 #include "misc/wall_time.h"
@@ -45,6 +46,7 @@
 #include "platforms/unix/stream_sockets_adapter.h"
 #include "platforms/unix/stream_sockets_channel.h"
 #include "storage/reference_types.h"
+#include "storage/shm_object_store.h"
 #include "storage/types.h"
 
 namespace firmament {
@@ -60,6 +62,16 @@ class TaskLib {
 
   void RunMonitor(boost::thread::id main_thread_id);
   void AwaitNextMessage();
+  /**
+   * Used by warm (zygote) processes: connects to the coordinator, then
+   * blocks until the local executor hands this process a task through the
+   * zygote socket. On return, the task's environment, task ID and output
+   * redirection are in place.
+   * @param socket_path the path of the executor's zygote socket
+   * @param args set to the task's arguments, excluding the binary name
+   * @return false if no task could be received
+   */
+  bool AwaitZygoteTask(const string& socket_path, vector<string>* args);
   bool ConnectToCoordinator(const string& coordinator_uri);
   // CIEL programming model
   //virtual const string Construct(const DataObject& object);
@@ -69,9 +81,30 @@ class TaskLib {
   void Publish(const vector<ConcreteReference>& references);
   //virtual void TailSpawn(const ConcreteReference& code);
 
+  /**
+   * Maps an object from the machine's shared memory object store into this
+   * task without copying it. The mapping is read-only and stays valid until
+   * the matching GetObjectEnd(). Waits for inputs that are still being
+   * fetched from other machines.
+   * @param id the object's name
+   * @return a pointer to the object's data, or NULL if the object is not
+   * available on this machine
+   */
   void* GetObjectStart(const DataObjectID_t& id);
   void GetObjectEnd(const DataObjectID_t& id);
+  /**
+   * Creates an object in the machine's shared memory object store.
+   * @param id the object's name
+   * @param size the initial capacity in bytes; see Extend()
+   * @return a pointer to the writable object data, or NULL on failure
+   */
   void* PutObjectStart(const DataObjectID_t& id, size_t size);
+  /**
+   * Seals an object created by PutObjectStart() and publishes a concrete
+   * reference to it to the coordinator.
+   * @param id the object's name
+   * @param size the final size of the object in bytes
+   */
   void PutObjectEnd(const DataObjectID_t& id, size_t size);
   void* Extend(const DataObjectID_t& id, size_t old_size, size_t new_size);
 
@@ -89,6 +122,7 @@ class TaskLib {
   ResourceID_t resource_id_;
   TaskID_t task_id_;
   TaskDescriptor task_descriptor_;
+  store::ShmObjectStore* object_store_;
 
   void AddTaskStatisticsToHeartbeat(
       const ProcFSMonitor::ProcessStatistics_t& proc_stats, TaskStats* stats);
@@ -102,13 +136,36 @@ class TaskLib {
                                           TaskDescriptor* desc);
   void SendFinalizeMessage(bool success);
   void SendHeartbeat(const ProcFSMonitor::ProcessStatistics_t& stats);
+  bool SendMessageToAggregator(const BaseMessage& msg);
   bool SendMessageToCoordinator(BaseMessage* msg);
   void setUpStorageEngine();
 
  private:
+  /**
+   * Works out how long to wait before the next heartbeat. New tasks and tasks
+   * whose resource usage changes report at the base heartbeat interval; the
+   * interval doubles, up to a maximum, while usage stays steady.
+   * @param stats the statistics sent with the latest heartbeat
+   * @param sample_time the time, in microseconds, at which stats were taken
+   * @return the interval in microseconds
+   */
+  uint64_t NextHeartbeatInterval(
+      const ProcFSMonitor::ProcessStatistics_t& stats, uint64_t sample_time);
+  void SetTaskID(TaskID_t task_id);
+
   pid_t pid_;
   volatile bool task_running_;
   uint64_t heartbeat_seq_number_;
+  // Datagram socket on which heartbeats and state reports go to the
+  // machine's heartbeat aggregator, or -1 if they are sent over chan_.
+  int heartbeat_fd_;
+  string heartbeat_socket_path_;
+  // Current heartbeat interval, and the usage seen at the last heartbeat.
+  uint64_t heartbeat_interval_;
+  uint64_t last_rss_;
+  uint64_t last_cpu_ticks_;
+  double last_cpu_rate_;
+  uint64_t last_sample_time_;
   bool use_procfs_;
   string hostname_;
   WallTime time_manager_;
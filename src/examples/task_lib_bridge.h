@@ -10,8 +10,10 @@
 #include "base/common.h"
 #include "base/types.h"
 
+#include <string>
 #include <vector>
 
+using std::string;
 using std::vector;
 
 // Local task lib instance
@@ -40,11 +42,46 @@ void LaunchTasklib(int argc, char** argv) {
   task_lib_->RunMonitor(task_thread_id);
 }
 
+// Runs the TaskLib monitor of a warm process, which is initialized already.
+void RunWarmTasklib(boost::thread::id task_thread_id) {
+  task_lib_->RunMonitor(task_thread_id);
+}
+
+// Runs as a warm (zygote) process of the local executor: initializes TaskLib
+// up front, then waits to be handed a task and runs it.
+int RunAsZygote(int argc, char** argv, const string& socket_path) {
+  setenv("GLOG_logtostderr", "1", 1);
+  firmament::common::InitFirmament(argc, argv);
+  task_lib_ = new firmament::TaskLib();
+  // Tasks started by this one should not become warm processes.
+  unsetenv("FIRMAMENT_ZYGOTE_SOCKET");
+  vector<string> task_args;
+  if (!task_lib_->AwaitZygoteTask(socket_path, &task_args)) {
+    LOG(ERROR) << "Warm process did not receive a task";
+    delete task_lib_;
+    task_lib_ = NULL;
+    return 1;
+  }
+  atexit(TerminationCleanup);
+  boost::thread t1(&RunWarmTasklib, boost::this_thread::get_id());
+  vector<char*> args;
+  for (uint64_t i = 0; i < task_args.size(); ++i) {
+    args.push_back(const_cast<char*>(task_args[i].c_str()));
+  }
+  firmament::task_main(0, &args);
+  return 0;
+}
+
 int main(int argc, char** argv) {
   // Unset LD_PRELOAD to avoid us from starting launching monitors in
   // child processes, unless we're in a wrapper
   setenv("LD_PRELOAD", "", 1);
 
+  const char* zygote_socket = getenv("FIRMAMENT_ZYGOTE_SOCKET");
+  if (zygote_socket) {
+    return RunAsZygote(argc, argv, string(zygote_socket));
+  }
+
   // Cleanup task lib before terminating the process.
   atexit(TerminationCleanup);
 
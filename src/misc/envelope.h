@@ -23,7 +23,11 @@
 #ifndef FIRMAMENT_MISC_ENVELOPE_H
 #define FIRMAMENT_MISC_ENVELOPE_H
 
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#include <google/protobuf/io/zero_copy_stream.h>
 
 #include "base/common.h"
 #include "misc/printable_interface.h"
@@ -68,6 +72,24 @@ class Envelope : public PrintableInterface {
     memcpy(static_cast<void*>(data_), buffer, length);
     return true;
   }
+  // Parses a message of the given length from a stream of buffers. The basic
+  // envelope gathers the data into a contiguous buffer and parses that.
+  // Returns boolean indication if parse/copy succeeded.
+  virtual bool ParseFromStream(
+      google::protobuf::io::ZeroCopyInputStream* stream, size_t length) {
+    vector<char> buffer(length);
+    size_t copied = 0;
+    const void* data;
+    int size;
+    while (copied < length && stream->Next(&data, &size)) {
+      size_t chunk = min(static_cast<size_t>(size), length - copied);
+      memcpy(&buffer[copied], data, chunk);
+      copied += chunk;
+    }
+    if (copied < length)
+      return false;
+    return Parse(&buffer[0], length);
+  }
   // Serializes the data contained in this envelope into a given buffer.
   // Since this is the most basic envelope implementation, we simply copy the
   // binary data over from the internal buffer to the buffer given as an
@@ -22,8 +22,11 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
 #include <vector>
 
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
 #include "base/common.h"
 #include "messages/base_message.pb.h"
 #include "messages/test_message.pb.h"
@@ -119,6 +122,26 @@ TEST_F(EnvelopeTest, EmptyParseBlankProtobuf) {
            testMsg.test().test());
 }
 
+// Tests parsing a protobuf from a stream, including one larger than
+// protobuf's default total bytes limit of 64MB.
+TEST_F(EnvelopeTest, ParseProtobufFromStream) {
+  BaseMessage testMsg;
+  testMsg.mutable_registration()->set_location(string(65 << 20, 'x'));
+  string buf;
+  CHECK(testMsg.SerializeToString(&buf));
+  google::protobuf::io::ArrayInputStream stream(buf.data(),
+                                                static_cast<int>(buf.size()),
+                                                1 << 20);
+  Envelope<BaseMessage> envelope;
+  EXPECT_TRUE(envelope.ParseFromStream(&stream, buf.size()));
+  EXPECT_EQ(envelope.data_->registration().location().size(), 65 << 20);
+  // A stream that ends before the given length does not parse.
+  google::protobuf::io::ArrayInputStream short_stream(
+      buf.data(), static_cast<int>(buf.size()) - 1);
+  Envelope<BaseMessage> short_envelope;
+  EXPECT_FALSE(short_envelope.ParseFromStream(&short_stream, buf.size()));
+}
+
 // Tests allocation of a wrapping envelope around a protobuf. Internal pointer
 // of the envelope should point to said protobuf, not a copy thereof.
 TEST_F(EnvelopeTest, StashProtobuf) {
@@ -21,6 +21,10 @@
 // Utility functions for working with protobufs.
 
 #include <queue>
+#include <vector>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/util/message_differencer.h>
 
 #include "misc/pb_utils.h"
 
@@ -204,4 +208,56 @@ void BFSTraverseResourceProtobufTreeToHash(
   }
 }
 
+void DiffProtobuf(const google::protobuf::Message& base,
+                  const google::protobuf::Message& cur,
+                  google::protobuf::Message* delta,
+                  google::protobuf::RepeatedField<uint32_t>* cleared_fields) {
+  using google::protobuf::FieldDescriptor;
+  using google::protobuf::util::MessageDifferencer;
+  const google::protobuf::Descriptor* descriptor = cur.GetDescriptor();
+  const google::protobuf::Reflection* reflection = cur.GetReflection();
+  CHECK_EQ(base.GetDescriptor(), descriptor);
+  delta->CopyFrom(cur);
+  MessageDifferencer differencer;
+  for (int32_t i = 0; i < descriptor->field_count(); ++i) {
+    vector<const FieldDescriptor*> field(1, descriptor->field(i));
+    if (differencer.CompareWithFields(base, cur, field, field)) {
+      reflection->ClearField(delta, field[0]);
+    } else if (field[0]->is_repeated() ?
+               reflection->FieldSize(cur, field[0]) == 0 :
+               !reflection->HasField(cur, field[0])) {
+      cleared_fields->Add(field[0]->number());
+    }
+  }
+}
+
+void ApplyProtobufDelta(
+    const google::protobuf::Message& delta,
+    const google::protobuf::RepeatedField<uint32_t>& cleared_fields,
+    google::protobuf::Message* base) {
+  const google::protobuf::Descriptor* descriptor = base->GetDescriptor();
+  const google::protobuf::Reflection* reflection = base->GetReflection();
+  CHECK_EQ(delta.GetDescriptor(), descriptor);
+  // MergeFrom merges message fields and appends to repeated fields, so clear
+  // the fields being replaced first.
+  vector<const google::protobuf::FieldDescriptor*> fields;
+  reflection->ListFields(delta, &fields);
+  for (vector<const google::protobuf::FieldDescriptor*>::const_iterator it =
+         fields.begin();
+       it != fields.end();
+       ++it) {
+    reflection->ClearField(base, *it);
+  }
+  base->MergeFrom(delta);
+  for (google::protobuf::RepeatedField<uint32_t>::const_iterator it =
+         cleared_fields.begin();
+       it != cleared_fields.end();
+       ++it) {
+    const google::protobuf::FieldDescriptor* field =
+      descriptor->FindFieldByNumber(*it);
+    if (field)
+      reflection->ClearField(base, field);
+  }
+}
+
 }  // namespace firmament
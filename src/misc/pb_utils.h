@@ -25,6 +25,9 @@
 
 #include <string>
 
+#include <google/protobuf/message.h>
+#include <google/protobuf/repeated_field.h>
+
 #include "base/common.h"
 #include "base/types.h"
 #include "base/resource_topology_node_desc.pb.h"
@@ -77,6 +80,33 @@ void BFSTraverseResourceProtobufTreeToHash(
     ResourceTopologyNodeDescriptor* pb, size_t* hash,
     boost::function<void(ResourceTopologyNodeDescriptor*, size_t*)> callback);  // NOLINT
 
+/**
+ * Computes the top-level fields of a protobuf that differ from a base version
+ * of it.
+ * @param base the base version
+ * @param cur the current version
+ * @param delta set to a copy of cur in which all fields that are equal in base
+ * and cur are cleared
+ * @param cleared_fields the numbers of fields that are set in base, but not in
+ * cur, are appended here
+ */
+void DiffProtobuf(const google::protobuf::Message& base,
+                  const google::protobuf::Message& cur,
+                  google::protobuf::Message* delta,
+                  google::protobuf::RepeatedField<uint32_t>* cleared_fields);
+
+/**
+ * Applies a delta computed by DiffProtobuf. Fields set in the delta replace
+ * the corresponding fields of the base, including repeated and message fields.
+ * @param delta the delta
+ * @param cleared_fields the numbers of fields to clear in the base
+ * @param base the protobuf to apply the delta to
+ */
+void ApplyProtobufDelta(
+    const google::protobuf::Message& delta,
+    const google::protobuf::RepeatedField<uint32_t>& cleared_fields,
+    google::protobuf::Message* base);
+
 template <typename T>
 bool RepeatedContainsPtr(RepeatedPtrField<T>* pbf, T* item) {
   // N.B.: using GNU-style RTTI
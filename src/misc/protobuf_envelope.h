@@ -23,8 +23,12 @@
 #ifndef FIRMAMENT_MISC_PROTOBUF_ENVELOPE_H
 #define FIRMAMENT_MISC_PROTOBUF_ENVELOPE_H
 
+#include <limits.h>
+
 #include <vector>
 
+#include <google/protobuf/io/coded_stream.h>
+
 #include "messages/base_message.pb.h"
 #include "misc/envelope.h"
 
@@ -62,6 +66,29 @@ class Envelope<BaseMessage> : public PrintableInterface {
     }
     return data_->ParseFromArray(buffer, length);
   }
+  virtual bool ParseFromStream(
+      google::protobuf::io::ZeroCopyInputStream* stream, size_t length) {
+    if (!data_) {
+      data_ = new BaseMessage();
+      is_owner_ = true;
+    }
+    // CodedInputStream counts bytes in an int.
+    if (length > static_cast<size_t>(INT_MAX)) {
+      LOG(ERROR) << "Cannot parse message of " << length << " bytes";
+      return false;
+    }
+    // Parses directly out of the stream's buffers, without copying them. The
+    // default total bytes limit (64MB) would reject larger messages, which
+    // --stream_sockets_max_message_size may permit, so the message length is
+    // the limit instead.
+    int limit = static_cast<int>(length);
+    google::protobuf::io::CodedInputStream coded_stream(stream);
+    coded_stream.SetTotalBytesLimit(limit, -1);
+    coded_stream.PushLimit(limit);
+    return data_->ParseFromCodedStream(&coded_stream) &&
+           coded_stream.ConsumedEntireMessage() &&
+           coded_stream.BytesUntilLimit() == 0;
+  }
   virtual bool Serialize(void *buffer, int32_t length) const {
     CHECK(data_ != NULL) << "Tried to serialize a protobuf message envelope "
                          << "with NULL contents.";
@@ -76,6 +103,7 @@ class Envelope<BaseMessage> : public PrintableInterface {
   // unit tests
   FRIEND_TEST(EnvelopeTest, EmptyParseProtobuf);
   FRIEND_TEST(EnvelopeTest, EmptyParseBlankProtobuf);
+  FRIEND_TEST(EnvelopeTest, ParseProtobufFromStream);
   FRIEND_TEST(EnvelopeTest, StashProtobuf);
   // fields
   BaseMessage* data_;
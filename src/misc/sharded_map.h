@@ -0,0 +1,290 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// A hash-sharded map with per-shard reader-writer locks, used for the task,
+// job and resource tables that are shared between the coordinator, the
+// scheduler and the service threads.
+
+#ifndef FIRMAMENT_MISC_SHARDED_MAP_H
+#define FIRMAMENT_MISC_SHARDED_MAP_H
+
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <type_traits>
+#include <utility>
+
+namespace firmament {
+
+// Keys are spread over kNumShards shards by hash, and each shard is an
+// ordered map guarded by its own shared_mutex. Lookups only take the shard's
+// lock in shared mode, so readers never block each other and writers only
+// block operations on the same shard.
+//
+// The interface follows std::map closely enough for the map-util helpers and
+// existing iteration code to work unchanged. As with thread_safe::map, every
+// individual operation is atomic, but iterators and the pointers or
+// references they yield are not protected once the operation returns. Since
+// each shard is node-based, iterators stay valid across insertions and
+// across erasure of other elements. Iteration order is by shard, and ordered
+// by key only within a shard.
+template <typename K, typename V, typename Hash = boost::hash<K>,
+          uint32_t kNumShards = 64>
+class ShardedMap {
+ private:
+  typedef std::map<K, V> ShardMap;
+
+  struct Shard {
+    mutable boost::shared_mutex lock_;
+    ShardMap map_;
+  };
+
+  typedef boost::shared_lock<boost::shared_mutex> ReadLock;
+  typedef boost::unique_lock<boost::shared_mutex> WriteLock;
+
+ public:
+  typedef K key_type;
+  typedef V mapped_type;
+  typedef typename ShardMap::value_type value_type;
+  typedef size_t size_type;
+
+  template <bool kIsConst>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename ShardedMap::value_type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef typename std::conditional<kIsConst, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<kIsConst, const value_type&,
+                                      value_type&>::type reference;
+    typedef typename std::conditional<kIsConst,
+                                      typename ShardMap::const_iterator,
+                                      typename ShardMap::iterator>::type
+        ShardIterator;
+    typedef typename std::conditional<kIsConst, const Shard*, Shard*>::type
+        ShardPtr;
+
+    Iterator() : shards_(NULL), shard_(kNumShards) {}
+    Iterator(ShardPtr shards, uint32_t shard, ShardIterator it)
+      : shards_(shards), shard_(shard), it_(it) {}
+    // Allows iterator to const_iterator conversion.
+    Iterator(const Iterator<false>& other)  // NOLINT
+      : shards_(other.shards_), shard_(other.shard_), it_(other.it_) {}
+    // For iterator, the constructor above is the copy constructor, which
+    // would otherwise make the implicit copy assignment deprecated.
+    Iterator& operator=(const Iterator& other) = default;
+
+    reference operator*() const { return *it_; }
+    pointer operator->() const { return &(*it_); }
+    Iterator& operator++() {
+      {
+        ReadLock lock(shards_[shard_].lock_);
+        ++it_;
+      }
+      SkipEmptyShards();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++(*this);
+      return old;
+    }
+    friend bool operator==(const Iterator& a, const Iterator& b) {
+      return a.shard_ == b.shard_ && (a.shard_ == kNumShards || a.it_ == b.it_);
+    }
+    friend bool operator!=(const Iterator& a, const Iterator& b) {
+      return !(a == b);
+    }
+
+   private:
+    friend class ShardedMap;
+    friend class Iterator<true>;
+
+    // Moves on to the first element of the next non-empty shard when the
+    // iterator has reached the end of its current shard. Must be called
+    // without holding any shard lock.
+    void SkipEmptyShards() {
+      while (shard_ < kNumShards) {
+        const Shard& shard = shards_[shard_];
+        {
+          ReadLock lock(shard.lock_);
+          if (it_ != shard.map_.end())
+            return;
+        }
+        if (++shard_ < kNumShards) {
+          ReadLock lock(shards_[shard_].lock_);
+          it_ = shards_[shard_].map_.begin();
+        }
+      }
+    }
+
+    ShardPtr shards_;
+    uint32_t shard_;
+    ShardIterator it_;
+  };
+
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  ShardedMap() : size_(0) {
+    static_assert((kNumShards & (kNumShards - 1)) == 0,
+                  "the number of shards must be a power of two");
+  }
+
+  iterator begin() {
+    iterator it;
+    {
+      ReadLock lock(shards_[0].lock_);
+      it = iterator(shards_, 0, shards_[0].map_.begin());
+    }
+    it.SkipEmptyShards();
+    return it;
+  }
+  const_iterator begin() const {
+    const_iterator it;
+    {
+      ReadLock lock(shards_[0].lock_);
+      it = const_iterator(shards_, 0, shards_[0].map_.begin());
+    }
+    it.SkipEmptyShards();
+    return it;
+  }
+  iterator end() {
+    return iterator();
+  }
+  const_iterator end() const {
+    return const_iterator();
+  }
+
+  void clear() {
+    for (uint32_t i = 0; i < kNumShards; ++i) {
+      WriteLock lock(shards_[i].lock_);
+      size_ -= shards_[i].map_.size();
+      shards_[i].map_.clear();
+    }
+  }
+  size_type count(const K& key) const {
+    const Shard& shard = ShardFor(key);
+    ReadLock lock(shard.lock_);
+    return shard.map_.count(key);
+  }
+  bool empty() const {
+    return size() == 0;
+  }
+  size_type erase(const K& key) {
+    Shard& shard = ShardFor(key);
+    WriteLock lock(shard.lock_);
+    size_type num_erased = shard.map_.erase(key);
+    size_ -= num_erased;
+    return num_erased;
+  }
+  void erase(const_iterator it) {
+    Shard& shard = shards_[it.shard_];
+    WriteLock lock(shard.lock_);
+    shard.map_.erase(it.it_);
+    --size_;
+  }
+  iterator find(const K& key) {
+    uint32_t index = ShardIndex(key);
+    Shard& shard = shards_[index];
+    ReadLock lock(shard.lock_);
+    typename ShardMap::iterator it = shard.map_.find(key);
+    if (it == shard.map_.end())
+      return end();
+    return iterator(shards_, index, it);
+  }
+  const_iterator find(const K& key) const {
+    uint32_t index = ShardIndex(key);
+    const Shard& shard = shards_[index];
+    ReadLock lock(shard.lock_);
+    typename ShardMap::const_iterator it = shard.map_.find(key);
+    if (it == shard.map_.end())
+      return end();
+    return const_iterator(shards_, index, it);
+  }
+  std::pair<iterator, bool> insert(const value_type& value) {
+    uint32_t index = ShardIndex(value.first);
+    Shard& shard = shards_[index];
+    WriteLock lock(shard.lock_);
+    std::pair<typename ShardMap::iterator, bool> result =
+      shard.map_.insert(value);
+    if (result.second)
+      ++size_;
+    return std::make_pair(iterator(shards_, index, result.first),
+                          result.second);
+  }
+  /**
+   * Copies the value mapped to a key while holding the shard's lock, so that
+   * the result remains valid even if the entry is concurrently erased.
+   * @param key the key to look up
+   * @param value set to the mapped value if the key is present
+   * @return true if the key is present
+   */
+  bool Lookup(const K& key, V* value) const {
+    const Shard& shard = ShardFor(key);
+    ReadLock lock(shard.lock_);
+    typename ShardMap::const_iterator it = shard.map_.find(key);
+    if (it == shard.map_.end())
+      return false;
+    *value = it->second;
+    return true;
+  }
+  V& operator[](const K& key) {
+    Shard& shard = ShardFor(key);
+    WriteLock lock(shard.lock_);
+    std::pair<typename ShardMap::iterator, bool> result =
+      shard.map_.insert(value_type(key, V()));
+    if (result.second)
+      ++size_;
+    return result.first->second;
+  }
+  size_type size() const {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Hashes of integral keys are often the keys themselves, so the hash is
+  // mixed before picking a shard to avoid clustering sequential IDs.
+  static uint32_t ShardIndex(const K& key) {
+    uint64_t hash = static_cast<uint64_t>(Hash()(key));
+    hash *= 0x9E3779B97F4A7C15ULL;
+    return static_cast<uint32_t>(hash >> 32) & (kNumShards - 1);
+  }
+  Shard& ShardFor(const K& key) {
+    return shards_[ShardIndex(key)];
+  }
+  const Shard& ShardFor(const K& key) const {
+    return shards_[ShardIndex(key)];
+  }
+
+  Shard shards_[kNumShards];
+  std::atomic<size_type> size_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_SHARDED_MAP_H
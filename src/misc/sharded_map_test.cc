@@ -0,0 +1,138 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Sharded map unit tests.
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <set>
+#include <vector>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "misc/map-util.h"
+#include "misc/sharded_map.h"
+#include "misc/utils.h"
+
+namespace firmament {
+
+typedef ShardedMap<uint64_t, uint64_t> TestMap_t;
+
+// The fixture for testing class ShardedMap.
+class ShardedMapTest : public ::testing::Test {
+ public:
+  // Inserts, looks up and erases the keys in [start, start + count).
+  void InsertLookupErase(TestMap_t* map, uint64_t start, uint64_t count) {
+    for (uint64_t key = start; key < start + count; ++key) {
+      CHECK(InsertIfNotPresent(map, key, key * 2));
+    }
+    for (uint64_t key = start; key < start + count; ++key) {
+      uint64_t value = 0;
+      CHECK(map->Lookup(key, &value));
+      CHECK_EQ(value, key * 2);
+    }
+    for (uint64_t key = start; key < start + count; key += 2) {
+      CHECK_EQ(map->erase(key), 1);
+    }
+  }
+};
+
+// Tests that the map behaves like a map through the map-util helpers.
+TEST_F(ShardedMapTest, MapUtilOperations) {
+  TestMap_t map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(InsertIfNotPresent(&map, 1, 10));
+  EXPECT_FALSE(InsertIfNotPresent(&map, 1, 11));
+  EXPECT_TRUE(InsertOrUpdate(&map, 2, 20));
+  EXPECT_FALSE(InsertOrUpdate(&map, 2, 21));
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(*FindOrNull(map, 1), 10);
+  EXPECT_EQ(FindWithDefault(map, 2, 0), 21);
+  EXPECT_EQ(FindOrNull(map, 3), static_cast<uint64_t*>(NULL));
+  map[3] = 30;
+  EXPECT_EQ(map.count(3), 1);
+  EXPECT_EQ(map.erase(1), 1);
+  EXPECT_EQ(map.erase(1), 0);
+  map.erase(map.find(2));
+  EXPECT_EQ(map.size(), 1);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+}
+
+// Tests that iteration visits every entry exactly once.
+TEST_F(ShardedMapTest, IteratesAllEntries) {
+  TestMap_t map;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    map[key] = key;
+  }
+  std::set<uint64_t> seen;
+  for (TestMap_t::const_iterator it = map.begin(); it != map.end(); ++it) {
+    EXPECT_EQ(it->first, it->second);
+    EXPECT_TRUE(seen.insert(it->first).second);
+  }
+  EXPECT_EQ(seen.size(), 1000);
+}
+
+// Tests that the task, job and resource tables work with their key types.
+TEST_F(ShardedMapTest, TableTypes) {
+  JobMap_t job_map;
+  JobID_t job_id = GenerateJobID();
+  JobDescriptor jd;
+  jd.set_uuid(to_string(job_id));
+  CHECK(InsertIfNotPresent(&job_map, job_id, jd));
+  JobDescriptor* jd_ptr = FindOrNull(job_map, job_id);
+  ASSERT_TRUE(jd_ptr != NULL);
+  EXPECT_EQ(jd_ptr->uuid(), to_string(job_id));
+  TaskMap_t task_map;
+  TaskDescriptor td;
+  CHECK(InsertIfNotPresent(&task_map, 42ULL, &td));
+  EXPECT_EQ(FindPtrOrNull(task_map, 42ULL), &td);
+}
+
+// Tests concurrent writers and readers on disjoint key ranges.
+TEST_F(ShardedMapTest, ConcurrentAccess) {
+  TestMap_t map;
+  const uint64_t kKeysPerThread = 10000;
+  boost::thread_group threads;
+  for (uint64_t i = 0; i < 8; ++i) {
+    threads.create_thread(boost::bind(&ShardedMapTest::InsertLookupErase,
+                                      this, &map, i * kKeysPerThread,
+                                      kKeysPerThread));
+  }
+  threads.join_all();
+  EXPECT_EQ(map.size(), 8 * kKeysPerThread / 2);
+  uint64_t num_entries = 0;
+  for (TestMap_t::iterator it = map.begin(); it != map.end(); ++it) {
+    EXPECT_EQ(it->first % 2, 1);
+    ++num_entries;
+  }
+  EXPECT_EQ(num_entries, map.size());
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
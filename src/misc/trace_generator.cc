@@ -37,13 +37,21 @@ DEFINE_string(generated_trace_path, "",
               "Path to where the trace will be generated");
 DEFINE_bool(generate_quincy_cost_model_trace, false,
             "A trace containing information specific to the Quincy cost model");
+DEFINE_bool(generated_trace_async_writer, true,
+            "True if the trace files should be written by a background thread");
+DEFINE_bool(generated_trace_compression, false,
+            "True if the trace files should be gzip compressed");
+DEFINE_uint64(generated_trace_queue_size, 65536,
+              "Maximum number of trace lines waiting to be written by the "
+              "background writer thread");
 
 namespace firmament {
 
 TraceGenerator::TraceGenerator(TimeInterface* time_manager)
   : time_manager_(time_manager), unscheduled_tasks_cnt_(0),
     running_tasks_cnt_(0), evicted_tasks_cnt_(0), migrated_tasks_cnt_(0),
-    task_events_cnt_per_round_(0), machine_events_cnt_per_round_(0) {
+    task_events_cnt_per_round_(0), machine_events_cnt_per_round_(0),
+    trace_writer_(NULL) {
   if (FLAGS_generate_trace) {
     MkdirIfNotPresent(FLAGS_generated_trace_path);
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/machine_events");
@@ -55,67 +63,56 @@ TraceGenerator::TraceGenerator(TimeInterface* time_manager)
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/dfs_events");
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/tasks_to_blocks");
     MkdirIfNotPresent(FLAGS_generated_trace_path + "/machines_to_racks");
-    string path =
-      FLAGS_generated_trace_path + "/machine_events/part-00000-of-00001.csv";
-    machine_events_ = fopen(path.c_str(), "w");
-    CHECK(machine_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path +
-      "/scheduler_events/scheduler_events.csv";
-    scheduler_events_ = fopen(path.c_str(), "w");
-    CHECK(scheduler_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/task_events/part-00000-of-00500.csv";
-    task_events_ = fopen(path.c_str(), "w");
-    CHECK(task_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path +
-      "/task_runtime_events/task_runtime_events.csv";
-    task_runtime_events_ = fopen(path.c_str(), "w");
-    CHECK(task_runtime_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/jobs_num_tasks/jobs_num_tasks.csv";
-    jobs_num_tasks_ = fopen(path.c_str(), "w");
-    CHECK(jobs_num_tasks_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/task_usage_stat/task_usage_stat.csv";
-    task_usage_stat_ = fopen(path.c_str(), "w");
-    CHECK(task_usage_stat_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/dfs_events/dfs_events.csv";
-    dfs_events_ = fopen(path.c_str(), "w");
-    CHECK(dfs_events_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/tasks_to_blocks/tasks_to_blocks.csv";
-    tasks_to_blocks_ = fopen(path.c_str(), "w");
-    CHECK(tasks_to_blocks_ != NULL) << "Failed to open: " << path;
-    path = FLAGS_generated_trace_path + "/machines_to_racks/machines_to_racks.csv";
-    machines_to_racks_ = fopen(path.c_str(), "w");
-    CHECK(machines_to_racks_ != NULL) << "Failed to open: " << path;
+    trace_writer_ = new TraceWriter(FLAGS_generated_trace_async_writer,
+                                    FLAGS_generated_trace_compression,
+                                    FLAGS_generated_trace_queue_size);
+    machine_events_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/machine_events/part-00000-of-00001.csv");
+    scheduler_events_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/scheduler_events/scheduler_events.csv");
+    task_events_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/task_events/part-00000-of-00500.csv");
+    task_runtime_events_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path +
+        "/task_runtime_events/task_runtime_events.csv");
+    jobs_num_tasks_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/jobs_num_tasks/jobs_num_tasks.csv");
+    task_usage_stat_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/task_usage_stat/task_usage_stat.csv");
+    dfs_events_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/dfs_events/dfs_events.csv");
+    tasks_to_blocks_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path + "/tasks_to_blocks/tasks_to_blocks.csv");
+    machines_to_racks_ = trace_writer_->OpenStream(
+        FLAGS_generated_trace_path +
+        "/machines_to_racks/machines_to_racks.csv");
     if (FLAGS_generate_quincy_cost_model_trace) {
       MkdirIfNotPresent(FLAGS_generated_trace_path + "/quincy_tasks");
-      path = FLAGS_generated_trace_path + "/quincy_tasks/quincy_tasks.csv";
-      quincy_tasks_ = fopen(path.c_str(), "w");
-      CHECK(quincy_tasks_ != NULL) << "Failed to open: " << path;
+      quincy_tasks_ = trace_writer_->OpenStream(
+          FLAGS_generated_trace_path + "/quincy_tasks/quincy_tasks.csv");
     }
   }
 }
 
 TraceGenerator::~TraceGenerator() {
   if (FLAGS_generate_trace) {
-    fclose(machine_events_);
-    fclose(scheduler_events_);
-    fclose(task_events_);
     // Print runtime for service tasks or tasks that haven't completed.
     for (auto& task_id_runtime : task_to_runtime_) {
       uint64_t* job_id_ptr = FindOrNull(task_to_job_, task_id_runtime.first);
       TaskRuntime task_runtime = task_id_runtime.second;
       // NOTE: We are using the job id as the job logical name.
-      fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-              *job_id_ptr, task_runtime.task_id_, *job_id_ptr,
-              task_runtime.start_time_, task_runtime.total_runtime_,
-              task_runtime.runtime_, task_runtime.num_runs_);
+      trace_writer_->Write(task_runtime_events_,
+                           "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n", *job_id_ptr,
+                           task_runtime.task_id_, *job_id_ptr,
+                           task_runtime.start_time_,
+                           task_runtime.total_runtime_, task_runtime.runtime_,
+                           task_runtime.num_runs_);
     }
-    fclose(task_runtime_events_);
     // Print number of tasks for service jobs or jobs that haven't completed.
     for (auto& job_to_num_tasks : job_num_tasks_) {
-      fprintf(jobs_num_tasks_, "%ju,%ju\n", job_to_num_tasks.first,
-              job_to_num_tasks.second);
+      trace_writer_->Write(jobs_num_tasks_, "%ju,%ju\n", job_to_num_tasks.first,
+                           job_to_num_tasks.second);
     }
-    fclose(jobs_num_tasks_);
     // TODO(ionel): Collect task usage stats.
     // for (auto& task_to_job : task_to_job_) {
     //   uint64_t* job_id_ptr = FindOrNull(task_to_job_, task_to_job.first);
@@ -123,13 +120,9 @@ TraceGenerator::~TraceGenerator() {
     //           "0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0\n", *job_id_ptr,
     //           task_to_job.first);
     // }
-    fclose(task_usage_stat_);
-    fclose(dfs_events_);
-    fclose(tasks_to_blocks_);
-    fclose(machines_to_racks_);
-    if (FLAGS_generate_quincy_cost_model_trace) {
-      fclose(quincy_tasks_);
-    }
+    // Deleting the writer waits for all the lines to be written and closes
+    // the trace files.
+    delete trace_writer_;
   }
   // time_manager is not owned by this class. We don't have to delete it here.
 }
@@ -141,8 +134,8 @@ void TraceGenerator::AddBlock(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp, BLOCK_ADD,
-            *machine_id, block_id, block_size);
+    trace_writer_->Write(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp,
+                         BLOCK_ADD, *machine_id, block_id, block_size);
   }
 }
 
@@ -154,8 +147,8 @@ void TraceGenerator::AddMachine(const ResourceDescriptor& rd) {
     CHECK(InsertIfNotPresent(&machine_res_id_to_trace_id_,
                              ResourceIDFromString(rd.uuid()),
                              machine_id));
-    fprintf(machine_events_, "%ju,%ju,%d,,,\n",
-            timestamp, machine_id, MACHINE_ADD);
+    trace_writer_->Write(machine_events_, "%ju,%ju,%d,,,\n", timestamp,
+                         machine_id, MACHINE_ADD);
   }
 }
 
@@ -166,8 +159,8 @@ void TraceGenerator::AddMachineToRack(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(machines_to_racks_, "%ju,%d,%ju,%ju\n", timestamp, MACHINE_ADD,
-            *machine_id, rack_id);
+    trace_writer_->Write(machines_to_racks_, "%ju,%d,%ju,%ju\n", timestamp,
+                         MACHINE_ADD, *machine_id, rack_id);
   }
 }
 
@@ -183,8 +176,8 @@ void TraceGenerator::AddTaskInputBlock(const TaskDescriptor& td,
       trace_job_id = HashString(td.job_id());
       trace_task_id = td.uid();
     }
-    fprintf(tasks_to_blocks_, "%ju,%ju,%ju\n",
-            trace_job_id, trace_task_id, block_id);
+    trace_writer_->Write(tasks_to_blocks_, "%ju,%ju,%ju\n", trace_job_id,
+                         trace_task_id, block_id);
   }
 }
 
@@ -204,10 +197,29 @@ void TraceGenerator::AddTaskQuincy(
       trace_job_id = HashString(td.job_id());
       trace_task_id = td.uid();
     }
-    fprintf(quincy_tasks_, "%ju,%ju,%ju,%ju,%jd,%jd,%jd,%jd,%ju,%ju\n",
-            timestamp, trace_job_id, trace_task_id, input_size,
-            worst_cluster_cost, best_rack_cost, best_machine_cost,
-            cost_to_unsched, num_pref_machines, num_pref_racks);
+    trace_writer_->Write(quincy_tasks_,
+                         "%ju,%ju,%ju,%ju,%jd,%jd,%jd,%jd,%ju,%ju\n", timestamp,
+                         trace_job_id, trace_task_id, input_size,
+                         worst_cluster_cost, best_rack_cost, best_machine_cost,
+                         cost_to_unsched, num_pref_machines, num_pref_racks);
+  }
+}
+
+void TraceGenerator::JobCompleted(const JobDescriptor& jd) {
+  if (FLAGS_generate_trace) {
+    uint64_t job_id;
+    if (jd.root_task().trace_job_id() != 0) {
+      job_id = jd.root_task().trace_job_id();
+    } else {
+      job_id = HashString(jd.uuid());
+    }
+    // Output the number of tasks now so that we don't have to keep the
+    // job's state until the generator is deleted.
+    uint64_t* num_tasks = FindOrNull(job_num_tasks_, job_id);
+    if (num_tasks != NULL) {
+      trace_writer_->Write(jobs_num_tasks_, "%ju,%ju\n", job_id, *num_tasks);
+      job_num_tasks_.erase(job_id);
+    }
   }
 }
 
@@ -226,8 +238,8 @@ void TraceGenerator::RemoveBlock(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp, BLOCK_REMOVE,
-            *machine_id, block_id, block_size);
+    trace_writer_->Write(dfs_events_, "%ju,%d,%ju,%ju,%ju\n", timestamp,
+                         BLOCK_REMOVE, *machine_id, block_id, block_size);
   }
 }
 
@@ -237,8 +249,8 @@ void TraceGenerator::RemoveMachine(const ResourceDescriptor& rd) {
     uint64_t timestamp = time_manager_->GetCurrentTimestamp();
     uint64_t machine_id = GetMachineId(rd);
     machine_res_id_to_trace_id_.erase(ResourceIDFromString(rd.uuid()));
-    fprintf(machine_events_, "%ju,%ju,%d,,,\n",
-            timestamp, machine_id, MACHINE_REMOVE);
+    trace_writer_->Write(machine_events_, "%ju,%ju,%d,,,\n", timestamp,
+                         machine_id, MACHINE_REMOVE);
   }
 }
 
@@ -249,8 +261,8 @@ void TraceGenerator::RemoveMachineFromRack(ResourceID_t machine_res_id,
     uint64_t* machine_id =
       FindOrNull(machine_res_id_to_trace_id_, machine_res_id);
     CHECK_NOTNULL(machine_id);
-    fprintf(machines_to_racks_, "%ju,%d,%ju,%ju\n", timestamp, MACHINE_REMOVE,
-            *machine_id, rack_id);
+    trace_writer_->Write(machines_to_racks_, "%ju,%d,%ju,%ju\n", timestamp,
+                         MACHINE_REMOVE, *machine_id, rack_id);
   }
 }
 
@@ -265,19 +277,21 @@ void TraceGenerator::SchedulerRun(
                    << "% of tasks are unscheduled";
     }
     uint64_t timestamp = time_manager_->GetCurrentTimestamp();
-    fprintf(scheduler_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%s\n",
-            timestamp, scheduler_stats.scheduler_runtime_,
-            scheduler_stats.algorithm_runtime_,
-            scheduler_stats.total_runtime_,
-            unscheduled_tasks_cnt_, evicted_tasks_cnt_, migrated_tasks_cnt_,
-            unscheduled_tasks_cnt_ + running_tasks_cnt_,
-            task_events_cnt_per_round_, machine_events_cnt_per_round_,
-            dimacs_stats.GetStatsString().c_str());
+    trace_writer_->Write(scheduler_events_,
+                         "%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%ju,%s\n",
+                         timestamp, scheduler_stats.scheduler_runtime_,
+                         scheduler_stats.algorithm_runtime_,
+                         scheduler_stats.total_runtime_, unscheduled_tasks_cnt_,
+                         evicted_tasks_cnt_, migrated_tasks_cnt_,
+                         unscheduled_tasks_cnt_ + running_tasks_cnt_,
+                         task_events_cnt_per_round_,
+                         machine_events_cnt_per_round_,
+                         dimacs_stats.GetStatsString().c_str());
     evicted_tasks_cnt_ = 0;
     migrated_tasks_cnt_ = 0;
     task_events_cnt_per_round_ = 0;
     machine_events_cnt_per_round_ = 0;
-    fflush(scheduler_events_);
+    trace_writer_->Flush(scheduler_events_);
   }
 }
 
@@ -312,9 +326,9 @@ void TraceGenerator::TaskSubmitted(TaskDescriptor* td_ptr) {
         *num_tasks = *num_tasks + 1;
       }
     }
-    fprintf(task_events_, "%ju,,%ju,%ju,,%d,,,,,,,\n",
-            timestamp, job_id, trace_task_id, TASK_SUBMIT_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,,%d,,,,,,,\n", timestamp,
+                         job_id, trace_task_id, TASK_SUBMIT_EVENT);
+    trace_writer_->Flush(task_events_);
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     if (tr_ptr == NULL) {
       TaskRuntime task_runtime;
@@ -338,17 +352,18 @@ void TraceGenerator::TaskCompleted(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_FINISH_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
+                         timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
+                         TASK_FINISH_EVENT);
+    trace_writer_->Flush(task_events_);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
     tr_ptr->runtime_ = timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    trace_writer_->Write(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
+                         *job_id_ptr, tr_ptr->task_id_, *job_id_ptr,
+                         tr_ptr->start_time_, tr_ptr->total_runtime_,
+                         tr_ptr->runtime_, tr_ptr->num_runs_);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -369,10 +384,10 @@ void TraceGenerator::TaskEvicted(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_EVICT_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
+                         timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
+                         TASK_EVICT_EVENT);
+    trace_writer_->Flush(task_events_);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
@@ -390,16 +405,17 @@ void TraceGenerator::TaskFailed(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_FAIL_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
+                         timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
+                         TASK_FAIL_EVENT);
+    trace_writer_->Flush(task_events_);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    trace_writer_->Write(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
+                         *job_id_ptr, tr_ptr->task_id_, *job_id_ptr,
+                         tr_ptr->start_time_, tr_ptr->total_runtime_,
+                         tr_ptr->runtime_, tr_ptr->num_runs_);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -416,16 +432,17 @@ void TraceGenerator::TaskKilled(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_KILL_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
+                         timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
+                         TASK_KILL_EVENT);
+    trace_writer_->Flush(task_events_);
     // XXX(ionel): This assumes that only one task with task_id is running
     // at a time.
     tr_ptr->total_runtime_ += timestamp - tr_ptr->last_schedule_time_;
-    fprintf(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
-            *job_id_ptr, tr_ptr->task_id_, *job_id_ptr, tr_ptr->start_time_,
-            tr_ptr->total_runtime_, tr_ptr->runtime_, tr_ptr->num_runs_);
+    trace_writer_->Write(task_runtime_events_, "%ju,%ju,%ju,%ju,%ju,%ju,%ju\n",
+                         *job_id_ptr, tr_ptr->task_id_, *job_id_ptr,
+                         tr_ptr->start_time_, tr_ptr->total_runtime_,
+                         tr_ptr->runtime_, tr_ptr->num_runs_);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -455,9 +472,9 @@ void TraceGenerator::TaskRemoved(TaskID_t task_id, bool was_running) {
     CHECK_NOTNULL(job_id_ptr);
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
-    fprintf(task_events_, "%ju,,%ju,%ju,,,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, TASK_REMOVED_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,,,%d,,,,,,,\n", timestamp,
+                         *job_id_ptr, tr_ptr->task_id_, TASK_REMOVED_EVENT);
+    trace_writer_->Flush(task_events_);
     task_to_job_.erase(task_id);
     task_to_runtime_.erase(task_id);
   }
@@ -474,10 +491,10 @@ void TraceGenerator::TaskScheduled(TaskID_t task_id,
     TaskRuntime* tr_ptr = FindOrNull(task_to_runtime_, task_id);
     CHECK_NOTNULL(tr_ptr);
     uint64_t machine_id = GetMachineId(rd);
-    fprintf(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
-            timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
-            TASK_SCHEDULE_EVENT);
-    fflush(task_events_);
+    trace_writer_->Write(task_events_, "%ju,,%ju,%ju,%ju,%d,,,,,,,\n",
+                         timestamp, *job_id_ptr, tr_ptr->task_id_, machine_id,
+                         TASK_SCHEDULE_EVENT);
+    trace_writer_->Flush(task_events_);
     tr_ptr->num_runs_++;
     tr_ptr->last_schedule_time_ = timestamp;
   }
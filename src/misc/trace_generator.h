@@ -25,6 +25,7 @@
 
 #include "base/types.h"
 #include "misc/time_interface.h"
+#include "misc/trace_writer.h"
 #include "scheduling/flow/dimacs_change_stats.h"
 #include "scheduling/scheduler_interface.h"
 
@@ -93,6 +94,7 @@ class TraceGenerator {
                      int64_t worst_cluster_cost, int64_t best_rack_cost,
                      int64_t best_machine_cost, int64_t cost_to_unsched,
                      uint64_t num_pref_machines, uint64_t num_pref_racks);
+  void JobCompleted(const JobDescriptor& jd);
   void RemoveBlock(ResourceID_t machine_res_id, uint64_t block_id,
                    uint64_t block_size);
   void RemoveMachine(const ResourceDescriptor& rd);
@@ -116,23 +118,22 @@ class TraceGenerator {
 
   TimeInterface* time_manager_;
   unordered_map<TaskID_t, uint64_t> task_to_job_;
-  // We currently only remove data from job_num_tasks_ when
-  // TraceGenerator is deleted. Update the code if the table
-  // ends up consuming too much memory.
+  // Entries are removed when jobs complete. The number of tasks of jobs
+  // that do not complete is output when TraceGenerator is deleted.
   unordered_map<uint64_t, uint64_t> job_num_tasks_;
   unordered_map<TaskID_t, TaskRuntime> task_to_runtime_;
   unordered_map<ResourceID_t, uint64_t,
       boost::hash<ResourceID_t>> machine_res_id_to_trace_id_;
-  FILE* machine_events_;
-  FILE* scheduler_events_;
-  FILE* task_events_;
-  FILE* task_runtime_events_;
-  FILE* jobs_num_tasks_;
-  FILE* task_usage_stat_;
-  FILE* dfs_events_;
-  FILE* tasks_to_blocks_;
-  FILE* machines_to_racks_;
-  FILE* quincy_tasks_;
+  uint32_t machine_events_;
+  uint32_t scheduler_events_;
+  uint32_t task_events_;
+  uint32_t task_runtime_events_;
+  uint32_t jobs_num_tasks_;
+  uint32_t task_usage_stat_;
+  uint32_t dfs_events_;
+  uint32_t tasks_to_blocks_;
+  uint32_t machines_to_racks_;
+  uint32_t quincy_tasks_;
   uint64_t unscheduled_tasks_cnt_;
   uint64_t running_tasks_cnt_;
   uint64_t evicted_tasks_cnt_;
@@ -142,6 +143,8 @@ class TraceGenerator {
   uint64_t task_events_cnt_per_round_;
   // It includes machine additions and removals.
   uint64_t machine_events_cnt_per_round_;
+  // Writer used to output the trace streams.
+  TraceWriter* trace_writer_;
 };
 
 } // namespace firmament
@@ -0,0 +1,179 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Asynchronous and compressed trace writer.
+
+#include "misc/trace_writer.h"
+
+#include <stdarg.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define TRACE_LINE_MAX_LENGTH 4096
+
+namespace firmament {
+
+TraceWriter::TraceWriter(bool async, bool compress, uint64_t queue_size)
+  : async_(async), compress_(compress), lines_(max<uint64_t>(queue_size, 1)),
+    writer_idle_(false), stop_(false), num_lines_written_(0),
+    writer_thread_(NULL) {
+  if (async_) {
+    writer_thread_ =
+      new boost::thread(boost::bind(&TraceWriter::WriterLoop, this));
+  }
+}
+
+TraceWriter::~TraceWriter() {
+  if (writer_thread_) {
+    // The writer thread drains the queue before it exits.
+    stop_.store(true);
+    {
+      boost::lock_guard<boost::mutex> lock(wake_lock_);
+      wake_cond_.notify_one();
+    }
+    writer_thread_->join();
+    delete writer_thread_;
+  }
+  CloseStreams();
+}
+
+void TraceWriter::CloseStreams() {
+  for (auto& file : files_) {
+    fclose(file);
+  }
+  for (auto& gz_file : gz_files_) {
+    gzclose(gz_file);
+  }
+  files_.clear();
+  gz_files_.clear();
+}
+
+void TraceWriter::Flush(uint32_t stream_id) {
+  // Flushing compressed streams would degrade the compression ratio.
+  if (!async_ && !compress_) {
+    CHECK_LT(stream_id, files_.size());
+    fflush(files_[stream_id]);
+  }
+}
+
+void TraceWriter::FlushStreams() {
+  for (auto& file : files_) {
+    fflush(file);
+  }
+}
+
+uint32_t TraceWriter::OpenStream(const string& path) {
+  // N.B. Streams must be opened before any line is written because the
+  // writer thread accesses the file vectors without a lock.
+  CHECK_EQ(num_lines_written_.load(), 0);
+  if (compress_) {
+    string gz_path = path + ".gz";
+    gzFile gz_file = gzopen(gz_path.c_str(), "wb");
+    CHECK(gz_file != NULL) << "Failed to open: " << gz_path;
+    gz_files_.push_back(gz_file);
+    return gz_files_.size() - 1;
+  } else {
+    FILE* file = fopen(path.c_str(), "w");
+    CHECK(file != NULL) << "Failed to open: " << path;
+    files_.push_back(file);
+    return files_.size() - 1;
+  }
+}
+
+void TraceWriter::Write(uint32_t stream_id, const char* format, ...) {
+  char line[TRACE_LINE_MAX_LENGTH];
+  va_list args;
+  va_start(args, format);
+  int line_length = vsnprintf(line, TRACE_LINE_MAX_LENGTH, format, args);
+  va_end(args);
+  CHECK_GE(line_length, 0);
+  CHECK_LT(line_length, TRACE_LINE_MAX_LENGTH) << "Trace line is too long";
+  if (async_) {
+    TraceLine* trace_line = new TraceLine(stream_id, string(line, line_length));
+    // Block until the writer thread catches up if the queue is full.
+    while (!lines_.bounded_push(trace_line)) {
+      WakeWriter();
+      boost::this_thread::yield();
+    }
+    WakeWriter();
+  } else {
+    boost::lock_guard<boost::mutex> lock(sync_write_lock_);
+    WriteLine(TraceLine(stream_id, string(line, line_length)));
+  }
+}
+
+void TraceWriter::WakeWriter() {
+  // Pairs with the fence in WriterLoop: either the writer sees the line
+  // before it goes to sleep, or we see that it is idle and wake it up.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (writer_idle_.load()) {
+    boost::lock_guard<boost::mutex> lock(wake_lock_);
+    wake_cond_.notify_one();
+  }
+}
+
+void TraceWriter::WriteLine(const TraceLine& trace_line) {
+  if (compress_) {
+    CHECK_LT(trace_line.stream_id_, gz_files_.size());
+    CHECK_EQ(gzwrite(gz_files_[trace_line.stream_id_],
+                     trace_line.line_.data(), trace_line.line_.size()),
+             static_cast<int>(trace_line.line_.size()));
+  } else {
+    CHECK_LT(trace_line.stream_id_, files_.size());
+    CHECK_EQ(fwrite(trace_line.line_.data(), 1, trace_line.line_.size(),
+                    files_[trace_line.stream_id_]),
+             trace_line.line_.size());
+  }
+  num_lines_written_.fetch_add(1);
+}
+
+void TraceWriter::WriterLoop() {
+  TraceLine* trace_line;
+  while (true) {
+    bool stopping = stop_.load();
+    uint64_t num_popped = 0;
+    while (lines_.pop(trace_line)) {
+      WriteLine(*trace_line);
+      delete trace_line;
+      num_popped++;
+    }
+    if (stopping) {
+      // All the lines pushed before stop_ was set have been written.
+      break;
+    }
+    if (num_popped > 0) {
+      if (!compress_) {
+        FlushStreams();
+      }
+      continue;
+    }
+    boost::unique_lock<boost::mutex> lock(wake_lock_);
+    writer_idle_.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (lines_.empty() && !stop_.load()) {
+      wake_cond_.wait(lock);
+    }
+    writer_idle_.store(false);
+  }
+}
+
+} // namespace firmament
@@ -0,0 +1,118 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Writer used by the trace generator to output the trace files. The writer
+// can format the trace lines on the caller's thread and hand them over to a
+// background thread which does the (optionally compressed) file I/O.
+
+#ifndef FIRMAMENT_MISC_TRACE_WRITER_H
+#define FIRMAMENT_MISC_TRACE_WRITER_H
+
+#include <zlib.h>
+
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+
+class TraceWriter {
+ public:
+  /**
+   * @param async true if the files should be written by a background thread
+   * @param compress true if the files should be gzip compressed
+   * @param queue_size the maximum number of lines waiting to be written by
+   * the background thread
+   */
+  TraceWriter(bool async, bool compress, uint64_t queue_size);
+  ~TraceWriter();
+
+  /**
+   * Opens a new trace file. If the writer compresses the files then a .gz
+   * suffix is appended to the path.
+   * @param path the path of the file
+   * @return the id of the stream that must be used to write to the file
+   */
+  uint32_t OpenStream(const string& path);
+
+  /**
+   * Flushes a stream. It is a no-op for asynchronous writers because the
+   * background thread flushes the streams whenever it runs out of lines to
+   * write.
+   * @param stream_id the id of the stream to flush
+   */
+  void Flush(uint32_t stream_id);
+
+  /**
+   * Writes a formatted line to a stream. The method may be called from
+   * several threads; lines are formatted on the calling thread and, for
+   * asynchronous writers, handed over without taking a lock.
+   * @param stream_id the id of the stream to write to
+   * @param format printf style format of the line
+   */
+  void Write(uint32_t stream_id, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+  inline uint64_t num_lines_written() const {
+    return num_lines_written_.load();
+  }
+
+ private:
+  struct TraceLine {
+    TraceLine() : stream_id_(0) {}
+    TraceLine(uint32_t stream_id, const string& line)
+      : stream_id_(stream_id), line_(line) {}
+    uint32_t stream_id_;
+    string line_;
+  };
+
+  void CloseStreams();
+  void FlushStreams();
+  void WakeWriter();
+  void WriteLine(const TraceLine& trace_line);
+  void WriterLoop();
+
+  bool async_;
+  bool compress_;
+  vector<FILE*> files_;
+  vector<gzFile> gz_files_;
+  // Serializes the threads of synchronous writers, which share the files.
+  boost::mutex sync_write_lock_;
+  // Lines waiting for the writer thread. The queue is lock-free for any
+  // number of producers; its nodes are preallocated, which bounds it.
+  boost::lockfree::queue<TraceLine*> lines_;
+  // The writer thread sleeps on wake_cond_ while it has nothing to write,
+  // and sets writer_idle_ so that producers know to wake it up.
+  boost::mutex wake_lock_;
+  boost::condition_variable wake_cond_;
+  std::atomic<bool> writer_idle_;
+  std::atomic<bool> stop_;
+  std::atomic<uint64_t> num_lines_written_;
+  boost::thread* writer_thread_;
+};
+
+} // namespace firmament
+
+#endif  // FIRMAMENT_MISC_TRACE_WRITER_H
@@ -0,0 +1,129 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Trace writer unit tests.
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "base/common.h"
+#include "misc/trace_writer.h"
+#include "misc/utils.h"
+
+namespace firmament {
+
+class TraceWriterTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    trace_dir_ = MakeTemporaryDirectory("trace_writer_test");
+    ASSERT_FALSE(trace_dir_.empty());
+  }
+
+  virtual void TearDown() {
+    if (!trace_dir_.empty()) {
+      EXPECT_TRUE(RemoveDirectoryRecursively(trace_dir_));
+    }
+  }
+
+  string ReadFile(const string& path) {
+    string contents;
+    char buffer[256];
+    gzFile file = gzopen(path.c_str(), "rb");
+    EXPECT_TRUE(file != NULL) << "Failed to open: " << path;
+    if (file == NULL)
+      return contents;
+    int num_read;
+    while ((num_read = gzread(file, buffer, sizeof(buffer))) > 0) {
+      contents.append(buffer, num_read);
+    }
+    gzclose(file);
+    return contents;
+  }
+
+ public:
+  void WriteLines(TraceWriter* writer, uint32_t stream_id,
+                  uint64_t num_lines) {
+    for (uint64_t index = 0; index < num_lines; ++index) {
+      writer->Write(stream_id, "%ju,%d,%s\n", index, TRACE_EVENT, "a");
+    }
+  }
+
+ protected:
+  static const int TRACE_EVENT = 3;
+  string trace_dir_;
+};
+
+TEST_F(TraceWriterTest, SyncWrite) {
+  TraceWriter* writer = new TraceWriter(false, false, 16);
+  uint32_t stream_id = writer->OpenStream(trace_dir_ + "/sync.csv");
+  WriteLines(writer, stream_id, 2);
+  writer->Flush(stream_id);
+  EXPECT_EQ(writer->num_lines_written(), 2);
+  EXPECT_EQ(ReadFile(trace_dir_ + "/sync.csv"), "0,3,a\n1,3,a\n");
+  delete writer;
+}
+
+TEST_F(TraceWriterTest, AsyncWrite) {
+  // Use a queue smaller than the number of lines to check that the writer
+  // blocks when the queue is full rather than dropping lines.
+  TraceWriter* writer = new TraceWriter(true, false, 4);
+  uint32_t first_stream_id = writer->OpenStream(trace_dir_ + "/first.csv");
+  uint32_t second_stream_id = writer->OpenStream(trace_dir_ + "/second.csv");
+  WriteLines(writer, first_stream_id, 1000);
+  WriteLines(writer, second_stream_id, 10);
+  delete writer;
+  string first_contents = ReadFile(trace_dir_ + "/first.csv");
+  EXPECT_EQ(count(first_contents.begin(), first_contents.end(), '\n'), 1000);
+  EXPECT_EQ(first_contents.substr(0, 12), "0,3,a\n1,3,a\n");
+  string second_contents = ReadFile(trace_dir_ + "/second.csv");
+  EXPECT_EQ(count(second_contents.begin(), second_contents.end(), '\n'), 10);
+}
+
+TEST_F(TraceWriterTest, AsyncWriteFromSeveralThreads) {
+  TraceWriter* writer = new TraceWriter(true, true, 4);
+  uint32_t stream_id = writer->OpenStream(trace_dir_ + "/threads.csv");
+  boost::thread_group writers;
+  for (uint32_t i = 0; i < 4; ++i) {
+    writers.create_thread(boost::bind(&TraceWriterTest::WriteLines, this,
+                                      writer, stream_id, 500));
+  }
+  writers.join_all();
+  delete writer;
+  string contents = ReadFile(trace_dir_ + "/threads.csv.gz");
+  EXPECT_EQ(count(contents.begin(), contents.end(), '\n'), 2000);
+  EXPECT_EQ(count(contents.begin(), contents.end(), 'a'), 2000);
+}
+
+TEST_F(TraceWriterTest, CompressedWrite) {
+  TraceWriter* writer = new TraceWriter(true, true, 16);
+  uint32_t stream_id = writer->OpenStream(trace_dir_ + "/compressed.csv");
+  WriteLines(writer, stream_id, 2);
+  delete writer;
+  EXPECT_EQ(ReadFile(trace_dir_ + "/compressed.csv.gz"), "0,3,a\n1,3,a\n");
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
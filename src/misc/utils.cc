@@ -24,9 +24,11 @@
 
 // N.B.: C header for gettimeofday()
 extern "C" {
+#include <ftw.h>
 #include <limits.h>
 #include <openssl/sha.h>
 #include <stdio.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -46,6 +48,7 @@ extern "C" {
 #include <SpookyV2.h>
 
 #include "misc/utils.h"
+#include "base/resource_id_interner.h"
 #include "misc/map-util.h"
 
 DEFINE_string(debug_output_dir, "/tmp/firmament-debug",
@@ -220,6 +223,33 @@ void MkdirIfNotPresent(const string &directory) {
   }
 }
 
+string MakeTemporaryDirectory(const string& prefix) {
+  string dir_template = "/tmp/" + prefix + "-XXXXXX";
+  vector<char> path(dir_template.begin(), dir_template.end());
+  path.push_back('\0');
+  if (mkdtemp(&path[0]) == NULL) {
+    PLOG(ERROR) << "Could not make temporary directory " << dir_template;
+    return "";
+  }
+  return string(&path[0]);
+}
+
+static int RemoveTreeEntry(const char* path, const struct stat* stat_buf,
+                           int type_flag, struct FTW* ftw_buf) {
+  if (remove(path) < 0) {
+    PLOG(ERROR) << "Could not remove " << path;
+    return -1;
+  }
+  return 0;
+}
+
+bool RemoveDirectoryRecursively(const string& path) {
+  // FTW_DEPTH visits a directory's entries before the directory itself, and
+  // FTW_PHYS removes symlinks rather than what they point to.
+  return nftw(path.c_str(), RemoveTreeEntry, OPEN_MAX_GUESS,
+              FTW_DEPTH | FTW_PHYS) == 0;
+}
+
 DataObjectID_t DataObjectIDFromString(const string& str) {
   // N.B.: This assumes that the string is a readable, hexadecimal
   // representation of the ID.
@@ -264,15 +294,28 @@ ResourceID_t MachineResIDForResource(shared_ptr<ResourceMap_t> resource_map,
                                      ResourceID_t res_id) {
   ResourceStatus* rs = FindPtrOrNull(*resource_map, res_id);
   CHECK_NOTNULL(rs);
-  ResourceTopologyNodeDescriptor* rtnd = rs->mutable_topology_node();
+  // A resource never moves to a different machine, so the result is cached
+  // in the resource's status after the first walk up the topology.
+  DenseResourceID_t machine_dense_id = rs->machine_dense_id();
+  if (machine_dense_id != ResourceIDInterner::kInvalidDenseResourceID) {
+    return ResourceIDs()->ResourceIDForDenseID(machine_dense_id);
+  }
+  ResourceStatus* machine_rs = rs;
+  ResourceTopologyNodeDescriptor* rtnd = machine_rs->mutable_topology_node();
   while (rtnd->resource_desc().type() != ResourceDescriptor::RESOURCE_MACHINE) {
     CHECK(!rtnd->parent_id().empty())
       << "Non-machine resource " << rtnd->resource_desc().uuid()
       << " has no parent!";
-    rs = FindPtrOrNull(*resource_map, ResourceIDFromString(rtnd->parent_id()));
-    rtnd = rs->mutable_topology_node();
+    machine_rs = FindPtrOrNull(*resource_map,
+                               ResourceIDFromString(rtnd->parent_id()));
+    rtnd = machine_rs->mutable_topology_node();
   }
-  return ResourceIDFromString(rtnd->resource_desc().uuid());
+  ResourceID_t machine_res_id =
+    ResourceIDs()->ResourceIDForDenseID(machine_rs->dense_id());
+  // The cached index must stay valid for as long as the status exists, so the
+  // status holds its own reference on it.
+  rs->set_machine_dense_id(ResourceIDs()->Intern(machine_res_id));
+  return machine_res_id;
 }
 
 ResourceID_t ResourceIDFromString(const string& str) {
@@ -294,6 +337,19 @@ TaskID_t TaskIDFromString(const string& str) {
   return task_uuid;
 }
 
+void CloseFileDescriptorsFrom(int first_fd) {
+#ifdef __NR_close_range
+  if (syscall(__NR_close_range, first_fd, ~0U, 0) == 0)
+    return;
+#endif
+  // Older kernels: close every possible descriptor, one syscall each.
+  int fds;
+  if ((fds = getdtablesize()) == -1) fds = OPEN_MAX_GUESS;
+  for (int fd = first_fd; fd < fds; fd++) {
+    close(fd);
+  }
+}
+
 // Pipe setup
 // errfd[0] == PARENT_READ
 // errfd[1] == CHILD_WRITE
@@ -351,9 +407,6 @@ int32_t ExecCommandSync(const string& cmdline, vector<string> args,
       break;
     case 0: {
       // Child
-      int fd;
-      int fds;
-
       // set up pipes
       CHECK(dup2(infd[0], STDIN_FILENO) == STDIN_FILENO);
       CHECK(dup2(outfd[1], STDOUT_FILENO) == STDOUT_FILENO);
@@ -362,12 +415,7 @@ int32_t ExecCommandSync(const string& cmdline, vector<string> args,
       // XXX(ionel): It's not clear to me while we're closing all the fds >= 3.
 
       // Close all file descriptors other than stdin, stdout and stderr
-      if ((fds = getdtablesize()) == -1) fds = OPEN_MAX_GUESS;
-      for (fd = 3; fd < fds; fd++) {
-        // Assume we're done once we get a BADFD
-        if (close(fd) == -EBADF)
-          break;
-      }
+      CloseFileDescriptorsFrom(3);
 
       // kill child process if parent terminates
       // SOMEDAY(adam): make this portable beyond Linux?
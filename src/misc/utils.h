@@ -78,6 +78,12 @@ uint64_t HashJobID(const TaskDescriptor& td);
 uint64_t HashString(const string& str);
 bool IsEqual(double first, double second);
 void MkdirIfNotPresent(const string &directory);
+// Creates a fresh directory named /tmp/<prefix>-XXXXXX and returns its path,
+// or an empty string if it could not be created.
+string MakeTemporaryDirectory(const string& prefix);
+// Removes a directory and everything below it without following symlinks.
+// Returns false if anything could not be removed.
+bool RemoveDirectoryRecursively(const string& path);
 // Utility functions to parse various types from strings.
 DataObjectID_t DataObjectIDFromString(const string& str);
 DataObjectID_t DataObjectIDFromProtobuf(const string& str);
@@ -90,6 +96,10 @@ uint64_t UpdateTaskTotalUnscheduledTime(const TaskDescriptor& td);
 void SetupResourceID(boost::mt19937 *resource_id, const char *hostname);
 TaskID_t TaskIDFromString(const string& str);
 
+// Closes all file descriptors numbered first_fd or higher. Uses close_range(2)
+// where the kernel supports it, and is safe to call between fork or vfork and
+// exec.
+void CloseFileDescriptorsFrom(int first_fd);
 int32_t ExecCommandSync(const string& cmdline, vector<string> args,
                         int infd[2], int outfd[2], int errfd[2]);
 int32_t WaitForFinish(pid_t pid);
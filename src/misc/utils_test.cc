@@ -21,6 +21,8 @@
 // Utility function unit tests.
 
 #include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include "base/common.h"
 #include "base/task_desc.pb.h"
@@ -105,6 +107,19 @@ TEST_F(UtilsTest, TaskIDFromString) {
   EXPECT_EQ(TaskIDFromString(test2), 16733209960240500155ULL);
 }
 
+// Tests creating and removing a temporary directory tree.
+TEST_F(UtilsTest, TemporaryDirectory) {
+  string dir = MakeTemporaryDirectory("utils_test");
+  ASSERT_FALSE(dir.empty());
+  MkdirIfNotPresent(dir + "/nested");
+  FILE* file = fopen((dir + "/nested/file").c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  fclose(file);
+  ASSERT_EQ(symlink("/", (dir + "/link").c_str()), 0);
+  EXPECT_TRUE(RemoveDirectoryRecursively(dir));
+  EXPECT_NE(access(dir.c_str(), F_OK), 0);
+}
+
 
 
 }  // namespace firmament
@@ -0,0 +1,180 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Work-stealing thread pool, and a dispatcher that runs tasks on it in
+// per-key order.
+
+#include "misc/work_stealing_executor.h"
+
+#include <boost/bind.hpp>
+
+namespace firmament {
+
+// Maximum number of tasks a lane runs before yielding its worker thread.
+static const uint32_t kMaxTasksPerLaneRun = 32;
+
+WorkStealingExecutor::WorkStealingExecutor(uint32_t num_threads)
+  : next_queue_(0), num_queued_(0), shutdown_(false) {
+  CHECK_GT(num_threads, 0);
+  for (uint32_t i = 0; i < num_threads; ++i)
+    queues_.push_back(new WorkerQueue);
+  for (uint32_t i = 0; i < num_threads; ++i) {
+    threads_.create_thread(
+        boost::bind(&WorkStealingExecutor::WorkerLoop, this, i));
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  Shutdown();
+  for (vector<WorkerQueue*>::iterator it = queues_.begin();
+       it != queues_.end();
+       ++it) {
+    delete *it;
+  }
+}
+
+bool WorkStealingExecutor::GetTask(uint32_t worker_index, Task* task) {
+  // Take the oldest task from our own queue first...
+  {
+    WorkerQueue* queue = queues_[worker_index];
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+    if (!queue->tasks.empty()) {
+      task->swap(queue->tasks.front());
+      queue->tasks.pop_front();
+      --num_queued_;
+      return true;
+    }
+  }
+  // ... and otherwise steal the newest task from another worker's queue.
+  for (uint32_t i = 1; i < queues_.size(); ++i) {
+    WorkerQueue* queue = queues_[(worker_index + i) % queues_.size()];
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+    if (!queue->tasks.empty()) {
+      task->swap(queue->tasks.back());
+      queue->tasks.pop_back();
+      --num_queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingExecutor::Shutdown() {
+  {
+    boost::lock_guard<boost::mutex> lock(idle_lock_);
+    if (shutdown_)
+      return;
+    shutdown_ = true;
+  }
+  idle_cond_.notify_all();
+  threads_.join_all();
+}
+
+void WorkStealingExecutor::Submit(const Task& task) {
+  uint32_t* worker_index = worker_index_.get();
+  uint32_t queue_index =
+    worker_index ? *worker_index : next_queue_++ % queues_.size();
+  {
+    WorkerQueue* queue = queues_[queue_index];
+    boost::lock_guard<boost::mutex> lock(queue->lock);
+    queue->tasks.push_back(task);
+    ++num_queued_;
+  }
+  // Taking the idle lock ensures that a worker that found no tasks is either
+  // already waiting, or will see the task we have just queued.
+  {
+    boost::lock_guard<boost::mutex> lock(idle_lock_);
+  }
+  idle_cond_.notify_one();
+}
+
+void WorkStealingExecutor::WorkerLoop(uint32_t worker_index) {
+  worker_index_.reset(new uint32_t(worker_index));
+  Task task;
+  while (true) {
+    if (GetTask(worker_index, &task)) {
+      task();
+      task.clear();
+      continue;
+    }
+    boost::unique_lock<boost::mutex> lock(idle_lock_);
+    while (num_queued_ == 0 && !shutdown_)
+      idle_cond_.wait(lock);
+    if (num_queued_ == 0 && shutdown_)
+      return;
+  }
+}
+
+KeyedDispatcher::KeyedDispatcher(WorkStealingExecutor* executor,
+                                 uint32_t num_lanes)
+  : executor_(executor) {
+  CHECK_GT(num_lanes, 0);
+  for (uint32_t i = 0; i < num_lanes; ++i)
+    lanes_.push_back(new Lane);
+}
+
+KeyedDispatcher::~KeyedDispatcher() {
+  for (vector<Lane*>::iterator it = lanes_.begin();
+       it != lanes_.end();
+       ++it) {
+    delete *it;
+  }
+}
+
+void KeyedDispatcher::Dispatch(uint64_t key, const Task& task) {
+  Enqueue(lanes_[key % lanes_.size()], task);
+}
+
+void KeyedDispatcher::DispatchSequenced(const Task& task) {
+  Enqueue(&sequenced_lane_, task);
+}
+
+void KeyedDispatcher::Enqueue(Lane* lane, const Task& task) {
+  bool schedule;
+  {
+    boost::lock_guard<boost::mutex> lock(lane->lock);
+    lane->tasks.push_back(task);
+    schedule = !lane->scheduled;
+    lane->scheduled = true;
+  }
+  if (schedule)
+    executor_->Submit(boost::bind(&KeyedDispatcher::RunLane, this, lane));
+}
+
+void KeyedDispatcher::RunLane(Lane* lane) {
+  Task task;
+  for (uint32_t i = 0; i < kMaxTasksPerLaneRun; ++i) {
+    {
+      boost::lock_guard<boost::mutex> lock(lane->lock);
+      if (lane->tasks.empty()) {
+        lane->scheduled = false;
+        return;
+      }
+      task.swap(lane->tasks.front());
+      lane->tasks.pop_front();
+    }
+    task();
+  }
+  // The lane still has tasks; requeue it rather than hogging the worker, so
+  // that other lanes get a turn.
+  executor_->Submit(boost::bind(&KeyedDispatcher::RunLane, this, lane));
+}
+
+}  // namespace firmament
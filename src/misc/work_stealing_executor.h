@@ -0,0 +1,137 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Work-stealing thread pool, and a dispatcher that runs tasks on it in
+// per-key order.
+
+#ifndef FIRMAMENT_MISC_WORK_STEALING_EXECUTOR_H
+#define FIRMAMENT_MISC_WORK_STEALING_EXECUTOR_H
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+
+// A fixed-size thread pool. Each worker thread has its own task queue; tasks
+// submitted from a worker go to its own queue, and other tasks are spread
+// round-robin over the queues. Idle workers steal tasks from the other
+// workers' queues.
+class WorkStealingExecutor {
+ public:
+  typedef boost::function<void()> Task;
+
+  /**
+   * @param num_threads the number of worker threads
+   */
+  explicit WorkStealingExecutor(uint32_t num_threads);
+  ~WorkStealingExecutor();
+
+  /**
+   * Stops the workers once all submitted tasks have run, and waits for them
+   * to exit. No tasks may be submitted afterwards.
+   */
+  void Shutdown();
+
+  /**
+   * Submits a task for execution on one of the worker threads.
+   * @param task the task to run
+   */
+  void Submit(const Task& task);
+
+  uint32_t num_threads() const {
+    return queues_.size();
+  }
+
+ private:
+  struct WorkerQueue {
+    boost::mutex lock;
+    deque<Task> tasks;
+  };
+
+  bool GetTask(uint32_t worker_index, Task* task);
+  void WorkerLoop(uint32_t worker_index);
+
+  vector<WorkerQueue*> queues_;
+  boost::thread_group threads_;
+  // Index of the current thread's queue; not set on non-worker threads.
+  boost::thread_specific_ptr<uint32_t> worker_index_;
+  std::atomic<uint32_t> next_queue_;
+  // Number of submitted tasks that have not yet been taken by a worker.
+  std::atomic<uint64_t> num_queued_;
+  boost::mutex idle_lock_;
+  boost::condition_variable idle_cond_;
+  bool shutdown_;
+};
+
+// Runs tasks on a WorkStealingExecutor such that tasks with the same key run
+// one at a time and in the order in which they were dispatched, while tasks
+// with different keys may run in parallel. Keys are hashed onto a fixed set of
+// lanes; in addition, there is a single sequenced lane for tasks that must be
+// serialized with respect to each other regardless of their keys.
+class KeyedDispatcher {
+ public:
+  typedef WorkStealingExecutor::Task Task;
+
+  /**
+   * @param executor the executor to run tasks on
+   * @param num_lanes the number of lanes keys are hashed onto
+   */
+  KeyedDispatcher(WorkStealingExecutor* executor, uint32_t num_lanes);
+  ~KeyedDispatcher();
+
+  /**
+   * Dispatches a task to run after all earlier tasks with the same key.
+   * @param key the ordering key
+   * @param task the task to run
+   */
+  void Dispatch(uint64_t key, const Task& task);
+
+  /**
+   * Dispatches a task to the sequenced lane.
+   * @param task the task to run
+   */
+  void DispatchSequenced(const Task& task);
+
+ private:
+  struct Lane {
+    Lane() : scheduled(false) {}
+    boost::mutex lock;
+    deque<Task> tasks;
+    // True if the lane is queued on, or running on, the executor.
+    bool scheduled;
+  };
+
+  void Enqueue(Lane* lane, const Task& task);
+  void RunLane(Lane* lane);
+
+  WorkStealingExecutor* executor_;
+  vector<Lane*> lanes_;
+  Lane sequenced_lane_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_MISC_WORK_STEALING_EXECUTOR_H
@@ -0,0 +1,130 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Work-stealing executor and keyed dispatcher unit tests.
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+
+#include <atomic>
+#include <vector>
+
+#include "base/common.h"
+#include "misc/work_stealing_executor.h"
+
+namespace firmament {
+
+static const uint32_t kNumKeys = 16;
+static const uint32_t kTasksPerKey = 500;
+
+// The fixture for testing classes WorkStealingExecutor and KeyedDispatcher.
+class WorkStealingExecutorTest : public ::testing::Test {
+ public:
+  WorkStealingExecutorTest()
+    : num_run_(0), num_out_of_order_(0), next_index_(kNumKeys, 0) {}
+
+  void CountTask() {
+    ++num_run_;
+  }
+
+  // Records a task for the given key; tasks must arrive with increasing
+  // indices.
+  void KeyedTask(uint32_t key, uint32_t index) {
+    if (next_index_[key] != index)
+      ++num_out_of_order_;
+    next_index_[key] = index + 1;
+    ++num_run_;
+  }
+
+  // Submits further tasks from a worker thread.
+  void SpawningTask(WorkStealingExecutor* executor, uint32_t depth) {
+    ++num_run_;
+    if (depth == 0)
+      return;
+    for (uint32_t i = 0; i < 2; ++i) {
+      executor->Submit(boost::bind(&WorkStealingExecutorTest::SpawningTask,
+                                   this, executor, depth - 1));
+    }
+  }
+
+  std::atomic<uint64_t> num_run_;
+  std::atomic<uint64_t> num_out_of_order_;
+  // Only accessed from tasks on the key's lane, which never run concurrently.
+  vector<uint32_t> next_index_;
+};
+
+// Tests that all submitted tasks run before shutdown completes.
+TEST_F(WorkStealingExecutorTest, RunsAllTasks) {
+  WorkStealingExecutor executor(4);
+  for (uint32_t i = 0; i < 10000; ++i) {
+    executor.Submit(boost::bind(&WorkStealingExecutorTest::CountTask, this));
+  }
+  executor.Shutdown();
+  EXPECT_EQ(num_run_, 10000ULL);
+}
+
+// Tests that tasks submitted from worker threads also run.
+TEST_F(WorkStealingExecutorTest, RunsTasksSubmittedByWorkers) {
+  WorkStealingExecutor executor(4);
+  executor.Submit(boost::bind(&WorkStealingExecutorTest::SpawningTask, this,
+                              &executor, 10));
+  // Wait for the task tree to finish before shutting down, since workers
+  // must not submit to an executor that has been shut down.
+  while (num_run_ < (1ULL << 11) - 1)
+    boost::this_thread::yield();
+  executor.Shutdown();
+  EXPECT_EQ(num_run_, (1ULL << 11) - 1);
+}
+
+// Tests that tasks with the same key run in dispatch order.
+TEST_F(WorkStealingExecutorTest, DispatchPreservesPerKeyOrder) {
+  WorkStealingExecutor executor(4);
+  KeyedDispatcher dispatcher(&executor, 8);
+  for (uint32_t i = 0; i < kTasksPerKey; ++i) {
+    for (uint32_t key = 0; key < kNumKeys; ++key) {
+      dispatcher.Dispatch(key, boost::bind(
+          &WorkStealingExecutorTest::KeyedTask, this, key, i));
+    }
+  }
+  executor.Shutdown();
+  EXPECT_EQ(num_run_, kNumKeys * kTasksPerKey);
+  EXPECT_EQ(num_out_of_order_, 0ULL);
+}
+
+// Tests that sequenced tasks run in dispatch order.
+TEST_F(WorkStealingExecutorTest, DispatchSequencedPreservesOrder) {
+  WorkStealingExecutor executor(4);
+  KeyedDispatcher dispatcher(&executor, 8);
+  for (uint32_t i = 0; i < kTasksPerKey; ++i) {
+    dispatcher.DispatchSequenced(boost::bind(
+        &WorkStealingExecutorTest::KeyedTask, this, 0, i));
+  }
+  executor.Shutdown();
+  EXPECT_EQ(num_run_, kTasksPerKey);
+  EXPECT_EQ(num_out_of_order_, 0ULL);
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -42,11 +42,12 @@ namespace streamsockets {
 
 AsyncTCPServer::AsyncTCPServer(
     const string& endpoint_addr, const string& port,
-    AcceptHandler::type accept_callback)
+    AcceptHandler::type accept_callback, uint32_t num_io_threads)
     : listening_(false),
         listening_interface_(""),
       accept_handler_(accept_callback),
-      io_service_(new boost::asio::io_service),
+      io_service_pool_(new IOServicePool(num_io_threads)),
+      io_service_(io_service_pool_->GetIOService()),
       acceptor_(*io_service_) {
   VLOG(2) << "AsyncTCPServer starting!";
   tcp::resolver resolver(*io_service_);
@@ -65,7 +66,8 @@ AsyncTCPServer::AsyncTCPServer(
   listening_interface_ = "tcp:" + endp.address().to_string() + ":"
       + boost::lexical_cast<string>(endp.port());
 
-  VLOG(1) << "Async TCP server listening on: " << listening_interface_;
+  VLOG(1) << "Async TCP server listening on: " << listening_interface_
+          << ", using " << num_io_threads << " IO threads";
 
   StartAccept();
 }
@@ -73,7 +75,8 @@ AsyncTCPServer::AsyncTCPServer(
 void AsyncTCPServer::StartAccept() {
   VLOG(2) << "In StartAccept()";
   shared_ptr<tcp::endpoint> remote_endpoint(new tcp::endpoint());
-  TCPConnection::connection_ptr new_connection(new TCPConnection(io_service_));
+  TCPConnection::connection_ptr new_connection(
+      new TCPConnection(io_service_pool_->GetIOService()));
   acceptor_.async_accept(*new_connection->socket(),
                          *remote_endpoint,
                          boost::bind(&AsyncTCPServer::HandleAccept,
@@ -85,20 +88,20 @@ void AsyncTCPServer::StartAccept() {
 }
 
 void AsyncTCPServer::DropConnectionForEndpoint(const string& remote_endpoint) {
+  boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
   endpoint_connection_map_.erase(remote_endpoint);
 }
 
+void AsyncTCPServer::Post(boost::function<void()> handler) {
+  io_service_->post(handler);
+}
+
 void AsyncTCPServer::Run() {
   // TODO(malte): Figure out if we need to reset the io_service itself here,
   // given that it may have been stopped beforehand.
-  VLOG(2) << "Creating IO service thread";
-  io_service_work_.reset(new boost::asio::io_service::work(*io_service_));
-  thread_.reset(new boost::thread(
-      boost::bind(&boost::asio::io_service::run, io_service_.get())));
-  // Wait for thread to exit
-  VLOG(2) << "IO service thread (" << thread_->get_id()
-          << ") running -- Waiting for join...";
-  thread_->join();
+  VLOG(2) << "Creating " << io_service_pool_->size() << " IO service threads";
+  // Blocks until all IO service threads have exited
+  io_service_pool_->Run();
   VLOG(2) << "IO service terminated; TCP server's Run() method returning...";
 }
 
@@ -114,6 +117,7 @@ void AsyncTCPServer::Stop() {
     return;
 
   listening_ = false;
+  boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
   VLOG(2) << "Terminating " << endpoint_connection_map_.size()
           << " active TCP connections.";
   // This check around the close() call is necessary because ASIO does NOT
@@ -128,12 +132,9 @@ void AsyncTCPServer::Stop() {
        ++c_iter) {
     c_iter->second->Close();
   }
-  if (io_service_) {
-    io_service_work_.reset();
-    VLOG(2) << "Calling io_service.stop() from thread "
-            << boost::this_thread::get_id();
-    io_service_->stop();
-  }
+  VLOG(2) << "Stopping IO services from thread "
+          << boost::this_thread::get_id();
+  io_service_pool_->Stop();
 }
 
 void AsyncTCPServer::HandleAccept(TCPConnection::connection_ptr connection,
@@ -145,10 +146,14 @@ void AsyncTCPServer::HandleAccept(TCPConnection::connection_ptr connection,
     connection->Start(remote_endpoint);
     // Get string version of remote endpoint
     string remote_ept_str = EndpointToString(*remote_endpoint);
-    // Check we do not already have a connection for this endpoint
-    CHECK(!endpoint_connection_map_.count(remote_ept_str));
-    // Record a mapping for the connection's endpoint
-    InsertIfNotPresent(&endpoint_connection_map_, remote_ept_str, connection);
+    {
+      boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
+      // Check we do not already have a connection for this endpoint
+      CHECK(!endpoint_connection_map_.count(remote_ept_str));
+      // Record a mapping for the connection's endpoint
+      InsertIfNotPresent(&endpoint_connection_map_, remote_ept_str,
+                         connection);
+    }
     // Once the connection is up, we invoke the callback to notify the messaging
     // adapter (which will wrap the connection into a channel).
     VLOG(2) << "Invoking accept handler...";
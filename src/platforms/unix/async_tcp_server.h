@@ -30,6 +30,7 @@
 #include <map>
 
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/thread.hpp>
 
@@ -37,25 +38,42 @@
 #include "misc/uri_tools.h"
 #include "platforms/common.h"
 #include "platforms/unix/common.h"
+#include "platforms/unix/io_service_pool.h"
 #include "platforms/unix/tcp_connection.h"
 
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
 
-// Asynchronous, multi-threaded TCP server.
+// Asynchronous, multi-threaded TCP server. Accepted connections are spread
+// round-robin over a pool of IO services, each run by its own thread.
 // Design inspired by
 // http://www.boost.org/doc/html/boost_asio/example/http/server3/server.hpp.
 class AsyncTCPServer : public boost::enable_shared_from_this<AsyncTCPServer>,
   private boost::noncopyable {
  public:
+  /**
+   * @param endpoint_addr the address to listen on
+   * @param port the port to listen on; an empty string picks any free port
+   * @param accept_callback called with each newly accepted connection
+   * @param num_io_threads the number of IO services (and threads) serving
+   * connections
+   */
   AsyncTCPServer(const string& endpoint_addr, const string& port,
-                 AcceptHandler::type accept_callback);
+                 AcceptHandler::type accept_callback,
+                 uint32_t num_io_threads = 1);
   ~AsyncTCPServer();
   void DropConnectionForEndpoint(const string& remote_endpoint);
+  /**
+   * Runs a handler on the IO service that runs the acceptor. With a single IO
+   * thread, this is the thread on which all messages are received.
+   * @param handler the handler to run
+   */
+  void Post(boost::function<void()> handler);
   void Run();
   void Stop();
   TCPConnection::connection_ptr connection(const string& endpoint) {
+    boost::lock_guard<boost::mutex> lock(endpoint_connection_map_mutex_);
     CHECK_EQ(endpoint_connection_map_.count(endpoint), 1);
     return endpoint_connection_map_[endpoint];
   }
@@ -70,9 +88,11 @@ class AsyncTCPServer : public boost::enable_shared_from_this<AsyncTCPServer>,
                     shared_ptr<tcp::endpoint> remote_endpoint);
 
   unordered_map<string, TCPConnection::connection_ptr> endpoint_connection_map_;
+  // Connections are dropped from IO service threads other than the acceptor's.
+  boost::mutex endpoint_connection_map_mutex_;
   AcceptHandler::type accept_handler_;
-  scoped_ptr<boost::thread> thread_;
-  scoped_ptr<boost::asio::io_service::work> io_service_work_;
+  scoped_ptr<IOServicePool> io_service_pool_;
+  // The IO service running the acceptor; this is one of the pool's.
   shared_ptr<boost::asio::io_service> io_service_;
   tcp::acceptor acceptor_;
 };
@@ -0,0 +1,82 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Implementation of the IO service pool.
+
+#include "platforms/unix/io_service_pool.h"
+
+#include <boost/bind.hpp>
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+IOServicePool::IOServicePool(uint32_t pool_size)
+  : next_io_service_(0) {
+  CHECK_GT(pool_size, 0);
+  for (uint32_t i = 0; i < pool_size; ++i) {
+    shared_ptr<boost::asio::io_service> io_service(
+        new boost::asio::io_service);
+    io_services_.push_back(io_service);
+    // Keep the IO service running even when it has no outstanding work.
+    work_.push_back(shared_ptr<boost::asio::io_service::work>(
+        new boost::asio::io_service::work(*io_service)));
+  }
+}
+
+IOServicePool::~IOServicePool() {
+  Stop();
+}
+
+shared_ptr<boost::asio::io_service> IOServicePool::GetIOService() {
+  boost::lock_guard<boost::mutex> lock(next_io_service_lock_);
+  shared_ptr<boost::asio::io_service> io_service =
+    io_services_[next_io_service_];
+  next_io_service_ = (next_io_service_ + 1) % io_services_.size();
+  return io_service;
+}
+
+void IOServicePool::Run() {
+  boost::thread_group threads;
+  for (vector<shared_ptr<boost::asio::io_service> >::iterator it =
+         io_services_.begin();
+       it != io_services_.end();
+       ++it) {
+    boost::thread* thread = threads.create_thread(
+        boost::bind(&boost::asio::io_service::run, it->get()));
+    VLOG(2) << "Created IO service thread " << thread->get_id();
+  }
+  threads.join_all();
+  VLOG(2) << "All " << io_services_.size() << " IO service threads terminated";
+}
+
+void IOServicePool::Stop() {
+  work_.clear();
+  for (vector<shared_ptr<boost::asio::io_service> >::iterator it =
+         io_services_.begin();
+       it != io_services_.end();
+       ++it) {
+    (*it)->stop();
+  }
+}
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
@@ -0,0 +1,79 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Pool of IO services, each run by its own thread.
+
+#ifndef FIRMAMENT_PLATFORMS_UNIX_IO_SERVICE_POOL_H
+#define FIRMAMENT_PLATFORMS_UNIX_IO_SERVICE_POOL_H
+
+#include <boost/asio.hpp>
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "base/common.h"
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+// A fixed-size pool of IO services, each of which is run by a single thread.
+// Connections are spread across the IO services, so that their handlers run
+// in parallel, while all handlers for a given connection still run on the
+// same thread.
+// Design inspired by
+// http://www.boost.org/doc/html/boost_asio/example/http/server2/.
+class IOServicePool : private boost::noncopyable {
+ public:
+  /**
+   * @param pool_size the number of IO services (and threads) in the pool
+   */
+  explicit IOServicePool(uint32_t pool_size);
+  ~IOServicePool();
+  /**
+   * Returns the next IO service to use, picking IO services round-robin.
+   */
+  shared_ptr<boost::asio::io_service> GetIOService();
+  /**
+   * Runs all IO services in the pool and blocks until they have stopped.
+   */
+  void Run();
+  /**
+   * Stops all IO services in the pool.
+   */
+  void Stop();
+  uint32_t size() const {
+    return io_services_.size();
+  }
+
+ private:
+  vector<shared_ptr<boost::asio::io_service> > io_services_;
+  vector<shared_ptr<boost::asio::io_service::work> > work_;
+  boost::mutex next_io_service_lock_;
+  uint32_t next_io_service_;
+};
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
+
+#endif  // FIRMAMENT_PLATFORMS_UNIX_IO_SERVICE_POOL_H
@@ -26,6 +26,7 @@
 #include <sys/sysinfo.h>
 
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,19 @@ namespace firmament {
 namespace platform_unix {
 
 ProcFSMachine::ProcFSMachine() {
+  CHECK(proc_stat_.Open("/proc/stat"));
+  CHECK(meminfo_.Open("/proc/meminfo"));
+  // The block device and network interface may not exist, in which case
+  // their statistics are reported as zero.
+  string blockdev_stat_path;
+  spf(&blockdev_stat_path, "/sys/class/block/%s/stat",
+      FLAGS_monitor_blockdev.c_str());
+  blockdev_stat_.Open(blockdev_stat_path);
+  string interface_path;
+  spf(&interface_path, "/sys/class/net/%s/statistics/",
+      FLAGS_monitor_netif.c_str());
+  net_tx_bytes_.Open(interface_path + "tx_bytes");
+  net_rx_bytes_.Open(interface_path + "rx_bytes");
   cpu_stats_ = GetCPUStats();
   disk_stats_ = GetDiskStats();
   net_stats_ = GetNetworkStats();
@@ -95,25 +109,32 @@ const ResourceStats* ProcFSMachine::CreateStatistics(ResourceStats* stats) {
 }
 
 vector<CPUStatistics_t> ProcFSMachine::GetCPUStats() {
-  FILE* proc_stat = fopen("/proc/stat", "r");
   vector<CPUStatistics_t> cpus_now;
-  CPUStatistics_t cpu_now;
-  int proc_stat_cpu;
-  CHECK_NOTNULL(proc_stat);
-
-  for (int cpu_num = -1; ; cpu_num++) {
-    string read_expr;
-    if (cpu_num >= 0) {
-      read_expr = "cpu" + to_string(cpu_num) + " %lld %lld %lld %lld %lld " +
-           "%lld %lld %lld %lld %lld\n";
-    } else {
-      read_expr = "cpu %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n";
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  CHECK(proc_stat_.Read());
+  // The aggregate "cpu" line comes first, followed by one "cpuN" line per
+  // core; the CPU lines are followed by other statistics.
+  ProcFSTokenizer tokenizer(proc_stat_);
+  do {
+    const char* label;
+    size_t label_len;
+    if (!tokenizer.NextToken(&label, &label_len) || label_len < 3 ||
+        strncmp(label, "cpu", 3) != 0) {
+      break;
+    }
+    CPUStatistics_t cpu_now;
+    bzero(&cpu_now, sizeof(CPUStatistics_t));
+    uint64_t* fields[] = {
+      &cpu_now.user, &cpu_now.nice, &cpu_now.system, &cpu_now.idle,
+      &cpu_now.iowait, &cpu_now.irq, &cpu_now.soft_irq, &cpu_now.steal,
+      &cpu_now.guest, &cpu_now.guest_nice,
+    };
+    uint32_t num_fields = 0;
+    while (num_fields < sizeof(fields) / sizeof(uint64_t*) &&
+           tokenizer.NextUint64(fields[num_fields])) {
+      ++num_fields;
     }
-    proc_stat_cpu = fscanf(proc_stat, read_expr.c_str(),
-        &cpu_now.user, &cpu_now.nice, &cpu_now.system, &cpu_now.idle,
-        &cpu_now.iowait, &cpu_now.irq, &cpu_now.soft_irq, &cpu_now.steal,
-        &cpu_now.guest, &cpu_now.guest_nice);
-    if (proc_stat_cpu != 10) {
+    if (num_fields != sizeof(fields) / sizeof(uint64_t*)) {
       break;
     }
     cpu_now.total = cpu_now.user + cpu_now.nice + cpu_now.system +
@@ -121,8 +142,7 @@ vector<CPUStatistics_t> ProcFSMachine::GetCPUStats() {
         cpu_now.steal + cpu_now.guest + cpu_now.guest_nice;
     cpu_now.systime = time(NULL);
     cpus_now.push_back(cpu_now);
-  }
-  CHECK_EQ(fclose(proc_stat), 0);
+  } while (tokenizer.NextLine());
   return cpus_now;
 }
 
@@ -156,14 +176,11 @@ DiskStatistics_t ProcFSMachine::GetDiskStats() {
   // /sys/block/<dev> or 'mount'.
   DiskStatistics_t disk_stats;
   bzero(&disk_stats, sizeof(DiskStatistics_t));
-  string dev_path;
-  spf(&dev_path, "/sys/class/block/%s/",
-      FLAGS_monitor_blockdev.c_str());
-  FILE* blockdev_stat_fd = fopen((dev_path + "/stat").c_str(), "r");
-  if (blockdev_stat_fd) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  if (blockdev_stat_.Read()) {
+    ProcFSTokenizer tokenizer(blockdev_stat_);
     uint64_t tmp_value;
-    for (uint64_t i = 0; i < 11; i++) {
-      CHECK_EQ(readunsigned(blockdev_stat_fd, &tmp_value), 0);
+    for (uint64_t i = 0; i < 7 && tokenizer.NextUint64(&tmp_value); i++) {
       if (i == 2)
         // read sector count
         disk_stats.read = tmp_value * 512;
@@ -171,7 +188,6 @@ DiskStatistics_t ProcFSMachine::GetDiskStats() {
         // write sector count
         disk_stats.write = tmp_value * 512;
     }
-    CHECK_EQ(fclose(blockdev_stat_fd), 0);
   }
   return disk_stats;
 }
@@ -230,27 +246,29 @@ void ProcFSMachine::GetMachineCapacity(ResourceVector* cap) {
 
 MemoryStatistics_t ProcFSMachine::GetMemoryStats() {
   MemoryStatistics_t mem_stats;
-  FILE* mem_stat_fd = fopen("/proc/meminfo", "r");
-  CHECK_NOTNULL(mem_stat_fd);
-  while (!feof(mem_stat_fd)) {
-    char label[100];
+  bzero(&mem_stats, sizeof(MemoryStatistics_t));
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  CHECK(meminfo_.Read());
+  ProcFSTokenizer tokenizer(meminfo_);
+  do {
+    const char* label;
+    size_t label_len;
     uint64_t val = 0;
     // Ignore invalid lines
-    if (fscanf(mem_stat_fd, "%s", label) <= 0)
+    if (!tokenizer.NextToken(&label, &label_len) ||
+        !tokenizer.NextUint64(&val))
       continue;
-    if (fscanf(mem_stat_fd, "%ju", &val) <= 0)
-      continue;
-    if (strncmp(label, "MemTotal:", 100) == 0) {
+    string label_str(label, label_len);
+    if (label_str == "MemTotal:") {
       mem_stats.mem_total = val * 1024;
-    } else if (strncmp(label, "MemFree:", 100) == 0) {
+    } else if (label_str == "MemFree:") {
       mem_stats.mem_free = val * 1024;
-    } else if (strncmp(label, "Buffers:", 100) == 0) {
+    } else if (label_str == "Buffers:") {
       mem_stats.mem_buffers = val * 1024;
-    } else if (strncmp(label, "Cached:", 100) == 0) {
+    } else if (label_str == "Cached:") {
       mem_stats.mem_pagecache = val * 1024;
     }
-  }
-  CHECK_EQ(fclose(mem_stat_fd), 0);
+  } while (tokenizer.NextLine());
   return mem_stats;
 }
 
@@ -261,21 +279,16 @@ NetworkStatistics_t ProcFSMachine::GetNetworkStats() {
   // /proc/net/dev.
   NetworkStatistics_t net_stats;
   bzero(&net_stats, sizeof(NetworkStatistics_t));
-  string interface_path;
-  spf(&interface_path, "/sys/class/net/%s/statistics/",
-      FLAGS_monitor_netif.c_str());
-
+  boost::lock_guard<boost::mutex> lock(files_mut_);
   // Send
-  FILE* tx_stat_fd = fopen((interface_path + "/tx_bytes").c_str(), "r");
-  if (tx_stat_fd) {
-    CHECK_EQ(readunsigned(tx_stat_fd, &net_stats.send), 0);
-    CHECK_EQ(fclose(tx_stat_fd), 0);
+  if (net_tx_bytes_.Read()) {
+    ProcFSTokenizer tokenizer(net_tx_bytes_);
+    tokenizer.NextUint64(&net_stats.send);
   }
   // Recv
-  FILE* rx_stat_fd = fopen((interface_path + "/rx_bytes").c_str(), "r");
-  if (rx_stat_fd) {
-    CHECK_EQ(readunsigned(rx_stat_fd, &net_stats.recv), 0);
-    CHECK_EQ(fclose(rx_stat_fd), 0);
+  if (net_rx_bytes_.Read()) {
+    ProcFSTokenizer tokenizer(net_rx_bytes_);
+    tokenizer.NextUint64(&net_stats.recv);
   }
   return net_stats;
 }
@@ -25,8 +25,11 @@
 
 #include <vector>
 
+#include <boost/thread/mutex.hpp>
+
 #include "base/resource_stats.pb.h"
 #include "platforms/unix/common.h"
+#include "platforms/unix/procfs_reader.h"
 
 namespace firmament {
 namespace platform_unix {
@@ -82,6 +85,15 @@ class ProcFSMachine {
     return errno;
 }
 
+  // Files sampled on every call to CreateStatistics, kept open between
+  // samples and guarded by files_mut_.
+  boost::mutex files_mut_;
+  ProcFSFile proc_stat_;
+  ProcFSFile meminfo_;
+  ProcFSFile blockdev_stat_;
+  ProcFSFile net_tx_bytes_;
+  ProcFSFile net_rx_bytes_;
+
   vector<CPUStatistics_t> cpu_stats_;
   DiskStatistics_t disk_stats_;
   NetworkStatistics_t net_stats_;
@@ -22,198 +22,224 @@
 
 #include "platforms/unix/procfs_monitor.h"
 
-#include <stdio.h>
+#include <string.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
-#include <boost/regex.hpp>
+#include "misc/map-util.h"
 
 namespace firmament {
 namespace platform_unix {
 
 ProcFSMonitor::ProcFSMonitor(uint64_t polling_frequency)
-  : polling_frequency_(polling_frequency) {
+  : polling_frequency_(polling_frequency), pass_(0) {
   ticks_per_sec_ = sysconf(_SC_CLK_TCK);
   page_size_ = getpagesize();
 }
 
-void ProcFSMonitor::AddSchedStatsForPID(pid_t pid, ProcessStatistics_t* stats) {
+ProcFSMonitor::~ProcFSMonitor() {
+  for (unordered_map<pid_t, PIDFiles*>::iterator it = pid_files_.begin();
+       it != pid_files_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+void ProcFSMonitor::AddSchedStatsForPID(pid_t pid, PIDFiles* files,
+                                        ProcessStatistics_t* stats) {
   // /proc/[pid]/schedstat parsing
-  string filename = "/proc/" + to_string(pid) + "/schedstat";
-  FILE* input = fopen(filename.c_str(), "r");
   // The procfs file may no longer be there if the process has finished
-  if (!input)
+  if (!ReadPIDFile(pid, "schedstat", &files->schedstat))
     return;
+  ProcFSTokenizer tokenizer(files->schedstat);
   uint64_t tmp;
-  readunsigned(input, &tmp);
-  stats->sched_run_ticks += tmp;
-  readunsigned(input, &tmp);
-  stats->sched_wait_runnable_ticks += tmp;
-  readunsigned(input, &tmp);
-  stats->sched_run_timeslices += tmp;
-  CHECK_EQ(fclose(input), 0);
-}
-
-void ProcFSMonitor::AddStatsForPID(pid_t pid, ProcessStatistics_t* stats) {
-  // /proc/[pid]/stat parsing
-  string filename = "/proc/" + to_string(pid) + "/stat";
-  FILE* input = fopen(filename.c_str(), "r");
-  // The procfs file may no longer be there if the process has finished
-  if (!input)
+  if (tokenizer.NextUint64(&tmp))
+    stats->sched_run_ticks += tmp;
+  if (tokenizer.NextUint64(&tmp))
+    stats->sched_wait_runnable_ticks += tmp;
+  if (tokenizer.NextUint64(&tmp))
+    stats->sched_run_timeslices += tmp;
+}
+
+void ProcFSMonitor::AddStatsForPID(pid_t pid, PIDFiles* files,
+                                   ProcessStatistics_t* stats) {
+  // /proc/[pid]/stat parsing; the file has already been read by the caller.
+  ProcFSTokenizer tokenizer(files->stat);
+  // Skip the PID and the command name, which may contain spaces, then the
+  // state, ppid, pgrp, session, tty_nr, tpgid and flags fields.
+  if (!tokenizer.SkipPastLast(')') || !tokenizer.SkipTokens(7))
     return;
+  uint64_t* summed_fields[] = {
+    &stats->minflt, &stats->cminflt, &stats->majflt, &stats->cmajflt,
+    &stats->utime, &stats->stime, &stats->cutime, &stats->cstime,
+  };
   uint64_t tmp;
-  char tmp_str[PATH_MAX];
-  readone(input, &tmp);  // skip
-  readstr(input, tmp_str);  // skip
-  readchar(input, &tmp_str[0]);  // skip
-  skip(input, sizeof(uint64_t) * 6);
-  readone(input, &tmp);
-  stats->minflt += tmp;
-  readone(input, &tmp);
-  stats->cminflt += tmp;
-  readone(input, &tmp);
-  stats->majflt += tmp;
-  readone(input, &tmp);
-  stats->cmajflt += tmp;
-  readone(input, &tmp);
-  stats->utime += tmp;
-  readone(input, &tmp);
-  stats->stime += tmp;
-  readone(input, &tmp);
-  stats->cutime += tmp;
-  readone(input, &tmp);
-  stats->cstime += tmp;
-  readone(input, &tmp);
+  for (uint32_t i = 0; i < sizeof(summed_fields) / sizeof(uint64_t*); ++i) {
+    if (!tokenizer.NextUint64(&tmp))
+      return;
+    *summed_fields[i] += tmp;
+  }
+  // Skip priority and nice.
+  if (!tokenizer.SkipTokens(2) || !tokenizer.NextUint64(&tmp))
+    return;
   stats->num_threads += tmp;
-  readone(input, &tmp);  // skip
-  readunsigned(input, &tmp);  // skip
-  readone(input, &tmp);
-  stats->vsize += tmp;
-  readone(input, &tmp);
-  stats->rss += tmp;
-  readone(input, &tmp);
-  stats->rsslim += tmp;
-  skip(input, sizeof(uint64_t) * 16);  // skip remaining 16 fields
-  CHECK_EQ(fclose(input), 0);
-}
-
-void ProcFSMonitor::AggregateStatsForPIDTree(
+  // Skip itrealvalue and starttime.
+  if (!tokenizer.SkipTokens(2))
+    return;
+  if (tokenizer.NextUint64(&tmp))
+    stats->vsize += tmp;
+  if (tokenizer.NextUint64(&tmp))
+    stats->rss += tmp;
+  if (tokenizer.NextUint64(&tmp))
+    stats->rsslim += tmp;
+}
+
+bool ProcFSMonitor::AggregateStatsForPIDTree(
     pid_t pid,
     bool root,
     ProcessStatistics_t* stats) {
   VLOG(1) << "Adding stats for PID " << pid;
+  PIDFiles* files = FilesForPID(pid);
+  // The procfs files may no longer be there if the process has finished
+  if (!files || !ReadPIDFile(pid, "stat", &files->stat))
+    return false;
   // Grab information from /proc/[pid]/stat
   if (root)
-    GetStatsForPID(pid, stats);
+    GetStatsForPID(files, stats);
   else
-    AddStatsForPID(pid, stats);
+    AddStatsForPID(pid, files, stats);
   // Grab information from /proc/[pid]/schedstat
-  AddSchedStatsForPID(pid, stats);
+  AddSchedStatsForPID(pid, files, stats);
   // Now also aggregate from children
-  string filename = "/proc/" + to_string(pid) + "/task/" + to_string(pid)
-                    + "/children";
-  FILE* chld_input = fopen(filename.c_str(), "r");
-  if (!chld_input)
-    return;
+  if (!ReadPIDFile(pid, "children", &files->children))
+    return true;
   vector<uint64_t> children;
+  ProcFSTokenizer tokenizer(files->children);
   uint64_t tmp;
-  while (fscanf(chld_input, "%ju ", &tmp) > 0) {
+  while (tokenizer.NextUint64(&tmp)) {
     VLOG(1) << "Found child " << tmp << " for " << pid;
     children.push_back(tmp);
   }
-  CHECK_EQ(fclose(chld_input), 0);
   for (uint64_t i = 0; i < children.size(); i++)
     AggregateStatsForPIDTree(children[i], false, stats);
+  return true;
 }
 
-void ProcFSMonitor::GetStatsForPID(pid_t pid, ProcessStatistics_t* stats) {
-  // /proc/[pid]/stat parsing
-  string filename = "/proc/" + to_string(pid) + "/stat";
-  FILE* input = fopen(filename.c_str(), "r");
-  // The procfs file may no longer be there if the process has finished
-  if (!input)
+ProcFSMonitor::PIDFiles* ProcFSMonitor::FilesForPID(pid_t pid) {
+  PIDFiles* files = FindPtrOrNull(pid_files_, pid);
+  if (!files) {
+    files = new PIDFiles;
+    CHECK(InsertIfNotPresent(&pid_files_, pid, files));
+  }
+  files->last_pass = pass_;
+  return files;
+}
+
+void ProcFSMonitor::GetStatsForPID(PIDFiles* files,
+                                   ProcessStatistics_t* stats) {
+  // /proc/[pid]/stat parsing; the file has already been read by the caller.
+  ProcFSTokenizer tokenizer(files->stat);
+  if (!tokenizer.NextUint64(&stats->pid))
     return;
-  readone(input, &stats->pid);
-  readstr(input, stats->comm);
-  readchar(input, &stats->state);
-  readone(input, &stats->ppid);
-  readone(input, &stats->pgid);
-  readone(input, &stats->sid);
-  readone(input, &stats->tty_nr);
-  readone(input, &stats->tpgid);
-  readone(input, &stats->flags);
-  readone(input, &stats->minflt);
-  readone(input, &stats->cminflt);
-  readone(input, &stats->majflt);
-  readone(input, &stats->cmajflt);
-  readone(input, &stats->utime);
-  readone(input, &stats->stime);
-  readone(input, &stats->cutime);
-  readone(input, &stats->cstime);
-  readone(input, &stats->priority);
-  readone(input, &stats->nice);
-  readone(input, &stats->num_threads);
-  readone(input, &stats->zero1);  // skip unmaintained itrealvalue field
-  readunsigned(input, &stats->starttime);
-  readone(input, &stats->vsize);
-  readone(input, &stats->rss);
-  readone(input, &stats->rsslim);
-  readone(input, &stats->startcode);
-  readone(input, &stats->endcode);
-  readone(input, &stats->startstack);
-  readone(input, &stats->esp);
-  readone(input, &stats->eip);
-  readone(input, &stats->pending);
-  readone(input, &stats->blocked);
-  readone(input, &stats->sigign);
-  readone(input, &stats->sigcatch);
-  readone(input, &stats->wchan);
-  readone(input, &stats->zero1);  // skip unmaintained nswap field
-  readone(input, &stats->zero2);  // skip unmaintained cnswap field
-  readone(input, &stats->exit_signal);
-  readone(input, &stats->cpu);
-  readone(input, &stats->rt_priority);
-  readone(input, &stats->policy);
-  CHECK_EQ(fclose(input), 0);
-}
-
-vector<string>* ProcFSMonitor::FindMatchingLine(
-    const string& regexp, const string& data) {
-  boost::regex e(regexp);
-  boost::smatch m;
-  // Magic
-  if (boost::regex_match(data, m, e, boost::match_extra)) {
-    // Found a line
-    vector<string>* matches = new vector<string>(m.size());
-    for (boost::smatch::const_iterator m_iter = m.begin();
-         m_iter != m.end();
-           ++m_iter)
-        matches->push_back(*m_iter);
-    return matches;
-  } else {
-    // No match
-    return NULL;
+  // The command name is enclosed in parentheses and may itself contain
+  // spaces and parentheses, so it extends to the last closing parenthesis.
+  const char* comm_start = strchr(files->stat.data(), '(');
+  const char* comm_end = strrchr(files->stat.data(), ')');
+  if (!comm_start || !comm_end || comm_end < comm_start)
+    return;
+  size_t comm_len = min(static_cast<size_t>(comm_end - comm_start + 1),
+                        sizeof(stats->comm) - 1);
+  memcpy(stats->comm, comm_start, comm_len);
+  stats->comm[comm_len] = '\0';
+  tokenizer.SkipPastLast(')');
+  const char* state;
+  size_t state_len;
+  if (!tokenizer.NextToken(&state, &state_len))
+    return;
+  stats->state = state[0];
+  uint64_t* fields[] = {
+    &stats->ppid, &stats->pgid, &stats->sid, &stats->tty_nr, &stats->tpgid,
+    &stats->flags, &stats->minflt, &stats->cminflt, &stats->majflt,
+    &stats->cmajflt, &stats->utime, &stats->stime, &stats->cutime,
+    &stats->cstime, &stats->priority, &stats->nice, &stats->num_threads,
+    &stats->zero1,  // skip unmaintained itrealvalue field
+    &stats->starttime, &stats->vsize, &stats->rss, &stats->rsslim,
+    &stats->startcode, &stats->endcode, &stats->startstack, &stats->esp,
+    &stats->eip, &stats->pending, &stats->blocked, &stats->sigign,
+    &stats->sigcatch, &stats->wchan,
+    &stats->zero1,  // skip unmaintained nswap field
+    &stats->zero2,  // skip unmaintained cnswap field
+    &stats->exit_signal, &stats->cpu, &stats->rt_priority, &stats->policy,
+  };
+  for (uint32_t i = 0; i < sizeof(fields) / sizeof(uint64_t*); ++i) {
+    if (!tokenizer.NextUint64(fields[i]))
+      return;
   }
 }
 
+bool ProcFSMonitor::LatestProcessInformation(pid_t pid,
+                                             ProcessStatistics_t* stats) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  ProcessStatistics_t* latest = FindOrNull(latest_stats_, pid);
+  if (!latest)
+    return false;
+  *stats = *latest;
+  return true;
+}
+
 const ProcFSMonitor::ProcessStatistics_t* ProcFSMonitor::ProcessInformation(
     pid_t pid, ProcessStatistics_t* stats) {
   if (stats == NULL) {
     stats = new ProcessStatistics_t;
     bzero(stats, sizeof(ProcessStatistics_t));
   }
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  ++pass_;
   // Grab information recursively for PID and its children
   AggregateStatsForPIDTree(pid, true, stats);
+  PruneFiles();
   return stats;
 }
 
+void ProcFSMonitor::PruneFiles() {
+  for (unordered_map<pid_t, PIDFiles*>::iterator it = pid_files_.begin();
+       it != pid_files_.end();) {
+    if (it->second->last_pass != pass_) {
+      delete it->second;
+      it = pid_files_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool ProcFSMonitor::ReadPIDFile(pid_t pid, const char* name,
+                                ProcFSFile* file) {
+  if (file->is_open() && file->Read())
+    return true;
+  // Either the file has not been opened yet, or it belonged to a process
+  // that has exited and whose PID may since have been reused.
+  string filename;
+  if (strcmp(name, "children") == 0) {
+    filename = "/proc/" + to_string(pid) + "/task/" + to_string(pid) +
+               "/children";
+  } else {
+    filename = "/proc/" + to_string(pid) + "/" + name;
+  }
+  return file->Open(filename) && file->Read();
+}
+
 void ProcFSMonitor::Run() {
   // Keep going until we're told to stop
   boost::unique_lock<boost::mutex> lock(stop_mut_);
   while (!stop_.timed_wait(
       lock, boost::posix_time::microseconds(polling_frequency_))) {
     VLOG(2) << "ProcFSMonitor polling...";
+    unordered_map<pid_t, ProcessStatistics_t> samples;
+    SampleWatchedPIDs(&samples);
+    boost::lock_guard<boost::mutex> files_lock(files_mut_);
+    latest_stats_.swap(samples);
   }
   // Return -- this typically means the monitoring thread will exit.
 }
@@ -230,10 +256,35 @@ void ProcFSMonitor::RunForPID(pid_t pid) {
   // Return -- this typically means the monitoring thread will exit.
 }
 
+void ProcFSMonitor::SampleWatchedPIDs(
+    unordered_map<pid_t, ProcessStatistics_t>* samples) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  ++pass_;
+  for (unordered_set<pid_t>::const_iterator it = watched_pids_.begin();
+       it != watched_pids_.end(); ++it) {
+    ProcessStatistics_t stats;
+    bzero(&stats, sizeof(ProcessStatistics_t));
+    if (AggregateStatsForPIDTree(*it, true, &stats)) {
+      InsertOrUpdate(samples, *it, stats);
+    }
+  }
+  PruneFiles();
+}
 
 void ProcFSMonitor::Stop() {
   stop_.notify_all();
 }
 
+void ProcFSMonitor::UnwatchPID(pid_t pid) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  watched_pids_.erase(pid);
+  latest_stats_.erase(pid);
+}
+
+void ProcFSMonitor::WatchPID(pid_t pid) {
+  boost::lock_guard<boost::mutex> lock(files_mut_);
+  watched_pids_.insert(pid);
+}
+
 }  // namespace platform_unix
 }  // namespace firmament
@@ -24,6 +24,7 @@
 #define FIRMAMENT_PLATFORMS_UNIX_PROCFS_MONITOR_H
 
 #include "platforms/unix/common.h"
+#include "platforms/unix/procfs_reader.h"
 
 #include <stdio.h>
 
@@ -99,12 +100,40 @@ class ProcFSMonitor {
   typedef ProcessStatistics ProcessStatistics_t;
   typedef SystemStatistics SystemStatistics_t;
   explicit ProcFSMonitor(uint64_t polling_frequency);
+  ~ProcFSMonitor();
+  /**
+   * Aggregates the statistics of a process and all of its descendants.
+   * @param pid the root of the process tree
+   * @param stats the statistics to update, or NULL to allocate new ones
+   * @return the updated statistics
+   */
   const ProcessStatistics_t* ProcessInformation(pid_t pid,
       ProcessStatistics_t* stats);
+  /**
+   * Copies the statistics collected for a watched process in the most recent
+   * polling interval of Run().
+   * @param pid the watched process
+   * @param stats set to the process tree's statistics
+   * @return false if no statistics have been collected for the process
+   */
+  bool LatestProcessInformation(pid_t pid, ProcessStatistics_t* stats);
   void Run();
   void RunForPID(pid_t pid);
+  /**
+   * Samples all watched processes (and their descendants) in a single pass.
+   * Processes that have exited are omitted from the result.
+   * @param samples set to the statistics of each watched process
+   */
+  void SampleWatchedPIDs(
+      unordered_map<pid_t, ProcessStatistics_t>* samples);
   void Stop();
   const SystemStatistics_t SystemInformation();
+  /**
+   * Adds a process to the set that Run() samples every polling interval.
+   * @param pid the process to watch
+   */
+  void WatchPID(pid_t pid);
+  void UnwatchPID(pid_t pid);
 
   inline uint64_t ticks_per_sec() { return ticks_per_sec_; }
   inline uint32_t page_size() { return page_size_; }
@@ -114,30 +143,37 @@ class ProcFSMonitor {
   boost::mutex stop_mut_;
 
  private:
+  // The procfs files of a process, kept open between samples.
+  struct PIDFiles {
+    PIDFiles() : last_pass(0) {}
+    ProcFSFile stat;
+    ProcFSFile schedstat;
+    ProcFSFile children;
+    // The sampling pass in which the files were last read.
+    uint64_t last_pass;
+  };
+
   // The polling frequency, specified in microseconds
   uint64_t polling_frequency_;
   uint64_t ticks_per_sec_;
   uint32_t page_size_;
-  void AddStatsForPID(pid_t pid, ProcessStatistics_t* stats);
-  void AddSchedStatsForPID(pid_t pid, ProcessStatistics_t* stats);
-  void AggregateStatsForPIDTree(pid_t pid, bool root,
+  void AddStatsForPID(pid_t pid, PIDFiles* files, ProcessStatistics_t* stats);
+  void AddSchedStatsForPID(pid_t pid, PIDFiles* files,
+                           ProcessStatistics_t* stats);
+  bool AggregateStatsForPIDTree(pid_t pid, bool root,
                                 ProcessStatistics_t* stats);
-  // Find a line matching the regular expression provided
-  vector<string>* FindMatchingLine(const string& regexp, const string& data);
-  void GetStatsForPID(pid_t pid, ProcessStatistics_t* stats);
-  inline void readone(FILE* input, uint64_t *x) {
-    CHECK_EQ(fscanf(input, "%ju ", x), 1);
-  }
-  inline void readunsigned(FILE* input, uint64_t *x) {
-    CHECK_EQ(fscanf(input, "%ju ", x), 1);
-  }
-  inline void readstr(FILE* input, char *x) {
-    CHECK_EQ(fscanf(input, "%s ", x), 1);
-  }
-  inline void readchar(FILE* input, char *x) {
-    CHECK_EQ(fscanf(input, "%c ", x), 1);
-  }
-  inline void skip(FILE* input, int64_t num) {  fseek(input, num, SEEK_CUR); }
+  PIDFiles* FilesForPID(pid_t pid);
+  void GetStatsForPID(PIDFiles* files, ProcessStatistics_t* stats);
+  // Closes the files of processes that were not visited in the current pass.
+  void PruneFiles();
+  bool ReadPIDFile(pid_t pid, const char* name, ProcFSFile* file);
+
+  // Guards the members below.
+  boost::mutex files_mut_;
+  unordered_map<pid_t, PIDFiles*> pid_files_;
+  uint64_t pass_;
+  unordered_set<pid_t> watched_pids_;
+  unordered_map<pid_t, ProcessStatistics_t> latest_stats_;
 };
 
 }  // namespace platform_unix
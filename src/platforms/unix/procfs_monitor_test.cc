@@ -25,6 +25,7 @@
 #include <boost/thread.hpp>
 
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "base/common.h"
@@ -112,6 +113,57 @@ TEST_F(ProcFSMonitorTest, SchedStatsTest) {
            pfsm_.ProcessInformation(pid, NULL)->sched_run_ticks);
 }
 
+// Tests that watched processes are sampled in a single pass, and that
+// processes that have exited are dropped.
+TEST_F(ProcFSMonitorTest, WatchedPIDsTest) {
+  pid_t pid = getpid();
+  pid_t child_pid = fork();
+  CHECK_GE(child_pid, 0);
+  if (child_pid == 0) {
+    _exit(0);
+  }
+  CHECK_EQ(waitpid(child_pid, NULL, 0), child_pid);
+  pfsm_.WatchPID(pid);
+  pfsm_.WatchPID(child_pid);
+  unordered_map<pid_t, ProcFSMonitor::ProcessStatistics_t> samples;
+  pfsm_.SampleWatchedPIDs(&samples);
+  ASSERT_EQ(samples.size(), 1);
+  EXPECT_EQ(samples[pid].pid, pid);
+  EXPECT_GT(samples[pid].vsize, 0);
+  EXPECT_GT(samples[pid].num_threads, 0);
+  boost::thread t(&ProcFSMonitor::Run, &pfsm_);
+  usleep(300000);
+  pfsm_.Stop();
+  t.join();
+  ProcFSMonitor::ProcessStatistics_t stats;
+  EXPECT_TRUE(pfsm_.LatestProcessInformation(pid, &stats));
+  EXPECT_EQ(stats.pid, pid);
+  EXPECT_FALSE(pfsm_.LatestProcessInformation(child_pid, &stats));
+  pfsm_.UnwatchPID(pid);
+  EXPECT_FALSE(pfsm_.LatestProcessInformation(pid, &stats));
+}
+
+// Tests that sampling a process through its kept-open procfs files stops
+// returning statistics once the process has exited.
+TEST_F(ProcFSMonitorTest, ExitedProcessTest) {
+  pid_t child_pid = fork();
+  CHECK_GE(child_pid, 0);
+  if (child_pid == 0) {
+    pause();
+    _exit(0);
+  }
+  ProcFSMonitor::ProcessStatistics_t stats;
+  bzero(&stats, sizeof(stats));
+  pfsm_.ProcessInformation(child_pid, &stats);
+  EXPECT_EQ(stats.pid, child_pid);
+  EXPECT_GT(stats.num_threads, 0);
+  CHECK_EQ(kill(child_pid, SIGKILL), 0);
+  CHECK_EQ(waitpid(child_pid, NULL, 0), child_pid);
+  bzero(&stats, sizeof(stats));
+  pfsm_.ProcessInformation(child_pid, &stats);
+  EXPECT_EQ(stats.pid, 0);
+}
+
 
 }  // namespace platform_unix
 }  // namespace firmament
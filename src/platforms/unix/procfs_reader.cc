@@ -0,0 +1,156 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Low-overhead readers for procfs and sysfs files.
+
+#include "platforms/unix/procfs_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace firmament {
+namespace platform_unix {
+
+// Large enough for /proc/[pid]/stat and most sysfs files; the buffer grows
+// as needed for larger files such as /proc/stat on many-core machines.
+static const size_t kInitialBufferSize = 4096;
+
+ProcFSFile::ProcFSFile()
+  : fd_(-1), buffer_(kInitialBufferSize), size_(0) {
+  buffer_[0] = '\0';
+}
+
+ProcFSFile::~ProcFSFile() {
+  Close();
+}
+
+bool ProcFSFile::Open(const string& path) {
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  return fd_ >= 0;
+}
+
+void ProcFSFile::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  size_ = 0;
+  buffer_[0] = '\0';
+}
+
+bool ProcFSFile::Read() {
+  size_ = 0;
+  buffer_[0] = '\0';
+  if (fd_ < 0)
+    return false;
+  while (true) {
+    // Always leave room for the terminating NUL.
+    if (size_ + 1 >= buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    ssize_t bytes_read = pread(fd_, &buffer_[size_],
+                               buffer_.size() - size_ - 1, size_);
+    if (bytes_read < 0) {
+      if (errno == EINTR)
+        continue;
+      size_ = 0;
+      buffer_[0] = '\0';
+      return false;
+    }
+    if (bytes_read == 0)
+      break;
+    size_ += bytes_read;
+  }
+  buffer_[size_] = '\0';
+  return true;
+}
+
+void ProcFSTokenizer::SkipSpaces() {
+  while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t')) {
+    ++pos_;
+  }
+}
+
+bool ProcFSTokenizer::NextUint64(uint64_t* value) {
+  SkipSpaces();
+  bool negative = false;
+  if (pos_ < end_ && *pos_ == '-') {
+    negative = true;
+    ++pos_;
+  }
+  if (pos_ >= end_ || *pos_ < '0' || *pos_ > '9')
+    return false;
+  uint64_t result = 0;
+  while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') {
+    result = result * 10 + static_cast<uint64_t>(*pos_ - '0');
+    ++pos_;
+  }
+  *value = negative ? ~result + 1 : result;
+  return true;
+}
+
+bool ProcFSTokenizer::NextToken(const char** token, size_t* length) {
+  SkipSpaces();
+  const char* start = pos_;
+  while (pos_ < end_ && *pos_ != ' ' && *pos_ != '\t' && *pos_ != '\n') {
+    ++pos_;
+  }
+  *token = start;
+  *length = static_cast<size_t>(pos_ - start);
+  return *length > 0;
+}
+
+bool ProcFSTokenizer::SkipTokens(uint32_t num_tokens) {
+  const char* token;
+  size_t length;
+  for (uint32_t i = 0; i < num_tokens; ++i) {
+    if (!NextToken(&token, &length))
+      return false;
+  }
+  return true;
+}
+
+bool ProcFSTokenizer::SkipPastLast(char c) {
+  const char* last = NULL;
+  for (const char* p = pos_; p < end_; ++p) {
+    if (*p == c)
+      last = p;
+  }
+  if (last == NULL)
+    return false;
+  pos_ = last + 1;
+  return true;
+}
+
+bool ProcFSTokenizer::NextLine() {
+  while (pos_ < end_ && *pos_ != '\n') {
+    ++pos_;
+  }
+  if (pos_ >= end_)
+    return false;
+  ++pos_;
+  return pos_ < end_;
+}
+
+}  // namespace platform_unix
+}  // namespace firmament
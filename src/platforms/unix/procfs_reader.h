@@ -0,0 +1,125 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Low-overhead readers for procfs and sysfs files. Files are kept open and
+// re-read with pread(2) into a reusable buffer, and parsed by hand rather
+// than through stdio or regular expressions.
+
+#ifndef FIRMAMENT_PLATFORMS_UNIX_PROCFS_READER_H
+#define FIRMAMENT_PLATFORMS_UNIX_PROCFS_READER_H
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+
+namespace firmament {
+namespace platform_unix {
+
+class ProcFSFile {
+ public:
+  ProcFSFile();
+  ~ProcFSFile();
+
+  /**
+   * Opens a file, closing any file that was previously open.
+   * @param path the path of the file
+   * @return true if the file was opened
+   */
+  bool Open(const string& path);
+  void Close();
+  inline bool is_open() const { return fd_ >= 0; }
+
+  /**
+   * Reads the whole file from its start. procfs and sysfs regenerate the
+   * contents when read from offset zero, so this returns a fresh snapshot.
+   * The contents are NUL-terminated.
+   * @return true if the file was read; false if reading failed, e.g.
+   * because the process that the file describes has exited
+   */
+  bool Read();
+  inline const char* data() const { return &buffer_[0]; }
+  inline size_t size() const { return size_; }
+
+ private:
+  int fd_;
+  vector<char> buffer_;
+  size_t size_;
+};
+
+// Cursor over the contents of a procfs file.
+class ProcFSTokenizer {
+ public:
+  explicit ProcFSTokenizer(const ProcFSFile& file)
+    : pos_(file.data()), end_(file.data() + file.size()) {}
+  ProcFSTokenizer(const char* begin, const char* end)
+    : pos_(begin), end_(end) {}
+
+  inline bool AtEnd() const { return pos_ >= end_; }
+
+  /**
+   * Parses the next whitespace-separated number. A leading minus sign is
+   * accepted and the value is returned in two's complement, as for fscanf's
+   * "%ju" conversion.
+   * @param value set to the parsed number
+   * @return false if the next token on the current line is not a number
+   */
+  bool NextUint64(uint64_t* value);
+
+  /**
+   * Returns the next whitespace-separated token on the current line.
+   * @param token set to the start of the token
+   * @param length set to the length of the token
+   * @return false if there are no more tokens on the current line
+   */
+  bool NextToken(const char** token, size_t* length);
+
+  /**
+   * Skips whitespace-separated tokens on the current line.
+   * @param num_tokens the number of tokens to skip
+   * @return false if the line ended before all tokens were skipped
+   */
+  bool SkipTokens(uint32_t num_tokens);
+
+  /**
+   * Positions the cursor just after the last occurrence of a character in
+   * the remaining input.
+   * @param c the character to look for
+   * @return false if the character does not occur
+   */
+  bool SkipPastLast(char c);
+
+  /**
+   * Moves the cursor to the start of the next line.
+   * @return false if there are no more lines
+   */
+  bool NextLine();
+
+ private:
+  void SkipSpaces();
+
+  const char* pos_;
+  const char* end_;
+};
+
+}  // namespace platform_unix
+}  // namespace firmament
+
+#endif  // FIRMAMENT_PLATFORMS_UNIX_PROCFS_READER_H
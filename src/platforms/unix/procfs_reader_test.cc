@@ -0,0 +1,105 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// ProcFS file reader and tokenizer unit tests.
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/common.h"
+#include "platforms/unix/procfs_reader.h"
+
+namespace firmament {
+namespace platform_unix {
+
+class ProcFSReaderTest : public ::testing::Test {
+};
+
+// Tests that an open procfs file can be re-read to get fresh contents.
+TEST_F(ProcFSReaderTest, RereadOpenFile) {
+  ProcFSFile file;
+  ASSERT_TRUE(file.Open("/proc/self/stat"));
+  ASSERT_TRUE(file.Read());
+  ProcFSTokenizer tokenizer(file);
+  uint64_t pid;
+  ASSERT_TRUE(tokenizer.NextUint64(&pid));
+  EXPECT_EQ(pid, getpid());
+  size_t first_size = file.size();
+  ASSERT_TRUE(file.Read());
+  EXPECT_GT(file.size(), 0);
+  EXPECT_EQ(strlen(file.data()), file.size());
+  EXPECT_NEAR(file.size(), first_size, 16);
+}
+
+// Tests that files larger than the initial buffer are read completely.
+TEST_F(ProcFSReaderTest, ReadLargeFile) {
+  ProcFSFile file;
+  ASSERT_TRUE(file.Open("/proc/self/maps"));
+  ASSERT_TRUE(file.Read());
+  EXPECT_EQ(strlen(file.data()), file.size());
+  EXPECT_EQ(file.data()[file.size() - 1], '\n');
+}
+
+// Tests that opening a missing file fails, and that closed files cannot be
+// read.
+TEST_F(ProcFSReaderTest, MissingFile) {
+  ProcFSFile file;
+  EXPECT_FALSE(file.Open("/proc/self/does_not_exist"));
+  EXPECT_FALSE(file.is_open());
+  EXPECT_FALSE(file.Read());
+}
+
+// Tests parsing of numbers, tokens and lines.
+TEST_F(ProcFSReaderTest, Tokenizer) {
+  string data = "42 (a (b) c) R -1 7\nMemTotal:   1024 kB\n";
+  ProcFSTokenizer tokenizer(data.data(), data.data() + data.size());
+  uint64_t value;
+  ASSERT_TRUE(tokenizer.NextUint64(&value));
+  EXPECT_EQ(value, 42);
+  // The command name contains spaces and parentheses.
+  EXPECT_FALSE(tokenizer.NextUint64(&value));
+  ASSERT_TRUE(tokenizer.SkipPastLast(')'));
+  ASSERT_TRUE(tokenizer.SkipTokens(1));
+  ASSERT_TRUE(tokenizer.NextUint64(&value));
+  EXPECT_EQ(static_cast<int64_t>(value), -1);
+  ASSERT_TRUE(tokenizer.NextUint64(&value));
+  EXPECT_EQ(value, 7);
+  EXPECT_FALSE(tokenizer.SkipTokens(1));
+  ASSERT_TRUE(tokenizer.NextLine());
+  const char* token;
+  size_t length;
+  ASSERT_TRUE(tokenizer.NextToken(&token, &length));
+  EXPECT_EQ(string(token, length), "MemTotal:");
+  ASSERT_TRUE(tokenizer.NextUint64(&value));
+  EXPECT_EQ(value, 1024);
+  EXPECT_FALSE(tokenizer.NextLine());
+}
+
+}  // namespace platform_unix
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Chained receive buffer for stream sockets channels.
+
+#include "platforms/unix/recv_buffer_chain.h"
+
+#include <algorithm>
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+RecvBufferChain::InputStream::InputStream(const RecvBufferChain* chain,
+                                          uint64_t length)
+  : chain_(chain), length_(length), position_(0) {
+  CHECK_LE(length_, chain_->size());
+}
+
+bool RecvBufferChain::InputStream::Next(const void** data, int* size) {
+  if (position_ >= length_)
+    return false;
+  uint64_t offset = chain_->head_ + position_;
+  uint64_t block_offset = offset % chain_->block_size_;
+  uint64_t chunk = min(chain_->block_size_ - block_offset,
+                       length_ - position_);
+  *data = chain_->blocks_[offset / chain_->block_size_] + block_offset;
+  *size = static_cast<int>(chunk);
+  position_ += chunk;
+  return true;
+}
+
+void RecvBufferChain::InputStream::BackUp(int count) {
+  CHECK_GE(count, 0);
+  CHECK_LE(static_cast<uint64_t>(count), position_);
+  position_ -= count;
+}
+
+bool RecvBufferChain::InputStream::Skip(int count) {
+  CHECK_GE(count, 0);
+  if (position_ + count > length_) {
+    position_ = length_;
+    return false;
+  }
+  position_ += count;
+  return true;
+}
+
+google::protobuf::int64 RecvBufferChain::InputStream::ByteCount() const {
+  return position_;
+}
+
+RecvBufferChain::RecvBufferChain(size_t block_size, size_t max_free_blocks)
+  : block_size_(block_size), max_free_blocks_(max_free_blocks), head_(0),
+    tail_(0) {
+  CHECK_GT(block_size_, 0);
+}
+
+RecvBufferChain::~RecvBufferChain() {
+  for (deque<char*>::iterator it = blocks_.begin();
+       it != blocks_.end();
+       ++it) {
+    delete[] *it;
+  }
+  for (vector<char*>::iterator it = free_blocks_.begin();
+       it != free_blocks_.end();
+       ++it) {
+    delete[] *it;
+  }
+}
+
+char* RecvBufferChain::AllocateBlock() {
+  if (free_blocks_.empty())
+    return new char[block_size_];
+  char* block = free_blocks_.back();
+  free_blocks_.pop_back();
+  return block;
+}
+
+void RecvBufferChain::CommitWrite(uint64_t length) {
+  CHECK_LE(tail_ + length, blocks_.size() * block_size_);
+  tail_ += length;
+}
+
+void RecvBufferChain::Consume(uint64_t length) {
+  CHECK_LE(length, size());
+  head_ += length;
+  // Recycle blocks that have been consumed in full.
+  while (head_ >= block_size_) {
+    ReleaseBlock(blocks_.front());
+    blocks_.pop_front();
+    head_ -= block_size_;
+    tail_ -= block_size_;
+  }
+  if (head_ == tail_) {
+    // Nothing buffered, so start again at the beginning of the first block and
+    // recycle any others.
+    head_ = 0;
+    tail_ = 0;
+    while (blocks_.size() > 1) {
+      ReleaseBlock(blocks_.back());
+      blocks_.pop_back();
+    }
+  }
+}
+
+void RecvBufferChain::CopyOut(uint64_t length, void* dest) const {
+  CHECK_LE(length, size());
+  char* out = static_cast<char*>(dest);
+  uint64_t offset = head_;
+  while (length > 0) {
+    uint64_t block_offset = offset % block_size_;
+    uint64_t chunk = min(block_size_ - block_offset, length);
+    memcpy(out, blocks_[offset / block_size_] + block_offset, chunk);
+    out += chunk;
+    offset += chunk;
+    length -= chunk;
+  }
+}
+
+void RecvBufferChain::PrepareWrite(
+    uint64_t length,
+    vector<boost::asio::mutable_buffer>* buffers) {
+  while (blocks_.size() * block_size_ < tail_ + length)
+    blocks_.push_back(AllocateBlock());
+  buffers->clear();
+  uint64_t offset = tail_;
+  while (length > 0) {
+    uint64_t block_offset = offset % block_size_;
+    uint64_t chunk = min(block_size_ - block_offset, length);
+    buffers->push_back(boost::asio::mutable_buffer(
+        blocks_[offset / block_size_] + block_offset, chunk));
+    offset += chunk;
+    length -= chunk;
+  }
+}
+
+void RecvBufferChain::ReleaseBlock(char* block) {
+  if (free_blocks_.size() < max_free_blocks_)
+    free_blocks_.push_back(block);
+  else
+    delete[] block;
+}
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
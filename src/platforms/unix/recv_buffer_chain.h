@@ -0,0 +1,118 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Chained receive buffer for stream sockets channels.
+
+#ifndef FIRMAMENT_PLATFORMS_UNIX_RECV_BUFFER_CHAIN_H
+#define FIRMAMENT_PLATFORMS_UNIX_RECV_BUFFER_CHAIN_H
+
+#include <boost/asio.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include "base/common.h"
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+// A receive buffer made up of a chain of fixed-size blocks. Data is read from
+// the socket into the blocks at the tail of the chain and consumed from the
+// head; blocks that have been consumed in full are recycled through a small
+// per-chain pool. Messages larger than a block simply span several blocks and
+// are parsed in place via an InputStream, so neither a contiguous copy of the
+// message nor an upper bound on its size is required.
+class RecvBufferChain {
+ public:
+  // A ZeroCopyInputStream over a prefix of the buffered data. The data must
+  // not be consumed from the chain while a stream over it is in use.
+  class InputStream : public google::protobuf::io::ZeroCopyInputStream {
+   public:
+    InputStream(const RecvBufferChain* chain, uint64_t length);
+    bool Next(const void** data, int* size);
+    void BackUp(int count);
+    bool Skip(int count);
+    google::protobuf::int64 ByteCount() const;
+
+   private:
+    const RecvBufferChain* chain_;
+    uint64_t length_;
+    uint64_t position_;
+  };
+
+  /**
+   * @param block_size the size of each block in bytes
+   * @param max_free_blocks the maximum number of unused blocks to retain for
+   * reuse; further blocks are freed once they have been consumed
+   */
+  RecvBufferChain(size_t block_size, size_t max_free_blocks);
+  ~RecvBufferChain();
+  /**
+   * Marks bytes at the head of the chain as consumed, recycling any blocks
+   * that no longer hold unconsumed data.
+   * @param length the number of bytes to consume
+   */
+  void Consume(uint64_t length);
+  /**
+   * Copies bytes from the head of the chain without consuming them.
+   * @param length the number of bytes to copy; must not exceed size()
+   * @param dest the buffer to copy to
+   */
+  void CopyOut(uint64_t length, void* dest) const;
+  /**
+   * Marks bytes written into the buffers returned by PrepareWrite as holding
+   * data.
+   * @param length the number of bytes written
+   */
+  void CommitWrite(uint64_t length);
+  /**
+   * Ensures that the chain has space for a number of bytes beyond its tail,
+   * and returns the buffers covering that space, suitable for a scatter read.
+   * @param length the number of bytes of space required
+   * @param buffers set to the buffers covering the space
+   */
+  void PrepareWrite(uint64_t length,
+                    vector<boost::asio::mutable_buffer>* buffers);
+  // Number of bytes buffered and not yet consumed.
+  uint64_t size() const {
+    return tail_ - head_;
+  }
+
+ private:
+  char* AllocateBlock();
+  void ReleaseBlock(char* block);
+
+  uint64_t block_size_;
+  size_t max_free_blocks_;
+  // Blocks in use; head_ and tail_ are offsets from the start of the first one.
+  deque<char*> blocks_;
+  vector<char*> free_blocks_;
+  uint64_t head_;
+  uint64_t tail_;
+};
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
+
+#endif  // FIRMAMENT_PLATFORMS_UNIX_RECV_BUFFER_CHAIN_H
@@ -30,6 +30,30 @@
 
 using boost::asio::ip::tcp;
 
+DEFINE_bool(stream_sockets_batching, false,
+            "Coalesce messages queued on a stream sockets channel into a single "
+            "gather write, and decode multiple messages from each read.");
+DEFINE_uint64(stream_sockets_batch_max_bytes, 65536,
+              "Number of queued bytes on a channel at which a batch of "
+              "messages is flushed to the socket.");
+DEFINE_uint64(stream_sockets_recv_buffer_size, 65536,
+              "Size (in bytes) of the blocks making up a channel's receive "
+              "buffer, and maximum size of each read from the socket.");
+DEFINE_uint64(stream_sockets_max_message_size, 0,
+              "Maximum size (in bytes) of a received message, or 0 for no "
+              "limit. A channel receiving a frame that claims to be larger "
+              "is closed.");
+DEFINE_uint64(stream_sockets_recv_buffer_pool_blocks, 16,
+              "Maximum number of unused receive buffer blocks each channel "
+              "retains for reuse.");
+DEFINE_uint64(stream_sockets_io_threads, 1,
+              "Number of IO service threads serving connections accepted by a "
+              "messaging adapter. With more than one, message receipt "
+              "callbacks for different connections may run concurrently.");
+DEFINE_uint64(stream_sockets_channel_map_shards, 16,
+              "Number of independently locked shards a messaging adapter's "
+              "channels are spread over.");
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
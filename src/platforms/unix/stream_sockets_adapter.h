@@ -29,6 +29,7 @@
 #include <set>
 
 #include <boost/asio.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
@@ -44,6 +45,9 @@
 #include "platforms/unix/async_tcp_server.h"
 #include "platforms/unix/stream_sockets_channel.h"
 
+DECLARE_uint64(stream_sockets_io_threads);
+DECLARE_uint64(stream_sockets_channel_map_shards);
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
@@ -57,36 +61,45 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
   StreamSocketsAdapter() : message_recv_handler_(NULL),
     error_path_handler_(NULL),
     message_wait_ready_(false) {
+    CHECK_GT(FLAGS_stream_sockets_channel_map_shards, 0);
+    for (uint64_t i = 0; i < FLAGS_stream_sockets_channel_map_shards; ++i)
+      shards_.push_back(new ChannelMapShard);
   }
 
   virtual ~StreamSocketsAdapter() {
     VLOG(2) << "Messaging adapter is being destroyed.";
     StopListen();
+    for (typename vector<ChannelMapShard*>::iterator it = shards_.begin();
+         it != shards_.end();
+         ++it) {
+      delete *it;
+    }
   }
 
   void AwaitNextMessage() {
-    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-    VLOG(3) << "Iterating over " << endpoint_channel_map_.size()
+    VLOG(3) << "Iterating over " << NumActiveChannels()
             << " active channels in adapter " << this;
     if (VLOG_IS_ON(3))
       DumpActiveChannels();
-    // If we have no active channels, we cannot receive any messages, so we
-    // return immediately.
-    if (endpoint_channel_map_.size() == 0)
-      return;
-    // Otherwise, let's make sure we have an outstanding async receive request
-    // for each fo them.
-    {
-      boost::lock_guard<boost::mutex> envel_lock(channel_recv_envelopes_mutex_);
-      for (__typeof__(endpoint_channel_map_.begin()) chan_iter =
-             endpoint_channel_map_.begin();
-           chan_iter != endpoint_channel_map_.end();
+    // Make sure we have an outstanding async receive request for each active
+    // channel. Each shard is locked in turn, so receive handlers for channels
+    // in other shards can make progress meanwhile.
+    for (typename vector<ChannelMapShard*>::iterator shard_iter =
+           shards_.begin();
+         shard_iter != shards_.end();
+         ++shard_iter) {
+      ChannelMapShard* shard = *shard_iter;
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      for (__typeof__(shard->endpoint_channel_map.begin()) chan_iter =
+             shard->endpoint_channel_map.begin();
+           chan_iter != shard->endpoint_channel_map.end();
            ++chan_iter) {
         StreamSocketsChannel<T>* chan = chan_iter->second;
-        if (!channel_recv_envelopes_.count(chan)) {
+        if (!shard->channel_recv_envelopes.count(chan)) {
           // No outstanding receive request for this channel, so create one
           Envelope<T>* envelope = new Envelope<T>();
-          CHECK(InsertIfNotPresent(&channel_recv_envelopes_, chan, envelope));
+          CHECK(InsertIfNotPresent(&shard->channel_recv_envelopes, chan,
+                                   envelope));
           VLOG(2) << "MA replenishing envelope for channel " << chan
                   << " at " << envelope;
           chan->RecvA(envelope,
@@ -94,7 +107,7 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
                                   this,
                                   boost::asio::placeholders::error,
                                   boost::asio::placeholders::bytes_transferred,
-                                  chan));
+                                  chan, shard));
         }
       }
     }
@@ -119,8 +132,11 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     VLOG(1) << "Adding back-channel for connection at " << connection
             << ", channel is " << *channel << ", remote endpoint: "
             << endpoint_name;
-    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-    InsertIfNotPresent(&endpoint_channel_map_, endpoint_name, channel);
+    {
+      ChannelMapShard* shard = ShardForEndpoint(endpoint_name);
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      InsertIfNotPresent(&shard->endpoint_channel_map, endpoint_name, channel);
+    }
     if (VLOG_IS_ON(3))
       DumpActiveChannels();
     // Unblock any waiters, since there's now an additional connection
@@ -141,9 +157,12 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
 
   MessagingChannelInterface<T>* GetChannelForEndpoint(const string& endpoint) {
     CHECK_NE(endpoint, "");
-    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-    StreamSocketsChannel<T>* channel =
-      FindPtrOrNull(endpoint_channel_map_, endpoint);
+    StreamSocketsChannel<T>* channel;
+    {
+      ChannelMapShard* shard = ShardForEndpoint(endpoint);
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      channel = FindPtrOrNull(shard->endpoint_channel_map, endpoint);
+    }
     if (VLOG_IS_ON(3))
       DumpActiveChannels();
     return channel;
@@ -160,8 +179,12 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     /*if (ListenReady())
       return;*/
     CHECK(!ListenReady());
-    CHECK_EQ(endpoint_channel_map_.size(), 0);
-    CHECK_EQ(channel_recv_envelopes_.size(), 0);
+    CHECK_EQ(NumActiveChannels(), 0);
+    for (typename vector<ChannelMapShard*>::iterator it = shards_.begin();
+         it != shards_.end();
+         ++it) {
+      CHECK_EQ((*it)->channel_recv_envelopes.size(), 0);
+    }
     message_wait_mutex_.lock();
     message_wait_ready_ = false;
     message_wait_mutex_.unlock();
@@ -169,7 +192,8 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
             << " on endpoint " << hostname;
     tcp_server_.reset(new AsyncTCPServer(
         hostname, port, boost::bind(
-            &StreamSocketsAdapter::AddChannelForConnection, this, _1)));
+            &StreamSocketsAdapter::AddChannelForConnection, this, _1),
+        FLAGS_stream_sockets_io_threads));
     CHECK(tcp_server_);
     VLOG(2) << "TCP server created";
     tcp_server_thread_.reset(
@@ -191,6 +215,21 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
       return false;
   }
 
+  /**
+   * Runs a handler on the thread that receives messages, so that it does not
+   * run concurrently with message receipt callbacks. This only holds with a
+   * single IO thread: with --stream_sockets_io_threads greater than one, the
+   * handler runs on any of them.
+   * @param handler the handler to run
+   * @return false if the adapter is not listening, and the handler was dropped
+   */
+  bool PostToMessagingThread(boost::function<void()> handler) {
+    if (!ListenReady())
+      return false;
+    tcp_server_->Post(handler);
+    return true;
+  }
+
   void RegisterAsyncMessageReceiptCallback(
       typename AsyncMessageRecvHandler<T>::type callback) {
     message_recv_handler_ = callback;
@@ -202,9 +241,15 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
   }
 
   bool SendMessageToEndpoint(const string& endpoint_uri, T& message) {  // NOLINT
-    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-    StreamSocketsChannel<T>* channel =
-      FindPtrOrNull(endpoint_channel_map_, endpoint_uri);
+    // The channel serializes its own writes, so the shard is only locked for
+    // the lookup; a slow receiver must not hold up the other channels in
+    // its shard.
+    StreamSocketsChannel<T>* channel;
+    {
+      ChannelMapShard* shard = ShardForEndpoint(endpoint_uri);
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      channel = FindPtrOrNull(shard->endpoint_channel_map, endpoint_uri);
+    }
     if (!channel) {
       LOG(ERROR) << "Failed to find channel for endpoint " << endpoint_uri;
       return false;
@@ -218,12 +263,18 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
 
   void StopListen() {
     if (tcp_server_) {
-      for (__typeof__(endpoint_channel_map_.begin()) chan_iter =
-             endpoint_channel_map_.begin();
-           chan_iter != endpoint_channel_map_.end();
-           ++chan_iter) {
-        VLOG(2) << "Closing associated channel at " << chan_iter->second;
-        chan_iter->second->Close();
+      for (typename vector<ChannelMapShard*>::iterator shard_iter =
+             shards_.begin();
+           shard_iter != shards_.end();
+           ++shard_iter) {
+        boost::lock_guard<boost::mutex> lock((*shard_iter)->mutex);
+        for (__typeof__((*shard_iter)->endpoint_channel_map.begin())
+               chan_iter = (*shard_iter)->endpoint_channel_map.begin();
+             chan_iter != (*shard_iter)->endpoint_channel_map.end();
+             ++chan_iter) {
+          VLOG(2) << "Closing associated channel at " << chan_iter->second;
+          chan_iter->second->Close();
+        }
       }
       VLOG(2) << "Stopping async TCP server at " << tcp_server_ << "...";
       CHECK(tcp_server_);
@@ -235,35 +286,72 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     // XXX(malte): We would prefer if channels cleared up after themselves, but
     // for the moment, this is a sledgehammer approach.
     VLOG(1) << "Dropping channels and outstanding requests...";
-    endpoint_channel_map_.clear();
-    channel_recv_envelopes_.clear();
+    for (typename vector<ChannelMapShard*>::iterator it = shards_.begin();
+         it != shards_.end();
+         ++it) {
+      boost::lock_guard<boost::mutex> lock((*it)->mutex);
+      (*it)->endpoint_channel_map.clear();
+      (*it)->channel_recv_envelopes.clear();
+    }
   }
 
   ostream& ToString(ostream* stream) const {
     return *stream << "(MessagingAdapter,type=StreamSockets,at=" << this
-                   << ",num_channels=" << endpoint_channel_map_.size() << ")";
+                   << ",num_channels=" << NumActiveChannels() << ")";
   }
 
-  uint32_t NumActiveChannels() {
-    return endpoint_channel_map_.size();
+  // N.B.: must not be called with any shard lock held. The shards are locked
+  // one at a time, so the result is not a consistent snapshot if channels are
+  // added or removed concurrently.
+  uint32_t NumActiveChannels() const {
+    uint32_t num_channels = 0;
+    for (typename vector<ChannelMapShard*>::const_iterator it =
+           shards_.begin();
+         it != shards_.end();
+         ++it) {
+      boost::lock_guard<boost::mutex> lock((*it)->mutex);
+      num_channels += (*it)->endpoint_channel_map.size();
+    }
+    return num_channels;
   }
   void DumpActiveChannels() {
     LOG(INFO) << NumActiveChannels() << " active channels at " << *this;
-    for (__typeof__(endpoint_channel_map_.begin()) chan_iter =
-         endpoint_channel_map_.begin();
-         chan_iter != endpoint_channel_map_.end();
-         ++chan_iter) {
-      LOG(INFO) << "[" << chan_iter->second << "]: Local: "
-                << chan_iter->second->LocalEndpointString()
-                << " Remote: " << chan_iter->second->RemoteEndpointString();
+    for (typename vector<ChannelMapShard*>::iterator shard_iter =
+           shards_.begin();
+         shard_iter != shards_.end();
+         ++shard_iter) {
+      boost::lock_guard<boost::mutex> lock((*shard_iter)->mutex);
+      for (__typeof__((*shard_iter)->endpoint_channel_map.begin()) chan_iter =
+             (*shard_iter)->endpoint_channel_map.begin();
+           chan_iter != (*shard_iter)->endpoint_channel_map.end();
+           ++chan_iter) {
+        LOG(INFO) << "[" << chan_iter->second << "]: Local: "
+                  << chan_iter->second->LocalEndpointString()
+                  << " Remote: " << chan_iter->second->RemoteEndpointString();
+      }
     }
   }
 
  private:
+  // A shard of the adapter's channel state. Channels are assigned to shards by
+  // hashing their remote endpoint, and each shard has its own lock, so that
+  // receive handlers for different channels rarely contend.
+  struct ChannelMapShard {
+    boost::mutex mutex;
+    unordered_map<string, StreamSocketsChannel<T>*> endpoint_channel_map;
+    unordered_map<StreamSocketsChannel<T>*, Envelope<T>*>
+      channel_recv_envelopes;
+  };
+
+  ChannelMapShard* ShardForEndpoint(const string& endpoint) {
+    return shards_[boost::hash<string>()(endpoint) % shards_.size()];
+  }
+
   void HandleAsyncMessageRecv(
       const boost::system::error_code& error,
       uint64_t bytes_transferred,
-      StreamSocketsChannel<T>* chan) {
+      StreamSocketsChannel<T>* chan,
+      ChannelMapShard* shard) {
     if (error) {
       VLOG(1) << "Failed to receive message on MA " << *this;
       // TODO(malte): think about clearing up state here. Should we consider the
@@ -272,11 +360,9 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
       // concurrency
       string remote_endpoint = chan->RemoteEndpointString();
       if (remote_endpoint != "") {
-        boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-        boost::lock_guard<boost::mutex> envel_lock(
-            channel_recv_envelopes_mutex_);
-        CHECK(endpoint_channel_map_.erase(remote_endpoint));
-        CHECK(channel_recv_envelopes_.erase(chan));
+        boost::lock_guard<boost::mutex> lock(shard->mutex);
+        CHECK(shard->endpoint_channel_map.erase(remote_endpoint));
+        CHECK(shard->channel_recv_envelopes.erase(chan));
       } else {
         LOG(ERROR) << "Failed to receive on channel at " << chan
                    << ", which no longer has an endpoint set. Cannot remove "
@@ -302,9 +388,13 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
                    << remote_endpoint;
       return;
     }
-    CHECK_GT(channel_recv_envelopes_.count(chan), 0)
-      << "No envelopes around when we expected to have at least one.";
-    Envelope<T>* envelope = FindPtrOrNull(channel_recv_envelopes_, chan);
+    Envelope<T>* envelope;
+    {
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      CHECK_GT(shard->channel_recv_envelopes.count(chan), 0)
+        << "No envelopes around when we expected to have at least one.";
+      envelope = FindPtrOrNull(shard->channel_recv_envelopes, chan);
+    }
     CHECK_NOTNULL(envelope);
     VLOG(2) << "Received in MA: " << *envelope << " ("
             << bytes_transferred << ")";
@@ -313,8 +403,8 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     message_recv_handler_(envelope->data(), chan->RemoteEndpointString());
     // We've finished dealing with this message, so clean up now.
     {
-      boost::lock_guard<boost::mutex> lock(channel_recv_envelopes_mutex_);
-      channel_recv_envelopes_.erase(chan);
+      boost::lock_guard<boost::mutex> lock(shard->mutex);
+      shard->channel_recv_envelopes.erase(chan);
       delete envelope;
     }
     {
@@ -333,8 +423,9 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
     VLOG(1) << "Establishing channel to endpoint " << endpoint_uri
             << ", chan: " << *chan << "!";
     bool result = chan->Establish(endpoint_uri);
-    boost::lock_guard<boost::mutex> lock(endpoint_channel_map_mutex_);
-    InsertIfNotPresent(&endpoint_channel_map_, endpoint_uri, chan);
+    ChannelMapShard* shard = ShardForEndpoint(endpoint_uri);
+    boost::lock_guard<boost::mutex> lock(shard->mutex);
+    InsertIfNotPresent(&shard->endpoint_channel_map, endpoint_uri, chan);
     return result;
   }
 
@@ -343,13 +434,11 @@ class StreamSocketsAdapter : public firmament::MessagingAdapterInterface<T>,
   shared_ptr<AsyncTCPServer> tcp_server_;
   scoped_ptr<boost::thread> tcp_server_thread_;
   //set<shared_ptr<StreamSocketsChannel<T> > > active_channels_;
-  unordered_map<string, StreamSocketsChannel<T>*> endpoint_channel_map_;
-  unordered_map<StreamSocketsChannel<T>*, Envelope<T>*> channel_recv_envelopes_;
+  // Channel maps, sharded by remote endpoint.
+  vector<ChannelMapShard*> shards_;
   // Synchronization variables, locks tec.
   boost::mutex message_wait_mutex_;
   boost::condition_variable message_wait_condvar_;
-  boost::mutex channel_recv_envelopes_mutex_;
-  boost::mutex endpoint_channel_map_mutex_;
   bool message_wait_ready_;
 };
 
@@ -0,0 +1,120 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Stream sockets messaging adapter unit tests.
+
+#include <gtest/gtest.h>
+
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "base/common.h"
+#include "messages/base_message.pb.h"
+#include "misc/protobuf_envelope.h"
+#include "platforms/unix/stream_sockets_adapter.h"
+#include "platforms/unix/stream_sockets_channel.h"
+
+using firmament::common::InitFirmament;
+using firmament::misc::Envelope;
+
+DECLARE_uint64(stream_sockets_io_threads);
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+class StreamSocketsAdapterTest : public ::testing::Test {
+ protected:
+  StreamSocketsAdapterTest()
+    : num_received_(0) {
+  }
+
+  virtual void TearDown() {
+    FLAGS_stream_sockets_io_threads = 1;
+  }
+
+  void HandleRecv(BaseMessage* bm, const string& remote_endpoint) {
+    boost::lock_guard<boost::mutex> lock(received_lock_);
+    ++num_received_;
+  }
+
+  // Connects the given number of clients to a listening adapter, sends a
+  // message from each and waits for the adapter to receive all of them.
+  void SendFromClients(uint32_t num_clients) {
+    StreamSocketsAdapter<BaseMessage> adapter;
+    adapter.RegisterAsyncMessageReceiptCallback(
+        boost::bind(&StreamSocketsAdapterTest::HandleRecv, this, _1, _2));
+    string endpoint = adapter.Listen("localhost");
+    vector<StreamSocketsChannel<BaseMessage>*> clients;
+    for (uint32_t i = 0; i < num_clients; ++i) {
+      StreamSocketsChannel<BaseMessage>* chan =
+        new StreamSocketsChannel<BaseMessage>(
+            StreamSocketsChannel<BaseMessage>::SS_TCP);
+      CHECK(chan->Establish(endpoint));
+      clients.push_back(chan);
+    }
+    // Wait for the adapter to accept all connections.
+    while (adapter.NumActiveChannels() < num_clients)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    for (uint32_t i = 0; i < num_clients; ++i) {
+      BaseMessage bm;
+      bm.mutable_test()->set_test(i);
+      Envelope<BaseMessage> envelope(&bm);
+      EXPECT_TRUE(clients[i]->SendS(envelope));
+    }
+    while (true) {
+      adapter.AwaitNextMessage();
+      {
+        boost::lock_guard<boost::mutex> lock(received_lock_);
+        if (num_received_ == num_clients)
+          break;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    adapter.StopListen();
+    for (uint32_t i = 0; i < num_clients; ++i)
+      delete clients[i];
+  }
+
+  boost::mutex received_lock_;
+  uint32_t num_received_;
+};
+
+TEST_F(StreamSocketsAdapterTest, ReceiveFromManyClients) {
+  SendFromClients(8);
+  EXPECT_EQ(num_received_, 8);
+}
+
+TEST_F(StreamSocketsAdapterTest, ReceiveWithIOServicePool) {
+  FLAGS_stream_sockets_io_threads = 4;
+  SendFromClients(16);
+  EXPECT_EQ(num_received_, 16);
+}
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitFirmament(argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -25,6 +25,7 @@
 
 #include <boost/asio.hpp>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -37,9 +38,16 @@
 #include "misc/uri_tools.h"
 #include "platforms/common.h"
 #include "platforms/unix/common.h"
+#include "platforms/unix/recv_buffer_chain.h"
 #include "platforms/unix/tcp_connection.h"
 #include "platforms/unix/async_tcp_server.h"
 
+DECLARE_bool(stream_sockets_batching);
+DECLARE_uint64(stream_sockets_batch_max_bytes);
+DECLARE_uint64(stream_sockets_recv_buffer_size);
+DECLARE_uint64(stream_sockets_max_message_size);
+DECLARE_uint64(stream_sockets_recv_buffer_pool_blocks);
+
 namespace firmament {
 namespace platform_unix {
 namespace streamsockets {
@@ -58,12 +66,14 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   typedef shared_ptr<type> ptr_type;
 
   explicit StreamSocketsChannel(StreamSocketType type)
-    : async_recv_buffer_(NULL),
-      async_recv_buffer_vec_(NULL),
-      client_io_service_(new io_service),
+    : client_io_service_(new io_service),
       client_socket_(NULL),
       channel_ready_(false),
-      type_(type) {
+      type_(type),
+      send_queue_bytes_(0),
+      num_writes_(0),
+      recv_buffer_(FLAGS_stream_sockets_recv_buffer_size,
+                   FLAGS_stream_sockets_recv_buffer_pool_blocks) {
     switch (type) {
     case SS_TCP:
       VLOG(2) << "Setup for TCP endpoints";
@@ -77,12 +87,14 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   }
 
   explicit StreamSocketsChannel(TCPConnection::connection_ptr connection)
-    : async_recv_buffer_(NULL),
-      async_recv_buffer_vec_(NULL),
-      client_socket_(connection->socket()),
+    : client_socket_(connection->socket()),
       client_connection_(connection),
       channel_ready_(false),
-      type_(SS_TCP) {
+      type_(SS_TCP),
+      send_queue_bytes_(0),
+      num_writes_(0),
+      recv_buffer_(FLAGS_stream_sockets_recv_buffer_size,
+                   FLAGS_stream_sockets_recv_buffer_pool_blocks) {
     VLOG(2) << "Creating new channel around socket at " << client_socket_;
     if (client_socket_->is_open()) {
       channel_ready_ = true;
@@ -119,6 +131,7 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
       // The channel was constructed around an existing connection, so it does
       // not have ownership of the socket. Ask the connection to terminate
       // instead.
+      cached_remote_endpoint_ = client_connection_->RemoteEndpointString();
       client_connection_->Close();
       client_connection_.reset();
       client_socket_ = NULL;
@@ -229,22 +242,17 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     }
     // Obtain the lock on the async receive buffer.
     async_recv_lock_.lock();
-    CHECK_EQ(async_recv_buffer_vec_, static_cast<char*>(NULL));
-    CHECK_EQ(async_recv_buffer_,
-             static_cast<boost::asio::mutable_buffers_1*>(NULL));
-    async_recv_buffer_vec_ = reinterpret_cast<char*>(malloc(sizeof(uint64_t)));
-    async_recv_buffer_ =
-      new boost::asio::mutable_buffers_1(async_recv_buffer_vec_,
-                                         sizeof(uint64_t));
-    // Asynchronously read the incoming protobuf message length and invoke the
-    // second stage of the receive call once we have it.
-    async_read(*client_socket_, *async_recv_buffer_,
-               boost::asio::transfer_exactly(sizeof(uint64_t)),
-               boost::bind(&StreamSocketsChannel<T>::RecvASecondStage,
-                           this,
-                           boost::asio::placeholders::error,
-                           boost::asio::placeholders::bytes_transferred,
-                           message, callback));
+    uint64_t msg_size;
+    if (NextFrameStatus(&msg_size) != FRAME_INCOMPLETE) {
+      // An earlier read already brought in this message (or an invalid frame
+      // header); complete the receive without touching the socket. The
+      // completion is posted so that the callback never runs inside RecvA.
+      IOService()->post(
+          boost::bind(&StreamSocketsChannel<T>::HandleAsyncRead, this,
+                      boost::system::error_code(), 0, message, callback));
+    } else {
+      StartAsyncRead(message, callback);
+    }
     // First stage of RecvA always succeeds.
     return true;
   }
@@ -253,62 +261,39 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
    * Synchronous receive -- blocks until the next message is received.
    */
   bool RecvS(misc::Envelope<T>* message) {
-    boost::lock_guard<boost::mutex> lock(sync_send_lock_);
+    boost::lock_guard<boost::mutex> lock(sync_recv_lock_);
     VLOG(2) << "In RecvS, polling for next message";
     if (!Ready()) {
       LOG(WARNING) << "Tried to read from channel " << this
                    << ", which is not ready; read failed.";
       return false;
     }
-    uint64_t len;
-    vector<char> size_buf(sizeof(uint64_t));
-    boost::asio::mutable_buffers_1 size_m_buf(
-        reinterpret_cast<char*>(&size_buf[0]), sizeof(uint64_t));
-    boost::system::error_code error;
-    // Read the incoming protobuf message length
-    // N.B.: read() blocks until the buffer has been filled, i.e. an entire
-    // uint64_t has been read.
-    len = read(*client_socket_, size_m_buf,
-               boost::asio::transfer_exactly(sizeof(uint64_t)), error);
-    if (error || len != sizeof(uint64_t)) {
-      LOG(ERROR) << "Error reading from connection on channel " << *this
-                 << "(len: " << len << ", expected: " << sizeof(uint64_t) << ")"
-                 << ": " << error.message();
-      if (error)
+    uint64_t msg_size;
+    FrameStatus frame_status;
+    while ((frame_status = NextFrameStatus(&msg_size)) == FRAME_INCOMPLETE) {
+      vector<boost::asio::mutable_buffer> buffers;
+      PrepareRecvBuffer(&buffers);
+      boost::system::error_code error;
+      size_t len = client_socket_->read_some(buffers, error);
+      if (error == boost::asio::error::eof) {
+        VLOG(1) << "Received EOF, connection terminating!";
+        return false;
+      } else if (error) {
+        LOG(ERROR) << "Error reading from connection on channel " << *this
+                   << ": " << error.message();
         HandleIOError(error);
-      return false;
+        return false;
+      }
+      VLOG(2) << "Read " << len << " bytes.";
+      recv_buffer_.CommitWrite(len);
     }
-    // ... we can get away with a simple CHECK here and assume that we have some
-    // incoming data available.
-    CHECK_EQ(sizeof(uint64_t), len);
-    uint64_t msg_size = be64toh(*reinterpret_cast<uint64_t*>(&size_buf[0]));
-    CHECK_GT(msg_size, 0);
-    VLOG(3) << "RecvS: size of incoming protobuf from" << RemoteEndpointString()
-            << "is " << msg_size << " bytes.";
-    // XXX(malte): This is a nasty hack to highlight bugs in the channel logic.
-    CHECK_LT(msg_size, 35000) << "Received implausibly large message size "
-                              << "from " << RemoteEndpointString();
-    vector<char> buf(msg_size);
-    len = read(*client_socket_,
-               boost::asio::mutable_buffers_1(&buf[0], msg_size),
-               boost::asio::transfer_exactly(msg_size), error);
-    VLOG(2) << "Read " << len << " bytes.";
-
-    if (error == boost::asio::error::eof) {
-      VLOG(1) << "Received EOF, connection terminating!";
-      return false;
-    } else if (error) {
-      LOG(ERROR) << "Error reading from connection: "
-                 << error.message();
-      HandleIOError(error);
+    if (frame_status == FRAME_INVALID) {
+      Close();
       return false;
-    } else {
-      VLOG(2) << "Read " << len << " bytes of protobuf data...";
     }
-    CHECK_GT(len, 0);
-    CHECK_EQ(len, msg_size);
-    // XXX(malte): data copy here -- optimize away if possible.
-    return (message->Parse(&buf[0], len));
+    VLOG(3) << "RecvS: size of incoming protobuf from "
+            << RemoteEndpointString() << " is " << msg_size << " bytes.";
+    return ConsumeBufferedFrame(msg_size, message);
   }
 
   /**
@@ -317,6 +302,10 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   const string RemoteEndpointString() {
     if (client_connection_)
       return client_connection_->RemoteEndpointString();
+    // The socket goes away when a server-side channel is closed, which may
+    // race with handlers for reads outstanding on it.
+    if (!client_socket_)
+      return cached_remote_endpoint_;
     boost::system::error_code ec;
     tcp::endpoint ept = client_socket_->remote_endpoint(ec);
     if (ec)
@@ -326,32 +315,35 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   }
 
   bool SendS(const misc::Envelope<T>& message) {
+    bool queued;
+    {
+      boost::lock_guard<boost::mutex> lock(send_queue_lock_);
+      queued = !send_queue_.empty();
+    }
+    // Messages queued by EnqueueS() must go out first, so they are flushed
+    // along with this one even without batching.
+    if (FLAGS_stream_sockets_batching || queued) {
+      // Queue the message and flush the queue. If another thread is in the
+      // middle of a write, we block on the send lock and our message goes out
+      // in the same gather write as any others queued in the meantime.
+      if (!EnqueueS(message))
+        return false;
+      return FlushS();
+    }
     boost::lock_guard<boost::mutex> lock(sync_send_lock_);
     VLOG(2) << "Trying to send message of size " << message.size()
             << " on channel " << *this;
+    // Frame the message (size preamble followed by the data) in the channel's
+    // send buffer, so that it goes out in a single write.
     uint64_t msg_size = message.size();
-    vector<char> buf(msg_size);
-    CHECK(message.Serialize(&buf[0], message.size()));
-    // Send data size
+    if (!SerializeFrame(message, msg_size, &send_buffer_))
+      return false;
     boost::system::error_code error;
-    uint64_t msg_size_endian = htobe64(msg_size);
-
+    num_writes_++;
     uint64_t len = boost::asio::write(
-        *client_socket_, boost::asio::buffer(
-            reinterpret_cast<char*>(&msg_size_endian), sizeof(msg_size_endian)),
-        boost::asio::transfer_exactly(sizeof(uint64_t)), error);
-    if (error || len != sizeof(uint64_t)) {
-      LOG(ERROR) << "Error sending size preamble on connection: "
-                 << error.message();
-      if (error)
-        HandleIOError(error);
-      return false;
-    }
-    // Send the data
-    len = boost::asio::write(
-        *client_socket_, boost::asio::buffer(buf, msg_size),
-        boost::asio::transfer_exactly(msg_size), error);
-    if (error || len != msg_size) {
+        *client_socket_, boost::asio::buffer(send_buffer_),
+        boost::asio::transfer_exactly(send_buffer_.size()), error);
+    if (error || len != send_buffer_.size()) {
       LOG(ERROR) << "Error sending message on connection: "
                  << error.message();
       if (error)
@@ -364,6 +356,80 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     return true;
   }
 
+  /**
+   * Queues a message for sending without writing it to the socket. Queued
+   * messages are coalesced into a single gather write by the next call to
+   * FlushS() or SendS(). The queue is flushed automatically
+   * once it holds more than --stream_sockets_batch_max_bytes.
+   * @param message the message to queue
+   * @return true if the message was queued (and any automatic flush succeeded)
+   */
+  bool EnqueueS(const misc::Envelope<T>& message) {
+    uint64_t msg_size = message.size();
+    vector<char> frame;
+    if (!SerializeFrame(message, msg_size, &frame))
+      return false;
+    bool flush = false;
+    {
+      boost::lock_guard<boost::mutex> lock(send_queue_lock_);
+      send_queue_bytes_ += frame.size();
+      send_queue_.push_back(vector<char>());
+      send_queue_.back().swap(frame);
+      flush = send_queue_bytes_ >= FLAGS_stream_sockets_batch_max_bytes;
+    }
+    if (flush)
+      return FlushS();
+    return true;
+  }
+
+  /**
+   * Writes all queued messages to the socket in a single gather write.
+   * @return true if the queue was empty or all messages were written
+   */
+  bool FlushS() {
+    boost::lock_guard<boost::mutex> lock(sync_send_lock_);
+    vector<vector<char> > frames;
+    {
+      boost::lock_guard<boost::mutex> queue_lock(send_queue_lock_);
+      frames.swap(send_queue_);
+      send_queue_bytes_ = 0;
+    }
+    if (frames.empty())
+      return true;
+    vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(frames.size());
+    uint64_t total_size = 0;
+    for (vector<vector<char> >::const_iterator it = frames.begin();
+         it != frames.end();
+         ++it) {
+      buffers.push_back(boost::asio::buffer(*it));
+      total_size += it->size();
+    }
+    boost::system::error_code error;
+    num_writes_++;
+    uint64_t len = boost::asio::write(*client_socket_, buffers,
+                                      boost::asio::transfer_all(), error);
+    if (error || len != total_size) {
+      LOG(ERROR) << "Error sending batch of " << frames.size()
+                 << " messages on connection: " << error.message();
+      if (error)
+        HandleIOError(error);
+      return false;
+    }
+    VLOG(2) << "Sent batch of " << frames.size() << " messages ("
+            << len << " bytes) on channel " << *this;
+    return true;
+  }
+
+  /**
+   * @return the number of (gather) writes issued by SendS() and FlushS() so
+   * far
+   */
+  uint64_t num_writes() {
+    boost::lock_guard<boost::mutex> lock(sync_send_lock_);
+    return num_writes_;
+  }
+
   /**
    * Asynchronous send.
    * N.B.: error handling is deferred to the callback handler, which takes a
@@ -419,117 +485,173 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
     }
   }
 
+  enum FrameStatus {
+    FRAME_INCOMPLETE,
+    FRAME_AVAILABLE,
+    FRAME_INVALID,
+  };
+
   /**
-   * Second stage of asynchronous receive, which calls async_recv again in order
-   * to get the actual message data.
-   * Called with the async_recv_lock_ mutex held. It is either released before
-   * returning (error path) or maintained for RecvAThirdStage to release.
+   * Checks if the receive buffer holds a complete frame. A frame whose size
+   * preamble claims an empty message, or one larger than a non-zero
+   * --stream_sockets_max_message_size, is invalid; the stream cannot be
+   * resynchronized after it, so the caller must close the channel.
+   * @param msg_size set to the size of the message in the next frame, if its
+   * size preamble has been received
+   * @return the status of the next frame
    */
-  void RecvASecondStage(const boost::system::error_code& error,
-                        const size_t bytes_read,
-                        Envelope<T>* final_envelope,
-                        typename AsyncRecvHandler<T>::type final_callback) {
-    if (error || bytes_read != sizeof(uint64_t)) {
-      if (error != boost::asio::error::eof) {
-        LOG(ERROR) << "Error reading from connection: " << error.message()
-                   << "; read " << bytes_read << " bytes, expected "
-                   << sizeof(uint64_t);
-      }
-      if (error)
-        HandleIOError(error);
-      async_recv_lock_.unlock();
-      final_callback(error, bytes_read, final_envelope);
-      return;
+  FrameStatus NextFrameStatus(uint64_t* msg_size) {
+    if (recv_buffer_.size() < sizeof(uint64_t))
+      return FRAME_INCOMPLETE;
+    uint64_t msg_size_endian;
+    recv_buffer_.CopyOut(sizeof(uint64_t), &msg_size_endian);
+    *msg_size = be64toh(msg_size_endian);
+    if (*msg_size == 0 || (FLAGS_stream_sockets_max_message_size > 0 &&
+                           *msg_size > FLAGS_stream_sockets_max_message_size)) {
+      LOG(ERROR) << "Received frame with invalid message size " << *msg_size
+                 << " from " << RemoteEndpointString() << "; closing channel "
+                 << *this;
+      return FRAME_INVALID;
+    }
+    if (recv_buffer_.size() < sizeof(uint64_t) + *msg_size)
+      return FRAME_INCOMPLETE;
+    return FRAME_AVAILABLE;
+  }
+
+  /**
+   * Parses the next frame directly out of the receive buffer and consumes it.
+   * @param msg_size the size of the message in the next frame
+   * @param message the envelope to parse the message into
+   * @return true if the message was parsed successfully
+   */
+  bool ConsumeBufferedFrame(uint64_t msg_size, misc::Envelope<T>* message) {
+    recv_buffer_.Consume(sizeof(uint64_t));
+    bool parsed;
+    {
+      RecvBufferChain::InputStream stream(&recv_buffer_, msg_size);
+      parsed = message->ParseFromStream(&stream, msg_size);
     }
-    // ... we can get away with a simple CHECK here and assume that we have some
-    // incoming data available.
-    CHECK_EQ(sizeof(uint64_t), bytes_read);
-    // Nasty cast to get message size indicator received (after endian
-    // conversion)
-    uint64_t msg_size =
-      be64toh(*reinterpret_cast<uint64_t*>(async_recv_buffer_vec_));
-    CHECK_GT(msg_size, 0) << "Received message of length 0 from "
-                          << RemoteEndpointString();
-    // XXX(malte): This is a nasty hack to highlight bugs in the channel logic.
-    CHECK_LT(msg_size, 1024*1024) << "Received implausibly large message "
-                                  << "from " << RemoteEndpointString();
-    VLOG(2) << "RecvA: size of incoming protobuf from" << RemoteEndpointString()
-            << "is " << msg_size << " bytes.";
-    // We still hold the async_recv_lock_ mutex here.
-    free(async_recv_buffer_vec_);
-    async_recv_buffer_vec_ = reinterpret_cast<char*>(malloc(msg_size));
-    VLOG(2) << "New async recv buffer is at "
-            << static_cast<void*>(async_recv_buffer_vec_);
-    delete async_recv_buffer_;
-    async_recv_buffer_ =
-      new boost::asio::mutable_buffers_1(async_recv_buffer_vec_, msg_size);
-    async_read(*client_socket_, *async_recv_buffer_,
-               boost::asio::transfer_exactly(msg_size),
-               boost::bind(&StreamSocketsChannel<T>::RecvAThirdStage,
-                           this,
-                           boost::asio::placeholders::error,
-                           boost::asio::placeholders::bytes_transferred,
-                           msg_size, final_envelope, final_callback));
+    recv_buffer_.Consume(msg_size);
+    return parsed;
   }
 
   /**
-   * Third stage of asynchronous receive, which finalizes the message reception
-   * by parsing the received data.
-   * Called with the async_recv_lock_ mutex held, but releases it before
-   * returning.
+   * Prepares the receive buffer for the next read, which covers up to
+   * --stream_sockets_recv_buffer_size bytes. Without batching, we never read
+   * beyond the end of the current frame; in batching mode, a read may cover
+   * several frames. Large messages are received over several reads, so
+   * buffer space is only allocated as data arrives.
+   * @param buffers set to the buffers to read into
    */
-  void RecvAThirdStage(const boost::system::error_code& error,
-                       const size_t bytes_read, uint64_t message_size,
+  void PrepareRecvBuffer(vector<boost::asio::mutable_buffer>* buffers) {
+    // Only called while the next frame is incomplete, so its size (if
+    // known) has been checked already.
+    uint64_t frame_size = sizeof(uint64_t);
+    if (recv_buffer_.size() >= sizeof(uint64_t)) {
+      uint64_t msg_size_endian;
+      recv_buffer_.CopyOut(sizeof(uint64_t), &msg_size_endian);
+      frame_size += be64toh(msg_size_endian);
+    }
+    uint64_t wanted = FLAGS_stream_sockets_recv_buffer_size;
+    if (!FLAGS_stream_sockets_batching)
+      wanted = min(wanted, frame_size - recv_buffer_.size());
+    recv_buffer_.PrepareWrite(wanted, buffers);
+  }
+
+  /**
+   * Issues an asynchronous read into the receive buffer.
+   * Called with the async_recv_lock_ mutex held.
+   */
+  void StartAsyncRead(Envelope<T>* final_envelope,
+                      typename AsyncRecvHandler<T>::type final_callback) {
+    vector<boost::asio::mutable_buffer> buffers;
+    PrepareRecvBuffer(&buffers);
+    client_socket_->async_read_some(
+        buffers,
+        boost::bind(&StreamSocketsChannel<T>::HandleAsyncRead,
+                    this,
+                    boost::asio::placeholders::error,
+                    boost::asio::placeholders::bytes_transferred,
+                    final_envelope, final_callback));
+  }
+
+  /**
+   * Completion handler for asynchronous reads. Parses the next message if its
+   * frame has been received in full, and otherwise reads more data.
+   * Called with the async_recv_lock_ mutex held, which is released before the
+   * final callback is invoked.
+   */
+  void HandleAsyncRead(const boost::system::error_code& error,
+                       const size_t bytes_read,
                        Envelope<T>* final_envelope,
                        typename AsyncRecvHandler<T>::type final_callback) {
-    VLOG(2) << "Read " << bytes_read << " bytes.";
-    if (error == boost::asio::error::eof) {
-      VLOG(1) << "Received EOF, connection terminating!";
+    if (error) {
+      if (error != boost::asio::error::eof) {
+        LOG(ERROR) << "Error reading from connection: " << error.message()
+                   << "; read " << bytes_read << " bytes";
+      }
+      HandleIOError(error);
       async_recv_lock_.unlock();
       final_callback(error, bytes_read, final_envelope);
       return;
-    } else if (error) {
-      LOG(ERROR) << "Error reading from connection: "
-                 << error.message() << "; read " << bytes_read
-                 << " bytes, expected " << message_size;
-      if (error)
-        HandleIOError(error);
+    }
+    VLOG(2) << "Read " << bytes_read << " bytes.";
+    recv_buffer_.CommitWrite(bytes_read);
+    uint64_t msg_size;
+    FrameStatus frame_status = NextFrameStatus(&msg_size);
+    if (frame_status == FRAME_INCOMPLETE) {
+      StartAsyncRead(final_envelope, final_callback);
+      return;
+    }
+    if (frame_status == FRAME_INVALID) {
+      Close();
       async_recv_lock_.unlock();
-      final_callback(error, bytes_read, final_envelope);
+      final_callback(boost::asio::error::message_size, 0, final_envelope);
       return;
-    } else {
-      VLOG(2) << "Read " << bytes_read << " bytes of protobuf data...";
     }
-    CHECK_GT(bytes_read, 0);
-    CHECK_EQ(bytes_read, message_size);
-    VLOG(2) << "About to parse message";
-    if (!final_envelope->Parse(async_recv_buffer_vec_, bytes_read)) {
-      LOG(ERROR) << "Failed to parse protobuf message of " << bytes_read
+    VLOG(2) << "RecvA: size of incoming protobuf from "
+            << RemoteEndpointString() << " is " << msg_size << " bytes.";
+    if (!ConsumeBufferedFrame(msg_size, final_envelope)) {
+      LOG(ERROR) << "Failed to parse protobuf message of " << msg_size
                  << " bytes!";
     }
-    free(async_recv_buffer_vec_);
-    delete async_recv_buffer_;
-    async_recv_buffer_vec_ = NULL;
-    async_recv_buffer_ = NULL;
-    // Invoke the original callback
-    // XXX(malte): potential race condition -- someone else may finish and
-    // invoke the callback before we do (although this is very unlikely).
-    VLOG(2) << "About to invoke final async recv callback!";
-    final_callback(error, bytes_read, final_envelope);
-    // Drop the lock
     VLOG(2) << "Unlocking async receive buffer";
     async_recv_lock_.unlock();
+    final_callback(error, msg_size, final_envelope);
+  }
+
+  /**
+   * Serializes a message into a frame consisting of the big-endian size
+   * preamble followed by the message data.
+   * @param message the message to serialize
+   * @param msg_size the serialized size of the message
+   * @param frame the buffer to serialize into; resized to fit the frame
+   * @return true if serialization succeeded
+   */
+  bool SerializeFrame(const misc::Envelope<T>& message, uint64_t msg_size,
+                      vector<char>* frame) {
+    frame->resize(sizeof(uint64_t) + msg_size);
+    uint64_t msg_size_endian = htobe64(msg_size);
+    memcpy(&(*frame)[0], &msg_size_endian, sizeof(uint64_t));
+    if (!message.Serialize(&(*frame)[sizeof(uint64_t)], msg_size)) {
+      LOG(ERROR) << "Failed to serialize message of size " << msg_size
+                 << " on channel " << *this;
+      return false;
+    }
+    return true;
+  }
+
+  shared_ptr<boost::asio::io_service> IOService() {
+    if (client_connection_)
+      return client_connection_->io_service_ptr();
+    return client_io_service_;
   }
 
  private:
   boost::mutex sync_recv_lock_;
   boost::mutex sync_send_lock_;
-  // Async receive buffer data structures and lock
+  // Async receive lock; held while an asynchronous receive is outstanding.
   boost::mutex async_recv_lock_;
-  //scoped_ptr<boost::asio::mutable_buffers_1> async_recv_buffer_;
-  boost::asio::mutable_buffers_1* async_recv_buffer_;
-  //scoped_ptr<vector<char> > async_recv_buffer_vec_;
-  char* async_recv_buffer_vec_;
   // TCP and io_service data structures
   shared_ptr<boost::asio::io_service> client_io_service_;
   scoped_ptr<boost::asio::io_service::work> io_service_work_;
@@ -543,6 +665,20 @@ class StreamSocketsChannel : public MessagingChannelInterface<T>,
   string cached_remote_endpoint_;
   bool channel_ready_;
   StreamSocketType type_;
+  // Send buffer reused by SendS in non-batching mode; protected by
+  // sync_send_lock_.
+  vector<char> send_buffer_;
+  // Framed messages queued for the next batched write, and their total size.
+  boost::mutex send_queue_lock_;
+  vector<vector<char> > send_queue_;
+  uint64_t send_queue_bytes_;
+  // Protected by sync_send_lock_.
+  uint64_t num_writes_;
+  // Receive buffer. Messages are parsed directly out of its blocks, and in
+  // batching mode a single read may bring in several of them. Protected by
+  // sync_recv_lock_ or async_recv_lock_; a channel should not mix synchronous
+  // and asynchronous receives.
+  RecvBufferChain recv_buffer_;
 };
 
 }  // namespace streamsockets
@@ -0,0 +1,249 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Stream sockets channel unit tests.
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "base/common.h"
+#include "messages/base_message.pb.h"
+#include "misc/protobuf_envelope.h"
+#include "platforms/unix/stream_sockets_channel.h"
+#include "platforms/unix/tcp_connection.h"
+
+using boost::asio::ip::tcp;
+using firmament::common::InitFirmament;
+using firmament::misc::Envelope;
+
+DECLARE_bool(stream_sockets_batching);
+DECLARE_uint64(stream_sockets_batch_max_bytes);
+DECLARE_uint64(stream_sockets_max_message_size);
+DECLARE_uint64(stream_sockets_recv_buffer_size);
+
+namespace firmament {
+namespace platform_unix {
+namespace streamsockets {
+
+class StreamSocketsChannelTest : public ::testing::Test {
+ protected:
+  StreamSocketsChannelTest()
+    : io_service_(new io_service),
+      acceptor_(*io_service_,
+                tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+      num_expected_(0) {
+  }
+
+  virtual void TearDown() {
+    FLAGS_stream_sockets_batching = false;
+    FLAGS_stream_sockets_batch_max_bytes = 65536;
+    FLAGS_stream_sockets_recv_buffer_size = 65536;
+    FLAGS_stream_sockets_max_message_size = 0;
+  }
+
+  // Connects a client channel to a server-side channel wrapping the accepted
+  // connection.
+  void Connect() {
+    connection_.reset(new TCPConnection(io_service_));
+    client_.reset(new StreamSocketsChannel<BaseMessage>(
+        StreamSocketsChannel<BaseMessage>::SS_TCP));
+    boost::thread client_thread(
+        boost::bind(&StreamSocketsChannelTest::EstablishClient, this));
+    acceptor_.accept(*connection_->socket());
+    client_thread.join();
+    server_.reset(new StreamSocketsChannel<BaseMessage>(connection_));
+  }
+
+  void HandleAsyncRecv(const boost::system::error_code& error, size_t len,
+                       Envelope<BaseMessage>* envelope) {
+    CHECK(!error);
+    received_.push_back(envelope->data()->test().test());
+    delete envelope;
+    // N.B.: an outstanding receive holds the channel's receive lock, so we
+    // must not issue one that will never complete.
+    if (received_.size() < num_expected_)
+      StartAsyncRecv();
+  }
+
+  void StartAsyncRecv() {
+    server_->RecvA(new Envelope<BaseMessage>,
+                   boost::bind(&StreamSocketsChannelTest::HandleAsyncRecv, this,
+                               _1, _2, _3));
+  }
+
+  void EstablishClient() {
+    CHECK(client_->Establish(
+        "tcp:localhost:" + to_string(acceptor_.local_endpoint().port())));
+  }
+
+  shared_ptr<io_service> io_service_;
+  tcp::acceptor acceptor_;
+  TCPConnection::connection_ptr connection_;
+  scoped_ptr<StreamSocketsChannel<BaseMessage> > client_;
+  scoped_ptr<StreamSocketsChannel<BaseMessage> > server_;
+  vector<int64_t> received_;
+  size_t num_expected_;
+};
+
+TEST_F(StreamSocketsChannelTest, SendRecvSync) {
+  Connect();
+  for (int64_t i = 0; i < 3; ++i) {
+    BaseMessage bm;
+    bm.mutable_test()->set_test(i);
+    Envelope<BaseMessage> envelope(&bm);
+    EXPECT_TRUE(client_->SendS(envelope));
+  }
+  for (int64_t i = 0; i < 3; ++i) {
+    Envelope<BaseMessage> envelope;
+    EXPECT_TRUE(server_->RecvS(&envelope));
+    EXPECT_EQ(envelope.data()->test().test(), i);
+  }
+}
+
+TEST_F(StreamSocketsChannelTest, LargeMessageSpansBufferBlocks) {
+  // Use small receive buffer blocks, so that the message is parsed out of a
+  // chain of them.
+  FLAGS_stream_sockets_recv_buffer_size = 1024;
+  Connect();
+  BaseMessage bm;
+  bm.mutable_registration()->set_location(string(100000, 'x'));
+  Envelope<BaseMessage> envelope(&bm);
+  EXPECT_TRUE(client_->SendS(envelope));
+  Envelope<BaseMessage> recv_envelope;
+  EXPECT_TRUE(server_->RecvS(&recv_envelope));
+  EXPECT_EQ(recv_envelope.data()->registration().location(),
+            bm.registration().location());
+}
+
+TEST_F(StreamSocketsChannelTest, OversizedMessageClosesChannel) {
+  FLAGS_stream_sockets_max_message_size = 1024;
+  Connect();
+  BaseMessage bm;
+  bm.mutable_registration()->set_location(string(100000, 'x'));
+  Envelope<BaseMessage> envelope(&bm);
+  EXPECT_TRUE(client_->SendS(envelope));
+  // The receiver must not buffer the claimed size, but give up on the
+  // channel.
+  BaseMessage recv_bm;
+  Envelope<BaseMessage> recv_envelope(&recv_bm);
+  EXPECT_FALSE(server_->RecvS(&recv_envelope));
+  EXPECT_FALSE(server_->Ready());
+}
+
+TEST_F(StreamSocketsChannelTest, BatchedSendRecvSync) {
+  FLAGS_stream_sockets_batching = true;
+  Connect();
+  // Queued messages go out in one write and are decoded from the receive
+  // buffer by successive receives.
+  for (int64_t i = 0; i < 10; ++i) {
+    BaseMessage bm;
+    bm.mutable_test()->set_test(i);
+    Envelope<BaseMessage> envelope(&bm);
+    EXPECT_TRUE(client_->EnqueueS(envelope));
+  }
+  EXPECT_TRUE(client_->FlushS());
+  BaseMessage bm;
+  bm.mutable_test()->set_test(10);
+  Envelope<BaseMessage> last_envelope(&bm);
+  EXPECT_TRUE(client_->SendS(last_envelope));
+  for (int64_t i = 0; i <= 10; ++i) {
+    Envelope<BaseMessage> envelope;
+    EXPECT_TRUE(server_->RecvS(&envelope));
+    EXPECT_EQ(envelope.data()->test().test(), i);
+  }
+}
+
+TEST_F(StreamSocketsChannelTest, BatchedRecvAsync) {
+  FLAGS_stream_sockets_batching = true;
+  Connect();
+  for (int64_t i = 0; i < 5; ++i) {
+    BaseMessage bm;
+    bm.mutable_test()->set_test(i);
+    Envelope<BaseMessage> envelope(&bm);
+    EXPECT_TRUE(client_->EnqueueS(envelope));
+  }
+  EXPECT_TRUE(client_->FlushS());
+  num_expected_ = 5;
+  StartAsyncRecv();
+  while (received_.size() < num_expected_)
+    io_service_->run_one();
+  for (int64_t i = 0; i < 5; ++i)
+    EXPECT_EQ(received_[i], i);
+}
+
+// Queued messages are coalesced: sending many takes far fewer writes than
+// messages, both when the queue fills up and when it is flushed.
+TEST_F(StreamSocketsChannelTest, QueuedMessagesCoalesceWrites) {
+  FLAGS_stream_sockets_batching = true;
+  FLAGS_stream_sockets_batch_max_bytes = 1024;
+  Connect();
+  const int64_t kNumMessages = 200;
+  for (int64_t i = 0; i < kNumMessages; ++i) {
+    BaseMessage bm;
+    bm.mutable_test()->set_test(i);
+    Envelope<BaseMessage> envelope(&bm);
+    EXPECT_TRUE(client_->EnqueueS(envelope));
+  }
+  EXPECT_TRUE(client_->FlushS());
+  EXPECT_GT(client_->num_writes(), 1U);
+  EXPECT_LT(client_->num_writes(), static_cast<uint64_t>(kNumMessages) / 10);
+  for (int64_t i = 0; i < kNumMessages; ++i) {
+    Envelope<BaseMessage> envelope;
+    EXPECT_TRUE(server_->RecvS(&envelope));
+    EXPECT_EQ(envelope.data()->test().test(), i);
+  }
+}
+
+// Without batching, a send still writes out the messages queued before it
+// first, and in the same write.
+TEST_F(StreamSocketsChannelTest, SendFlushesQueuedMessages) {
+  Connect();
+  for (int64_t i = 0; i < 3; ++i) {
+    BaseMessage bm;
+    bm.mutable_test()->set_test(i);
+    Envelope<BaseMessage> envelope(&bm);
+    EXPECT_TRUE(client_->EnqueueS(envelope));
+  }
+  EXPECT_EQ(0U, client_->num_writes());
+  BaseMessage bm;
+  bm.mutable_test()->set_test(3);
+  Envelope<BaseMessage> last_envelope(&bm);
+  EXPECT_TRUE(client_->SendS(last_envelope));
+  EXPECT_EQ(1U, client_->num_writes());
+  for (int64_t i = 0; i <= 3; ++i) {
+    Envelope<BaseMessage> envelope;
+    EXPECT_TRUE(server_->RecvS(&envelope));
+    EXPECT_EQ(envelope.data()->test().test(), i);
+  }
+}
+
+}  // namespace streamsockets
+}  // namespace platform_unix
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitFirmament(argc, argv);
+  return RUN_ALL_TESTS();
+}
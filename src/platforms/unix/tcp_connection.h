@@ -54,8 +54,11 @@ class TCPConnection : public boost::enable_shared_from_this<TCPConnection>,
  public:
   typedef shared_ptr<TCPConnection> connection_ptr;
   explicit TCPConnection(shared_ptr<io_service> io_service)
-      : socket_(*io_service), io_service_(io_service), ready_(false) { }
+      : io_service_(io_service), socket_(*io_service), ready_(false) { }
   virtual ~TCPConnection();
+  shared_ptr<io_service> io_service_ptr() {
+    return io_service_;
+  }
   // XXX(malte): unsafe raw pointer, fix this
   tcp::socket* socket() {
     return &socket_;
@@ -69,8 +72,9 @@ class TCPConnection : public boost::enable_shared_from_this<TCPConnection>,
  private:
   void HandleWrite(const boost::system::error_code& error,
                    size_t bytes_transferred);
-  tcp::socket socket_;
+  // N.B.: the IO service must outlive the socket, so it is declared first.
   shared_ptr<io_service> io_service_;
+  tcp::socket socket_;
   shared_ptr<tcp::endpoint> remote_endpoint_;
   bool ready_;
 };
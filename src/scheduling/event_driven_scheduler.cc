@@ -23,6 +23,9 @@
 
 #include "scheduling/event_driven_scheduler.h"
 
+#include <sys/wait.h>
+
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <set>
@@ -30,6 +33,8 @@
 #include <utility>
 #include <vector>
 
+#include "base/resource_id_interner.h"
+#include "base/task_heartbeat_lock.h"
 #include "base/units.h"
 #include "misc/map-util.h"
 #include "misc/pb_utils.h"
@@ -41,9 +46,13 @@
 #include "storage/object_store_interface.h"
 #include "storage/reference_types.h"
 #include "storage/reference_utils.h"
+#include "storage/shm_object_store.h"
 
 DEFINE_uint64(task_fail_timeout, 60, "Time (in seconds) after which to declare "
               "a task as failed if it has not sent heartbeats");
+DEFINE_bool(prefetch_task_inputs, true, "Warm up the page cache of the "
+            "machine a task is placed on with the task's input files that "
+            "are not held locally, while the task starts up.");
 
 namespace firmament {
 namespace scheduler {
@@ -99,15 +108,51 @@ void EventDrivenScheduler::AddJob(JobDescriptor* jd_ptr) {
   InsertOrUpdate(&jobs_to_schedule_, JobIDFromString(jd_ptr->uuid()), jd_ptr);
 }
 
+void EventDrivenScheduler::AddReplicaEndpointsToDependencies(
+    TaskDescriptor* td_ptr) {
+  // Tasks delegated to us arrive with the delegating coordinator's view of
+  // the replicas, which is more complete than ours.
+  if (!td_ptr->delegated_from().empty())
+    return;
+  for (auto& dependency : *td_ptr->mutable_dependencies()) {
+    dependency.clear_replica_endpoints();
+    list<DataLocation> locations;
+    uint64_t object_size = GetObjectStoreLocations(dependency, &locations);
+    if (locations.empty())
+      continue;
+    if (dependency.size() == 0)
+      dependency.set_size(object_size);
+    for (auto& location : locations) {
+      ResourceStatus* rs =
+        FindPtrOrNull(*resource_map_, location.machine_res_id_);
+      if (rs && !rs->descriptor().storage_engine().empty())
+        dependency.add_replica_endpoints(rs->descriptor().storage_engine());
+    }
+  }
+}
+
 void EventDrivenScheduler::BindTaskToResource(TaskDescriptor* td_ptr,
                                               ResourceDescriptor* rd_ptr) {
-  TaskID_t task_id = td_ptr->uid();
   ResourceID_t res_id = ResourceIDFromString(rd_ptr->uuid());
+  // The resource's status holds a reference on its dense ID.
+  DenseResourceID_t dense_res_id = ResourceIDs()->Lookup(res_id);
+  CHECK_NE(dense_res_id, ResourceIDInterner::kInvalidDenseResourceID);
+  BindTaskToResource(td_ptr, rd_ptr, res_id, dense_res_id);
+}
+
+void EventDrivenScheduler::BindTaskToResource(TaskDescriptor* td_ptr,
+                                              ResourceDescriptor* rd_ptr,
+                                              ResourceID_t res_id,
+                                              DenseResourceID_t dense_res_id) {
+  TaskID_t task_id = td_ptr->uid();
   // Mark resource as busy and record task binding
   rd_ptr->set_state(ResourceDescriptor::RESOURCE_BUSY);
   rd_ptr->add_current_running_tasks(task_id);
   CHECK(InsertIfNotPresent(&task_bindings_, task_id, res_id));
-  resource_bindings_.insert(pair<ResourceID_t, TaskID_t>(res_id, task_id));
+  if (dense_res_id >= resource_bindings_.size()) {
+    resource_bindings_.resize(dense_res_id + 1);
+  }
+  resource_bindings_[dense_res_id].push_back(task_id);
 }
 
 ResourceID_t* EventDrivenScheduler::BoundResourceForTask(TaskID_t task_id) {
@@ -117,20 +162,16 @@ ResourceID_t* EventDrivenScheduler::BoundResourceForTask(TaskID_t task_id) {
 
 vector<TaskID_t> EventDrivenScheduler::BoundTasksForResource(
   ResourceID_t res_id) {
-  vector<TaskID_t> tasks;
-  pair<unordered_multimap<ResourceID_t, TaskID_t,
-                          boost::hash<ResourceID_t>>::iterator,
-       unordered_multimap<ResourceID_t, TaskID_t,
-                          boost::hash<ResourceID_t>>::iterator> range_it =
-    resource_bindings_.equal_range(res_id);
-  for (; range_it.first != range_it.second; range_it.first++) {
-    tasks.push_back(range_it.first->second);
+  DenseResourceID_t dense_res_id = ResourceIDs()->Lookup(res_id);
+  if (dense_res_id >= resource_bindings_.size()) {
+    return vector<TaskID_t>();
   }
-  return tasks;
+  return resource_bindings_[dense_res_id];
 }
 
 void EventDrivenScheduler::CheckRunningTasksHealth() {
   boost::lock_guard<boost::recursive_mutex> lock(scheduling_lock_);
+  HandleFailedTaskProcessExits();
   for (auto& executor : executors_) {
     vector<TaskID_t> failed_tasks;
     if (!executor.second->CheckRunningTasksHealth(&failed_tasks)) {
@@ -138,13 +179,19 @@ void EventDrivenScheduler::CheckRunningTasksHealth() {
       for (auto& failed_task : failed_tasks) {
         TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, failed_task);
         CHECK_NOTNULL(td_ptr);
+        uint64_t last_heartbeat_time;
+        {
+          boost::lock_guard<boost::mutex> lock(
+              *TaskHeartbeatLock(failed_task));
+          last_heartbeat_time = td_ptr->last_heartbeat_time();
+        }
         if (td_ptr->state() != TaskDescriptor::COMPLETED &&
-            td_ptr->last_heartbeat_time() <=
+            last_heartbeat_time <=
             (time_manager_->GetCurrentTimestamp() - FLAGS_task_fail_timeout *
              SECONDS_TO_MICROSECONDS)) {
           LOG(INFO) << "Task " << td_ptr->uid() << " has not reported "
                     << "heartbeats for " << FLAGS_task_fail_timeout
-                    << "s and its handler thread has exited. "
+                    << "s and its process has exited. "
                     << "Declaring it FAILED!";
           HandleTaskFailure(td_ptr);
         }
@@ -170,10 +217,15 @@ void EventDrivenScheduler::CleanStateForDeregisteredResource(
   } else if (rd.type() == ResourceDescriptor::RESOURCE_MACHINE) {
     trace_generator_->RemoveMachine(rd);
   }
-  resource_bindings_.erase(res_id);
   ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
   CHECK_NOTNULL(rs_ptr);
+  DenseResourceID_t dense_res_id = rs_ptr->dense_id();
+  if (dense_res_id < resource_bindings_.size()) {
+    resource_bindings_[dense_res_id].clear();
+  }
   resource_map_->erase(res_id);
+  // Drops the status's reference on the dense ID. The ID is handed out again
+  // once the flow graph and any other holders have released it, too.
   delete rs_ptr;
 }
 
@@ -209,6 +261,8 @@ void EventDrivenScheduler::ExecuteTask(TaskDescriptor* td_ptr,
   // Find an executor for this resource.
   ExecutorInterface* exec = FindPtrOrNull(executors_, res_id);
   CHECK_NOTNULL(exec);
+  AddReplicaEndpointsToDependencies(td_ptr);
+  MarkInputsForPrefetch(td_ptr, rd_ptr);
   // Actually kick off the task
   // N.B. This is an asynchronous call, as the executor will spawn a thread.
   exec->RunTask(td_ptr, !td_ptr->inject_task_lib());
@@ -218,6 +272,25 @@ void EventDrivenScheduler::ExecuteTask(TaskDescriptor* td_ptr,
   VLOG(2) << "Task " << task_id << " running.";
 }
 
+void EventDrivenScheduler::HandleFailedTaskProcessExits() {
+  vector<TaskID_t> failed_tasks;
+  {
+    boost::lock_guard<boost::mutex> lock(failed_exits_lock_);
+    failed_tasks.swap(failed_task_exits_);
+  }
+  for (auto& task_id : failed_tasks) {
+    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, task_id);
+    if (!td_ptr || td_ptr->state() != TaskDescriptor::RUNNING ||
+        !FindOrNull(task_bindings_, task_id)) {
+      // The task has completed, failed or been killed already.
+      continue;
+    }
+    LOG(INFO) << "Process of task " << task_id << " failed. "
+              << "Declaring the task FAILED!";
+    HandleTaskFailure(td_ptr);
+  }
+}
+
 void EventDrivenScheduler::HandleJobCompletion(JobID_t job_id) {
   boost::lock_guard<boost::recursive_mutex> lock(scheduling_lock_);
   JobDescriptor* jd = FindOrNull(*job_map_, job_id);
@@ -226,6 +299,7 @@ void EventDrivenScheduler::HandleJobCompletion(JobID_t job_id) {
   jobs_to_schedule_.erase(job_id);
   runnable_tasks_.erase(job_id);
   jd->set_state(JobDescriptor::COMPLETED);
+  trace_generator_->JobCompleted(*jd);
   if (event_notifier_) {
     event_notifier_->OnJobCompletion(job_id);
   }
@@ -370,6 +444,9 @@ void EventDrivenScheduler::HandleTaskEviction(TaskDescriptor* td_ptr,
   InsertTaskIntoRunnables(JobIDFromString(td_ptr->job_id()), td_ptr->uid());
   CHECK_NOTNULL(exec);
   exec->HandleTaskEviction(td_ptr);
+  // The executor has stopped prefetching the task's inputs, so its progress
+  // is no longer updated.
+  knowledge_base_->EraseInputPrefetchProgress(td_ptr->uid());
   trace_generator_->TaskEvicted(td_ptr->uid(), *rd_ptr, false);
   if (event_notifier_) {
     event_notifier_->OnTaskEviction(td_ptr, rd_ptr);
@@ -397,6 +474,7 @@ void EventDrivenScheduler::HandleTaskFailure(TaskDescriptor* td_ptr) {
   ExecutorInterface* exec_ptr = FindPtrOrNull(executors_, res_id_tmp);
   CHECK_NOTNULL(exec_ptr);
   exec_ptr->HandleTaskFailure(td_ptr);
+  knowledge_base_->EraseInputPrefetchProgress(td_ptr->uid());
   // Remove the task's resource binding (as it is no longer currently bound)
   CHECK(UnbindTaskFromResource(td_ptr, res_id_tmp));
   // Set the task to "failed" state and deal with the consequences
@@ -470,6 +548,31 @@ void EventDrivenScheduler::HandleTaskPlacement(
   }
 }
 
+void EventDrivenScheduler::HandleTaskProcessExit(TaskID_t task_id,
+                                                 int status) {
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    // The task reports its completion itself; if it does not, the health
+    // monitor declares it failed once its heartbeats time out.
+    return;
+  }
+  LOG(INFO) << "Process of task " << task_id << " failed with status "
+            << status << ".";
+  boost::function<void()> notifier;
+  {
+    boost::lock_guard<boost::mutex> lock(failed_exits_lock_);
+    failed_task_exits_.push_back(task_id);
+    notifier = failed_exit_notifier_;
+  }
+  if (notifier)
+    notifier();
+}
+
+void EventDrivenScheduler::SetFailedTaskProcessExitNotifier(
+    boost::function<void()> notifier) {
+  boost::lock_guard<boost::mutex> lock(failed_exits_lock_);
+  failed_exit_notifier_ = notifier;
+}
+
 void EventDrivenScheduler::HandleTaskRemoval(TaskDescriptor* td_ptr) {
   bool was_running = false;
   if (td_ptr->state() == TaskDescriptor::RUNNING) {
@@ -508,11 +611,15 @@ void EventDrivenScheduler::KillRunningTask(
   BaseMessage bm;
   SUBMSG_WRITE(bm, task_kill, task_id, task_id);
   SUBMSG_WRITE(bm, task_kill, reason, reason);
+  string endpoint;
+  {
+    boost::lock_guard<boost::mutex> lock(*TaskHeartbeatLock(task_id));
+    endpoint = td_ptr->last_heartbeat_location();
+  }
   // Send the message
   LOG(INFO) << "Sending KILL message to task " << task_id << " on resource "
-            << *rid << " (endpoint: " << td_ptr->last_heartbeat_location()
-            << ")";
-  m_adapter_ptr_->SendMessageToEndpoint(td_ptr->last_heartbeat_location(), bm);
+            << *rid << " (endpoint: " << endpoint << ")";
+  m_adapter_ptr_->SendMessageToEndpoint(endpoint, bm);
   if (!rid) {
     CHECK(UnbindTaskFromResource(td_ptr, *rid));
   }
@@ -656,6 +763,49 @@ void EventDrivenScheduler::LazyGraphReduction(
   }
 }
 
+void EventDrivenScheduler::MarkInputsForPrefetch(TaskDescriptor* td_ptr,
+                                                 ResourceDescriptor* rd_ptr) {
+  // As with the replica endpoints, the delegating coordinator has decided
+  // already.
+  if (!td_ptr->delegated_from().empty())
+    return;
+  ResourceID_t machine_res_id;
+  bool found_machine = false;
+  for (auto& dependency : *td_ptr->mutable_dependencies()) {
+    dependency.set_prefetch(false);
+    // Objects in the shared memory object stores are fetched in full.
+    ResourceID_t object_res_id;
+    if (!FLAGS_prefetch_task_inputs || dependency.location().empty() ||
+        store::ShmObjectStore::MachineForLocation(dependency.location(),
+                                                  &object_res_id)) {
+      continue;
+    }
+    if (!found_machine) {
+      machine_res_id = MachineResIDForResource(
+          resource_map_, ResourceIDFromString(rd_ptr->uuid()));
+      found_machine = true;
+    }
+    list<DataLocation> locations;
+    if (data_layer_manager_)
+      data_layer_manager_->GetFileLocations(dependency.location(), &locations);
+    unordered_set<uint64_t> local_blocks;
+    for (auto& location : locations) {
+      if (location.machine_res_id_ == machine_res_id)
+        local_blocks.insert(location.block_id_);
+    }
+    // Inputs that the data layer does not know about may still be on a
+    // shared file system, so they are prefetched as well.
+    bool all_blocks_local = !locations.empty();
+    for (auto& location : locations) {
+      if (local_blocks.find(location.block_id_) == local_blocks.end()) {
+        all_blocks_local = false;
+        break;
+      }
+    }
+    dependency.set_prefetch(!all_blocks_local);
+  }
+}
+
 bool EventDrivenScheduler::PlaceDelegatedTask(TaskDescriptor* td,
                                               ResourceID_t target_resource) {
   // Check if the resource is available
@@ -744,6 +894,13 @@ void EventDrivenScheduler::RegisterLocalResource(ResourceID_t res_id) {
   VLOG(1) << "Adding executor for local resource " << res_id;
   LocalExecutor* exec = new LocalExecutor(res_id, coordinator_uri_,
                                           time_manager_, topology_manager_);
+  exec->SetTaskStatsHandler(boost::bind(&KnowledgeBase::AddTaskStatsSample,
+                                        knowledge_base_.get(), _1));
+  exec->SetInputPrefetchHandler(
+      boost::bind(&KnowledgeBase::UpdateInputPrefetchProgress,
+                  knowledge_base_.get(), _1, _2, _3));
+  exec->SetTaskExitHandler(
+      boost::bind(&EventDrivenScheduler::HandleTaskProcessExit, this, _1, _2));
   CHECK(InsertIfNotPresent(&executors_, res_id, exec));
 }
 
@@ -758,6 +915,32 @@ void EventDrivenScheduler::RegisterResource(
                             local, simulated));
 }
 
+void EventDrivenScheduler::RestoreJob(JobDescriptor* jd_ptr) {
+  boost::lock_guard<boost::recursive_mutex> lock(scheduling_lock_);
+  AddJob(jd_ptr);
+  RestoreTaskBindings(jd_ptr->mutable_root_task(), NULL);
+}
+
+void EventDrivenScheduler::RestoreTaskBindings(
+    TaskDescriptor* td_ptr,
+    vector<TaskDescriptor*>* running_tasks) {
+  if (td_ptr->state() == TaskDescriptor::RUNNING) {
+    ResourceID_t res_id =
+      ResourceIDFromString(td_ptr->scheduled_to_resource());
+    ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
+    CHECK_NOTNULL(rs_ptr);
+    VLOG(1) << "Restoring binding of task " << td_ptr->uid()
+            << " to resource " << res_id;
+    BindTaskToResource(td_ptr, rs_ptr->mutable_descriptor(), res_id,
+                       rs_ptr->dense_id());
+    if (running_tasks)
+      running_tasks->push_back(td_ptr);
+  }
+  for (auto& spawned_td : *td_ptr->mutable_spawned()) {
+    RestoreTaskBindings(&spawned_td, running_tasks);
+  }
+}
+
 void EventDrivenScheduler::RegisterRemoteResource(ResourceID_t res_id) {
   // Create an executor for each resource.
   VLOG(1) << "Adding executor for remote resource " << res_id;
@@ -863,16 +1046,17 @@ bool EventDrivenScheduler::UnbindTaskFromResource(TaskDescriptor* td_ptr,
   }
   ResourceID_t* res_id_ptr = FindOrNull(task_bindings_, task_id);
   if (res_id_ptr) {
-    pair<unordered_multimap<ResourceID_t, TaskID_t,
-                            boost::hash<ResourceID_t>>::iterator,
-         unordered_multimap<ResourceID_t, TaskID_t,
-                            boost::hash<ResourceID_t>>::iterator>
-      range_it = resource_bindings_.equal_range(*res_id_ptr);
-    for (; range_it.first != range_it.second; range_it.first++) {
-      if (range_it.first->second == task_id) {
+    // The task is normally unbound from the resource it is bound to, whose
+    // status we hold already.
+    DenseResourceID_t dense_res_id = *res_id_ptr == res_id ?
+      rs_ptr->dense_id() : ResourceIDs()->Lookup(*res_id_ptr);
+    if (dense_res_id < resource_bindings_.size()) {
+      vector<TaskID_t>* tasks = &resource_bindings_[dense_res_id];
+      vector<TaskID_t>::iterator it =
+        find(tasks->begin(), tasks->end(), task_id);
+      if (it != tasks->end()) {
         // We've found the element.
-        resource_bindings_.erase(range_it.first);
-        break;
+        tasks->erase(it);
       }
     }
     return task_bindings_.erase(task_id) == 1;
@@ -920,6 +1104,33 @@ void EventDrivenScheduler::UpdateRackBlocks(
 }
 
 
+uint64_t EventDrivenScheduler::GetObjectStoreLocations(
+    const ReferenceDescriptor& dependency,
+    list<DataLocation>* locations) {
+  unordered_set<ReferenceInterface*>* refs =
+    object_store_->GetReferences(DataObjectIDFromProtobuf(dependency.id()));
+  if (!refs)
+    return 0;
+  uint64_t object_size = 0;
+  for (auto& ref : *refs) {
+    ReferenceDescriptor rd = ref->desc();
+    ResourceID_t machine_res_id;
+    if (rd.type() != ReferenceDescriptor::CONCRETE ||
+        !store::ShmObjectStore::MachineForLocation(rd.location(),
+                                                   &machine_res_id))
+      continue;
+    EquivClass_t rack_id = 0;
+    if (data_layer_manager_)
+      rack_id = data_layer_manager_->GetRackForMachine(machine_res_id);
+    // Each copy of an object counts as a single block.
+    locations->push_back(DataLocation(machine_res_id, rack_id,
+                                      boost::hash<string>()(rd.id()),
+                                      rd.size()));
+    object_size = rd.size();
+  }
+  return object_size;
+}
+
 uint64_t EventDrivenScheduler::ComputeClusterDataStatistics(
     TaskDescriptor& td_ptr,
     unordered_map<ResourceID_t, uint64_t,
@@ -938,12 +1149,20 @@ uint64_t EventDrivenScheduler::ComputeClusterDataStatistics(
        ++dependency_it) {
     auto& dependency = *dependency_it;
     string location = dependency->location();
+    list<DataLocation> locations;
+    // Objects produced by other tasks are located through the object store;
+    // everything else is a file in the data layer.
+    uint64_t object_size = GetObjectStoreLocations(*dependency, &locations);
     if (dependency->size() == 0) {
-      dependency->set_size(data_layer_manager_->GetFileSize(location));
+      if (object_size > 0) {
+        dependency->set_size(object_size);
+      } else {
+        dependency->set_size(data_layer_manager_->GetFileSize(location));
+      }
     }
     input_size += dependency->size();
-    list<DataLocation> locations;
-    data_layer_manager_->GetFileLocations(location, &locations);
+    if (locations.empty())
+      data_layer_manager_->GetFileLocations(location, &locations);
     for (auto& location : locations) {
       UpdateMachineBlocks(location, &blocks_on_machines);
       UpdateRackBlocks(location, &blocks_on_racks);
@@ -90,6 +90,7 @@ class EventDrivenScheduler : public SchedulerInterface {
   virtual void RegisterResource(ResourceTopologyNodeDescriptor* rtnd_ptr,
                                 bool local,
                                 bool simulated);
+  virtual void RestoreJob(JobDescriptor* jd_ptr);
   // N.B. ScheduleJob must be implemented in scheduler-specific logic
   virtual uint64_t ScheduleAllJobs(SchedulerStats* scheduler_stats) = 0;
   virtual uint64_t ScheduleAllJobs(SchedulerStats* scheduler_stats,
@@ -99,6 +100,8 @@ class EventDrivenScheduler : public SchedulerInterface {
   virtual uint64_t ScheduleJobs(const vector<JobDescriptor*>& jds_ptr,
                                 SchedulerStats* scheduler_stats,
                                 vector<SchedulingDelta>* deltas = NULL) = 0;
+  virtual void SetFailedTaskProcessExitNotifier(
+      boost::function<void()> notifier);
   virtual ostream& ToString(ostream* stream) const {
     return *stream << "<EventDrivenScheduler>";
   }
@@ -108,6 +111,15 @@ class EventDrivenScheduler : public SchedulerInterface {
       unordered_map<ResourceID_t, uint64_t,
         boost::hash<ResourceID_t>>* data_on_machines,
       unordered_map<EquivClass_t, uint64_t>* data_on_racks);
+  /**
+   * Finds the machines whose shared memory object stores hold a copy of an
+   * object published by a task.
+   * @param dependency the reference to the object
+   * @param locations the list to which the copies' locations are appended
+   * @return the size of the object, or 0 if no copy is known
+   */
+  uint64_t GetObjectStoreLocations(const ReferenceDescriptor& dependency,
+                                   list<DataLocation>* locations);
   void UpdateMachineBlocks(
       const DataLocation& location,
       unordered_map<ResourceID_t, unordered_map<uint64_t, uint64_t>,
@@ -127,11 +139,42 @@ class EventDrivenScheduler : public SchedulerInterface {
   FRIEND_TEST(FulcrumSchedulerTest, FindRunnableTasksForJob);
   FRIEND_TEST(FulcrumSchedulerTest, FindRunnableTasksForComplexJob);
   FRIEND_TEST(FulcrumSchedulerTest, FindRunnableTasksForComplexJob2);
+  FRIEND_TEST(SimpleSchedulerTest, TaskProcessFailsDuringPlacement);
+  /**
+   * Records, on each of a task's dependencies, the object transfer endpoints
+   * of the machines holding a copy of the object, so that the executor can
+   * fetch missing inputs while the task starts up.
+   * @param td_ptr the descriptor of the task being placed
+   */
+  void AddReplicaEndpointsToDependencies(TaskDescriptor* td_ptr);
   void BindTaskToResource(TaskDescriptor* td_ptr, ResourceDescriptor* rd_ptr);
+  /**
+   * As above, for callers that already know the resource's ID and dense ID
+   * (e.g., from its ResourceStatus), which saves parsing the UUID and the
+   * interner lookup.
+   */
+  void BindTaskToResource(TaskDescriptor* td_ptr, ResourceDescriptor* rd_ptr,
+                          ResourceID_t res_id, DenseResourceID_t dense_res_id);
   void CleanStateForDeregisteredResource(
       ResourceTopologyNodeDescriptor* rtnd_ptr);
   void DebugPrintRunnableTasks();
   void ExecuteTask(TaskDescriptor* td_ptr, ResourceDescriptor* rd_ptr);
+  /**
+   * Fails the tasks whose process exits were queued by HandleTaskProcessExit.
+   * Must be called with scheduling_lock_ held.
+   */
+  void HandleFailedTaskProcessExits();
+  /**
+   * Handles the exit of a local task's process, as reported by its executor
+   * on the supervisor thread. The thread placing tasks blocks on the
+   * supervisor while holding scheduling_lock_, so this does not take it:
+   * tasks whose process failed are queued, the failed exit notifier is told,
+   * and the next health check declares them FAILED; tasks that exited cleanly
+   * are expected to report their completion.
+   * @param task_id the id of the task
+   * @param status the wait(2) status of the task's process
+   */
+  void HandleTaskProcessExit(TaskID_t task_id, int status);
   virtual void HandleTaskMigration(TaskDescriptor* td_ptr,
                                    ResourceDescriptor* rd_ptr);
   virtual void HandleTaskPlacement(TaskDescriptor* td_ptr,
@@ -140,6 +183,14 @@ class EventDrivenScheduler : public SchedulerInterface {
   void LazyGraphReduction(const unordered_set<DataObjectID_t*>& output_ids,
                           TaskDescriptor* root_task,
                           const JobID_t& job_id);
+  /**
+   * Marks the file inputs of a task for prefetching unless the data layer
+   * reports all of their blocks on the machine the task is placed on.
+   * @param td_ptr the descriptor of the task being placed
+   * @param rd_ptr the descriptor of the resource the task is placed on
+   */
+  void MarkInputsForPrefetch(TaskDescriptor* td_ptr,
+                             ResourceDescriptor* rd_ptr);
   unordered_set<TaskDescriptor*> ProducingTasksForDataObjectID(
       const DataObjectID_t& id,
       const JobID_t& cur_job);
@@ -156,6 +207,16 @@ class EventDrivenScheduler : public SchedulerInterface {
   void RemoveResourceNodeFromParentChildrenList(
       ResourceTopologyNodeDescriptor* rtnd_ptr);
 
+  /**
+   * Binds the restored task and its spawned tasks to the resources they were
+   * running on when the checkpoint was taken.
+   * @param td_ptr the task descriptor of the restored task
+   * @param running_tasks vector to which the running tasks are appended, or
+   * NULL if the caller does not need them
+   */
+  void RestoreTaskBindings(TaskDescriptor* td_ptr,
+                           vector<TaskDescriptor*>* running_tasks);
+
   const unordered_set<TaskID_t>& ComputeRunnableTasksForJob(
       JobDescriptor* job_desc);
   void SetupPUs(ResourceTopologyNodeDescriptor* rtnd_ptr,
@@ -191,11 +252,16 @@ class EventDrivenScheduler : public SchedulerInterface {
   // A lock indicating if the scheduler is currently
   // in the process of making scheduling decisions.
   boost::recursive_mutex scheduling_lock_;
+  // Tasks whose process failed, reported by the supervisor thread and not
+  // handled yet; guarded by failed_exits_lock_.
+  boost::mutex failed_exits_lock_;
+  vector<TaskID_t> failed_task_exits_;
+  boost::function<void()> failed_exit_notifier_;
   // Map of reference subscriptions
   map<DataObjectID_t, unordered_set<TaskDescriptor*>> reference_subscriptions_;
-  // The current resource to task bindings managed by this scheduler.
-  unordered_multimap<ResourceID_t, TaskID_t, boost::hash<ResourceID_t>>
-    resource_bindings_;
+  // The current resource to task bindings managed by this scheduler, indexed
+  // by the resources' dense IDs (see base/resource_id_interner.h).
+  vector<vector<TaskID_t>> resource_bindings_;
   // The current task bindings managed by this scheduler.
   unordered_map<TaskID_t, ResourceID_t> task_bindings_;
   // Pointer to the coordinator's topology manager
@@ -0,0 +1,97 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Initialization code for the scheduler service binary.
+
+#include <signal.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <chrono>
+
+#include "platforms/unix/signal_handler.h"
+#include "scheduling/firmament_scheduler_service.h"
+
+using grpc::Server;
+using grpc::ServerBuilder;
+using grpc::ServerCompletionQueue;
+
+using namespace firmament;  // NOLINT
+
+// Set when the service receives SIGINT or SIGTERM.
+static volatile sig_atomic_t exit_ = 0;
+
+static void HandleSignal(int signum) {
+  exit_ = 1;
+}
+
+// Blocks until the service is asked to exit, then shuts the server down.
+// Calls that are still running after a second are cancelled.
+static void WaitForExit(Server* server) {
+  while (!exit_) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  }
+  LOG(INFO) << "Firmament scheduler shutting down ...";
+  server->Shutdown(std::chrono::system_clock::now() +
+                   std::chrono::seconds(1));
+}
+
+int main(int argc, char *argv[]) {
+  VLOG(1) << "Calling common::InitFirmament";
+  common::InitFirmament(argc, argv);
+  platform_unix::SignalHandler handler;
+  handler.ConfigureSignal(SIGINT, HandleSignal, NULL);
+  handler.ConfigureSignal(SIGTERM, HandleSignal, NULL);
+  std::string server_address(FLAGS_firmament_scheduler_service_address + ":" +
+                             FLAGS_firmament_scheduler_service_port);
+  LOG(INFO) << "Firmament scheduler starting ...";
+  ServerBuilder builder;
+  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+  if (FLAGS_scheduler_service_async) {
+    FirmamentSchedulerAsyncServiceImpl scheduler;
+    builder.RegisterService(&scheduler);
+    std::unique_ptr<ServerCompletionQueue> event_cq =
+      builder.AddCompletionQueue();
+    std::unique_ptr<ServerCompletionQueue> schedule_cq =
+      builder.AddCompletionQueue();
+    if (FLAGS_scheduler_service_background_rounds)
+      scheduler.StartSchedulingRounds();
+    std::unique_ptr<Server> server(builder.BuildAndStart());
+    LOG(INFO) << "Firmament scheduler listening on " << server_address
+              << " (async)";
+    boost::thread serving(
+        boost::bind(&FirmamentSchedulerAsyncServiceImpl::Run, &scheduler,
+                    event_cq.get(), schedule_cq.get()));
+    WaitForExit(server.get());
+    // The completion queues may only be shut down after the server.
+    event_cq->Shutdown();
+    schedule_cq->Shutdown();
+    serving.join();
+    return 0;
+  }
+  FirmamentSchedulerServiceImpl scheduler;
+  builder.RegisterService(&scheduler);
+  if (FLAGS_scheduler_service_background_rounds)
+    scheduler.StartSchedulingRounds();
+  std::unique_ptr<Server> server(builder.BuildAndStart());
+  LOG(INFO) << "Firmament scheduler listening on " << server_address;
+  WaitForExit(server.get());
+  return 0;
+}
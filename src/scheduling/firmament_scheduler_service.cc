@@ -18,35 +18,31 @@
  * permissions and limitations under the License.
  */
 
+// The scheduler service that integrations (e.g. Poseidon) use to drive
+// Firmament over gRPC.
+
+#include "scheduling/firmament_scheduler_service.h"
+
+#include <boost/bind.hpp>
 #include <grpc++/grpc++.h>
 
-#include "base/resource_status.h"
-#include "base/resource_topology_node_desc.pb.h"
 #include "base/units.h"
 #include "misc/map-util.h"
 #include "misc/pb_utils.h"
-#include "misc/trace_generator.h"
 #include "misc/utils.h"
-#include "misc/wall_time.h"
-#include "platforms/sim/simulated_messaging_adapter.h"
-#include "scheduling/firmament_scheduler.grpc.pb.h"
-#include "scheduling/firmament_scheduler.pb.h"
 #include "scheduling/flow/flow_scheduler.h"
-#include "scheduling/knowledge_base_populator.h"
-#include "scheduling/scheduler_interface.h"
-#include "scheduling/scheduling_delta.pb.h"
 #include "scheduling/simple/simple_scheduler.h"
 #include "scheduling/fulcrum_c/fulcrum_c_scheduler.h"
-#include "storage/simple_object_store.h"
 
-using grpc::Server;
-using grpc::ServerBuilder;
+using grpc::CompletionQueue;
+using grpc::ServerAsyncResponseWriter;
+using grpc::ServerCompletionQueue;
 using grpc::ServerContext;
+using grpc::ServerReader;
+using grpc::ServerWriter;
 using grpc::Status;
 
 using firmament::scheduler::FlowScheduler;
-using firmament::scheduler::ObjectStoreInterface;
-using firmament::scheduler::SchedulerInterface;
 using firmament::scheduler::SchedulerStats;
 using firmament::scheduler::SimpleScheduler;
 using firmament::scheduler::FulcrumScheduler;
@@ -58,451 +54,980 @@ DEFINE_string(firmament_scheduler_service_address, "127.0.0.1",
 DEFINE_string(firmament_scheduler_service_port, "9090",
               "The port of the scheduler service");
 DEFINE_string(service_scheduler, "flow", "Scheduler to use: flow | simple | fulcrum_c");
+DEFINE_bool(scheduler_service_async, false,
+            "Serve task and node events from completion queues, and apply "
+            "them between scheduling rounds instead of blocking on them. "
+            "Event calls are then answered with TASK_ACCEPTED or "
+            "NODE_ACCEPTED, and stats calls with TASK_STATS_ACCEPTED or "
+            "NODE_STATS_ACCEPTED.");
+DEFINE_bool(scheduler_service_background_rounds, false,
+            "Run scheduling rounds continuously on a background thread instead "
+            "of only when a client calls Schedule.");
+DEFINE_uint64(scheduler_service_round_event_threshold, 100,
+              "Number of task and node events that trigger a background "
+              "scheduling round. 0 disables the event trigger.");
+DEFINE_uint64(scheduler_service_round_interval_ms, 1000,
+              "Maximum time between background scheduling rounds.");
+DEFINE_bool(scheduler_service_back_to_back_rounds, false,
+            "Start the next background scheduling round as soon as the "
+            "previous one finishes if any events arrived during it.");
+DEFINE_uint64(scheduler_service_stats_batch_size, 256,
+              "Number of streamed stats samples that are applied at once.");
+DEFINE_uint64(scheduler_service_max_pending_deltas, 1024,
+              "Number of scheduling rounds a WatchSchedulingDeltas stream may "
+              "fall behind before it is terminated.");
 
 namespace firmament {
 
-class FirmamentSchedulerServiceImpl final :
-  public FirmamentScheduler::Service {
-
-  public:
-  FirmamentSchedulerServiceImpl() {
-    LOG(INFO) << "FirmamentSchedulerServiceImpl invoked ";
-    job_map_.reset(new JobMap_t);
-    task_map_.reset(new TaskMap_t);
-    resource_map_.reset(new ResourceMap_t);
-    knowledge_base_.reset(new KnowledgeBase);
-    topology_manager_.reset(new TopologyManager);
-    ResourceStatus* top_level_res_status = CreateTopLevelResource();
-    top_level_res_id_ =
-      ResourceIDFromString(top_level_res_status->descriptor().uuid());
-    sim_messaging_adapter_ = new SimulatedMessagingAdapter<BaseMessage>();
-    trace_generator_ = new TraceGenerator(&wall_time_);
-    LOG(INFO) << "Initial Resource map size: "<<resource_map_->size();
-    if (FLAGS_service_scheduler == "flow") {
-      scheduler_ =
-        new FlowScheduler(job_map_, resource_map_,
+FirmamentSchedulerServiceImpl::FirmamentSchedulerServiceImpl()
+  : ingest_queue_(1024), num_events_since_round_(0),
+    stop_scheduling_rounds_(false) {
+  LOG(INFO) << "FirmamentSchedulerServiceImpl invoked ";
+  job_map_.reset(new JobMap_t);
+  task_map_.reset(new TaskMap_t);
+  resource_map_.reset(new ResourceMap_t);
+  knowledge_base_.reset(new KnowledgeBase);
+  topology_manager_.reset(new TopologyManager);
+  ResourceStatus* top_level_res_status = CreateTopLevelResource();
+  top_level_res_id_ =
+    ResourceIDFromString(top_level_res_status->descriptor().uuid());
+  sim_messaging_adapter_ = new SimulatedMessagingAdapter<BaseMessage>();
+  trace_generator_ = new TraceGenerator(&wall_time_);
+  LOG(INFO) << "Initial Resource map size: "<<resource_map_->size();
+  if (FLAGS_service_scheduler == "flow") {
+    scheduler_ =
+      new FlowScheduler(job_map_, resource_map_,
+                        top_level_res_status->mutable_topology_node(),
+                        obj_store_, task_map_, knowledge_base_,
+                        topology_manager_, sim_messaging_adapter_, NULL,
+                        top_level_res_id_, "", &wall_time_, trace_generator_);
+  } else if (FLAGS_service_scheduler == "simple") {
+    scheduler_ =
+      new SimpleScheduler(job_map_, resource_map_,
                           top_level_res_status->mutable_topology_node(),
                           obj_store_, task_map_, knowledge_base_,
                           topology_manager_, sim_messaging_adapter_, NULL,
-                          top_level_res_id_, "", &wall_time_, trace_generator_);
-    } else if (FLAGS_service_scheduler == "simple") {
-      scheduler_ =
-        new SimpleScheduler(job_map_, resource_map_,
-                            top_level_res_status->mutable_topology_node(),
-                            obj_store_, task_map_, knowledge_base_,
-                            topology_manager_, sim_messaging_adapter_, NULL,
-                            top_level_res_id_, "", &wall_time_,
-                            trace_generator_);
-    } else if (FLAGS_service_scheduler == "fulcrum_c") {
-      scheduler_ =
-        new FulcrumScheduler(job_map_, resource_map_,
-                            top_level_res_status->mutable_topology_node(),
-                            obj_store_, task_map_, knowledge_base_,
-                            topology_manager_, sim_messaging_adapter_, NULL,
-                            top_level_res_id_, "", &wall_time_,
-                            trace_generator_);
-    } else {
-      LOG(FATAL) << "Flag specifies unknown scheduler "
-                 << FLAGS_service_scheduler;
-    }
-
-    kb_populator_ = new KnowledgeBasePopulator(knowledge_base_);
+                          top_level_res_id_, "", &wall_time_,
+                          trace_generator_);
+  } else if (FLAGS_service_scheduler == "fulcrum_c") {
+    scheduler_ =
+      new FulcrumScheduler(job_map_, resource_map_,
+                          top_level_res_status->mutable_topology_node(),
+                          obj_store_, task_map_, knowledge_base_,
+                          topology_manager_, sim_messaging_adapter_, NULL,
+                          top_level_res_id_, "", &wall_time_,
+                          trace_generator_);
+  } else {
+    LOG(FATAL) << "Flag specifies unknown scheduler "
+               << FLAGS_service_scheduler;
   }
 
-  ~FirmamentSchedulerServiceImpl() {
-    delete scheduler_;
-    delete sim_messaging_adapter_;
-    delete trace_generator_;
-    delete kb_populator_;
+  kb_populator_ = new KnowledgeBasePopulator(knowledge_base_);
+}
+
+FirmamentSchedulerServiceImpl::~FirmamentSchedulerServiceImpl() {
+  if (scheduling_thread_) {
+    {
+      boost::lock_guard<boost::mutex> lock(round_wait_lock_);
+      stop_scheduling_rounds_ = true;
+    }
+    round_cond_.notify_one();
+    scheduling_thread_->join();
+  }
+  boost::function<void()>* event;
+  while (ingest_queue_.pop(event)) {
+    delete event;
   }
+  delete scheduler_;
+  delete sim_messaging_adapter_;
+  delete trace_generator_;
+  delete kb_populator_;
+}
+
+void FirmamentSchedulerServiceImpl::HandlePlacementDelta(
+    const SchedulingDelta& delta) {
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, delta.task_id());
+  CHECK_NOTNULL(td_ptr);
+  td_ptr->set_start_time(wall_time_.GetCurrentTimestamp());
+}
+
+void FirmamentSchedulerServiceImpl::HandlePreemptionDelta(
+    const SchedulingDelta& delta) {
+  // TODO(ionel): Implement!
+}
+
+void FirmamentSchedulerServiceImpl::HandleMigrationDelta(
+    const SchedulingDelta& delta) {
+  // TODO(ionel): Implement!
+}
+
+Status FirmamentSchedulerServiceImpl::Schedule(ServerContext* context,
+                                               const ScheduleRequest* request,
+                                               SchedulingDeltas* reply) {
+  ScheduleRound(reply);
+  return Status::OK;
+}
 
-  void HandlePlacementDelta(const SchedulingDelta& delta) {
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, delta.task_id());
-    CHECK_NOTNULL(td_ptr);
-    td_ptr->set_start_time(wall_time_.GetCurrentTimestamp());
+void FirmamentSchedulerServiceImpl::ScheduleRound(SchedulingDeltas* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  // This round consumes every event applied so far; events applied after we
+  // release the lock count towards the next one.
+  num_events_since_round_ = 0;
+  SchedulerStats sstat;
+  vector<SchedulingDelta> deltas;
+  scheduler_->ScheduleAllJobs(&sstat, &deltas);
+  // Extract results
+  LOG(INFO) << "Got " << deltas.size() << " scheduling deltas";
+  for (auto& d : deltas) {
+    LOG(INFO) << "Delta: " << d.DebugString();
+    SchedulingDelta* ret_delta = reply->add_deltas();
+    ret_delta->CopyFrom(d);
+    if (d.type() == SchedulingDelta::PLACE) {
+      HandlePlacementDelta(d);
+    } else if (d.type() == SchedulingDelta::PREEMPT) {
+      HandlePreemptionDelta(d);
+    } else if (d.type() == SchedulingDelta::MIGRATE) {
+      HandleMigrationDelta(d);
+    } else if (d.type() == SchedulingDelta::NOOP) {
+      // We do not have to do anything.
+    } else {
+      LOG(FATAL) << "Encountered unsupported scheduling delta of type "
+                 << to_string(d.type());
+    }
   }
+  PublishSchedulingDeltas(*reply);
+}
 
-  void HandlePreemptionDelta(const SchedulingDelta& delta)
+void FirmamentSchedulerServiceImpl::StartSchedulingRounds() {
+  CHECK(!scheduling_thread_);
+  scheduling_thread_.reset(new boost::thread(
+      boost::bind(&FirmamentSchedulerServiceImpl::RunSchedulingRounds,
+                  this)));
+}
+
+Status FirmamentSchedulerServiceImpl::TaskCompleted(
+    ServerContext* context, const TaskUID* tid_ptr,
+    TaskCompletedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  TaskCompletedWithLockHeld(tid_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::TaskCompletedWithLockHeld(
+    const TaskUID* tid_ptr, TaskCompletedResponse* reply) {
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
+  if (td_ptr == NULL) {
+    reply->set_type(TaskReplyType::TASK_NOT_FOUND);
+    return;
+  }
+  JobID_t job_id = JobIDFromString(td_ptr->job_id());
+  JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
+  if (jd_ptr == NULL)
   {
-    // TODO(ionel): Implement!
+    reply->set_type(TaskReplyType::TASK_JOB_NOT_FOUND);
+    return;
+  }
+  td_ptr->set_finish_time(wall_time_.GetCurrentTimestamp());
+  TaskFinalReport report;
+  scheduler_->HandleTaskCompletion(td_ptr, &report);
+  kb_populator_->PopulateTaskFinalReport(*td_ptr, &report);
+  scheduler_->HandleTaskFinalReport(report, td_ptr);
+  // Check if it was the last task of the job.
+  uint64_t* num_incomplete_tasks =
+    FindOrNull(job_num_incomplete_tasks_, job_id);
+  CHECK_NOTNULL(num_incomplete_tasks);
+  CHECK_GE(*num_incomplete_tasks, 1);
+  (*num_incomplete_tasks)--;
+  if (*num_incomplete_tasks == 0) {
+    scheduler_->HandleJobCompletion(job_id);
   }
+  RecordSchedulingEvent();
+  reply->set_type(TaskReplyType::TASK_COMPLETED_OK);
+}
 
-  void HandleMigrationDelta(const SchedulingDelta& delta)
-  {
-    // TODO(ionel): Implement!
-  }
-
-  Status Schedule(ServerContext* context,
-                  const ScheduleRequest* request,
-                  SchedulingDeltas* reply) override {
-    SchedulerStats sstat;
-    vector<SchedulingDelta> deltas;
-    scheduler_->ScheduleAllJobs(&sstat, &deltas);
-    // Extract results
-    LOG(INFO) << "Got " << deltas.size() << " scheduling deltas";
-    for (auto& d : deltas) {
-      LOG(INFO) << "Delta: " << d.DebugString();
-      SchedulingDelta* ret_delta = reply->add_deltas();
-      ret_delta->CopyFrom(d);
-      if (d.type() == SchedulingDelta::PLACE) {
-        HandlePlacementDelta(d);
-      } else if (d.type() == SchedulingDelta::PREEMPT) {
-        HandlePreemptionDelta(d);
-      } else if (d.type() == SchedulingDelta::MIGRATE) {
-        HandleMigrationDelta(d);
-      } else if (d.type() == SchedulingDelta::NOOP) {
-        // We do not have to do anything.
-      } else {
-        LOG(FATAL) << "Encountered unsupported scheduling delta of type "
-                   << to_string(d.type());
-      }
-    }
-    return Status::OK;
+Status FirmamentSchedulerServiceImpl::TaskFailed(ServerContext* context,
+                                                 const TaskUID* tid_ptr,
+                                                 TaskFailedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  TaskFailedWithLockHeld(tid_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::TaskFailedWithLockHeld(
+    const TaskUID* tid_ptr, TaskFailedResponse* reply) {
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
+  if (td_ptr == NULL) {
+    reply->set_type(TaskReplyType::TASK_NOT_FOUND);
+    return;
   }
+  scheduler_->HandleTaskFailure(td_ptr);
+  RecordSchedulingEvent();
+  reply->set_type(TaskReplyType::TASK_FAILED_OK);
+}
 
-  Status TaskCompleted(ServerContext* context,
-                       const TaskUID* tid_ptr,
-                       TaskCompletedResponse* reply) override {
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
-    if (td_ptr == NULL) {
-      reply->set_type(TaskReplyType::TASK_NOT_FOUND);
-      return Status::OK;
-    }
-    JobID_t job_id = JobIDFromString(td_ptr->job_id());
-    JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
-    if (jd_ptr == NULL)
-    {
-      reply->set_type(TaskReplyType::TASK_JOB_NOT_FOUND);
-      return Status::OK;
-    }
-    td_ptr->set_finish_time(wall_time_.GetCurrentTimestamp());
-    TaskFinalReport report;
-    scheduler_->HandleTaskCompletion(td_ptr, &report);
-    kb_populator_->PopulateTaskFinalReport(*td_ptr, &report);
-    scheduler_->HandleTaskFinalReport(report, td_ptr);
-    // Check if it was the last task of the job.
+Status FirmamentSchedulerServiceImpl::TaskRemoved(ServerContext* context,
+                                                  const TaskUID* tid_ptr,
+                                                  TaskRemovedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  TaskRemovedWithLockHeld(tid_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::TaskRemovedWithLockHeld(
+    const TaskUID* tid_ptr, TaskRemovedResponse* reply) {
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
+  if (td_ptr == NULL) {
+    reply->set_type(TaskReplyType::TASK_NOT_FOUND);
+    return;
+  }
+  scheduler_->HandleTaskRemoval(td_ptr);
+  JobID_t job_id = JobIDFromString(td_ptr->job_id());
+  JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
+  CHECK_NOTNULL(jd_ptr);
+  // Don't remove the root task so that tasks can still be appended to
+  // the job. We only remove the root task when the job completes.
+  if (td_ptr != jd_ptr->mutable_root_task()) {
+    task_map_->erase(td_ptr->uid());
+  }
+  uint64_t* num_tasks_to_remove =
+    FindOrNull(job_num_tasks_to_remove_, job_id);
+  CHECK_NOTNULL(num_tasks_to_remove);
+  (*num_tasks_to_remove)--;
+  if (*num_tasks_to_remove == 0) {
     uint64_t* num_incomplete_tasks =
       FindOrNull(job_num_incomplete_tasks_, job_id);
-    CHECK_NOTNULL(num_incomplete_tasks);
-    CHECK_GE(*num_incomplete_tasks, 1);
-    (*num_incomplete_tasks)--;
-    if (*num_incomplete_tasks == 0) {
-      scheduler_->HandleJobCompletion(job_id);
+    if (*num_incomplete_tasks > 0) {
+      scheduler_->HandleJobRemoval(job_id);
     }
-    reply->set_type(TaskReplyType::TASK_COMPLETED_OK);
-    return Status::OK;
+    // Delete the job because we removed its last task.
+    task_map_->erase(jd_ptr->root_task().uid());
+    job_map_->erase(job_id);
+    job_num_incomplete_tasks_.erase(job_id);
+    job_num_tasks_to_remove_.erase(job_id);
   }
+  RecordSchedulingEvent();
+  reply->set_type(TaskReplyType::TASK_REMOVED_OK);
+}
 
-  Status TaskFailed(ServerContext* context,
-                    const TaskUID* tid_ptr,
-                    TaskFailedResponse* reply) override {
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
-    if (td_ptr == NULL) {
-      reply->set_type(TaskReplyType::TASK_NOT_FOUND);
-      return Status::OK;
-    }
-    scheduler_->HandleTaskFailure(td_ptr);
-    reply->set_type(TaskReplyType::TASK_FAILED_OK);
-    return Status::OK;
-  }
-
-  Status TaskRemoved(ServerContext* context,
-                     const TaskUID* tid_ptr,
-                     TaskRemovedResponse* reply) override {
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, tid_ptr->task_uid());
-    if (td_ptr == NULL) {
-      reply->set_type(TaskReplyType::TASK_NOT_FOUND);
-      return Status::OK;
-    }
-    scheduler_->HandleTaskRemoval(td_ptr);
-    JobID_t job_id = JobIDFromString(td_ptr->job_id());
-    JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
-    CHECK_NOTNULL(jd_ptr);
-    // Don't remove the root task so that tasks can still be appended to
-    // the job. We only remove the root task when the job completes.
-    if (td_ptr != jd_ptr->mutable_root_task()) {
-      task_map_->erase(td_ptr->uid());
-    }
-    uint64_t* num_tasks_to_remove =
-      FindOrNull(job_num_tasks_to_remove_, job_id);
-    CHECK_NOTNULL(num_tasks_to_remove);
-    (*num_tasks_to_remove)--;
-    if (*num_tasks_to_remove == 0) {
-      uint64_t* num_incomplete_tasks =
-        FindOrNull(job_num_incomplete_tasks_, job_id);
-      if (*num_incomplete_tasks > 0) {
-        scheduler_->HandleJobRemoval(job_id);
-      }
-      // Delete the job because we removed its last task.
-      task_map_->erase(jd_ptr->root_task().uid());
-      job_map_->erase(job_id);
-      job_num_incomplete_tasks_.erase(job_id);
-      job_num_tasks_to_remove_.erase(job_id);
-    }
-    reply->set_type(TaskReplyType::TASK_REMOVED_OK);
-    return Status::OK;
+Status FirmamentSchedulerServiceImpl::TaskSubmitted(
+    ServerContext* context, const TaskDescription* task_desc_ptr,
+    TaskSubmittedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  TaskSubmittedWithLockHeld(task_desc_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::TaskSubmittedWithLockHeld(
+    const TaskDescription* task_desc_ptr, TaskSubmittedResponse* reply) {
+  TaskID_t task_id = task_desc_ptr->task_descriptor().uid();
+  if (FindPtrOrNull(*task_map_, task_id)) {
+    reply->set_type(TaskReplyType::TASK_ALREADY_SUBMITTED);
+    return;
+  }
+  if (task_desc_ptr->task_descriptor().state() != TaskDescriptor::CREATED) {
+    reply->set_type(TaskReplyType::TASK_STATE_NOT_CREATED);
+    return;
   }
+  JobID_t job_id = JobIDFromString(task_desc_ptr->task_descriptor().job_id());
+  JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
+  if (jd_ptr == NULL) {
+    CHECK(InsertIfNotPresent(job_map_.get(), job_id,
+                             task_desc_ptr->job_descriptor()));
+    jd_ptr = FindOrNull(*job_map_, job_id);
+    TaskDescriptor* root_td_ptr = jd_ptr->mutable_root_task();
+    CHECK(InsertIfNotPresent(task_map_.get(), root_td_ptr->uid(),
+                             root_td_ptr));
+    root_td_ptr->set_submit_time(wall_time_.GetCurrentTimestamp());
+    CHECK(InsertIfNotPresent(&job_num_incomplete_tasks_, job_id, 0));
+    CHECK(InsertIfNotPresent(&job_num_tasks_to_remove_, job_id, 0));
+  } else {
+    TaskDescriptor* td_ptr = jd_ptr->mutable_root_task()->add_spawned();
+    td_ptr->CopyFrom(task_desc_ptr->task_descriptor());
+    CHECK(InsertIfNotPresent(task_map_.get(), td_ptr->uid(), td_ptr));
+    td_ptr->set_submit_time(wall_time_.GetCurrentTimestamp());
+  }
+  uint64_t* num_incomplete_tasks =
+    FindOrNull(job_num_incomplete_tasks_, job_id);
+  CHECK_NOTNULL(num_incomplete_tasks);
+  if (*num_incomplete_tasks == 0) {
+    scheduler_->AddJob(jd_ptr);
+  }
+  (*num_incomplete_tasks)++;
+  uint64_t* num_tasks_to_remove =
+    FindOrNull(job_num_tasks_to_remove_, job_id);
+  (*num_tasks_to_remove)++;
+  RecordSchedulingEvent();
+  reply->set_type(TaskReplyType::TASK_SUBMITTED_OK);
+}
 
-  Status TaskSubmitted(ServerContext* context,
-                       const TaskDescription* task_desc_ptr,
-                       TaskSubmittedResponse* reply) override {
-    TaskID_t task_id = task_desc_ptr->task_descriptor().uid();
-    if (FindPtrOrNull(*task_map_, task_id)) {
-      reply->set_type(TaskReplyType::TASK_ALREADY_SUBMITTED);
-      return Status::OK;
-    }
-    if (task_desc_ptr->task_descriptor().state() != TaskDescriptor::CREATED) {
-      reply->set_type(TaskReplyType::TASK_STATE_NOT_CREATED);
-      return Status::OK;
+Status FirmamentSchedulerServiceImpl::TaskUpdated(
+    ServerContext* context, const TaskDescription* task_desc_ptr,
+    TaskUpdatedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  TaskUpdatedWithLockHeld(task_desc_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::TaskUpdatedWithLockHeld(
+    const TaskDescription* task_desc_ptr, TaskUpdatedResponse* reply) {
+  TaskID_t task_id = task_desc_ptr->task_descriptor().uid();
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, task_id);
+  if (td_ptr == NULL) {
+    reply->set_type(TaskReplyType::TASK_NOT_FOUND);
+    return;
+  }
+  // The scheduler will notice that the task's properties (e.g.,
+  // resource requirements, labels) are different and react accordingly.
+  const TaskDescriptor& updated_td = task_desc_ptr->task_descriptor();
+  td_ptr->mutable_resource_request()->CopyFrom(updated_td.resource_request());
+  td_ptr->set_priority(updated_td.priority());
+  td_ptr->clear_labels();
+  for (const auto& label : updated_td.labels()) {
+    Label* label_ptr = td_ptr->add_labels();
+    label_ptr->CopyFrom(label);
+  }
+  td_ptr->clear_label_selectors();
+  for (const auto& label_selector : updated_td.label_selectors()) {
+    LabelSelector* label_sel_ptr = td_ptr->add_label_selectors();
+    label_sel_ptr->CopyFrom(label_selector);
+  }
+  // XXX(ionel): We may want to add support for other field updates as well.
+  RecordSchedulingEvent();
+  reply->set_type(TaskReplyType::TASK_UPDATED_OK);
+}
+
+bool FirmamentSchedulerServiceImpl::CheckResourceDoesntExist(
+    const ResourceDescriptor& rd) {
+  ResourceStatus* rs_ptr =
+    FindPtrOrNull(*resource_map_, ResourceIDFromString(rd.uuid()));
+  return rs_ptr == NULL;
+}
+
+void FirmamentSchedulerServiceImpl::AddResource(
+    ResourceTopologyNodeDescriptor* rtnd_ptr) {
+  ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
+  ResourceID_t res_id = ResourceIDFromString(rd_ptr->uuid());
+  ResourceStatus* rs_ptr =
+    new ResourceStatus(rd_ptr, rtnd_ptr, rd_ptr->friendly_name(), 0);
+  LOG(INFO) << "Adding Resource, current #resources: "<< resource_map_->size();
+  CHECK(InsertIfNotPresent(resource_map_.get(), res_id, rs_ptr));
+  LOG(INFO) << "Added Resource, current #resources: "<< resource_map_->size();
+}
+
+Status FirmamentSchedulerServiceImpl::NodeAdded(
+    ServerContext* context,
+    const ResourceTopologyNodeDescriptor* submitted_rtnd_ptr,
+    NodeAddedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  NodeAddedWithLockHeld(submitted_rtnd_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::NodeAddedWithLockHeld(
+    const ResourceTopologyNodeDescriptor* submitted_rtnd_ptr,
+    NodeAddedResponse* reply) {
+  bool doesnt_exist = DFSTraverseResourceProtobufTreeWhileTrue(
+      *submitted_rtnd_ptr,
+      boost::bind(&FirmamentSchedulerServiceImpl::CheckResourceDoesntExist,
+                  this, _1));
+  if (!doesnt_exist) {
+    reply->set_type(NodeReplyType::NODE_ALREADY_EXISTS);
+    return;
+  }
+  ResourceStatus* root_rs_ptr =
+    FindPtrOrNull(*resource_map_, top_level_res_id_);
+  CHECK_NOTNULL(root_rs_ptr);
+  ResourceTopologyNodeDescriptor* rtnd_ptr =
+    root_rs_ptr->mutable_topology_node()->add_children();
+  rtnd_ptr->CopyFrom(*submitted_rtnd_ptr);
+  rtnd_ptr->set_parent_id(to_string(top_level_res_id_));
+  DFSTraverseResourceProtobufTreeReturnRTND(
+      rtnd_ptr,
+      boost::bind(&FirmamentSchedulerServiceImpl::AddResource, this, _1));
+  // TODO(ionel): we use a hack here -- we pass simulated=true to
+  // avoid Firmament instantiating an actual executor for this resource.
+  // Instead, we rely on the no-op SimulatedExecutor. We should change
+  // it such that Firmament does not mandatorily create an executor.
+  scheduler_->RegisterResource(rtnd_ptr, false, true);
+  RecordSchedulingEvent();
+  reply->set_type(NodeReplyType::NODE_ADDED_OK);
+}
+
+Status FirmamentSchedulerServiceImpl::NodeFailed(ServerContext* context,
+                                                 const ResourceUID* rid_ptr,
+                                                 NodeFailedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  NodeFailedWithLockHeld(rid_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::NodeFailedWithLockHeld(
+    const ResourceUID* rid_ptr, NodeFailedResponse* reply) {
+  ResourceID_t res_id = ResourceIDFromString(rid_ptr->resource_uid());
+  ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
+  if (rs_ptr == NULL) {
+    reply->set_type(NodeReplyType::NODE_NOT_FOUND);
+    return;
+  }
+  scheduler_->DeregisterResource(rs_ptr->mutable_topology_node());
+  RecordSchedulingEvent();
+  reply->set_type(NodeReplyType::NODE_FAILED_OK);
+}
+
+Status FirmamentSchedulerServiceImpl::NodeRemoved(ServerContext* context,
+                                                  const ResourceUID* rid_ptr,
+                                                  NodeRemovedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  NodeRemovedWithLockHeld(rid_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::NodeRemovedWithLockHeld(
+    const ResourceUID* rid_ptr, NodeRemovedResponse* reply) {
+  ResourceID_t res_id = ResourceIDFromString(rid_ptr->resource_uid());
+  ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
+  if (rs_ptr == NULL) {
+    reply->set_type(NodeReplyType::NODE_NOT_FOUND);
+    return;
+  }
+  scheduler_->DeregisterResource(rs_ptr->mutable_topology_node());
+  RecordSchedulingEvent();
+  reply->set_type(NodeReplyType::NODE_REMOVED_OK);
+}
+
+Status FirmamentSchedulerServiceImpl::NodeUpdated(
+    ServerContext* context,
+    const ResourceTopologyNodeDescriptor* updated_rtnd_ptr,
+    NodeUpdatedResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  NodeUpdatedWithLockHeld(updated_rtnd_ptr, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::NodeUpdatedWithLockHeld(
+    const ResourceTopologyNodeDescriptor* updated_rtnd_ptr,
+    NodeUpdatedResponse* reply) {
+  ResourceID_t res_id = ResourceIDFromString(updated_rtnd_ptr->resource_desc().uuid());
+  ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
+  if (rs_ptr == NULL) {
+    reply->set_type(NodeReplyType::NODE_NOT_FOUND);
+    return;
+  }
+  DFSTraverseResourceProtobufTreesReturnRTNDs(
+      rs_ptr->mutable_topology_node(),
+      *updated_rtnd_ptr,
+      boost::bind(&FirmamentSchedulerServiceImpl::UpdateNodeLabels,
+                  this, _1, _2));
+  // TODO(ionel): Support other types of node updates.
+  RecordSchedulingEvent();
+  reply->set_type(NodeReplyType::NODE_UPDATED_OK);
+}
+
+void FirmamentSchedulerServiceImpl::UpdateNodeLabels(
+    ResourceTopologyNodeDescriptor* old_rtnd_ptr,
+    const ResourceTopologyNodeDescriptor& new_rtnd_ptr) {
+  ResourceDescriptor* old_rd_ptr = old_rtnd_ptr->mutable_resource_desc();
+  const ResourceDescriptor& new_rd = new_rtnd_ptr.resource_desc();
+  old_rd_ptr->clear_labels();
+  for (const auto& label : new_rd.labels()) {
+    Label* label_ptr = old_rd_ptr->add_labels();
+    label_ptr->CopyFrom(label);
+  }
+}
+
+Status FirmamentSchedulerServiceImpl::AddTaskStats(ServerContext* context,
+                                                   const TaskStats* task_stats,
+                                                   TaskStatsResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  AddTaskStatsWithLockHeld(task_stats, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::AddTaskStatsWithLockHeld(
+    const TaskStats* task_stats, TaskStatsResponse* reply) {
+  TaskID_t task_id = task_stats->task_id();
+  TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, task_id);
+  if (td_ptr == NULL) {
+    reply->set_type(TaskReplyType::TASK_NOT_FOUND);
+    return;
+  }
+  knowledge_base_->AddTaskStatsSample(*task_stats);
+  reply->set_type(TaskReplyType::TASK_STATS_OK);
+}
+
+Status FirmamentSchedulerServiceImpl::AddNodeStats(
+    ServerContext* context, const ResourceStats* resource_stats,
+    ResourceStatsResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  AddNodeStatsWithLockHeld(resource_stats, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::AddNodeStatsWithLockHeld(
+    const ResourceStats* resource_stats, ResourceStatsResponse* reply) {
+  ResourceID_t res_id = ResourceIDFromString(resource_stats->resource_id());
+  ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
+  if (rs_ptr == NULL || rs_ptr->mutable_descriptor() == NULL) {
+    reply->set_type(NodeReplyType::NODE_NOT_FOUND);
+    return;
+  }
+  knowledge_base_->AddMachineSample(*resource_stats);
+  reply->set_type(NodeReplyType::NODE_STATS_OK);
+}
+
+Status FirmamentSchedulerServiceImpl::TaskCompletedBatch(
+    ServerContext* context, const TaskUIDs* tids_ptr,
+    TaskCompletedBatchResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  for (const auto& tid : tids_ptr->task_uids()) {
+    TaskCompletedWithLockHeld(&tid, reply->add_responses());
+  }
+  return Status::OK;
+}
+
+Status FirmamentSchedulerServiceImpl::TaskRemovedBatch(
+    ServerContext* context, const TaskUIDs* tids_ptr,
+    TaskRemovedBatchResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  for (const auto& tid : tids_ptr->task_uids()) {
+    TaskRemovedWithLockHeld(&tid, reply->add_responses());
+  }
+  return Status::OK;
+}
+
+Status FirmamentSchedulerServiceImpl::TaskSubmittedBatch(
+    ServerContext* context, const TaskDescriptions* task_descs_ptr,
+    TaskSubmittedBatchResponse* reply) {
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  for (const auto& task_desc : task_descs_ptr->task_descriptions()) {
+    TaskSubmittedWithLockHeld(&task_desc, reply->add_responses());
+  }
+  return Status::OK;
+}
+
+Status FirmamentSchedulerServiceImpl::StreamTaskStats(
+    ServerContext* context, ServerReader<TaskStats>* reader,
+    TaskStatsBatchResponse* reply) {
+  vector<TaskStats> batch;
+  TaskStats task_stats;
+  while (reader->Read(&task_stats)) {
+    batch.push_back(task_stats);
+    if (batch.size() >= FLAGS_scheduler_service_stats_batch_size) {
+      AddTaskStatsBatch(batch, reply);
+      batch.clear();
     }
-    JobID_t job_id = JobIDFromString(task_desc_ptr->task_descriptor().job_id());
-    JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
-    if (jd_ptr == NULL) {
-      CHECK(InsertIfNotPresent(job_map_.get(), job_id,
-                               task_desc_ptr->job_descriptor()));
-      jd_ptr = FindOrNull(*job_map_, job_id);
-      TaskDescriptor* root_td_ptr = jd_ptr->mutable_root_task();
-      CHECK(InsertIfNotPresent(task_map_.get(), root_td_ptr->uid(),
-                               root_td_ptr));
-      root_td_ptr->set_submit_time(wall_time_.GetCurrentTimestamp());
-      CHECK(InsertIfNotPresent(&job_num_incomplete_tasks_, job_id, 0));
-      CHECK(InsertIfNotPresent(&job_num_tasks_to_remove_, job_id, 0));
+  }
+  AddTaskStatsBatch(batch, reply);
+  return Status::OK;
+}
+
+void FirmamentSchedulerServiceImpl::AddTaskStatsBatch(
+    const vector<TaskStats>& batch, TaskStatsBatchResponse* reply) {
+  vector<TaskStats> known_task_stats;
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  for (const auto& task_stats : batch) {
+    TaskStatsResponse* response = reply->add_responses();
+    if (FindPtrOrNull(*task_map_, task_stats.task_id()) == NULL) {
+      response->set_type(TaskReplyType::TASK_NOT_FOUND);
     } else {
-      TaskDescriptor* td_ptr = jd_ptr->mutable_root_task()->add_spawned();
-      td_ptr->CopyFrom(task_desc_ptr->task_descriptor());
-      CHECK(InsertIfNotPresent(task_map_.get(), td_ptr->uid(), td_ptr));
-      td_ptr->set_submit_time(wall_time_.GetCurrentTimestamp());
-    }
-    uint64_t* num_incomplete_tasks =
-      FindOrNull(job_num_incomplete_tasks_, job_id);
-    CHECK_NOTNULL(num_incomplete_tasks);
-    if (*num_incomplete_tasks == 0) {
-      scheduler_->AddJob(jd_ptr);
-    }
-    (*num_incomplete_tasks)++;
-    uint64_t* num_tasks_to_remove =
-      FindOrNull(job_num_tasks_to_remove_, job_id);
-    (*num_tasks_to_remove)++;
-    reply->set_type(TaskReplyType::TASK_SUBMITTED_OK);
-    return Status::OK;
-  }
-
-  Status TaskUpdated(ServerContext* context,
-                     const TaskDescription* task_desc_ptr,
-                     TaskUpdatedResponse* reply) override {
-    TaskID_t task_id = task_desc_ptr->task_descriptor().uid();
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, task_id);
-    if (td_ptr == NULL) {
-      reply->set_type(TaskReplyType::TASK_NOT_FOUND);
-      return Status::OK;
+      response->set_type(TaskReplyType::TASK_STATS_OK);
+      known_task_stats.push_back(task_stats);
     }
-    // The scheduler will notice that the task's properties (e.g.,
-    // resource requirements, labels) are different and react accordingly.
-    const TaskDescriptor& updated_td = task_desc_ptr->task_descriptor();
-    td_ptr->mutable_resource_request()->CopyFrom(updated_td.resource_request());
-    td_ptr->set_priority(updated_td.priority());
-    td_ptr->clear_labels();
-    for (const auto& label : updated_td.labels()) {
-      Label* label_ptr = td_ptr->add_labels();
-      label_ptr->CopyFrom(label);
-    }
-    td_ptr->clear_label_selectors();
-    for (const auto& label_selector : updated_td.label_selectors()) {
-      LabelSelector* label_sel_ptr = td_ptr->add_label_selectors();
-      label_sel_ptr->CopyFrom(label_selector);
-    }
-    // XXX(ionel): We may want to add support for other field updates as well.
-    return Status::OK;
   }
+  knowledge_base_->AddTaskStatsSamples(known_task_stats);
+}
 
-  bool CheckResourceDoesntExist(const ResourceDescriptor& rd) {
-    ResourceStatus* rs_ptr =
-      FindPtrOrNull(*resource_map_, ResourceIDFromString(rd.uuid()));
-    return rs_ptr == NULL;
+Status FirmamentSchedulerServiceImpl::StreamNodeStats(
+    ServerContext* context, ServerReader<ResourceStats>* reader,
+    ResourceStatsBatchResponse* reply) {
+  vector<ResourceStats> batch;
+  ResourceStats resource_stats;
+  while (reader->Read(&resource_stats)) {
+    batch.push_back(resource_stats);
+    if (batch.size() >= FLAGS_scheduler_service_stats_batch_size) {
+      AddNodeStatsBatch(batch, reply);
+      batch.clear();
+    }
   }
+  AddNodeStatsBatch(batch, reply);
+  return Status::OK;
+}
 
-  void AddResource(ResourceTopologyNodeDescriptor* rtnd_ptr) {
-    ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
-    ResourceID_t res_id = ResourceIDFromString(rd_ptr->uuid());
+void FirmamentSchedulerServiceImpl::AddNodeStatsBatch(
+    const vector<ResourceStats>& batch, ResourceStatsBatchResponse* reply) {
+  vector<ResourceStats> known_resource_stats;
+  boost::lock_guard<boost::mutex> lock(service_lock_);
+  ApplyIngestedEventsWithLockHeld();
+  for (const auto& resource_stats : batch) {
+    ResourceStatsResponse* response = reply->add_responses();
     ResourceStatus* rs_ptr =
-      new ResourceStatus(rd_ptr, rtnd_ptr, rd_ptr->friendly_name(), 0);
-    LOG(INFO) << "Adding Resource, current #resources: "<< resource_map_->size();
-    CHECK(InsertIfNotPresent(resource_map_.get(), res_id, rs_ptr));
-    LOG(INFO) << "Added Resource, current #resources: "<< resource_map_->size();
-  }
-
-  Status NodeAdded(ServerContext* context,
-                   const ResourceTopologyNodeDescriptor* submitted_rtnd_ptr,
-                   NodeAddedResponse* reply) override {
-    bool doesnt_exist = DFSTraverseResourceProtobufTreeWhileTrue(
-        *submitted_rtnd_ptr,
-        boost::bind(&FirmamentSchedulerServiceImpl::CheckResourceDoesntExist,
-                    this, _1));
-    if (!doesnt_exist) {
-      reply->set_type(NodeReplyType::NODE_ALREADY_EXISTS);
-      return Status::OK;
-    }
-    ResourceStatus* root_rs_ptr =
-      FindPtrOrNull(*resource_map_, top_level_res_id_);
-    CHECK_NOTNULL(root_rs_ptr);
-    ResourceTopologyNodeDescriptor* rtnd_ptr =
-      root_rs_ptr->mutable_topology_node()->add_children();
-    rtnd_ptr->CopyFrom(*submitted_rtnd_ptr);
-    rtnd_ptr->set_parent_id(to_string(top_level_res_id_));
-    DFSTraverseResourceProtobufTreeReturnRTND(
-        rtnd_ptr,
-        boost::bind(&FirmamentSchedulerServiceImpl::AddResource, this, _1));
-    // TODO(ionel): we use a hack here -- we pass simulated=true to
-    // avoid Firmament instantiating an actual executor for this resource.
-    // Instead, we rely on the no-op SimulatedExecutor. We should change
-    // it such that Firmament does not mandatorily create an executor.
-    scheduler_->RegisterResource(rtnd_ptr, false, true);
-    reply->set_type(NodeReplyType::NODE_ADDED_OK);
-    return Status::OK;
-  }
-
-  Status NodeFailed(ServerContext* context,
-                   const ResourceUID* rid_ptr,
-                   NodeFailedResponse* reply) override {
-    ResourceID_t res_id = ResourceIDFromString(rid_ptr->resource_uid());
-    ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
-    if (rs_ptr == NULL) {
-      reply->set_type(NodeReplyType::NODE_NOT_FOUND);
-      return Status::OK;
+      FindPtrOrNull(*resource_map_,
+                    ResourceIDFromString(resource_stats.resource_id()));
+    if (rs_ptr == NULL || rs_ptr->mutable_descriptor() == NULL) {
+      response->set_type(NodeReplyType::NODE_NOT_FOUND);
+    } else {
+      response->set_type(NodeReplyType::NODE_STATS_OK);
+      known_resource_stats.push_back(resource_stats);
     }
-    scheduler_->DeregisterResource(rs_ptr->mutable_topology_node());
-    reply->set_type(NodeReplyType::NODE_FAILED_OK);
-    return Status::OK;
-  }
-
-  Status NodeRemoved(ServerContext* context,
-                     const ResourceUID* rid_ptr,
-                     NodeRemovedResponse* reply) override {
-    ResourceID_t res_id = ResourceIDFromString(rid_ptr->resource_uid());
-    ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
-    if (rs_ptr == NULL) {
-      reply->set_type(NodeReplyType::NODE_NOT_FOUND);
-      return Status::OK;
+  }
+  knowledge_base_->AddMachineSamples(known_resource_stats);
+}
+
+Status FirmamentSchedulerServiceImpl::WatchSchedulingDeltas(
+    ServerContext* context, const WatchSchedulingDeltasRequest* request,
+    ServerWriter<SchedulingDeltas>* writer) {
+  DeltaWatcher watcher;
+  {
+    boost::lock_guard<boost::mutex> lock(watchers_lock_);
+    watchers_.insert(&watcher);
+  }
+  Status status = Status::OK;
+  SchedulingDeltas deltas;
+  while (!context->IsCancelled()) {
+    {
+      boost::unique_lock<boost::mutex> lock(watchers_lock_);
+      if (watcher.overflowed) {
+        status = Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                        "Watcher fell too far behind");
+        break;
+      }
+      if (watcher.pending.empty()) {
+        // Every scheduling round wakes the watchers, so the timeout only
+        // bounds how long a cancelled stream lingers while no rounds run.
+        watchers_cond_.timed_wait(
+            lock, boost::posix_time::milliseconds(
+                FLAGS_scheduler_service_round_interval_ms));
+        continue;
+      }
+      deltas.Swap(&watcher.pending.front());
+      watcher.pending.pop_front();
     }
-    scheduler_->DeregisterResource(rs_ptr->mutable_topology_node());
-    reply->set_type(NodeReplyType::NODE_REMOVED_OK);
-    return Status::OK;
-  }
-
-  Status NodeUpdated(ServerContext* context,
-                     const ResourceTopologyNodeDescriptor* updated_rtnd_ptr,
-                     NodeUpdatedResponse* reply) override {
-    ResourceID_t res_id = ResourceIDFromString(updated_rtnd_ptr->resource_desc().uuid());
-    ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
-    if (rs_ptr == NULL) {
-      reply->set_type(NodeReplyType::NODE_NOT_FOUND);
-      return Status::OK;
+    if (!writer->Write(deltas))
+      break;
+  }
+  {
+    boost::lock_guard<boost::mutex> lock(watchers_lock_);
+    watchers_.erase(&watcher);
+  }
+  return status;
+}
+
+void FirmamentSchedulerServiceImpl::IngestEvent(
+    const boost::function<void()>& event) {
+  CHECK(ingest_queue_.push(new boost::function<void()>(event)));
+  // Taking the wait lock ensures that the applier thread is either already
+  // waiting, or will see the event we have just queued.
+  {
+    boost::lock_guard<boost::mutex> lock(ingest_wait_lock_);
+  }
+  ingest_cond_.notify_one();
+}
+
+void FirmamentSchedulerServiceImpl::ApplyIngestedEventsWithLockHeld() {
+  boost::function<void()>* event;
+  while (ingest_queue_.pop(event)) {
+    (*event)();
+    delete event;
+  }
+}
+
+void FirmamentSchedulerServiceImpl::RecordSchedulingEvent() {
+  uint64_t num_events = ++num_events_since_round_;
+  if (!scheduling_thread_)
+    return;
+  // Only wake the scheduling thread when this event may trigger a round.
+  if (num_events == FLAGS_scheduler_service_round_event_threshold ||
+      (FLAGS_scheduler_service_back_to_back_rounds && num_events == 1)) {
+    {
+      boost::lock_guard<boost::mutex> lock(round_wait_lock_);
     }
-    DFSTraverseResourceProtobufTreesReturnRTNDs(
-        rs_ptr->mutable_topology_node(),
-        *updated_rtnd_ptr,
-        boost::bind(&FirmamentSchedulerServiceImpl::UpdateNodeLabels,
-                    this, _1, _2));
-    // TODO(ionel): Support other types of node updates.
-    reply->set_type(NodeReplyType::NODE_UPDATED_OK);
-    return Status::OK;
-  }
-
-  void UpdateNodeLabels(ResourceTopologyNodeDescriptor* old_rtnd_ptr,
-                        const ResourceTopologyNodeDescriptor& new_rtnd_ptr) {
-    ResourceDescriptor* old_rd_ptr = old_rtnd_ptr->mutable_resource_desc();
-    const ResourceDescriptor& new_rd = new_rtnd_ptr.resource_desc();
-    old_rd_ptr->clear_labels();
-    for (const auto& label : new_rd.labels()) {
-      Label* label_ptr = old_rd_ptr->add_labels();
-      label_ptr->CopyFrom(label);
+    round_cond_.notify_one();
+  }
+}
+
+bool FirmamentSchedulerServiceImpl::RoundDue(uint64_t last_round_time) {
+  uint64_t num_events = num_events_since_round_;
+  // A threshold of zero disables the event trigger; otherwise every check
+  // would find a round due, and rounds would run back-to-back without events.
+  return (FLAGS_scheduler_service_round_event_threshold > 0 &&
+          num_events >= FLAGS_scheduler_service_round_event_threshold) ||
+    (FLAGS_scheduler_service_back_to_back_rounds && num_events > 0) ||
+    wall_time_.GetCurrentTimestamp() >= last_round_time +
+      FLAGS_scheduler_service_round_interval_ms * 1000;
+}
+
+void FirmamentSchedulerServiceImpl::RunSchedulingRounds() {
+  LOG(INFO) << "Running scheduling rounds in the background.";
+  uint64_t last_round_time = wall_time_.GetCurrentTimestamp();
+  while (true) {
+    {
+      boost::unique_lock<boost::mutex> lock(round_wait_lock_);
+      while (!stop_scheduling_rounds_ && !RoundDue(last_round_time)) {
+        round_cond_.timed_wait(
+            lock, boost::posix_time::milliseconds(
+                FLAGS_scheduler_service_round_interval_ms));
+      }
+      if (stop_scheduling_rounds_)
+        return;
     }
+    last_round_time = wall_time_.GetCurrentTimestamp();
+    SchedulingDeltas deltas;
+    ScheduleRound(&deltas);
+    VLOG(1) << "Background scheduling round took "
+            << (wall_time_.GetCurrentTimestamp() - last_round_time)
+            << " us and produced " << deltas.deltas_size() << " deltas";
   }
+}
 
-  Status AddTaskStats(ServerContext* context,
-                      const TaskStats* task_stats,
-                      TaskStatsResponse* reply) override {
-    TaskID_t task_id = task_stats->task_id();
-    TaskDescriptor* td_ptr = FindPtrOrNull(*task_map_, task_id);
-    if (td_ptr == NULL) {
-      reply->set_type(TaskReplyType::TASK_NOT_FOUND);
-      return Status::OK;
+void FirmamentSchedulerServiceImpl::PublishSchedulingDeltas(
+    const SchedulingDeltas& deltas) {
+  {
+    boost::lock_guard<boost::mutex> lock(watchers_lock_);
+    for (auto& watcher : watchers_) {
+      if (deltas.deltas_size() == 0) {
+        // Nothing to send; the notification below still wakes the watcher.
+      } else if (watcher->pending.size() >=
+                 FLAGS_scheduler_service_max_pending_deltas) {
+        watcher->overflowed = true;
+      } else {
+        watcher->pending.push_back(deltas);
+      }
     }
-    knowledge_base_->AddTaskStatsSample(*task_stats);
-    return Status::OK;
   }
+  watchers_cond_.notify_all();
+}
 
-  Status AddNodeStats(ServerContext* context,
-                      const ResourceStats* resource_stats,
-                      ResourceStatsResponse* reply) override {
-    ResourceID_t res_id = ResourceIDFromString(resource_stats->resource_id());
-    ResourceStatus* rs_ptr = FindPtrOrNull(*resource_map_, res_id);
-    if (rs_ptr == NULL || rs_ptr->mutable_descriptor() == NULL) {
-      reply->set_type(NodeReplyType::NODE_NOT_FOUND);
-      return Status::OK;
+ResourceStatus* FirmamentSchedulerServiceImpl::CreateTopLevelResource() {
+  ResourceID_t res_id = GenerateResourceID();
+  ResourceTopologyNodeDescriptor* rtnd_ptr =
+    new ResourceTopologyNodeDescriptor();
+  // Set up the RD
+  ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
+  rd_ptr->set_uuid(to_string(res_id));
+  rd_ptr->set_type(ResourceDescriptor::RESOURCE_COORDINATOR);
+  // Need to maintain a ResourceStatus for the resource map
+  ResourceStatus* rs_ptr =
+    new ResourceStatus(rd_ptr, rtnd_ptr, "root_resource", 0);
+  // Insert into resource map
+
+  LOG(INFO) << "Creating Top Level Resource, current #resources: "<< resource_map_->size();
+  CHECK(InsertIfNotPresent(resource_map_.get(), res_id, rs_ptr));
+  LOG(INFO) << "Created Top Level Resource, current #resources: "<< resource_map_->size();
+  return rs_ptr;
+}
+
+// A call that is waiting on a completion queue.
+class AsyncCallInterface {
+ public:
+  virtual ~AsyncCallInterface() {}
+  /**
+   * Advances the call after its completion queue returned it.
+   * @param ok false if the operation the call waited for failed
+   */
+  virtual void Proceed(bool ok) = 0;
+};
+
+// An asynchronous unary call. Each instance serves a single call, and requests
+// the next call of the same method once its own call has arrived.
+template <typename Request, typename Response>
+class AsyncUnaryCall : public AsyncCallInterface {
+ public:
+  typedef boost::function<void(ServerContext*, Request*,
+                               ServerAsyncResponseWriter<Response>*,
+                               void*)> RequestFunc;
+  typedef boost::function<void(const Request&, Response*)> HandleFunc;
+
+  AsyncUnaryCall(const RequestFunc& request_func,
+                 const HandleFunc& handle_func)
+    : request_func_(request_func), handle_func_(handle_func),
+      responder_(&context_), finished_(false) {
+    request_func_(&context_, &request_, &responder_, this);
+  }
+
+  void Proceed(bool ok) {
+    // The request fails when the server shuts down.
+    if (!ok || finished_) {
+      delete this;
+      return;
     }
-    knowledge_base_->AddMachineSample(*resource_stats);
-    return Status::OK;
+    new AsyncUnaryCall(request_func_, handle_func_);
+    handle_func_(request_, &response_);
+    finished_ = true;
+    responder_.Finish(response_, Status::OK, this);
   }
 
  private:
-  SchedulerInterface* scheduler_;
-  SimulatedMessagingAdapter<BaseMessage>* sim_messaging_adapter_;
-  TraceGenerator* trace_generator_;
-  WallTime wall_time_;
-  // Data structures thare are populated by the scheduler. The service should
-  // never have to directly insert values in these data structures.
-  boost::shared_ptr<JobMap_t> job_map_;
-  boost::shared_ptr<KnowledgeBase> knowledge_base_;
-  boost::shared_ptr<ObjectStoreInterface> obj_store_;
-  boost::shared_ptr<TaskMap_t> task_map_;
-  boost::shared_ptr<TopologyManager> topology_manager_;
-  // Data structures that we populate in the scheduler service.
-  boost::shared_ptr<ResourceMap_t> resource_map_;
-  ResourceID_t top_level_res_id_;
-  // Mapping from JobID_t to number of incomplete job tasks.
-  unordered_map<JobID_t, uint64_t, boost::hash<boost::uuids::uuid>>
-    job_num_incomplete_tasks_;
-  // Mapping from JobID_t to number of job tasks left to be removed.
-  unordered_map<JobID_t, uint64_t, boost::hash<boost::uuids::uuid>>
-    job_num_tasks_to_remove_;
-  KnowledgeBasePopulator* kb_populator_;
-
-  ResourceStatus* CreateTopLevelResource() {
-    ResourceID_t res_id = GenerateResourceID();
-    ResourceTopologyNodeDescriptor* rtnd_ptr =
-      new ResourceTopologyNodeDescriptor();
-    // Set up the RD
-    ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
-    rd_ptr->set_uuid(to_string(res_id));
-    rd_ptr->set_type(ResourceDescriptor::RESOURCE_COORDINATOR);
-    // Need to maintain a ResourceStatus for the resource map
-    ResourceStatus* rs_ptr =
-      new ResourceStatus(rd_ptr, rtnd_ptr, "root_resource", 0);
-    // Insert into resource map
+  RequestFunc request_func_;
+  HandleFunc handle_func_;
+  ServerContext context_;
+  Request request_;
+  Response response_;
+  ServerAsyncResponseWriter<Response> responder_;
+  bool finished_;
+};
+
+FirmamentSchedulerAsyncServiceImpl::FirmamentSchedulerAsyncServiceImpl()
+  : stop_applying_events_(false) {}
+
+void FirmamentSchedulerAsyncServiceImpl::ApplyIngestedEvents() {
+  bool stop = false;
+  while (!stop) {
+    {
+      boost::unique_lock<boost::mutex> lock(ingest_wait_lock_);
+      while (ingest_queue_.empty() && !stop_applying_events_)
+        ingest_cond_.wait(lock);
+      stop = stop_applying_events_;
+    }
+    boost::lock_guard<boost::mutex> lock(service_lock_);
+    ApplyIngestedEventsWithLockHeld();
+  }
+}
 
-    LOG(INFO) << "Creating Top Level Resource, current #resources: "<< resource_map_->size();
-    CHECK(InsertIfNotPresent(resource_map_.get(), res_id, rs_ptr));
-    LOG(INFO) << "Created Top Level Resource, current #resources: "<< resource_map_->size();
-    return rs_ptr;
+template <typename Request, typename Response, typename ReplyType>
+void FirmamentSchedulerAsyncServiceImpl::ApplyEvent(
+    void (FirmamentSchedulerServiceImpl::*handler)(const Request*, Response*),
+    ReplyType ok_type, const Request& request) {
+  Response response;
+  (this->*handler)(&request, &response);
+  // The client only learned that the event was queued, so this is the only
+  // place where a rejected event shows up.
+  if (response.type() != ok_type) {
+    LOG(WARNING) << "Rejected queued " << request.GetDescriptor()->name()
+                 << " (" << request.ShortDebugString() << "): "
+                 << response.ShortDebugString();
+  } else {
+    VLOG(2) << "Applied " << request.GetDescriptor()->name();
   }
+}
 
-};
+void FirmamentSchedulerAsyncServiceImpl::HandleSchedule(
+    const ScheduleRequest& request, SchedulingDeltas* reply) {
+  ScheduleRound(reply);
+}
 
-}  // namespace firmament
+template <typename Request, typename Response, typename ReplyType>
+void FirmamentSchedulerAsyncServiceImpl::HandleEvent(
+    void (FirmamentSchedulerServiceImpl::*handler)(const Request*, Response*),
+    ReplyType ok_type, ReplyType accepted_type, const Request& request,
+    Response* reply) {
+  IngestEvent(boost::bind(
+      &FirmamentSchedulerAsyncServiceImpl::ApplyEvent<Request, Response,
+                                                      ReplyType>,
+      this, handler, ok_type, request));
+  reply->set_type(accepted_type);
+}
+
+void FirmamentSchedulerAsyncServiceImpl::ServeCompletionQueue(
+    ServerCompletionQueue* cq) {
+  void* tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    static_cast<AsyncCallInterface*>(tag)->Proceed(ok);
+  }
+}
+
+template <typename RequestService, typename Request, typename Response,
+          typename HandleFunc>
+void FirmamentSchedulerAsyncServiceImpl::ServeAsync(
+    void (RequestService::*request_method)(ServerContext*, Request*,
+                                    ServerAsyncResponseWriter<Response>*,
+                                    CompletionQueue*,
+                                    ServerCompletionQueue*, void*),
+    ServerCompletionQueue* cq, const HandleFunc& handle_func) {
+  new AsyncUnaryCall<Request, Response>(
+      boost::bind(request_method, this, _1, _2, _3, cq, cq, _4),
+      handle_func);
+}
 
-int main(int argc, char *argv[]) {
-  VLOG(1) << "Calling common::InitFirmament";
-  firmament::common::InitFirmament(argc, argv);
-  std::string server_address(FLAGS_firmament_scheduler_service_address + ":" +
-                             FLAGS_firmament_scheduler_service_port);
-  LOG(INFO) << "Firmament scheduler starting ...";
-  firmament::FirmamentSchedulerServiceImpl scheduler;
-  ServerBuilder builder;
-  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-  builder.RegisterService(&scheduler);
-  std::unique_ptr<Server> server(builder.BuildAndStart());
-  LOG(INFO) << "Firmament scheduler listening on " << server_address;
-  server->Wait();
-  return 0;
+template <typename RequestService, typename Request, typename Response,
+          typename ReplyType>
+void FirmamentSchedulerAsyncServiceImpl::ServeEventAsync(
+    void (RequestService::*request_method)(ServerContext*, Request*,
+                                    ServerAsyncResponseWriter<Response>*,
+                                    CompletionQueue*,
+                                    ServerCompletionQueue*, void*),
+    ServerCompletionQueue* cq,
+    void (FirmamentSchedulerServiceImpl::*handler)(const Request*, Response*),
+    ReplyType ok_type, ReplyType accepted_type) {
+  ServeAsync(request_method, cq, boost::bind(
+      &FirmamentSchedulerAsyncServiceImpl::HandleEvent<Request, Response,
+                                                       ReplyType>,
+      this, handler, ok_type, accepted_type, _1, _2));
 }
+
+void FirmamentSchedulerAsyncServiceImpl::Run(
+    ServerCompletionQueue* event_cq, ServerCompletionQueue* schedule_cq) {
+  ServeAsync(&AsyncServiceBase::RequestSchedule, schedule_cq,
+             boost::bind(&FirmamentSchedulerAsyncServiceImpl::HandleSchedule,
+                         this, _1, _2));
+  ServeEventAsync(&AsyncServiceBase::RequestTaskCompleted, event_cq,
+                  &FirmamentSchedulerServiceImpl::TaskCompletedWithLockHeld,
+                  TaskReplyType::TASK_COMPLETED_OK,
+                  TaskReplyType::TASK_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestTaskFailed, event_cq,
+                  &FirmamentSchedulerServiceImpl::TaskFailedWithLockHeld,
+                  TaskReplyType::TASK_FAILED_OK,
+                  TaskReplyType::TASK_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestTaskRemoved, event_cq,
+                  &FirmamentSchedulerServiceImpl::TaskRemovedWithLockHeld,
+                  TaskReplyType::TASK_REMOVED_OK,
+                  TaskReplyType::TASK_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestTaskSubmitted, event_cq,
+                  &FirmamentSchedulerServiceImpl::TaskSubmittedWithLockHeld,
+                  TaskReplyType::TASK_SUBMITTED_OK,
+                  TaskReplyType::TASK_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestTaskUpdated, event_cq,
+                  &FirmamentSchedulerServiceImpl::TaskUpdatedWithLockHeld,
+                  TaskReplyType::TASK_UPDATED_OK,
+                  TaskReplyType::TASK_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestNodeAdded, event_cq,
+                  &FirmamentSchedulerServiceImpl::NodeAddedWithLockHeld,
+                  NodeReplyType::NODE_ADDED_OK,
+                  NodeReplyType::NODE_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestNodeFailed, event_cq,
+                  &FirmamentSchedulerServiceImpl::NodeFailedWithLockHeld,
+                  NodeReplyType::NODE_FAILED_OK,
+                  NodeReplyType::NODE_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestNodeRemoved, event_cq,
+                  &FirmamentSchedulerServiceImpl::NodeRemovedWithLockHeld,
+                  NodeReplyType::NODE_REMOVED_OK,
+                  NodeReplyType::NODE_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestNodeUpdated, event_cq,
+                  &FirmamentSchedulerServiceImpl::NodeUpdatedWithLockHeld,
+                  NodeReplyType::NODE_UPDATED_OK,
+                  NodeReplyType::NODE_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestAddTaskStats, event_cq,
+                  &FirmamentSchedulerServiceImpl::AddTaskStatsWithLockHeld,
+                  TaskReplyType::TASK_STATS_OK,
+                  TaskReplyType::TASK_STATS_ACCEPTED);
+  ServeEventAsync(&AsyncServiceBase::RequestAddNodeStats, event_cq,
+                  &FirmamentSchedulerServiceImpl::AddNodeStatsWithLockHeld,
+                  NodeReplyType::NODE_STATS_OK,
+                  NodeReplyType::NODE_STATS_ACCEPTED);
+  boost::thread applier(
+      boost::bind(&FirmamentSchedulerAsyncServiceImpl::ApplyIngestedEvents,
+                  this));
+  boost::thread_group cq_threads;
+  cq_threads.create_thread(
+      boost::bind(&FirmamentSchedulerAsyncServiceImpl::ServeCompletionQueue,
+                  this, event_cq));
+  cq_threads.create_thread(
+      boost::bind(&FirmamentSchedulerAsyncServiceImpl::ServeCompletionQueue,
+                  this, schedule_cq));
+  // The completion queue threads return once their queues have been shut
+  // down and drained, after which no more events can be queued.
+  cq_threads.join_all();
+  {
+    boost::lock_guard<boost::mutex> lock(ingest_wait_lock_);
+    stop_applying_events_ = true;
+  }
+  ingest_cond_.notify_one();
+  applier.join();
+}
+
+}  // namespace firmament
@@ -0,0 +1,323 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// The scheduler service that integrations (e.g. Poseidon) use to drive
+// Firmament over gRPC.
+
+#ifndef FIRMAMENT_SCHEDULING_FIRMAMENT_SCHEDULER_SERVICE_H
+#define FIRMAMENT_SCHEDULING_FIRMAMENT_SCHEDULER_SERVICE_H
+
+#include <grpc++/grpc++.h>
+
+#include <boost/function.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "base/resource_status.h"
+#include "base/resource_topology_node_desc.pb.h"
+#include "misc/trace_generator.h"
+#include "misc/wall_time.h"
+#include "platforms/sim/simulated_messaging_adapter.h"
+#include "scheduling/firmament_scheduler.grpc.pb.h"
+#include "scheduling/firmament_scheduler.pb.h"
+#include "scheduling/knowledge_base_populator.h"
+#include "scheduling/scheduler_interface.h"
+#include "scheduling/scheduling_delta.pb.h"
+
+DECLARE_string(firmament_scheduler_service_address);
+DECLARE_string(firmament_scheduler_service_port);
+DECLARE_string(service_scheduler);
+DECLARE_bool(scheduler_service_async);
+DECLARE_bool(scheduler_service_background_rounds);
+DECLARE_uint64(scheduler_service_round_event_threshold);
+DECLARE_uint64(scheduler_service_round_interval_ms);
+DECLARE_bool(scheduler_service_back_to_back_rounds);
+DECLARE_uint64(scheduler_service_stats_batch_size);
+DECLARE_uint64(scheduler_service_max_pending_deltas);
+
+namespace firmament {
+
+class FirmamentSchedulerServiceImpl :
+  public FirmamentScheduler::Service {
+
+  public:
+  FirmamentSchedulerServiceImpl();
+  virtual ~FirmamentSchedulerServiceImpl();
+
+  void HandlePlacementDelta(const SchedulingDelta& delta);
+  void HandlePreemptionDelta(const SchedulingDelta& delta);
+  void HandleMigrationDelta(const SchedulingDelta& delta);
+  grpc::Status Schedule(grpc::ServerContext* context,
+                        const ScheduleRequest* request,
+                        SchedulingDeltas* reply) override;
+  /**
+   * Runs a scheduling round over all pending events, and publishes its deltas
+   * to WatchSchedulingDeltas subscribers.
+   * @param reply populated with the round's scheduling deltas
+   */
+  void ScheduleRound(SchedulingDeltas* reply);
+  /**
+   * Starts running scheduling rounds on a background thread. A round starts
+   * when enough events have arrived, when the round interval has elapsed, or,
+   * in back-to-back mode, as soon as the previous round finishes if events
+   * arrived during it.
+   */
+  void StartSchedulingRounds();
+  grpc::Status TaskCompleted(grpc::ServerContext* context,
+                             const TaskUID* tid_ptr,
+                             TaskCompletedResponse* reply) override;
+  void TaskCompletedWithLockHeld(const TaskUID* tid_ptr,
+                                 TaskCompletedResponse* reply);
+  grpc::Status TaskFailed(grpc::ServerContext* context,
+                          const TaskUID* tid_ptr,
+                          TaskFailedResponse* reply) override;
+  void TaskFailedWithLockHeld(const TaskUID* tid_ptr,
+                              TaskFailedResponse* reply);
+  grpc::Status TaskRemoved(grpc::ServerContext* context,
+                           const TaskUID* tid_ptr,
+                           TaskRemovedResponse* reply) override;
+  void TaskRemovedWithLockHeld(const TaskUID* tid_ptr,
+                               TaskRemovedResponse* reply);
+  grpc::Status TaskSubmitted(grpc::ServerContext* context,
+                             const TaskDescription* task_desc_ptr,
+                             TaskSubmittedResponse* reply) override;
+  void TaskSubmittedWithLockHeld(const TaskDescription* task_desc_ptr,
+                                 TaskSubmittedResponse* reply);
+  grpc::Status TaskUpdated(grpc::ServerContext* context,
+                           const TaskDescription* task_desc_ptr,
+                           TaskUpdatedResponse* reply) override;
+  void TaskUpdatedWithLockHeld(const TaskDescription* task_desc_ptr,
+                               TaskUpdatedResponse* reply);
+  bool CheckResourceDoesntExist(const ResourceDescriptor& rd);
+  void AddResource(ResourceTopologyNodeDescriptor* rtnd_ptr);
+  grpc::Status NodeAdded(
+      grpc::ServerContext* context,
+      const ResourceTopologyNodeDescriptor* submitted_rtnd_ptr,
+      NodeAddedResponse* reply) override;
+  void NodeAddedWithLockHeld(
+      const ResourceTopologyNodeDescriptor* submitted_rtnd_ptr,
+      NodeAddedResponse* reply);
+  grpc::Status NodeFailed(grpc::ServerContext* context,
+                          const ResourceUID* rid_ptr,
+                          NodeFailedResponse* reply) override;
+  void NodeFailedWithLockHeld(const ResourceUID* rid_ptr,
+                              NodeFailedResponse* reply);
+  grpc::Status NodeRemoved(grpc::ServerContext* context,
+                           const ResourceUID* rid_ptr,
+                           NodeRemovedResponse* reply) override;
+  void NodeRemovedWithLockHeld(const ResourceUID* rid_ptr,
+                               NodeRemovedResponse* reply);
+  grpc::Status NodeUpdated(
+      grpc::ServerContext* context,
+      const ResourceTopologyNodeDescriptor* updated_rtnd_ptr,
+      NodeUpdatedResponse* reply) override;
+  void NodeUpdatedWithLockHeld(
+      const ResourceTopologyNodeDescriptor* updated_rtnd_ptr,
+      NodeUpdatedResponse* reply);
+  void UpdateNodeLabels(ResourceTopologyNodeDescriptor* old_rtnd_ptr,
+                        const ResourceTopologyNodeDescriptor& new_rtnd_ptr);
+  grpc::Status AddTaskStats(grpc::ServerContext* context,
+                            const TaskStats* task_stats,
+                            TaskStatsResponse* reply) override;
+  void AddTaskStatsWithLockHeld(const TaskStats* task_stats,
+                                TaskStatsResponse* reply);
+  grpc::Status AddNodeStats(grpc::ServerContext* context,
+                            const ResourceStats* resource_stats,
+                            ResourceStatsResponse* reply) override;
+  void AddNodeStatsWithLockHeld(const ResourceStats* resource_stats,
+                                ResourceStatsResponse* reply);
+  grpc::Status TaskCompletedBatch(grpc::ServerContext* context,
+                                  const TaskUIDs* tids_ptr,
+                                  TaskCompletedBatchResponse* reply) override;
+  grpc::Status TaskRemovedBatch(grpc::ServerContext* context,
+                                const TaskUIDs* tids_ptr,
+                                TaskRemovedBatchResponse* reply) override;
+  grpc::Status TaskSubmittedBatch(grpc::ServerContext* context,
+                                  const TaskDescriptions* task_descs_ptr,
+                                  TaskSubmittedBatchResponse* reply) override;
+  grpc::Status StreamTaskStats(grpc::ServerContext* context,
+                               grpc::ServerReader<TaskStats>* reader,
+                               TaskStatsBatchResponse* reply) override;
+  void AddTaskStatsBatch(const vector<TaskStats>& batch,
+                         TaskStatsBatchResponse* reply);
+  grpc::Status StreamNodeStats(grpc::ServerContext* context,
+                               grpc::ServerReader<ResourceStats>* reader,
+                               ResourceStatsBatchResponse* reply) override;
+  void AddNodeStatsBatch(const vector<ResourceStats>& batch,
+                         ResourceStatsBatchResponse* reply);
+  grpc::Status WatchSchedulingDeltas(
+      grpc::ServerContext* context,
+      const WatchSchedulingDeltasRequest* request,
+      grpc::ServerWriter<SchedulingDeltas>* writer) override;
+  /**
+   * Queues an event to be applied before the next call that takes the service
+   * lock. Does not block, even while a scheduling round runs.
+   * @param event the event to apply
+   */
+  void IngestEvent(const boost::function<void()>& event);
+  void ApplyIngestedEventsWithLockHeld();
+  // Counts an applied event towards triggering the next background scheduling
+  // round. Rejected events do not change scheduler state, so they are not
+  // counted.
+  void RecordSchedulingEvent();
+  bool RoundDue(uint64_t last_round_time);
+  void RunSchedulingRounds();
+  // Queues a round's deltas for the WatchSchedulingDeltas streams, and wakes
+  // them even if the round produced none, so that they can notice that their
+  // call was cancelled.
+  void PublishSchedulingDeltas(const SchedulingDeltas& deltas);
+
+ protected:
+  scheduler::SchedulerInterface* scheduler_;
+  platform::sim::SimulatedMessagingAdapter<BaseMessage>*
+    sim_messaging_adapter_;
+  TraceGenerator* trace_generator_;
+  WallTime wall_time_;
+  // Data structures thare are populated by the scheduler. The service should
+  // never have to directly insert values in these data structures.
+  boost::shared_ptr<JobMap_t> job_map_;
+  boost::shared_ptr<KnowledgeBase> knowledge_base_;
+  boost::shared_ptr<store::ObjectStoreInterface> obj_store_;
+  boost::shared_ptr<TaskMap_t> task_map_;
+  boost::shared_ptr<machine::topology::TopologyManager> topology_manager_;
+  // Data structures that we populate in the scheduler service.
+  boost::shared_ptr<ResourceMap_t> resource_map_;
+  ResourceID_t top_level_res_id_;
+  // Mapping from JobID_t to number of incomplete job tasks.
+  unordered_map<JobID_t, uint64_t, boost::hash<boost::uuids::uuid>>
+    job_num_incomplete_tasks_;
+  // Mapping from JobID_t to number of job tasks left to be removed.
+  unordered_map<JobID_t, uint64_t, boost::hash<boost::uuids::uuid>>
+    job_num_tasks_to_remove_;
+  KnowledgeBasePopulator* kb_populator_;
+  // Serializes all calls that read or modify the scheduler state. Batch calls
+  // take it once for the whole batch.
+  boost::mutex service_lock_;
+  // Events received by the asynchronous server that have not yet been
+  // applied, in arrival order. Producers never block on it.
+  boost::lockfree::queue<boost::function<void()>*> ingest_queue_;
+  boost::mutex ingest_wait_lock_;
+  boost::condition_variable ingest_cond_;
+  // Background scheduling rounds; the thread is NULL unless they are enabled.
+  scoped_ptr<boost::thread> scheduling_thread_;
+  std::atomic<uint64_t> num_events_since_round_;
+  boost::mutex round_wait_lock_;
+  boost::condition_variable round_cond_;
+  bool stop_scheduling_rounds_;
+  // Deltas of completed scheduling rounds not yet sent to a
+  // WatchSchedulingDeltas stream.
+  struct DeltaWatcher {
+    DeltaWatcher() : overflowed(false) {}
+    deque<SchedulingDeltas> pending;
+    bool overflowed;
+  };
+  set<DeltaWatcher*> watchers_;
+  boost::mutex watchers_lock_;
+  boost::condition_variable watchers_cond_;
+
+  ResourceStatus* CreateTopLevelResource();
+};
+
+typedef FirmamentScheduler::WithAsyncMethod_Schedule<
+  FirmamentScheduler::WithAsyncMethod_TaskCompleted<
+  FirmamentScheduler::WithAsyncMethod_TaskFailed<
+  FirmamentScheduler::WithAsyncMethod_TaskRemoved<
+  FirmamentScheduler::WithAsyncMethod_TaskSubmitted<
+  FirmamentScheduler::WithAsyncMethod_TaskUpdated<
+  FirmamentScheduler::WithAsyncMethod_NodeAdded<
+  FirmamentScheduler::WithAsyncMethod_NodeFailed<
+  FirmamentScheduler::WithAsyncMethod_NodeRemoved<
+  FirmamentScheduler::WithAsyncMethod_NodeUpdated<
+  FirmamentScheduler::WithAsyncMethod_AddTaskStats<
+  FirmamentScheduler::WithAsyncMethod_AddNodeStats<
+  FirmamentSchedulerServiceImpl> > > > > > > > > > > > AsyncServiceBase;
+
+// Serves the unary RPCs from completion queues. Event RPCs (task and node
+// events) are acknowledged with TASK_ACCEPTED or NODE_ACCEPTED, and stats with
+// TASK_STATS_ACCEPTED or NODE_STATS_ACCEPTED, as soon as they have been
+// queued; they are applied between scheduling rounds, and events that turn out
+// to be invalid are logged. Schedule runs on its own completion queue, so that
+// a long scheduling round does not delay event RPCs. The batch and streaming
+// RPCs are still served synchronously.
+class FirmamentSchedulerAsyncServiceImpl : public AsyncServiceBase {
+ public:
+  FirmamentSchedulerAsyncServiceImpl();
+
+  /**
+   * Serves calls until the server and both completion queues have been shut
+   * down, and then applies the events that are still queued.
+   * @param event_cq the completion queue for event RPCs
+   * @param schedule_cq the completion queue for Schedule RPCs
+   */
+  void Run(grpc::ServerCompletionQueue* event_cq,
+           grpc::ServerCompletionQueue* schedule_cq);
+
+ private:
+  // Applies queued events whenever no other call holds the service lock; in
+  // particular, events that arrive during a scheduling round are applied as
+  // soon as it finishes. Returns after applying the remaining events once
+  // Run() asks it to stop.
+  void ApplyIngestedEvents();
+  template <typename Request, typename Response, typename ReplyType>
+  void ApplyEvent(void (FirmamentSchedulerServiceImpl::*handler)(
+                      const Request*, Response*),
+                  ReplyType ok_type, const Request& request);
+  void HandleSchedule(const ScheduleRequest& request,
+                      SchedulingDeltas* reply);
+  template <typename Request, typename Response, typename ReplyType>
+  void HandleEvent(void (FirmamentSchedulerServiceImpl::*handler)(
+                       const Request*, Response*),
+                   ReplyType ok_type, ReplyType accepted_type,
+                   const Request& request, Response* reply);
+  void ServeCompletionQueue(grpc::ServerCompletionQueue* cq);
+  template <typename RequestService, typename Request, typename Response,
+            typename HandleFunc>
+  void ServeAsync(
+      void (RequestService::*request_method)(
+          grpc::ServerContext*, Request*,
+          grpc::ServerAsyncResponseWriter<Response>*, grpc::CompletionQueue*,
+          grpc::ServerCompletionQueue*, void*),
+      grpc::ServerCompletionQueue* cq, const HandleFunc& handle_func);
+  template <typename RequestService, typename Request, typename Response,
+            typename ReplyType>
+  void ServeEventAsync(
+      void (RequestService::*request_method)(
+          grpc::ServerContext*, Request*,
+          grpc::ServerAsyncResponseWriter<Response>*, grpc::CompletionQueue*,
+          grpc::ServerCompletionQueue*, void*),
+      grpc::ServerCompletionQueue* cq,
+      void (FirmamentSchedulerServiceImpl::*handler)(const Request*,
+                                                     Response*),
+      ReplyType ok_type, ReplyType accepted_type);
+
+  // Set once no more events can arrive; guarded by ingest_wait_lock_.
+  bool stop_applying_events_;
+};
+
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SCHEDULING_FIRMAMENT_SCHEDULER_SERVICE_H
@@ -0,0 +1,337 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Scheduler service tests: batch calls, background scheduling rounds and the
+// asynchronous server.
+
+#include <gtest/gtest.h>
+
+#include <boost/thread/thread.hpp>
+
+#include "misc/utils.h"
+#include "scheduling/firmament_scheduler_service.h"
+
+using grpc::Server;
+using grpc::ServerBuilder;
+using grpc::ServerCompletionQueue;
+using grpc::ServerContext;
+
+namespace firmament {
+
+// Exposes the state of the tasks that a service knows about.
+template <typename ServiceImpl>
+class InspectableService : public ServiceImpl {
+ public:
+  bool HasTask(TaskID_t task_id) {
+    boost::lock_guard<boost::mutex> lock(this->service_lock_);
+    return FindPtrOrNull(*this->task_map_, task_id) != NULL;
+  }
+
+  TaskDescriptor::TaskState TaskState(TaskID_t task_id) {
+    boost::lock_guard<boost::mutex> lock(this->service_lock_);
+    TaskDescriptor* td_ptr = FindPtrOrNull(*this->task_map_, task_id);
+    CHECK_NOTNULL(td_ptr);
+    return td_ptr->state();
+  }
+
+  /**
+   * Waits for a task to be placed.
+   * @param task_id the task to wait for
+   * @return false if it is not running after ten seconds
+   */
+  bool WaitForTaskRunning(TaskID_t task_id) {
+    for (uint32_t i = 0; i < 1000; ++i) {
+      if (HasTask(task_id) &&
+          TaskState(task_id) == TaskDescriptor::RUNNING) {
+        return true;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    return false;
+  }
+};
+
+class FirmamentSchedulerServiceTest : public ::testing::Test {
+ protected:
+  FirmamentSchedulerServiceTest()
+    : service_scheduler_(FLAGS_service_scheduler),
+      round_event_threshold_(FLAGS_scheduler_service_round_event_threshold),
+      round_interval_ms_(FLAGS_scheduler_service_round_interval_ms),
+      back_to_back_rounds_(FLAGS_scheduler_service_back_to_back_rounds) {
+    // The simple scheduler does not need an external solver.
+    FLAGS_service_scheduler = "simple";
+  }
+
+  virtual ~FirmamentSchedulerServiceTest() {
+    FLAGS_service_scheduler = service_scheduler_;
+    FLAGS_scheduler_service_round_event_threshold = round_event_threshold_;
+    FLAGS_scheduler_service_round_interval_ms = round_interval_ms_;
+    FLAGS_scheduler_service_back_to_back_rounds = back_to_back_rounds_;
+  }
+
+  // Creates a machine with a single PU.
+  void CreateMachine(ResourceTopologyNodeDescriptor* rtnd_ptr,
+                     const string& machine_name) {
+    ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
+    rd_ptr->set_uuid(to_string(GenerateResourceID(machine_name)));
+    rd_ptr->set_friendly_name(machine_name);
+    rd_ptr->set_type(ResourceDescriptor::RESOURCE_MACHINE);
+    ResourceTopologyNodeDescriptor* pu_rtnd_ptr = rtnd_ptr->add_children();
+    pu_rtnd_ptr->set_parent_id(rd_ptr->uuid());
+    ResourceDescriptor* pu_rd_ptr = pu_rtnd_ptr->mutable_resource_desc();
+    pu_rd_ptr->set_uuid(to_string(GenerateResourceID(machine_name + "_pu")));
+    pu_rd_ptr->set_friendly_name(machine_name + "_pu");
+    pu_rd_ptr->set_type(ResourceDescriptor::RESOURCE_PU);
+  }
+
+  // Creates the root task of a new job.
+  void CreateTask(TaskDescription* task_desc_ptr, uint64_t job_id_seed) {
+    JobDescriptor* jd_ptr = task_desc_ptr->mutable_job_descriptor();
+    JobID_t job_id = GenerateJobID(job_id_seed);
+    jd_ptr->set_uuid(to_string(job_id));
+    jd_ptr->set_name(to_string(job_id));
+    TaskDescriptor* td_ptr = jd_ptr->mutable_root_task();
+    td_ptr->set_uid(GenerateRootTaskID(*jd_ptr));
+    td_ptr->set_job_id(jd_ptr->uuid());
+    td_ptr->set_state(TaskDescriptor::CREATED);
+    task_desc_ptr->mutable_task_descriptor()->CopyFrom(*td_ptr);
+  }
+
+  string service_scheduler_;
+  uint64_t round_event_threshold_;
+  uint64_t round_interval_ms_;
+  bool back_to_back_rounds_;
+};
+
+// Tests that a batch call applies every event in it and reports on each.
+TEST_F(FirmamentSchedulerServiceTest, SubmitAndRemoveBatches) {
+  InspectableService<FirmamentSchedulerServiceImpl> service;
+  ServerContext context;
+  TaskDescriptions task_descs;
+  CreateTask(task_descs.add_task_descriptions(), 1);
+  CreateTask(task_descs.add_task_descriptions(), 2);
+  task_descs.add_task_descriptions()->CopyFrom(task_descs.task_descriptions(0));
+  TaskSubmittedBatchResponse submitted;
+  service.TaskSubmittedBatch(&context, &task_descs, &submitted);
+  ASSERT_EQ(submitted.responses_size(), 3);
+  EXPECT_EQ(submitted.responses(0).type(), TaskReplyType::TASK_SUBMITTED_OK);
+  EXPECT_EQ(submitted.responses(1).type(), TaskReplyType::TASK_SUBMITTED_OK);
+  EXPECT_EQ(submitted.responses(2).type(),
+            TaskReplyType::TASK_ALREADY_SUBMITTED);
+  TaskUIDs tids;
+  tids.add_task_uids()->set_task_uid(
+      task_descs.task_descriptions(0).task_descriptor().uid());
+  tids.add_task_uids()->set_task_uid(
+      task_descs.task_descriptions(1).task_descriptor().uid());
+  TaskRemovedBatchResponse removed;
+  service.TaskRemovedBatch(&context, &tids, &removed);
+  ASSERT_EQ(removed.responses_size(), 2);
+  EXPECT_EQ(removed.responses(0).type(), TaskReplyType::TASK_REMOVED_OK);
+  EXPECT_EQ(removed.responses(1).type(), TaskReplyType::TASK_REMOVED_OK);
+  EXPECT_FALSE(service.HasTask(tids.task_uids(0).task_uid()));
+  // The tasks are gone now, so completing them fails.
+  TaskCompletedBatchResponse completed;
+  service.TaskCompletedBatch(&context, &tids, &completed);
+  ASSERT_EQ(completed.responses_size(), 2);
+  EXPECT_EQ(completed.responses(0).type(), TaskReplyType::TASK_NOT_FOUND);
+  EXPECT_EQ(completed.responses(1).type(), TaskReplyType::TASK_NOT_FOUND);
+}
+
+// Tests that a stats batch only rejects the samples for unknown tasks and
+// nodes.
+TEST_F(FirmamentSchedulerServiceTest, StatsBatches) {
+  InspectableService<FirmamentSchedulerServiceImpl> service;
+  ServerContext context;
+  ResourceTopologyNodeDescriptor machine;
+  CreateMachine(&machine, "stats_machine");
+  NodeAddedResponse node_added;
+  service.NodeAdded(&context, &machine, &node_added);
+  ASSERT_EQ(node_added.type(), NodeReplyType::NODE_ADDED_OK);
+  TaskDescription task_desc;
+  CreateTask(&task_desc, 3);
+  TaskSubmittedResponse submitted;
+  service.TaskSubmitted(&context, &task_desc, &submitted);
+  ASSERT_EQ(submitted.type(), TaskReplyType::TASK_SUBMITTED_OK);
+  vector<TaskStats> task_stats(2);
+  task_stats[0].set_task_id(task_desc.task_descriptor().uid());
+  task_stats[1].set_task_id(task_desc.task_descriptor().uid() + 1);
+  TaskStatsBatchResponse task_stats_reply;
+  service.AddTaskStatsBatch(task_stats, &task_stats_reply);
+  ASSERT_EQ(task_stats_reply.responses_size(), 2);
+  EXPECT_EQ(task_stats_reply.responses(0).type(),
+            TaskReplyType::TASK_STATS_OK);
+  EXPECT_EQ(task_stats_reply.responses(1).type(),
+            TaskReplyType::TASK_NOT_FOUND);
+  vector<ResourceStats> resource_stats(2);
+  resource_stats[0].set_resource_id(machine.resource_desc().uuid());
+  resource_stats[1].set_resource_id(
+      to_string(GenerateResourceID("unknown_machine")));
+  ResourceStatsBatchResponse resource_stats_reply;
+  service.AddNodeStatsBatch(resource_stats, &resource_stats_reply);
+  ASSERT_EQ(resource_stats_reply.responses_size(), 2);
+  EXPECT_EQ(resource_stats_reply.responses(0).type(),
+            NodeReplyType::NODE_STATS_OK);
+  EXPECT_EQ(resource_stats_reply.responses(1).type(),
+            NodeReplyType::NODE_NOT_FOUND);
+}
+
+// Tests that enough events trigger a background scheduling round, and that
+// destroying the service stops the rounds.
+TEST_F(FirmamentSchedulerServiceTest, BackgroundRoundAfterEventThreshold) {
+  FLAGS_scheduler_service_round_event_threshold = 2;
+  FLAGS_scheduler_service_round_interval_ms = 60000;
+  FLAGS_scheduler_service_back_to_back_rounds = false;
+  InspectableService<FirmamentSchedulerServiceImpl> service;
+  service.StartSchedulingRounds();
+  ServerContext context;
+  ResourceTopologyNodeDescriptor machine;
+  CreateMachine(&machine, "threshold_machine");
+  NodeAddedResponse node_added;
+  service.NodeAdded(&context, &machine, &node_added);
+  TaskDescription task_desc;
+  CreateTask(&task_desc, 4);
+  TaskSubmittedResponse submitted;
+  service.TaskSubmitted(&context, &task_desc, &submitted);
+  EXPECT_TRUE(service.WaitForTaskRunning(task_desc.task_descriptor().uid()));
+}
+
+// Tests that an event threshold of zero disables the event trigger instead of
+// making every check find a round due.
+TEST_F(FirmamentSchedulerServiceTest, ZeroEventThresholdDisablesTrigger) {
+  FLAGS_scheduler_service_round_event_threshold = 0;
+  FLAGS_scheduler_service_round_interval_ms = 60000;
+  FLAGS_scheduler_service_back_to_back_rounds = false;
+  InspectableService<FirmamentSchedulerServiceImpl> service;
+  service.StartSchedulingRounds();
+  ServerContext context;
+  ResourceTopologyNodeDescriptor machine;
+  CreateMachine(&machine, "zero_threshold_machine");
+  NodeAddedResponse node_added;
+  service.NodeAdded(&context, &machine, &node_added);
+  TaskDescription task_desc;
+  CreateTask(&task_desc, 8);
+  TaskSubmittedResponse submitted;
+  service.TaskSubmitted(&context, &task_desc, &submitted);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+  EXPECT_NE(service.TaskState(task_desc.task_descriptor().uid()),
+            TaskDescriptor::RUNNING);
+}
+
+// Tests that in back-to-back mode, a single event triggers a round.
+TEST_F(FirmamentSchedulerServiceTest, BackToBackRounds) {
+  FLAGS_scheduler_service_round_event_threshold = 1000;
+  FLAGS_scheduler_service_round_interval_ms = 60000;
+  FLAGS_scheduler_service_back_to_back_rounds = true;
+  InspectableService<FirmamentSchedulerServiceImpl> service;
+  service.StartSchedulingRounds();
+  ServerContext context;
+  ResourceTopologyNodeDescriptor machine;
+  CreateMachine(&machine, "back_to_back_machine");
+  NodeAddedResponse node_added;
+  service.NodeAdded(&context, &machine, &node_added);
+  TaskDescription task_desc;
+  CreateTask(&task_desc, 5);
+  TaskSubmittedResponse submitted;
+  service.TaskSubmitted(&context, &task_desc, &submitted);
+  EXPECT_TRUE(service.WaitForTaskRunning(task_desc.task_descriptor().uid()));
+}
+
+// Tests that the asynchronous server acknowledges events and stats as queued,
+// applies them, and applies the events still queued when it shuts down.
+TEST_F(FirmamentSchedulerServiceTest, AsyncServer) {
+  InspectableService<FirmamentSchedulerAsyncServiceImpl> service;
+  ServerBuilder builder;
+  int port = 0;
+  builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(),
+                           &port);
+  builder.RegisterService(&service);
+  std::unique_ptr<ServerCompletionQueue> event_cq =
+    builder.AddCompletionQueue();
+  std::unique_ptr<ServerCompletionQueue> schedule_cq =
+    builder.AddCompletionQueue();
+  std::unique_ptr<Server> server(builder.BuildAndStart());
+  ASSERT_NE(port, 0);
+  boost::thread serving(
+      boost::bind(&FirmamentSchedulerAsyncServiceImpl::Run, &service,
+                  event_cq.get(), schedule_cq.get()));
+  std::unique_ptr<FirmamentScheduler::Stub> stub(FirmamentScheduler::NewStub(
+      grpc::CreateChannel("127.0.0.1:" + to_string(port),
+                          grpc::InsecureChannelCredentials())));
+  ResourceTopologyNodeDescriptor machine;
+  CreateMachine(&machine, "async_machine");
+  {
+    grpc::ClientContext context;
+    NodeAddedResponse reply;
+    ASSERT_TRUE(stub->NodeAdded(&context, machine, &reply).ok());
+    EXPECT_EQ(reply.type(), NodeReplyType::NODE_ACCEPTED);
+  }
+  TaskDescription task_desc;
+  CreateTask(&task_desc, 6);
+  TaskID_t task_id = task_desc.task_descriptor().uid();
+  {
+    grpc::ClientContext context;
+    TaskSubmittedResponse reply;
+    ASSERT_TRUE(stub->TaskSubmitted(&context, task_desc, &reply).ok());
+    EXPECT_EQ(reply.type(), TaskReplyType::TASK_ACCEPTED);
+  }
+  {
+    grpc::ClientContext context;
+    TaskStats task_stats;
+    task_stats.set_task_id(task_id);
+    TaskStatsResponse reply;
+    ASSERT_TRUE(stub->AddTaskStats(&context, task_stats, &reply).ok());
+    EXPECT_EQ(reply.type(), TaskReplyType::TASK_STATS_ACCEPTED);
+  }
+  {
+    grpc::ClientContext context;
+    ResourceStats resource_stats;
+    resource_stats.set_resource_id(machine.resource_desc().uuid());
+    ResourceStatsResponse reply;
+    ASSERT_TRUE(stub->AddNodeStats(&context, resource_stats, &reply).ok());
+    EXPECT_EQ(reply.type(), NodeReplyType::NODE_STATS_ACCEPTED);
+  }
+  // A scheduling round applies all events queued before it.
+  {
+    grpc::ClientContext context;
+    SchedulingDeltas reply;
+    ASSERT_TRUE(stub->Schedule(&context, ScheduleRequest(), &reply).ok());
+    EXPECT_EQ(service.TaskState(task_id), TaskDescriptor::RUNNING);
+  }
+  TaskDescription last_task_desc;
+  CreateTask(&last_task_desc, 7);
+  {
+    grpc::ClientContext context;
+    TaskSubmittedResponse reply;
+    ASSERT_TRUE(stub->TaskSubmitted(&context, last_task_desc, &reply).ok());
+    EXPECT_EQ(reply.type(), TaskReplyType::TASK_ACCEPTED);
+  }
+  server->Shutdown();
+  event_cq->Shutdown();
+  schedule_cq->Shutdown();
+  serving.join();
+  EXPECT_TRUE(service.HasTask(last_task_desc.task_descriptor().uid()));
+}
+
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -231,7 +231,13 @@ FlowGraphNode* FlowGraphManager::AddResourceNode(ResourceDescriptor* rd_ptr) {
   ResourceID_t res_id = ResourceIDFromString(rd_ptr->uuid());
   res_node->resource_id_ = res_id;
   res_node->rd_ptr_ = rd_ptr;
-  CHECK(InsertIfNotPresent(&resource_to_node_map_, res_id, res_node));
+  // The node holds a reference on the dense ID until it is removed.
+  DenseResourceID_t dense_res_id = ResourceIDs()->Intern(res_id);
+  if (dense_res_id >= resource_to_node_map_.size()) {
+    resource_to_node_map_.resize(dense_res_id + 1, NULL);
+  }
+  CHECK(resource_to_node_map_[dense_res_id] == NULL);
+  resource_to_node_map_[dense_res_id] = res_node;
   if (res_node->type_ == FlowNodeType::PU) {
     leaf_nodes_.insert(res_node->id_);
     leaf_res_ids_->insert(res_id);
@@ -568,7 +574,13 @@ void FlowGraphManager::RemoveResourceNode(FlowGraphNode* res_node) {
   ResourceID_t res_id_tmp = res_node->resource_id_;
   ResourceID_t res_id_tmp2 = res_node->resource_id_;
   leaf_res_ids_->erase(res_id_tmp);
-  resource_to_node_map_.erase(res_id_tmp2);
+  DenseResourceID_t dense_res_id = ResourceIDs()->Lookup(res_id_tmp2);
+  if (dense_res_id < resource_to_node_map_.size() &&
+      resource_to_node_map_[dense_res_id] != NULL) {
+    resource_to_node_map_[dense_res_id] = NULL;
+    // Drop the reference taken when the node was added.
+    ResourceIDs()->ReleaseDenseID(dense_res_id);
+  }
   graph_change_manager_->DeleteNode(res_node, DEL_RESOURCE_NODE,
                                     "RemoveResourceNode");
 }
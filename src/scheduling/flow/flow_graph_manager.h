@@ -28,6 +28,7 @@
 
 #include "base/common.h"
 #include "base/types.h"
+#include "base/resource_id_interner.h"
 #include "base/resource_topology_node_desc.pb.h"
 #include "misc/map-util.h"
 #include "misc/time_interface.h"
@@ -366,7 +367,10 @@ class FlowGraphManager {
     return FindPtrOrNull(tec_to_node_map_, ec);
   }
   inline FlowGraphNode* NodeForResourceID(const ResourceID_t& res_id) {
-    return FindPtrOrNull(resource_to_node_map_, res_id);
+    DenseResourceID_t dense_res_id = ResourceIDs()->Lookup(res_id);
+    if (dense_res_id >= resource_to_node_map_.size())
+      return NULL;
+    return resource_to_node_map_[dense_res_id];
   }
   inline FlowGraphNode* NodeForTaskID(TaskID_t task_id) {
     return FindPtrOrNull(task_to_node_map_, task_id);
@@ -382,8 +386,8 @@ class FlowGraphManager {
 
   // Resource and task mappings
   unordered_map<TaskID_t, FlowGraphNode*> task_to_node_map_;
-  unordered_map<ResourceID_t, FlowGraphNode*,
-      boost::hash<boost::uuids::uuid> > resource_to_node_map_;
+  // Indexed by the resources' dense IDs; NULL for resources without a node.
+  vector<FlowGraphNode*> resource_to_node_map_;
   // Mapping storing flow graph node for each task equivalence class.
   unordered_map<EquivClass_t, FlowGraphNode*> tec_to_node_map_;
   // Mapping storing flow graph node for each unscheduled aggregator.
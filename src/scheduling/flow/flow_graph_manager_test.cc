@@ -159,8 +159,7 @@ TEST_F(FlowGraphManagerTest, AddResourceNode) {
   CHECK_NOTNULL(res_node);
   EXPECT_EQ(res_node->resource_id_, res_id);
   EXPECT_EQ(res_node->rd_ptr_, rd_ptr);
-  EXPECT_EQ(FindPtrOrNull(graph_manager->resource_to_node_map_,
-                          res_node->resource_id_),
+  EXPECT_EQ(graph_manager->NodeForResourceID(res_node->resource_id_),
             res_node);
   EXPECT_EQ(num_nodes + 1,
             graph_manager->graph_change_manager_->flow_graph().NumNodes());
@@ -178,8 +177,7 @@ TEST_F(FlowGraphManagerTest, AddResourceNode) {
   CHECK_NOTNULL(res_child_node);
   EXPECT_EQ(res_child_node->resource_id_, res_child_id);
   EXPECT_EQ(res_child_node->rd_ptr_, rd_child_ptr);
-  EXPECT_EQ(FindPtrOrNull(graph_manager->resource_to_node_map_,
-                          res_child_node->resource_id_),
+  EXPECT_EQ(graph_manager->NodeForResourceID(res_child_node->resource_id_),
             res_child_node);
   EXPECT_NE(graph_manager->leaf_nodes_.find(res_child_node->id_),
             graph_manager->leaf_nodes_.end());
@@ -525,14 +523,13 @@ TEST_F(FlowGraphManagerTest, RemoveResourceNode) {
   FlowGraphNode* res_node = graph_manager->AddResourceNode(rd_ptr);
   CHECK_NOTNULL(res_node);
   EXPECT_EQ(num_arcs, flow_graph.NumArcs());
-  EXPECT_EQ(FindPtrOrNull(graph_manager->resource_to_node_map_,
-                          res_node->resource_id_),
+  EXPECT_EQ(graph_manager->NodeForResourceID(res_node->resource_id_),
             res_node);
   EXPECT_EQ(0, flow_graph.unused_ids_.size());
   graph_manager->RemoveResourceNode(res_node);
   EXPECT_EQ(1, flow_graph.unused_ids_.size());
   ResourceID_t res_id = ResourceIDFromString(rd_ptr->uuid());
-  CHECK(FindPtrOrNull(graph_manager->resource_to_node_map_, res_id) == NULL);
+  CHECK(graph_manager->NodeForResourceID(res_id) == NULL);
   EXPECT_DEATH(graph_manager->RemoveResourceNode(NULL), "");
 }
 
@@ -468,6 +468,22 @@ void FlowScheduler::RegisterResource(ResourceTopologyNodeDescriptor* rtnd_ptr,
   }
 }
 
+void FlowScheduler::RestoreJob(JobDescriptor* jd_ptr) {
+  boost::lock_guard<boost::recursive_mutex> lock(scheduling_lock_);
+  EventDrivenScheduler::AddJob(jd_ptr);
+  vector<TaskDescriptor*> running_tasks;
+  RestoreTaskBindings(jd_ptr->mutable_root_task(), &running_tasks);
+  // Add the job's task nodes to the flow graph straight away so that the
+  // running tasks can be pinned to their resources before the next solver run.
+  vector<JobDescriptor*> jd_ptr_vect;
+  jd_ptr_vect.push_back(jd_ptr);
+  flow_graph_manager_->AddOrUpdateJobNodes(jd_ptr_vect);
+  for (auto& td_ptr : running_tasks) {
+    flow_graph_manager_->TaskScheduled(
+        td_ptr->uid(), ResourceIDFromString(td_ptr->scheduled_to_resource()));
+  }
+}
+
 uint64_t FlowScheduler::RunSchedulingIteration(
     SchedulerStats* scheduler_stats,
     vector<SchedulingDelta>* deltas_output) {
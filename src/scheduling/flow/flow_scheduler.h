@@ -87,6 +87,7 @@ class FlowScheduler : public EventDrivenScheduler {
   virtual void RegisterResource(ResourceTopologyNodeDescriptor* rtnd_ptr,
                                 bool local,
                                 bool simulated);
+  virtual void RestoreJob(JobDescriptor* jd_ptr);
   virtual uint64_t ScheduleAllJobs(SchedulerStats* scheduler_stats);
   virtual uint64_t ScheduleAllJobs(SchedulerStats* scheduler_stats,
                                    vector<SchedulingDelta>* deltas);
@@ -111,38 +111,25 @@ bool FulcrumScheduler::FindResourceForTask(TaskDescriptor& task_desc,
        res_id != data_machines.end();
        ++res_id) {
     ResourceStatus* res_status =  FindPtrOrNull(*resource_map_, *res_id);
-	 CHECK_NOTNULL(res_status);
+    CHECK_NOTNULL(res_status);
     CHECK_EQ(res_status->descriptor().type(),
-                  ResourceDescriptor::RESOURCE_MACHINE);
-	 // Get machine's PUs
-    ResourceID_t machine_res_id = MachineResIDForResource(resource_map_,
-                           ResourceIDFromString(res_status->descriptor().uuid()));
-	 pair<multimap<ResourceID_t, ResourceDescriptor*>::iterator,
-		 multimap<ResourceID_t, ResourceDescriptor*>::iterator> range_it =
-			 machine_res_id_pus_->equal_range(machine_res_id);
-	 for (; range_it.first != range_it.second; range_it.first++) {
-		 ResourceID_t pu_res_id =
-			ResourceIDFromString(range_it.first->second->uuid());
-		 ResourceStatus* pu_res_status = FindPtrOrNull(*resource_map_, pu_res_id);
-		 CHECK_EQ(pu_res_status->descriptor().type(),
-							ResourceDescriptor::RESOURCE_PU);
-		 VLOG(3) << "Considering resource " << pu_res_id
-					<< ", which is in state "
-					<< pu_res_status->descriptor().state();
-       /*
-		 LOG(INFO) << "Considering resource with data " << pu_res_id
-					<< ", which is in state "
-					<< pu_res_status->descriptor().state()
-					<<", of type "
-					<< pu_res_status->descriptor().type();
-       */
-		 if (pu_res_status->descriptor().state() ==
-			  ResourceDescriptor::RESOURCE_IDLE) {
-			*best_resource = pu_res_id;
-			//LOG(INFO)<< "Scheduling on machine with data. ";
-			return true;
-		 }
-  	}
+             ResourceDescriptor::RESOURCE_MACHINE);
+    // Get machine's PUs. The multimap holds the PUs' descriptors, so their
+    // state can be checked without parsing their IDs and looking them up in
+    // the resource map; only the chosen PU's ID is parsed.
+    pair<multimap<ResourceID_t, ResourceDescriptor*>::iterator,
+         multimap<ResourceID_t, ResourceDescriptor*>::iterator> range_it =
+      machine_res_id_pus_->equal_range(*res_id);
+    for (; range_it.first != range_it.second; range_it.first++) {
+      const ResourceDescriptor& pu_rd = *range_it.first->second;
+      CHECK_EQ(pu_rd.type(), ResourceDescriptor::RESOURCE_PU);
+      VLOG(3) << "Considering resource " << pu_rd.uuid()
+              << ", which is in state " << pu_rd.state();
+      if (pu_rd.state() == ResourceDescriptor::RESOURCE_IDLE) {
+        *best_resource = ResourceIDFromString(pu_rd.uuid());
+        return true;
+      }
+    }
   }
 
   // Find the first idle resource in the resource map
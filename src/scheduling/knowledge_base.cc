@@ -96,6 +96,10 @@ KnowledgeBase::~KnowledgeBase() {
 
 void KnowledgeBase::AddMachineSample(const ResourceStats& sample) {
   boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  AddMachineSampleWithLockHeld(sample);
+}
+
+void KnowledgeBase::AddMachineSampleWithLockHeld(const ResourceStats& sample) {
   ResourceID_t rid = ResourceIDFromString(sample.resource_id());
   // Check if we already have a record for this machine
   deque<ResourceStats>* q = FindOrNull(machine_map_, rid);
@@ -117,9 +121,29 @@ void KnowledgeBase::AddMachineSample(const ResourceStats& sample) {
   }
 }
 
+void KnowledgeBase::AddMachineSamples(const vector<ResourceStats>& samples) {
+  // We only acquire the lock once for the entire batch.
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  for (auto& sample : samples) {
+    AddMachineSampleWithLockHeld(sample);
+  }
+}
+
 void KnowledgeBase::AddTaskStatsSample(const TaskStats& sample) {
-  TaskID_t tid = sample.task_id();
   boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  AddTaskStatsSampleWithLockHeld(sample);
+}
+
+void KnowledgeBase::AddTaskStatsSamples(const vector<TaskStats>& samples) {
+  // We only acquire the lock once for the entire batch.
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  for (auto& sample : samples) {
+    AddTaskStatsSampleWithLockHeld(sample);
+  }
+}
+
+void KnowledgeBase::AddTaskStatsSampleWithLockHeld(const TaskStats& sample) {
+  TaskID_t tid = sample.task_id();
   // Check if we already have a record for this task
   deque<TaskStats>* q = FindOrNull(task_map_, tid);
   if (!q) {
@@ -264,6 +288,20 @@ uint64_t KnowledgeBase::GetRuntimeForTask(TaskID_t task_id) {
   return rep->front().finish_time() - rep->front().start_time();
 }
 
+bool KnowledgeBase::GetInputPrefetchProgressForTask(
+    TaskID_t task_id,
+    uint64_t* bytes_prefetched,
+    uint64_t* input_size) {
+  boost::lock_guard<boost::upgrade_mutex> lock_shared(kb_lock_);
+  const pair<uint64_t, uint64_t>* progress =
+    FindOrNull(input_prefetch_progress_, task_id);
+  if (!progress)
+    return false;
+  *bytes_prefetched = progress->first;
+  *input_size = progress->second;
+  return true;
+}
+
 void KnowledgeBase::LoadKnowledgeBaseFromFile() {
   // Load the machine samples.
   fstream machine_samples(FLAGS_serial_machine_samples.c_str(),
@@ -327,6 +365,11 @@ void KnowledgeBase::LoadKnowledgeBaseFromFile() {
   task_samples.close();
 }
 
+void KnowledgeBase::EraseInputPrefetchProgress(TaskID_t task_id) {
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  input_prefetch_progress_.erase(task_id);
+}
+
 void KnowledgeBase::ProcessTaskFinalReport(
     const vector<EquivClass_t>& equiv_classes,
     const TaskFinalReport& report) {
@@ -348,6 +391,16 @@ void KnowledgeBase::ProcessTaskFinalReport(
     reports->push_back(report);
     VLOG(2) << "Recorded final report for task " << report.task_id();
   }
+  // The task no longer reads its inputs.
+  input_prefetch_progress_.erase(report.task_id());
+}
+
+void KnowledgeBase::UpdateInputPrefetchProgress(TaskID_t task_id,
+                                                uint64_t bytes_prefetched,
+                                                uint64_t input_size) {
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  InsertOrUpdate(&input_prefetch_progress_, task_id,
+                 pair<uint64_t, uint64_t>(bytes_prefetched, input_size));
 }
 
 }  // namespace firmament
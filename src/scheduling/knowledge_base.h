@@ -52,7 +52,17 @@ class KnowledgeBase {
                multimap<ResourceID_t, ResourceDescriptor*>* machine_res_id_pus);
   virtual ~KnowledgeBase();
   void AddMachineSample(const ResourceStats& sample);
+  /**
+   * Adds samples for several machines while acquiring the lock only once.
+   * @param samples the machine samples to add
+   */
+  void AddMachineSamples(const vector<ResourceStats>& samples);
   void AddTaskStatsSample(const TaskStats& stats_sample);
+  /**
+   * Adds samples for several tasks while acquiring the lock only once.
+   * @param samples the task samples to add
+   */
+  void AddTaskStatsSamples(const vector<TaskStats>& samples);
   void DumpMachineStats(const ResourceID_t& res_id) const;
   bool GetLatestStatsForMachine(ResourceID_t id, ResourceStats* sample);
   const deque<ResourceStats> GetStatsForMachine(ResourceID_t id);
@@ -64,9 +74,36 @@ class KnowledgeBase {
   const deque<TaskFinalReport>* GetFinalReportForTask(TaskID_t task_id) const;
   const deque<TaskFinalReport>* GetFinalReportsForTEC(EquivClass_t ec_id) const;
   virtual uint64_t GetRuntimeForTask(TaskID_t task_id);
+  /**
+   * Gets the progress of the prefetch of a task's inputs on the machine it
+   * was placed on.
+   * @param task_id the id of the task
+   * @param bytes_prefetched set to the number of input bytes prefetched so
+   * far
+   * @param input_size set to the number of input bytes being prefetched
+   * @return false if no inputs are being prefetched for the task
+   */
+  bool GetInputPrefetchProgressForTask(TaskID_t task_id,
+                                       uint64_t* bytes_prefetched,
+                                       uint64_t* input_size);
   void LoadKnowledgeBaseFromFile();
+  /**
+   * Forgets the progress of the prefetch of a task's inputs, e.g. because
+   * the task failed or was evicted.
+   * @param task_id the id of the task
+   */
+  void EraseInputPrefetchProgress(TaskID_t task_id);
   void ProcessTaskFinalReport(const vector<EquivClass_t>& equiv_classes,
                               const TaskFinalReport& report);
+  /**
+   * Records the progress of the prefetch of a task's inputs.
+   * @param task_id the id of the task
+   * @param bytes_prefetched the number of input bytes prefetched so far
+   * @param input_size the number of input bytes being prefetched
+   */
+  void UpdateInputPrefetchProgress(TaskID_t task_id,
+                                   uint64_t bytes_prefetched,
+                                   uint64_t input_size);
   inline const DataLayerManagerInterface& data_layer_manager() {
     CHECK_NOTNULL(data_layer_manager_);
     return *data_layer_manager_;
@@ -87,9 +124,14 @@ class KnowledgeBase {
   // task, i.e. it mixes samples from all phases
   unordered_map<TaskID_t, deque<TaskStats> > task_map_;
   unordered_map<TaskID_t, deque<TaskFinalReport> > task_exec_reports_;
+  // Bytes prefetched and total bytes being prefetched of each task's inputs.
+  unordered_map<TaskID_t, pair<uint64_t, uint64_t> > input_prefetch_progress_;
   boost::upgrade_mutex kb_lock_;
 
  private:
+  void AddMachineSampleWithLockHeld(const ResourceStats& sample);
+  void AddTaskStatsSampleWithLockHeld(const TaskStats& sample);
+
   fstream serial_machine_samples_;
   fstream serial_task_samples_;
   ::google::protobuf::io::ZeroCopyOutputStream* raw_machine_output_;
@@ -27,6 +27,7 @@
 #include <set>
 #include <vector>
 
+#include <boost/function.hpp>
 #include <ctemplate/template.h>
 
 #include "base/common.h"
@@ -234,6 +235,14 @@ class SchedulerInterface : public PrintableInterface {
                                 bool local,
                                 bool simulated = false) = 0;
 
+  /**
+   * Re-adds a job whose state has been restored from a checkpoint. Unlike
+   * AddJob, tasks that are RUNNING are bound to the resource stored in their
+   * scheduled_to_resource field without notifying the event notifier.
+   * @param jd_ptr the job descriptor of the restored job
+   */
+  virtual void RestoreJob(JobDescriptor* jd_ptr) = 0;
+
   /**
    * Runs a scheduling iteration for all active jobs.
    * @return the number of tasks scheduled
@@ -261,6 +270,16 @@ class SchedulerInterface : public PrintableInterface {
                                 SchedulerStats* scheduler_stats,
                                 vector<SchedulingDelta>* deltas = NULL) = 0;
 
+  /**
+   * Sets the callback invoked when the process of a local task fails. The
+   * failure is handled by the next call to CheckRunningTasksHealth(), which
+   * the callback should bring forward. It runs on the thread that reaps task
+   * processes, and must neither block nor call into the scheduler.
+   * @param notifier the callback
+   */
+  virtual void SetFailedTaskProcessExitNotifier(
+      boost::function<void()> notifier) = 0;
+
  protected:
   /**
    * Handles the migration of a task.
@@ -92,6 +92,12 @@ EquivClass_t SimulatedDataLayerManager::AddMachine(
   return dfs_->AddMachine(machine_res_id);
 }
 
+void SimulatedDataLayerManager::GetAllBlockLocations(
+    vector<pair<TaskID_t, DataLocation> >* block_locations) {
+  CHECK_NOTNULL(block_locations);
+  dfs_->GetAllBlockLocations(block_locations);
+}
+
 void SimulatedDataLayerManager::GetFileLocations(
     const string& file_path, list<DataLocation>* locations) {
   CHECK_NOTNULL(locations);
@@ -112,6 +118,11 @@ int64_t SimulatedDataLayerManager::GetFileSize(const string& file_path) {
   return file_size;
 }
 
+void SimulatedDataLayerManager::RestoreBlock(TaskID_t task_id,
+                                             const DataLocation& location) {
+  dfs_->RestoreBlock(task_id, location);
+}
+
 bool SimulatedDataLayerManager::RemoveMachine(const string& hostname) {
   ResourceID_t* machine_res_id = FindOrNull(hostname_to_res_id_, hostname);
   CHECK_NOTNULL(machine_res_id);
@@ -48,10 +48,19 @@ class SimulatedDataLayerManager : public DataLayerManagerInterface {
                            bool long_running_service,
                            uint64_t max_machine_spread);
   EquivClass_t AddMachine(const string& hostname, ResourceID_t machine_res_id);
+  void GetAllBlockLocations(
+      vector<pair<TaskID_t, DataLocation> >* block_locations);
   void GetFileLocations(const string& file_path, list<DataLocation>* locations);
   int64_t GetFileSize(const string& file_path);
   void RemoveFilesForTask(const TaskDescriptor& td);
   bool RemoveMachine(const string& hostname);
+  void RestoreBlock(TaskID_t task_id, const DataLocation& location);
+  inline void RestoreCheckpoint(const DFSCheckpoint& checkpoint) {
+    dfs_->RestoreCheckpoint(checkpoint);
+  }
+  inline void SaveCheckpoint(DFSCheckpoint* checkpoint) {
+    dfs_->SaveCheckpoint(checkpoint);
+  }
   inline const unordered_set<ResourceID_t, boost::hash<ResourceID_t>>&
     GetMachinesInRack(EquivClass_t rack_ec) {
     return dfs_->GetMachinesInRack(rack_ec);
@@ -26,6 +26,7 @@
 #include "misc/map-util.h"
 #include "misc/trace_generator.h"
 #include "scheduling/data_layer_manager_interface.h"
+#include "sim/simulator_checkpoint.pb.h"
 
 namespace firmament {
 namespace sim {
@@ -51,6 +52,13 @@ class SimulatedDFS {
    * @return the id of the rack in which the machine is located
    */
   virtual EquivClass_t AddMachine(ResourceID_t machine_res_id);
+  /**
+   * Appends the locations of all the block replicas stored in the DFS.
+   * @param block_locations vector to which (task id, location) pairs are
+   * appended
+   */
+  virtual void GetAllBlockLocations(
+      vector<pair<TaskID_t, DataLocation> >* block_locations) = 0;
   virtual void GetFileLocations(const string& file_path,
                                 list<DataLocation>* locations) = 0;
   /**
@@ -67,6 +75,28 @@ class SimulatedDFS {
    */
   virtual bool RemoveMachine(ResourceID_t machine_res_id);
 
+  /**
+   * Re-adds a block replica that has been saved in a simulator checkpoint.
+   * The block is placed on the machine it was on when the checkpoint was
+   * taken rather than on a newly chosen machine.
+   * @param task_id the id of the task to which the block belongs
+   * @param location the location of the block replica
+   */
+  virtual void RestoreBlock(TaskID_t task_id, const DataLocation& location) = 0;
+
+  /**
+   * Restores the state of the random generators used to place blocks.
+   * @param checkpoint the state saved by SaveCheckpoint
+   */
+  virtual void RestoreCheckpoint(const DFSCheckpoint& checkpoint) = 0;
+
+  /**
+   * Saves the state of the random generators used to place blocks so that
+   * the blocks of tasks added after a restore go to the same machines.
+   * @param checkpoint the message to save the state to
+   */
+  virtual void SaveCheckpoint(DFSCheckpoint* checkpoint) = 0;
+
   inline const unordered_set<ResourceID_t, boost::hash<ResourceID_t>>&
     GetMachinesInRack(EquivClass_t rack_ec) {
     auto machines_in_rack = FindOrNull(rack_to_machine_res_, rack_ec);
@@ -20,6 +20,8 @@
 
 #include "sim/dfs/simulated_skewed_dfs.h"
 
+#include <sstream>
+
 DECLARE_uint64(simulated_dfs_replication_factor);
 DECLARE_uint64(simulated_block_size);
 
@@ -63,6 +65,20 @@ void SimulatedSkewedDFS::AddBlocksForTask(const TaskDescriptor& td,
   }
 }
 
+void SimulatedSkewedDFS::RestoreCheckpoint(const DFSCheckpoint& checkpoint) {
+  SimulatedUniformDFS::RestoreCheckpoint(checkpoint);
+  istringstream engine_state(checkpoint.random_engine_state());
+  engine_state >> rand_gen_;
+  CHECK(!engine_state.fail()) << "Failed to restore random engine state";
+}
+
+void SimulatedSkewedDFS::SaveCheckpoint(DFSCheckpoint* checkpoint) {
+  SimulatedUniformDFS::SaveCheckpoint(checkpoint);
+  ostringstream engine_state;
+  engine_state << rand_gen_;
+  checkpoint->set_random_engine_state(engine_state.str());
+}
+
 ResourceID_t SimulatedSkewedDFS::GetMachineForNewBlock() {
   uint32_t machine_pareto_index =
     static_cast<uint32_t>(round(boost::math::quantile(pareto_dist_,
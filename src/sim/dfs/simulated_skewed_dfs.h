@@ -39,6 +39,9 @@ class SimulatedSkewedDFS : public SimulatedUniformDFS {
 
   void AddBlocksForTask(const TaskDescriptor& td, uint64_t num_blocks,
                         uint64_t max_machine_spread);
+  void RestoreCheckpoint(const DFSCheckpoint& checkpoint);
+  void SaveCheckpoint(DFSCheckpoint* checkpoint);
+
  private:
   ResourceID_t GetMachineForNewBlock();
 
@@ -75,6 +75,16 @@ uint64_t SimulatedUniformDFS::GenerateBlockID(TaskID_t task_id,
   return hash;
 }
 
+void SimulatedUniformDFS::GetAllBlockLocations(
+    vector<pair<TaskID_t, DataLocation> >* block_locations) {
+  CHECK_NOTNULL(block_locations);
+  block_locations->reserve(block_locations->size() +
+                           task_to_data_locations_.size());
+  for (auto& task_location : task_to_data_locations_) {
+    block_locations->push_back(task_location);
+  }
+}
+
 void SimulatedUniformDFS::GetFileLocations(const string& file_path,
                                            list<DataLocation>* locations) {
   CHECK_NOTNULL(locations);
@@ -131,6 +141,36 @@ void SimulatedUniformDFS::PlaceBlockOnMachines(TaskID_t task_id,
   }
 }
 
+void SimulatedUniformDFS::RestoreBlock(TaskID_t task_id,
+                                       const DataLocation& location) {
+  uint64_t* num_free_blocks =
+    FindOrNull(machine_num_free_blocks_, location.machine_res_id_);
+  CHECK_NOTNULL(num_free_blocks);
+  CHECK_GT(*num_free_blocks, 0);
+  *num_free_blocks = *num_free_blocks - 1;
+  unordered_set<TaskID_t>* tasks_machine =
+    FindOrNull(tasks_on_machine_, location.machine_res_id_);
+  CHECK_NOTNULL(tasks_machine);
+  tasks_machine->insert(task_id);
+  // The rack ids are assigned again when the machines are re-added, so we
+  // do not trust the rack id stored in the checkpoint.
+  DataLocation data_location(location.machine_res_id_,
+                             GetRackForMachine(location.machine_res_id_),
+                             location.block_id_, location.size_bytes_);
+  task_to_data_locations_.insert(pair<TaskID_t, DataLocation>(task_id,
+                                                              data_location));
+}
+
+void SimulatedUniformDFS::RestoreCheckpoint(
+    const DFSCheckpoint& checkpoint) {
+  rand_seed_ = checkpoint.rand_seed();
+}
+
+void SimulatedUniformDFS::SaveCheckpoint(DFSCheckpoint* checkpoint) {
+  CHECK_NOTNULL(checkpoint);
+  checkpoint->set_rand_seed(rand_seed_);
+}
+
 void SimulatedUniformDFS::RemoveBlocksForTask(TaskID_t task_id) {
   pair<unordered_multimap<TaskID_t, DataLocation>::iterator,
        unordered_multimap<TaskID_t, DataLocation>::iterator> range_it =
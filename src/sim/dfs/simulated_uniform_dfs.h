@@ -62,6 +62,8 @@ class SimulatedUniformDFS : public SimulatedDFS {
    * @return the id of the rack in which the machine is located
    */
   EquivClass_t AddMachine(ResourceID_t machine_res_id);
+  void GetAllBlockLocations(
+      vector<pair<TaskID_t, DataLocation> >* block_locations);
   void GetFileLocations(const string& file_path, list<DataLocation>* locations);
 
   /**
@@ -79,6 +81,15 @@ class SimulatedUniformDFS : public SimulatedDFS {
    */
   bool RemoveMachine(ResourceID_t machine_res_id);
 
+  /**
+   * Re-adds a block replica that has been saved in a simulator checkpoint.
+   * @param task_id the id of the task to which the block belongs
+   * @param location the location of the block replica
+   */
+  void RestoreBlock(TaskID_t task_id, const DataLocation& location);
+  virtual void RestoreCheckpoint(const DFSCheckpoint& checkpoint);
+  virtual void SaveCheckpoint(DFSCheckpoint* checkpoint);
+
  protected:
   uint64_t GenerateBlockID(TaskID_t task_id, uint64_t block_index);
   void PlaceBlockOnMachines(TaskID_t task_id, uint64_t block_id);
@@ -165,5 +165,16 @@ void EventManager::RemoveTaskEndRuntimeEvent(
   }
 }
 
+void EventManager::SaveCheckpoint(CheckpointWriter* writer) {
+  CHECK_NOTNULL(writer);
+  CheckpointRecord record;
+  CheckpointEvent* checkpoint_event = record.mutable_event();
+  for (auto& timestamp_event : events_) {
+    checkpoint_event->set_timestamp(timestamp_event.first);
+    checkpoint_event->mutable_event()->CopyFrom(timestamp_event.second);
+    writer->WriteRecord(record);
+  }
+}
+
 } // namespace sim
 } // namespace firmament
@@ -28,6 +28,7 @@
 #include "misc/time_interface.h"
 #include "sim/event_desc.pb.h"
 #include "sim/simulated_wall_time.h"
+#include "sim/simulator_checkpoint.h"
 #include "sim/trace_utils.h"
 
 namespace firmament {
@@ -80,6 +81,19 @@ class EventManager {
   void RemoveTaskEndRuntimeEvent(const TraceTaskIdentifier& task_identifier,
                                  uint64_t task_end_time);
 
+  /**
+   * Writes all the pending simulator events to a checkpoint.
+   * @param writer the checkpoint writer to use
+   */
+  void SaveCheckpoint(CheckpointWriter* writer);
+
+  inline uint64_t num_events_processed() const {
+    return num_events_processed_;
+  }
+  inline void set_num_events_processed(uint64_t num_events_processed) {
+    num_events_processed_ = num_events_processed;
+  }
+
  private:
   SimulatedWallTime* simulated_time_;
   // The map storing the simulator events. Maps from timestamp to simulator
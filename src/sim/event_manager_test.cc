@@ -22,8 +22,10 @@
 
 #include <gtest/gtest.h>
 
+#include "misc/utils.h"
 #include "sim/event_manager.h"
 #include "sim/simulated_wall_time.h"
+#include "sim/simulator_checkpoint.h"
 
 DEFINE_string(scheduler, "flow", "The scheduler to use for tests.");
 
@@ -57,11 +59,11 @@ TEST(EventManagerTest, AddEvent) {
   EventDescriptor event_desc;
   event_desc.set_type(EventDescriptor::TASK_END_RUNTIME);
   event_manager.AddEvent(2, event_desc);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 2);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), 2U);
   event_manager.AddEvent(3, event_desc);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 2);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), 2U);
   event_manager.AddEvent(1, event_desc);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 1);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), 1U);
 }
 
 TEST(EventManagerTest, GetNextEvent) {
@@ -72,8 +74,8 @@ TEST(EventManagerTest, GetNextEvent) {
   event_manager.AddEvent(2, event_desc);
   event_desc.set_type(EventDescriptor::TASK_END_RUNTIME);
   event_manager.AddEvent(2, event_desc);
-  CHECK_EQ(event_manager.GetNextEvent().first, 2);
-  CHECK_EQ(event_manager.GetNextEvent().first, 2);
+  EXPECT_EQ(event_manager.GetNextEvent().first, 2U);
+  EXPECT_EQ(event_manager.GetNextEvent().first, 2U);
 }
 
 TEST(EventManagerTest, RemoveTaskEndRuntimeEvent) {
@@ -90,13 +92,44 @@ TEST(EventManagerTest, RemoveTaskEndRuntimeEvent) {
   task_identifier.job_id = 1;
   task_identifier.task_index = 1;
   event_manager.RemoveTaskEndRuntimeEvent(task_identifier, 2);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 2);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), 2U);
   task_identifier.task_index = 3;
   event_manager.RemoveTaskEndRuntimeEvent(task_identifier, 2);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), 2);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), 2U);
   task_identifier.task_index = 2;
   event_manager.RemoveTaskEndRuntimeEvent(task_identifier, 2);
-  CHECK_EQ(event_manager.GetTimeOfNextEvent(), UINT64_MAX);
+  EXPECT_EQ(event_manager.GetTimeOfNextEvent(), UINT64_MAX);
+}
+
+TEST(EventManagerTest, SaveCheckpoint) {
+  SimulatedWallTime simulated_time;
+  EventManager event_manager(&simulated_time);
+  EventDescriptor event_desc;
+  event_desc.set_type(EventDescriptor::TASK_SUBMIT);
+  event_desc.set_job_id(1);
+  event_desc.set_task_index(1);
+  event_manager.AddEvent(3, event_desc);
+  event_desc.set_type(EventDescriptor::MACHINE_HEARTBEAT);
+  event_manager.AddEvent(1, event_desc);
+  string dir = MakeTemporaryDirectory("event_manager_test");
+  ASSERT_FALSE(dir.empty());
+  string checkpoint_file = dir + "/checkpoint";
+  {
+    CheckpointWriter writer(checkpoint_file);
+    event_manager.SaveCheckpoint(&writer);
+    EXPECT_EQ(writer.num_records_written(), 2U);
+  }
+  CheckpointReader reader(checkpoint_file);
+  CheckpointRecord record;
+  ASSERT_TRUE(reader.ReadRecord(&record));
+  EXPECT_EQ(record.event().timestamp(), 1U);
+  EXPECT_EQ(record.event().event().type(), EventDescriptor::MACHINE_HEARTBEAT);
+  ASSERT_TRUE(reader.ReadRecord(&record));
+  EXPECT_EQ(record.event().timestamp(), 3U);
+  EXPECT_EQ(record.event().event().type(), EventDescriptor::TASK_SUBMIT);
+  EXPECT_EQ(record.event().event().task_index(), 1U);
+  EXPECT_FALSE(reader.ReadRecord(&record));
+  EXPECT_TRUE(RemoveDirectoryRecursively(dir));
 }
 
 } // namespace sim
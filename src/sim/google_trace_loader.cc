@@ -203,12 +203,7 @@ bool GoogleTraceLoader::LoadTaskEvents(
     if (!task_events_file_) {
       if (current_task_events_file_id_ < FLAGS_num_files_to_process) {
         // We still have files to open.
-        string fname;
-        spf(&fname, "%s/task_events/part-%05d-of-00500.csv",
-            FLAGS_trace_path.c_str(), current_task_events_file_id_);
-        if ((task_events_file_ = fopen(fname.c_str(), "r")) == NULL) {
-          LOG(FATAL) << "Failed to open trace for reading of task events.";
-        }
+        OpenTaskEventsFile();
       } else {
         // There are no task events left to load.
         return loaded_event;
@@ -475,5 +470,56 @@ uint64_t GoogleTraceLoader::MaxMachineEventHashToRetain() {
   }
 }
 
+void GoogleTraceLoader::OpenTaskEventsFile() {
+  string fname;
+  spf(&fname, "%s/task_events/part-%05d-of-00500.csv",
+      FLAGS_trace_path.c_str(), current_task_events_file_id_);
+  if ((task_events_file_ = fopen(fname.c_str(), "r")) == NULL) {
+    LOG(FATAL) << "Failed to open trace for reading of task events.";
+  }
+}
+
+void GoogleTraceLoader::RestoreCheckpoint(
+    const TraceLoaderCheckpoint& checkpoint) {
+  if (task_events_file_) {
+    fclose(task_events_file_);
+    task_events_file_ = NULL;
+  }
+  current_task_events_file_id_ = checkpoint.task_events_file_id();
+  loaded_synthetic_task_ = checkpoint.loaded_synthetic_task();
+  filtered_tasks_.clear();
+  for (auto& filtered_task : checkpoint.filtered_tasks()) {
+    TraceTaskIdentifier task_id;
+    task_id.job_id = filtered_task.job_id();
+    task_id.task_index = filtered_task.task_index();
+    filtered_tasks_.insert(task_id);
+  }
+  if (checkpoint.task_events_file_offset() >= 0) {
+    // The checkpoint was taken while we were reading from a file.
+    OpenTaskEventsFile();
+    CHECK_EQ(fseek(task_events_file_, checkpoint.task_events_file_offset(),
+                   SEEK_SET), 0)
+      << "Failed to seek in task events file "
+      << current_task_events_file_id_;
+  }
+}
+
+void GoogleTraceLoader::SaveCheckpoint(TraceLoaderCheckpoint* checkpoint) {
+  CHECK_NOTNULL(checkpoint);
+  checkpoint->set_task_events_file_id(current_task_events_file_id_);
+  if (task_events_file_) {
+    checkpoint->set_task_events_file_offset(ftell(task_events_file_));
+  } else {
+    checkpoint->set_task_events_file_offset(-1);
+  }
+  checkpoint->set_loaded_synthetic_task(loaded_synthetic_task_);
+  for (auto& task_id : filtered_tasks_) {
+    CheckpointTraceTaskIdentifier* filtered_task =
+      checkpoint->add_filtered_tasks();
+    filtered_task->set_job_id(task_id.job_id);
+    filtered_task->set_task_index(task_id.task_index);
+  }
+}
+
 } // namespace sim
 } // namespace firmament
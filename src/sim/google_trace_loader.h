@@ -75,8 +75,12 @@ class GoogleTraceLoader : public TraceLoader {
   void LoadTasksRunningTime(
       unordered_map<TaskID_t, uint64_t>* task_runtime);
 
+  void RestoreCheckpoint(const TraceLoaderCheckpoint& checkpoint);
+  void SaveCheckpoint(TraceLoaderCheckpoint* checkpoint);
+
  private:
   uint64_t MaxEventHashToRetain();
+  void OpenTaskEventsFile();
   uint64_t MaxMachineEventHashToRetain();
 
   // The number of the task events file the simulator is reading from.
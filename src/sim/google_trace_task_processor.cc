@@ -23,7 +23,9 @@
 #include "sim/google_trace_task_processor.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 #include <errno.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -60,6 +62,7 @@ DECLARE_bool(aggregate_task_usage);
 DECLARE_bool(jobs_runtime);
 DECLARE_bool(jobs_num_tasks);
 DECLARE_int32(num_files_to_process);
+DECLARE_int32(num_processing_threads);
 
 DEFINE_uint64(bin_time_duration, 10, "Bin size in microseconds.");
 
@@ -76,6 +79,15 @@ namespace sim {
     }
   }
 
+  // Runs the jobs assigned to one of the threads of RunInParallel.
+  void RunJobs(uint32_t first_job, uint32_t num_threads, uint32_t num_jobs,
+               boost::function<void(uint32_t)> job) {
+    for (uint32_t job_index = first_job; job_index < num_jobs;
+         job_index += num_threads) {
+      job(job_index);
+    }
+  }
+
   GoogleTraceTaskProcessor::GoogleTraceTaskProcessor(const string& trace_path):
     trace_path_(trace_path) {
   }
@@ -224,24 +236,23 @@ namespace sim {
   }
 
   void GoogleTraceTaskProcessor::ExpandTaskEvent(
-      uint64_t timestamp, const TaskIdentifier& task_id, int32_t event_type,
-      unordered_map<TaskIdentifier, TaskRuntime,
-                    TaskIdentifierHasher>* tasks_runtime,
-      unordered_map<uint64_t, string>* job_id_to_name,
-      vector<string>& line_cols) {
+      const TaskEventRecord& event, TaskRuntimeMap_t* tasks_runtime) {
+    uint64_t timestamp = event.timestamp_;
+    const TaskIdentifier& task_id = event.task_id_;
+    int32_t event_type = event.event_type_;
     if (event_type == TASK_SCHEDULE) {
       TaskRuntime* task_runtime_ptr = FindOrNull(*tasks_runtime, task_id);
       if (task_runtime_ptr == NULL) {
         TaskRuntime task_runtime;
         task_runtime.start_time_ = timestamp;
         task_runtime.last_schedule_time_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        SetTaskRequests(event.task_requests_, &task_runtime);
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         // Update the last scheduling time for the task. Assumes that
         // the previously running instance of the task has finished/failed.
         task_runtime_ptr->last_schedule_time_ = timestamp;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        SetTaskRequests(event.task_requests_, task_runtime_ptr);
       }
     } else if (event_type == TASK_EVICT || event_type == TASK_FAIL ||
                event_type == TASK_KILL || event_type == TASK_LOST) {
@@ -254,7 +265,7 @@ namespace sim {
         task_runtime.start_time_ = 0;
         task_runtime.num_runs_ = 1;
         task_runtime.total_runtime_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        SetTaskRequests(event.task_requests_, &task_runtime);
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         // Update the runtime for the task. The failed tasks are included
@@ -262,11 +273,10 @@ namespace sim {
         task_runtime_ptr->num_runs_++;
         task_runtime_ptr->total_runtime_ +=
           timestamp - task_runtime_ptr->last_schedule_time_;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        SetTaskRequests(event.task_requests_, task_runtime_ptr);
         task_runtime_ptr->last_schedule_time_ = -1;  // unscheduled
       }
     } else if (event_type == TASK_FINISH) {
-      string logical_job_name = (*job_id_to_name)[task_id.job_id_];
       TaskRuntime* task_runtime_ptr = FindOrNull(*tasks_runtime, task_id);
       if (task_runtime_ptr == NULL) {
         // First event for this task.
@@ -275,14 +285,14 @@ namespace sim {
         task_runtime.start_time_ = 0;
         task_runtime.num_runs_ = 1;
         task_runtime.total_runtime_ = timestamp;
-        PopulateTaskRuntime(&task_runtime, line_cols);
+        SetTaskRequests(event.task_requests_, &task_runtime);
         task_runtime.runtime_ = timestamp;
         InsertIfNotPresent(tasks_runtime, task_id, task_runtime);
       } else {
         task_runtime_ptr->num_runs_++;
         task_runtime_ptr->total_runtime_ +=
           timestamp - task_runtime_ptr->last_schedule_time_;
-        PopulateTaskRuntime(task_runtime_ptr, line_cols);
+        SetTaskRequests(event.task_requests_, task_runtime_ptr);
         CHECK_GE(task_runtime_ptr->last_schedule_time_, 0);
         // NOTE: runtime_ represents the time the task spent running in the run
         // that finished correctly. This value is computed as
@@ -460,6 +470,10 @@ namespace sim {
   }
 
   void GoogleTraceTaskProcessor::AggregateTaskUsage() {
+    if (FLAGS_num_processing_threads > 1) {
+      AggregateTaskUsageParallel();
+      return;
+    }
     unordered_map<uint64_t, uint64_t>* job_num_tasks =
       new unordered_map<uint64_t, uint64_t>();
     multimap<uint64_t, TaskSchedulingEvent>& scheduling_events =
@@ -555,6 +569,61 @@ namespace sim {
     fclose(usage_stat_file);
   }
 
+  void GoogleTraceTaskProcessor::AggregateTaskUsageParallel() {
+    uint32_t num_partitions = NumPartitions();
+    uint32_t num_workers = static_cast<uint32_t>(FLAGS_num_processing_threads);
+    // Compute the time of the first FINISH event of every task.
+    vector<PartitionedTaskFinishTime_t> worker_finish_times(
+        num_workers, PartitionedTaskFinishTime_t(num_partitions));
+    RunInParallel(num_workers,
+                  boost::bind(&GoogleTraceTaskProcessor::MapTaskFinishTimes,
+                              this, num_workers, &worker_finish_times, _1));
+    RunInParallel(num_partitions,
+                  boost::bind(&GoogleTraceTaskProcessor::ReduceTaskFinishTimes,
+                              this, &worker_finish_times, _1));
+    // The finish times have been merged into the first worker's partitions.
+    const PartitionedTaskFinishTime_t& finish_times = worker_finish_times[0];
+    vector<PartitionedTaskUsageStats_t> worker_usage_stats(
+        num_workers, PartitionedTaskUsageStats_t(num_partitions));
+    vector<uint64_t> last_timestamps(num_workers, 0);
+    RunInParallel(num_workers,
+                  boost::bind(&GoogleTraceTaskProcessor::MapTaskUsage,
+                              this, num_workers, boost::cref(finish_times),
+                              &worker_usage_stats, &last_timestamps, _1));
+    RunInParallel(num_partitions,
+                  boost::bind(&GoogleTraceTaskProcessor::ReduceTaskUsage,
+                              this, &worker_usage_stats, _1));
+    FILE* usage_stat_file = NULL;
+    string usage_directory;
+    spf(&usage_directory, "%s/task_usage_stat", trace_path_.c_str());
+    MkdirIfNotPresent(usage_directory);
+    string usage_file_name;
+    spf(&usage_file_name, "%s/task_usage_stat.csv", usage_directory.c_str());
+    if ((usage_stat_file = fopen(usage_file_name.c_str(), "w")) == NULL) {
+      LOG(FATAL) << "Failed to open task_usage_stat file for writing";
+    }
+    const PartitionedTaskUsageStats_t& usage_stats = worker_usage_stats[0];
+    uint64_t last_timestamp = *max_element(last_timestamps.begin(),
+                                           last_timestamps.end());
+    for (uint32_t partition = 0; partition < num_partitions; ++partition) {
+      // Like the sequential version, print statistics for tasks that finish
+      // before the last usage sample even if they do not have any samples.
+      for (auto& task_id_finish_time : finish_times[partition]) {
+        if (task_id_finish_time.second <= last_timestamp &&
+            usage_stats[partition].find(task_id_finish_time.first) ==
+            usage_stats[partition].end()) {
+          PrintStats(usage_stat_file, task_id_finish_time.first,
+                     TaskResourceUsageStats());
+        }
+      }
+      for (auto& task_id_to_usage : usage_stats[partition]) {
+        PrintStats(usage_stat_file, task_id_to_usage.first,
+                   task_id_to_usage.second);
+      }
+    }
+    fclose(usage_stat_file);
+  }
+
   // Returns a mapping job id to logical job name.
   unordered_map<uint64_t, string>&
       GoogleTraceTaskProcessor::ReadLogicalJobsName() {
@@ -649,12 +718,9 @@ namespace sim {
 
   void GoogleTraceTaskProcessor::JobsRuntimeEvents() {
     unordered_map<uint64_t, string>& job_id_to_name = ReadLogicalJobsName();
-    unordered_map<TaskIdentifier, TaskRuntime,
-                  TaskIdentifierHasher> tasks_runtime;
-    uint64_t end_simulation_time = 0;
-    char line[200];
-    vector<string> line_cols;
-    FILE* events_file = NULL;
+    uint32_t num_partitions = NumPartitions();
+    PartitionedTaskRuntime_t tasks_runtime(num_partitions);
+    vector<uint64_t> end_simulation_times(num_partitions, 0);
     string out_events_directory;
     spf(&out_events_directory, "%s/task_runtime_events", trace_path_.c_str());
     MkdirIfNotPresent(out_events_directory);
@@ -665,83 +731,72 @@ namespace sim {
     if ((out_events_file = fopen(out_file_name.c_str(), "w")) == NULL) {
       LOG(FATAL) << "Failed to open task_runtime_events file for writing";
     }
-    for (int32_t file_num = 0; file_num < FLAGS_num_files_to_process;
-         file_num++) {
-      LOG(INFO) << "Reading task_events file " << file_num;
-      string file_name;
-      spf(&file_name, "%s/task_events/part-%05d-of-00500.csv",
-          trace_path_.c_str(), file_num);
-      if ((events_file = fopen(file_name.c_str(), "r")) == NULL) {
-        LOG(FATAL) << "Failed to open trace for reading of task events.";
-      }
-      int64_t num_line = 1;
-      while (!feof(events_file)) {
-        if (fscanf(events_file, "%[^\n]%*[\n]", &line[0]) > 0) {
-          boost::split(line_cols, line, is_any_of(","), token_compress_off);
-          if (line_cols.size() != 13) {
-            LOG(ERROR) << "Unexpected structure of task event on line "
-                       << num_line << ": found " << line_cols.size()
-                       << " columns.";
+    int32_t batch_size = max(FLAGS_num_processing_threads, 1);
+    for (int32_t first_file_num = 0;
+         first_file_num < FLAGS_num_files_to_process;
+         first_file_num += batch_size) {
+      uint32_t num_files =
+        min(batch_size, FLAGS_num_files_to_process - first_file_num);
+      // Map: parse the batch of task_events files in parallel.
+      vector<PartitionedTaskEvents_t> files_events(num_files);
+      RunInParallel(num_files,
+                    boost::bind(&GoogleTraceTaskProcessor::MapTaskEventsFile,
+                                this, first_file_num, num_partitions,
+                                &files_events, _1));
+      // Reduce: expand the events of every task partition. The events of a
+      // task always end up in the same partition, and are expanded in the
+      // order in which they appear in the trace.
+      RunInParallel(num_partitions,
+                    boost::bind(&GoogleTraceTaskProcessor::ReduceTaskEvents,
+                                this, boost::cref(files_events),
+                                &tasks_runtime, &end_simulation_times, _1));
+    }
+    uint64_t end_simulation_time = *max_element(end_simulation_times.begin(),
+                                                end_simulation_times.end());
+    for (auto& partition_tasks_runtime : tasks_runtime) {
+      for (auto& task_id_runtime : partition_tasks_runtime) {
+        TaskIdentifier task_id = task_id_runtime.first;
+        string logical_job_name =  job_id_to_name[task_id.job_id_];
+        TaskRuntime task_runtime = task_id_runtime.second;
+        if (task_runtime.last_schedule_time_ >= 0) {
+          // Task is still running.
+          if (task_runtime.num_runs_ == 0) {
+            // It's the first time the task is running. We assume it
+            // runs until the end of the trace.
+            task_runtime.runtime_ =
+              end_simulation_time - task_runtime.last_schedule_time_;
+            task_runtime.num_runs_++;
+            task_runtime.total_runtime_ = task_runtime.runtime_;
           } else {
-            TaskIdentifier task_id;
-            uint64_t timestamp = lexical_cast<uint64_t>(line_cols[0]);
-            if (timestamp < numeric_limits<int64_t>::max()) {
-              end_simulation_time = max(end_simulation_time, timestamp);
+            if (task_runtime.runtime_ == 0) {
+              // The task has never completed successfully.
+              // We assume that the task is going to run for the average
+              // duration of the previous failed runs.
+              task_runtime.runtime_ =
+                task_runtime.total_runtime_ / task_runtime.num_runs_;
             }
-            task_id.job_id_ = lexical_cast<uint64_t>(line_cols[2]);
-            task_id.task_index_ = lexical_cast<uint64_t>(line_cols[3]);
-            int32_t event_type = lexical_cast<int32_t>(line_cols[5]);
-            ExpandTaskEvent(timestamp, task_id, event_type, &tasks_runtime,
-                            &job_id_to_name, line_cols);
+            // Make sure the time left to run the task doesn't exceed
+            // simulation's end time.
+            if (task_runtime.runtime_ >
+                end_simulation_time - task_runtime.last_schedule_time_) {
+              task_runtime.total_runtime_ +=
+                end_simulation_time - task_runtime.last_schedule_time_;
+            } else {
+              task_runtime.total_runtime_ += task_runtime.runtime_;
+            }
+            task_runtime.num_runs_++;
           }
-        }
-        num_line++;
-      }
-      fclose(events_file);
-    }
-
-    for (auto& task_id_runtime : tasks_runtime) {
-      TaskIdentifier task_id = task_id_runtime.first;
-      string logical_job_name =  job_id_to_name[task_id.job_id_];
-      TaskRuntime task_runtime = task_id_runtime.second;
-      if (task_runtime.last_schedule_time_ >= 0) {
-        // Task is still running.
-        if (task_runtime.num_runs_ == 0) {
-          // It's the first time the task is running. We assume it
-          // runs until the end of the trace.
-          task_runtime.runtime_ =
-            end_simulation_time - task_runtime.last_schedule_time_;
-          task_runtime.num_runs_++;
-          task_runtime.total_runtime_ = task_runtime.runtime_;
         } else {
           if (task_runtime.runtime_ == 0) {
-            // The task has never completed successfully.
-            // We assume that the task is going to run for the average duration
-            // of the previous failed runs.
+            // The task has never completed successfully. Set the runtime
+            // to the average of the failed runs.
             task_runtime.runtime_ =
               task_runtime.total_runtime_ / task_runtime.num_runs_;
           }
-          // Make sure the time left to run the task doesn't exceed
-          // simulation's end time.
-          if (task_runtime.runtime_ >
-              end_simulation_time - task_runtime.last_schedule_time_) {
-            task_runtime.total_runtime_ +=
-              end_simulation_time - task_runtime.last_schedule_time_;
-          } else {
-            task_runtime.total_runtime_ += task_runtime.runtime_;
-          }
-          task_runtime.num_runs_++;
-        }
-      } else {
-        if (task_runtime.runtime_ == 0) {
-          // The task has never completed successfully. Set the runtime
-          // to the average of the failed runs.
-          task_runtime.runtime_ =
-            task_runtime.total_runtime_ / task_runtime.num_runs_;
         }
+        PrintTaskRuntime(out_events_file, task_runtime, task_id,
+                         logical_job_name);
       }
-      PrintTaskRuntime(out_events_file, task_runtime, task_id,
-                       logical_job_name);
     }
     job_id_to_name.clear();
     delete &job_id_to_name;
@@ -775,6 +830,225 @@ namespace sim {
     delete job_num_tasks;
   }
 
+  void GoogleTraceTaskProcessor::MapTaskEventsFile(
+      int32_t first_file_num, uint32_t num_partitions,
+      vector<PartitionedTaskEvents_t>* files_events, uint32_t file_index) {
+    ReadTaskEventsFile(first_file_num + file_index, num_partitions,
+                       &(*files_events)[file_index]);
+  }
+
+  void GoogleTraceTaskProcessor::MapTaskFinishTimes(
+      uint32_t num_workers,
+      vector<PartitionedTaskFinishTime_t>* finish_times,
+      uint32_t worker) {
+    PartitionedTaskFinishTime_t* worker_finish_times =
+      &(*finish_times)[worker];
+    uint32_t num_partitions = worker_finish_times->size();
+    for (int32_t file_num = worker; file_num < FLAGS_num_files_to_process;
+         file_num += num_workers) {
+      PartitionedTaskEvents_t events;
+      ReadTaskEventsFile(file_num, num_partitions, &events);
+      for (uint32_t partition = 0; partition < num_partitions; ++partition) {
+        for (auto& event : events[partition]) {
+          if (event.event_type_ == TASK_FINISH) {
+            uint64_t* finish_time =
+              FindOrNull((*worker_finish_times)[partition], event.task_id_);
+            if (finish_time == NULL) {
+              InsertIfNotPresent(&(*worker_finish_times)[partition],
+                                 event.task_id_, event.timestamp_);
+            } else {
+              *finish_time = min(*finish_time, event.timestamp_);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void GoogleTraceTaskProcessor::MapTaskUsage(
+      uint32_t num_workers,
+      const PartitionedTaskFinishTime_t& finish_times,
+      vector<PartitionedTaskUsageStats_t>* usage_stats,
+      vector<uint64_t>* last_timestamps,
+      uint32_t worker) {
+    PartitionedTaskUsageStats_t* worker_usage_stats = &(*usage_stats)[worker];
+    uint64_t* last_timestamp = &(*last_timestamps)[worker];
+    uint32_t num_partitions = worker_usage_stats->size();
+    char line[200];
+    vector<string> line_cols;
+    FILE* usage_file = NULL;
+    for (int32_t file_num = worker; file_num < FLAGS_num_files_to_process;
+         file_num += num_workers) {
+      LOG(INFO) << "Reading task_usage file " << file_num;
+      string file_name;
+      spf(&file_name, "%s/task_usage/part-%05d-of-00500.csv",
+          trace_path_.c_str(), file_num);
+      if ((usage_file = fopen(file_name.c_str(), "r")) == NULL) {
+        LOG(FATAL) << "Failed to open trace for reading of task "
+                   << "resource usage.";
+      }
+      int64_t num_line = 1;
+      while (!feof(usage_file)) {
+        if (fscanf(usage_file, "%[^\n]%*[\n]", &line[0]) > 0) {
+          boost::split(line_cols, line, is_any_of(","), token_compress_off);
+          if (line_cols.size() != 19 && line_cols.size() != 20) {
+            LOG(ERROR) << "Unexpected structure of task usage on line "
+                       << num_line << ": found " << line_cols.size()
+                       << " columns.";
+          } else {
+            uint64_t start_timestamp = lexical_cast<uint64_t>(line_cols[0]);
+            *last_timestamp = max(*last_timestamp, start_timestamp);
+            TaskIdentifier cur_task_id;
+            cur_task_id.job_id_ = lexical_cast<uint64_t>(line_cols[2]);
+            cur_task_id.task_index_ = lexical_cast<uint64_t>(line_cols[3]);
+            uint32_t partition = PartitionForTask(cur_task_id, num_partitions);
+            const uint64_t* finish_time =
+              FindOrNull(finish_times[partition], cur_task_id);
+            if (finish_time != NULL && *finish_time < start_timestamp) {
+              // Ignore task usage statistics after the end of the task.
+              num_line++;
+              continue;
+            }
+            TaskResourceUsage task_resource_usage =
+              BuildTaskResourceUsage(line_cols);
+            TaskResourceUsageStats* usage_stats_ptr =
+              FindOrNull((*worker_usage_stats)[partition], cur_task_id);
+            if (!usage_stats_ptr) {
+              TaskResourceUsageStats new_usage_stats;
+              InitializeResourceUsageStats(&new_usage_stats);
+              UpdateUsageStats(task_resource_usage, &new_usage_stats);
+              InsertOrUpdate(&(*worker_usage_stats)[partition], cur_task_id,
+                             new_usage_stats);
+            } else {
+              UpdateUsageStats(task_resource_usage, usage_stats_ptr);
+            }
+          }
+        }
+        num_line++;
+      }
+      fclose(usage_file);
+    }
+  }
+
+  uint32_t GoogleTraceTaskProcessor::NumPartitions() {
+    return static_cast<uint32_t>(max(FLAGS_num_processing_threads, 1));
+  }
+
+  uint32_t GoogleTraceTaskProcessor::PartitionForTask(
+      const TaskIdentifier& task_id, uint32_t num_partitions) {
+    return TaskIdentifierHasher()(task_id) % num_partitions;
+  }
+
+  void GoogleTraceTaskProcessor::ReadTaskEventsFile(
+      int32_t file_num, uint32_t num_partitions,
+      PartitionedTaskEvents_t* events) {
+    events->resize(num_partitions);
+    char line[200];
+    vector<string> line_cols;
+    FILE* events_file = NULL;
+    LOG(INFO) << "Reading task_events file " << file_num;
+    string file_name;
+    spf(&file_name, "%s/task_events/part-%05d-of-00500.csv",
+        trace_path_.c_str(), file_num);
+    if ((events_file = fopen(file_name.c_str(), "r")) == NULL) {
+      LOG(FATAL) << "Failed to open trace for reading of task events.";
+    }
+    int64_t num_line = 1;
+    while (!feof(events_file)) {
+      if (fscanf(events_file, "%[^\n]%*[\n]", &line[0]) > 0) {
+        boost::split(line_cols, line, is_any_of(","), token_compress_off);
+        if (line_cols.size() != 13) {
+          LOG(ERROR) << "Unexpected structure of task event on line "
+                     << num_line << ": found " << line_cols.size()
+                     << " columns.";
+        } else {
+          TaskEventRecord event;
+          event.timestamp_ = lexical_cast<uint64_t>(line_cols[0]);
+          event.task_id_.job_id_ = lexical_cast<uint64_t>(line_cols[2]);
+          event.task_id_.task_index_ = lexical_cast<uint64_t>(line_cols[3]);
+          event.event_type_ = lexical_cast<int32_t>(line_cols[5]);
+          PopulateTaskRuntime(&event.task_requests_, line_cols);
+          (*events)[PartitionForTask(event.task_id_, num_partitions)]
+            .push_back(event);
+        }
+      }
+      num_line++;
+    }
+    fclose(events_file);
+  }
+
+  void GoogleTraceTaskProcessor::ReduceTaskEvents(
+      const vector<PartitionedTaskEvents_t>& files_events,
+      PartitionedTaskRuntime_t* tasks_runtime,
+      vector<uint64_t>* end_simulation_times,
+      uint32_t partition) {
+    uint64_t* end_simulation_time = &(*end_simulation_times)[partition];
+    for (auto& file_events : files_events) {
+      for (auto& event : file_events[partition]) {
+        if (event.timestamp_ < numeric_limits<int64_t>::max()) {
+          *end_simulation_time = max(*end_simulation_time, event.timestamp_);
+        }
+        ExpandTaskEvent(event, &(*tasks_runtime)[partition]);
+      }
+    }
+  }
+
+  void GoogleTraceTaskProcessor::ReduceTaskFinishTimes(
+      vector<PartitionedTaskFinishTime_t>* finish_times,
+      uint32_t partition) {
+    TaskFinishTimeMap_t* merged_finish_times = &(*finish_times)[0][partition];
+    for (uint32_t worker = 1; worker < finish_times->size(); ++worker) {
+      for (auto& task_id_finish_time : (*finish_times)[worker][partition]) {
+        uint64_t* finish_time =
+          FindOrNull(*merged_finish_times, task_id_finish_time.first);
+        if (finish_time == NULL) {
+          InsertIfNotPresent(merged_finish_times, task_id_finish_time.first,
+                             task_id_finish_time.second);
+        } else {
+          *finish_time = min(*finish_time, task_id_finish_time.second);
+        }
+      }
+      (*finish_times)[worker][partition].clear();
+    }
+  }
+
+  void GoogleTraceTaskProcessor::ReduceTaskUsage(
+      vector<PartitionedTaskUsageStats_t>* usage_stats,
+      uint32_t partition) {
+    // Merge in worker order so that the output does not depend on thread
+    // scheduling.
+    TaskUsageStatsMap_t* merged_usage_stats = &(*usage_stats)[0][partition];
+    for (uint32_t worker = 1; worker < usage_stats->size(); ++worker) {
+      for (auto& task_id_to_usage : (*usage_stats)[worker][partition]) {
+        TaskResourceUsageStats* usage_stats_ptr =
+          FindOrNull(*merged_usage_stats, task_id_to_usage.first);
+        if (usage_stats_ptr == NULL) {
+          InsertIfNotPresent(merged_usage_stats, task_id_to_usage.first,
+                             task_id_to_usage.second);
+        } else {
+          MergeUsageStats(task_id_to_usage.second, usage_stats_ptr);
+        }
+      }
+      (*usage_stats)[worker][partition].clear();
+    }
+  }
+
+  void GoogleTraceTaskProcessor::RunInParallel(
+      uint32_t num_jobs, boost::function<void(uint32_t)> job) {
+    uint32_t num_threads = min(NumPartitions(), num_jobs);
+    if (num_threads <= 1) {
+      RunJobs(0, 1, num_jobs, job);
+      return;
+    }
+    boost::thread_group threads;
+    for (uint32_t thread_index = 0; thread_index < num_threads;
+         ++thread_index) {
+      threads.create_thread(boost::bind(&RunJobs, thread_index, num_threads,
+                                        num_jobs, job));
+    }
+    threads.join_all();
+  }
+
   void GoogleTraceTaskProcessor::Run() {
     if (FLAGS_jobs_runtime) {
       JobsRuntimeEvents();
@@ -787,6 +1061,177 @@ namespace sim {
     }
   }
 
+  void GoogleTraceTaskProcessor::MergeStats(double other_min_usage,
+                                            double other_max_usage,
+                                            double other_avg_usage,
+                                            double other_variance_usage,
+                                            uint32_t other_num_usage,
+                                            double* min_usage,
+                                            double* max_usage,
+                                            double* avg_usage,
+                                            double* variance_usage,
+                                            uint32_t* num_usage) {
+    if (other_num_usage == 0) {
+      return;
+    }
+    *min_usage = min(*min_usage, other_min_usage);
+    *max_usage = max(*max_usage, other_max_usage);
+    if (*num_usage == 0) {
+      *avg_usage = other_avg_usage;
+      *variance_usage = other_variance_usage;
+      *num_usage = other_num_usage;
+      return;
+    }
+    // Combine the (sample) variances by summing the squared deviations of
+    // the two sets of samples and correcting for the difference between the
+    // two averages.
+    double num = *num_usage;
+    double other_num = other_num_usage;
+    double total_num = num + other_num;
+    double delta = other_avg_usage - *avg_usage;
+    double sq_deviations = *variance_usage * (num - 1) +
+      other_variance_usage * (other_num - 1) +
+      delta * delta * num * other_num / total_num;
+    *variance_usage = sq_deviations / (total_num - 1);
+    *avg_usage = *avg_usage + delta * other_num / total_num;
+    *num_usage = *num_usage + other_num_usage;
+  }
+
+  void GoogleTraceTaskProcessor::MergeUsageStats(
+      const TaskResourceUsageStats& other_usage_stats,
+      TaskResourceUsageStats* usage_stats) {
+    MergeStats(other_usage_stats.min_usage_.mean_cpu_usage_,
+               other_usage_stats.max_usage_.mean_cpu_usage_,
+               other_usage_stats.avg_usage_.mean_cpu_usage_,
+               other_usage_stats.variance_usage_.mean_cpu_usage_,
+               other_usage_stats.sample_count_mean_cpu_usage_,
+               &usage_stats->min_usage_.mean_cpu_usage_,
+               &usage_stats->max_usage_.mean_cpu_usage_,
+               &usage_stats->avg_usage_.mean_cpu_usage_,
+               &usage_stats->variance_usage_.mean_cpu_usage_,
+               &usage_stats->sample_count_mean_cpu_usage_);
+    MergeStats(other_usage_stats.min_usage_.canonical_mem_usage_,
+               other_usage_stats.max_usage_.canonical_mem_usage_,
+               other_usage_stats.avg_usage_.canonical_mem_usage_,
+               other_usage_stats.variance_usage_.canonical_mem_usage_,
+               other_usage_stats.sample_count_canonical_mem_usage_,
+               &usage_stats->min_usage_.canonical_mem_usage_,
+               &usage_stats->max_usage_.canonical_mem_usage_,
+               &usage_stats->avg_usage_.canonical_mem_usage_,
+               &usage_stats->variance_usage_.canonical_mem_usage_,
+               &usage_stats->sample_count_canonical_mem_usage_);
+    MergeStats(other_usage_stats.min_usage_.assigned_mem_usage_,
+               other_usage_stats.max_usage_.assigned_mem_usage_,
+               other_usage_stats.avg_usage_.assigned_mem_usage_,
+               other_usage_stats.variance_usage_.assigned_mem_usage_,
+               other_usage_stats.sample_count_assigned_mem_usage_,
+               &usage_stats->min_usage_.assigned_mem_usage_,
+               &usage_stats->max_usage_.assigned_mem_usage_,
+               &usage_stats->avg_usage_.assigned_mem_usage_,
+               &usage_stats->variance_usage_.assigned_mem_usage_,
+               &usage_stats->sample_count_assigned_mem_usage_);
+    MergeStats(other_usage_stats.min_usage_.unmapped_page_cache_,
+               other_usage_stats.max_usage_.unmapped_page_cache_,
+               other_usage_stats.avg_usage_.unmapped_page_cache_,
+               other_usage_stats.variance_usage_.unmapped_page_cache_,
+               other_usage_stats.sample_count_unmapped_page_cache_,
+               &usage_stats->min_usage_.unmapped_page_cache_,
+               &usage_stats->max_usage_.unmapped_page_cache_,
+               &usage_stats->avg_usage_.unmapped_page_cache_,
+               &usage_stats->variance_usage_.unmapped_page_cache_,
+               &usage_stats->sample_count_unmapped_page_cache_);
+    MergeStats(other_usage_stats.min_usage_.total_page_cache_,
+               other_usage_stats.max_usage_.total_page_cache_,
+               other_usage_stats.avg_usage_.total_page_cache_,
+               other_usage_stats.variance_usage_.total_page_cache_,
+               other_usage_stats.sample_count_total_page_cache_,
+               &usage_stats->min_usage_.total_page_cache_,
+               &usage_stats->max_usage_.total_page_cache_,
+               &usage_stats->avg_usage_.total_page_cache_,
+               &usage_stats->variance_usage_.total_page_cache_,
+               &usage_stats->sample_count_total_page_cache_);
+    MergeStats(other_usage_stats.min_usage_.max_mem_usage_,
+               other_usage_stats.max_usage_.max_mem_usage_,
+               other_usage_stats.avg_usage_.max_mem_usage_,
+               other_usage_stats.variance_usage_.max_mem_usage_,
+               other_usage_stats.sample_count_max_mem_usage_,
+               &usage_stats->min_usage_.max_mem_usage_,
+               &usage_stats->max_usage_.max_mem_usage_,
+               &usage_stats->avg_usage_.max_mem_usage_,
+               &usage_stats->variance_usage_.max_mem_usage_,
+               &usage_stats->sample_count_max_mem_usage_);
+    MergeStats(other_usage_stats.min_usage_.mean_disk_io_time_,
+               other_usage_stats.max_usage_.mean_disk_io_time_,
+               other_usage_stats.avg_usage_.mean_disk_io_time_,
+               other_usage_stats.variance_usage_.mean_disk_io_time_,
+               other_usage_stats.sample_count_mean_disk_io_time_,
+               &usage_stats->min_usage_.mean_disk_io_time_,
+               &usage_stats->max_usage_.mean_disk_io_time_,
+               &usage_stats->avg_usage_.mean_disk_io_time_,
+               &usage_stats->variance_usage_.mean_disk_io_time_,
+               &usage_stats->sample_count_mean_disk_io_time_);
+    MergeStats(other_usage_stats.min_usage_.mean_local_disk_used_,
+               other_usage_stats.max_usage_.mean_local_disk_used_,
+               other_usage_stats.avg_usage_.mean_local_disk_used_,
+               other_usage_stats.variance_usage_.mean_local_disk_used_,
+               other_usage_stats.sample_count_mean_local_disk_used_,
+               &usage_stats->min_usage_.mean_local_disk_used_,
+               &usage_stats->max_usage_.mean_local_disk_used_,
+               &usage_stats->avg_usage_.mean_local_disk_used_,
+               &usage_stats->variance_usage_.mean_local_disk_used_,
+               &usage_stats->sample_count_mean_local_disk_used_);
+    MergeStats(other_usage_stats.min_usage_.max_cpu_usage_,
+               other_usage_stats.max_usage_.max_cpu_usage_,
+               other_usage_stats.avg_usage_.max_cpu_usage_,
+               other_usage_stats.variance_usage_.max_cpu_usage_,
+               other_usage_stats.sample_count_max_cpu_usage_,
+               &usage_stats->min_usage_.max_cpu_usage_,
+               &usage_stats->max_usage_.max_cpu_usage_,
+               &usage_stats->avg_usage_.max_cpu_usage_,
+               &usage_stats->variance_usage_.max_cpu_usage_,
+               &usage_stats->sample_count_max_cpu_usage_);
+    MergeStats(other_usage_stats.min_usage_.max_disk_io_time_,
+               other_usage_stats.max_usage_.max_disk_io_time_,
+               other_usage_stats.avg_usage_.max_disk_io_time_,
+               other_usage_stats.variance_usage_.max_disk_io_time_,
+               other_usage_stats.sample_count_max_disk_io_time_,
+               &usage_stats->min_usage_.max_disk_io_time_,
+               &usage_stats->max_usage_.max_disk_io_time_,
+               &usage_stats->avg_usage_.max_disk_io_time_,
+               &usage_stats->variance_usage_.max_disk_io_time_,
+               &usage_stats->sample_count_max_disk_io_time_);
+    MergeStats(other_usage_stats.min_usage_.cpi_,
+               other_usage_stats.max_usage_.cpi_,
+               other_usage_stats.avg_usage_.cpi_,
+               other_usage_stats.variance_usage_.cpi_,
+               other_usage_stats.sample_count_cpi_,
+               &usage_stats->min_usage_.cpi_,
+               &usage_stats->max_usage_.cpi_,
+               &usage_stats->avg_usage_.cpi_,
+               &usage_stats->variance_usage_.cpi_,
+               &usage_stats->sample_count_cpi_);
+    MergeStats(other_usage_stats.min_usage_.mai_,
+               other_usage_stats.max_usage_.mai_,
+               other_usage_stats.avg_usage_.mai_,
+               other_usage_stats.variance_usage_.mai_,
+               other_usage_stats.sample_count_mai_,
+               &usage_stats->min_usage_.mai_,
+               &usage_stats->max_usage_.mai_,
+               &usage_stats->avg_usage_.mai_,
+               &usage_stats->variance_usage_.mai_,
+               &usage_stats->sample_count_mai_);
+  }
+
+  void GoogleTraceTaskProcessor::SetTaskRequests(
+      const TaskRuntime& task_requests, TaskRuntime* task_runtime_ptr) {
+    task_runtime_ptr->scheduling_class_ = task_requests.scheduling_class_;
+    task_runtime_ptr->priority_ = task_requests.priority_;
+    task_runtime_ptr->cpu_request_ = task_requests.cpu_request_;
+    task_runtime_ptr->ram_request_ = task_requests.ram_request_;
+    task_runtime_ptr->disk_request_ = task_requests.disk_request_;
+    task_runtime_ptr->machine_constraint_ = task_requests.machine_constraint_;
+  }
+
   void GoogleTraceTaskProcessor::UpdateStats(double task_usage,
                                              double* min_usage,
                                              double* max_usage,
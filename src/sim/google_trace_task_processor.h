@@ -21,6 +21,9 @@
 #ifndef FIRMAMENT_SIM_GOOGLE_TRACE_TASK_PROCESSOR_H
 #define FIRMAMENT_SIM_GOOGLE_TRACE_TASK_PROCESSOR_H
 
+#include <boost/function.hpp>
+#include <gtest/gtest_prod.h>
+
 #include <map>
 #include <string>
 #include <unordered_map>
@@ -122,10 +125,35 @@ struct TaskIdentifierHasher {
   }
 };
 
+struct TaskEventRecord {
+  uint64_t timestamp_;
+  TaskIdentifier task_id_;
+  int32_t event_type_;
+  // Only the request fields (e.g., priority, cpu_request_) are populated.
+  TaskRuntime task_requests_;
+};
+
+typedef unordered_map<TaskIdentifier, TaskRuntime, TaskIdentifierHasher>
+  TaskRuntimeMap_t;
+typedef unordered_map<TaskIdentifier, TaskResourceUsageStats,
+                      TaskIdentifierHasher> TaskUsageStatsMap_t;
+typedef unordered_map<TaskIdentifier, uint64_t, TaskIdentifierHasher>
+  TaskFinishTimeMap_t;
+// Task events or aggregates split in partitions by task identifier.
+typedef vector<vector<TaskEventRecord> > PartitionedTaskEvents_t;
+typedef vector<TaskRuntimeMap_t> PartitionedTaskRuntime_t;
+typedef vector<TaskUsageStatsMap_t> PartitionedTaskUsageStats_t;
+typedef vector<TaskFinishTimeMap_t> PartitionedTaskFinishTime_t;
+
 class GoogleTraceTaskProcessor {
  public:
   explicit GoogleTraceTaskProcessor(const string& trace_path);
 
+  /**
+   * Compute resource usage statistics for every task. If more than one
+   * processing thread is used, the task_usage files are aggregated in
+   * parallel (see AggregateTaskUsageParallel).
+   */
   void AggregateTaskUsage();
 
   /**
@@ -135,7 +163,10 @@ class GoogleTraceTaskProcessor {
   void BinTasksByEventType(int32_t event_type, FILE* out_file); // NOLINT
 
   /**
-   * Generate task events with runtime information.
+   * Generate task events with runtime information. The task_events files are
+   * parsed in parallel in batches of --num_processing_threads files. The
+   * events of each batch are then expanded in trace order by one reducer per
+   * task partition.
    * NOTE: Events will only be generated for tasks that successfully complete.
    */
   void JobsRuntimeEvents();
@@ -148,14 +179,46 @@ class GoogleTraceTaskProcessor {
   void Run();
 
  private:
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, MergeStats);
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, MergeUsageStats);
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, NumPartitions);
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, PartitionForTask);
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, ReadTaskEventsFile);
+  FRIEND_TEST(GoogleTraceTaskProcessorTest, RunInParallel);
+
+  /**
+   * Map-reduce version of AggregateTaskUsage. Each thread aggregates the
+   * usage samples of its task_usage files into thread-local statistics, which
+   * are merged by task partition at the end. Unlike the sequential version,
+   * a usage sample is discarded if its start time is after the task's first
+   * FINISH event, and the statistics are printed in partition order.
+   */
+  void AggregateTaskUsageParallel();
   TaskResourceUsage BuildTaskResourceUsage(vector<string>& line_cols); // NOLINT
-  void ExpandTaskEvent(
-      uint64_t timestamp, const TaskIdentifier& task_id, int32_t event_type,
-      unordered_map<TaskIdentifier, TaskRuntime,
-                    TaskIdentifierHasher>* tasks_runtime,
-      unordered_map<uint64_t, string>* job_id_to_name,
-      vector<string>& line_cols); // NOLINT
+  void ExpandTaskEvent(const TaskEventRecord& event,
+                       TaskRuntimeMap_t* tasks_runtime);
   void InitializeResourceUsageStats(TaskResourceUsageStats* usage_stats);
+  void MapTaskEventsFile(int32_t first_file_num, uint32_t num_partitions,
+                         vector<PartitionedTaskEvents_t>* files_events,
+                         uint32_t file_index);
+  void MapTaskFinishTimes(uint32_t num_workers,
+                          vector<PartitionedTaskFinishTime_t>* finish_times,
+                          uint32_t worker);
+  void MapTaskUsage(uint32_t num_workers,
+                    const PartitionedTaskFinishTime_t& finish_times,
+                    vector<PartitionedTaskUsageStats_t>* usage_stats,
+                    vector<uint64_t>* last_timestamps,
+                    uint32_t worker);
+  void MergeStats(double other_min_usage, double other_max_usage,
+                  double other_avg_usage, double other_variance_usage,
+                  uint32_t other_num_usage, double* min_usage,
+                  double* max_usage, double* avg_usage,
+                  double* variance_usage, uint32_t* num_usage);
+  void MergeUsageStats(const TaskResourceUsageStats& other_usage_stats,
+                       TaskResourceUsageStats* usage_stats);
+  uint32_t NumPartitions();
+  uint32_t PartitionForTask(const TaskIdentifier& task_id,
+                            uint32_t num_partitions);
   void PopulateTaskRuntime(TaskRuntime* task_runtime_ptr,
                            vector<string>& cols); // NOLINT
   void PrintStats(FILE* usage_stat_file, const TaskIdentifier& task_id,
@@ -169,9 +232,27 @@ class GoogleTraceTaskProcessor {
                     TaskIdentifierHasher>* task_usage,
       unordered_set<TaskIdentifier, TaskIdentifierHasher>* finished_tasks,
       FILE* usage_stat_file);
+  void ReadTaskEventsFile(int32_t file_num, uint32_t num_partitions,
+                          PartitionedTaskEvents_t* events);
   unordered_map<uint64_t, string>& ReadLogicalJobsName();
   multimap<uint64_t, TaskSchedulingEvent>& ReadTaskStateChangingEvents(
       unordered_map<uint64_t, uint64_t>* job_num_tasks);
+  void ReduceTaskEvents(const vector<PartitionedTaskEvents_t>& files_events,
+                        PartitionedTaskRuntime_t* tasks_runtime,
+                        vector<uint64_t>* end_simulation_times,
+                        uint32_t partition);
+  void ReduceTaskFinishTimes(vector<PartitionedTaskFinishTime_t>* finish_times,
+                             uint32_t partition);
+  void ReduceTaskUsage(vector<PartitionedTaskUsageStats_t>* usage_stats,
+                       uint32_t partition);
+  /**
+   * Runs job(0), ..., job(num_jobs - 1) on up to --num_processing_threads
+   * threads and waits for all of them to complete. The jobs are assigned to
+   * threads round-robin.
+   */
+  void RunInParallel(uint32_t num_jobs, boost::function<void(uint32_t)> job);
+  void SetTaskRequests(const TaskRuntime& task_requests,
+                       TaskRuntime* task_runtime_ptr);
   void UpdateStats(double task_usage, double* min_usage, double* max_usage,
                    double* avg_usage, double* variance_usage,
                    uint32_t* num_usage);
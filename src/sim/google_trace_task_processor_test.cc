@@ -0,0 +1,253 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Tests for the parallel parts of the Google trace task processor.
+
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "base/common.h"
+#include "misc/utils.h"
+#include "sim/google_trace_task_processor.h"
+
+DEFINE_bool(aggregate_task_usage, false, "Generate aggregated task usage.");
+DEFINE_bool(jobs_runtime, false, "Generate task events with runtime.");
+DEFINE_bool(jobs_num_tasks, false, "Generate num tasks for each jobs.");
+DEFINE_int32(num_files_to_process, 1, "Number of files to process.");
+DEFINE_int32(num_processing_threads, 1,
+             "Number of threads used to process the trace files.");
+
+namespace firmament {
+namespace sim {
+
+class GoogleTraceTaskProcessorTest : public ::testing::Test {
+ protected:
+  GoogleTraceTaskProcessorTest() : processor_(NULL) {
+  }
+
+  virtual void SetUp() {
+    trace_dir_ = MakeTemporaryDirectory("google_trace_task_processor_test");
+    ASSERT_FALSE(trace_dir_.empty());
+    processor_ = new GoogleTraceTaskProcessor(trace_dir_);
+  }
+
+  virtual void TearDown() {
+    delete processor_;
+    FLAGS_num_processing_threads = 1;
+    if (!trace_dir_.empty()) {
+      EXPECT_TRUE(RemoveDirectoryRecursively(trace_dir_));
+    }
+  }
+
+  // Computes the minimum, maximum, mean and sample variance of the samples
+  // in two passes.
+  void ReferenceStats(const vector<double>& samples, double* min_usage,
+                      double* max_usage, double* avg_usage,
+                      double* variance_usage) {
+    *min_usage = numeric_limits<double>::max();
+    *max_usage = 0.0;
+    double sum = 0.0;
+    for (auto& sample : samples) {
+      *min_usage = min(*min_usage, sample);
+      *max_usage = max(*max_usage, sample);
+      sum += sample;
+    }
+    *avg_usage = sum / samples.size();
+    double sq_deviations = 0.0;
+    for (auto& sample : samples) {
+      sq_deviations += (sample - *avg_usage) * (sample - *avg_usage);
+    }
+    *variance_usage = sq_deviations / (samples.size() - 1);
+  }
+
+  GoogleTraceTaskProcessor* processor_;
+  string trace_dir_;
+  boost::mutex jobs_run_lock_;
+  vector<uint32_t> jobs_run_;
+
+ public:
+  void RecordJob(uint32_t job_index) {
+    boost::lock_guard<boost::mutex> lock(jobs_run_lock_);
+    jobs_run_[job_index]++;
+  }
+};
+
+TEST_F(GoogleTraceTaskProcessorTest, MergeStats) {
+  vector<double> samples = {0.5, 2.0, 3.5, 1.0, 10.0, 7.25, 0.0, 4.0};
+  double min_usage, max_usage, avg_usage, variance_usage;
+  ReferenceStats(samples, &min_usage, &max_usage, &avg_usage,
+                 &variance_usage);
+  // Split the samples at every possible point, including into an empty and
+  // a full part, and check that merging the parts gives the same statistics.
+  for (size_t split = 0; split <= samples.size(); ++split) {
+    double first_min = numeric_limits<double>::max();
+    double first_max = 0.0, first_avg = 0.0, first_variance = 0.0;
+    double second_min = numeric_limits<double>::max();
+    double second_max = 0.0, second_avg = 0.0, second_variance = 0.0;
+    uint32_t first_num = 0, second_num = 0;
+    for (size_t index = 0; index < samples.size(); ++index) {
+      if (index < split) {
+        processor_->UpdateStats(samples[index], &first_min, &first_max,
+                                &first_avg, &first_variance, &first_num);
+      } else {
+        processor_->UpdateStats(samples[index], &second_min, &second_max,
+                                &second_avg, &second_variance, &second_num);
+      }
+    }
+    processor_->MergeStats(second_min, second_max, second_avg,
+                           second_variance, second_num, &first_min,
+                           &first_max, &first_avg, &first_variance,
+                           &first_num);
+    EXPECT_EQ(first_num, samples.size());
+    EXPECT_DOUBLE_EQ(first_min, min_usage);
+    EXPECT_DOUBLE_EQ(first_max, max_usage);
+    EXPECT_NEAR(first_avg, avg_usage, 1e-9);
+    EXPECT_NEAR(first_variance, variance_usage, 1e-9);
+  }
+}
+
+TEST_F(GoogleTraceTaskProcessorTest, MergeUsageStats) {
+  TaskResourceUsageStats all_stats;
+  TaskResourceUsageStats first_stats;
+  TaskResourceUsageStats second_stats;
+  processor_->InitializeResourceUsageStats(&all_stats);
+  processor_->InitializeResourceUsageStats(&first_stats);
+  processor_->InitializeResourceUsageStats(&second_stats);
+  for (uint32_t index = 0; index < 10; ++index) {
+    TaskResourceUsage usage;
+    usage.mean_cpu_usage_ = index * 0.1;
+    usage.canonical_mem_usage_ = 1.0 - index * 0.05;
+    // Missing samples are negative and must not be counted.
+    usage.cpi_ = index % 2 == 0 ? -1.0 : index;
+    processor_->UpdateUsageStats(usage, &all_stats);
+    processor_->UpdateUsageStats(usage,
+                                 index < 3 ? &first_stats : &second_stats);
+  }
+  processor_->MergeUsageStats(second_stats, &first_stats);
+  EXPECT_EQ(first_stats.sample_count_mean_cpu_usage_, 10U);
+  EXPECT_EQ(first_stats.sample_count_cpi_, 5U);
+  EXPECT_NEAR(first_stats.avg_usage_.mean_cpu_usage_,
+              all_stats.avg_usage_.mean_cpu_usage_, 1e-9);
+  EXPECT_NEAR(first_stats.variance_usage_.canonical_mem_usage_,
+              all_stats.variance_usage_.canonical_mem_usage_, 1e-9);
+  EXPECT_DOUBLE_EQ(first_stats.min_usage_.cpi_, all_stats.min_usage_.cpi_);
+  EXPECT_DOUBLE_EQ(first_stats.max_usage_.cpi_, all_stats.max_usage_.cpi_);
+  EXPECT_NEAR(first_stats.avg_usage_.cpi_, all_stats.avg_usage_.cpi_, 1e-9);
+}
+
+TEST_F(GoogleTraceTaskProcessorTest, NumPartitions) {
+  FLAGS_num_processing_threads = 0;
+  EXPECT_EQ(processor_->NumPartitions(), 1U);
+  FLAGS_num_processing_threads = -2;
+  EXPECT_EQ(processor_->NumPartitions(), 1U);
+  FLAGS_num_processing_threads = 4;
+  EXPECT_EQ(processor_->NumPartitions(), 4U);
+}
+
+TEST_F(GoogleTraceTaskProcessorTest, PartitionForTask) {
+  vector<uint32_t> num_partitions = {1, 2, 3, 7};
+  for (auto& partitions : num_partitions) {
+    vector<uint64_t> tasks_per_partition(partitions, 0);
+    for (uint64_t job_id = 0; job_id < 20; ++job_id) {
+      for (uint64_t task_index = 0; task_index < 20; ++task_index) {
+        TaskIdentifier task_id = {job_id, task_index};
+        uint32_t partition =
+          processor_->PartitionForTask(task_id, partitions);
+        ASSERT_LT(partition, partitions);
+        // A task always maps to the same partition.
+        EXPECT_EQ(processor_->PartitionForTask(task_id, partitions),
+                  partition);
+        tasks_per_partition[partition]++;
+      }
+    }
+    for (auto& num_tasks : tasks_per_partition) {
+      EXPECT_GT(num_tasks, 0U);
+    }
+  }
+}
+
+TEST_F(GoogleTraceTaskProcessorTest, ReadTaskEventsFile) {
+  ASSERT_EQ(mkdir((trace_dir_ + "/task_events").c_str(), 0777), 0);
+  FILE* events_file =
+    fopen((trace_dir_ + "/task_events/part-00000-of-00500.csv").c_str(), "w");
+  ASSERT_TRUE(events_file != NULL);
+  uint64_t num_events = 0;
+  for (uint64_t timestamp = 0; timestamp < 5; ++timestamp) {
+    for (uint64_t job_id = 1; job_id <= 4; ++job_id) {
+      for (uint64_t task_index = 0; task_index < 3; ++task_index) {
+        fprintf(events_file, "%ju,,%ju,%ju,,%d,,1,2,0.5,0.25,0.0,\n",
+                timestamp, job_id, task_index, 1);
+        num_events++;
+      }
+    }
+  }
+  // Lines with the wrong number of columns are skipped.
+  fprintf(events_file, "0,,1,2\n");
+  fclose(events_file);
+  const uint32_t num_partitions = 3;
+  PartitionedTaskEvents_t events;
+  processor_->ReadTaskEventsFile(0, num_partitions, &events);
+  ASSERT_EQ(events.size(), num_partitions);
+  uint64_t num_read = 0;
+  for (uint32_t partition = 0; partition < num_partitions; ++partition) {
+    uint64_t last_timestamp = 0;
+    for (auto& event : events[partition]) {
+      // Every event is in its task's partition, in trace order.
+      EXPECT_EQ(processor_->PartitionForTask(event.task_id_, num_partitions),
+                partition);
+      EXPECT_GE(event.timestamp_, last_timestamp);
+      last_timestamp = event.timestamp_;
+      EXPECT_EQ(event.task_requests_.priority_, 2);
+      EXPECT_EQ(event.task_requests_.machine_constraint_, -1);
+      num_read++;
+    }
+  }
+  EXPECT_EQ(num_read, num_events);
+}
+
+TEST_F(GoogleTraceTaskProcessorTest, RunInParallel) {
+  FLAGS_num_processing_threads = 3;
+  // Fewer, as many and more jobs than threads.
+  vector<uint32_t> num_jobs = {1, 3, 10};
+  for (auto& jobs : num_jobs) {
+    jobs_run_.assign(jobs, 0);
+    processor_->RunInParallel(
+        jobs, boost::bind(&GoogleTraceTaskProcessorTest::RecordJob, this, _1));
+    for (auto& num_runs : jobs_run_) {
+      EXPECT_EQ(num_runs, 1U);
+    }
+  }
+}
+
+}  // namespace sim
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -66,65 +66,111 @@ void KnowledgeBaseSimulator::AddMachineSample(
     uint64_t current_simulation_time,
     ResourceDescriptor* rd_ptr,
     const unordered_map<TaskID_t, ResourceDescriptor*>& task_id_to_rd) {
-  ResourceStats machine_stats;
-  machine_stats.set_resource_id(rd_ptr->uuid());
-  machine_stats.set_timestamp(current_simulation_time);
-  uint64_t mem_usage = 0;
-  uint64_t num_cores =
-    lexical_cast<uint64_t>(rd_ptr->resource_capacity().cpu_cores());
-  vector<double> cpus_usage(num_cores, 1.0);
-  for (auto& task_id_rd : task_id_to_rd) {
-    TraceTaskStats* task_stat = FindOrNull(task_stats_, task_id_rd.first);
-    if (!task_stat) {
-      // We don't have any stats for the task. Ignore it.
-      continue;
-    }
-    if (task_stat->avg_canonical_mem_usage_ > 0 ||
-        task_stat->avg_unmapped_page_cache_ > 0 ||
-        task_stat->avg_total_page_cache_ > 0) {
-      mem_usage += task_stat->avg_canonical_mem_usage_ +
-        task_stat->avg_unmapped_page_cache_ -
-        task_stat->avg_total_page_cache_;
+  vector<ResourceDescriptor*> machine_rds(1, rd_ptr);
+  vector<pair<TaskID_t, ResourceDescriptor*> > running_tasks(
+      task_id_to_rd.begin(), task_id_to_rd.end());
+  vector<size_t> machine_task_offsets;
+  machine_task_offsets.push_back(0);
+  machine_task_offsets.push_back(running_tasks.size());
+  AddMachineSamples(current_simulation_time, machine_rds, running_tasks,
+                    machine_task_offsets);
+}
+
+void KnowledgeBaseSimulator::AddMachineSamples(
+    uint64_t current_simulation_time,
+    const vector<ResourceDescriptor*>& machine_rds,
+    const vector<pair<TaskID_t, ResourceDescriptor*> >& running_tasks,
+    const vector<size_t>& machine_task_offsets) {
+  size_t num_machines = machine_rds.size();
+  CHECK_EQ(machine_task_offsets.size(), num_machines + 1);
+  // The usage of all the machines' cores is kept in a single flat array.
+  // core_offsets[i] is the index at which the cores of machine i start.
+  vector<size_t> core_offsets(num_machines + 1, 0);
+  for (size_t machine_index = 0; machine_index < num_machines;
+       ++machine_index) {
+    core_offsets[machine_index + 1] = core_offsets[machine_index] +
+      static_cast<size_t>(
+          machine_rds[machine_index]->resource_capacity().cpu_cores());
+  }
+  vector<double> cpus_usage(core_offsets[num_machines], 1.0);
+  vector<uint64_t> mem_usage(num_machines, 0);
+  for (size_t machine_index = 0; machine_index < num_machines;
+       ++machine_index) {
+    size_t num_cores =
+      core_offsets[machine_index + 1] - core_offsets[machine_index];
+    double* machine_cpus_usage = &cpus_usage[core_offsets[machine_index]];
+    for (size_t task_index = machine_task_offsets[machine_index];
+         task_index < machine_task_offsets[machine_index + 1];
+         ++task_index) {
+      TraceTaskStats* task_stat =
+        FindOrNull(task_stats_, running_tasks[task_index].first);
+      if (!task_stat) {
+        // We don't have any stats for the task. Ignore it.
+        continue;
+      }
+      if (task_stat->avg_canonical_mem_usage_ > 0 ||
+          task_stat->avg_unmapped_page_cache_ > 0 ||
+          task_stat->avg_total_page_cache_ > 0) {
+        mem_usage[machine_index] += task_stat->avg_canonical_mem_usage_ +
+          task_stat->avg_unmapped_page_cache_ -
+          task_stat->avg_total_page_cache_;
+      }
+      int64_t core_id = GetCoreIdForPU(*running_tasks[task_index].second);
+      // TODO(ionel): In the Google trace a task might require more than one
+      // core. Change the code to handle this case as well.
+      // TODO(ionel): This assumes that all the machines in the trace are the
+      // same. The reported cpu_usage is relative to the machine type. Fix!
+      CHECK_LT(core_id, num_cores);
+      machine_cpus_usage[core_id] -= task_stat->avg_mean_cpu_usage_;
     }
-    string label = task_id_rd.second->friendly_name();
-    uint64_t idx = label.find("PU #");
-    CHECK_NE(idx, string::npos)
-      << "PU label does not contain core id for resource: "
-      << task_id_rd.second->uuid();
-    string core_id_substr = label.substr(idx + 4, label.size() - idx - 4);
-    int64_t core_id = strtoll(core_id_substr.c_str(), 0, 10);
-    // TODO(ionel): In the Google trace a task might require more than one
-    // core. Change the code to handle this case as well.
-    // TODO(ionel): This assumes that all the machines in the trace are the
-    // same. The reported cpu_usage is relative to the machine type. Fix!
-    CHECK_LT(core_id, num_cores);
-    cpus_usage[core_id] -= task_stat->avg_mean_cpu_usage_;
   }
-  // RAM stats
-  machine_stats.set_mem_capacity(rd_ptr->resource_capacity().ram_cap());
-  machine_stats.set_mem_utilization(mem_usage);
-  // CPU stats
+  // Turn the idle fractions into utilizations in a single pass over the
+  // flat array.
   for (auto& usage : cpus_usage) {
-    CpuStats* cpu_stats = machine_stats.add_cpus_stats();
-    // Capacity is 1000 millicores
-    cpu_stats->set_cpu_capacity(1000);
-    cpu_stats->set_cpu_utilization(1.0 - usage);
-    // We don't have information to fill in the other fields.
+    usage = 1.0 - usage;
   }
-  // Disk stats
-  // The trace doesn't have information about disk bandwidth.
-  machine_stats.set_disk_bw(0);
-  // Network stats
-  // The trace doesn't have any information about network utilization.
-  machine_stats.set_net_rx_bw(0);
-  machine_stats.set_net_tx_bw(0);
-  KnowledgeBase::AddMachineSample(machine_stats);
+  vector<ResourceStats> samples(num_machines);
+  for (size_t machine_index = 0; machine_index < num_machines;
+       ++machine_index) {
+    ResourceDescriptor* rd_ptr = machine_rds[machine_index];
+    ResourceStats* machine_stats = &samples[machine_index];
+    machine_stats->set_resource_id(rd_ptr->uuid());
+    machine_stats->set_timestamp(current_simulation_time);
+    // RAM stats
+    machine_stats->set_mem_capacity(rd_ptr->resource_capacity().ram_cap());
+    machine_stats->set_mem_utilization(mem_usage[machine_index]);
+    // CPU stats
+    for (size_t core_index = core_offsets[machine_index];
+         core_index < core_offsets[machine_index + 1]; ++core_index) {
+      CpuStats* cpu_stats = machine_stats->add_cpus_stats();
+      // Capacity is 1000 millicores
+      cpu_stats->set_cpu_capacity(1000);
+      cpu_stats->set_cpu_utilization(cpus_usage[core_index]);
+      // We don't have information to fill in the other fields.
+    }
+    // Disk stats
+    // The trace doesn't have information about disk bandwidth.
+    machine_stats->set_disk_bw(0);
+    // Network stats
+    // The trace doesn't have any information about network utilization.
+    machine_stats->set_net_rx_bw(0);
+    machine_stats->set_net_tx_bw(0);
+  }
+  KnowledgeBase::AddMachineSamples(samples);
 }
 
 void KnowledgeBaseSimulator::EraseTraceTaskStats(TaskID_t task_id) {
   task_stats_.erase(task_id);
 }
 
+int64_t KnowledgeBaseSimulator::GetCoreIdForPU(const ResourceDescriptor& pu_rd) {
+  const string& label = pu_rd.friendly_name();
+  size_t idx = label.find("PU #");
+  CHECK_NE(idx, string::npos)
+    << "PU label does not contain core id for resource: " << pu_rd.uuid();
+  return strtoll(label.c_str() + idx + 4, 0, 10);
+}
+
 uint64_t KnowledgeBaseSimulator::GetRuntimeForTask(TaskID_t task_id) {
   TraceTaskStats* task_stats = FindOrNull(task_stats_, task_id);
   CHECK_NOTNULL(task_stats);
@@ -159,6 +205,94 @@ void KnowledgeBaseSimulator::PopulateTaskFinalReport(TaskDescriptor* td_ptr,
   }
 }
 
+void KnowledgeBaseSimulator::RestoreFinalReports(
+    const CheckpointFinalReports& final_reports) {
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  deque<TaskFinalReport> reports(final_reports.reports().begin(),
+                                 final_reports.reports().end());
+  CHECK(InsertIfNotPresent(&task_exec_reports_, final_reports.id(), reports));
+}
+
+void KnowledgeBaseSimulator::RestoreMachineStats(
+    const CheckpointMachineStats& machine_stats) {
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  deque<ResourceStats> samples(machine_stats.samples().begin(),
+                               machine_stats.samples().end());
+  CHECK(InsertIfNotPresent(&machine_map_,
+                           ResourceIDFromString(machine_stats.resource_id()),
+                           samples));
+}
+
+void KnowledgeBaseSimulator::RestoreTraceTaskStats(
+    const CheckpointTraceTaskStats& task_stats) {
+  TraceTaskStats trace_task_stats;
+  trace_task_stats.avg_mean_cpu_usage_ = task_stats.avg_mean_cpu_usage();
+  trace_task_stats.avg_canonical_mem_usage_ =
+    task_stats.avg_canonical_mem_usage();
+  trace_task_stats.avg_assigned_mem_usage_ =
+    task_stats.avg_assigned_mem_usage();
+  trace_task_stats.avg_unmapped_page_cache_ =
+    task_stats.avg_unmapped_page_cache();
+  trace_task_stats.avg_total_page_cache_ = task_stats.avg_total_page_cache();
+  trace_task_stats.avg_mean_disk_io_time_ =
+    task_stats.avg_mean_disk_io_time();
+  trace_task_stats.avg_mean_local_disk_used_ =
+    task_stats.avg_mean_local_disk_used();
+  trace_task_stats.avg_cpi_ = task_stats.avg_cpi();
+  trace_task_stats.avg_mai_ = task_stats.avg_mai();
+  trace_task_stats.total_runtime_ = task_stats.total_runtime();
+  CHECK(InsertIfNotPresent(&task_stats_, task_stats.task_id(),
+                           trace_task_stats));
+}
+
+void KnowledgeBaseSimulator::SaveCheckpoint(CheckpointWriter* writer) {
+  CHECK_NOTNULL(writer);
+  boost::lock_guard<boost::upgrade_mutex> lock(kb_lock_);
+  CheckpointRecord record;
+  for (auto& task_id_stats : task_stats_) {
+    const TraceTaskStats& trace_task_stats = task_id_stats.second;
+    CheckpointTraceTaskStats* task_stats = record.mutable_task_stats();
+    task_stats->set_task_id(task_id_stats.first);
+    task_stats->set_avg_mean_cpu_usage(trace_task_stats.avg_mean_cpu_usage_);
+    task_stats->set_avg_canonical_mem_usage(
+        trace_task_stats.avg_canonical_mem_usage_);
+    task_stats->set_avg_assigned_mem_usage(
+        trace_task_stats.avg_assigned_mem_usage_);
+    task_stats->set_avg_unmapped_page_cache(
+        trace_task_stats.avg_unmapped_page_cache_);
+    task_stats->set_avg_total_page_cache(
+        trace_task_stats.avg_total_page_cache_);
+    task_stats->set_avg_mean_disk_io_time(
+        trace_task_stats.avg_mean_disk_io_time_);
+    task_stats->set_avg_mean_local_disk_used(
+        trace_task_stats.avg_mean_local_disk_used_);
+    task_stats->set_avg_cpi(trace_task_stats.avg_cpi_);
+    task_stats->set_avg_mai(trace_task_stats.avg_mai_);
+    task_stats->set_total_runtime(trace_task_stats.total_runtime_);
+    writer->WriteRecord(record);
+  }
+  for (auto& id_reports : task_exec_reports_) {
+    CheckpointFinalReports* final_reports = record.mutable_final_reports();
+    final_reports->Clear();
+    final_reports->set_id(id_reports.first);
+    for (auto& report : id_reports.second) {
+      final_reports->add_reports()->CopyFrom(report);
+    }
+    writer->WriteRecord(record);
+  }
+  for (auto& res_id_samples : machine_map_) {
+    CheckpointMachineStats* machine_stats = record.mutable_machine_stats();
+    machine_stats->Clear();
+    machine_stats->set_resource_id(to_string(res_id_samples.first));
+    for (auto& sample : res_id_samples.second) {
+      machine_stats->add_samples()->CopyFrom(sample);
+    }
+    writer->WriteRecord(record);
+  }
+  // N.B. The task stats samples in task_map_ are not checkpointed because
+  // simulated tasks never report them.
+}
+
 void KnowledgeBaseSimulator::SetTaskType(TaskDescriptor* td_ptr) {
   // The classification works as follows:
   // low CPI, low MAI (lots of compute, but little memory access) => rabbit
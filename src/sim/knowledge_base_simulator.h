@@ -24,6 +24,7 @@
 #include "scheduling/knowledge_base.h"
 
 #include "scheduling/data_layer_manager_interface.h"
+#include "sim/simulator_checkpoint.h"
 #include "sim/trace_utils.h"
 
 namespace firmament {
@@ -40,13 +41,45 @@ class KnowledgeBaseSimulator : public KnowledgeBase {
       uint64_t current_simulation_time,
       ResourceDescriptor* rd_ptr,
       const unordered_map<TaskID_t, ResourceDescriptor*>& task_id_to_rd);
+  /**
+   * Computes the utilization of a batch of machines and adds the samples to
+   * the knowledge base while acquiring its lock only once.
+   * @param current_simulation_time the timestamp of the samples
+   * @param machine_rds the descriptors of the machines to sample
+   * @param running_tasks (task id, PU descriptor) pairs of the tasks running
+   * on the machines, grouped by machine
+   * @param machine_task_offsets offsets in running_tasks at which the tasks of
+   * each machine start; it has one more entry than machine_rds
+   */
+  void AddMachineSamples(
+      uint64_t current_simulation_time,
+      const vector<ResourceDescriptor*>& machine_rds,
+      const vector<pair<TaskID_t, ResourceDescriptor*> >& running_tasks,
+      const vector<size_t>& machine_task_offsets);
   void EraseTraceTaskStats(TaskID_t task_id);
   uint64_t GetRuntimeForTask(TaskID_t task_id);
   void PopulateTaskFinalReport(TaskDescriptor* td_ptr, TaskFinalReport* report);
+  /**
+   * Restores state saved in a checkpoint by SaveCheckpoint.
+   */
+  void RestoreFinalReports(const CheckpointFinalReports& final_reports);
+  void RestoreMachineStats(const CheckpointMachineStats& machine_stats);
+  void RestoreTraceTaskStats(const CheckpointTraceTaskStats& task_stats);
+  /**
+   * Writes the trace task statistics, the task final reports and the machine
+   * samples to a checkpoint.
+   * @param writer the checkpoint writer to use
+   */
+  void SaveCheckpoint(CheckpointWriter* writer);
   void SetTaskType(TaskDescriptor* td_ptr);
   void SetTraceTaskStats(TaskID_t task_id, const TraceTaskStats& task_stat);
 
  private:
+  /**
+   * Returns the index of the core a PU corresponds to, based on its label.
+   */
+  int64_t GetCoreIdForPU(const ResourceDescriptor& pu_rd);
+
   unordered_map<TaskID_t, TraceTaskStats> task_stats_;
 };
 
@@ -0,0 +1,111 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Implementation of the simulated machine template.
+
+#include "sim/simulated_machine_template.h"
+
+#include <string>
+#include <vector>
+
+#include "misc/utils.h"
+
+DECLARE_uint64(sim_machine_max_ram);
+
+namespace firmament {
+namespace sim {
+
+SimulatedMachineTemplate::SimulatedMachineTemplate(
+    const ResourceTopologyNodeDescriptor& machine_tmpl)
+  : num_pus_(0) {
+  IndexNodes(machine_tmpl, -1);
+  VLOG(1) << "Machine template has " << node_rds_.size() << " nodes and "
+          << num_pus_ << " PUs";
+}
+
+void SimulatedMachineTemplate::IndexNodes(
+    const ResourceTopologyNodeDescriptor& rtnd,
+    int64_t parent_index) {
+  int64_t node_index = static_cast<int64_t>(node_rds_.size());
+  node_rds_.push_back(rtnd.resource_desc());
+  parent_index_.push_back(parent_index);
+  num_children_.push_back(rtnd.children_size());
+  if (rtnd.resource_desc().type() == ResourceDescriptor::RESOURCE_PU) {
+    num_pus_++;
+  }
+  for (auto& child : rtnd.children()) {
+    IndexNodes(child, node_index);
+  }
+}
+
+void SimulatedMachineTemplate::Instantiate(
+    const string& hostname,
+    uint64_t trace_machine_id,
+    const string& root_uuid,
+    ResourceTopologyNodeDescriptor* new_machine,
+    vector<ResourceTopologyNodeDescriptor*>* machine_nodes) const {
+  CHECK_NOTNULL(new_machine);
+  CHECK_NOTNULL(machine_nodes);
+  new_machine->Clear();
+  machine_nodes->clear();
+  machine_nodes->reserve(node_rds_.size());
+  // N.B. The uuids must be generated in DFS pre-order starting with the
+  // machine node: GenerateRootResourceID seeds the generator used by
+  // GenerateResourceID, which makes the machine's resource ids deterministic.
+  for (size_t node_index = 0; node_index < node_rds_.size(); ++node_index) {
+    ResourceTopologyNodeDescriptor* rtnd_ptr;
+    int64_t parent_index = parent_index_[node_index];
+    if (parent_index < 0) {
+      // This is the top of a machine topology, so generate a first UUID for
+      // its topology based on its hostname and link it into the root.
+      rtnd_ptr = new_machine;
+      rtnd_ptr->set_parent_id(root_uuid);
+    } else {
+      // The parent precedes the node in pre-order, so it already exists and
+      // has its new uuid; children are added in template order.
+      ResourceTopologyNodeDescriptor* parent_ptr =
+        (*machine_nodes)[parent_index];
+      rtnd_ptr = parent_ptr->add_children();
+      rtnd_ptr->set_parent_id(parent_ptr->resource_desc().uuid());
+    }
+    rtnd_ptr->mutable_children()->Reserve(num_children_[node_index]);
+    ResourceDescriptor* rd_ptr = rtnd_ptr->mutable_resource_desc();
+    rd_ptr->CopyFrom(node_rds_[node_index]);
+    if (parent_index < 0) {
+      rd_ptr->set_uuid(to_string(GenerateRootResourceID(hostname)));
+    } else {
+      rd_ptr->set_uuid(to_string(GenerateResourceID()));
+    }
+    rd_ptr->set_trace_machine_id(trace_machine_id);
+    machine_nodes->push_back(rtnd_ptr);
+  }
+  ResourceDescriptor* machine_rd_ptr = new_machine->mutable_resource_desc();
+  machine_rd_ptr->set_friendly_name(hostname);
+  machine_rd_ptr->set_type(ResourceDescriptor::RESOURCE_MACHINE);
+  ResourceVector* res_cap = machine_rd_ptr->mutable_resource_capacity();
+  // TODO(ionel): Do not manually set ram_cap! Update the machine protobuf
+  // to include resource capacity values.
+  res_cap->set_ram_cap(FLAGS_sim_machine_max_ram);
+  // NOTE: We set the number of cpu_cores to the number of PUs.
+  res_cap->set_cpu_cores(res_cap->cpu_cores() + num_pus_);
+}
+
+}  // namespace sim
+}  // namespace firmament
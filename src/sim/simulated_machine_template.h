@@ -0,0 +1,90 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Machine topology template used to instantiate simulated machines.
+
+#ifndef FIRMAMENT_SIM_SIMULATED_MACHINE_TEMPLATE_H
+#define FIRMAMENT_SIM_SIMULATED_MACHINE_TEMPLATE_H
+
+#include <string>
+#include <vector>
+
+#include "base/common.h"
+#include "base/resource_topology_node_desc.pb.h"
+
+namespace firmament {
+namespace sim {
+
+class SimulatedMachineTemplate {
+ public:
+  /**
+   * Pre-processes the template topology. The template is flattened into its
+   * nodes' resource descriptors in DFS pre-order, together with every node's
+   * parent and number of children. Only this index is computed once; every
+   * machine still gets its own copy of each resource descriptor, since the
+   * schedulers keep and update per-machine state in them.
+   * @param machine_tmpl the machine topology to use as template
+   */
+  explicit SimulatedMachineTemplate(
+      const ResourceTopologyNodeDescriptor& machine_tmpl);
+
+  /**
+   * Instantiates a new machine from the template. The machine's topology is
+   * built in a single pass over the flattened template: each node's resource
+   * descriptor is copied under its already-built parent and gets its uuid and
+   * parent id as it is created, so the new tree is not walked afterwards.
+   * @param hostname the hostname of the new machine; its resource id is
+   * derived from it
+   * @param trace_machine_id the simulator id of the machine
+   * @param root_uuid the uuid of the node to which the machine is connected
+   * @param new_machine the topology node to populate
+   * @param machine_nodes populated with the machine's nodes in DFS pre-order
+   */
+  void Instantiate(const string& hostname,
+                   uint64_t trace_machine_id,
+                   const string& root_uuid,
+                   ResourceTopologyNodeDescriptor* new_machine,
+                   vector<ResourceTopologyNodeDescriptor*>* machine_nodes) const;
+
+  inline uint64_t num_nodes() const {
+    return node_rds_.size();
+  }
+  inline uint64_t num_pus() const {
+    return num_pus_;
+  }
+
+ private:
+  void IndexNodes(const ResourceTopologyNodeDescriptor& rtnd,
+                  int64_t parent_index);
+
+  // The resource descriptors of the template's nodes in DFS pre-order.
+  vector<ResourceDescriptor> node_rds_;
+  // The index of every node's parent in the DFS pre-order of the template.
+  // The machine node has no parent within the template (i.e. -1).
+  vector<int64_t> parent_index_;
+  // The number of children of every node.
+  vector<int32_t> num_children_;
+  uint64_t num_pus_;
+};
+
+}  // namespace sim
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SIM_SIMULATED_MACHINE_TEMPLATE_H
@@ -58,7 +58,18 @@ DEFINE_double(trace_speed_up, 1, "Factor by which to speed up events");
 DEFINE_bool(enable_task_interference, false,
             "True if task runtimes should be affected by co-location "
             "interference");
+DEFINE_string(checkpoint_file, "",
+              "Path of the file to which to save a simulator checkpoint.");
+DEFINE_uint64(checkpoint_at, UINT64_MAX,
+              "Simulation time (in microseconds) after which the first "
+              "scheduling round saves a checkpoint to --checkpoint_file.");
+DEFINE_bool(exit_after_checkpoint, false,
+            "True if the simulation should stop after saving a checkpoint");
+DEFINE_string(restore_checkpoint_file, "",
+              "Path of a simulator checkpoint from which to resume the "
+              "simulation.");
 
+DECLARE_bool(generate_trace);
 DECLARE_uint64(heartbeat_interval);
 DECLARE_uint64(max_solver_runtime);
 DECLARE_uint64(runtime);
@@ -123,15 +134,48 @@ void Simulator::ReplaySimulation() {
     trace_loader = new SyntheticTraceLoader(event_manager_);
   }
   CHECK_NOTNULL(trace_loader);
-  bridge_->LoadTraceData(trace_loader);
 
   uint64_t run_scheduler_at = 0;
   uint64_t current_heartbeat_time = 0;
   uint64_t num_scheduling_rounds = 0;
   bool loaded_initial_machines = false;
+  bool saved_checkpoint = false;
+
+  if (FLAGS_restore_checkpoint_file.empty()) {
+    bridge_->LoadTraceData(trace_loader);
+  } else {
+    // The trace generator's per-task state is not part of the checkpoint.
+    CHECK(!FLAGS_generate_trace)
+      << "--generate_trace cannot be used with --restore_checkpoint_file";
+    CheckpointHeader header;
+    bridge_->RestoreCheckpoint(FLAGS_restore_checkpoint_file, trace_loader,
+                               &header);
+    CHECK_EQ(header.simulation(), FLAGS_simulation)
+      << "Checkpoint was taken for a different type of simulation";
+    run_scheduler_at = header.run_scheduler_at();
+    current_heartbeat_time = header.current_heartbeat_time();
+    num_scheduling_rounds = header.num_scheduling_rounds();
+    scheduler_run_cnt_ = header.scheduler_run_cnt();
+    // The initial machines are part of the checkpoint.
+    loaded_initial_machines = true;
+    // Do not overwrite the checkpoint we've just restored from.
+    saved_checkpoint = true;
+  }
 
   LOG(INFO) << "Simulator::ReplaySimulation: starting loop";
   while (!event_manager_->HasSimulationCompleted(num_scheduling_rounds)) {
+    // We save the checkpoint at the start of an iteration because the
+    // simulator's state is consistent in between scheduling rounds.
+    if (!saved_checkpoint && !FLAGS_checkpoint_file.empty() &&
+        num_scheduling_rounds > 0 &&
+        simulated_time_.GetCurrentTimestamp() >= FLAGS_checkpoint_at) {
+      saved_checkpoint = true;
+      SaveCheckpoint(trace_loader, run_scheduler_at, current_heartbeat_time,
+                     num_scheduling_rounds);
+      if (FLAGS_exit_after_checkpoint) {
+        break;
+      }
+    }
     // Make sure to process all the initial machine additions before we add
     // tasks.
     if (!loaded_initial_machines) {
@@ -198,6 +242,19 @@ void Simulator::Run() {
             << " duplicate task ids";
 }
 
+void Simulator::SaveCheckpoint(TraceLoader* trace_loader,
+                               uint64_t run_scheduler_at,
+                               uint64_t current_heartbeat_time,
+                               uint64_t num_scheduling_rounds) {
+  CheckpointHeader header;
+  header.set_run_scheduler_at(run_scheduler_at);
+  header.set_current_heartbeat_time(current_heartbeat_time);
+  header.set_num_scheduling_rounds(num_scheduling_rounds);
+  header.set_scheduler_run_cnt(scheduler_run_cnt_);
+  header.set_simulation(FLAGS_simulation);
+  bridge_->SaveCheckpoint(FLAGS_checkpoint_file, trace_loader, &header);
+}
+
 uint64_t Simulator::ScheduleJobsHelper(uint64_t run_scheduler_at) {
   boost::timer::cpu_timer timer;
   scheduler::SchedulerStats scheduler_stats;
@@ -33,6 +33,7 @@
 #include "sim/event_manager.h"
 #include "sim/simulated_wall_time.h"
 #include "sim/simulator_bridge.h"
+#include "sim/trace_loader.h"
 #include "sim/trace_utils.h"
 
 DECLARE_string(flow_scheduling_binary);
@@ -52,6 +53,18 @@ class Simulator {
  private:
   void ReplaySimulation();
 
+  /**
+   * Saves a checkpoint of the simulation to --checkpoint_file.
+   * @param trace_loader the trace loader from which task events are loaded
+   * @param run_scheduler_at the time when the scheduler runs next
+   * @param current_heartbeat_time the time of the next machine heartbeat
+   * @param num_scheduling_rounds the number of scheduling rounds run so far
+   */
+  void SaveCheckpoint(TraceLoader* trace_loader,
+                      uint64_t run_scheduler_at,
+                      uint64_t current_heartbeat_time,
+                      uint64_t num_scheduling_rounds);
+
   /**
    * Runs the scheduler.
    * @param the time when the scheduler should run
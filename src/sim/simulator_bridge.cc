@@ -49,7 +49,6 @@ using boost::hash;
 
 DECLARE_uint64(runtime);
 DECLARE_string(scheduler);
-DECLARE_uint64(sim_machine_max_ram);
 DECLARE_int32(flow_scheduling_cost_model);
 DECLARE_double(trace_speed_up);
 DECLARE_bool(enable_task_interference);
@@ -119,7 +118,9 @@ SimulatorBridge::SimulatorBridge(EventManager* event_manager,
         simulated_time_, trace_generator_);
   }
   // Import a fictional machine resource topology
-  LoadMachineTemplate(&machine_tmpl_);
+  ResourceTopologyNodeDescriptor machine_tmpl;
+  LoadMachineTemplate(&machine_tmpl);
+  machine_tmpl_ = new SimulatedMachineTemplate(machine_tmpl);
   scheduler_->RegisterResource(&rtn_root_, false, true);
   if (FLAGS_enable_task_interference) {
     if (FLAGS_flow_scheduling_cost_model == COST_MODEL_QUINCY) {
@@ -141,6 +142,7 @@ SimulatorBridge::SimulatorBridge(EventManager* event_manager,
 SimulatorBridge::~SimulatorBridge() {
   delete trace_generator_;
   delete task_interference_model_;
+  delete machine_tmpl_;
   while (rtn_root_.children_size() > 0) {
     rtn_root_.mutable_children()->RemoveLast();
   }
@@ -179,23 +181,29 @@ ResourceDescriptor* SimulatorBridge::AddMachine(
   //LOG(INFO) << "SimulatorBridge::AddMachine";
   // Create a new machine topology descriptor.
   ResourceTopologyNodeDescriptor* new_machine = rtn_root_.add_children();
-  new_machine->CopyFrom(machine_tmpl_);
-  //LogMachineTemplate(new_machine, 0);
   const string& root_uuid = rtn_root_.resource_desc().uuid();
   string hostname = "firmament_simulation_machine_" +
     lexical_cast<string>(machine_id);
+  vector<ResourceTopologyNodeDescriptor*> machine_nodes;
+  machine_tmpl_->Instantiate(hostname, machine_id, root_uuid, new_machine,
+                             &machine_nodes);
   ResourceDescriptor* rd_ptr = new_machine->mutable_resource_desc();
-  rd_ptr->set_friendly_name(hostname);
-  rd_ptr->set_type(ResourceDescriptor::RESOURCE_MACHINE);
-  rd_ptr->set_trace_machine_id(machine_id);
-  ResourceVector* res_cap = rd_ptr->mutable_resource_capacity();
-  // TODO(ionel): Do not manually set ram_cap! Update the machine protobuf
-  // to include resource capacity values.
-  res_cap->set_ram_cap(FLAGS_sim_machine_max_ram);
-  DFSTraverseResourceProtobufTreeReturnRTND(
-      new_machine, boost::bind(&SimulatorBridge::SetupMachine,
-                               this, _1, res_cap, hostname, machine_id,
-                               root_uuid, rd_ptr->uuid()));
+  ResourceID_t machine_res_id = ResourceIDFromString(rd_ptr->uuid());
+  uint64_t current_time = simulated_time_->GetCurrentTimestamp();
+  for (auto& rtnd_ptr : machine_nodes) {
+    ResourceDescriptor* node_rd_ptr = rtnd_ptr->mutable_resource_desc();
+    // Add the resource node to the map.
+    CHECK(InsertIfNotPresent(
+        resource_map_.get(),
+        ResourceIDFromString(node_rd_ptr->uuid()),
+        new ResourceStatus(node_rd_ptr, rtnd_ptr, "endpoint_uri",
+                           current_time)));
+    if (node_rd_ptr->type() == ResourceDescriptor::RESOURCE_PU) {
+      machine_res_id_pus_.insert(
+          pair<ResourceID_t, ResourceDescriptor*>(machine_res_id,
+                                                  node_rd_ptr));
+    }
+  }
   CHECK(InsertIfNotPresent(&trace_machine_id_to_rtnd_, machine_id,
                            new_machine));
   scheduler_->RegisterResource(new_machine, false, true);
@@ -205,9 +213,6 @@ ResourceDescriptor* SimulatorBridge::AddMachine(
       trace_generator_->AddMachine(*rd_ptr);
   }
   if (FLAGS_flow_scheduling_cost_model != COST_MODEL_QUINCY && data_layer_manager_) {
-      ResourceID_t machine_res_id = MachineResIDForResource(
-                           resource_map_,
-                           ResourceIDFromString(rd_ptr->uuid()));
       //LOG(INFO) << "data_layer_manager_::AddMachine " << hostname <<" : "<<machine_res_id;
       data_layer_manager_->AddMachine(hostname, machine_res_id);
       //LOG(INFO) << "Finsihed data_layer_manager_::AddMachine";
@@ -216,28 +221,38 @@ ResourceDescriptor* SimulatorBridge::AddMachine(
 }
 
 void SimulatorBridge::AddMachineSamples(uint64_t current_time) {
+  // We collect the running tasks of all the machines in a flat vector and
+  // add all the samples to the knowledge base in one batch.
+  vector<ResourceDescriptor*> machine_rds;
+  vector<pair<TaskID_t, ResourceDescriptor*> > running_tasks;
+  vector<size_t> machine_task_offsets;
+  // A task must only be bound to one PU.
+  unordered_set<TaskID_t> sampled_tasks;
+  machine_rds.reserve(trace_machine_id_to_rtnd_.size());
+  machine_task_offsets.reserve(trace_machine_id_to_rtnd_.size() + 1);
+  machine_task_offsets.push_back(0);
   for (auto& machine_id_rtnd : trace_machine_id_to_rtnd_) {
     ResourceDescriptor* machine_rd_ptr =
       machine_id_rtnd.second->mutable_resource_desc();
-    unordered_map<TaskID_t, ResourceDescriptor*> running_task_id_to_rd;
-    vector<ResourceDescriptor*> pu_rds;
     pair<multimap<ResourceID_t, ResourceDescriptor*>::iterator,
          multimap<ResourceID_t, ResourceDescriptor*>::iterator> range_it =
       machine_res_id_pus_.equal_range(
           ResourceIDFromString(machine_rd_ptr->uuid()));
     for (; range_it.first != range_it.second; range_it.first++) {
-      pu_rds.push_back(range_it.first->second);
-    }
-    for (auto& rd_ptr : pu_rds) {
-      vector<TaskID_t> tasks =
-        scheduler_->BoundTasksForResource(ResourceIDFromString(rd_ptr->uuid()));
+      ResourceDescriptor* pu_rd_ptr = range_it.first->second;
+      vector<TaskID_t> tasks = scheduler_->BoundTasksForResource(
+          ResourceIDFromString(pu_rd_ptr->uuid()));
       for (auto& task : tasks) {
-        CHECK(InsertIfNotPresent(&running_task_id_to_rd, task, rd_ptr));
+        CHECK(sampled_tasks.insert(task).second);
+        running_tasks.push_back(
+            pair<TaskID_t, ResourceDescriptor*>(task, pu_rd_ptr));
       }
     }
-    knowledge_base_->AddMachineSample(current_time, machine_rd_ptr,
-                                      running_task_id_to_rd);
+    machine_rds.push_back(machine_rd_ptr);
+    machine_task_offsets.push_back(running_tasks.size());
   }
+  knowledge_base_->AddMachineSamples(current_time, machine_rds, running_tasks,
+                                     machine_task_offsets);
 }
 
 bool SimulatorBridge::AddTask(const TraceTaskIdentifier& task_identifier,
@@ -645,56 +660,222 @@ void SimulatorBridge::RemoveTaskFromSpawned(
   }
 }
 
-void SimulatorBridge::SetupMachine(
-    ResourceTopologyNodeDescriptor* rtnd,
-    ResourceVector* machine_res_cap,
-    const string& hostname,
-    uint64_t trace_machine_id,
-    const string& root_uuid,
-    const string& old_machine_res_id) {
-  string new_uuid;
-  if (!rtnd->parent_id().empty()) {
-    // This is an intermediate node, so translate the parent UUID via the
-    // lookup table
-    const string& old_parent_id = rtnd->parent_id();
-    string* new_parent_id = FindOrNull(uuid_conversion_map_, rtnd->parent_id());
-    CHECK_NOTNULL(new_parent_id);
-    VLOG(3) << "Resetting parent UUID for " << rtnd->resource_desc().uuid()
-            << ", parent was " << old_parent_id
-            << ", is now " << *new_parent_id;
-    rtnd->set_parent_id(*new_parent_id);
-    // Grab a new UUID for the node itself
-    new_uuid = to_string(GenerateResourceID());
-  } else {
-    // This is the top of a machine topology, so generate a first UUID for its
-    // topology based on its hostname and link it into the root
-    rtnd->set_parent_id(root_uuid);
-    new_uuid = to_string(GenerateRootResourceID(hostname));
-  }
-  VLOG(3) << "Resetting UUID for " << rtnd->resource_desc().uuid() << " to "
-          << new_uuid;
-  InsertOrUpdate(&uuid_conversion_map_, rtnd->resource_desc().uuid(), new_uuid);
-  ResourceDescriptor* rd = rtnd->mutable_resource_desc();
-  rd->set_uuid(new_uuid);
-  rd->set_trace_machine_id(trace_machine_id);
-  // Add the resource node to the map.
-  CHECK(InsertIfNotPresent(
-      resource_map_.get(),
-      ResourceIDFromString(rd->uuid()),
-      new ResourceStatus(rd, rtnd, "endpoint_uri",
-                         simulated_time_->GetCurrentTimestamp())));
-  //LOG(INFO) << "SetupMachine: Added Resource, current #resources: "<< resource_map_->size();
-  if (rd->type() == ResourceDescriptor::RESOURCE_PU) {
-    string* new_machine_res_id = FindOrNull(uuid_conversion_map_,
-                                            old_machine_res_id);
-    CHECK_NOTNULL(new_machine_res_id);
-    ResourceID_t machine_res_id = ResourceIDFromString(*new_machine_res_id);
-    float cpu_cores = machine_res_cap->cpu_cores() + 1;
-    // NOTE: We set the number of cpu_cores to the number of PUs.
-    machine_res_cap->set_cpu_cores(cpu_cores);
-    machine_res_id_pus_.insert(
-        pair<ResourceID_t, ResourceDescriptor*>(machine_res_id, rd));
+void SimulatorBridge::RestoreCheckpoint(const string& checkpoint_file,
+                                        TraceLoader* trace_loader,
+                                        CheckpointHeader* header) {
+  CHECK_NOTNULL(trace_loader);
+  CHECK_NOTNULL(header);
+  CHECK(trace_machine_id_to_rtnd_.empty() && job_map_->size() == 0)
+    << "Checkpoints can only be restored into a fresh simulation";
+  LOG(INFO) << "Restoring simulator checkpoint from " << checkpoint_file;
+  CheckpointReader reader(checkpoint_file);
+  CheckpointRecord record;
+  CHECK(reader.ReadRecord(&record) &&
+        record.record_case() == CheckpointRecord::kHeader)
+    << "Checkpoint " << checkpoint_file << " does not start with a header";
+  header->CopyFrom(record.header());
+  CHECK_EQ(header->scheduler(), FLAGS_scheduler)
+    << "Checkpoint was taken with a different scheduler";
+  simulated_time_->UpdateCurrentTimestampIfSmaller(header->simulation_time());
+  event_manager_->set_num_events_processed(header->num_events_processed());
+  num_duplicate_task_ids_ = header->num_duplicate_task_ids();
+  trace_loader->RestoreCheckpoint(header->trace_loader());
+  // The records are stored in the order in which they must be restored:
+  // machines, DFS blocks and knowledge base state before the jobs because the
+  // cost models use them when the jobs' tasks are added to the flow graph.
+  uint64_t num_records = 1;
+  while (reader.ReadRecord(&record)) {
+    num_records++;
+    switch (record.record_case()) {
+      case CheckpointRecord::kMachine: {
+        ResourceDescriptor* rd_ptr = AddMachine(record.machine().machine_id());
+        CHECK_EQ(rd_ptr->uuid(), record.machine().res_id())
+          << "Machine " << record.machine().machine_id()
+          << " got a different resource id on restore";
+        break;
+      }
+      case CheckpointRecord::kDataBlock: {
+        CHECK_NOTNULL(data_layer_manager_);
+        const CheckpointDataBlock& block = record.data_block();
+        // The rack id is set by the DFS.
+        DataLocation location(ResourceIDFromString(block.machine_res_id()), 0,
+                              block.block_id(), block.size_bytes());
+        data_layer_manager_->RestoreBlock(block.task_id(), location);
+        break;
+      }
+      case CheckpointRecord::kTaskStats:
+        knowledge_base_->RestoreTraceTaskStats(record.task_stats());
+        break;
+      case CheckpointRecord::kFinalReports:
+        knowledge_base_->RestoreFinalReports(record.final_reports());
+        break;
+      case CheckpointRecord::kMachineStats:
+        knowledge_base_->RestoreMachineStats(record.machine_stats());
+        break;
+      case CheckpointRecord::kJobNumTasks: {
+        const CheckpointJobNumTasks& job_num_tasks = record.job_num_tasks();
+        CHECK(InsertIfNotPresent(&job_num_tasks_,
+                                 job_num_tasks.trace_job_id(),
+                                 job_num_tasks.num_tasks()));
+        CHECK(InsertIfNotPresent(&immutable_job_num_tasks_,
+                                 job_num_tasks.trace_job_id(),
+                                 job_num_tasks.immutable_num_tasks()));
+        break;
+      }
+      case CheckpointRecord::kTaskRuntime:
+        CHECK(InsertIfNotPresent(&task_runtime_,
+                                 record.task_runtime().task_id(),
+                                 record.task_runtime().runtime()));
+        break;
+      case CheckpointRecord::kSubmittedTask: {
+        TraceTaskIdentifier task_identifier;
+        task_identifier.job_id = record.submitted_task().job_id();
+        task_identifier.task_index = record.submitted_task().task_index();
+        submitted_tasks_.insert(task_identifier);
+        break;
+      }
+      case CheckpointRecord::kJob:
+        RestoreJob(record.job());
+        break;
+      case CheckpointRecord::kEvent:
+        event_manager_->AddEvent(record.event().timestamp(),
+                                 record.event().event());
+        break;
+      default:
+        LOG(FATAL) << "Unexpected checkpoint record type "
+                   << record.record_case();
+    }
+  }
+  // Restore the block placement state last: re-adding the machines must not
+  // advance it.
+  if (data_layer_manager_) {
+    data_layer_manager_->RestoreCheckpoint(header->dfs());
+  }
+  // The stats of the tasks that have not yet been submitted are not part of
+  // the checkpoint. We load them again from the trace.
+  trace_loader->LoadTaskUtilizationStats(&task_id_to_stats_, task_runtime_);
+  for (auto& task_identifier : submitted_tasks_) {
+    task_id_to_stats_.erase(GenerateTaskIDFromTraceIdentifier(task_identifier));
+  }
+  LOG(INFO) << "Restored " << num_records << " checkpoint records at "
+            << "simulation time " << simulated_time_->GetCurrentTimestamp();
+}
+
+void SimulatorBridge::RestoreJob(const CheckpointJob& checkpoint_job) {
+  JobID_t job_id = JobIDFromString(checkpoint_job.job().uuid());
+  CHECK(InsertIfNotPresent(job_map_.get(), job_id, checkpoint_job.job()));
+  // Get the new value of the pointer because the job has been copied.
+  JobDescriptor* jd_ptr = FindOrNull(*job_map_, job_id);
+  CHECK_NOTNULL(jd_ptr);
+  CHECK(InsertIfNotPresent(&trace_job_id_to_jd_, checkpoint_job.trace_job_id(),
+                           jd_ptr));
+  InsertOrUpdate(&job_id_to_trace_job_id_, job_id,
+                 checkpoint_job.trace_job_id());
+  RestoreTaskMappings(jd_ptr->mutable_root_task(), true);
+  scheduler_->RestoreJob(jd_ptr);
+}
+
+void SimulatorBridge::RestoreTaskMappings(TaskDescriptor* td_ptr,
+                                          bool is_root) {
+  // Completed tasks are kept in the job descriptor, but only the root task
+  // remains in the task map (see TaskCompleted).
+  if (td_ptr->state() != TaskDescriptor::COMPLETED || is_root) {
+    CHECK(InsertIfNotPresent(task_map_.get(), td_ptr->uid(), td_ptr));
+  }
+  if (td_ptr->state() != TaskDescriptor::COMPLETED) {
+    TraceTaskIdentifier task_identifier;
+    task_identifier.job_id = td_ptr->trace_job_id();
+    task_identifier.task_index = td_ptr->trace_task_id();
+    CHECK(InsertIfNotPresent(&task_id_to_identifier_, td_ptr->uid(),
+                             task_identifier));
+    CHECK(InsertIfNotPresent(&trace_task_id_to_td_, task_identifier, td_ptr));
+  }
+  for (auto& spawned_td : *td_ptr->mutable_spawned()) {
+    RestoreTaskMappings(&spawned_td, false);
+  }
+}
+
+void SimulatorBridge::SaveCheckpoint(const string& checkpoint_file,
+                                     TraceLoader* trace_loader,
+                                     CheckpointHeader* header) {
+  CHECK_NOTNULL(trace_loader);
+  CHECK_NOTNULL(header);
+  LOG(INFO) << "Saving simulator checkpoint to " << checkpoint_file;
+  CheckpointWriter writer(checkpoint_file);
+  CheckpointRecord record;
+  header->set_simulation_time(simulated_time_->GetCurrentTimestamp());
+  header->set_num_events_processed(event_manager_->num_events_processed());
+  header->set_num_duplicate_task_ids(num_duplicate_task_ids_);
+  header->set_scheduler(FLAGS_scheduler);
+  trace_loader->SaveCheckpoint(header->mutable_trace_loader());
+  if (data_layer_manager_) {
+    data_layer_manager_->SaveCheckpoint(header->mutable_dfs());
+  }
+  record.mutable_header()->CopyFrom(*header);
+  writer.WriteRecord(record);
+  // Machines get their resource ids and their DFS racks depending on the
+  // order in which they are added, so we save them in that order.
+  for (auto& machine_rtnd : rtn_root_.children()) {
+    uint64_t machine_id = machine_rtnd.resource_desc().trace_machine_id();
+    ResourceTopologyNodeDescriptor* rtnd_ptr =
+      FindPtrOrNull(trace_machine_id_to_rtnd_, machine_id);
+    if (rtnd_ptr != &machine_rtnd) {
+      // The machine has been removed.
+      continue;
+    }
+    CheckpointMachine* machine = record.mutable_machine();
+    machine->set_machine_id(machine_id);
+    machine->set_res_id(machine_rtnd.resource_desc().uuid());
+    writer.WriteRecord(record);
+  }
+  if (data_layer_manager_) {
+    vector<pair<TaskID_t, DataLocation> > block_locations;
+    data_layer_manager_->GetAllBlockLocations(&block_locations);
+    for (auto& task_location : block_locations) {
+      CheckpointDataBlock* block = record.mutable_data_block();
+      block->set_task_id(task_location.first);
+      block->set_machine_res_id(
+          to_string(task_location.second.machine_res_id_));
+      block->set_block_id(task_location.second.block_id_);
+      block->set_size_bytes(task_location.second.size_bytes_);
+      writer.WriteRecord(record);
+    }
+  }
+  knowledge_base_->SaveCheckpoint(&writer);
+  for (auto& job_num_tasks : job_num_tasks_) {
+    uint64_t* immutable_num_tasks =
+      FindOrNull(immutable_job_num_tasks_, job_num_tasks.first);
+    CHECK_NOTNULL(immutable_num_tasks);
+    CheckpointJobNumTasks* checkpoint_num_tasks =
+      record.mutable_job_num_tasks();
+    checkpoint_num_tasks->set_trace_job_id(job_num_tasks.first);
+    checkpoint_num_tasks->set_num_tasks(job_num_tasks.second);
+    checkpoint_num_tasks->set_immutable_num_tasks(*immutable_num_tasks);
+    writer.WriteRecord(record);
+  }
+  for (auto& task_runtime : task_runtime_) {
+    CheckpointTaskRuntime* checkpoint_runtime = record.mutable_task_runtime();
+    checkpoint_runtime->set_task_id(task_runtime.first);
+    checkpoint_runtime->set_runtime(task_runtime.second);
+    writer.WriteRecord(record);
+  }
+  for (auto& task_identifier : submitted_tasks_) {
+    CheckpointTraceTaskIdentifier* submitted_task =
+      record.mutable_submitted_task();
+    submitted_task->set_job_id(task_identifier.job_id);
+    submitted_task->set_task_index(task_identifier.task_index);
+    writer.WriteRecord(record);
+  }
+  for (auto& trace_job_id_jd : trace_job_id_to_jd_) {
+    CheckpointJob* checkpoint_job = record.mutable_job();
+    checkpoint_job->set_trace_job_id(trace_job_id_jd.first);
+    checkpoint_job->mutable_job()->CopyFrom(*trace_job_id_jd.second);
+    writer.WriteRecord(record);
   }
+  event_manager_->SaveCheckpoint(&writer);
+  LOG(INFO) << "Saved " << writer.num_records_written()
+            << " checkpoint records at simulation time "
+            << simulated_time_->GetCurrentTimestamp();
 }
 
 void SimulatorBridge::ScheduleJobs(SchedulerStats* scheduler_stats) {
@@ -37,7 +37,9 @@
 #include "sim/event_manager.h"
 #include "sim/interference/task_interference_interface.h"
 #include "sim/knowledge_base_simulator.h"
+#include "sim/simulated_machine_template.h"
 #include "sim/simulated_wall_time.h"
+#include "sim/simulator_checkpoint.h"
 #include "sim/trace_loader.h"
 #include "sim/trace_utils.h"
 #include "storage/object_store_interface.h"
@@ -157,6 +159,31 @@ class SimulatorBridge : public scheduler::SchedulingEventNotifierInterface {
    */
   void RemoveMachine(uint64_t machine_id);
 
+  /**
+   * Restores the simulation state from a checkpoint. The method must be called
+   * on a fresh bridge instead of LoadTraceData.
+   * @param checkpoint_file the path of the checkpoint file
+   * @param trace_loader the trace loader to continue loading task events from
+   * @param header populated with the checkpoint header, which contains the
+   * simulator's scheduling loop state
+   */
+  void RestoreCheckpoint(const string& checkpoint_file,
+                         TraceLoader* trace_loader,
+                         CheckpointHeader* header);
+
+  /**
+   * Saves the simulation state to a checkpoint. The flow graph and the
+   * solver state are not saved; they are rebuilt from the restored jobs
+   * and resource topology.
+   * @param checkpoint_file the path of the checkpoint file
+   * @param trace_loader the trace loader from which task events are loaded
+   * @param header the checkpoint header, which must already contain the
+   * simulator's scheduling loop state
+   */
+  void SaveCheckpoint(const string& checkpoint_file,
+                      TraceLoader* trace_loader,
+                      CheckpointHeader* header);
+
   void ScheduleJobs(SchedulerStats* scheduler_stats);
 
   /**
@@ -182,6 +209,7 @@ class SimulatorBridge : public scheduler::SchedulingEventNotifierInterface {
   FRIEND_TEST(SimulatorBridgeTest, OnTaskEviction);
   FRIEND_TEST(SimulatorBridgeTest, OnTaskPlacement);
   FRIEND_TEST(SimulatorBridgeTest, RemoveMachine);
+  FRIEND_TEST(SimulatorBridgeTest, SaveAndRestoreCheckpoint);
 
   /**
    * Add task statistics to the knowledge base.
@@ -216,15 +244,19 @@ class SimulatorBridge : public scheduler::SchedulingEventNotifierInterface {
                              const TaskDescriptor& td_to_remove);
 
   /**
-   * The resource topology is built from the same protobuf file. The function
-   * changes the uuids to make sure that there's no two identical uuids.
+   * Adds a job saved in a checkpoint and re-creates the mappings for its
+   * tasks.
+   * @param checkpoint_job the checkpointed job
+   */
+  void RestoreJob(const CheckpointJob& checkpoint_job);
+
+  /**
+   * Re-creates the simulator's mappings for a restored task and its spawned
+   * tasks.
+   * @param td_ptr the descriptor of the restored task
+   * @param is_root true if the task is the root task of its job
    */
-  void SetupMachine(ResourceTopologyNodeDescriptor* rtnd,
-                    ResourceVector* machine_res_cap,
-                    const string& hostname,
-                    uint64_t trace_machine_id,
-                    const string& root_uuid,
-                    const string& old_machine_res_id);
+  void RestoreTaskMappings(TaskDescriptor* td_ptr, bool is_root);
 
   /**
    * Helper method that updates TASK_END_RUNTIME events for tasks whose end
@@ -291,11 +323,8 @@ class SimulatorBridge : public scheduler::SchedulingEventNotifierInterface {
   unordered_set<TraceTaskIdentifier,
     TraceTaskIdentifierHasher> submitted_tasks_;
 
-  // Map used to convert between the new uuids assigned to the machine nodes and
-  // the old uuids read from the machine topology file.
-  unordered_map<string, string> uuid_conversion_map_;
-  // The template topology descriptor of the new machine.
-  ResourceTopologyNodeDescriptor machine_tmpl_;
+  // The template from which the simulated machines are instantiated.
+  SimulatedMachineTemplate* machine_tmpl_;
   // Counter used to store the number of duplicate task ids seed in the trace.
   uint64_t num_duplicate_task_ids_;
   // Object used to get task interference information.
@@ -22,13 +22,25 @@
 
 #include <gtest/gtest.h>
 
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/units.h"
 #include "misc/utils.h"
 #include "sim/google_trace_loader.h"
 #include "sim/simulated_wall_time.h"
 #include "sim/simulator_bridge.h"
+#include "sim/simulator_checkpoint.h"
+#include "sim/synthetic_trace_loader.h"
 #include "sim/trace_utils.h"
 
 DECLARE_string(machine_tmpl_file);
+DECLARE_uint64(runtime);
+DECLARE_uint64(synthetic_job_interarrival_time);
+DECLARE_uint64(synthetic_num_jobs);
+DECLARE_uint64(synthetic_num_machines);
+DECLARE_uint64(synthetic_tasks_per_job);
 DEFINE_string(scheduler, "flow", "The scheduler to use for tests.");
 
 namespace firmament {
@@ -74,10 +86,16 @@ TEST_F(SimulatorBridgeTest, AddMachine) {
   CHECK_EQ(bridge_->trace_machine_id_to_rtnd_.size(), 0);
   CHECK_EQ(bridge_->machine_res_id_pus_.size(), 0);
   // Add first machine.
-  bridge_->AddMachine(1);
+  ResourceDescriptor* rd_ptr = bridge_->AddMachine(1);
   CHECK_EQ(bridge_->resource_map_->size(), 10);
   CHECK_EQ(bridge_->trace_machine_id_to_rtnd_.size(), 1);
   CHECK_EQ(bridge_->machine_res_id_pus_.size(), 8);
+  CHECK_EQ(rd_ptr->resource_capacity().cpu_cores(), 8);
+  ResourceTopologyNodeDescriptor** rtnd_ptr =
+    FindOrNull(bridge_->trace_machine_id_to_rtnd_, 1);
+  CHECK_NOTNULL(rtnd_ptr);
+  CHECK_EQ((*rtnd_ptr)->parent_id(),
+           bridge_->rtn_root_.resource_desc().uuid());
   // Add second machine.
   bridge_->AddMachine(2);
   CHECK_EQ(bridge_->resource_map_->size(), 19);
@@ -261,6 +279,175 @@ TEST_F(SimulatorBridgeTest, RemoveMachine) {
   CHECK_EQ(bridge_->machine_res_id_pus_.size(), 0);
 }
 
+// Resource and finish time of every running task, keyed by task id.
+typedef map<TaskID_t, pair<string, uint64_t> > TaskBindings_t;
+
+static const uint64_t kSchedulingInterval = 100000;
+static const uint64_t kHeartbeatInterval = 200000;
+
+// Runs scheduling rounds the way Simulator::ReplaySimulation does, keeping the
+// loop state in the checkpoint header, and appends the running tasks'
+// bindings after each round to schedule.
+void RunSchedulingRounds(SimulatorBridge* bridge, EventManager* event_manager,
+                         SimulatedWallTime* simulated_time,
+                         TraceLoader* trace_loader, const TaskMap_t& task_map,
+                         uint64_t num_rounds, CheckpointHeader* loop_state,
+                         vector<TaskBindings_t>* schedule) {
+  for (uint64_t round = 0; round < num_rounds; ++round) {
+    uint64_t run_scheduler_at = loop_state->run_scheduler_at();
+    uint64_t heartbeat_time = loop_state->current_heartbeat_time();
+    trace_loader->LoadTaskEvents(run_scheduler_at, bridge->job_num_tasks());
+    for (; run_scheduler_at >= heartbeat_time;
+         heartbeat_time += kHeartbeatInterval) {
+      EventDescriptor event_desc;
+      event_desc.set_type(EventDescriptor::MACHINE_HEARTBEAT);
+      event_manager->AddEvent(heartbeat_time, event_desc);
+    }
+    bridge->ProcessSimulatorEvents(run_scheduler_at);
+    simulated_time->UpdateCurrentTimestamp(run_scheduler_at);
+    scheduler::SchedulerStats scheduler_stats;
+    bridge->ScheduleJobs(&scheduler_stats);
+    TaskBindings_t bindings;
+    for (auto& id_td : task_map) {
+      if (id_td.second->state() == TaskDescriptor::RUNNING) {
+        bindings[id_td.first] =
+          make_pair(id_td.second->scheduled_to_resource(),
+                    id_td.second->finish_time());
+      }
+    }
+    schedule->push_back(bindings);
+    loop_state->set_run_scheduler_at(run_scheduler_at + kSchedulingInterval);
+    loop_state->set_current_heartbeat_time(heartbeat_time);
+    loop_state->set_num_scheduling_rounds(
+        loop_state->num_scheduling_rounds() + 1);
+  }
+}
+
+// Writes the pending events to a checkpoint file and reads them back.
+void GetPendingEvents(EventManager* event_manager, const string& file_name,
+                      vector<string>* events) {
+  {
+    CheckpointWriter writer(file_name);
+    event_manager->SaveCheckpoint(&writer);
+  }
+  CheckpointReader reader(file_name);
+  CheckpointRecord record;
+  while (reader.ReadRecord(&record)) {
+    events->push_back(record.event().SerializeAsString());
+  }
+  remove(file_name.c_str());
+}
+
+TEST_F(SimulatorBridgeTest, SaveAndRestoreCheckpoint) {
+  // The simple scheduler does not need an external solver. One task per job
+  // and one job per round keep its placements independent of the order in
+  // which it visits runnable tasks.
+  FLAGS_scheduler = "simple";
+  FLAGS_runtime = 10 * SECONDS_TO_MICROSECONDS;
+  FLAGS_synthetic_num_machines = 2;
+  FLAGS_synthetic_num_jobs = 40;
+  FLAGS_synthetic_tasks_per_job = 1;
+  FLAGS_synthetic_job_interarrival_time = kSchedulingInterval;
+  string dir = MakeTemporaryDirectory("simulator_bridge_test");
+  ASSERT_FALSE(dir.empty());
+  string checkpoint_file = dir + "/checkpoint";
+  // Run the original simulation up to the checkpoint.
+  SimulatedWallTime simulated_time;
+  EventManager event_manager(&simulated_time);
+  SimulatorBridge bridge(&event_manager, &simulated_time);
+  SyntheticTraceLoader loader(&event_manager);
+  bridge.LoadTraceData(&loader);
+  bridge.ProcessSimulatorEvents(0);
+  CheckpointHeader loop_state;
+  vector<TaskBindings_t> schedule;
+  RunSchedulingRounds(&bridge, &event_manager, &simulated_time, &loader,
+                      *bridge.task_map_, 15, &loop_state, &schedule);
+  ASSERT_GT(schedule.back().size(), 0U);
+  bridge.SaveCheckpoint(checkpoint_file, &loader, &loop_state);
+  // Restore it into a fresh simulation.
+  SimulatedWallTime restored_time;
+  EventManager restored_event_manager(&restored_time);
+  SimulatorBridge restored_bridge(&restored_event_manager, &restored_time);
+  SyntheticTraceLoader restored_loader(&restored_event_manager);
+  CheckpointHeader restored_loop_state;
+  restored_bridge.RestoreCheckpoint(checkpoint_file, &restored_loader,
+                                    &restored_loop_state);
+  EXPECT_EQ(restored_loop_state.run_scheduler_at(),
+            loop_state.run_scheduler_at());
+  EXPECT_EQ(restored_loop_state.current_heartbeat_time(),
+            loop_state.current_heartbeat_time());
+  EXPECT_EQ(restored_time.GetCurrentTimestamp(),
+            simulated_time.GetCurrentTimestamp());
+  EXPECT_EQ(restored_event_manager.num_events_processed(),
+            event_manager.num_events_processed());
+  // Check the resources.
+  EXPECT_EQ(restored_bridge.resource_map_->size(),
+            bridge.resource_map_->size());
+  EXPECT_EQ(restored_bridge.trace_machine_id_to_rtnd_.size(),
+            bridge.trace_machine_id_to_rtnd_.size());
+  for (auto& id_rs : *bridge.resource_map_) {
+    ResourceStatus* rs_ptr =
+      FindPtrOrNull(*restored_bridge.resource_map_, id_rs.first);
+    ASSERT_TRUE(rs_ptr != NULL);
+    EXPECT_EQ(rs_ptr->descriptor().state(), id_rs.second->descriptor().state());
+    EXPECT_EQ(rs_ptr->descriptor().current_running_tasks_size(),
+              id_rs.second->descriptor().current_running_tasks_size());
+  }
+  // Check the jobs.
+  EXPECT_EQ(restored_bridge.job_map_->size(), bridge.job_map_->size());
+  EXPECT_EQ(restored_bridge.trace_job_id_to_jd_.size(),
+            bridge.trace_job_id_to_jd_.size());
+  for (auto& id_jd : *bridge.job_map_) {
+    JobDescriptor* jd_ptr = FindOrNull(*restored_bridge.job_map_, id_jd.first);
+    ASSERT_TRUE(jd_ptr != NULL);
+    EXPECT_EQ(jd_ptr->state(), id_jd.second.state());
+    EXPECT_EQ(jd_ptr->root_task().state(), id_jd.second.root_task().state());
+  }
+  // Check the tasks and the scheduler's bindings.
+  EXPECT_EQ(restored_bridge.task_map_->size(), bridge.task_map_->size());
+  EXPECT_EQ(restored_bridge.trace_task_id_to_td_.size(),
+            bridge.trace_task_id_to_td_.size());
+  for (auto& id_td : *bridge.task_map_) {
+    TaskDescriptor* td_ptr =
+      FindPtrOrNull(*restored_bridge.task_map_, id_td.first);
+    ASSERT_TRUE(td_ptr != NULL);
+    EXPECT_EQ(td_ptr->state(), id_td.second->state());
+    EXPECT_EQ(td_ptr->scheduled_to_resource(),
+              id_td.second->scheduled_to_resource());
+    EXPECT_EQ(td_ptr->finish_time(), id_td.second->finish_time());
+    ResourceID_t* res_id_ptr =
+      restored_bridge.scheduler_->BoundResourceForTask(id_td.first);
+    if (id_td.second->state() == TaskDescriptor::RUNNING) {
+      ASSERT_TRUE(res_id_ptr != NULL);
+      EXPECT_EQ(to_string(*res_id_ptr), td_ptr->scheduled_to_resource());
+    } else {
+      EXPECT_TRUE(res_id_ptr == NULL);
+    }
+  }
+  // Check the pending events.
+  vector<string> events;
+  vector<string> restored_events;
+  GetPendingEvents(&event_manager, dir + "/events",
+                   &events);
+  GetPendingEvents(&restored_event_manager,
+                   dir + "/restored_events",
+                   &restored_events);
+  EXPECT_GT(events.size(), 0U);
+  EXPECT_TRUE(events == restored_events);
+  // Both simulations must make the same decisions from here on.
+  vector<TaskBindings_t> continued_schedule;
+  vector<TaskBindings_t> restored_schedule;
+  RunSchedulingRounds(&bridge, &event_manager, &simulated_time, &loader,
+                      *bridge.task_map_, 25, &loop_state,
+                      &continued_schedule);
+  RunSchedulingRounds(&restored_bridge, &restored_event_manager,
+                      &restored_time, &restored_loader,
+                      *restored_bridge.task_map_, 25, &restored_loop_state,
+                      &restored_schedule);
+  EXPECT_TRUE(continued_schedule == restored_schedule);
+  EXPECT_TRUE(RemoveDirectoryRecursively(dir));
+}
+
 } // namespace sim
 } // namespace firmament
 
@@ -0,0 +1,89 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+// Implementation of the simulator checkpoint reader and writer.
+
+#include "sim/simulator_checkpoint.h"
+
+#include <string>
+
+namespace firmament {
+namespace sim {
+
+CheckpointWriter::CheckpointWriter(const string& file_name)
+  : num_records_written_(0) {
+  checkpoint_file_.open(file_name.c_str(),
+                        ios::out | ios::trunc | ios::binary);
+  CHECK(checkpoint_file_.is_open()) << "Could not open checkpoint file "
+                                    << file_name << " for writing";
+  raw_output_ =
+    new ::google::protobuf::io::OstreamOutputStream(&checkpoint_file_);
+  coded_output_ = new ::google::protobuf::io::CodedOutputStream(raw_output_);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  // The coded stream must be deleted first in order to flush its buffer.
+  delete coded_output_;
+  delete raw_output_;
+  checkpoint_file_.close();
+}
+
+void CheckpointWriter::WriteRecord(const CheckpointRecord& record) {
+  string record_string;
+  CHECK(record.SerializeToString(&record_string));
+  coded_output_->WriteVarint32(record_string.size());
+  coded_output_->WriteRaw(record_string.data(), record_string.size());
+  CHECK(!coded_output_->HadError()) << "Failed to write checkpoint record";
+  num_records_written_++;
+}
+
+CheckpointReader::CheckpointReader(const string& file_name) {
+  checkpoint_file_.open(file_name.c_str(), ios::in | ios::binary);
+  CHECK(checkpoint_file_.is_open()) << "Could not open checkpoint file "
+                                    << file_name << " for reading";
+  raw_input_ = new ::google::protobuf::io::IstreamInputStream(&checkpoint_file_);
+}
+
+CheckpointReader::~CheckpointReader() {
+  delete raw_input_;
+  checkpoint_file_.close();
+}
+
+bool CheckpointReader::ReadRecord(CheckpointRecord* record) {
+  CHECK_NOTNULL(record);
+  // We use a new CodedInputStream for every record because a coded stream
+  // refuses to read more than a total of 64MB, and checkpoints of large
+  // simulations are bigger than that.
+  ::google::protobuf::io::CodedInputStream coded_input(raw_input_);
+  uint32_t record_size;
+  if (!coded_input.ReadVarint32(&record_size)) {
+    return false;
+  }
+  ::google::protobuf::io::CodedInputStream::Limit limit =
+    coded_input.PushLimit(record_size);
+  CHECK(record->ParseFromCodedStream(&coded_input))
+    << "Unexpected format of the checkpoint file";
+  coded_input.PopLimit(limit);
+  return true;
+}
+
+}  // namespace sim
+}  // namespace firmament
@@ -0,0 +1,82 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+// Reader and writer for simulator checkpoint files. A checkpoint is a sequence
+// of varint length-prefixed CheckpointRecord protobufs.
+
+#ifndef FIRMAMENT_SIM_SIMULATOR_CHECKPOINT_H
+#define FIRMAMENT_SIM_SIMULATOR_CHECKPOINT_H
+
+#include <fstream>
+#include <string>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include "base/common.h"
+#include "sim/simulator_checkpoint.pb.h"
+
+namespace firmament {
+namespace sim {
+
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(const string& file_name);
+  ~CheckpointWriter();
+
+  /**
+   * Appends a record to the checkpoint file.
+   * @param record the record to append
+   */
+  void WriteRecord(const CheckpointRecord& record);
+
+  inline uint64_t num_records_written() const {
+    return num_records_written_;
+  }
+
+ private:
+  fstream checkpoint_file_;
+  ::google::protobuf::io::ZeroCopyOutputStream* raw_output_;
+  ::google::protobuf::io::CodedOutputStream* coded_output_;
+  uint64_t num_records_written_;
+};
+
+class CheckpointReader {
+ public:
+  explicit CheckpointReader(const string& file_name);
+  ~CheckpointReader();
+
+  /**
+   * Reads the next record from the checkpoint file.
+   * @param record the record to populate
+   * @return false if there are no more records to read
+   */
+  bool ReadRecord(CheckpointRecord* record);
+
+ private:
+  fstream checkpoint_file_;
+  ::google::protobuf::io::ZeroCopyInputStream* raw_input_;
+};
+
+}  // namespace sim
+}  // namespace firmament
+
+#endif  // FIRMAMENT_SIM_SIMULATOR_CHECKPOINT_H
@@ -25,6 +25,7 @@
 #include "sim/trace_utils.h"
 #include <cstdlib>
 #include <ctime>
+#include <sstream>
 
 DEFINE_uint64(synthetic_machine_failure_rate, 0,
               "Number of machine failures per hour");
@@ -294,5 +295,21 @@ void SyntheticTraceLoader::LoadTasksRunningTime(
   }
 }
 
+void SyntheticTraceLoader::RestoreCheckpoint(
+    const TraceLoaderCheckpoint& checkpoint) {
+  last_generated_job_id_ = checkpoint.last_generated_job_id();
+  istringstream engine_state(checkpoint.random_engine_state());
+  engine_state >> generator;
+  CHECK(!engine_state.fail()) << "Failed to restore random engine state";
+}
+
+void SyntheticTraceLoader::SaveCheckpoint(TraceLoaderCheckpoint* checkpoint) {
+  CHECK_NOTNULL(checkpoint);
+  checkpoint->set_last_generated_job_id(last_generated_job_id_);
+  ostringstream engine_state;
+  engine_state << generator;
+  checkpoint->set_random_engine_state(engine_state.str());
+}
+
 } // namespace sim
 } // namespace firmament
@@ -42,6 +42,8 @@ class SyntheticTraceLoader : public TraceLoader {
       const unordered_map<TaskID_t, uint64_t>& task_runtimes);
   void LoadTasksRunningTime(
       unordered_map<TaskID_t, uint64_t>* task_runtime);
+  void RestoreCheckpoint(const TraceLoaderCheckpoint& checkpoint);
+  void SaveCheckpoint(TraceLoaderCheckpoint* checkpoint);
  private:
   void GetNumberOfSlots(const ResourceTopologyNodeDescriptor& rtnd,
                         uint64_t* num_slots);
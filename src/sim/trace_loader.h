@@ -25,6 +25,7 @@
 
 #include "base/common.h"
 #include "sim/event_manager.h"
+#include "sim/simulator_checkpoint.pb.h"
 #include "sim/trace_utils.h"
 
 namespace firmament {
@@ -70,6 +71,18 @@ class TraceLoader {
   virtual void LoadTasksRunningTime(
       unordered_map<TaskID_t, uint64_t>* task_runtime) = 0;
 
+  /**
+   * Restores the position in the trace from which to load task events.
+   * @param checkpoint the loader state saved by SaveCheckpoint
+   */
+  virtual void RestoreCheckpoint(const TraceLoaderCheckpoint& checkpoint) = 0;
+
+  /**
+   * Saves the position in the trace from which task events are loaded.
+   * @param checkpoint the checkpoint message to populate
+   */
+  virtual void SaveCheckpoint(TraceLoaderCheckpoint* checkpoint) = 0;
+
  protected:
   EventManager* event_manager_;
 };
@@ -66,6 +66,7 @@ class ConcreteReference : public ReferenceInterface {
   }
   void SetLocation(const string& location) {
     location_ = location;
+    desc_.set_location(location);
   }
   virtual inline bool Consumable() const {
     return true;
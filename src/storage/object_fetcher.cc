@@ -0,0 +1,295 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Object fetcher implementation.
+
+#include "storage/object_fetcher.h"
+
+#include <endian.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include "misc/uri_tools.h"
+
+DEFINE_uint64(object_transfer_chunk_size, 4 * 1024 * 1024,
+              "Size, in bytes, of the chunks in which objects are fetched "
+              "from other machines.");
+DEFINE_uint64(object_transfer_pipeline_depth, 4,
+              "Number of chunk requests that an object fetch keeps "
+              "outstanding on each replica's connection.");
+DEFINE_uint64(object_transfer_timeout_ms, 10000,
+              "Time after which a replica that does not accept or send any "
+              "data on a fetch connection is given up on.");
+DEFINE_uint64(object_transfer_fetch_threads, 8,
+              "Number of threads that run object fetch connections. Further "
+              "connections wait until a thread is free.");
+
+DECLARE_string(object_store_dir);
+
+namespace firmament {
+namespace store {
+
+ObjectFetcher::ObjectFetcher(ResourceID_t uuid)
+  : ObjectFetcher(uuid, FLAGS_object_store_dir) {
+}
+
+ObjectFetcher::ObjectFetcher(ResourceID_t uuid, const string& store_dir)
+  : store_(uuid, store_dir), num_active_fetches_(0),
+    executor_(max<uint64_t>(FLAGS_object_transfer_fetch_threads, 1)) {
+}
+
+ObjectFetcher::~ObjectFetcher() {
+  {
+    boost::unique_lock<boost::mutex> lock(active_lock_);
+    while (num_active_fetches_ > 0)
+      fetch_finished_.wait(lock);
+  }
+  executor_.Shutdown();
+}
+
+bool ObjectFetcher::FetchAsync(const DataObjectID_t& id, uint64_t size,
+                               const vector<string>& replicas,
+                               FetchCallback callback) {
+  return StartFetch(id, size, replicas, callback) != NULL;
+}
+
+bool ObjectFetcher::Fetch(const DataObjectID_t& id, uint64_t size,
+                          const vector<string>& replicas) {
+  shared_ptr<FetchState> state =
+    StartFetch(id, size, replicas, FetchCallback());
+  if (!state)
+    return false;
+  boost::unique_lock<boost::mutex> lock(state->lock);
+  while (!state->finished)
+    state->finished_cond.wait(lock);
+  return state->succeeded;
+}
+
+uint64_t ObjectFetcher::NumActiveFetches() {
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  return num_active_fetches_;
+}
+
+int ObjectFetcher::ConnectToReplica(const string& endpoint) {
+  string host = URITools::GetHostnameFromURI(endpoint);
+  string port = URITools::GetPortFromURI(endpoint);
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addrs = NULL;
+  int ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs);
+  if (ret != 0) {
+    LOG(ERROR) << "Failed to resolve object transfer endpoint " << endpoint
+               << ": " << gai_strerror(ret);
+    return -1;
+  }
+  // Stalled replicas must not block the fetch forever: the send timeout
+  // also bounds connect(2), and on expiry the chunks move to other replicas.
+  struct timeval timeout;
+  timeout.tv_sec = FLAGS_object_transfer_timeout_ms / 1000;
+  timeout.tv_usec = (FLAGS_object_transfer_timeout_ms % 1000) * 1000;
+  int fd = -1;
+  for (struct addrinfo* addr = addrs; addr; addr = addr->ai_next) {
+    fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC,
+                addr->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (FLAGS_object_transfer_timeout_ms > 0 &&
+        (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                    sizeof(timeout)) != 0 ||
+         setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                    sizeof(timeout)) != 0)) {
+      PLOG(WARNING) << "Failed to set timeouts on object transfer socket";
+    }
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  if (fd < 0) {
+    PLOG(WARNING) << "Failed to connect to object transfer endpoint "
+                  << endpoint;
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+bool ObjectFetcher::FetchChunksFromReplica(FetchState* state,
+                                           const string& endpoint) {
+  int fd = ConnectToReplica(endpoint);
+  if (fd < 0)
+    return false;
+  uint64_t chunk_size = max<uint64_t>(FLAGS_object_transfer_chunk_size, 1);
+  uint64_t depth = max<uint64_t>(FLAGS_object_transfer_pipeline_depth, 1);
+  // Chunks requested on this connection, in the order in which the server
+  // answers them.
+  deque<uint64_t> in_flight;
+  bool failed = false;
+  while (!failed) {
+    // Keep the pipeline full, so that the server always has the next
+    // request at hand when it finishes sending a chunk.
+    while (in_flight.size() < depth) {
+      uint64_t chunk;
+      {
+        boost::lock_guard<boost::mutex> lock(state->lock);
+        if (state->pending_chunks.empty())
+          break;
+        chunk = state->pending_chunks.front();
+        state->pending_chunks.pop_front();
+      }
+      in_flight.push_back(chunk);
+      uint64_t offset = chunk * chunk_size;
+      ObjectChunkRequest request;
+      memcpy(request.name, state->id.name(), DIOS_NAME_BYTES);
+      request.offset = htobe64(offset);
+      request.length = htobe64(min(chunk_size, state->size - offset));
+      if (!SendFully(fd, &request, sizeof(request))) {
+        failed = true;
+        break;
+      }
+    }
+    if (failed || in_flight.empty())
+      break;
+    uint64_t offset = in_flight.front() * chunk_size;
+    uint64_t length = min(chunk_size, state->size - offset);
+    ObjectChunkResponse response;
+    // The chunk lands directly in the object's shared memory segment.
+    if (!RecvFully(fd, &response, sizeof(response)) ||
+        static_cast<int64_t>(be64toh(response.length)) !=
+        static_cast<int64_t>(length) ||
+        !RecvFully(fd, state->data + offset, length)) {
+      failed = true;
+      break;
+    }
+    in_flight.pop_front();
+    boost::lock_guard<boost::mutex> lock(state->lock);
+    state->num_chunks_done++;
+  }
+  close(fd);
+  if (failed) {
+    LOG(WARNING) << "Fetching object " << state->id << " from " << endpoint
+                 << " failed; " << in_flight.size() << " chunks will be "
+                 << "fetched from other replicas.";
+    boost::lock_guard<boost::mutex> lock(state->lock);
+    state->pending_chunks.insert(state->pending_chunks.end(),
+                                 in_flight.begin(), in_flight.end());
+    return false;
+  }
+  return true;
+}
+
+void ObjectFetcher::FinishFetch(shared_ptr<FetchState> state) {
+  bool success = state->num_chunks_done == state->num_chunks;
+  if (success) {
+    success = store_.PutObjectEnd(state->id, state->size);
+  } else {
+    LOG(ERROR) << "Failed to fetch object " << state->id << " from any of "
+               << "its replicas";
+    store_.PutObjectAbort(state->id);
+  }
+  if (state->callback)
+    state->callback(state->id, success);
+  {
+    boost::lock_guard<boost::mutex> lock(state->lock);
+    state->finished = true;
+    state->succeeded = success;
+    state->finished_cond.notify_all();
+  }
+  boost::lock_guard<boost::mutex> lock(active_lock_);
+  num_active_fetches_--;
+  fetch_finished_.notify_all();
+}
+
+void ObjectFetcher::RunReplica(shared_ptr<FetchState> state,
+                               string endpoint) {
+  bool success = FetchChunksFromReplica(state.get(), endpoint);
+  vector<string> next_round;
+  {
+    boost::lock_guard<boost::mutex> lock(state->lock);
+    if (success)
+      state->live_replicas.push_back(endpoint);
+    if (--state->num_running_replicas > 0)
+      return;
+    // The last connection of the round decides how to go on. Chunks that
+    // failed replicas gave back go to the replicas that are still live.
+    if (state->num_chunks_done < state->num_chunks)
+      next_round.swap(state->live_replicas);
+  }
+  if (next_round.empty())
+    FinishFetch(state);
+  else
+    StartRound(state, next_round);
+}
+
+shared_ptr<ObjectFetcher::FetchState> ObjectFetcher::StartFetch(
+    const DataObjectID_t& id, uint64_t size, const vector<string>& replicas,
+    FetchCallback callback) {
+  if (replicas.empty())
+    return shared_ptr<FetchState>();
+  uint8_t* data = static_cast<uint8_t*>(store_.PutObjectStart(id, size));
+  if (!data)
+    return shared_ptr<FetchState>();
+  shared_ptr<FetchState> state(new FetchState(id, data, size, callback));
+  uint64_t chunk_size = max<uint64_t>(FLAGS_object_transfer_chunk_size, 1);
+  state->num_chunks = (size + chunk_size - 1) / chunk_size;
+  for (uint64_t i = 0; i < state->num_chunks; ++i)
+    state->pending_chunks.push_back(i);
+  VLOG(1) << "Fetching object " << id << " (" << size << " bytes, "
+          << state->num_chunks << " chunks) from " << replicas.size()
+          << " replicas";
+  {
+    boost::lock_guard<boost::mutex> lock(active_lock_);
+    num_active_fetches_++;
+  }
+  StartRound(state, replicas);
+  return state;
+}
+
+void ObjectFetcher::StartRound(shared_ptr<FetchState> state,
+                               const vector<string>& replicas) {
+  // All live replicas serve chunks in parallel. A replica that fails drops
+  // out, and the chunks it had claimed go to the remaining ones.
+  {
+    boost::lock_guard<boost::mutex> lock(state->lock);
+    state->num_running_replicas = replicas.size();
+  }
+  for (vector<string>::const_iterator it = replicas.begin();
+       it != replicas.end();
+       ++it) {
+    executor_.Submit(boost::bind(&ObjectFetcher::RunReplica, this, state,
+                                 *it));
+  }
+}
+
+}  // namespace store
+}  // namespace firmament
@@ -0,0 +1,135 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Fetches objects from the object transfer servers of other machines into the
+// local shared memory object store. Objects are split into chunks, which are
+// requested in a pipeline over one connection per replica, with all replicas
+// holding a copy serving chunks in parallel. Connections run on a fixed pool
+// of --object_transfer_fetch_threads threads.
+
+#ifndef FIRMAMENT_STORAGE_OBJECT_FETCHER_H
+#define FIRMAMENT_STORAGE_OBJECT_FETCHER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "misc/work_stealing_executor.h"
+#include "storage/object_transfer_protocol.h"
+#include "storage/shm_object_store.h"
+
+namespace firmament {
+namespace store {
+
+class ObjectFetcher {
+ public:
+  typedef boost::function<void(const DataObjectID_t&, bool)> FetchCallback;
+
+  /**
+   * @param uuid the resource ID on whose behalf objects are fetched
+   * @param store_dir the directory of the object store to fetch into
+   */
+  ObjectFetcher(ResourceID_t uuid, const string& store_dir);
+  explicit ObjectFetcher(ResourceID_t uuid);
+  /**
+   * Waits for outstanding asynchronous fetches to finish.
+   */
+  ~ObjectFetcher();
+
+  /**
+   * Fetches an object into the local store. The object's segment is
+   * created before the call returns, so that local consumers can wait for
+   * it with ShmObjectStore::WaitForObject() while the transfer runs.
+   * @param id the object's name
+   * @param size the object's size in bytes
+   * @param replicas the endpoints of transfer servers holding the object;
+   * replicas that stall for --object_transfer_timeout_ms are given up on
+   * @param callback if not NULL, invoked with the outcome once the fetch
+   * finishes
+   * @return false if the fetch could not be started; this includes the
+   * object already being present or in flight locally
+   */
+  bool FetchAsync(const DataObjectID_t& id, uint64_t size,
+                  const vector<string>& replicas, FetchCallback callback);
+  /**
+   * Synchronous version of FetchAsync().
+   * @return true if the object was fetched and sealed in the local store
+   */
+  bool Fetch(const DataObjectID_t& id, uint64_t size,
+             const vector<string>& replicas);
+  /**
+   * @return the number of fetches in flight
+   */
+  uint64_t NumActiveFetches();
+
+ private:
+  struct FetchState {
+    FetchState(const DataObjectID_t& object_id, uint8_t* object_data,
+               uint64_t object_size, FetchCallback fetch_callback)
+      : id(object_id), data(object_data), size(object_size), num_chunks(0),
+        callback(fetch_callback), num_chunks_done(0),
+        num_running_replicas(0), finished(false), succeeded(false) {}
+    DataObjectID_t id;
+    uint8_t* data;
+    uint64_t size;
+    uint64_t num_chunks;
+    FetchCallback callback;
+    boost::mutex lock;
+    // Indices of the chunks that no replica is working on yet.
+    deque<uint64_t> pending_chunks;
+    uint64_t num_chunks_done;
+    // Connections of the current round that are still running, and the
+    // replicas whose connection in this round did not fail.
+    uint64_t num_running_replicas;
+    vector<string> live_replicas;
+    bool finished;
+    bool succeeded;
+    boost::condition_variable finished_cond;
+  };
+
+  int ConnectToReplica(const string& endpoint);
+  bool FetchChunksFromReplica(FetchState* state, const string& endpoint);
+  void FinishFetch(shared_ptr<FetchState> state);
+  void RunReplica(shared_ptr<FetchState> state, string endpoint);
+  shared_ptr<FetchState> StartFetch(const DataObjectID_t& id, uint64_t size,
+                                    const vector<string>& replicas,
+                                    FetchCallback callback);
+  void StartRound(shared_ptr<FetchState> state,
+                  const vector<string>& replicas);
+
+  ShmObjectStore store_;
+  boost::mutex active_lock_;
+  boost::condition_variable fetch_finished_;
+  uint64_t num_active_fetches_;
+  // Runs the replica connections of all fetches, so that the number of
+  // threads stays bounded no matter how many fetches are in flight.
+  WorkStealingExecutor executor_;
+};
+
+}  // namespace store
+}  // namespace firmament
+
+#endif  // FIRMAMENT_STORAGE_OBJECT_FETCHER_H
@@ -0,0 +1,86 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Wire format of the object transfer service. A client sends a sequence of
+// chunk requests over a TCP connection, without waiting for the responses in
+// between; the server answers them in order, each with a response header
+// followed by the chunk's bytes. All integers are big-endian.
+
+#ifndef FIRMAMENT_STORAGE_OBJECT_TRANSFER_PROTOCOL_H
+#define FIRMAMENT_STORAGE_OBJECT_TRANSFER_PROTOCOL_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "base/data_object.h"
+
+namespace firmament {
+namespace store {
+
+struct ObjectChunkRequest {
+  uint8_t name[DIOS_NAME_BYTES];
+  uint64_t offset;
+  uint64_t length;
+} __attribute__((packed));
+
+struct ObjectChunkResponse {
+  // Number of bytes that follow, or kObjectChunkMissing if the server does
+  // not hold the object or the range lies outside it.
+  int64_t length;
+} __attribute__((packed));
+
+static const int64_t kObjectChunkMissing = -1;
+
+// Sends or receives exactly len bytes, retrying after partial transfers and
+// interruptions. Returns false if the connection fails, is closed, or hits
+// the socket's send or receive timeout.
+inline bool SendFully(int fd, const void* buf, size_t len) {
+  const uint8_t* pos = static_cast<const uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t sent = send(fd, pos, len, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+    pos += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+inline bool RecvFully(int fd, void* buf, size_t len) {
+  uint8_t* pos = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    ssize_t received = recv(fd, pos, len, 0);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      return false;
+    pos += received;
+    len -= received;
+  }
+  return true;
+}
+
+}  // namespace store
+}  // namespace firmament
+
+#endif  // FIRMAMENT_STORAGE_OBJECT_TRANSFER_PROTOCOL_H
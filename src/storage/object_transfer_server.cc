@@ -0,0 +1,253 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Object transfer server implementation.
+
+#include "storage/object_transfer_server.h"
+
+#include <endian.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/asio/ip/host_name.hpp>
+#include <boost/bind.hpp>
+
+DEFINE_bool(object_transfer_server, false,
+            "Serve objects from the local object store to other machines. "
+            "The server does not authenticate its clients, so only enable "
+            "it on trusted networks.");
+DEFINE_uint64(object_transfer_port, 0,
+              "TCP port on which to serve objects from the local object "
+              "store to other machines. 0 picks an unused port.");
+DEFINE_uint64(object_transfer_max_connections, 64,
+              "Maximum number of object transfer connections served at "
+              "once. Further connections wait until one closes.");
+DEFINE_uint64(object_transfer_idle_timeout_ms, 30000,
+              "Time after which an object transfer connection is closed if "
+              "its client neither sends requests nor reads responses.");
+
+DECLARE_string(object_store_dir);
+
+namespace firmament {
+namespace store {
+
+ObjectTransferServer::ObjectTransferServer(ResourceID_t uuid)
+  : ObjectTransferServer(uuid, FLAGS_object_store_dir) {
+}
+
+ObjectTransferServer::ObjectTransferServer(ResourceID_t uuid,
+                                           const string& store_dir)
+  : store_(uuid, store_dir), listen_fd_(-1), port_(0), idle_timeout_ms_(0),
+    stop_(false), accept_thread_(NULL) {
+}
+
+ObjectTransferServer::~ObjectTransferServer() {
+  Stop();
+}
+
+bool ObjectTransferServer::Start(uint16_t port) {
+  CHECK(!accept_thread_);
+  // Prefer a dual-stack socket, but hosts without IPv6 support only offer
+  // AF_INET.
+  listen_fd_ = Listen(AF_INET6, port);
+  if (listen_fd_ < 0 && errno == EAFNOSUPPORT)
+    listen_fd_ = Listen(AF_INET, port);
+  if (listen_fd_ < 0) {
+    PLOG(ERROR) << "Failed to listen for object transfers on port " << port;
+    return false;
+  }
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&addr),
+                  &addr_len) != 0) {
+    PLOG(ERROR) << "Failed to get the object transfer server address";
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  if (addr.ss_family == AF_INET6)
+    port_ = ntohs(reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_port);
+  else
+    port_ = ntohs(reinterpret_cast<struct sockaddr_in*>(&addr)->sin_port);
+  idle_timeout_ms_ = FLAGS_object_transfer_idle_timeout_ms;
+  stop_ = false;
+  accept_thread_ = new boost::thread(
+      boost::bind(&ObjectTransferServer::AcceptConnections, this));
+  LOG(INFO) << "Object transfer server listening at " << endpoint();
+  return true;
+}
+
+int ObjectTransferServer::Listen(int family, uint16_t port) {
+  int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  memset(&addr, 0, sizeof(addr));
+  if (family == AF_INET6) {
+    struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(&addr);
+    addr6->sin6_family = AF_INET6;
+    addr6->sin6_addr = in6addr_any;
+    addr6->sin6_port = htons(port);
+    addr_len = sizeof(*addr6);
+  } else {
+    struct sockaddr_in* addr4 = reinterpret_cast<struct sockaddr_in*>(&addr);
+    addr4->sin_family = AF_INET;
+    addr4->sin_addr.s_addr = htonl(INADDR_ANY);
+    addr4->sin_port = htons(port);
+    addr_len = sizeof(*addr4);
+  }
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), addr_len) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+void ObjectTransferServer::Stop() {
+  if (!accept_thread_)
+    return;
+  stop_ = true;
+  {
+    // Wakes up the accept thread if it waits for a connection to close.
+    boost::lock_guard<boost::mutex> lock(connections_lock_);
+    connection_closed_.notify_all();
+  }
+  // Wakes up the accept() and recv() calls of the server threads.
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_->join();
+  delete accept_thread_;
+  accept_thread_ = NULL;
+  {
+    boost::unique_lock<boost::mutex> lock(connections_lock_);
+    for (auto& fd : connection_fds_)
+      shutdown(fd, SHUT_RDWR);
+    while (!connection_fds_.empty())
+      connection_closed_.wait(lock);
+  }
+  close(listen_fd_);
+  listen_fd_ = -1;
+}
+
+string ObjectTransferServer::endpoint() const {
+  if (!accept_thread_)
+    return "";
+  return "tcp:" + boost::asio::ip::host_name() + ":" + to_string(port_);
+}
+
+void ObjectTransferServer::AcceptConnections() {
+  struct timeval idle_timeout;
+  idle_timeout.tv_sec = idle_timeout_ms_ / 1000;
+  idle_timeout.tv_usec = (idle_timeout_ms_ % 1000) * 1000;
+  while (!stop_) {
+    {
+      // Leaves further clients in the listen backlog until a connection
+      // thread finishes.
+      boost::unique_lock<boost::mutex> lock(connections_lock_);
+      while (!stop_ &&
+             connection_fds_.size() >= FLAGS_object_transfer_max_connections)
+        connection_closed_.wait(lock);
+    }
+    if (stop_)
+      break;
+    int fd = accept4(listen_fd_, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (!stop_)
+        PLOG(ERROR) << "Failed to accept object transfer connection";
+      break;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // Idle or stalled clients would otherwise hold a connection slot, and
+    // their object's reference, forever.
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle_timeout,
+               sizeof(idle_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &idle_timeout,
+               sizeof(idle_timeout));
+    {
+      boost::lock_guard<boost::mutex> lock(connections_lock_);
+      connection_fds_.insert(fd);
+    }
+    boost::thread connection_thread(
+        boost::bind(&ObjectTransferServer::ServeConnection, this, fd));
+    connection_thread.detach();
+  }
+}
+
+void ObjectTransferServer::ServeConnection(int fd) {
+  // Fetchers request the chunks of an object back to back, so the most
+  // recently requested object stays mapped (and referenced, so that it
+  // cannot be removed mid-transfer).
+  scoped_ptr<DataObjectID_t> current_id;
+  const uint8_t* data = NULL;
+  size_t size = 0;
+  ObjectChunkRequest request;
+  while (!stop_ && RecvFully(fd, &request, sizeof(request))) {
+    DataObjectID_t id(request.name);
+    if (!current_id || !(*current_id == id)) {
+      if (current_id)
+        store_.GetObjectEnd(*current_id);
+      data = static_cast<const uint8_t*>(store_.GetObjectStart(id, &size));
+      current_id.reset(data ? new DataObjectID_t(id) : NULL);
+    }
+    if (!SendChunk(fd, request, id, data, size))
+      break;
+  }
+  if (current_id)
+    store_.GetObjectEnd(*current_id);
+  boost::lock_guard<boost::mutex> lock(connections_lock_);
+  connection_fds_.erase(fd);
+  close(fd);
+  connection_closed_.notify_all();
+}
+
+bool ObjectTransferServer::SendChunk(int fd,
+                                     const ObjectChunkRequest& request,
+                                     const DataObjectID_t& id,
+                                     const uint8_t* data, uint64_t size) {
+  uint64_t offset = be64toh(request.offset);
+  uint64_t length = be64toh(request.length);
+  ObjectChunkResponse response;
+  if (!data || offset > size || length > size - offset) {
+    VLOG(1) << "Cannot serve bytes " << offset << "+" << length
+            << " of object " << id;
+    response.length = htobe64(kObjectChunkMissing);
+    return SendFully(fd, &response, sizeof(response));
+  }
+  response.length = htobe64(length);
+  // Sending straight from the shared mapping costs the same single copy
+  // into the socket buffer as sendfile(2) would, and also works for
+  // segments on hugetlbfs, which does not support sendfile.
+  return SendFully(fd, &response, sizeof(response)) &&
+    SendFully(fd, data + offset, length);
+}
+
+}  // namespace store
+}  // namespace firmament
@@ -0,0 +1,96 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Serves objects held in the local shared memory object store to the object
+// fetchers of other machines.
+
+#ifndef FIRMAMENT_STORAGE_OBJECT_TRANSFER_SERVER_H
+#define FIRMAMENT_STORAGE_OBJECT_TRANSFER_SERVER_H
+
+#include <string>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "storage/object_transfer_protocol.h"
+#include "storage/shm_object_store.h"
+
+namespace firmament {
+namespace store {
+
+class ObjectTransferServer {
+ public:
+  /**
+   * @param uuid the resource ID of the coordinator running the server
+   * @param store_dir the directory of the object store to serve
+   */
+  ObjectTransferServer(ResourceID_t uuid, const string& store_dir);
+  explicit ObjectTransferServer(ResourceID_t uuid);
+  ~ObjectTransferServer();
+
+  /**
+   * Starts listening and serving connections on a background thread. At
+   * most --object_transfer_max_connections are served at once.
+   * @param port the TCP port to listen on; 0 picks an unused port
+   * @return true if the server is listening
+   */
+  bool Start(uint16_t port);
+  /**
+   * Stops accepting connections and closes the open ones.
+   */
+  void Stop();
+  /**
+   * @return the endpoint ("tcp:<host>:<port>") that fetchers should use, or
+   * an empty string if the server is not running
+   */
+  string endpoint() const;
+
+ private:
+  // Returns a listening socket of the given address family bound to the
+  // wildcard address, or -1 with errno set.
+  static int Listen(int family, uint16_t port);
+  void AcceptConnections();
+  void ServeConnection(int fd);
+  bool SendChunk(int fd, const ObjectChunkRequest& request,
+                 const DataObjectID_t& id, const uint8_t* data,
+                 uint64_t size);
+
+  ShmObjectStore store_;
+  int listen_fd_;
+  uint16_t port_;
+  // --object_transfer_idle_timeout_ms when the server was started.
+  uint64_t idle_timeout_ms_;
+  volatile bool stop_;
+  boost::thread* accept_thread_;
+  // Connections are served on detached threads, which remove their socket
+  // from connection_fds_ when they finish. The accept thread and Stop()
+  // wait on connection_closed_ for them.
+  boost::mutex connections_lock_;
+  boost::condition_variable connection_closed_;
+  unordered_set<int> connection_fds_;
+};
+
+}  // namespace store
+}  // namespace firmament
+
+#endif  // FIRMAMENT_STORAGE_OBJECT_TRANSFER_SERVER_H
@@ -0,0 +1,252 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Object transfer server and fetcher unit tests.
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/common.h"
+#include "misc/utils.h"
+#include "storage/object_fetcher.h"
+#include "storage/object_transfer_server.h"
+#include "storage/shm_object_store.h"
+
+DECLARE_uint64(object_transfer_chunk_size);
+DECLARE_uint64(object_transfer_fetch_threads);
+DECLARE_uint64(object_transfer_idle_timeout_ms);
+DECLARE_uint64(object_transfer_max_connections);
+DECLARE_uint64(object_transfer_timeout_ms);
+
+namespace firmament {
+namespace store {
+
+class ObjectTransferTest : public ::testing::Test {
+ protected:
+  ObjectTransferTest()
+    : id_(string(DIOS_NAME_BYTES * 2, 'b'), true) {
+  }
+
+  virtual void SetUp() {
+    for (uint32_t i = 0; i < 3; ++i) {
+      string dir = MakeTemporaryDirectory("firmament-transfer-test");
+      ASSERT_FALSE(dir.empty());
+      dirs_.push_back(dir);
+    }
+    // Small chunks, so that objects span many pipelined requests.
+    FLAGS_object_transfer_chunk_size = 4096;
+  }
+
+  virtual void TearDown() {
+    for (auto& dir : dirs_)
+      EXPECT_TRUE(RemoveDirectoryRecursively(dir));
+  }
+
+  // Puts the test object, filled with a byte pattern, into a store.
+  void PutTestObject(const string& dir, uint64_t size) {
+    ShmObjectStore store(GenerateResourceID(), dir);
+    uint8_t* data = static_cast<uint8_t*>(store.PutObjectStart(id_, size));
+    ASSERT_TRUE(data != NULL);
+    for (uint64_t i = 0; i < size; ++i)
+      data[i] = i % 251;
+    ASSERT_TRUE(store.PutObjectEnd(id_, size));
+  }
+
+  bool HasTestObject(const string& dir, uint64_t size) {
+    ShmObjectStore store(GenerateResourceID(), dir);
+    size_t stored_size = 0;
+    const uint8_t* data =
+      static_cast<const uint8_t*>(store.GetObjectStart(id_, &stored_size));
+    if (!data)
+      return false;
+    bool intact = (stored_size == size);
+    for (uint64_t i = 0; intact && i < size; ++i)
+      intact = (data[i] == i % 251);
+    store.GetObjectEnd(id_);
+    return intact;
+  }
+
+  uint16_t ServerPort(const ObjectTransferServer& server) {
+    string endpoint = server.endpoint();
+    return atoi(endpoint.substr(endpoint.rfind(':') + 1).c_str());
+  }
+
+  DataObjectID_t id_;
+  vector<string> dirs_;
+};
+
+// An object held by two machines is fetched from both of them.
+TEST_F(ObjectTransferTest, FetchFromReplicas) {
+  uint64_t size = 1024 * 1024 + 17;
+  PutTestObject(dirs_[0], size);
+  PutTestObject(dirs_[1], size);
+  ObjectTransferServer server0(GenerateResourceID(), dirs_[0]);
+  ObjectTransferServer server1(GenerateResourceID(), dirs_[1]);
+  ASSERT_TRUE(server0.Start(0));
+  ASSERT_TRUE(server1.Start(0));
+  vector<string> replicas;
+  replicas.push_back(server0.endpoint());
+  replicas.push_back(server1.endpoint());
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  EXPECT_TRUE(fetcher.Fetch(id_, size, replicas));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+  // The object is now present locally, so it is not fetched again.
+  EXPECT_FALSE(fetcher.Fetch(id_, size, replicas));
+}
+
+// Replicas that fail are skipped, and the fetch fails cleanly if no replica
+// has the object.
+TEST_F(ObjectTransferTest, FailingReplicas) {
+  uint64_t size = 100 * 1024;
+  PutTestObject(dirs_[0], size);
+  ObjectTransferServer server0(GenerateResourceID(), dirs_[0]);
+  ObjectTransferServer server1(GenerateResourceID(), dirs_[1]);
+  ASSERT_TRUE(server0.Start(0));
+  ASSERT_TRUE(server1.Start(0));
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  vector<string> replicas;
+  replicas.push_back(server1.endpoint());
+  EXPECT_FALSE(fetcher.Fetch(id_, size, replicas));
+  ShmObjectStore store(GenerateResourceID(), dirs_[2]);
+  EXPECT_FALSE(store.HasObject(id_));
+  replicas.push_back(server0.endpoint());
+  EXPECT_TRUE(fetcher.Fetch(id_, size, replicas));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+}
+
+// A replica that accepts connections but never answers is given up on, and
+// the object's segment is discarded so that a later fetch can create it.
+TEST_F(ObjectTransferTest, StalledReplica) {
+  uint64_t size = 64 * 1024;
+  PutTestObject(dirs_[0], size);
+  ObjectTransferServer server(GenerateResourceID(), dirs_[0]);
+  ASSERT_TRUE(server.Start(0));
+  // The kernel completes connections to a listening socket, but nothing
+  // ever reads the requests.
+  int stalled_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(stalled_fd, 0);
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, bind(stalled_fd, reinterpret_cast<struct sockaddr*>(&addr),
+                    sizeof(addr)));
+  ASSERT_EQ(0, listen(stalled_fd, 16));
+  ASSERT_EQ(0, getsockname(stalled_fd,
+                           reinterpret_cast<struct sockaddr*>(&addr),
+                           &addr_len));
+  string stalled_endpoint = "tcp:localhost:" + to_string(ntohs(addr.sin6_port));
+  FLAGS_object_transfer_timeout_ms = 200;
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  vector<string> replicas;
+  replicas.push_back(stalled_endpoint);
+  EXPECT_FALSE(fetcher.Fetch(id_, size, replicas));
+  ShmObjectStore store(GenerateResourceID(), dirs_[2]);
+  EXPECT_FALSE(store.HasObject(id_));
+  // The stalled replica's chunks go to the live one.
+  replicas.push_back(server.endpoint());
+  EXPECT_TRUE(fetcher.Fetch(id_, size, replicas));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+  FLAGS_object_transfer_timeout_ms = 10000;
+  close(stalled_fd);
+}
+
+// A client that connects but sends nothing is disconnected once idle, and
+// frees its connection slot for others.
+TEST_F(ObjectTransferTest, IdleConnectionLimit) {
+  uint64_t size = 64 * 1024;
+  PutTestObject(dirs_[0], size);
+  FLAGS_object_transfer_idle_timeout_ms = 200;
+  FLAGS_object_transfer_max_connections = 1;
+  ObjectTransferServer server(GenerateResourceID(), dirs_[0]);
+  ASSERT_TRUE(server.Start(0));
+  FLAGS_object_transfer_idle_timeout_ms = 30000;
+  int idle_fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(idle_fd, 0);
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_loopback;
+  addr.sin6_port = htons(ServerPort(server));
+  ASSERT_EQ(0, connect(idle_fd, reinterpret_cast<struct sockaddr*>(&addr),
+                       sizeof(addr)));
+  // The fetch waits for the idle connection's slot.
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  vector<string> replicas;
+  replicas.push_back(server.endpoint());
+  EXPECT_TRUE(fetcher.Fetch(id_, size, replicas));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+  char byte;
+  EXPECT_EQ(0, recv(idle_fd, &byte, 1, 0));
+  close(idle_fd);
+  FLAGS_object_transfer_max_connections = 64;
+}
+
+// Consumers can wait for an object while it is being fetched.
+TEST_F(ObjectTransferTest, AsyncFetch) {
+  uint64_t size = 512 * 1024;
+  PutTestObject(dirs_[0], size);
+  ObjectTransferServer server(GenerateResourceID(), dirs_[0]);
+  ASSERT_TRUE(server.Start(0));
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  vector<string> replicas;
+  replicas.push_back(server.endpoint());
+  ASSERT_TRUE(fetcher.FetchAsync(id_, size, replicas,
+                                 ObjectFetcher::FetchCallback()));
+  ShmObjectStore consumer(GenerateResourceID(), dirs_[2]);
+  EXPECT_TRUE(consumer.WaitForObject(id_, 10 * 1000 * 1000));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+}
+
+// Replica connections queue up for the fetch threads rather than each
+// getting a thread of their own, and a failed replica's chunks still move
+// to the other replica.
+TEST_F(ObjectTransferTest, FetchOnSingleThread) {
+  uint64_t size = 256 * 1024;
+  PutTestObject(dirs_[0], size);
+  ObjectTransferServer server0(GenerateResourceID(), dirs_[0]);
+  ObjectTransferServer server1(GenerateResourceID(), dirs_[1]);
+  ASSERT_TRUE(server0.Start(0));
+  ASSERT_TRUE(server1.Start(0));
+  vector<string> replicas;
+  replicas.push_back(server1.endpoint());
+  replicas.push_back(server0.endpoint());
+  FLAGS_object_transfer_fetch_threads = 1;
+  ObjectFetcher fetcher(GenerateResourceID(), dirs_[2]);
+  FLAGS_object_transfer_fetch_threads = 8;
+  EXPECT_TRUE(fetcher.Fetch(id_, size, replicas));
+  EXPECT_TRUE(HasTestObject(dirs_[2], size));
+  EXPECT_EQ(0U, fetcher.NumActiveFetches());
+}
+
+}  // namespace store
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,688 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Shared memory object store implementation.
+
+#include "storage/shm_object_store.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include "misc/utils.h"
+
+DEFINE_string(object_store_dir, "/dev/shm/firmament-objects",
+              "Directory holding the segments of the shared memory object "
+              "store. Point this at a hugetlbfs mount to back objects with "
+              "huge pages.");
+DEFINE_bool(object_store_huge_pages, true,
+            "Ask for transparent huge pages on object store mappings that "
+            "are not on hugetlbfs.");
+DEFINE_uint64(object_store_capacity_mb, 4096,
+              "Space the shared memory object store may use. Once new "
+              "objects exceed it, unreferenced objects are evicted in the "
+              "background, least recently used first. 0 disables eviction.");
+
+namespace firmament {
+namespace store {
+
+static const uint64_t kSegmentMagic = 0x4649524d4f424a32ULL;  // "FIRMOBJ2"
+static const char kLocationPrefix[] = "shm://";
+static const char kUsageFile[] = ".usage";
+
+const uint32_t ShmObjectStore::kMaxHolders;
+
+static uint64_t MonotonicTimeUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Returns the start time of a process in clock ticks since boot, or 0 if
+// it cannot be read.
+static uint64_t ProcessStartTime(pid_t pid) {
+  ifstream stat_file(("/proc/" + to_string(pid) + "/stat").c_str());
+  string stat;
+  if (!getline(stat_file, stat))
+    return 0;
+  // The command name may contain spaces, so count fields from its end.
+  size_t pos = stat.rfind(')');
+  if (pos == string::npos)
+    return 0;
+  // The start time is the 20th field after the command name.
+  for (uint32_t field = 0; field < 20 && pos != string::npos; ++field)
+    pos = stat.find(' ', pos + 1);
+  if (pos == string::npos)
+    return 0;
+  return strtoull(stat.c_str() + pos + 1, NULL, 10);
+}
+
+static uint64_t HolderForProcess(pid_t pid, uint64_t start_time) {
+  return (start_time << 32) | static_cast<uint32_t>(pid);
+}
+
+static uint64_t SelfHolder() {
+  // Recomputed in forked children, whose PID differs.
+  static std::atomic<uint64_t> self_holder(0);
+  pid_t self = getpid();
+  uint64_t holder = self_holder.load();
+  if (static_cast<pid_t>(holder & 0xffffffffULL) != self) {
+    holder = HolderForProcess(self, ProcessStartTime(self));
+    self_holder.store(holder);
+  }
+  return holder;
+}
+
+static bool HolderAlive(uint64_t holder) {
+  pid_t pid = static_cast<pid_t>(holder & 0xffffffffULL);
+  if (kill(pid, 0) != 0 && errno != EPERM)
+    return false;
+  // A different process may have been given the holder's PID since.
+  uint64_t start_time = ProcessStartTime(pid);
+  return start_time == 0 || HolderForProcess(pid, start_time) == holder;
+}
+
+ShmObjectStore::ShmObjectStore(ResourceID_t uuid)
+  : ShmObjectStore(uuid, FLAGS_object_store_dir) {
+}
+
+ShmObjectStore::ShmObjectStore(ResourceID_t uuid, const string& dir)
+  : ObjectStoreInterface(), dir_(dir), page_size_(getpagesize()),
+    hugetlbfs_(false),
+    capacity_bytes_(FLAGS_object_store_capacity_mb * 1024 * 1024),
+    usage_(NULL), evict_thread_(NULL), evict_pending_(false),
+    evict_running_(false), evict_stop_(false) {
+  VLOG(2) << "Constructing shared memory object store in " << dir_;
+  this->uuid = uuid;
+  object_table_.reset(new DataObjectMap_t);
+  CHECK_LE(sizeof(SegmentHeader), page_size_);
+  if (mkdir(dir_.c_str(), 0770) != 0 && errno != EEXIST) {
+    PLOG(ERROR) << "Failed to create object store directory " << dir_;
+  }
+  struct statfs fs;
+  if (statfs(dir_.c_str(), &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC) {
+    hugetlbfs_ = true;
+    page_size_ = fs.f_bsize;
+  }
+  if (capacity_bytes_ > 0)
+    MapUsage();
+}
+
+ShmObjectStore::~ShmObjectStore() {
+  VLOG(2) << "Destroying shared memory object store";
+  if (evict_thread_) {
+    {
+      boost::lock_guard<boost::mutex> lock(evict_lock_);
+      evict_stop_ = true;
+      evict_cond_.notify_all();
+    }
+    evict_thread_->join();
+    delete evict_thread_;
+  }
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  for (auto& object : mapped_) {
+    if (object.second.writable) {
+      // Never sealed, so no consumer can hold it.
+      if (unlink(PathForObject(object.first).c_str()) == 0)
+        AddUsage(-static_cast<int64_t>(object.second.length));
+    } else {
+      RemoveHolder(Header(object.second));
+    }
+    munmap(object.second.base, object.second.length);
+  }
+  mapped_.clear();
+  if (usage_)
+    munmap(usage_, page_size_);
+  object_table_.reset();
+}
+
+bool ShmObjectStore::AddHolder(SegmentHeader* header) {
+  uint64_t self = SelfHolder();
+  for (uint32_t i = 0; i < kMaxHolders; ++i) {
+    if (__sync_bool_compare_and_swap(&header->holders[i], 0, self))
+      return true;
+  }
+  // All slots are taken; free those of processes that died without
+  // releasing them, and take the first.
+  bool added = false;
+  for (uint32_t i = 0; i < kMaxHolders; ++i) {
+    uint64_t holder = header->holders[i];
+    if (holder == 0 || HolderAlive(holder))
+      continue;
+    if (__sync_bool_compare_and_swap(&header->holders[i], holder,
+                                     added ? 0 : self))
+      added = true;
+  }
+  return added;
+}
+
+void ShmObjectStore::RemoveHolder(SegmentHeader* header) {
+  uint64_t self = SelfHolder();
+  for (uint32_t i = 0; i < kMaxHolders; ++i) {
+    if (header->holders[i] == self &&
+        __sync_bool_compare_and_swap(&header->holders[i], self, 0))
+      return;
+  }
+  LOG(ERROR) << "Process " << getpid() << " holds no reference to the "
+             << "object";
+}
+
+uint64_t ShmObjectStore::NumLiveHolders(const SegmentHeader& header) {
+  uint64_t holders = 0;
+  for (uint32_t i = 0; i < kMaxHolders; ++i) {
+    if (header.holders[i] != 0 && HolderAlive(header.holders[i]))
+      holders++;
+  }
+  return holders;
+}
+
+void ShmObjectStore::AddUsage(int64_t delta) {
+  if (!usage_)
+    return;
+  uint64_t used_bytes = __sync_add_and_fetch(&usage_->used_bytes, delta);
+  if (delta <= 0 || used_bytes <= capacity_bytes_)
+    return;
+  // Scanning the segments takes a few syscalls per object, so the writer
+  // does not wait for it.
+  boost::lock_guard<boost::mutex> lock(evict_lock_);
+  evict_pending_ = true;
+  if (!evict_thread_) {
+    evict_thread_ =
+      new boost::thread(boost::bind(&ShmObjectStore::EvictionLoop, this));
+  }
+  evict_cond_.notify_all();
+}
+
+void ShmObjectStore::EvictionLoop() {
+  boost::unique_lock<boost::mutex> lock(evict_lock_);
+  while (true) {
+    while (!evict_pending_ && !evict_stop_)
+      evict_cond_.wait(lock);
+    if (evict_stop_)
+      break;
+    evict_pending_ = false;
+    evict_running_ = true;
+    lock.unlock();
+    EvictObjects();
+    lock.lock();
+    evict_running_ = false;
+    evict_cond_.notify_all();
+  }
+}
+
+void ShmObjectStore::EvictObjects() {
+  // (last use, (path, length)) of each object that nobody references.
+  vector<pair<uint64_t, pair<string, uint64_t> > > unreferenced;
+  uint64_t used_bytes = ScanSegments(&unreferenced);
+  if (used_bytes <= capacity_bytes_)
+    return;
+  sort(unreferenced.begin(), unreferenced.end());
+  for (auto& object : unreferenced) {
+    if (used_bytes <= capacity_bytes_)
+      break;
+    VLOG(1) << "Evicting object segment " << object.second.first;
+    // A consumer that maps the object concurrently keeps its pages.
+    if (unlink(object.second.first.c_str()) == 0) {
+      used_bytes -= object.second.second;
+      AddUsage(-static_cast<int64_t>(object.second.second));
+    }
+  }
+  if (used_bytes > capacity_bytes_) {
+    LOG(WARNING) << "Object store in " << dir_ << " holds " << used_bytes
+                 << " bytes of referenced objects, more than its capacity of "
+                 << capacity_bytes_ << " bytes";
+  }
+}
+
+void ShmObjectStore::MapUsage() {
+  string path = dir_ + "/" + kUsageFile;
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+  bool created = (fd >= 0);
+  if (fd < 0 && errno == EEXIST)
+    fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  // Every instance sizes the file, so that none maps it while it is empty.
+  void* addr = MAP_FAILED;
+  if (fd >= 0 && ftruncate(fd, page_size_) == 0) {
+    addr = mmap(NULL, page_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (fd >= 0)
+    close(fd);
+  if (addr == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map object store usage file " << path
+                << "; objects will not be evicted";
+    return;
+  }
+  usage_ = static_cast<UsageHeader*>(addr);
+  if (created) {
+    // Account for the segments already in the directory.
+    ScanSegments(NULL);
+  }
+}
+
+uint64_t ShmObjectStore::ScanSegments(
+    vector<pair<uint64_t, pair<string, uint64_t> > >* unreferenced) {
+  uint64_t recorded_bytes = usage_->used_bytes;
+  DIR* dir = opendir(dir_.c_str());
+  if (!dir) {
+    PLOG(ERROR) << "Failed to list object store directory " << dir_;
+    return recorded_bytes;
+  }
+  uint64_t used_bytes = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+    string path = dir_ + "/" + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    used_bytes += st.st_size;
+    if (!unreferenced)
+      continue;
+    SegmentHeader header;
+    // Segments whose writer has not initialized the header yet are skipped;
+    // those whose writer died before sealing them have no live holders.
+    if (PeekHeader(path, &header) && header.magic == kSegmentMagic &&
+        NumLiveHolders(header) == 0) {
+      unreferenced->push_back(make_pair(header.last_use_us,
+                                        make_pair(path, st.st_size)));
+    }
+  }
+  closedir(dir);
+  // Correct any drift in the shared count, e.g. from writers that died
+  // between sizing and removing a segment, unless segments changed while we
+  // scanned.
+  __sync_bool_compare_and_swap(&usage_->used_bytes, recorded_bytes,
+                               used_bytes);
+  return used_bytes;
+}
+
+uint8_t* ShmObjectStore::MapSegment(int fd, size_t length, bool writable) {
+  void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    PLOG(ERROR) << "Failed to map object segment of " << length << " bytes";
+    return NULL;
+  }
+  uint8_t* base = static_cast<uint8_t*>(addr);
+  if (!hugetlbfs_ && FLAGS_object_store_huge_pages) {
+    // Only a hint: tmpfs honours it if shmem_enabled permits.
+    madvise(base, length, MADV_HUGEPAGE);
+  }
+  if (!writable && length > page_size_) {
+    // Consumers share the producer's pages, so keep them from scribbling on
+    // the payload; the header stays writable for the reference count.
+    if (mprotect(base + page_size_, length - page_size_, PROT_READ) != 0)
+      PLOG(WARNING) << "Failed to write-protect object payload";
+  }
+  return base;
+}
+
+string ShmObjectStore::PathForObject(const DataObjectID_t& id) const {
+  return dir_ + "/" + id.name_printable_string();
+}
+
+size_t ShmObjectStore::SegmentLength(size_t payload_size) const {
+  if (payload_size == 0)
+    payload_size = 1;
+  size_t pages = (payload_size + page_size_ - 1) / page_size_;
+  return page_size_ * (pages + 1);
+}
+
+void* ShmObjectStore::PutObjectStart(const DataObjectID_t& id, size_t size) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  if (FindOrNull(mapped_, id)) {
+    LOG(ERROR) << "Object " << id << " is already mapped by this process";
+    return NULL;
+  }
+  string path = PathForObject(id);
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+  SegmentHeader existing;
+  struct stat st;
+  if (fd < 0 && errno == EEXIST && PeekHeader(path, &existing) &&
+      existing.magic == kSegmentMagic && !existing.sealed &&
+      NumLiveHolders(existing) == 0 && stat(path.c_str(), &st) == 0) {
+    // Left behind by a writer that died before sealing or discarding it.
+    LOG(WARNING) << "Replacing abandoned segment of object " << id;
+    if (unlink(path.c_str()) == 0)
+      AddUsage(-static_cast<int64_t>(st.st_size));
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+  }
+  if (fd < 0) {
+    if (errno == EEXIST)
+      VLOG(1) << "Object " << id << " already exists in " << dir_;
+    else
+      PLOG(ERROR) << "Failed to create object segment " << path;
+    return NULL;
+  }
+  size_t length = SegmentLength(size);
+  uint8_t* base = NULL;
+  if (ftruncate(fd, length) == 0) {
+    AddUsage(length);
+    base = MapSegment(fd, length, true);
+    if (!base)
+      AddUsage(-static_cast<int64_t>(length));
+  } else {
+    PLOG(ERROR) << "Failed to size object segment " << path;
+  }
+  close(fd);
+  if (!base) {
+    unlink(path.c_str());
+    return NULL;
+  }
+  MappedObject object = {base, length, 1, true};
+  SegmentHeader* header = Header(object);
+  header->size = 0;
+  header->capacity = size;
+  header->sealed = 0;
+  header->last_use_us = MonotonicTimeUs();
+  // The writer's reference, dropped when the object is sealed.
+  memset(const_cast<uint64_t*>(header->holders), 0,
+         sizeof(header->holders));
+  header->holders[0] = SelfHolder();
+  // Other processes only trust the header once they see the magic, so it is
+  // written last: a header that reads as valid always lists us as a holder,
+  // and eviction does not take the segment from under us.
+  __sync_synchronize();
+  header->magic = kSegmentMagic;
+  CHECK(InsertIfNotPresent(&mapped_, id, object));
+  return base + page_size_;
+}
+
+void* ShmObjectStore::Extend(const DataObjectID_t& id, size_t old_size,
+                             size_t new_size) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  MappedObject* object = FindOrNull(mapped_, id);
+  if (!object || !object->writable) {
+    LOG(ERROR) << "Cannot extend object " << id << ", which is not being "
+               << "written by this process";
+    return NULL;
+  }
+  CHECK_EQ(Header(*object)->capacity, old_size);
+  size_t length = SegmentLength(new_size);
+  if (length > object->length) {
+    string path = PathForObject(id);
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, length) != 0) {
+      PLOG(ERROR) << "Failed to grow object segment " << path;
+      if (fd >= 0)
+        close(fd);
+      return NULL;
+    }
+    close(fd);
+    AddUsage(length - object->length);
+    void* addr = mremap(object->base, object->length, length, MREMAP_MAYMOVE);
+    if (addr == MAP_FAILED) {
+      PLOG(ERROR) << "Failed to remap object segment " << path;
+      return NULL;
+    }
+    object->base = static_cast<uint8_t*>(addr);
+    object->length = length;
+  }
+  Header(*object)->capacity = new_size;
+  return object->base + page_size_;
+}
+
+bool ShmObjectStore::PutObjectEnd(const DataObjectID_t& id, size_t size) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  MappedObject* object = FindOrNull(mapped_, id);
+  if (!object || !object->writable) {
+    LOG(ERROR) << "Cannot seal object " << id << ", which is not being "
+               << "written by this process";
+    return false;
+  }
+  SegmentHeader* header = Header(*object);
+  CHECK_LE(size, header->capacity);
+  header->size = size;
+  // Publish the payload before the sealed flag becomes visible.
+  __sync_synchronize();
+  header->sealed = 1;
+  header->last_use_us = MonotonicTimeUs();
+  RemoveHolder(header);
+  munmap(object->base, object->length);
+  mapped_.erase(id);
+  return true;
+}
+
+void ShmObjectStore::PutObjectAbort(const DataObjectID_t& id) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  MappedObject* object = FindOrNull(mapped_, id);
+  if (!object || !object->writable) {
+    LOG(ERROR) << "Cannot discard object " << id << ", which is not being "
+               << "written by this process";
+    return;
+  }
+  if (unlink(PathForObject(id).c_str()) == 0)
+    AddUsage(-static_cast<int64_t>(object->length));
+  munmap(object->base, object->length);
+  mapped_.erase(id);
+}
+
+const void* ShmObjectStore::GetObjectStart(const DataObjectID_t& id,
+                                           size_t* size) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  MappedObject* object = FindOrNull(mapped_, id);
+  if (object) {
+    if (object->writable)
+      return NULL;
+    object->local_refs++;
+    if (size)
+      *size = Header(*object)->size;
+    return object->base + page_size_;
+  }
+  string path = PathForObject(id);
+  int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    VLOG(2) << "Object " << id << " is not present in " << dir_;
+    return NULL;
+  }
+  struct stat st;
+  uint8_t* base = NULL;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) > page_size_) {
+    base = MapSegment(fd, st.st_size, false);
+  }
+  close(fd);
+  if (!base)
+    return NULL;
+  MappedObject mapped_object = {base, static_cast<size_t>(st.st_size), 1,
+                                false};
+  SegmentHeader* header = Header(mapped_object);
+  if (header->magic != kSegmentMagic || !header->sealed) {
+    VLOG(2) << "Object " << id << " is not sealed yet";
+    munmap(base, mapped_object.length);
+    return NULL;
+  }
+  __sync_synchronize();
+  if (!AddHolder(header)) {
+    LOG(ERROR) << "Object " << id << " is referenced by " << kMaxHolders
+               << " processes already";
+    munmap(base, mapped_object.length);
+    return NULL;
+  }
+  header->last_use_us = MonotonicTimeUs();
+  CHECK(InsertIfNotPresent(&mapped_, id, mapped_object));
+  if (size)
+    *size = header->size;
+  return base + page_size_;
+}
+
+void ShmObjectStore::GetObjectEnd(const DataObjectID_t& id) {
+  boost::lock_guard<boost::mutex> lock(mapped_lock_);
+  MappedObject* object = FindOrNull(mapped_, id);
+  if (!object || object->writable) {
+    LOG(ERROR) << "Releasing object " << id << ", which was not obtained "
+               << "through GetObjectStart";
+    return;
+  }
+  if (--object->local_refs > 0)
+    return;
+  RemoveHolder(Header(*object));
+  munmap(object->base, object->length);
+  mapped_.erase(id);
+}
+
+bool ShmObjectStore::PinObject(const DataObjectID_t& id) {
+  boost::lock_guard<boost::mutex> lock(pinned_lock_);
+  if (pinned_.count(id) > 0)
+    return true;
+  // The pin is an ordinary reference, which eviction respects.
+  if (!GetObjectStart(id, NULL))
+    return false;
+  pinned_.insert(id);
+  return true;
+}
+
+void ShmObjectStore::UnpinObject(const DataObjectID_t& id) {
+  boost::lock_guard<boost::mutex> lock(pinned_lock_);
+  if (pinned_.erase(id) > 0)
+    GetObjectEnd(id);
+}
+
+bool ShmObjectStore::RemoveObject(const DataObjectID_t& id) {
+  if (NumObjectReferences(id) > 0) {
+    VLOG(1) << "Not removing object " << id << ", which is still in use";
+    return false;
+  }
+  // A consumer that maps the object concurrently keeps its pages until it
+  // unmaps them; only the name goes away.
+  string path = PathForObject(id);
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || unlink(path.c_str()) != 0) {
+    if (errno != ENOENT)
+      PLOG(ERROR) << "Failed to remove object " << id;
+    return false;
+  }
+  AddUsage(-static_cast<int64_t>(st.st_size));
+  return true;
+}
+
+bool ShmObjectStore::HasObject(const DataObjectID_t& id) {
+  size_t size;
+  if (!GetObjectStart(id, &size))
+    return false;
+  GetObjectEnd(id);
+  return true;
+}
+
+bool ShmObjectStore::WaitForObject(const DataObjectID_t& id,
+                                   uint64_t timeout_us) {
+  // Poll quickly at first, for objects that are about to be sealed, and back
+  // off exponentially for long transfers.
+  static const uint64_t kMinPollIntervalUs = 1000;
+  static const uint64_t kMaxPollIntervalUs = 100000;
+  SegmentHeader header;
+  string path = PathForObject(id);
+  uint64_t waited_us = 0;
+  uint64_t poll_interval_us = kMinPollIntervalUs;
+  while (PeekHeader(path, &header)) {
+    if (header.sealed)
+      return true;
+    if (waited_us >= timeout_us)
+      break;
+    if (header.magic == kSegmentMagic && NumLiveHolders(header) == 0) {
+      // The writer died before sealing the object.
+      break;
+    }
+    uint64_t sleep_us = min(poll_interval_us, timeout_us - waited_us);
+    usleep(sleep_us);
+    waited_us += sleep_us;
+    poll_interval_us = min(poll_interval_us * 2, kMaxPollIntervalUs);
+  }
+  return false;
+}
+
+uint64_t ShmObjectStore::NumObjectReferences(const DataObjectID_t& id) {
+  SegmentHeader header;
+  if (!PeekHeader(PathForObject(id), &header))
+    return 0;
+  return NumLiveHolders(header);
+}
+
+void ShmObjectStore::WaitForEviction() {
+  boost::unique_lock<boost::mutex> lock(evict_lock_);
+  while (evict_pending_ || evict_running_)
+    evict_cond_.wait(lock);
+}
+
+bool ShmObjectStore::PeekHeader(const string& path, SegmentHeader* header) {
+  // hugetlbfs does not support read(2), so peek at the header via mmap.
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  memset(header, 0, sizeof(SegmentHeader));
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < page_size_) {
+    // The writer has not sized the segment yet.
+    close(fd);
+    return true;
+  }
+  void* addr = mmap(NULL, page_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return false;
+  // Until the writer initializes the header, the segment reads as unsealed
+  // and unreferenced.
+  // The writer publishes the magic after the rest of the header.
+  if (static_cast<const volatile SegmentHeader*>(addr)->magic ==
+      kSegmentMagic) {
+    __sync_synchronize();
+    memcpy(header, addr, sizeof(SegmentHeader));
+  }
+  munmap(addr, page_size_);
+  return true;
+}
+
+string ShmObjectStore::LocationForObject(ResourceID_t machine_res_id,
+                                         const DataObjectID_t& id) {
+  return kLocationPrefix + to_string(machine_res_id) + "/" +
+    id.name_printable_string();
+}
+
+bool ShmObjectStore::MachineForLocation(const string& location,
+                                        ResourceID_t* machine_res_id) {
+  size_t prefix_len = strlen(kLocationPrefix);
+  if (location.compare(0, prefix_len, kLocationPrefix) != 0)
+    return false;
+  size_t slash = location.find('/', prefix_len);
+  if (slash == string::npos)
+    return false;
+  *machine_res_id =
+    ResourceIDFromString(location.substr(prefix_len, slash - prefix_len));
+  return true;
+}
+
+}  // namespace store
+}  // namespace firmament
@@ -0,0 +1,249 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Per-worker object store that keeps data objects in shared memory segments.
+// Each object lives in its own file in a shared memory directory (a hugetlbfs
+// mount, or tmpfs with transparent huge pages), so that any task on the same
+// machine can map it without copying.
+
+#ifndef FIRMAMENT_STORAGE_SHM_OBJECT_STORE_H
+#define FIRMAMENT_STORAGE_SHM_OBJECT_STORE_H
+
+#include <sys/types.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "base/common.h"
+#include "base/types.h"
+#include "storage/object_store_interface.h"
+
+namespace firmament {
+namespace store {
+
+class ShmObjectStore : public ObjectStoreInterface {
+ public:
+  /**
+   * @param uuid the resource ID of the coordinator or task owning this store
+   * instance
+   * @param dir the shared memory directory holding the object segments; all
+   * store instances on a machine must use the same directory
+   */
+  ShmObjectStore(ResourceID_t uuid, const string& dir);
+  explicit ShmObjectStore(ResourceID_t uuid);
+  ~ShmObjectStore();
+
+  /**
+   * Creates a new object segment and maps it writable into this process.
+   * @param id the object's name
+   * @param size the initial capacity of the object in bytes
+   * @return a pointer to the object's payload, or NULL if the object already
+   * exists or the segment could not be created; unsealed segments whose
+   * writer has died are replaced
+   */
+  void* PutObjectStart(const DataObjectID_t& id, size_t size);
+  /**
+   * Grows an object that is still being written. The payload may move.
+   * @param id the object's name
+   * @param old_size the capacity previously requested
+   * @param new_size the new capacity in bytes
+   * @return a pointer to the (possibly moved) payload, or NULL on failure
+   */
+  void* Extend(const DataObjectID_t& id, size_t old_size, size_t new_size);
+  /**
+   * Seals an object, making it visible to consumers, and drops the writer's
+   * mapping.
+   * @param id the object's name
+   * @param size the final size of the object in bytes
+   * @return true if the object was sealed
+   */
+  bool PutObjectEnd(const DataObjectID_t& id, size_t size);
+  /**
+   * Discards an object that is being written by this process.
+   * @param id the object's name
+   */
+  void PutObjectAbort(const DataObjectID_t& id);
+  /**
+   * Maps a sealed object read-only into this process and takes a reference
+   * on it. Repeated calls in the same process share one mapping.
+   * @param id the object's name
+   * @param size if not NULL, set to the object's size in bytes
+   * @return a pointer to the object's payload, or NULL if the object is not
+   * present (or not yet sealed) on this machine
+   */
+  const void* GetObjectStart(const DataObjectID_t& id, size_t* size);
+  /**
+   * Drops a reference taken by GetObjectStart, unmapping the object once this
+   * process holds no further references to it.
+   * @param id the object's name
+   */
+  void GetObjectEnd(const DataObjectID_t& id);
+  /**
+   * Keeps a sealed object from being evicted, e.g. while tasks that consume
+   * it have yet to run. The pin is a reference held by this process, so it
+   * lapses if the process exits. Pinning an object again has no effect.
+   * @param id the object's name
+   * @return true if the object is pinned
+   */
+  bool PinObject(const DataObjectID_t& id);
+  /**
+   * Releases a pin taken by PinObject.
+   * @param id the object's name
+   */
+  void UnpinObject(const DataObjectID_t& id);
+  /**
+   * Removes an object's segment. Only objects without outstanding references
+   * are removed. Unreferenced objects are also evicted, least recently used
+   * first, in the background once the segments exceed
+   * --object_store_capacity_mb.
+   * @param id the object's name
+   * @return true if the segment was removed
+   */
+  bool RemoveObject(const DataObjectID_t& id);
+  /**
+   * @param id the object's name
+   * @return true if a sealed copy of the object is present on this machine
+   */
+  bool HasObject(const DataObjectID_t& id);
+  /**
+   * Waits for an object that is still being written (e.g. fetched from
+   * another machine) to be sealed.
+   * @param id the object's name
+   * @param timeout_us the maximum time to wait, in microseconds
+   * @return true if the object is sealed; false if it is not present, is
+   * discarded or abandoned by its writer while waiting, or the timeout
+   * expires
+   */
+  bool WaitForObject(const DataObjectID_t& id, uint64_t timeout_us);
+  /**
+   * @param id the object's name
+   * @return the number of references held on the object by live processes
+   * on this machine, or 0 if the object is not present; references of
+   * processes that exited without releasing them are not counted
+   */
+  uint64_t NumObjectReferences(const DataObjectID_t& id);
+  /**
+   * Waits until evictions triggered by this instance's puts have finished.
+   */
+  void WaitForEviction();
+
+  /**
+   * Builds the location string stored in concrete references to objects in
+   * this store.
+   * @param machine_res_id the resource ID of the machine holding the object
+   * @param id the object's name
+   */
+  static string LocationForObject(ResourceID_t machine_res_id,
+                                  const DataObjectID_t& id);
+  /**
+   * Extracts the machine from a location built by LocationForObject.
+   * @param location the location string
+   * @param machine_res_id set to the machine holding the object
+   * @return false if the location does not refer to a shared memory object
+   */
+  static bool MachineForLocation(const string& location,
+                                 ResourceID_t* machine_res_id);
+
+  virtual ostream& ToString(ostream* stream) const {
+    return *stream << "<ShmObjectStore, dir=" << dir_ << ", containing "
+                   << object_table_->size() << " objects>";
+  }
+
+ private:
+  // The most processes that can reference an object at the same time.
+  static const uint32_t kMaxHolders = 256;
+  // Header at the start of every segment. The payload starts on the next
+  // page, so that consumer mappings of it can be read-only.
+  struct SegmentHeader {
+    uint64_t magic;
+    uint64_t size;
+    uint64_t capacity;
+    volatile uint64_t sealed;
+    // CLOCK_MONOTONIC time of the last seal or first mapping in a process,
+    // in microseconds; orders eviction.
+    volatile uint64_t last_use_us;
+    // The process holding each reference, or 0 for a free slot: its PID in
+    // the low 32 bits and the low 32 bits of its start time above them, so
+    // that the slots of processes that died without releasing them can be
+    // reclaimed even once their PID is reused.
+    volatile uint64_t holders[kMaxHolders];
+  };
+  // Shared by all instances on dir_, in a file that segment scans skip.
+  struct UsageHeader {
+    // Bytes taken up by the segments in dir_.
+    volatile uint64_t used_bytes;
+  };
+  struct MappedObject {
+    uint8_t* base;
+    size_t length;
+    uint64_t local_refs;
+    bool writable;
+  };
+
+  SegmentHeader* Header(const MappedObject& object) {
+    return reinterpret_cast<SegmentHeader*>(object.base);
+  }
+  static bool AddHolder(SegmentHeader* header);
+  static void RemoveHolder(SegmentHeader* header);
+  static uint64_t NumLiveHolders(const SegmentHeader& header);
+  void AddUsage(int64_t delta);
+  void EvictionLoop();
+  void EvictObjects();
+  void MapUsage();
+  uint64_t ScanSegments(
+      vector<pair<uint64_t, pair<string, uint64_t> > >* unreferenced);
+  uint8_t* MapSegment(int fd, size_t length, bool writable);
+  bool PeekHeader(const string& path, SegmentHeader* header);
+  string PathForObject(const DataObjectID_t& id) const;
+  size_t SegmentLength(size_t payload_size) const;
+
+  string dir_;
+  // Size of the pages backing the segments; the huge page size on hugetlbfs.
+  size_t page_size_;
+  bool hugetlbfs_;
+  // Bytes the segments in dir_ may take up before unreferenced ones are
+  // evicted; 0 for no limit.
+  uint64_t capacity_bytes_;
+  UsageHeader* usage_;
+  // Eviction runs on evict_thread_, which is started on first use.
+  boost::mutex evict_lock_;
+  boost::condition_variable evict_cond_;
+  boost::thread* evict_thread_;
+  bool evict_pending_;
+  bool evict_running_;
+  bool evict_stop_;
+  boost::mutex mapped_lock_;
+  map<DataObjectID_t, MappedObject> mapped_;
+  // Objects pinned by this instance; guarded by pinned_lock_.
+  boost::mutex pinned_lock_;
+  set<DataObjectID_t> pinned_;
+};
+
+}  // namespace store
+}  // namespace firmament
+
+#endif  // FIRMAMENT_STORAGE_SHM_OBJECT_STORE_H
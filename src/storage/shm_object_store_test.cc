@@ -0,0 +1,255 @@
+/*
+ * Firmament
+ * Copyright (c) The Firmament Authors.
+ * All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR
+ * A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+// Shared memory object store unit tests.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "base/common.h"
+#include "misc/utils.h"
+#include "storage/shm_object_store.h"
+
+DECLARE_uint64(object_store_capacity_mb);
+
+namespace firmament {
+namespace store {
+
+class ShmObjectStoreTest : public ::testing::Test {
+ protected:
+  ShmObjectStoreTest()
+    : id_(string(DIOS_NAME_BYTES * 2, 'a'), true) {
+  }
+
+  virtual void SetUp() {
+    dir_ = MakeTemporaryDirectory("firmament-shm-test");
+    ASSERT_FALSE(dir_.empty());
+  }
+
+  virtual void TearDown() {
+    if (!dir_.empty()) {
+      EXPECT_TRUE(RemoveDirectoryRecursively(dir_));
+    }
+  }
+
+  string dir_;
+  DataObjectID_t id_;
+};
+
+// Objects only become visible once sealed, and report their final size.
+TEST_F(ShmObjectStoreTest, PutAndGet) {
+  ShmObjectStore producer(GenerateResourceID(), dir_);
+  ShmObjectStore consumer(GenerateResourceID(), dir_);
+  char* buf = static_cast<char*>(producer.PutObjectStart(id_, 16));
+  ASSERT_TRUE(buf);
+  strcpy(buf, "hello");  // NOLINT
+  EXPECT_FALSE(consumer.GetObjectStart(id_, NULL));
+  buf = static_cast<char*>(producer.Extend(id_, 16, 1 << 20));
+  ASSERT_TRUE(buf);
+  EXPECT_STREQ("hello", buf);
+  EXPECT_TRUE(producer.PutObjectEnd(id_, 6));
+  size_t size = 0;
+  const char* data =
+    static_cast<const char*>(consumer.GetObjectStart(id_, &size));
+  ASSERT_TRUE(data);
+  EXPECT_EQ(6, size);
+  EXPECT_STREQ("hello", data);
+  // A second put of the same object fails.
+  EXPECT_FALSE(producer.PutObjectStart(id_, 16));
+  consumer.GetObjectEnd(id_);
+}
+
+// References are counted across processes, and objects in use are not
+// removed.
+TEST_F(ShmObjectStoreTest, ReferenceCounting) {
+  ShmObjectStore store(GenerateResourceID(), dir_);
+  ASSERT_TRUE(store.PutObjectStart(id_, 4096));
+  EXPECT_EQ(1, store.NumObjectReferences(id_));
+  EXPECT_TRUE(store.PutObjectEnd(id_, 4096));
+  EXPECT_EQ(0, store.NumObjectReferences(id_));
+  const void* first = store.GetObjectStart(id_, NULL);
+  // The same process shares one mapping and one reference.
+  EXPECT_EQ(first, store.GetObjectStart(id_, NULL));
+  EXPECT_EQ(1, store.NumObjectReferences(id_));
+  pid_t pid = fork();
+  if (pid == 0) {
+    ShmObjectStore child(GenerateResourceID(), dir_);
+    _exit(child.GetObjectStart(id_, NULL) &&
+          child.NumObjectReferences(id_) == 2 ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  // The child exited without releasing its reference, which therefore no
+  // longer counts.
+  EXPECT_EQ(1, store.NumObjectReferences(id_));
+  EXPECT_FALSE(store.RemoveObject(id_));
+  store.GetObjectEnd(id_);
+  store.GetObjectEnd(id_);
+  EXPECT_EQ(0, store.NumObjectReferences(id_));
+  EXPECT_TRUE(store.RemoveObject(id_));
+}
+
+TEST_F(ShmObjectStoreTest, Removal) {
+  ShmObjectStore store(GenerateResourceID(), dir_);
+  ASSERT_TRUE(store.PutObjectStart(id_, 128));
+  EXPECT_TRUE(store.PutObjectEnd(id_, 128));
+  const void* data = store.GetObjectStart(id_, NULL);
+  ASSERT_TRUE(data);
+  EXPECT_FALSE(store.RemoveObject(id_));
+  store.GetObjectEnd(id_);
+  EXPECT_TRUE(store.HasObject(id_));
+  EXPECT_TRUE(store.RemoveObject(id_));
+  EXPECT_FALSE(store.HasObject(id_));
+}
+
+// A segment whose writer died before sealing it is not waited for, and is
+// replaced by the next writer.
+TEST_F(ShmObjectStoreTest, AbandonedSegment) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    ShmObjectStore child(GenerateResourceID(), dir_);
+    _exit(child.PutObjectStart(id_, 4096) ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+  ShmObjectStore store(GenerateResourceID(), dir_);
+  EXPECT_FALSE(store.WaitForObject(id_, 10 * 1000 * 1000));
+  ASSERT_TRUE(store.PutObjectStart(id_, 4096));
+  EXPECT_TRUE(store.PutObjectEnd(id_, 4096));
+  EXPECT_TRUE(store.WaitForObject(id_, 0));
+}
+
+// Objects beyond the store's capacity evict the least recently used objects
+// that nobody references.
+TEST_F(ShmObjectStoreTest, Eviction) {
+  FLAGS_object_store_capacity_mb = 1;
+  ShmObjectStore store(GenerateResourceID(), dir_);
+  FLAGS_object_store_capacity_mb = 4096;
+  DataObjectID_t ids[] = {
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'b'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'c'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'd'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'e'), true),
+  };
+  size_t size = 300 * 1024;
+  for (uint32_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(store.PutObjectStart(ids[i], size));
+    EXPECT_TRUE(store.PutObjectEnd(ids[i], size));
+  }
+  // The oldest object is in use, so the next oldest one goes.
+  ASSERT_TRUE(store.GetObjectStart(ids[0], NULL));
+  ASSERT_TRUE(store.PutObjectStart(ids[3], size));
+  EXPECT_TRUE(store.PutObjectEnd(ids[3], size));
+  store.WaitForEviction();
+  EXPECT_FALSE(store.HasObject(ids[1]));
+  EXPECT_TRUE(store.HasObject(ids[2]));
+  EXPECT_TRUE(store.HasObject(ids[3]));
+  store.GetObjectEnd(ids[0]);
+  EXPECT_TRUE(store.HasObject(ids[0]));
+}
+
+// Pinned objects are not evicted until they are unpinned.
+TEST_F(ShmObjectStoreTest, Pinning) {
+  FLAGS_object_store_capacity_mb = 1;
+  ShmObjectStore store(GenerateResourceID(), dir_);
+  ShmObjectStore pinner(GenerateResourceID(), dir_);
+  FLAGS_object_store_capacity_mb = 4096;
+  DataObjectID_t ids[] = {
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'b'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'c'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'd'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'e'), true),
+  };
+  size_t size = 300 * 1024;
+  EXPECT_FALSE(pinner.PinObject(ids[0]));
+  for (uint32_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(store.PutObjectStart(ids[i], size));
+    EXPECT_TRUE(store.PutObjectEnd(ids[i], size));
+  }
+  EXPECT_TRUE(pinner.PinObject(ids[0]));
+  EXPECT_TRUE(pinner.PinObject(ids[0]));
+  EXPECT_EQ(1, store.NumObjectReferences(ids[0]));
+  ASSERT_TRUE(store.PutObjectStart(ids[3], size));
+  EXPECT_TRUE(store.PutObjectEnd(ids[3], size));
+  store.WaitForEviction();
+  EXPECT_TRUE(store.HasObject(ids[0]));
+  EXPECT_FALSE(store.HasObject(ids[1]));
+  // Once unpinned, the object may be evicted again.
+  pinner.UnpinObject(ids[0]);
+  EXPECT_EQ(0, store.NumObjectReferences(ids[0]));
+}
+
+// The space used is shared between all stores on a directory, so objects
+// put by one store count towards another's eviction.
+TEST_F(ShmObjectStoreTest, SharedUsage) {
+  FLAGS_object_store_capacity_mb = 1;
+  ShmObjectStore first(GenerateResourceID(), dir_);
+  ShmObjectStore second(GenerateResourceID(), dir_);
+  FLAGS_object_store_capacity_mb = 4096;
+  DataObjectID_t ids[] = {
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'b'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'c'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'd'), true),
+    DataObjectID_t(string(DIOS_NAME_BYTES * 2, 'e'), true),
+  };
+  size_t size = 300 * 1024;
+  for (uint32_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(first.PutObjectStart(ids[i], size));
+    EXPECT_TRUE(first.PutObjectEnd(ids[i], size));
+  }
+  ASSERT_TRUE(second.PutObjectStart(ids[3], size));
+  EXPECT_TRUE(second.PutObjectEnd(ids[3], size));
+  second.WaitForEviction();
+  EXPECT_FALSE(second.HasObject(ids[0]));
+  EXPECT_TRUE(second.HasObject(ids[1]));
+  EXPECT_TRUE(second.HasObject(ids[3]));
+  // Removals are accounted for, too: there is room for the evicted object
+  // again once another one is removed.
+  EXPECT_TRUE(first.RemoveObject(ids[1]));
+  ASSERT_TRUE(first.PutObjectStart(ids[0], size));
+  EXPECT_TRUE(first.PutObjectEnd(ids[0], size));
+  first.WaitForEviction();
+  EXPECT_TRUE(first.HasObject(ids[2]));
+  EXPECT_TRUE(first.HasObject(ids[3]));
+}
+
+TEST_F(ShmObjectStoreTest, Locations) {
+  ResourceID_t machine = GenerateResourceID();
+  string location = ShmObjectStore::LocationForObject(machine, id_);
+  ResourceID_t parsed;
+  EXPECT_TRUE(ShmObjectStore::MachineForLocation(location, &parsed));
+  EXPECT_EQ(machine, parsed);
+  EXPECT_FALSE(ShmObjectStore::MachineForLocation("hdfs:///foo", &parsed));
+}
+
+}  // namespace store
+}  // namespace firmament
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}